@@ -0,0 +1,169 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bench_helper.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <nghttp2/nghttp2.h>
+
+/* The stream JSON is written to, or NULL */
+static FILE *json_out;
+/* Nonzero if text is not printed because JSON goes to stdout */
+static int text_off;
+/* The number of benchmarks written to |json_out| */
+static size_t json_nresults;
+
+uint64_t bench_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int bench_json_open(const char *path) {
+  if (strcmp(path, "-") == 0) {
+    json_out = stdout;
+    text_off = 1;
+  } else {
+    json_out = fopen(path, "w");
+    if (json_out == NULL) {
+      return -1;
+    }
+  }
+
+  fprintf(json_out, "{\n  \"version\": \"%s\",\n  \"benchmarks\": [",
+          NGHTTP2_VERSION);
+
+  return 0;
+}
+
+void bench_json_close(void) {
+  if (json_out == NULL) {
+    return;
+  }
+
+  if (json_nresults) {
+    /* Close the object of the last benchmark. */
+    fprintf(json_out, "}\n  ");
+  }
+
+  fprintf(json_out, "]\n}\n");
+
+  if (json_out != stdout) {
+    fclose(json_out);
+  }
+
+  json_out = NULL;
+}
+
+/*
+ * Writes |s| to |json_out| as JSON string.
+ */
+static void json_write_string(const char *s) {
+  fputc('"', json_out);
+
+  for (; *s; ++s) {
+    unsigned char c = (unsigned char)*s;
+
+    if (c == '"' || c == '\\') {
+      fputc('\\', json_out);
+      fputc(c, json_out);
+    } else if (c < 0x20) {
+      fprintf(json_out, "\\u%04x", c);
+    } else {
+      fputc(c, json_out);
+    }
+  }
+
+  fputc('"', json_out);
+}
+
+/*
+ * Writes |value| to |json_out| with |precision| digits after the
+ * decimal point, or in %g format if |precision| is negative.  JSON
+ * has no infinity and NaN, so null is written instead of them.
+ */
+static void json_write_number(double value, int precision) {
+  if (!isfinite(value)) {
+    fputs("null", json_out);
+    return;
+  }
+
+  if (precision < 0) {
+    fprintf(json_out, "%g", value);
+    return;
+  }
+
+  fprintf(json_out, "%.*f", precision, value);
+}
+
+void bench_report(const char *name, size_t niters, size_t nbytes,
+                  uint64_t elapsed) {
+  double sec = (double)elapsed / 1e9;
+  double ns_per_op = (double)elapsed / (double)niters;
+  double mib_per_sec = (double)nbytes / (1024 * 1024) / sec;
+
+  if (!text_off) {
+    printf("%-32s %12.1f ns/op %10.1f MiB/s\n", name, ns_per_op,
+           mib_per_sec);
+  }
+
+  if (json_out == NULL) {
+    return;
+  }
+
+  /* The object is left open so that bench_report_metric() can add
+     members to it. */
+  fprintf(json_out, "%s\n    {\"name\": ", json_nresults ? "}," : "");
+  json_write_string(name);
+  fprintf(json_out,
+          ", \"iterations\": %zu, \"bytes\": %zu, \"elapsed_ns\": %llu, "
+          "\"ns_per_op\": ",
+          niters, nbytes, (unsigned long long)elapsed);
+  json_write_number(ns_per_op, 1);
+  fputs(", \"mib_per_sec\": ", json_out);
+  json_write_number(mib_per_sec, 1);
+
+  ++json_nresults;
+}
+
+void bench_report_metric(const char *name, const char *metric, double value) {
+  if (!text_off) {
+    printf("%-32s %12g %s\n", name, value, metric);
+  }
+
+  if (json_out == NULL) {
+    return;
+  }
+
+  fputs(", ", json_out);
+  json_write_string(metric);
+  fputs(": ", json_out);
+  json_write_number(value, -1);
+}
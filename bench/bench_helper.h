@@ -0,0 +1,77 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef BENCH_HELPER_H
+#define BENCH_HELPER_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARRLEN(ARR) (sizeof(ARR) / sizeof(ARR[0]))
+
+/*
+ * Returns monotonic clock in nanoseconds.
+ */
+uint64_t bench_now(void);
+
+/*
+ * Starts writing the results in JSON to |path| in addition to the
+ * text printed to standard output.  If |path| is "-", JSON is written
+ * to standard output instead of the text.  The document is an object
+ * whose "benchmarks" member is an array with one object per
+ * benchmark, which is keyed by "name", so that the results of two
+ * commits can be compared.
+ *
+ * This function returns 0 if it succeeds, or -1 if |path| cannot be
+ * opened.
+ */
+int bench_json_open(const char *path);
+
+/*
+ * Finishes the JSON document started by bench_json_open().  This
+ * function does nothing if bench_json_open() has not been called.
+ */
+void bench_json_close(void);
+
+/*
+ * Prints the result of benchmark |name|.  |niters| is the number of
+ * operations performed in |elapsed| nanoseconds, and |nbytes| is the
+ * total number of bytes processed by them.
+ */
+void bench_report(const char *name, size_t niters, size_t nbytes,
+                  uint64_t elapsed);
+
+/*
+ * Prints the additional |metric| of benchmark |name|, whose value is
+ * |value|.  This must be called after bench_report() for |name|, and
+ * the |metric| is added to its JSON object.  |metric| must not
+ * contain the characters which need escaping in JSON.
+ */
+void bench_report_metric(const char *name, const char *metric, double value);
+
+#endif /* BENCH_HELPER_H */
@@ -0,0 +1,113 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <string.h>
+/* include benchmark cases' include files here */
+#include "nghttp2_hd_huffman_bench.h"
+#include "nghttp2_hd_bench.h"
+#include "nghttp2_frame_bench.h"
+#include "nghttp2_helper_bench.h"
+#include "nghttp2_map_bench.h"
+#include "nghttp2_session_bench.h"
+#include "bench_helper.h"
+
+typedef struct {
+  const char *name;
+  void (*func)(void);
+} bench_entry;
+
+static const bench_entry benches[] = {
+    {"hd_huff_decode", bench_nghttp2_hd_huff_decode},
+    {"hd_huff_encode", bench_nghttp2_hd_huff_encode},
+    {"hd_deflate", bench_nghttp2_hd_deflate},
+    {"hd_deflate_adaptive", bench_nghttp2_hd_deflate_adaptive},
+    {"hd_deflate_response", bench_nghttp2_hd_deflate_response},
+    {"hd_deflate_response_template",
+     bench_nghttp2_hd_deflate_response_template},
+    {"hd_inflate", bench_nghttp2_hd_inflate},
+    {"hd_inflate_zero_copy", bench_nghttp2_hd_inflate_zero_copy},
+    {"check_header_name", bench_nghttp2_check_header_name},
+    {"check_header_value", bench_nghttp2_check_header_value},
+    {"map_churn", bench_nghttp2_map_churn},
+    {"map_strided", bench_nghttp2_map_strided},
+    {"session_stream_churn", bench_nghttp2_session_stream_churn},
+    {"session_stream_churn_nopool", bench_nghttp2_session_stream_churn_nopool},
+    {"session_recv_small_frames", bench_nghttp2_session_recv_small_frames},
+    {"session_send_response", bench_nghttp2_session_send_response},
+    {"session_send_response_batch", bench_nghttp2_session_send_response_batch},
+    {"session_retained", bench_nghttp2_session_retained_streams},
+    {"session_retained_compact",
+     bench_nghttp2_session_retained_streams_compact},
+    {"session_transfer", bench_nghttp2_session_transfer},
+    {"session_flat_tree", bench_nghttp2_session_flat_tree},
+    {"frame_pack", bench_nghttp2_frame_pack},
+    {"frame_unpack", bench_nghttp2_frame_unpack},
+};
+
+int main(int argc, char **argv) {
+  size_t i;
+  int j;
+  int nfilters = 0;
+
+  /* --json=PATH writes the results in JSON to PATH.  The other
+     arguments are filters. */
+  for (j = 1; j < argc; ++j) {
+    if (strncmp(argv[j], "--json=", sizeof("--json=") - 1) == 0) {
+      if (bench_json_open(argv[j] + sizeof("--json=") - 1) != 0) {
+        fprintf(stderr, "Could not open %s\n",
+                argv[j] + sizeof("--json=") - 1);
+        return 1;
+      }
+      continue;
+    }
+
+    argv[1 + nfilters++] = argv[j];
+  }
+
+  /* If filters are given, run only the benchmarks whose name
+     contains one of them. */
+  for (i = 0; i < ARRLEN(benches); ++i) {
+    if (nfilters) {
+      for (j = 1; j <= nfilters; ++j) {
+        if (strstr(benches[i].name, argv[j])) {
+          break;
+        }
+      }
+      if (j > nfilters) {
+        continue;
+      }
+    }
+
+    benches[i].func();
+  }
+
+  bench_json_close();
+
+  return 0;
+}
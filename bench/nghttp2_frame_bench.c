@@ -0,0 +1,206 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_frame_bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nghttp2_frame.h"
+#include "bench_helper.h"
+
+/* The number of times the set of frames is packed or unpacked */
+#define FRAME_ROUNDS 1000000
+
+/* The number of frames in the set */
+#define FRAME_NFRAMES 6
+
+static const nghttp2_settings_entry frame_iv[] = {
+    {NGHTTP2_SETTINGS_HEADER_TABLE_SIZE, 65536},
+    {NGHTTP2_SETTINGS_ENABLE_PUSH, 0},
+    {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, 1000},
+    {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, 6291456},
+    {NGHTTP2_SETTINGS_MAX_FRAME_SIZE, 16384},
+    {NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE, 262144},
+};
+
+/*
+ * Packs the |i|th frame of the set, which is the mix of DATA and
+ * control frames a busy connection sends, into |bufs|.
+ */
+static void pack_frame(nghttp2_bufs *bufs, size_t i) {
+  nghttp2_frame frame;
+  nghttp2_frame_hd hd;
+  uint8_t opaque_data[8] = {0};
+
+  nghttp2_bufs_reset(bufs);
+
+  switch (i) {
+  case 0:
+    nghttp2_frame_hd_init(&hd, 16384, NGHTTP2_DATA, NGHTTP2_FLAG_NONE, 1);
+    nghttp2_frame_pack_frame_hd(bufs->cur->buf.last, &hd);
+    bufs->cur->buf.last += NGHTTP2_FRAME_HDLEN;
+    break;
+  case 1:
+    nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE,
+                                (nghttp2_settings_entry *)frame_iv,
+                                ARRLEN(frame_iv));
+    nghttp2_frame_pack_settings(bufs, &frame.settings);
+    break;
+  case 2:
+    nghttp2_frame_ping_init(&frame.ping, NGHTTP2_FLAG_NONE, opaque_data);
+    nghttp2_frame_pack_ping(bufs, &frame.ping);
+    break;
+  case 3:
+    nghttp2_frame_window_update_init(&frame.window_update, NGHTTP2_FLAG_NONE,
+                                     1, 65536);
+    nghttp2_frame_pack_window_update(bufs, &frame.window_update);
+    break;
+  case 4:
+    nghttp2_frame_rst_stream_init(&frame.rst_stream, 3, NGHTTP2_CANCEL);
+    nghttp2_frame_pack_rst_stream(bufs, &frame.rst_stream);
+    break;
+  case 5:
+    nghttp2_frame_goaway_init(&frame.goaway, 1000001, NGHTTP2_NO_ERROR, NULL,
+                              0);
+    nghttp2_frame_pack_goaway(bufs, &frame.goaway);
+    break;
+  }
+}
+
+static int frame_bufs_init(nghttp2_bufs *bufs) {
+  return nghttp2_bufs_init2(bufs, 4096, 1, NGHTTP2_FRAME_HDLEN + 1,
+                            nghttp2_mem_default());
+}
+
+void bench_nghttp2_frame_pack(void) {
+  nghttp2_bufs bufs;
+  size_t i, j, nbytes = 0;
+  uint64_t start, elapsed;
+
+  frame_bufs_init(&bufs);
+
+  start = bench_now();
+
+  for (i = 0; i < FRAME_ROUNDS; ++i) {
+    for (j = 0; j < FRAME_NFRAMES; ++j) {
+      pack_frame(&bufs, j);
+      nbytes += nghttp2_bufs_len(&bufs);
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report("frame_pack", FRAME_ROUNDS * FRAME_NFRAMES, nbytes, elapsed);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+/*
+ * Unpacks the frames in |in| of length |inlen| the way
+ * nghttp2_session_mem_recv() does, and returns the sum of a few
+ * fields so that the work is not optimized away.
+ */
+static uint64_t unpack_frames(const uint8_t *in, size_t inlen) {
+  nghttp2_frame frame;
+  nghttp2_settings_entry iv;
+  const uint8_t *end = in + inlen;
+  const uint8_t *payload;
+  size_t i;
+  uint64_t sum = 0;
+
+  for (; in != end; in = payload + frame.hd.length) {
+    nghttp2_frame_unpack_frame_hd(&frame.hd, in);
+
+    payload = in + NGHTTP2_FRAME_HDLEN;
+
+    switch (frame.hd.type) {
+    case NGHTTP2_DATA:
+      sum += (uint64_t)frame.hd.stream_id;
+      /* The payload is not on the wire. */
+      payload -= frame.hd.length;
+      break;
+    case NGHTTP2_SETTINGS:
+      for (i = 0; i < frame.hd.length;
+           i += NGHTTP2_FRAME_SETTINGS_ENTRY_LENGTH) {
+        nghttp2_frame_unpack_settings_entry(&iv, payload + i);
+        sum += iv.value;
+      }
+      break;
+    case NGHTTP2_PING:
+      nghttp2_frame_unpack_ping_payload(&frame.ping, payload);
+      sum += frame.ping.opaque_data[0];
+      break;
+    case NGHTTP2_WINDOW_UPDATE:
+      nghttp2_frame_unpack_window_update_payload(&frame.window_update,
+                                                 payload);
+      sum += (uint64_t)frame.window_update.window_size_increment;
+      break;
+    case NGHTTP2_RST_STREAM:
+      nghttp2_frame_unpack_rst_stream_payload(&frame.rst_stream, payload);
+      sum += frame.rst_stream.error_code;
+      break;
+    case NGHTTP2_GOAWAY:
+      nghttp2_frame_unpack_goaway_payload(&frame.goaway, payload, NULL, 0);
+      sum += (uint64_t)frame.goaway.last_stream_id;
+      break;
+    }
+  }
+
+  return sum;
+}
+
+void bench_nghttp2_frame_unpack(void) {
+  nghttp2_bufs bufs;
+  uint8_t wire[1024];
+  size_t i, wirelen = 0;
+  uint64_t sum = 0, expected;
+  uint64_t start, elapsed;
+
+  frame_bufs_init(&bufs);
+
+  for (i = 0; i < FRAME_NFRAMES; ++i) {
+    pack_frame(&bufs, i);
+    wirelen += nghttp2_bufs_remove_copy(&bufs, wire + wirelen);
+  }
+
+  nghttp2_bufs_free(&bufs);
+
+  expected = unpack_frames(wire, wirelen);
+
+  start = bench_now();
+
+  for (i = 0; i < FRAME_ROUNDS; ++i) {
+    sum += unpack_frames(wire, wirelen);
+  }
+
+  elapsed = bench_now() - start;
+
+  if (sum != expected * FRAME_ROUNDS) {
+    fprintf(stderr, "frame_unpack: unexpected result\n");
+  }
+
+  bench_report("frame_unpack", FRAME_ROUNDS * FRAME_NFRAMES,
+               FRAME_ROUNDS * wirelen, elapsed);
+}
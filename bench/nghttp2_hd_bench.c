@@ -0,0 +1,373 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_hd_bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nghttp2_hd.h"
+#include "nghttp2_frame.h"
+#include "bench_helper.h"
+
+#define MAKE_NV(NAME, VALUE)                                                   \
+  {                                                                            \
+    (uint8_t *)(NAME), (uint8_t *)(VALUE), sizeof(NAME) - 1,                   \
+        sizeof(VALUE) - 1, NGHTTP2_NV_FLAG_NONE                                \
+  }
+
+/* The number of header blocks deflated by one session */
+#define HD_DEFLATE_NBLOCKS 2000
+/* The number of sessions simulated */
+#define HD_DEFLATE_ROUNDS 50
+/* The number of response header blocks deflated by one session */
+#define HD_RESPONSE_NBLOCKS 10000
+/* The number of header blocks inflated */
+#define HD_INFLATE_NBLOCKS 1000000
+
+static uint32_t hd_rand(uint32_t *state) {
+  /* xorshift32 */
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+
+  return *state;
+}
+
+/*
+ * Deflates the request header blocks of API polling clients.  Most of
+ * :path and if-none-match recur, and x-request-id never does.  The
+ * deflater uses adaptive indexing if |adaptive| is nonzero.
+ */
+static void bench_deflate(const char *name, int adaptive) {
+  nghttp2_mem *mem = nghttp2_mem_default();
+  nghttp2_hd_deflater deflater;
+  nghttp2_bufs bufs;
+  nghttp2_nv nva[] = {
+      MAKE_NV(":method", "GET"),
+      MAKE_NV(":scheme", "https"),
+      MAKE_NV(":authority", "api.example.com"),
+      MAKE_NV(":path", ""),
+      MAKE_NV("user-agent", "example-client/2.3.1 (linux; x86_64)"),
+      MAKE_NV("accept", "application/json"),
+      MAKE_NV("if-none-match", ""),
+      MAKE_NV("x-request-id", ""),
+      MAKE_NV("cookie", "session=5f2b6c7d8e9fa0b1c2d3e4f5a6b7c8d9"),
+  };
+  char path[64], etag[32], reqid[32];
+  size_t i, j, k, nbytes = 0, ncompressed = 0;
+  uint32_t state;
+  uint64_t start, elapsed = 0;
+  int rv;
+
+  nva[3].value = (uint8_t *)path;
+  nva[6].value = (uint8_t *)etag;
+  nva[7].value = (uint8_t *)reqid;
+
+  nghttp2_bufs_init(&bufs, 4096, 16, mem);
+
+  for (j = 0; j < HD_DEFLATE_ROUNDS; ++j) {
+    nghttp2_hd_deflate_init(&deflater, mem);
+    if (adaptive) {
+      nghttp2_hd_deflate_set_adaptive_indexing(&deflater, 1);
+    }
+
+    state = 2463534242u;
+
+    start = bench_now();
+
+    for (i = 0; i < HD_DEFLATE_NBLOCKS; ++i) {
+      uint32_t r = hd_rand(&state);
+
+      if (r % 10 < 7) {
+        /* polling one of a few channels */
+        nva[3].valuelen = (size_t)snprintf(
+            path, sizeof(path), "/api/v1/channels/%u/poll", (r >> 8) % 4);
+        nva[6].valuelen = (size_t)snprintf(etag, sizeof(etag), "\"%08x\"",
+                                           ((r >> 8) % 4) * 0x9e3779b9u);
+      } else {
+        nva[3].valuelen = (size_t)snprintf(path, sizeof(path),
+                                           "/api/v1/items/%u", r >> 8);
+        nva[6].valuelen =
+            (size_t)snprintf(etag, sizeof(etag), "\"%08x\"", hd_rand(&state));
+      }
+
+      nva[7].valuelen =
+          (size_t)snprintf(reqid, sizeof(reqid), "%08x%08x", hd_rand(&state),
+                           hd_rand(&state));
+
+      nghttp2_bufs_reset(&bufs);
+
+      rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, nva, ARRLEN(nva));
+      if (rv != 0) {
+        fprintf(stderr, "deflate failed\n");
+        nghttp2_hd_deflate_free(&deflater);
+        nghttp2_bufs_free(&bufs);
+        return;
+      }
+
+      ncompressed += nghttp2_bufs_len(&bufs);
+
+      for (k = 0; k < ARRLEN(nva); ++k) {
+        nbytes += nva[k].namelen + nva[k].valuelen;
+      }
+    }
+
+    elapsed += bench_now() - start;
+
+    nghttp2_hd_deflate_free(&deflater);
+  }
+
+  bench_report(name, HD_DEFLATE_ROUNDS * HD_DEFLATE_NBLOCKS, nbytes, elapsed);
+
+  bench_report_metric(name, "ratio", (double)ncompressed / (double)nbytes);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+void bench_nghttp2_hd_deflate(void) { bench_deflate("hd_deflate", 0); }
+
+void bench_nghttp2_hd_deflate_adaptive(void) {
+  bench_deflate("hd_deflate_adaptive", 1);
+}
+
+/*
+ * Deflates the response header blocks of an API server.  Most of the
+ * header fields are the same in all responses, and only date and
+ * content-length change.  If |use_template| is nonzero, the constant
+ * header fields are deflated from a header template.
+ */
+static void bench_deflate_response(const char *name, int use_template) {
+  nghttp2_mem *mem = nghttp2_mem_default();
+  nghttp2_hd_deflater deflater;
+  nghttp2_hd_template *tmpl = NULL;
+  nghttp2_bufs bufs;
+  nghttp2_nv tmpl_nva[] = {
+      MAKE_NV(":status", "200"),
+      MAKE_NV("server", "nghttpx"),
+      MAKE_NV("content-type", "application/json; charset=utf-8"),
+      MAKE_NV("cache-control", "private, max-age=0, must-revalidate"),
+      MAKE_NV("strict-transport-security",
+              "max-age=31536000; includeSubDomains"),
+      MAKE_NV("x-content-type-options", "nosniff"),
+      MAKE_NV("x-frame-options", "DENY"),
+      MAKE_NV("vary", "accept-encoding"),
+  };
+  nghttp2_nv nva[] = {
+      MAKE_NV("date", ""),
+      MAKE_NV("content-length", ""),
+  };
+  nghttp2_nv full_nva[ARRLEN(tmpl_nva) + ARRLEN(nva)];
+  nghttp2_nv *nva_copy;
+  char date[64], clen[16];
+  size_t i, j, k, nbytes = 0, ncompressed = 0;
+  uint32_t state;
+  uint64_t start, elapsed = 0;
+  int rv;
+
+  nva[0].value = (uint8_t *)date;
+  nva[1].value = (uint8_t *)clen;
+
+  nghttp2_bufs_init(&bufs, 4096, 16, mem);
+
+  for (j = 0; j < HD_DEFLATE_ROUNDS; ++j) {
+    nghttp2_hd_deflate_init(&deflater, mem);
+
+    if (use_template) {
+      nghttp2_nv_array_copy(&nva_copy, tmpl_nva, ARRLEN(tmpl_nva), mem);
+      nghttp2_hd_template_new(&tmpl, &deflater, nva_copy, ARRLEN(tmpl_nva),
+                              mem);
+    }
+
+    state = 2463534242u;
+
+    start = bench_now();
+
+    for (i = 0; i < HD_RESPONSE_NBLOCKS; ++i) {
+      nva[0].valuelen = (size_t)snprintf(
+          date, sizeof(date), "Thu, 15 Oct 2026 07:%02u:%02u GMT",
+          (unsigned int)(i / 600 % 60), (unsigned int)(i / 10 % 60));
+      nva[1].valuelen = (size_t)snprintf(clen, sizeof(clen), "%u",
+                                         hd_rand(&state) % 65536);
+
+      nghttp2_bufs_reset(&bufs);
+
+      if (use_template) {
+        rv = nghttp2_hd_deflate_hd_template_bufs(&deflater, &bufs, tmpl, nva,
+                                                 ARRLEN(nva));
+      } else {
+        /* nghttp2_submit_response copies all header fields */
+        memcpy(full_nva, tmpl_nva, sizeof(tmpl_nva));
+        memcpy(full_nva + ARRLEN(tmpl_nva), nva, sizeof(nva));
+
+        rv = nghttp2_nv_array_copy(&nva_copy, full_nva, ARRLEN(full_nva), mem);
+        if (rv == 0) {
+          rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, nva_copy,
+                                          ARRLEN(full_nva));
+          nghttp2_nv_array_del(nva_copy, mem);
+        }
+      }
+
+      if (rv != 0) {
+        fprintf(stderr, "deflate failed\n");
+        nghttp2_hd_template_decref(tmpl);
+        nghttp2_hd_deflate_free(&deflater);
+        nghttp2_bufs_free(&bufs);
+        return;
+      }
+
+      ncompressed += nghttp2_bufs_len(&bufs);
+
+      for (k = 0; k < ARRLEN(tmpl_nva); ++k) {
+        nbytes += tmpl_nva[k].namelen + tmpl_nva[k].valuelen;
+      }
+      for (k = 0; k < ARRLEN(nva); ++k) {
+        nbytes += nva[k].namelen + nva[k].valuelen;
+      }
+    }
+
+    elapsed += bench_now() - start;
+
+    nghttp2_hd_template_decref(tmpl);
+    tmpl = NULL;
+
+    nghttp2_hd_deflate_free(&deflater);
+  }
+
+  bench_report(name, HD_DEFLATE_ROUNDS * HD_RESPONSE_NBLOCKS, nbytes, elapsed);
+
+  bench_report_metric(name, "ratio", (double)ncompressed / (double)nbytes);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+void bench_nghttp2_hd_deflate_response(void) {
+  bench_deflate_response("hd_deflate_response", 0);
+}
+
+void bench_nghttp2_hd_deflate_response_template(void) {
+  bench_deflate_response("hd_deflate_response_template", 1);
+}
+
+/*
+ * Writes the HPACK integer |n| with |prefix| bits prefix to |p|,
+ * whose first byte has |first| in the bits above the prefix.
+ * Returns the end of written bytes.
+ */
+static uint8_t *hd_put_int(uint8_t *p, uint8_t first, size_t n,
+                           size_t prefix) {
+  size_t k = (size_t)((1 << prefix) - 1);
+
+  if (n < k) {
+    *p++ = (uint8_t)(first | n);
+    return p;
+  }
+
+  *p++ = (uint8_t)(first | k);
+
+  for (n -= k; n >= 128; n >>= 7) {
+    *p++ = (uint8_t)((n & 0x7f) | 0x80);
+  }
+
+  *p++ = (uint8_t)n;
+
+  return p;
+}
+
+/*
+ * Inflates the request header blocks which carry a large bearer token
+ * sent as a never indexed literal without Huffman encoding.  The
+ * inflater passes the value without copying it if |zero_copy| is
+ * nonzero.
+ */
+static void bench_inflate(const char *name, int zero_copy) {
+  nghttp2_mem *mem = nghttp2_mem_default();
+  nghttp2_hd_inflater inflater;
+  nghttp2_hd_nv nv;
+  uint8_t block[2048], *p;
+  size_t i, tokenlen = 1024, blocklen, nbytes = 0;
+  uint64_t start, elapsed;
+  int inflate_flags;
+  ssize_t rv;
+
+  p = block;
+  /* :method: GET, :scheme: https, :path: / */
+  *p++ = 0x82;
+  *p++ = 0x87;
+  *p++ = 0x84;
+  /* authorization: <token>, never indexed, indexed name */
+  p = hd_put_int(p, 0x10, 23, 4);
+  p = hd_put_int(p, 0, tokenlen, 7);
+  for (i = 0; i < tokenlen; ++i) {
+    *p++ = (uint8_t)"0123456789abcdefghijklmnopqrstuv"[i % 32];
+  }
+
+  blocklen = (size_t)(p - block);
+
+  nghttp2_hd_inflate_init(&inflater, mem);
+  nghttp2_hd_inflate_set_zero_copy(&inflater, zero_copy);
+
+  start = bench_now();
+
+  for (i = 0; i < HD_INFLATE_NBLOCKS; ++i) {
+    const uint8_t *in = block;
+    size_t inlen = blocklen;
+
+    for (;;) {
+      rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in, inlen,
+                                    1);
+      if (rv < 0) {
+        fprintf(stderr, "inflate failed\n");
+        nghttp2_hd_inflate_free(&inflater);
+        return;
+      }
+
+      in += rv;
+      inlen -= (size_t)rv;
+
+      if (inflate_flags & NGHTTP2_HD_INFLATE_EMIT) {
+        nbytes += nv.name->len + nv.value->len;
+
+        nghttp2_hd_inflate_unborrow(&inflater);
+      }
+
+      if (inflate_flags & NGHTTP2_HD_INFLATE_FINAL) {
+        nghttp2_hd_inflate_end_headers(&inflater);
+        break;
+      }
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report(name, HD_INFLATE_NBLOCKS, nbytes, elapsed);
+
+  nghttp2_hd_inflate_free(&inflater);
+}
+
+void bench_nghttp2_hd_inflate(void) { bench_inflate("hd_inflate", 0); }
+
+void bench_nghttp2_hd_inflate_zero_copy(void) {
+  bench_inflate("hd_inflate_zero_copy", 1);
+}
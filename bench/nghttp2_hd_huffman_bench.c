@@ -0,0 +1,142 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_hd_huffman_bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nghttp2_hd.h"
+#include "bench_helper.h"
+
+/* Header values which are commonly huffman encoded */
+static const char *huff_corpus[] = {
+    "/",
+    "/index.html",
+    "/api/v1/users/1234567/timeline?since_id=987654321&count=50",
+    "/static/js/main.8f3a2c1e.chunk.js",
+    "/search?q=nghttp2+hpack+huffman&hl=en&source=hp&ei=XzYdW6mZ",
+    "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like "
+    "Gecko) Chrome/68.0.3440.106 Safari/537.36",
+    "Mozilla/5.0 (Macintosh; Intel Mac OS X 10.13; rv:61.0) Gecko/20100101 "
+    "Firefox/61.0",
+    "text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,"
+    "image/apng,*/*;q=0.8",
+    "gzip, deflate, br",
+    "en-US,en;q=0.9,ja;q=0.8",
+    "_ga=GA1.2.1234567890.1530000000; _gid=GA1.2.987654321.1533000000; "
+    "session_id=5f2b6c7d8e9fa0b1c2d3e4f5a6b7c8d9; lang=en; "
+    "theme=dark; csrftoken=Zx9YwVu8TsRq7PoNm6LkJi5HgFe4DcBa",
+    "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZ"
+    "SI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ.SflKxwRJSMeKKF2QT4fwpMeJf36P"
+    "OR6yJV_adQssw5c",
+    "max-age=0, no-cache, no-store, must-revalidate",
+    "Wed, 15 Aug 2018 08:49:37 GMT",
+    "\"5b73e6a1-1d4c\"",
+    "application/grpc+proto",
+};
+
+/* The number of times the whole corpus is decoded */
+#define HUFF_DECODE_ROUNDS 20000
+
+void bench_nghttp2_hd_huff_decode(void) {
+  nghttp2_mem *mem = nghttp2_mem_default();
+  nghttp2_bufs bufs[ARRLEN(huff_corpus)];
+  nghttp2_hd_huff_decode_context ctx;
+  nghttp2_buf outbuf;
+  uint8_t out[1024];
+  size_t i, j, nbytes = 0;
+  uint64_t start, elapsed;
+  ssize_t rv;
+
+  for (i = 0; i < ARRLEN(huff_corpus); ++i) {
+    nghttp2_bufs_init(&bufs[i], 4096, 1, mem);
+    nghttp2_hd_huff_encode(&bufs[i], (const uint8_t *)huff_corpus[i],
+                           strlen(huff_corpus[i]));
+  }
+
+  nghttp2_buf_wrap_init(&outbuf, out, sizeof(out));
+
+  start = bench_now();
+
+  for (j = 0; j < HUFF_DECODE_ROUNDS; ++j) {
+    for (i = 0; i < ARRLEN(huff_corpus); ++i) {
+      nghttp2_buf_reset(&outbuf);
+      nghttp2_hd_huff_decode_context_init(&ctx);
+      rv = nghttp2_hd_huff_decode(&ctx, &outbuf, bufs[i].head->buf.pos,
+                                  nghttp2_buf_len(&bufs[i].head->buf), 1);
+      if (rv < 0) {
+        fprintf(stderr, "huffman decoding failed\n");
+        return;
+      }
+      nbytes += nghttp2_buf_len(&outbuf);
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report("hd_huff_decode", HUFF_DECODE_ROUNDS * ARRLEN(huff_corpus),
+               nbytes, elapsed);
+
+  for (i = 0; i < ARRLEN(huff_corpus); ++i) {
+    nghttp2_bufs_free(&bufs[i]);
+  }
+}
+
+/* The number of times the whole corpus is encoded */
+#define HUFF_ENCODE_ROUNDS 20000
+
+void bench_nghttp2_hd_huff_encode(void) {
+  nghttp2_mem *mem = nghttp2_mem_default();
+  nghttp2_bufs bufs;
+  size_t i, j, nbytes = 0;
+  uint64_t start, elapsed;
+  int rv;
+
+  nghttp2_bufs_init(&bufs, 4096, 1, mem);
+
+  start = bench_now();
+
+  for (j = 0; j < HUFF_ENCODE_ROUNDS; ++j) {
+    for (i = 0; i < ARRLEN(huff_corpus); ++i) {
+      size_t len = strlen(huff_corpus[i]);
+
+      nghttp2_bufs_reset(&bufs);
+      rv = nghttp2_hd_huff_encode(&bufs, (const uint8_t *)huff_corpus[i], len);
+      if (rv != 0) {
+        fprintf(stderr, "huffman encoding failed\n");
+        nghttp2_bufs_free(&bufs);
+        return;
+      }
+      nbytes += len;
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report("hd_huff_encode", HUFF_ENCODE_ROUNDS * ARRLEN(huff_corpus),
+               nbytes, elapsed);
+
+  nghttp2_bufs_free(&bufs);
+}
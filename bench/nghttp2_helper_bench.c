@@ -0,0 +1,99 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_helper_bench.h"
+
+#include <string.h>
+
+#include "nghttp2_helper.h"
+#include "bench_helper.h"
+
+static const char *name_corpus[] = {
+    ":path",
+    "user-agent",
+    "content-type",
+    "accept-encoding",
+    "x-forwarded-for",
+    "access-control-allow-credentials",
+    "x-b3-traceid",
+    "x-envoy-upstream-service-time",
+    "strict-transport-security",
+    "grpc-accept-encoding",
+};
+
+static const char *value_corpus[] = {
+    "/api/v1/users/1234567/timeline?since_id=987654321&count=50",
+    "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like "
+    "Gecko) Chrome/68.0.3440.106 Safari/537.36",
+    "text/html; charset=utf-8",
+    "_ga=GA1.2.1234567890.1530000000; _gid=GA1.2.987654321.1533000000; "
+    "session_id=5f2b6c7d8e9fa0b1c2d3e4f5a6b7c8d9; lang=en; "
+    "theme=dark; csrftoken=Zx9YwVu8TsRq7PoNm6LkJi5HgFe4DcBa",
+    "Bearer eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJzdWIiOiIxMjM0NTY3ODkwIiwi"
+    "bmFtZSI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ.SflKxwRJSMeKKF2QT4fwpMe"
+    "Jf36POR6yJV_adQssw5c",
+    "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01",
+    "max-age=31536000; includeSubDomains; preload",
+    "1024",
+};
+
+/* The number of times the whole corpus is validated */
+#define CHECK_HEADER_ROUNDS 200000
+
+static void bench_check(const char *name, const char **corpus,
+                        size_t ncorpus,
+                        int (*check)(const uint8_t *, size_t)) {
+  size_t i, j, nbytes = 0;
+  uint64_t start, elapsed;
+  int ok = 1;
+
+  start = bench_now();
+
+  for (j = 0; j < CHECK_HEADER_ROUNDS; ++j) {
+    for (i = 0; i < ncorpus; ++i) {
+      size_t len = strlen(corpus[i]);
+
+      ok &= check((const uint8_t *)corpus[i], len);
+      nbytes += len;
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  if (!ok) {
+    return;
+  }
+
+  bench_report(name, CHECK_HEADER_ROUNDS * ncorpus, nbytes, elapsed);
+}
+
+void bench_nghttp2_check_header_name(void) {
+  bench_check("check_header_name", name_corpus, ARRLEN(name_corpus),
+              nghttp2_check_header_name);
+}
+
+void bench_nghttp2_check_header_value(void) {
+  bench_check("check_header_value", value_corpus, ARRLEN(value_corpus),
+              nghttp2_check_header_value);
+}
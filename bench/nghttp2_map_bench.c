@@ -0,0 +1,154 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_map_bench.h"
+
+#include <stdio.h>
+
+#include "nghttp2_map.h"
+#include "bench_helper.h"
+
+/* The number of concurrent streams */
+#define MAP_NSTREAMS 10000
+/* The number of streams opened and closed during benchmark */
+#define MAP_NCHURN 2000000
+/* The number of lookups per stream opened */
+#define MAP_NFIND 8
+
+typedef struct {
+  nghttp2_map_entry map_entry;
+  int32_t stream_id;
+  /* Make the object as large as nghttp2_stream */
+  uint8_t pad[256];
+} map_bench_entry;
+
+static map_bench_entry entries[MAP_NSTREAMS];
+
+/*
+ * Simulates a connection which keeps MAP_NSTREAMS streams open.  Each
+ * iteration closes the oldest stream, opens a new one, and looks up
+ * MAP_NFIND streams, like receiving DATA and WINDOW_UPDATE frames.
+ */
+void bench_nghttp2_map_churn(void) {
+  nghttp2_map map;
+  map_bench_entry *ent;
+  int32_t next_stream_id = 1;
+  uint32_t state = 2463534242u;
+  size_t i, j, nfound = 0;
+  uint64_t start, elapsed;
+
+  nghttp2_map_init(&map, nghttp2_mem_default());
+
+  for (i = 0; i < MAP_NSTREAMS; ++i) {
+    ent = &entries[i];
+    ent->stream_id = next_stream_id;
+    nghttp2_map_entry_init(&ent->map_entry, next_stream_id);
+    nghttp2_map_insert(&map, &ent->map_entry);
+    next_stream_id += 2;
+  }
+
+  start = bench_now();
+
+  for (i = 0; i < MAP_NCHURN; ++i) {
+    ent = &entries[i % MAP_NSTREAMS];
+
+    nghttp2_map_remove(&map, ent->stream_id);
+
+    ent->stream_id = next_stream_id;
+    nghttp2_map_entry_init(&ent->map_entry, next_stream_id);
+    nghttp2_map_insert(&map, &ent->map_entry);
+    next_stream_id += 2;
+
+    for (j = 0; j < MAP_NFIND; ++j) {
+      /* xorshift32 */
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+
+      nfound += nghttp2_map_find(&map, next_stream_id - 2 -
+                                           (int32_t)(state % MAP_NSTREAMS) *
+                                               2) != NULL;
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  if (nfound != (size_t)MAP_NCHURN * MAP_NFIND) {
+    fprintf(stderr, "map_churn: lookup failed\n");
+  }
+
+  bench_report("map_churn", MAP_NCHURN, 0, elapsed);
+
+  nghttp2_map_free(&map);
+}
+
+/* The stride of stream IDs in bench_nghttp2_map_strided */
+#define MAP_STRIDE 65536
+/* The number of lookups in bench_nghttp2_map_strided */
+#define MAP_NSTRIDED_FIND 2000000
+
+/*
+ * Measures lookups of MAP_NSTREAMS streams whose IDs are spaced
+ * MAP_STRIDE apart, as a hostile peer would open them.  A weak hash
+ * puts all of them in a single probe sequence.
+ */
+void bench_nghttp2_map_strided(void) {
+  nghttp2_map map;
+  map_bench_entry *ent;
+  uint32_t state = 2463534242u;
+  size_t i, nfound = 0;
+  uint64_t start, elapsed;
+
+  nghttp2_map_init(&map, nghttp2_mem_default());
+
+  start = bench_now();
+
+  for (i = 0; i < MAP_NSTREAMS; ++i) {
+    ent = &entries[i];
+    ent->stream_id = (int32_t)(1 + i * MAP_STRIDE);
+    nghttp2_map_entry_init(&ent->map_entry, ent->stream_id);
+    nghttp2_map_insert(&map, &ent->map_entry);
+  }
+
+  for (i = 0; i < MAP_NSTRIDED_FIND; ++i) {
+    /* xorshift32 */
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    ent = &entries[state % MAP_NSTREAMS];
+
+    nfound += nghttp2_map_find(&map, ent->stream_id) != NULL;
+  }
+
+  elapsed = bench_now() - start;
+
+  if (nfound != MAP_NSTRIDED_FIND) {
+    fprintf(stderr, "map_strided: lookup failed\n");
+  }
+
+  bench_report("map_strided", MAP_NSTRIDED_FIND, 0, elapsed);
+
+  nghttp2_map_free(&map);
+}
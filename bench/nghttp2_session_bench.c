@@ -0,0 +1,751 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_session_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nghttp2_session.h"
+#include "nghttp2_helper.h"
+#include "bench_helper.h"
+
+/* The number of requests submitted during benchmark */
+#define SESSION_NCHURN 1000000
+
+/* The number of 16KiB records received during benchmark */
+#define SESSION_NRECORDS 100000
+
+#define MAKE_NV(NAME, VALUE)                                                   \
+  {                                                                            \
+    (uint8_t *)(NAME), (uint8_t *)(VALUE), sizeof(NAME) - 1,                   \
+        sizeof(VALUE) - 1, NGHTTP2_NV_FLAG_NONE                                \
+  }
+
+static const nghttp2_nv churn_reqnv[] = {
+    MAKE_NV(":method", "GET"),
+    MAKE_NV(":path", "/api/v1/items"),
+    MAKE_NV(":scheme", "https"),
+    MAKE_NV(":authority", "example.org"),
+    MAKE_NV("accept", "application/json"),
+    MAKE_NV("user-agent", "nghttp2-bench"),
+};
+
+static void drain(nghttp2_session *session) {
+  const uint8_t *data;
+
+  while (nghttp2_session_mem_send(session, &data) > 0)
+    ;
+}
+
+/*
+ * Submits a request, serializes it, and closes its stream, over and
+ * over.  This exercises allocation and deallocation of nghttp2_stream,
+ * nghttp2_outbound_item and the header field array per request.
+ */
+static void session_stream_churn(const char *name,
+                                 const nghttp2_option *option) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  int32_t stream_id;
+  size_t i;
+  uint64_t start, elapsed;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  drain(session);
+
+  start = bench_now();
+
+  for (i = 0; i < SESSION_NCHURN; ++i) {
+    stream_id = nghttp2_submit_request(session, NULL, churn_reqnv,
+                                       ARRLEN(churn_reqnv), NULL, NULL);
+
+    drain(session);
+
+    nghttp2_session_close_stream(session, stream_id, NGHTTP2_NO_ERROR);
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report(name, SESSION_NCHURN, 0, elapsed);
+
+  nghttp2_session_del(session);
+}
+
+void bench_nghttp2_session_stream_churn(void) {
+  session_stream_churn("session_stream_churn", NULL);
+}
+
+void bench_nghttp2_session_stream_churn_nopool(void) {
+  nghttp2_option *option;
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_pool_memory(option, 0);
+
+  session_stream_churn("session_stream_churn_nopool", option);
+
+  nghttp2_option_del(option);
+}
+
+/*
+ * Fills |buf| with a sequence of small DATA, WINDOW_UPDATE and PING
+ * frames, and returns the number of bytes written.
+ */
+static size_t pack_small_frames(uint8_t *buf, size_t buflen) {
+  nghttp2_frame_hd hd;
+  uint8_t *p = buf;
+
+  memset(buf, 0, buflen);
+
+  for (;;) {
+    if ((size_t)(buf + buflen - p) < NGHTTP2_FRAME_HDLEN * 3 + 10 + 4 + 8) {
+      break;
+    }
+
+    nghttp2_frame_hd_init(&hd, 10, NGHTTP2_DATA, NGHTTP2_FLAG_NONE, 1);
+    nghttp2_frame_pack_frame_hd(p, &hd);
+    p += NGHTTP2_FRAME_HDLEN + 10;
+
+    nghttp2_frame_hd_init(&hd, 4, NGHTTP2_WINDOW_UPDATE, NGHTTP2_FLAG_NONE, 0);
+    nghttp2_frame_pack_frame_hd(p, &hd);
+    nghttp2_put_uint32be(p + NGHTTP2_FRAME_HDLEN, 1);
+    p += NGHTTP2_FRAME_HDLEN + 4;
+
+    nghttp2_frame_hd_init(&hd, 8, NGHTTP2_PING, NGHTTP2_FLAG_NONE, 0);
+    nghttp2_frame_pack_frame_hd(p, &hd);
+    p += NGHTTP2_FRAME_HDLEN + 8;
+  }
+
+  return (size_t)(p - buf);
+}
+
+/*
+ * Receives 16KiB records full of small frames.  This exercises the
+ * per frame overhead of nghttp2_session_mem_recv().
+ */
+void bench_nghttp2_session_recv_small_frames(void) {
+  nghttp2_session *client, *server;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_option *option;
+  uint8_t record[16384];
+  size_t recordlen;
+  const uint8_t *data;
+  ssize_t datalen;
+  size_t i;
+  uint64_t start, elapsed;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_no_auto_ping_ack(option, 1);
+
+  nghttp2_session_client_new(&client, &callbacks, NULL);
+  nghttp2_session_server_new2(&server, &callbacks, NULL, option);
+
+  nghttp2_submit_settings(client, NGHTTP2_FLAG_NONE, NULL, 0);
+
+  /* Open stream 1 without END_STREAM, so that it can receive DATA */
+  nghttp2_submit_headers(client, NGHTTP2_FLAG_NONE, -1, NULL, churn_reqnv,
+                         ARRLEN(churn_reqnv), NULL);
+
+  while ((datalen = nghttp2_session_mem_send(client, &data)) > 0) {
+    nghttp2_session_mem_recv(server, data, (size_t)datalen);
+  }
+
+  recordlen = pack_small_frames(record, sizeof(record));
+
+  start = bench_now();
+
+  for (i = 0; i < SESSION_NRECORDS; ++i) {
+    if (nghttp2_session_mem_recv(server, record, recordlen) !=
+            (ssize_t)recordlen ||
+        !nghttp2_session_want_read(server)) {
+      fprintf(stderr, "session_recv_small_frames: mem_recv failed\n");
+      break;
+    }
+
+    /* Send WINDOW_UPDATE to keep the flow control windows open */
+    drain(server);
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report("session_recv_small_frames", SESSION_NRECORDS,
+               SESSION_NRECORDS * recordlen, elapsed);
+
+  nghttp2_session_del(server);
+  nghttp2_session_del(client);
+  nghttp2_option_del(option);
+}
+
+/* The number of bytes in a response body */
+#define SESSION_RESPONSE_LEN (1 << 20)
+
+/* The number of responses sent during benchmark */
+#define SESSION_NRESPONSES 1000
+
+/* The size of the write buffer, which is flushed by one write(2) */
+#define SESSION_WBUFLEN 65536
+
+static const nghttp2_nv response_nv[] = {
+    MAKE_NV(":status", "200"),
+    MAKE_NV("content-type", "application/octet-stream"),
+};
+
+static uint8_t response_body[SESSION_RESPONSE_LEN];
+
+static ssize_t response_read_callback(nghttp2_session *session,
+                                      int32_t stream_id, uint8_t *buf,
+                                      size_t length, uint32_t *data_flags,
+                                      nghttp2_data_source *source,
+                                      void *user_data) {
+  size_t *left = source->ptr;
+  size_t n;
+
+  (void)session;
+  (void)stream_id;
+  (void)user_data;
+
+  n = nghttp2_min(length, *left);
+
+  memcpy(buf, response_body + SESSION_RESPONSE_LEN - *left, n);
+
+  *left -= n;
+
+  if (*left == 0) {
+    *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+  }
+
+  return (ssize_t)n;
+}
+
+/*
+ * Fills |wb| with the frames |session| has to send, the way
+ * applications using nghttp2_session_mem_send() do: a chunk which
+ * does not fit is kept in |*pending| for the next write buffer.
+ * Returns the number of bytes written to |wb|.
+ */
+static size_t fill_wb(nghttp2_session *session, uint8_t *wb,
+                      const uint8_t **pending, size_t *pendinglen) {
+  size_t len = 0;
+  const uint8_t *data;
+  ssize_t datalen;
+
+  if (*pendinglen) {
+    memcpy(wb, *pending, *pendinglen);
+    len = *pendinglen;
+    *pendinglen = 0;
+  }
+
+  for (;;) {
+    datalen = nghttp2_session_mem_send(session, &data);
+    if (datalen <= 0) {
+      break;
+    }
+
+    if (SESSION_WBUFLEN - len < (size_t)datalen) {
+      *pending = data;
+      *pendinglen = (size_t)datalen;
+      break;
+    }
+
+    memcpy(wb + len, data, (size_t)datalen);
+    len += (size_t)datalen;
+  }
+
+  return len;
+}
+
+/*
+ * Serves |SESSION_NRESPONSES| responses of |SESSION_RESPONSE_LEN|
+ * bytes through a |SESSION_WBUFLEN| bytes write buffer.  If |batch|
+ * is nonzero, nghttp2_session_mem_send_batch() fills the write
+ * buffer.  Otherwise, chunks returned by nghttp2_session_mem_send()
+ * are copied into it.  Each flush of the write buffer stands for one
+ * write(2).
+ */
+static void session_send_response(const char *name, int batch) {
+  nghttp2_session *client, *server;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_settings_entry iv;
+  nghttp2_data_provider data_prd;
+  static uint8_t wb[SESSION_WBUFLEN];
+  const uint8_t *data;
+  const uint8_t *pending = NULL;
+  size_t pendinglen = 0;
+  ssize_t datalen;
+  size_t left;
+  size_t len;
+  size_t nwrites = 0;
+  size_t i;
+  int32_t stream_id;
+  uint64_t start, elapsed;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  memset(response_body, 'a', sizeof(response_body));
+
+  nghttp2_session_client_new(&client, &callbacks, NULL);
+  nghttp2_session_server_new(&server, &callbacks, NULL);
+
+  iv.settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  iv.value = NGHTTP2_MAX_WINDOW_SIZE;
+
+  nghttp2_submit_settings(client, NGHTTP2_FLAG_NONE, &iv, 1);
+  nghttp2_session_set_local_window_size(client, NGHTTP2_FLAG_NONE, 0,
+                                        NGHTTP2_MAX_WINDOW_SIZE);
+
+  data_prd.source.ptr = &left;
+  data_prd.read_callback = response_read_callback;
+
+  elapsed = 0;
+
+  for (i = 0; i < SESSION_NRESPONSES; ++i) {
+    stream_id = nghttp2_submit_request(client, NULL, churn_reqnv,
+                                       ARRLEN(churn_reqnv), NULL, NULL);
+
+    while ((datalen = nghttp2_session_mem_send(client, &data)) > 0) {
+      nghttp2_session_mem_recv(server, data, (size_t)datalen);
+    }
+
+    /* The response is not received by client. */
+    nghttp2_session_close_stream(client, stream_id, NGHTTP2_NO_ERROR);
+
+    left = SESSION_RESPONSE_LEN;
+
+    nghttp2_submit_response(server, stream_id, response_nv,
+                            ARRLEN(response_nv), &data_prd);
+
+    start = bench_now();
+
+    for (;;) {
+      if (batch) {
+        datalen = nghttp2_session_mem_send_batch(server, wb, sizeof(wb));
+        len = datalen > 0 ? (size_t)datalen : 0;
+      } else {
+        len = fill_wb(server, wb, &pending, &pendinglen);
+      }
+
+      if (len == 0) {
+        break;
+      }
+
+      ++nwrites;
+    }
+
+    elapsed += bench_now() - start;
+
+    if (left) {
+      fprintf(stderr, "%s: response was not sent\n", name);
+      break;
+    }
+  }
+
+  bench_report(name, nwrites,
+               (size_t)SESSION_NRESPONSES * SESSION_RESPONSE_LEN, elapsed);
+  bench_report_metric(name, "writes_per_mib",
+                      (double)nwrites / SESSION_NRESPONSES /
+                          (SESSION_RESPONSE_LEN / (1024 * 1024)));
+
+  nghttp2_session_del(server);
+  nghttp2_session_del(client);
+}
+
+void bench_nghttp2_session_send_response(void) {
+  session_send_response("session_send_response", 0);
+}
+
+void bench_nghttp2_session_send_response_batch(void) {
+  session_send_response("session_send_response_batch", 1);
+}
+
+/* The number of requests per SETTINGS_MAX_CONCURRENT_STREAMS in
+   session_retained_streams */
+#define SESSION_RETAINED_ROUNDS 100
+
+/*
+ * Feeds the frames |src| has to send to |dst|, and returns the number
+ * of bytes fed.
+ */
+static size_t exchange(nghttp2_session *src, nghttp2_session *dst) {
+  const uint8_t *data;
+  ssize_t datalen;
+  size_t nbytes = 0;
+
+  while ((datalen = nghttp2_session_mem_send(src, &data)) > 0) {
+    nghttp2_session_mem_recv(dst, data, (size_t)datalen);
+    nbytes += (size_t)datalen;
+  }
+
+  return nbytes;
+}
+
+static int retained_on_frame_recv_callback(nghttp2_session *session,
+                                           const nghttp2_frame *frame,
+                                           void *user_data) {
+  (void)user_data;
+
+  if (frame->hd.type == NGHTTP2_HEADERS &&
+      frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+    nghttp2_submit_response(session, frame->hd.stream_id, response_nv,
+                            ARRLEN(response_nv), NULL);
+  }
+
+  return 0;
+}
+
+/*
+ * Runs requests one after another against a server which advertises
+ * |max_concurrent_streams|, and reports the memory held by the server
+ * session, which is dominated by the closed streams it retains for the
+ * priority tree.
+ */
+static void session_retained_streams(const char *name,
+                                     uint32_t max_concurrent_streams,
+                                     int compact) {
+  nghttp2_session *client, *server;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_option *option;
+  nghttp2_settings_entry iv;
+  size_t i, n;
+  uint64_t start, elapsed;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  nghttp2_session_client_new(&client, &callbacks, NULL);
+
+  callbacks.on_frame_recv_callback = retained_on_frame_recv_callback;
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_session_memory(option, SIZE_MAX);
+  nghttp2_option_set_compact_retained_streams(option, compact);
+
+  nghttp2_session_server_new2(&server, &callbacks, NULL, option);
+
+  iv.settings_id = NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  iv.value = max_concurrent_streams;
+
+  nghttp2_submit_settings(client, NGHTTP2_FLAG_NONE, NULL, 0);
+  nghttp2_submit_settings(server, NGHTTP2_FLAG_NONE, &iv, 1);
+
+  exchange(client, server);
+  exchange(server, client);
+  exchange(client, server);
+
+  n = (size_t)max_concurrent_streams * SESSION_RETAINED_ROUNDS;
+
+  start = bench_now();
+
+  for (i = 0; i < n; ++i) {
+    nghttp2_submit_request(client, NULL, churn_reqnv, ARRLEN(churn_reqnv),
+                           NULL, NULL);
+
+    exchange(client, server);
+    exchange(server, client);
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report(name, n, 0, elapsed);
+  bench_report_metric(name, "memory_bytes",
+                      (double)nghttp2_session_get_memory_usage(server));
+  bench_report_metric(
+      name, "closed_streams",
+      (double)(server->num_closed_streams +
+               server->compact_closed_streams.len));
+
+  nghttp2_session_del(server);
+  nghttp2_session_del(client);
+  nghttp2_option_del(option);
+}
+
+void bench_nghttp2_session_retained_streams(void) {
+  session_retained_streams("session_retained_100", 100, 0);
+  session_retained_streams("session_retained_1000", 1000, 0);
+}
+
+void bench_nghttp2_session_retained_streams_compact(void) {
+  session_retained_streams("session_retained_compact_100", 100, 1);
+  session_retained_streams("session_retained_compact_1000", 1000, 1);
+}
+
+/* The number of response body bytes transferred by each
+   session_transfer benchmark */
+#define SESSION_TRANSFER_TOTAL (64 << 20)
+
+typedef struct {
+  /* The length of a response body */
+  size_t datalen;
+  /* The number of concurrent streams */
+  size_t nstreams;
+  /* The number of bytes left to send, indexed by stream */
+  size_t *left;
+  /* The number of streams closed by client */
+  size_t nclosed;
+} transfer_context;
+
+static size_t *transfer_left(transfer_context *ctx, int32_t stream_id) {
+  /* The streams of a round have consecutive odd stream IDs. */
+  return &ctx->left[(size_t)(stream_id - 1) / 2 % ctx->nstreams];
+}
+
+static ssize_t transfer_read_callback(nghttp2_session *session,
+                                      int32_t stream_id, uint8_t *buf,
+                                      size_t length, uint32_t *data_flags,
+                                      nghttp2_data_source *source,
+                                      void *user_data) {
+  transfer_context *ctx = user_data;
+  size_t *left = transfer_left(ctx, stream_id);
+  size_t n;
+
+  (void)session;
+  (void)source;
+
+  n = nghttp2_min(length, *left);
+
+  memcpy(buf, response_body + ctx->datalen - *left, n);
+
+  *left -= n;
+
+  if (*left == 0) {
+    *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+  }
+
+  return (ssize_t)n;
+}
+
+static int transfer_on_frame_recv_callback(nghttp2_session *session,
+                                           const nghttp2_frame *frame,
+                                           void *user_data) {
+  transfer_context *ctx = user_data;
+  nghttp2_data_provider data_prd;
+
+  if (frame->hd.type != NGHTTP2_HEADERS ||
+      frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+    return 0;
+  }
+
+  *transfer_left(ctx, frame->hd.stream_id) = ctx->datalen;
+
+  data_prd.source.ptr = NULL;
+  data_prd.read_callback = transfer_read_callback;
+
+  nghttp2_submit_response(session, frame->hd.stream_id, response_nv,
+                          ARRLEN(response_nv), &data_prd);
+
+  return 0;
+}
+
+static int transfer_on_stream_close_callback(nghttp2_session *session,
+                                             int32_t stream_id,
+                                             uint32_t error_code,
+                                             void *user_data) {
+  transfer_context *ctx = user_data;
+
+  (void)session;
+  (void)stream_id;
+  (void)error_code;
+
+  ++ctx->nclosed;
+
+  return 0;
+}
+
+/*
+ * Runs full client-server exchanges through nghttp2_session_mem_send()
+ * and nghttp2_session_mem_recv(): client sends |nstreams| requests at
+ * once, and server answers each of them with |datalen| bytes of
+ * DATA, until |SESSION_TRANSFER_TOTAL| bytes are transferred.  Client
+ * uses the flow control windows browsers commonly advertise, so that
+ * WINDOW_UPDATE is part of the loop.
+ */
+static void session_transfer(const char *name, size_t nstreams,
+                             size_t datalen) {
+  nghttp2_session *client, *server;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_settings_entry iv;
+  transfer_context client_ctx, server_ctx;
+  size_t i, j, nrounds;
+  uint64_t start, elapsed;
+
+  memset(response_body, 'a', sizeof(response_body));
+
+  memset(&client_ctx, 0, sizeof(client_ctx));
+  memset(&server_ctx, 0, sizeof(server_ctx));
+  server_ctx.datalen = datalen;
+  server_ctx.nstreams = nstreams;
+  server_ctx.left = malloc(nstreams * sizeof(size_t));
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_stream_close_callback = transfer_on_stream_close_callback;
+
+  nghttp2_session_client_new(&client, &callbacks, &client_ctx);
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_frame_recv_callback = transfer_on_frame_recv_callback;
+
+  nghttp2_session_server_new(&server, &callbacks, &server_ctx);
+
+  iv.settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  iv.value = 6 * 1024 * 1024;
+
+  nghttp2_submit_settings(client, NGHTTP2_FLAG_NONE, &iv, 1);
+  nghttp2_session_set_local_window_size(client, NGHTTP2_FLAG_NONE, 0,
+                                        15 * 1024 * 1024);
+  nghttp2_submit_settings(server, NGHTTP2_FLAG_NONE, NULL, 0);
+
+  nrounds = nghttp2_max(SESSION_TRANSFER_TOTAL / (nstreams * datalen), 1);
+
+  start = bench_now();
+
+  for (i = 0; i < nrounds; ++i) {
+    for (j = 0; j < nstreams; ++j) {
+      nghttp2_submit_request(client, NULL, churn_reqnv, ARRLEN(churn_reqnv),
+                             NULL, NULL);
+    }
+
+    client_ctx.nclosed = 0;
+
+    while (client_ctx.nclosed < nstreams) {
+      if (exchange(client, server) + exchange(server, client) == 0) {
+        break;
+      }
+    }
+
+    if (client_ctx.nclosed < nstreams) {
+      fprintf(stderr, "%s: responses were not received\n", name);
+      break;
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  bench_report(name, nrounds * nstreams, nrounds * nstreams * datalen,
+               elapsed);
+
+  nghttp2_session_del(server);
+  nghttp2_session_del(client);
+  free(server_ctx.left);
+}
+
+void bench_nghttp2_session_transfer(void) {
+  session_transfer("session_transfer_1x1k", 1, 1024);
+  session_transfer("session_transfer_100x1k", 100, 1024);
+  session_transfer("session_transfer_1x16k", 1, 16384);
+  session_transfer("session_transfer_100x16k", 100, 16384);
+  session_transfer("session_transfer_1x1m", 1, 1 << 20);
+  session_transfer("session_transfer_10x1m", 10, 1 << 20);
+}
+
+/* The number of DATA frames sent by each session_flat_tree
+   benchmark */
+#define SESSION_FLAT_TREE_NFRAMES 1000000
+
+static ssize_t flat_tree_send_callback(nghttp2_session *session,
+                                       const uint8_t *data, size_t length,
+                                       int flags, void *user_data) {
+  (void)session;
+  (void)data;
+  (void)flags;
+  (void)user_data;
+
+  return (ssize_t)length;
+}
+
+static ssize_t flat_tree_read_callback(nghttp2_session *session,
+                                       int32_t stream_id, uint8_t *buf,
+                                       size_t length, uint32_t *data_flags,
+                                       nghttp2_data_source *source,
+                                       void *user_data) {
+  (void)session;
+  (void)stream_id;
+  (void)buf;
+  (void)data_flags;
+  (void)source;
+  (void)user_data;
+
+  /* Small frames make the scheduler dominate. */
+  return (ssize_t)nghttp2_min(length, 64);
+}
+
+/*
+ * Sends DATA frames from |nstreams| streams which all depend on the
+ * root, the tree modern clients build, and never finish.  This
+ * measures picking the next stream and rescheduling it per frame.
+ */
+static void session_flat_tree(const char *name, size_t nstreams) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_data_provider data_prd;
+  nghttp2_stream *stream;
+  nghttp2_priority_spec pri_spec;
+  int32_t stream_id;
+  size_t i;
+  uint64_t start, elapsed;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = flat_tree_send_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  data_prd.source.ptr = NULL;
+  data_prd.read_callback = flat_tree_read_callback;
+
+  for (i = 0; i < nstreams; ++i) {
+    stream_id = (int32_t)(i * 2 + 1);
+
+    nghttp2_priority_spec_init(&pri_spec, 0, NGHTTP2_DEFAULT_WEIGHT, 0);
+
+    stream = nghttp2_session_open_stream(session, stream_id,
+                                         NGHTTP2_STREAM_FLAG_NONE, &pri_spec,
+                                         NGHTTP2_STREAM_OPENED, NULL);
+    stream->remote_window_size = NGHTTP2_MAX_WINDOW_SIZE;
+    session->last_recv_stream_id = stream_id;
+
+    nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, stream_id, &data_prd);
+  }
+
+  session->remote_window_size = SESSION_FLAT_TREE_NFRAMES * 64;
+
+  start = bench_now();
+
+  nghttp2_session_send(session);
+
+  elapsed = bench_now() - start;
+
+  bench_report(name, SESSION_FLAT_TREE_NFRAMES,
+               (size_t)SESSION_FLAT_TREE_NFRAMES * 64, elapsed);
+
+  nghttp2_session_del(session);
+}
+
+void bench_nghttp2_session_flat_tree(void) {
+  session_flat_tree("session_flat_tree_10", 10);
+  session_flat_tree("session_flat_tree_100", 100);
+  session_flat_tree("session_flat_tree_1000", 1000);
+  session_flat_tree("session_flat_tree_10000", 10000);
+}
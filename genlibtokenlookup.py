@@ -67,6 +67,7 @@ HEADERS = [
     ('keep-alive',None),
     ('proxy-connection', None),
     ('upgrade', None),
+    ('priority', None),
 ]
 
 def to_enum_hd(k):
@@ -175,6 +175,9 @@ OPTIONS = [
     "tls13-ciphers",
     "tls13-client-ciphers",
     "no-strip-incoming-early-data",
+    "frontend-reuseport",
+    "frontend-reuseport-cbpf",
+    "worker-accept-batch",
 ]
 
 LOGVARS = [
@@ -10,6 +10,7 @@ import (
 	"io"
 	"net/http"
 	"regexp"
+	"sync/atomic"
 	"syscall"
 	"testing"
 	"time"
@@ -215,6 +216,44 @@ func TestH1H1GracefulShutdown(t *testing.T) {
 	}
 }
 
+// TestH1H1FrontendReuseport tests that worker threads accept
+// connections from their own SO_REUSEPORT listening sockets.
+func TestH1H1FrontendReuseport(t *testing.T) {
+	st := newServerTester([]string{"--frontend-reuseport", "--workers=2"}, t, noopHandler)
+	defer st.Close()
+
+	for i := 0; i < 2; i++ {
+		res, err := st.http1(requestParam{
+			name: fmt.Sprintf("TestH1H1FrontendReuseport-%v", i),
+		})
+		if err != nil {
+			t.Fatalf("Error st.http1() = %v", err)
+		}
+
+		if got, want := res.status, 200; got != want {
+			t.Errorf("status: %v; want %v", got, want)
+		}
+	}
+}
+
+// TestH1H1FrontendReuseportCBPF tests that connections are accepted
+// when the classic BPF program steers them to worker threads.
+func TestH1H1FrontendReuseportCBPF(t *testing.T) {
+	st := newServerTester([]string{"--frontend-reuseport", "--frontend-reuseport-cbpf", "--workers=2"}, t, noopHandler)
+	defer st.Close()
+
+	res, err := st.http1(requestParam{
+		name: "TestH1H1FrontendReuseportCBPF",
+	})
+	if err != nil {
+		t.Fatalf("Error st.http1() = %v", err)
+	}
+
+	if got, want := res.status, 200; got != want {
+		t.Errorf("status: %v; want %v", got, want)
+	}
+}
+
 // TestH1H1HostRewrite tests that server rewrites Host header field
 func TestH1H1HostRewrite(t *testing.T) {
 	st := newServerTester([]string{"--host-rewrite"}, t, func(w http.ResponseWriter, r *http.Request) {
@@ -625,6 +664,99 @@ func TestH1H1HTTPSRedirectPort(t *testing.T) {
 	}
 }
 
+// TestH1H1RetryOn503 tests that nghttpx retries idempotent request
+// if backend responds with 503.
+func TestH1H1RetryOn503(t *testing.T) {
+	var n int32
+	st := newServerTester([]string{"--retry"}, t, func(w http.ResponseWriter, r *http.Request) {
+		if atomic.AddInt32(&n, 1) == 1 {
+			w.WriteHeader(http.StatusServiceUnavailable)
+		}
+	})
+	defer st.Close()
+
+	res, err := st.http1(requestParam{
+		name: "TestH1H1RetryOn503",
+	})
+	if err != nil {
+		t.Fatalf("Error st.http1() = %v", err)
+	}
+
+	if got, want := res.status, 200; got != want {
+		t.Errorf("status: %v; want %v", got, want)
+	}
+
+	if got, want := atomic.LoadInt32(&n), int32(2); got != want {
+		t.Errorf("the number of backend requests: %v; want %v", got, want)
+	}
+}
+
+// TestH1H1RetryOnReset tests that nghttpx retries idempotent request
+// if backend closes connection without sending response.
+func TestH1H1RetryOnReset(t *testing.T) {
+	var n int32
+	st := newServerTester([]string{"--retry"}, t, func(w http.ResponseWriter, r *http.Request) {
+		if atomic.AddInt32(&n, 1) > 1 {
+			return
+		}
+		hj, ok := w.(http.Hijacker)
+		if !ok {
+			http.Error(w, "Could not hijack the connection", http.StatusInternalServerError)
+			return
+		}
+		conn, _, err := hj.Hijack()
+		if err != nil {
+			http.Error(w, err.Error(), http.StatusInternalServerError)
+			return
+		}
+		conn.Close()
+	})
+	defer st.Close()
+
+	res, err := st.http1(requestParam{
+		name: "TestH1H1RetryOnReset",
+	})
+	if err != nil {
+		t.Fatalf("Error st.http1() = %v", err)
+	}
+
+	if got, want := res.status, 200; got != want {
+		t.Errorf("status: %v; want %v", got, want)
+	}
+
+	if got, want := atomic.LoadInt32(&n), int32(2); got != want {
+		t.Errorf("the number of backend requests: %v; want %v", got, want)
+	}
+}
+
+// TestH1H1NoRetryPOST tests that nghttpx does not retry POST
+// request.
+func TestH1H1NoRetryPOST(t *testing.T) {
+	var n int32
+	st := newServerTester([]string{"--retry"}, t, func(w http.ResponseWriter, r *http.Request) {
+		atomic.AddInt32(&n, 1)
+		w.WriteHeader(http.StatusServiceUnavailable)
+	})
+	defer st.Close()
+
+	res, err := st.http1(requestParam{
+		name:   "TestH1H1NoRetryPOST",
+		method: "POST",
+		body:   []byte("foo"),
+	})
+	if err != nil {
+		t.Fatalf("Error st.http1() = %v", err)
+	}
+
+	if got, want := res.status, 503; got != want {
+		t.Errorf("status: %v; want %v", got, want)
+	}
+
+	if got, want := atomic.LoadInt32(&n), int32(1); got != want {
+		t.Errorf("the number of backend requests: %v; want %v", got, want)
+	}
+}
+
 // // TestH1H2ConnectFailure tests that server handles the situation that
 // // connection attempt to HTTP/2 backend failed.
 // func TestH1H2ConnectFailure(t *testing.T) {
@@ -12,6 +12,7 @@ import (
 	"net/http"
 	"regexp"
 	"strings"
+	"sync/atomic"
 	"syscall"
 	"testing"
 	"time"
@@ -1832,6 +1833,71 @@ func TestH2H1GracefulShutdown(t *testing.T) {
 	}
 }
 
+// TestH2H1RetryOn503 tests that nghttpx retries idempotent request
+// if backend responds with 503.
+func TestH2H1RetryOn503(t *testing.T) {
+	var n int32
+	st := newServerTester([]string{"--retry"}, t, func(w http.ResponseWriter, r *http.Request) {
+		if atomic.AddInt32(&n, 1) == 1 {
+			w.WriteHeader(http.StatusServiceUnavailable)
+		}
+	})
+	defer st.Close()
+
+	res, err := st.http2(requestParam{
+		name: "TestH2H1RetryOn503",
+	})
+	if err != nil {
+		t.Fatalf("Error st.http2() = %v", err)
+	}
+
+	if got, want := res.status, 200; got != want {
+		t.Errorf("status = %v; want %v", got, want)
+	}
+
+	if got, want := atomic.LoadInt32(&n), int32(2); got != want {
+		t.Errorf("the number of backend requests = %v; want %v", got, want)
+	}
+}
+
+// TestH2H1RetryOnReset tests that nghttpx retries idempotent request
+// if backend closes connection without sending response.
+func TestH2H1RetryOnReset(t *testing.T) {
+	var n int32
+	st := newServerTester([]string{"--retry"}, t, func(w http.ResponseWriter, r *http.Request) {
+		if atomic.AddInt32(&n, 1) > 1 {
+			return
+		}
+		hj, ok := w.(http.Hijacker)
+		if !ok {
+			http.Error(w, "Could not hijack the connection", http.StatusInternalServerError)
+			return
+		}
+		conn, _, err := hj.Hijack()
+		if err != nil {
+			http.Error(w, err.Error(), http.StatusInternalServerError)
+			return
+		}
+		conn.Close()
+	})
+	defer st.Close()
+
+	res, err := st.http2(requestParam{
+		name: "TestH2H1RetryOnReset",
+	})
+	if err != nil {
+		t.Fatalf("Error st.http2() = %v", err)
+	}
+
+	if got, want := res.status, 200; got != want {
+		t.Errorf("status = %v; want %v", got, want)
+	}
+
+	if got, want := atomic.LoadInt32(&n), int32(2); got != want {
+		t.Errorf("the number of backend requests = %v; want %v", got, want)
+	}
+}
+
 // TestH2H2MultipleResponseCL tests that server returns error if
 // multiple Content-Length response header fields are received.
 func TestH2H2MultipleResponseCL(t *testing.T) {
@@ -98,7 +98,7 @@ func newServerTesterInternal(src_args []string, t *testing.T, handler http.Handl
 
 	args := []string{}
 
-	var backendTLS, dns, externalDNS, acceptProxyProtocol, redirectIfNotTLS, affinityCookie, alpnH1 bool
+	var backendTLS, dns, externalDNS, acceptProxyProtocol, redirectIfNotTLS, affinityCookie, alpnH1, retry bool
 
 	for _, k := range src_args {
 		switch k {
@@ -117,6 +117,8 @@ func newServerTesterInternal(src_args []string, t *testing.T, handler http.Handl
 			affinityCookie = true
 		case "--alpn-h1":
 			alpnH1 = true
+		case "--retry":
+			retry = true
 		default:
 			args = append(args, k)
 		}
@@ -173,6 +175,10 @@ func newServerTesterInternal(src_args []string, t *testing.T, handler http.Handl
 		b += ";affinity=cookie;affinity-cookie-name=affinity;affinity-cookie-path=/foo/bar"
 	}
 
+	if retry {
+		b += ";retry=1"
+	}
+
 	noTLS := ";no-tls"
 	if frontendTLS {
 		noTLS = ""
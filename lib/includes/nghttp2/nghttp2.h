@@ -559,6 +559,31 @@ typedef struct {
   uint8_t flags;
 } nghttp2_nv;
 
+/**
+ * @enum
+ *
+ * The HPACK representation used to encode a header field.  This is
+ * used by :type:`nghttp2_select_hd_indexing_callback` and
+ * :type:`nghttp2_hd_deflate_indexing_callback`.
+ */
+typedef enum {
+  /**
+   * The header field is added to the dynamic table ("Literal Header
+   * Field with Incremental Indexing" representation).
+   */
+  NGHTTP2_HD_INDEXING_INCREMENTAL = 0,
+  /**
+   * The header field is not added to the dynamic table ("Literal
+   * Header Field without Indexing" representation).
+   */
+  NGHTTP2_HD_INDEXING_NONE = 1,
+  /**
+   * The header field is never indexed, even by intermediaries
+   * ("Literal Header Field Never Indexed" representation).
+   */
+  NGHTTP2_HD_INDEXING_NEVER = 2
+} nghttp2_hd_indexing;
+
 /**
  * @enum
  *
@@ -616,7 +641,12 @@ typedef enum {
    * The ORIGIN frame, which is defined by `RFC 8336
    * <https://tools.ietf.org/html/rfc8336>`_.
    */
-  NGHTTP2_ORIGIN = 0x0c
+  NGHTTP2_ORIGIN = 0x0c,
+  /**
+   * The PRIORITY_UPDATE frame, which is defined by `RFC 9218
+   * <https://tools.ietf.org/html/rfc9218>`_.
+   */
+  NGHTTP2_PRIORITY_UPDATE = 0x10
 } nghttp2_frame_type;
 
 /**
@@ -680,7 +710,12 @@ typedef enum {
   /**
    * SETTINGS_MAX_HEADER_LIST_SIZE
    */
-  NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x06
+  NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x06,
+  /**
+   * SETTINGS_NO_RFC7540_PRIORITIES (`RFC 9218
+   * <https://tools.ietf.org/html/rfc9218>`_)
+   */
+  NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES = 0x09
 } nghttp2_settings_id;
 /* Note: If we add SETTINGS, update the capacity of
    NGHTTP2_INBOUND_NUM_IV as well */
@@ -836,7 +871,9 @@ typedef enum {
   NGHTTP2_DATA_FLAG_NO_END_STREAM = 0x02,
   /**
    * Indicates that application will send complete DATA frame in
-   * :type:`nghttp2_send_data_callback`.
+   * :type:`nghttp2_send_data_callback`, or pass the data by
+   * reference in :type:`nghttp2_get_data_ref_callback` if
+   * `nghttp2_session_mem_sendv()` is used.
    */
   NGHTTP2_DATA_FLAG_NO_COPY = 0x04
 } nghttp2_data_flag;
@@ -1840,6 +1877,35 @@ typedef ssize_t (*nghttp2_select_padding_callback)(nghttp2_session *session,
                                                    size_t max_payloadlen,
                                                    void *user_data);
 
+/**
+ * @functypedef
+ *
+ * Callback function invoked when the library encodes the header field
+ * |nv| and asks application which HPACK representation should be
+ * used for it.  The |suggested| is the representation the library
+ * would use on its own, taking into account
+ * `nghttp2_option_set_hd_adaptive_indexing()`.  The implementation
+ * of this function must return one of :type:`nghttp2_hd_indexing`.
+ * Returning |suggested| keeps the library's decision.
+ *
+ * This callback is not invoked for a header field which has
+ * :enum:`NGHTTP2_NV_FLAG_NO_INDEX` set.  Even if a header field is
+ * found in the static or dynamic table, returning
+ * :enum:`NGHTTP2_HD_INDEXING_NEVER` makes it encoded as a literal.
+ *
+ * Returning any other value, including
+ * :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`, will make
+ * `nghttp2_session_send()` and `nghttp2_session_mem_send()` functions
+ * immediately return :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`.
+ *
+ * To set this callback to :type:`nghttp2_session_callbacks`, use
+ * `nghttp2_session_callbacks_set_select_hd_indexing_callback()`.
+ */
+typedef int (*nghttp2_select_hd_indexing_callback)(nghttp2_session *session,
+                                                   const nghttp2_nv *nv,
+                                                   int suggested,
+                                                   void *user_data);
+
 /**
  * @functypedef
  *
@@ -2043,6 +2109,87 @@ typedef int (*nghttp2_error_callback2)(nghttp2_session *session,
                                        int lib_error_code, const char *msg,
                                        size_t len, void *user_data);
 
+/**
+ * @functypedef
+ *
+ * Callback function invoked by `nghttp2_session_mem_sendv()` when
+ * :enum:`NGHTTP2_DATA_FLAG_NO_COPY` is used in
+ * :type:`nghttp2_data_source_read_callback`.
+ *
+ * The |frame| is a DATA frame to send.  The |length| is the length of
+ * application data to send (this does not include padding).  The
+ * |source| is the same pointer passed to
+ * :type:`nghttp2_data_source_read_callback`.
+ *
+ * The application must assign the pointer to |length| bytes of
+ * application data to |*pdata|.  The library does not copy the data;
+ * it is returned by reference from `nghttp2_session_mem_sendv()`.
+ * The data must stay valid and unmodified until
+ * :type:`nghttp2_on_data_ref_release_callback` is invoked for it.
+ *
+ * If all went well, return 0.  If application decided to reset this
+ * stream, return :enum:`NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE`, then
+ * the library will send RST_STREAM with INTERNAL_ERROR as error code.
+ * Returning any other value is treated as
+ * :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`, which will result in
+ * connection closure.
+ */
+typedef int (*nghttp2_get_data_ref_callback)(nghttp2_session *session,
+                                             nghttp2_frame *frame,
+                                             size_t length,
+                                             const uint8_t **pdata,
+                                             nghttp2_data_source *source,
+                                             void *user_data);
+
+/**
+ * @functypedef
+ *
+ * Callback function invoked when the library no longer refers to the
+ * application data which was obtained by
+ * :type:`nghttp2_get_data_ref_callback`.  The |stream_id| is the
+ * stream the data was sent to, and the |data| and |length| are the
+ * values handed out by :type:`nghttp2_get_data_ref_callback`.  The
+ * stream may have been closed already.
+ *
+ * This callback is invoked on the next call of
+ * `nghttp2_session_mem_sendv()`, `nghttp2_session_mem_send()`, or
+ * `nghttp2_session_send()`, by which time the application must have
+ * written or copied the previous batch.  It is also invoked from
+ * `nghttp2_session_del()`.
+ *
+ * The implementation of this function must return 0 if it succeeds.
+ * If nonzero value is returned, it is treated as fatal error and
+ * the send functions return :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`.
+ * The return value is ignored in `nghttp2_session_del()`.
+ */
+typedef int (*nghttp2_on_data_ref_release_callback)(nghttp2_session *session,
+                                                    int32_t stream_id,
+                                                    const uint8_t *data,
+                                                    size_t length,
+                                                    void *user_data);
+
+/**
+ * @functypedef
+ *
+ * Callback function invoked when an operation is enqueued by
+ * `nghttp2_session_enqueue_data()`,
+ * `nghttp2_session_enqueue_resume_data()` or
+ * `nghttp2_session_enqueue_rst_stream()` while the submission queue
+ * of |session| is empty.  The |user_data| pointer is the third
+ * argument passed in to the call to `nghttp2_session_client_new()`
+ * or `nghttp2_session_server_new()`.
+ *
+ * Unlike the other callbacks, this callback is invoked by the thread
+ * which enqueued the operation.  The implementation of this function
+ * must be thread-safe, and must not call any function of the
+ * library.  It should only wake up the thread owning |session|, for
+ * example with ``eventfd(2)`` or ``ev_async_send()``, which then calls
+ * `nghttp2_session_send()`, `nghttp2_session_mem_send()` or similar
+ * function to carry out the queued operations.
+ */
+typedef void (*nghttp2_submission_wakeup_callback)(nghttp2_session *session,
+                                                   void *user_data);
+
 struct nghttp2_session_callbacks;
 
 /**
@@ -2240,6 +2387,17 @@ NGHTTP2_EXTERN void nghttp2_session_callbacks_set_select_padding_callback(
     nghttp2_session_callbacks *cbs,
     nghttp2_select_padding_callback select_padding_callback);
 
+/**
+ * @function
+ *
+ * Sets callback function invoked when the library asks application
+ * which HPACK representation is used to encode the given header
+ * field.
+ */
+NGHTTP2_EXTERN void nghttp2_session_callbacks_set_select_hd_indexing_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_select_hd_indexing_callback select_hd_indexing_callback);
+
 /**
  * @function
  *
@@ -2331,6 +2489,39 @@ NGHTTP2_EXTERN void nghttp2_session_callbacks_set_error_callback(
 NGHTTP2_EXTERN void nghttp2_session_callbacks_set_error_callback2(
     nghttp2_session_callbacks *cbs, nghttp2_error_callback2 error_callback2);
 
+/**
+ * @function
+ *
+ * Sets callback function invoked by `nghttp2_session_mem_sendv()`
+ * when :enum:`NGHTTP2_DATA_FLAG_NO_COPY` is used in
+ * :type:`nghttp2_data_source_read_callback` to pass application data
+ * by reference.
+ */
+NGHTTP2_EXTERN void nghttp2_session_callbacks_set_get_data_ref_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_get_data_ref_callback get_data_ref_callback);
+
+/**
+ * @function
+ *
+ * Sets callback function invoked when the library no longer refers
+ * to the application data obtained by
+ * :type:`nghttp2_get_data_ref_callback`.
+ */
+NGHTTP2_EXTERN void nghttp2_session_callbacks_set_on_data_ref_release_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_on_data_ref_release_callback on_data_ref_release_callback);
+
+/**
+ * @function
+ *
+ * Sets callback function invoked when the submission queue enabled
+ * by `nghttp2_option_set_submission_queue()` becomes non-empty.
+ */
+NGHTTP2_EXTERN void nghttp2_session_callbacks_set_submission_wakeup_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_submission_wakeup_callback submission_wakeup_callback);
+
 /**
  * @functypedef
  *
@@ -2637,6 +2828,226 @@ nghttp2_option_set_max_deflate_dynamic_table_size(nghttp2_option *option,
 NGHTTP2_EXTERN void nghttp2_option_set_no_closed_streams(nghttp2_option *option,
                                                          int val);
 
+/**
+ * @function
+ *
+ * This option enables adaptive indexing in the header field deflater
+ * if nonzero is passed.  By default, the deflater decides whether a
+ * header field is added to the dynamic table from its name only
+ * (e.g., ":path" and "etag" are never indexed).  With adaptive
+ * indexing, the deflater keeps track of how often a header field
+ * recurs, and indexes the ones which are likely to be reused, while
+ * leaving frequently changing ones out of the dynamic table.  See
+ * `nghttp2_hd_deflate_set_adaptive_indexing()` for details.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_hd_adaptive_indexing(nghttp2_option *option, int val);
+
+/**
+ * @function
+ *
+ * This option lets the library pass received header values to the
+ * header field callbacks (e.g., :type:`nghttp2_on_header_callback2`)
+ * without copying them if nonzero is passed.  A header value which is
+ * sent as a literal, neither Huffman encoded nor added to the dynamic
+ * table (e.g., large cookie or token), is handed out as
+ * :type:`nghttp2_rcbuf` referring to the buffer given to
+ * `nghttp2_session_mem_recv()`, as long as the whole value is
+ * contained in it.  If application calls
+ * `nghttp2_rcbuf_incref()` to keep the value, the library copies it
+ * after the callback returns, so the application can use it safely
+ * afterwards.
+ *
+ * With this option, header values passed to the callbacks, including
+ * :type:`nghttp2_on_header_callback`, are not necessarily
+ * NULL-terminated.  Header values retained by `nghttp2_rcbuf_incref()`
+ * are NULL-terminated.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_hd_inflate_zero_copy(nghttp2_option *option, int val);
+
+/**
+ * @function
+ *
+ * This option sets the maximum number of bytes of freed objects which
+ * a session keeps for reuse.  The session recycles memory of streams,
+ * outbound frames, and header fields copied by `nghttp2_submit_*`
+ * functions, so that it does not have to call the memory allocator
+ * for each of them.  The limit applies to each kind of object
+ * separately.  Memory is still obtained from, and eventually returned
+ * to, :type:`nghttp2_mem` given to the session.  Passing 0 disables
+ * recycling.  The default value is 32KiB.
+ */
+NGHTTP2_EXTERN void nghttp2_option_set_max_pool_memory(nghttp2_option *option,
+                                                       size_t val);
+
+/**
+ * @function
+ *
+ * This option, if set to nonzero, makes a session schedule streams
+ * by the extensible prioritization scheme defined in RFC 9218
+ * instead of the RFC 7540 dependency tree.  SETTINGS_NO_RFC7540_PRIORITIES
+ * with value 1 is added to the first SETTINGS frame submitted by
+ * `nghttp2_submit_settings()` if it is not included there.  Once the
+ * setting is in effect, PRIORITY frames and the priority
+ * information in HEADERS frames are ignored, and streams are
+ * scheduled by their urgency and incremental parameters.  Streams of
+ * the same urgency which are incremental are served in round-robin
+ * manner, one DATA frame at a time.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_no_rfc7540_priorities(nghttp2_option *option, int val);
+
+/**
+ * @function
+ *
+ * This option, if set to nonzero, and if a server session is
+ * configured with `nghttp2_option_set_no_rfc7540_priorities()`, makes
+ * the server fall back to the RFC 7540 priorities if the first
+ * SETTINGS frame received from the client does not contain
+ * SETTINGS_NO_RFC7540_PRIORITIES with value 1.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_server_fallback_rfc7540_priorities(nghttp2_option *option,
+                                                      int val);
+
+/**
+ * @function
+ *
+ * This option, if set to nonzero, turns on automatic tuning of the
+ * receive windows, and sets the maximum window size it may grow the
+ * windows to.  The value is capped at
+ * :macro:`NGHTTP2_MAX_WINDOW_SIZE`.
+ *
+ * The library estimates the bandwidth-delay product of the
+ * connection by counting the bytes of DATA consumed during the round
+ * trip of a PING frame it sends itself.  If one round trip consumes
+ * most of the connection window, the connection window is grown to
+ * twice the estimate.  If the connection keeps using only a small
+ * fraction of the grown window, it is shrunk again, but never below
+ * the size in effect when the first measurement was taken.  The
+ * stream level windows follow the connection window, but only when
+ * a stream receives DATA, so that idle streams keep the initial
+ * window size.  The bytes are counted when they are received, or,
+ * if `nghttp2_option_set_no_auto_window_update()` is used, when the
+ * application consumes them.
+ *
+ * The application should not change the receive windows itself
+ * while this option is in effect.  The PING frames sent for the
+ * measurement and their ACKs are passed to the callbacks like any
+ * other PING frames.  Use `nghttp2_session_get_window_tuning_stats()`
+ * to see the decisions taken.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_max_auto_window_size(nghttp2_option *option, uint32_t val);
+
+/**
+ * @function
+ *
+ * This option, if set to nonzero, attaches a submission queue to a
+ * session, which lets other threads request operations on it with
+ * `nghttp2_session_enqueue_data()`,
+ * `nghttp2_session_enqueue_resume_data()` and
+ * `nghttp2_session_enqueue_rst_stream()`.  The thread owning the
+ * session carries them out at the beginning of
+ * `nghttp2_session_send()`, `nghttp2_session_mem_send()`,
+ * `nghttp2_session_mem_sendv()`, `nghttp2_session_mem_send_batch()`,
+ * `nghttp2_session_recv()` and `nghttp2_session_mem_recv()`.
+ * :type:`nghttp2_submission_wakeup_callback` is invoked when the
+ * queue becomes non-empty.
+ *
+ * The queue is lock-free.  The memory for the queued operations is
+ * allocated by the enqueuing threads with the memory allocator of the
+ * session, which must be thread-safe.  The default allocator is.
+ *
+ * This option has no effect if the compiler does not provide the
+ * atomic operations the queue needs.
+ */
+NGHTTP2_EXTERN void nghttp2_option_set_submission_queue(nghttp2_option *option,
+                                                        int val);
+
+/**
+ * @function
+ *
+ * This option sets the memory budget of a session to |val| bytes,
+ * and enables the accounting of the memory which the session
+ * allocates, including the session object itself, HPACK tables,
+ * buffered header fields, queued outbound frames and retained
+ * streams.  Use `nghttp2_session_get_memory_usage()` and
+ * `nghttp2_session_get_peak_memory_usage()` to see the numbers.
+ * Pass ``SIZE_MAX`` to enable only the accounting.
+ *
+ * When the usage exceeds 3/4 of |val|, the session stops retaining
+ * closed and idle streams, releases the objects it keeps for reuse,
+ * and refuses new incoming streams with RST_STREAM of error code
+ * :enum:`nghttp2_error_code.NGHTTP2_REFUSED_STREAM` (or
+ * :enum:`nghttp2_error_code.NGHTTP2_CANCEL` for PUSH_PROMISE).  If
+ * the usage still exceeds |val| after `nghttp2_session_recv()` or
+ * `nghttp2_session_mem_recv()` processed the input, the session is
+ * terminated with GOAWAY of error code
+ * :enum:`nghttp2_error_code.NGHTTP2_ENHANCE_YOUR_CALM`.  The memory
+ * allocated by the application through the session, e.g., queued
+ * frames, is counted, but only the peer is penalized for it.
+ *
+ * The accounting stores the size of each allocation in front of it,
+ * which costs a few bytes per allocation.  The
+ * :type:`nghttp2_rcbuf` objects passed to the application must be
+ * released before the session is deleted while this option is in
+ * effect.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_max_session_memory(nghttp2_option *option, size_t val);
+
+/**
+ * @function
+ *
+ * This option, if set to nonzero, makes a server session keep the
+ * closed and idle streams it retains for the RFC 7540 priority tree
+ * in a compact form, which records only the stream ID, the weight
+ * and the parent, as long as no other stream depends on them.  This
+ * takes a fraction of the memory of a full stream object.  Idle
+ * streams are compacted only when they are created by a PRIORITY
+ * frame.  A compacted stream is restored to a full stream when it is
+ * looked up, e.g., when a new stream depends on it, or by
+ * `nghttp2_session_find_stream()`.  The restored stream becomes a
+ * child of the root if its parent is no longer in the tree.
+ *
+ * This option has no effect if
+ * `nghttp2_option_set_no_closed_streams()` or
+ * `nghttp2_option_set_no_rfc7540_priorities()` is used, because the
+ * streams are not retained then.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_compact_retained_streams(nghttp2_option *option, int val);
+
+/**
+ * @function
+ *
+ * This option, if set to nonzero, makes a session enforce
+ * :enum:`nghttp2_settings_id.NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE`
+ * it has advertised and the remote endpoint has acknowledged.  The
+ * size of the header list, which is the sum of the length of name
+ * and value plus 32 bytes per header field, is counted as the header
+ * fields are decoded from each HEADERS, PUSH_PROMISE and CONTINUATION
+ * frame, so that the memory used to receive a header block is bounded
+ * by the largest header field, rather than the whole header list.
+ *
+ * Once the size exceeds the limit, the stream is reset with
+ * :enum:`nghttp2_error_code.NGHTTP2_ENHANCE_YOUR_CALM`, and
+ * :type:`nghttp2_on_header_callback` and
+ * :type:`nghttp2_on_frame_recv_callback` are no longer invoked for
+ * the header block.  The remaining header block is still decoded to
+ * keep the header compression state in sync.  The header fields
+ * which have already been passed to the application are not
+ * retracted.
+ *
+ * By default, the limit is not enforced, and it is up to the
+ * application.
+ */
+NGHTTP2_EXTERN void
+nghttp2_option_set_enforce_max_header_list_size(nghttp2_option *option,
+                                                int val);
+
 /**
  * @function
  *
@@ -2872,7 +3283,8 @@ NGHTTP2_EXTERN int nghttp2_session_send(nghttp2_session *session);
  * or one of negative error codes.
  *
  * The assigned |*data_ptr| is valid until the next call of
- * `nghttp2_session_mem_send()` or `nghttp2_session_send()`.
+ * `nghttp2_session_mem_send()`, `nghttp2_session_mem_sendv()`,
+ * `nghttp2_session_mem_send_batch()` or `nghttp2_session_send()`.
  *
  * The caller must send all data before sending the next chunk of
  * data.
@@ -2896,6 +3308,95 @@ NGHTTP2_EXTERN int nghttp2_session_send(nghttp2_session *session);
 NGHTTP2_EXTERN ssize_t nghttp2_session_mem_send(nghttp2_session *session,
                                                 const uint8_t **data_ptr);
 
+/**
+ * @macro
+ *
+ * The minimum number of :type:`nghttp2_vec` which must be passed to
+ * `nghttp2_session_mem_sendv()`.
+ */
+#define NGHTTP2_MEM_SENDV_MIN_VECCNT 3
+
+/**
+ * @function
+ *
+ * Returns a batch of serialized frames to send as a vector.
+ *
+ * This function behaves like `nghttp2_session_mem_send()` except
+ * that it serializes as many frames as fit in |vec| of |veccnt|
+ * elements in one invocation.  It returns the number of
+ * :type:`nghttp2_vec` filled, which can be handed to ``writev(2)``
+ * or similar function at once.  If no data is available to send,
+ * this function returns 0.
+ *
+ * Frame headers and non-DATA frames are stored in the memory owned
+ * by |session|, and consecutive frames are coalesced into one
+ * :type:`nghttp2_vec`.  If :enum:`NGHTTP2_DATA_FLAG_NO_COPY` is used
+ * in :type:`nghttp2_data_source_read_callback`, DATA payload is not
+ * copied.  Instead, :type:`nghttp2_get_data_ref_callback` is invoked
+ * to get the application data, which is placed in |vec| by reference.
+ * :type:`nghttp2_on_data_ref_release_callback` is invoked when the
+ * library no longer refers to it.  :type:`nghttp2_send_data_callback`
+ * is not used by this function.
+ *
+ * The memory pointed by |vec| is valid until the next call of
+ * `nghttp2_session_mem_sendv()`, `nghttp2_session_mem_send()`,
+ * `nghttp2_session_mem_send_batch()` or `nghttp2_session_send()`.
+ * The caller must send all data in |vec| before calling those
+ * functions again.
+ *
+ * This function returns the number of :type:`nghttp2_vec` filled if
+ * it succeeds, or one of the following negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ * :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`
+ *     The callback function failed.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     The |veccnt| is less than :macro:`NGHTTP2_MEM_SENDV_MIN_VECCNT`.
+ */
+NGHTTP2_EXTERN ssize_t nghttp2_session_mem_sendv(nghttp2_session *session,
+                                                 nghttp2_vec *vec,
+                                                 size_t veccnt);
+
+/**
+ * @function
+ *
+ * Serializes as many frames as fit into the buffer pointed by |buf|
+ * of length |buflen|.
+ *
+ * This function behaves like `nghttp2_session_mem_send()` except
+ * that it writes the serialized frames into the caller supplied
+ * buffer, instead of returning them one by one.  It stops when the
+ * buffer is full or no data is available to send.  A frame which
+ * does not fit in the remaining space is written partially, and the
+ * rest of it is written by the next call.
+ *
+ * If the buffer has room for a whole DATA frame, and neither
+ * :type:`nghttp2_select_padding_callback`,
+ * :type:`nghttp2_data_source_read_length_callback`,
+ * :type:`nghttp2_send_data_callback` nor
+ * :type:`nghttp2_get_data_ref_callback` is set,
+ * :type:`nghttp2_data_source_read_callback` writes DATA payload
+ * directly into |buf|.
+ *
+ * If :enum:`NGHTTP2_DATA_FLAG_NO_COPY` is used,
+ * :type:`nghttp2_send_data_callback` is invoked as in
+ * `nghttp2_session_mem_send()`.  To keep the order of frames, this
+ * function returns early before invoking it if |buf| already has
+ * some data, and invokes it in the next call.
+ *
+ * This function returns the number of bytes written into |buf| if it
+ * succeeds, or one of the following negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ * :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`
+ *     The callback function failed.
+ */
+NGHTTP2_EXTERN ssize_t nghttp2_session_mem_send_batch(nghttp2_session *session,
+                                                      uint8_t *buf,
+                                                      size_t buflen);
+
 /**
  * @function
  *
@@ -3024,6 +3525,81 @@ NGHTTP2_EXTERN ssize_t nghttp2_session_mem_recv(nghttp2_session *session,
 NGHTTP2_EXTERN int nghttp2_session_resume_data(nghttp2_session *session,
                                                int32_t stream_id);
 
+/**
+ * @function
+ *
+ * Requests the thread owning |session| to call
+ * `nghttp2_submit_data()` with |flags|, |stream_id| and |data_prd|.
+ *
+ * This function is thread-safe, and can be called by any thread while
+ * |session| is alive, if `nghttp2_option_set_submission_queue()` is
+ * used.  The operation is carried out as described in that function.
+ * |*data_prd| is copied.  If `nghttp2_submit_data()` fails, for
+ * example because the stream has been closed in the meantime, the
+ * failure is ignored, and |data_prd| is never used.  The application
+ * should release the data source when the stream is closed, as
+ * usual.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     The submission queue is not enabled.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     The |stream_id| is 0 or negative; or |data_prd| is NULL.
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+NGHTTP2_EXTERN int
+nghttp2_session_enqueue_data(nghttp2_session *session, uint8_t flags,
+                             int32_t stream_id,
+                             const nghttp2_data_provider *data_prd);
+
+/**
+ * @function
+ *
+ * Requests the thread owning |session| to call
+ * `nghttp2_session_resume_data()` with |stream_id|.
+ *
+ * This function is thread-safe like `nghttp2_session_enqueue_data()`.
+ * If `nghttp2_session_resume_data()` fails, the failure is ignored.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     The submission queue is not enabled.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     The |stream_id| is 0 or negative.
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+NGHTTP2_EXTERN int nghttp2_session_enqueue_resume_data(nghttp2_session *session,
+                                                       int32_t stream_id);
+
+/**
+ * @function
+ *
+ * Requests the thread owning |session| to call
+ * `nghttp2_submit_rst_stream()` with |stream_id| and |error_code|.
+ *
+ * This function is thread-safe like `nghttp2_session_enqueue_data()`.
+ * If `nghttp2_submit_rst_stream()` fails, the failure is ignored.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     The submission queue is not enabled.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     The |stream_id| is 0 or negative.
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+NGHTTP2_EXTERN int nghttp2_session_enqueue_rst_stream(nghttp2_session *session,
+                                                      int32_t stream_id,
+                                                      uint32_t error_code);
+
 /**
  * @function
  *
@@ -3042,6 +3618,11 @@ NGHTTP2_EXTERN int nghttp2_session_want_read(nghttp2_session *session);
  * Returns nonzero value if |session| wants to send data to the remote
  * peer.
  *
+ * If the submission queue is enabled by
+ * `nghttp2_option_set_submission_queue()`, this function also returns
+ * nonzero value while the queue is not empty, so that the application
+ * calls `nghttp2_session_send()` to carry out the queued operations.
+ *
  * If both `nghttp2_session_want_read()` and
  * `nghttp2_session_want_write()` return 0, the application should
  * drop the connection.
@@ -3209,26 +3790,235 @@ NGHTTP2_EXTERN int32_t
 nghttp2_session_get_local_window_size(nghttp2_session *session);
 
 /**
- * @function
- *
- * Returns the remote window size for a given stream |stream_id|.
- *
- * This is the amount of flow-controlled payload (e.g., DATA) that the
- * local endpoint can send without stream level WINDOW_UPDATE.  There
- * is also connection level flow control, so the effective size of
- * payload that the local endpoint can actually send is
- * min(`nghttp2_session_get_stream_remote_window_size()`,
- * `nghttp2_session_get_remote_window_size()`).
+ * @enum
  *
- * This function returns -1 if it fails.
+ * The decisions taken by automatic window tuning.  See
+ * `nghttp2_option_set_max_auto_window_size()`.
  */
-NGHTTP2_EXTERN int32_t nghttp2_session_get_stream_remote_window_size(
-    nghttp2_session *session, int32_t stream_id);
+typedef enum {
+  /**
+   * The windows were left unchanged.
+   */
+  NGHTTP2_WINDOW_TUNING_ACTION_NONE = 0,
+  /**
+   * The windows were grown.
+   */
+  NGHTTP2_WINDOW_TUNING_ACTION_GROW = 1,
+  /**
+   * The windows were shrunk.
+   */
+  NGHTTP2_WINDOW_TUNING_ACTION_SHRINK = 2
+} nghttp2_window_tuning_action;
 
 /**
- * @function
- *
- * Returns the remote window size for a connection.
+ * @struct
+ *
+ * The state of automatic window tuning.
+ */
+typedef struct {
+  /**
+   * The latest estimate of the bandwidth-delay product in bytes; the
+   * number of bytes consumed during the last measured round trip.
+   */
+  uint64_t bdp;
+  /**
+   * The number of round trips measured so far.
+   */
+  uint64_t num_samples;
+  /**
+   * The number of times the windows were grown.
+   */
+  uint64_t num_grows;
+  /**
+   * The number of times the windows were shrunk.
+   */
+  uint64_t num_shrinks;
+  /**
+   * The connection level receive window size.  Streams which receive
+   * DATA are given the same window size, or the initial window size
+   * if it is larger.
+   */
+  int32_t window_size;
+  /**
+   * The maximum window size the windows may be grown to.
+   */
+  int32_t max_window_size;
+  /**
+   * The decision taken after the last measurement.
+   */
+  nghttp2_window_tuning_action last_action;
+} nghttp2_window_tuning_stats;
+
+/**
+ * @function
+ *
+ * Stores the state of automatic window tuning in |*stats|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     Automatic window tuning is not enabled by
+ *     `nghttp2_option_set_max_auto_window_size()`.
+ */
+NGHTTP2_EXTERN int
+nghttp2_session_get_window_tuning_stats(nghttp2_session *session,
+                                        nghttp2_window_tuning_stats *stats);
+
+/**
+ * @macro
+ *
+ * The index of the per frame type counters in
+ * :type:`nghttp2_session_stats` which counts the frames whose type
+ * is this value or larger.
+ */
+#define NGHTTP2_STATS_FRAME_TYPE_OTHER 0x11
+
+/**
+ * @macro
+ *
+ * The number of the per frame type counters in
+ * :type:`nghttp2_session_stats`.
+ */
+#define NGHTTP2_STATS_FRAME_TYPE_LEN (NGHTTP2_STATS_FRAME_TYPE_OTHER + 1)
+
+/**
+ * @struct
+ *
+ * The counters maintained by a session since its creation.  The per
+ * frame type counters are indexed by the frame type.  Frame types
+ * larger than or equal to :macro:`NGHTTP2_STATS_FRAME_TYPE_OTHER`
+ * are counted in the last element.
+ */
+typedef struct {
+  /**
+   * The number of frames sent.
+   */
+  uint64_t frames_sent[NGHTTP2_STATS_FRAME_TYPE_LEN];
+  /**
+   * The number of bytes sent, including the frame header and
+   * padding.
+   */
+  uint64_t bytes_sent[NGHTTP2_STATS_FRAME_TYPE_LEN];
+  /**
+   * The number of frames received, including the ones which are
+   * ignored.
+   */
+  uint64_t frames_recv[NGHTTP2_STATS_FRAME_TYPE_LEN];
+  /**
+   * The number of bytes received, including the frame header and
+   * padding.
+   */
+  uint64_t bytes_recv[NGHTTP2_STATS_FRAME_TYPE_LEN];
+  /**
+   * The number of bytes of header blocks produced by the HPACK
+   * encoder.
+   */
+  uint64_t hd_deflate_compressed_bytes;
+  /**
+   * The sum of the lengths of the names and the values of the header
+   * fields passed to the HPACK encoder.
+   */
+  uint64_t hd_deflate_uncompressed_bytes;
+  /**
+   * The number of header fields passed to the HPACK encoder.
+   */
+  uint64_t hd_deflate_num_fields;
+  /**
+   * The number of header fields which the HPACK encoder found in its
+   * dynamic table and encoded as an index.  Divide this by
+   * :member:`hd_deflate_num_fields` to get the hit rate.
+   */
+  uint64_t hd_deflate_num_dynamic_table_hits;
+  /**
+   * The number of bytes of header blocks consumed by the HPACK
+   * decoder.
+   */
+  uint64_t hd_inflate_compressed_bytes;
+  /**
+   * The sum of the lengths of the names and the values of the header
+   * fields produced by the HPACK decoder.
+   */
+  uint64_t hd_inflate_uncompressed_bytes;
+  /**
+   * The number of header fields produced by the HPACK decoder.
+   */
+  uint64_t hd_inflate_num_fields;
+  /**
+   * The number of header fields which the remote endpoint encoded as
+   * an index into the dynamic table.
+   */
+  uint64_t hd_inflate_num_dynamic_table_hits;
+  /**
+   * The number of times the connection level window of the remote
+   * endpoint was used up by DATA sent.
+   */
+  uint64_t connection_flow_control_blocked;
+  /**
+   * The number of times a stream had DATA to send, but was deferred
+   * because its window was used up.
+   */
+  uint64_t stream_flow_control_blocked;
+  /**
+   * The number of streams opened, both by the local and the remote
+   * endpoint.  Reserved streams are counted when they are opened.
+   */
+  uint64_t num_streams_opened;
+  /**
+   * The number of RST_STREAM frames sent.
+   */
+  uint64_t num_streams_reset_sent;
+  /**
+   * The number of RST_STREAM frames received.
+   */
+  uint64_t num_streams_reset_recv;
+  /**
+   * The number of RST_STREAM frames with
+   * :enum:`nghttp2_error_code.NGHTTP2_REFUSED_STREAM` sent.
+   */
+  uint64_t num_streams_refused_sent;
+  /**
+   * The number of RST_STREAM frames with
+   * :enum:`nghttp2_error_code.NGHTTP2_REFUSED_STREAM` received.
+   */
+  uint64_t num_streams_refused_recv;
+  /**
+   * The largest number of streams which were open at the same time.
+   */
+  size_t max_concurrent_streams;
+} nghttp2_session_stats;
+
+/**
+ * @function
+ *
+ * Stores the counters of |session| in |*stats|.  The counters are
+ * always maintained, and this function is cheap enough to be called
+ * frequently.
+ */
+NGHTTP2_EXTERN void nghttp2_session_get_stats(nghttp2_session *session,
+                                              nghttp2_session_stats *stats);
+
+/**
+ * @function
+ *
+ * Returns the remote window size for a given stream |stream_id|.
+ *
+ * This is the amount of flow-controlled payload (e.g., DATA) that the
+ * local endpoint can send without stream level WINDOW_UPDATE.  There
+ * is also connection level flow control, so the effective size of
+ * payload that the local endpoint can actually send is
+ * min(`nghttp2_session_get_stream_remote_window_size()`,
+ * `nghttp2_session_get_remote_window_size()`).
+ *
+ * This function returns -1 if it fails.
+ */
+NGHTTP2_EXTERN int32_t nghttp2_session_get_stream_remote_window_size(
+    nghttp2_session *session, int32_t stream_id);
+
+/**
+ * @function
+ *
+ * Returns the remote window size for a connection.
  *
  * This function always succeeds.
  */
@@ -3273,6 +4063,27 @@ nghttp2_session_get_hd_inflate_dynamic_table_size(nghttp2_session *session);
 NGHTTP2_EXTERN size_t
 nghttp2_session_get_hd_deflate_dynamic_table_size(nghttp2_session *session);
 
+/**
+ * @function
+ *
+ * Returns the number of bytes currently allocated by |session|.  It
+ * returns 0 unless `nghttp2_option_set_max_session_memory()` was
+ * used to create |session|.
+ */
+NGHTTP2_EXTERN size_t
+nghttp2_session_get_memory_usage(nghttp2_session *session);
+
+/**
+ * @function
+ *
+ * Returns the largest number of bytes which |session| has ever
+ * allocated at the same time.  It returns 0 unless
+ * `nghttp2_option_set_max_session_memory()` was used to create
+ * |session|.
+ */
+NGHTTP2_EXTERN size_t
+nghttp2_session_get_peak_memory_usage(nghttp2_session *session);
+
 /**
  * @function
  *
@@ -3885,6 +4696,95 @@ nghttp2_submit_response(nghttp2_session *session, int32_t stream_id,
                         const nghttp2_nv *nva, size_t nvlen,
                         const nghttp2_data_provider *data_prd);
 
+struct nghttp2_hd_template;
+
+/**
+ * @struct
+ *
+ * The set of header fields which are sent repeatedly with the same
+ * value.  The details of this structure are intentionally hidden from
+ * the public API.
+ */
+typedef struct nghttp2_hd_template nghttp2_hd_template;
+
+/**
+ * @function
+ *
+ * Creates a header template from the |nva|, which has |nvlen|
+ * name/value pairs, and registers it with |session|.  The pointer to
+ * the template is assigned to |*tmpl_ptr|.
+ *
+ * The template is used with `nghttp2_submit_response2()` and
+ * `nghttp2_submit_headers2()` to send the header fields which are
+ * identical across many HEADERS frames, such as "server" and
+ * "content-type" of responses.  The library encodes them in advance,
+ * and adds them to the dynamic table when they are sent first.  As
+ * long as they stay in the dynamic table, they are sent as references
+ * to it without searching the table or Huffman encoding.  Otherwise,
+ * they are encoded again, and added to the dynamic table.
+ *
+ * Header fields in the template are indexed regardless of their
+ * names, except for those which must not be indexed (e.g., the one
+ * with :enum:`NGHTTP2_NV_FLAG_NO_INDEX`), or too large to fit in the
+ * dynamic table.  :type:`nghttp2_select_hd_indexing_callback` is not
+ * invoked for them.
+ *
+ * Pseudo header fields (header fields whose name starts with ":")
+ * must be placed before regular header fields in |nva|.
+ *
+ * This function creates copies of all name/value pairs in |nva|.  It
+ * also lower-cases all names in |nva|.  If
+ * :enum:`NGHTTP2_NV_FLAG_NO_COPY_NAME` and
+ * :enum:`NGHTTP2_NV_FLAG_NO_COPY_VALUE` are set, header field name
+ * and value are not copied respectively, and the application must
+ * keep them alive until |session| is deleted.
+ *
+ * The template is valid until it is deleted by
+ * `nghttp2_session_del_hd_template()`, or |session| is deleted.  It
+ * must not be used with other sessions.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     A pseudo header field appears after a regular header field.
+ */
+NGHTTP2_EXTERN int
+nghttp2_session_create_hd_template(nghttp2_session *session,
+                                   nghttp2_hd_template **tmpl_ptr,
+                                   const nghttp2_nv *nva, size_t nvlen);
+
+/**
+ * @function
+ *
+ * Deletes |tmpl| from |session|.  The application must not use
+ * |tmpl| after this function returns.  HEADERS frames which have been
+ * submitted with |tmpl| but not been sent yet are not affected.
+ */
+NGHTTP2_EXTERN void nghttp2_session_del_hd_template(nghttp2_session *session,
+                                                    nghttp2_hd_template *tmpl);
+
+/**
+ * @function
+ *
+ * Like `nghttp2_submit_response()`, but the header fields in |tmpl|
+ * are sent in addition to |nva|.  Pseudo header fields in |tmpl| are
+ * sent first, followed by |nva|, and then the other header fields in
+ * |tmpl|.  If |tmpl| is ``NULL``, this function is equivalent to
+ * `nghttp2_submit_response()`.
+ *
+ * |tmpl| must be created by `nghttp2_session_create_hd_template()`
+ * for |session|.  The header fields in |tmpl| are not included in the
+ * HEADERS frame passed to callbacks such as
+ * :type:`nghttp2_on_frame_send_callback`.
+ */
+NGHTTP2_EXTERN int
+nghttp2_submit_response2(nghttp2_session *session, int32_t stream_id,
+                         nghttp2_hd_template *tmpl, const nghttp2_nv *nva,
+                         size_t nvlen, const nghttp2_data_provider *data_prd);
+
 /**
  * @function
  *
@@ -4033,6 +4933,25 @@ NGHTTP2_EXTERN int32_t nghttp2_submit_headers(
     const nghttp2_priority_spec *pri_spec, const nghttp2_nv *nva, size_t nvlen,
     void *stream_user_data);
 
+/**
+ * @function
+ *
+ * Like `nghttp2_submit_headers()`, but the header fields in |tmpl|
+ * are sent in addition to |nva|.  Pseudo header fields in |tmpl| are
+ * sent first, followed by |nva|, and then the other header fields in
+ * |tmpl|.  If |tmpl| is ``NULL``, this function is equivalent to
+ * `nghttp2_submit_headers()`.
+ *
+ * |tmpl| must be created by `nghttp2_session_create_hd_template()`
+ * for |session|.  The header fields in |tmpl| are not included in the
+ * HEADERS frame passed to callbacks such as
+ * :type:`nghttp2_on_frame_send_callback`.
+ */
+NGHTTP2_EXTERN int32_t nghttp2_submit_headers2(
+    nghttp2_session *session, uint8_t flags, int32_t stream_id,
+    const nghttp2_priority_spec *pri_spec, nghttp2_hd_template *tmpl,
+    const nghttp2_nv *nva, size_t nvlen, void *stream_user_data);
+
 /**
  * @function
  *
@@ -4633,6 +5552,217 @@ NGHTTP2_EXTERN int nghttp2_submit_origin(nghttp2_session *session,
                                          const nghttp2_origin_entry *ov,
                                          size_t nov);
 
+/**
+ * @struct
+ *
+ * The payload of PRIORITY_UPDATE frame.  PRIORITY_UPDATE frame is a
+ * non-critical extension to HTTP/2.  If this frame is received, and
+ * `nghttp2_option_set_user_recv_extension_type()` is not set, and
+ * `nghttp2_option_set_builtin_recv_extension_type()` is set for
+ * :enum:`NGHTTP2_PRIORITY_UPDATE`, ``nghttp2_extension.payload`` will
+ * point to this struct.  If the session has
+ * `nghttp2_option_set_no_rfc7540_priorities()` in effect, the frame is
+ * processed by the library and passed to the callbacks regardless of
+ * `nghttp2_option_set_builtin_recv_extension_type()`.
+ *
+ * It has the following members:
+ */
+typedef struct {
+  /**
+   * The stream ID of the stream whose priority is updated.
+   */
+  int32_t stream_id;
+  /**
+   * The pointer to Priority field value.  It is not necessarily
+   * NULL-terminated.
+   */
+  uint8_t *field_value;
+  /**
+   * The length of the |field_value|.
+   */
+  size_t field_value_len;
+} nghttp2_ext_priority_update;
+
+/**
+ * @function
+ *
+ * Submits PRIORITY_UPDATE frame.
+ *
+ * PRIORITY_UPDATE frame is a non-critical extension to HTTP/2, and
+ * defined in `RFC 9218
+ * <https://tools.ietf.org/html/rfc9218#section-7.1>`_.
+ *
+ * The |flags| is currently ignored and should be
+ * :enum:`NGHTTP2_FLAG_NONE`.
+ *
+ * The |stream_id| is the ID of the stream whose priority is updated.
+ * The |field_value| is the Priority field value, and its length is
+ * |field_value_len|.  This function copies |field_value|.
+ *
+ * PRIORITY_UPDATE frame is only usable by a client.  If this
+ * function is invoked with server side session, or if the server
+ * sent its SETTINGS without SETTINGS_NO_RFC7540_PRIORITIES = 1, this
+ * function returns :enum:`NGHTTP2_ERR_INVALID_STATE`.  The frame may
+ * be submitted before the server's SETTINGS arrives.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     The function is called from server side session, or the server
+ *     disabled the extensible priorities.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     The |field_value_len| is larger than 16380; or |stream_id| is 0.
+ */
+NGHTTP2_EXTERN int nghttp2_submit_priority_update(nghttp2_session *session,
+                                                  uint8_t flags,
+                                                  int32_t stream_id,
+                                                  const uint8_t *field_value,
+                                                  size_t field_value_len);
+
+/**
+ * @macro
+ *
+ * :macro:`NGHTTP2_EXTPRI_DEFAULT_URGENCY` is the default urgency
+ * level for RFC 9218 extensible priorities.
+ */
+#define NGHTTP2_EXTPRI_DEFAULT_URGENCY 3
+
+/**
+ * @macro
+ *
+ * :macro:`NGHTTP2_EXTPRI_URGENCY_HIGH` is the highest urgency level
+ * for RFC 9218 extensible priorities.
+ */
+#define NGHTTP2_EXTPRI_URGENCY_HIGH 0
+
+/**
+ * @macro
+ *
+ * :macro:`NGHTTP2_EXTPRI_URGENCY_LOW` is the lowest urgency level for
+ * RFC 9218 extensible priorities.
+ */
+#define NGHTTP2_EXTPRI_URGENCY_LOW 7
+
+/**
+ * @macro
+ *
+ * :macro:`NGHTTP2_EXTPRI_URGENCY_LEVELS` is the number of urgency
+ * levels for RFC 9218 extensible priorities.
+ */
+#define NGHTTP2_EXTPRI_URGENCY_LEVELS (NGHTTP2_EXTPRI_URGENCY_LOW + 1)
+
+/**
+ * @struct
+ *
+ * :type:`nghttp2_extpri` is RFC 9218 extensible priorities
+ * specification.
+ */
+typedef struct {
+  /**
+   * The urgency of a stream, it must be in
+   * [:macro:`NGHTTP2_EXTPRI_URGENCY_HIGH`,
+   * :macro:`NGHTTP2_EXTPRI_URGENCY_LOW`], inclusive, and 0 is the
+   * highest urgency.
+   */
+  uint32_t urgency;
+  /**
+   * Indicates that a content can be processed
+   * incrementally or not.  If |inc| is 0, it cannot be processed
+   * incrementally.  If |inc| is 1, it can be processed incrementally.
+   * Other value is not permitted.
+   */
+  int inc;
+} nghttp2_extpri;
+
+/**
+ * @function
+ *
+ * Changes the RFC 9218 priority of the existing stream denoted by
+ * |stream_id|.  The new priority is |extpri|.  This function is
+ * meant to be used by server for RFC 9218 extensible
+ * prioritization scheme.
+ *
+ * If |session| is initialized as client, this function returns
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`.  For client, use
+ * `nghttp2_submit_priority_update()` instead.
+ *
+ * If ``extpri->urgency`` is out of
+ * bound, it is set to :macro:`NGHTTP2_EXTPRI_URGENCY_LOW`.
+ *
+ * If |ignore_client_signal| is nonzero, server starts to ignore
+ * client priority signals for this stream.
+ *
+ * If SETTINGS_NO_RFC7540_PRIORITIES of value 1 is not in effect for
+ * |session|, this function returns
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     |session| is initialized as client, or the extensible
+ *     priorities are not in effect.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     |stream_id| is zero; or a stream denoted by |stream_id| is not
+ *     found.
+ */
+NGHTTP2_EXTERN int nghttp2_session_change_extpri_stream_priority(
+    nghttp2_session *session, int32_t stream_id, const nghttp2_extpri *extpri,
+    int ignore_client_signal);
+
+/**
+ * @function
+ *
+ * Stores the stream priority of the existing stream denoted by
+ * |stream_id| in the object pointed by |extpri|.  This function is
+ * meant to be used by server for RFC 9218 extensible
+ * prioritization scheme.
+ *
+ * If |session| is initialized as client, this function returns
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`.
+ *
+ * If SETTINGS_NO_RFC7540_PRIORITIES of value 1 is not in effect for
+ * |session|, this function returns
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     |session| is initialized as client, or the extensible
+ *     priorities are not in effect.
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     |stream_id| is zero; or a stream denoted by |stream_id| is not
+ *     found.
+ */
+NGHTTP2_EXTERN int nghttp2_session_get_extpri_stream_priority(
+    nghttp2_session *session, nghttp2_extpri *extpri, int32_t stream_id);
+
+/**
+ * @function
+ *
+ * Parses Priority header field value pointed by |value| of length
+ * |len|, and stores the result in the object pointed by |extpri|.
+ * Priority header field is defined in RFC 9218.
+ *
+ * This function does not initialize the object pointed by |extpri|
+ * before storing the result.  It only assigns the values that the
+ * parser correctly extracted to fields.  Unknown parameters, and
+ * parameters with out of range values are ignored.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
+ *     Failed to parse the header field value.
+ */
+NGHTTP2_EXTERN int nghttp2_extpri_parse_priority(nghttp2_extpri *extpri,
+                                                 const uint8_t *value,
+                                                 size_t len);
+
 /**
  * @function
  *
@@ -4949,6 +6079,69 @@ NGHTTP2_EXTERN
 size_t
 nghttp2_hd_deflate_get_max_dynamic_table_size(nghttp2_hd_deflater *deflater);
 
+/**
+ * @functypedef
+ *
+ * Callback function invoked when |deflater| encodes the header field
+ * |nv| and asks application which HPACK representation should be
+ * used for it.  The |suggested| is the representation |deflater|
+ * would use on its own.  The implementation of this function must
+ * return one of :type:`nghttp2_hd_indexing`.  Returning |suggested|
+ * keeps the decision of |deflater|.  The |user_data| is the pointer
+ * passed to `nghttp2_hd_deflate_set_indexing_callback()`.
+ *
+ * This callback is not invoked for a header field which has
+ * :enum:`NGHTTP2_NV_FLAG_NO_INDEX` set.  Even if a header field is
+ * found in the static or dynamic table, returning
+ * :enum:`NGHTTP2_HD_INDEXING_NEVER` makes it encoded as a literal.
+ *
+ * Returning any other value makes `nghttp2_hd_deflate_hd()` and
+ * `nghttp2_hd_deflate_hd_vec()` fail with
+ * :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`.
+ */
+typedef int (*nghttp2_hd_deflate_indexing_callback)(
+    nghttp2_hd_deflater *deflater, const nghttp2_nv *nv, int suggested,
+    void *user_data);
+
+/**
+ * @function
+ *
+ * Sets callback function invoked when |deflater| chooses HPACK
+ * representation of a header field.  Passing ``NULL`` to |cb|
+ * removes the callback.  The |user_data| is passed to |cb| as is.
+ */
+NGHTTP2_EXTERN void nghttp2_hd_deflate_set_indexing_callback(
+    nghttp2_hd_deflater *deflater, nghttp2_hd_deflate_indexing_callback cb,
+    void *user_data);
+
+/**
+ * @function
+ *
+ * Enables adaptive indexing in |deflater| if |val| is nonzero, and
+ * disables it otherwise.
+ *
+ * By default, |deflater| does not index a header field whose name is
+ * known to have frequently changing values (e.g., ":path", "etag",
+ * and "set-cookie"), and indexes the other header fields.  With
+ * adaptive indexing, |deflater| estimates how many times each
+ * name/value pair and each name have been seen recently, using a
+ * small count-min sketch.  A name/value pair seen at least twice
+ * before is indexed regardless of its name.  A header field whose
+ * name recently came with a repeated value at least half of the time
+ * is indexed, and one whose name mostly came with a new value is not.
+ * Until enough data is collected for a name, the default rule is
+ * used.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+NGHTTP2_EXTERN int
+nghttp2_hd_deflate_set_adaptive_indexing(nghttp2_hd_deflater *deflater,
+                                         int val);
+
 struct nghttp2_hd_inflater;
 
 /**
@@ -128,6 +128,12 @@ void nghttp2_session_callbacks_set_select_padding_callback(
   cbs->select_padding_callback = select_padding_callback;
 }
 
+void nghttp2_session_callbacks_set_select_hd_indexing_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_select_hd_indexing_callback select_hd_indexing_callback) {
+  cbs->select_hd_indexing_callback = select_hd_indexing_callback;
+}
+
 void nghttp2_session_callbacks_set_data_source_read_length_callback(
     nghttp2_session_callbacks *cbs,
     nghttp2_data_source_read_length_callback data_source_read_length_callback) {
@@ -173,3 +179,21 @@ void nghttp2_session_callbacks_set_error_callback2(
     nghttp2_session_callbacks *cbs, nghttp2_error_callback2 error_callback2) {
   cbs->error_callback2 = error_callback2;
 }
+
+void nghttp2_session_callbacks_set_get_data_ref_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_get_data_ref_callback get_data_ref_callback) {
+  cbs->get_data_ref_callback = get_data_ref_callback;
+}
+
+void nghttp2_session_callbacks_set_on_data_ref_release_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_on_data_ref_release_callback on_data_ref_release_callback) {
+  cbs->on_data_ref_release_callback = on_data_ref_release_callback;
+}
+
+void nghttp2_session_callbacks_set_submission_wakeup_callback(
+    nghttp2_session_callbacks *cbs,
+    nghttp2_submission_wakeup_callback submission_wakeup_callback) {
+  cbs->submission_wakeup_callback = submission_wakeup_callback;
+}
@@ -105,6 +105,12 @@ struct nghttp2_session_callbacks {
    * frame.
    */
   nghttp2_select_padding_callback select_padding_callback;
+  /**
+   * Callback function invoked when the library asks application
+   * which HPACK representation is used to encode the given header
+   * field.
+   */
+  nghttp2_select_hd_indexing_callback select_hd_indexing_callback;
   /**
    * The callback function used to determine the length allowed in
    * `nghttp2_data_source_read_callback()`
@@ -120,6 +126,9 @@ struct nghttp2_session_callbacks {
   nghttp2_on_extension_chunk_recv_callback on_extension_chunk_recv_callback;
   nghttp2_error_callback error_callback;
   nghttp2_error_callback2 error_callback2;
+  nghttp2_get_data_ref_callback get_data_ref_callback;
+  nghttp2_on_data_ref_release_callback on_data_ref_release_callback;
+  nghttp2_submission_wakeup_callback submission_wakeup_callback;
 };
 
 #endif /* NGHTTP2_CALLBACKS_H */
@@ -0,0 +1,361 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_extpri.h"
+
+uint8_t nghttp2_extpri_to_uint8(const nghttp2_extpri *extpri) {
+  return (uint8_t)((uint32_t)(extpri->inc ? NGHTTP2_EXTPRI_INC_MASK : 0) |
+                   extpri->urgency);
+}
+
+void nghttp2_extpri_from_uint8(nghttp2_extpri *extpri, uint8_t u8extpri) {
+  extpri->urgency = nghttp2_extpri_uint8_urgency(u8extpri);
+  extpri->inc = nghttp2_extpri_uint8_inc(u8extpri);
+}
+
+/* The minimal parser of Structured Field Values for HTTP (RFC 8941)
+   below only recognizes the shape of Dictionary.  The values other
+   than Integer and Boolean are validated and then discarded because
+   Priority field only uses these two types. */
+typedef enum {
+  NGHTTP2_SF_VALUE_OTHER,
+  NGHTTP2_SF_VALUE_INTEGER,
+  NGHTTP2_SF_VALUE_BOOLEAN
+} nghttp2_sf_value_type;
+
+typedef struct {
+  nghttp2_sf_value_type type;
+  /* Integer value, or 0 or 1 for Boolean */
+  int64_t i;
+} nghttp2_sf_value;
+
+static int sf_lcalpha(uint8_t c) { return 'a' <= c && c <= 'z'; }
+
+static int sf_alpha(uint8_t c) {
+  return sf_lcalpha(c) || ('A' <= c && c <= 'Z');
+}
+
+static int sf_digit(uint8_t c) { return '0' <= c && c <= '9'; }
+
+static int sf_tchar(uint8_t c) {
+  switch (c) {
+  case '!':
+  case '#':
+  case '$':
+  case '%':
+  case '&':
+  case '\'':
+  case '*':
+  case '+':
+  case '-':
+  case '.':
+  case '^':
+  case '_':
+  case '`':
+  case '|':
+  case '~':
+    return 1;
+  default:
+    return sf_alpha(c) || sf_digit(c);
+  }
+}
+
+static int sf_base64(uint8_t c) {
+  return sf_alpha(c) || sf_digit(c) || c == '+' || c == '/' || c == '=';
+}
+
+static const uint8_t *sf_skip_sp(const uint8_t *p, const uint8_t *end) {
+  for (; p != end && *p == ' '; ++p)
+    ;
+  return p;
+}
+
+static const uint8_t *sf_skip_ows(const uint8_t *p, const uint8_t *end) {
+  for (; p != end && (*p == ' ' || *p == '\t'); ++p)
+    ;
+  return p;
+}
+
+/*
+ * Parses key at |p|.  This function returns the position just past
+ * the key, or NULL if there is no valid key at |p|.
+ */
+static const uint8_t *sf_parse_key(const uint8_t *p, const uint8_t *end) {
+  if (p == end || (!sf_lcalpha(*p) && *p != '*')) {
+    return NULL;
+  }
+
+  for (++p; p != end; ++p) {
+    if (!sf_lcalpha(*p) && !sf_digit(*p) && *p != '_' && *p != '-' &&
+        *p != '.' && *p != '*') {
+      break;
+    }
+  }
+
+  return p;
+}
+
+static const uint8_t *sf_parse_number(nghttp2_sf_value *value,
+                                      const uint8_t *p, const uint8_t *end) {
+  int neg = 0;
+  size_t ndigits = 0, nfrac = 0;
+  int64_t n = 0;
+
+  if (*p == '-') {
+    neg = 1;
+    ++p;
+  }
+
+  for (; p != end && sf_digit(*p); ++p) {
+    if (++ndigits > 15) {
+      return NULL;
+    }
+    n = n * 10 + (*p - '0');
+  }
+
+  if (ndigits == 0) {
+    return NULL;
+  }
+
+  if (p == end || *p != '.') {
+    value->type = NGHTTP2_SF_VALUE_INTEGER;
+    value->i = neg ? -n : n;
+    return p;
+  }
+
+  if (ndigits > 12) {
+    return NULL;
+  }
+
+  for (++p; p != end && sf_digit(*p); ++p) {
+    if (++nfrac > 3) {
+      return NULL;
+    }
+  }
+
+  if (nfrac == 0) {
+    return NULL;
+  }
+
+  value->type = NGHTTP2_SF_VALUE_OTHER;
+
+  return p;
+}
+
+/*
+ * Parses bare item at |p|, and stores its type in |value|.  This
+ * function returns the position just past the item, or NULL if there
+ * is no valid bare item at |p|.
+ */
+static const uint8_t *sf_parse_bare_item(nghttp2_sf_value *value,
+                                         const uint8_t *p,
+                                         const uint8_t *end) {
+  if (p == end) {
+    return NULL;
+  }
+
+  if (*p == '-' || sf_digit(*p)) {
+    return sf_parse_number(value, p, end);
+  }
+
+  value->type = NGHTTP2_SF_VALUE_OTHER;
+
+  switch (*p) {
+  case '"':
+    for (++p; p != end; ++p) {
+      if (*p == '"') {
+        return p + 1;
+      }
+      if (*p == '\\') {
+        if (++p == end || (*p != '"' && *p != '\\')) {
+          return NULL;
+        }
+        continue;
+      }
+      if (*p < 0x20 || *p > 0x7e) {
+        return NULL;
+      }
+    }
+    return NULL;
+  case ':':
+    for (++p; p != end && sf_base64(*p); ++p)
+      ;
+    if (p == end || *p != ':') {
+      return NULL;
+    }
+    return p + 1;
+  case '?':
+    if (++p == end || (*p != '0' && *p != '1')) {
+      return NULL;
+    }
+    value->type = NGHTTP2_SF_VALUE_BOOLEAN;
+    value->i = *p - '0';
+    return p + 1;
+  default:
+    if (!sf_alpha(*p) && *p != '*') {
+      return NULL;
+    }
+    for (++p; p != end && (sf_tchar(*p) || *p == ':' || *p == '/'); ++p)
+      ;
+    return p;
+  }
+}
+
+static const uint8_t *sf_parse_params(const uint8_t *p, const uint8_t *end) {
+  nghttp2_sf_value value;
+
+  while (p != end && *p == ';') {
+    p = sf_parse_key(sf_skip_sp(p + 1, end), end);
+    if (p == NULL) {
+      return NULL;
+    }
+
+    if (p != end && *p == '=') {
+      p = sf_parse_bare_item(&value, p + 1, end);
+      if (p == NULL) {
+        return NULL;
+      }
+    }
+  }
+
+  return p;
+}
+
+/*
+ * Parses Item or Inner List, including their parameters, at |p|.
+ */
+static const uint8_t *sf_parse_member_value(nghttp2_sf_value *value,
+                                            const uint8_t *p,
+                                            const uint8_t *end) {
+  nghttp2_sf_value inner;
+
+  if (p == end || *p != '(') {
+    p = sf_parse_bare_item(value, p, end);
+    if (p == NULL) {
+      return NULL;
+    }
+
+    return sf_parse_params(p, end);
+  }
+
+  value->type = NGHTTP2_SF_VALUE_OTHER;
+
+  for (++p;;) {
+    p = sf_skip_sp(p, end);
+    if (p == end) {
+      return NULL;
+    }
+
+    if (*p == ')') {
+      break;
+    }
+
+    p = sf_parse_bare_item(&inner, p, end);
+    if (p == NULL) {
+      return NULL;
+    }
+
+    p = sf_parse_params(p, end);
+    if (p == NULL || p == end || (*p != ' ' && *p != ')')) {
+      return NULL;
+    }
+  }
+
+  return sf_parse_params(p + 1, end);
+}
+
+int nghttp2_extpri_parse_priority(nghttp2_extpri *extpri, const uint8_t *value,
+                                  size_t len) {
+  const uint8_t *p, *end, *key;
+  size_t keylen;
+  nghttp2_sf_value v;
+  /* -1 means that the parameter is absent or its last value is
+     invalid. */
+  int64_t urgency = -1, inc = -1;
+
+  p = value;
+  end = value + len;
+
+  p = sf_skip_sp(p, end);
+
+  while (p != end) {
+    key = p;
+    p = sf_parse_key(p, end);
+    if (p == NULL) {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+
+    keylen = (size_t)(p - key);
+
+    if (p != end && *p == '=') {
+      p = sf_parse_member_value(&v, p + 1, end);
+    } else {
+      v.type = NGHTTP2_SF_VALUE_BOOLEAN;
+      v.i = 1;
+      p = sf_parse_params(p, end);
+    }
+
+    if (p == NULL) {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+
+    if (keylen == 1) {
+      switch (*key) {
+      case 'u':
+        urgency = (v.type == NGHTTP2_SF_VALUE_INTEGER && v.i >= 0 &&
+                   v.i <= NGHTTP2_EXTPRI_URGENCY_LOW)
+                      ? v.i
+                      : -1;
+        break;
+      case 'i':
+        inc = v.type == NGHTTP2_SF_VALUE_BOOLEAN ? v.i : -1;
+        break;
+      }
+    }
+
+    p = sf_skip_ows(p, end);
+    if (p == end) {
+      break;
+    }
+
+    if (*p != ',') {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+
+    p = sf_skip_ows(p + 1, end);
+    if (p == end) {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+  }
+
+  if (urgency != -1) {
+    extpri->urgency = (uint32_t)urgency;
+  }
+
+  if (inc != -1) {
+    extpri->inc = (int)inc;
+  }
+
+  return 0;
+}
@@ -253,6 +253,32 @@ void nghttp2_frame_origin_free(nghttp2_extension *frame, nghttp2_mem *mem) {
   nghttp2_mem_free(mem, origin->ov);
 }
 
+void nghttp2_frame_priority_update_init(nghttp2_extension *frame,
+                                        int32_t stream_id,
+                                        uint8_t *field_value,
+                                        size_t field_value_len) {
+  nghttp2_ext_priority_update *priority_update;
+
+  nghttp2_frame_hd_init(&frame->hd, 4 + field_value_len,
+                        NGHTTP2_PRIORITY_UPDATE, NGHTTP2_FLAG_NONE, 0);
+
+  priority_update = frame->payload;
+  priority_update->stream_id = stream_id;
+  priority_update->field_value = field_value;
+  priority_update->field_value_len = field_value_len;
+}
+
+void nghttp2_frame_priority_update_free(nghttp2_extension *frame,
+                                        nghttp2_mem *mem) {
+  nghttp2_ext_priority_update *priority_update;
+
+  priority_update = frame->payload;
+  if (priority_update == NULL) {
+    return;
+  }
+  nghttp2_mem_free(mem, priority_update->field_value);
+}
+
 size_t nghttp2_frame_priority_len(uint8_t flags) {
   if (flags & NGHTTP2_FLAG_PRIORITY) {
     return NGHTTP2_PRIORITY_SPECLEN;
@@ -335,6 +361,12 @@ static int frame_pack_headers_shared(nghttp2_bufs *bufs,
 
 int nghttp2_frame_pack_headers(nghttp2_bufs *bufs, nghttp2_headers *frame,
                                nghttp2_hd_deflater *deflater) {
+  return nghttp2_frame_pack_headers2(bufs, frame, NULL, deflater);
+}
+
+int nghttp2_frame_pack_headers2(nghttp2_bufs *bufs, nghttp2_headers *frame,
+                                nghttp2_hd_template *tmpl,
+                                nghttp2_hd_deflater *deflater) {
   size_t nv_offset;
   int rv;
   nghttp2_buf *buf;
@@ -349,7 +381,8 @@ int nghttp2_frame_pack_headers(nghttp2_bufs *bufs, nghttp2_headers *frame,
   buf->last = buf->pos;
 
   /* This call will adjust buf->last to the correct position */
-  rv = nghttp2_hd_deflate_hd_bufs(deflater, bufs, frame->nva, frame->nvlen);
+  rv = nghttp2_hd_deflate_hd_template_bufs(deflater, bufs, tmpl, frame->nva,
+                                           frame->nvlen);
 
   if (rv == NGHTTP2_ERR_BUFFER_ERROR) {
     rv = NGHTTP2_ERR_HEADER_COMP;
@@ -876,6 +909,57 @@ int nghttp2_frame_unpack_origin_payload(nghttp2_extension *frame,
   return 0;
 }
 
+int nghttp2_frame_pack_priority_update(nghttp2_bufs *bufs,
+                                       nghttp2_extension *frame) {
+  int rv;
+  nghttp2_buf *buf;
+  nghttp2_ext_priority_update *priority_update;
+
+  /* This is required with --disable-assert. */
+  (void)rv;
+
+  priority_update = frame->payload;
+
+  buf = &bufs->head->buf;
+
+  assert(nghttp2_buf_avail(buf) >= 4 + priority_update->field_value_len);
+
+  buf->pos -= NGHTTP2_FRAME_HDLEN;
+
+  nghttp2_frame_pack_frame_hd(buf->pos, &frame->hd);
+
+  nghttp2_put_uint32be(buf->last, (uint32_t)priority_update->stream_id);
+  buf->last += 4;
+
+  rv = nghttp2_bufs_add(bufs, priority_update->field_value,
+                        priority_update->field_value_len);
+
+  assert(rv == 0);
+
+  return 0;
+}
+
+void nghttp2_frame_unpack_priority_update_payload(nghttp2_extension *frame,
+                                                  uint8_t *payload,
+                                                  size_t payloadlen) {
+  nghttp2_ext_priority_update *priority_update;
+
+  assert(payloadlen >= 4);
+
+  priority_update = frame->payload;
+
+  priority_update->stream_id =
+      nghttp2_get_uint32(payload) & NGHTTP2_STREAM_ID_MASK;
+
+  if (payloadlen > 4) {
+    priority_update->field_value = payload + 4;
+    priority_update->field_value_len = payloadlen - 4;
+  } else {
+    priority_update->field_value = NULL;
+    priority_update->field_value_len = 0;
+  }
+}
+
 nghttp2_settings_entry *nghttp2_frame_iv_copy(const nghttp2_settings_entry *iv,
                                               size_t niv, nghttp2_mem *mem) {
   nghttp2_settings_entry *iv_copy;
@@ -906,6 +990,16 @@ void nghttp2_nv_array_del(nghttp2_nv *nva, nghttp2_mem *mem) {
   nghttp2_mem_free(mem, nva);
 }
 
+void nghttp2_nv_array_del2(nghttp2_nv *nva, nghttp2_objpool *pool,
+                           nghttp2_mem *mem) {
+  if (pool) {
+    nghttp2_objpool_put(pool, nva);
+    return;
+  }
+
+  nghttp2_mem_free(mem, nva);
+}
+
 static int bytes_compar(const uint8_t *a, size_t alen, const uint8_t *b,
                         size_t blen) {
   int rv;
@@ -957,6 +1051,14 @@ void nghttp2_nv_array_sort(nghttp2_nv *nva, size_t nvlen) {
 
 int nghttp2_nv_array_copy(nghttp2_nv **nva_ptr, const nghttp2_nv *nva,
                           size_t nvlen, nghttp2_mem *mem) {
+  nghttp2_objpool *pool = NULL;
+
+  return nghttp2_nv_array_copy2(nva_ptr, &pool, nva, nvlen, mem);
+}
+
+int nghttp2_nv_array_copy2(nghttp2_nv **nva_ptr, nghttp2_objpool **pool_ptr,
+                           const nghttp2_nv *nva, size_t nvlen,
+                           nghttp2_mem *mem) {
   size_t i;
   uint8_t *data = NULL;
   size_t buflen = 0;
@@ -964,6 +1066,7 @@ int nghttp2_nv_array_copy(nghttp2_nv **nva_ptr, const nghttp2_nv *nva,
 
   if (nvlen == 0) {
     *nva_ptr = NULL;
+    *pool_ptr = NULL;
 
     return 0;
   }
@@ -980,7 +1083,12 @@ int nghttp2_nv_array_copy(nghttp2_nv **nva_ptr, const nghttp2_nv *nva,
 
   buflen += sizeof(nghttp2_nv) * nvlen;
 
-  *nva_ptr = nghttp2_mem_malloc(mem, buflen);
+  if (*pool_ptr && buflen <= (*pool_ptr)->objsize) {
+    *nva_ptr = nghttp2_objpool_get(*pool_ptr);
+  } else {
+    *pool_ptr = NULL;
+    *nva_ptr = nghttp2_mem_malloc(mem, buflen);
+  }
 
   if (*nva_ptr == NULL) {
     return NGHTTP2_ERR_NOMEM;
@@ -1050,6 +1158,11 @@ int nghttp2_iv_check(const nghttp2_settings_entry *iv, size_t niv) {
       break;
     case NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE:
       break;
+    case NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES:
+      if (iv[i].value != 0 && iv[i].value != 1) {
+        return 0;
+      }
+      break;
     }
   }
   return 1;
@@ -32,6 +32,7 @@
 #include <nghttp2/nghttp2.h>
 #include "nghttp2_hd.h"
 #include "nghttp2_buf.h"
+#include "nghttp2_objpool.h"
 
 #define NGHTTP2_STREAM_ID_MASK ((1u << 31) - 1)
 #define NGHTTP2_PRI_GROUP_ID_MASK ((1u << 31) - 1)
@@ -73,6 +74,7 @@
 typedef union {
   nghttp2_ext_altsvc altsvc;
   nghttp2_ext_origin origin;
+  nghttp2_ext_priority_update priority_update;
 } nghttp2_ext_frame_payload;
 
 void nghttp2_frame_pack_frame_hd(uint8_t *buf, const nghttp2_frame_hd *hd);
@@ -138,6 +140,15 @@ size_t nghttp2_frame_headers_payload_nv_offset(nghttp2_headers *frame);
 int nghttp2_frame_pack_headers(nghttp2_bufs *bufs, nghttp2_headers *frame,
                                nghttp2_hd_deflater *deflater);
 
+/*
+ * Like nghttp2_frame_pack_headers(), but the header fields in |tmpl|
+ * are also packed.  See nghttp2_hd_deflate_hd_template_bufs() for
+ * their order.  |tmpl| may be NULL.
+ */
+int nghttp2_frame_pack_headers2(nghttp2_bufs *bufs, nghttp2_headers *frame,
+                                nghttp2_hd_template *tmpl,
+                                nghttp2_hd_deflater *deflater);
+
 /*
  * Unpacks HEADERS frame byte sequence into |frame|.  This function
  * only unapcks bytes that come before name/value header block and
@@ -423,6 +434,30 @@ int nghttp2_frame_pack_origin(nghttp2_bufs *bufs, nghttp2_extension *ext);
 int nghttp2_frame_unpack_origin_payload(nghttp2_extension *frame,
                                         const uint8_t *payload,
                                         size_t payloadlen, nghttp2_mem *mem);
+
+/*
+ * Packs PRIORITY_UPDATE frame |frame| in wire frame format and store
+ * it in |bufs|.
+ *
+ * The caller must make sure that nghttp2_bufs_reset(bufs) is called
+ * before calling this function.
+ *
+ * This function always succeeds and returns 0.
+ */
+int nghttp2_frame_pack_priority_update(nghttp2_bufs *bufs,
+                                       nghttp2_extension *ext);
+
+/*
+ * Unpacks PRIORITY_UPDATE wire format into |frame|.  The |payload| of
+ * |payloadlen| bytes contains frame payload.  This function assumes
+ * that frame->payload points to the nghttp2_ext_priority_update
+ * object.  The caller must make sure that |payloadlen| >= 4.  The
+ * field value points into |payload| directly, so |payload| must
+ * outlive |frame|.
+ */
+void nghttp2_frame_unpack_priority_update_payload(nghttp2_extension *frame,
+                                                  uint8_t *payload,
+                                                  size_t payloadlen);
 /*
  * Initializes HEADERS frame |frame| with given values.  |frame| takes
  * ownership of |nva|, so caller must not free it. If |stream_id| is
@@ -538,6 +573,26 @@ void nghttp2_frame_origin_init(nghttp2_extension *frame,
  */
 void nghttp2_frame_origin_free(nghttp2_extension *frame, nghttp2_mem *mem);
 
+/*
+ * Initializes PRIORITY_UPDATE frame |frame| with given values.  This
+ * function assumes that frame->payload points to
+ * nghttp2_ext_priority_update object.  On success, this function
+ * takes ownership of |field_value|, so caller must not free it.
+ */
+void nghttp2_frame_priority_update_init(nghttp2_extension *frame,
+                                        int32_t stream_id,
+                                        uint8_t *field_value,
+                                        size_t field_value_len);
+
+/*
+ * Frees up resources under |frame|.  This function does not free
+ * nghttp2_ext_priority_update object pointed by frame->payload.  This
+ * function only frees field_value pointed by
+ * nghttp2_ext_priority_update.field_value.
+ */
+void nghttp2_frame_priority_update_free(nghttp2_extension *frame,
+                                        nghttp2_mem *mem);
+
 /*
  * Returns the number of padding bytes after payload.  The total
  * padding length is given in the |padlen|.  The returned value does
@@ -583,6 +638,23 @@ void nghttp2_nv_array_sort(nghttp2_nv *nva, size_t nvlen);
 int nghttp2_nv_array_copy(nghttp2_nv **nva_ptr, const nghttp2_nv *nva,
                           size_t nvlen, nghttp2_mem *mem);
 
+/*
+ * Like nghttp2_nv_array_copy(), but takes the buffer from |*pool_ptr|
+ * if it is not NULL, and the copy fits in (*pool_ptr)->objsize bytes.
+ * Otherwise, |*pool_ptr| is set to NULL, and the buffer is allocated
+ * by |mem|.  The |*nva_ptr| must be freed by nghttp2_nv_array_del2()
+ * with |*pool_ptr|.
+ *
+ * This function returns 0 if it succeeds or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ */
+int nghttp2_nv_array_copy2(nghttp2_nv **nva_ptr, nghttp2_objpool **pool_ptr,
+                           const nghttp2_nv *nva, size_t nvlen,
+                           nghttp2_mem *mem);
+
 /*
  * Returns nonzero if the name/value pair |a| equals to |b|. The name
  * is compared in case-sensitive, because we ensure that this function
@@ -595,6 +667,13 @@ int nghttp2_nv_equal(const nghttp2_nv *a, const nghttp2_nv *b);
  */
 void nghttp2_nv_array_del(nghttp2_nv *nva, nghttp2_mem *mem);
 
+/*
+ * Frees |nva| allocated by nghttp2_nv_array_copy2().  If |pool| is
+ * not NULL, |nva| is returned to |pool|.
+ */
+void nghttp2_nv_array_del2(nghttp2_nv *nva, nghttp2_objpool *pool,
+                           nghttp2_mem *mem);
+
 /*
  * Checks that the |iv|, which includes |niv| entries, does not have
  * invalid values.
@@ -35,8 +35,8 @@
 /* Make scalar initialization form of nghttp2_hd_entry */
 #define MAKE_STATIC_ENT(N, V, T, H)                                            \
   {                                                                            \
-    {NULL, NULL, (uint8_t *)(N), sizeof((N)) - 1, -1},                         \
-        {NULL, NULL, (uint8_t *)(V), sizeof((V)) - 1, -1},                     \
+    {NULL, NULL, (uint8_t *)(N), sizeof((N)) - 1, -1, 0},                      \
+        {NULL, NULL, (uint8_t *)(V), sizeof((V)) - 1, -1, 0},                  \
         {(uint8_t *)(N), (uint8_t *)(V), sizeof((N)) - 1, sizeof((V)) - 1, 0}, \
         T, H                                                                   \
   }
@@ -269,6 +269,11 @@ static int32_t lookup_token(const uint8_t *name, size_t namelen) {
         return NGHTTP2_TOKEN_LOCATION;
       }
       break;
+    case 'y':
+      if (memeq("priorit", name, 7)) {
+        return NGHTTP2_TOKEN_PRIORITY;
+      }
+      break;
     }
     break;
   case 10:
@@ -705,6 +710,12 @@ int nghttp2_hd_deflate_init2(nghttp2_hd_deflater *deflater,
   deflater->deflate_hd_table_bufsize_max = max_deflate_dynamic_table_size;
   deflater->min_hd_table_bufsize_max = UINT32_MAX;
 
+  deflater->indexing_callback = NULL;
+  deflater->indexing_callback_user_data = NULL;
+  deflater->sketch = NULL;
+
+  memset(&deflater->stats, 0, sizeof(deflater->stats));
+
   return 0;
 }
 
@@ -730,6 +741,7 @@ int nghttp2_hd_inflate_init(nghttp2_hd_inflater *inflater, nghttp2_mem *mem) {
 
   inflater->namercbuf = NULL;
   inflater->valuercbuf = NULL;
+  inflater->spare_rcbuf = NULL;
 
   inflater->huffman_encoded = 0;
   inflater->index = 0;
@@ -737,6 +749,9 @@ int nghttp2_hd_inflate_init(nghttp2_hd_inflater *inflater, nghttp2_mem *mem) {
   inflater->shift = 0;
   inflater->index_required = 0;
   inflater->no_index = 0;
+  inflater->zero_copy = 0;
+
+  memset(&inflater->stats, 0, sizeof(inflater->stats));
 
   return 0;
 
@@ -745,7 +760,16 @@ fail:
 }
 
 static void hd_inflate_keep_free(nghttp2_hd_inflater *inflater) {
-  nghttp2_rcbuf_decref(inflater->nv_value_keep);
+  nghttp2_rcbuf *rcbuf = inflater->nv_value_keep;
+
+  /* Nobody else refers to the borrowed value.  Keep the object for
+     the next borrowed value. */
+  if (rcbuf && nghttp2_rcbuf_is_borrowed(rcbuf) && rcbuf->ref == 1 &&
+      inflater->spare_rcbuf == NULL) {
+    inflater->spare_rcbuf = rcbuf;
+  } else {
+    nghttp2_rcbuf_decref(rcbuf);
+  }
   nghttp2_rcbuf_decref(inflater->nv_name_keep);
 
   inflater->nv_value_keep = NULL;
@@ -753,6 +777,7 @@ static void hd_inflate_keep_free(nghttp2_hd_inflater *inflater) {
 }
 
 void nghttp2_hd_deflate_free(nghttp2_hd_deflater *deflater) {
+  nghttp2_mem_free(deflater->ctx.mem, deflater->sketch);
   hd_context_free(&deflater->ctx);
 }
 
@@ -761,6 +786,7 @@ void nghttp2_hd_inflate_free(nghttp2_hd_inflater *inflater) {
 
   nghttp2_rcbuf_decref(inflater->valuercbuf);
   nghttp2_rcbuf_decref(inflater->namercbuf);
+  nghttp2_rcbuf_decref(inflater->spare_rcbuf);
 
   hd_context_free(&inflater->ctx);
 }
@@ -770,8 +796,8 @@ static size_t entry_room(size_t namelen, size_t valuelen) {
 }
 
 static void emit_header(nghttp2_hd_nv *nv_out, nghttp2_hd_nv *nv) {
-  DEBUGF("inflatehd: header emission: %s: %s\n", nv->name->base,
-         nv->value->base);
+  DEBUGF("inflatehd: header emission: %.*s: %.*s\n", (int)nv->name->len,
+         nv->name->base, (int)nv->value->len, nv->value->base);
   /* ent->ref may be 0. This happens if the encoder emits literal
      block larger than header table capacity with indexing. */
   *nv_out = *nv;
@@ -1324,38 +1350,125 @@ static int hd_deflate_decide_indexing(nghttp2_hd_deflater *deflater,
   return NGHTTP2_HD_WITH_INDEXING;
 }
 
-static int deflate_nv(nghttp2_hd_deflater *deflater, nghttp2_bufs *bufs,
-                      const nghttp2_nv *nv) {
-  int rv;
-  search_result res;
-  ssize_t idx;
-  int indexing_mode;
-  int32_t token;
-  nghttp2_mem *mem;
-  uint32_t hash = 0;
+static void hd_sketch_decay(nghttp2_hd_sketch *sketch) {
+  size_t i, j;
 
-  DEBUGF("deflatehd: deflating %.*s: %.*s\n", (int)nv->namelen, nv->name,
-         (int)nv->valuelen, nv->value);
+  for (i = 0; i < NGHTTP2_HD_SKETCH_DEPTH; ++i) {
+    for (j = 0; j < NGHTTP2_HD_SKETCH_WIDTH; ++j) {
+      sketch->nv[i][j] >>= 1;
+    }
+  }
 
-  mem = deflater->ctx.mem;
+  for (i = 0; i < NGHTTP2_HD_SKETCH_NAME_WIDTH; ++i) {
+    sketch->name_seen[i] >>= 1;
+    sketch->name_repeat[i] >>= 1;
+  }
 
-  token = lookup_token(nv->name, nv->namelen);
+  sketch->nrecord = 0;
+}
+
+/*
+ * Records |nv| in |sketch|, and returns indexing mode chosen from
+ * the recurrence of |nv| and its name.  The |name_key| identifies the
+ * name of |nv|.  If there is not enough data, this function returns
+ * |suggested|.
+ */
+static int hd_sketch_decide_indexing(nghttp2_hd_sketch *sketch,
+                                     const nghttp2_nv *nv, uint32_t name_key,
+                                     int suggested) {
+  /* 32 bit FNV-1a: http://isthe.com/chongo/tech/comp/fnv/ */
+  uint32_t h = 2166136261u ^ name_key;
+  size_t i, idx[NGHTTP2_HD_SKETCH_DEPTH];
+  uint8_t est;
+  size_t name_idx;
+
+  for (i = 0; i < nv->valuelen; ++i) {
+    h ^= nv->value[i];
+    h += (h << 1) + (h << 4) + (h << 7) + (h << 8) + (h << 24);
+  }
+
+  /* Derive the index of each row from the different bits of
+     Fibonacci hashed value. */
+  h *= 2654435769u;
+  for (i = 0; i < NGHTTP2_HD_SKETCH_DEPTH; ++i) {
+    idx[i] = (h >> (i * 11)) & (NGHTTP2_HD_SKETCH_WIDTH - 1);
+  }
+
+  est = UINT8_MAX;
+  for (i = 0; i < NGHTTP2_HD_SKETCH_DEPTH; ++i) {
+    est = nghttp2_min(est, sketch->nv[i][idx[i]]);
+  }
+
+  /* Conservative update: only the smallest counters are
+     incremented. */
+  if (est < UINT8_MAX) {
+    for (i = 0; i < NGHTTP2_HD_SKETCH_DEPTH; ++i) {
+      if (sketch->nv[i][idx[i]] == est) {
+        ++sketch->nv[i][idx[i]];
+      }
+    }
+  }
+
+  name_idx = (name_key * 2654435769u) >> 26;
+
+  if (sketch->name_seen[name_idx] == UINT8_MAX) {
+    sketch->name_seen[name_idx] >>= 1;
+    sketch->name_repeat[name_idx] >>= 1;
+  }
+
+  ++sketch->name_seen[name_idx];
+  if (est > 0) {
+    ++sketch->name_repeat[name_idx];
+  }
+
+  if (++sketch->nrecord == NGHTTP2_HD_SKETCH_DECAY_PERIOD) {
+    hd_sketch_decay(sketch);
+  }
+
+  if (est >= 2) {
+    return NGHTTP2_HD_WITH_INDEXING;
+  }
+
+  if (sketch->name_seen[name_idx] < NGHTTP2_HD_SKETCH_MIN_NAME_SEEN) {
+    return suggested;
+  }
+
+  if (sketch->name_repeat[name_idx] * 2 >= sketch->name_seen[name_idx]) {
+    return NGHTTP2_HD_WITH_INDEXING;
+  }
+
+  return NGHTTP2_HD_WITHOUT_INDEXING;
+}
+
+/*
+ * Returns the hash value of the name of |nv| used to look up the
+ * dynamic table.  |token| is the token of the name.
+ */
+static uint32_t hd_nv_hash(const nghttp2_nv *nv, int32_t token) {
   if (token == -1) {
-    hash = name_hash(nv);
-  } else if (token <= NGHTTP2_TOKEN_WWW_AUTHENTICATE) {
-    hash = static_table[token].hash;
+    return name_hash(nv);
   }
 
-  /* Don't index authorization header field since it may contain low
-     entropy secret data (e.g., id/password).  Also cookie header
-     field with less than 20 bytes value is also never indexed.  This
-     is the same criteria used in Firefox codebase. */
-  indexing_mode =
-      token == NGHTTP2_TOKEN_AUTHORIZATION ||
-              (token == NGHTTP2_TOKEN_COOKIE && nv->valuelen < 20) ||
-              (nv->flags & NGHTTP2_NV_FLAG_NO_INDEX)
-          ? NGHTTP2_HD_NEVER_INDEXING
-          : hd_deflate_decide_indexing(deflater, nv, token);
+  if (token <= NGHTTP2_TOKEN_WWW_AUTHENTICATE) {
+    return static_table[token].hash;
+  }
+
+  return 0;
+}
+
+/*
+ * Deflates |nv| into |bufs| using |indexing_mode|.  |token| and
+ * |hash| are the token and the hash value of the name of |nv|.
+ */
+static int deflate_nv_mode(nghttp2_hd_deflater *deflater, nghttp2_bufs *bufs,
+                           const nghttp2_nv *nv, int32_t token, uint32_t hash,
+                           int indexing_mode) {
+  int rv;
+  search_result res;
+  ssize_t idx;
+  nghttp2_mem *mem;
+
+  mem = deflater->ctx.mem;
 
   res = search_hd_table(&deflater->ctx, nv, token, indexing_mode,
                         &deflater->map, hash);
@@ -1363,6 +1476,9 @@ static int deflate_nv(nghttp2_hd_deflater *deflater, nghttp2_bufs *bufs,
   idx = res.index;
 
   if (res.name_value_match) {
+    if (idx >= (ssize_t)NGHTTP2_STATIC_TABLE_LENGTH) {
+      ++deflater->stats.num_dynamic_table_hits;
+    }
 
     DEBUGF("deflatehd: name/value match index=%zd\n", idx);
 
@@ -1422,35 +1538,177 @@ static int deflate_nv(nghttp2_hd_deflater *deflater, nghttp2_bufs *bufs,
   return 0;
 }
 
-int nghttp2_hd_deflate_hd_bufs(nghttp2_hd_deflater *deflater,
-                               nghttp2_bufs *bufs, const nghttp2_nv *nv,
-                               size_t nvlen) {
-  size_t i;
-  int rv = 0;
+static int deflate_nv(nghttp2_hd_deflater *deflater, nghttp2_bufs *bufs,
+                      const nghttp2_nv *nv) {
+  int indexing_mode;
+  int32_t token;
+  uint32_t hash;
 
-  if (deflater->ctx.bad) {
-    return NGHTTP2_ERR_HEADER_COMP;
-  }
+  DEBUGF("deflatehd: deflating %.*s: %.*s\n", (int)nv->namelen, nv->name,
+         (int)nv->valuelen, nv->value);
 
-  if (deflater->notify_table_size_change) {
-    size_t min_hd_table_bufsize_max;
+  ++deflater->stats.num_fields;
+  deflater->stats.uncompressed_bytes += nv->namelen + nv->valuelen;
 
-    min_hd_table_bufsize_max = deflater->min_hd_table_bufsize_max;
+  token = lookup_token(nv->name, nv->namelen);
+  hash = hd_nv_hash(nv, token);
 
-    deflater->notify_table_size_change = 0;
-    deflater->min_hd_table_bufsize_max = UINT32_MAX;
+  /* Don't index authorization header field since it may contain low
+     entropy secret data (e.g., id/password).  Also cookie header
+     field with less than 20 bytes value is also never indexed.  This
+     is the same criteria used in Firefox codebase. */
+  if (nv->flags & NGHTTP2_NV_FLAG_NO_INDEX) {
+    indexing_mode = NGHTTP2_HD_NEVER_INDEXING;
+  } else {
+    if (token == NGHTTP2_TOKEN_AUTHORIZATION ||
+        (token == NGHTTP2_TOKEN_COOKIE && nv->valuelen < 20)) {
+      indexing_mode = NGHTTP2_HD_NEVER_INDEXING;
+    } else {
+      indexing_mode = hd_deflate_decide_indexing(deflater, nv, token);
 
-    if (deflater->ctx.hd_table_bufsize_max > min_hd_table_bufsize_max) {
+      if (deflater->sketch &&
+          entry_room(nv->namelen, nv->valuelen) <=
+              deflater->ctx.hd_table_bufsize_max * 3 / 4) {
+        indexing_mode = hd_sketch_decide_indexing(
+            deflater->sketch, nv, token == -1 ? hash : (uint32_t)token,
+            indexing_mode);
+      }
+    }
 
-      rv = emit_table_size(bufs, min_hd_table_bufsize_max);
+    if (deflater->indexing_callback) {
+      indexing_mode = deflater->indexing_callback(
+          deflater, nv, indexing_mode, deflater->indexing_callback_user_data);
 
-      if (rv != 0) {
-        goto fail;
+      switch (indexing_mode) {
+      case NGHTTP2_HD_WITH_INDEXING:
+      case NGHTTP2_HD_WITHOUT_INDEXING:
+      case NGHTTP2_HD_NEVER_INDEXING:
+        break;
+      default:
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
       }
     }
+  }
+
+  return deflate_nv_mode(deflater, bufs, nv, token, hash, indexing_mode);
+}
+
+static int hd_deflate_emit_table_size_update(nghttp2_hd_deflater *deflater,
+                                             nghttp2_bufs *bufs) {
+  int rv;
+  size_t min_hd_table_bufsize_max;
+
+  if (!deflater->notify_table_size_change) {
+    return 0;
+  }
+
+  min_hd_table_bufsize_max = deflater->min_hd_table_bufsize_max;
+
+  deflater->notify_table_size_change = 0;
+  deflater->min_hd_table_bufsize_max = UINT32_MAX;
+
+  if (deflater->ctx.hd_table_bufsize_max > min_hd_table_bufsize_max) {
+
+    rv = emit_table_size(bufs, min_hd_table_bufsize_max);
+
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  return emit_table_size(bufs, deflater->ctx.hd_table_bufsize_max);
+}
+
+/*
+ * Deflates the |i|th header field of |tmpl| into |bufs|.
+ */
+static int deflate_template_nv(nghttp2_hd_deflater *deflater,
+                               nghttp2_bufs *bufs, nghttp2_hd_template *tmpl,
+                               size_t i) {
+  int rv;
+  const nghttp2_nv *nv = &tmpl->nva[i];
+  nghttp2_hd_template_field *field = &tmpl->fields[i];
+  nghttp2_hd_context *ctx = &deflater->ctx;
+  nghttp2_hd_entry *ent;
+  int exact_match;
+  int indexing_mode;
+
+  ++deflater->stats.num_fields;
+  deflater->stats.uncompressed_bytes += nv->namelen + nv->valuelen;
+
+  if (field->enclen) {
+    return nghttp2_bufs_add(bufs, tmpl->encbuf + field->encoff,
+                            field->enclen);
+  }
+
+  if (field->seq_valid) {
+    /* The dynamic table contains the entries whose sequence number is
+       in [next_seq - len, next_seq - 1]. */
+    size_t idx = ctx->next_seq - 1 - field->seq;
+
+    if (idx < ctx->hd_table.len) {
+      DEBUGF("deflatehd: template entry match index=%zu\n",
+             idx + NGHTTP2_STATIC_TABLE_LENGTH);
+
+      ++deflater->stats.num_dynamic_table_hits;
+
+      return emit_indexed_block(bufs, idx + NGHTTP2_STATIC_TABLE_LENGTH);
+    }
+
+    field->seq_valid = 0;
+  }
+
+  /* The dynamic table may have shrunk since |tmpl| was created. */
+  if (entry_room(nv->namelen, nv->valuelen) >
+      ctx->hd_table_bufsize_max * 3 / 4) {
+    indexing_mode = NGHTTP2_HD_WITHOUT_INDEXING;
+  } else {
+    indexing_mode = NGHTTP2_HD_WITH_INDEXING;
+  }
 
-    rv = emit_table_size(bufs, deflater->ctx.hd_table_bufsize_max);
+  rv = deflate_nv_mode(deflater, bufs, nv, field->token, field->hash,
+                       indexing_mode);
+  if (rv != 0) {
+    return rv;
+  }
 
+  ent = hd_map_find(&deflater->map, &exact_match, nv, field->token,
+                    field->hash, 0);
+  if (exact_match) {
+    field->seq = ent->seq;
+    field->seq_valid = 1;
+  }
+
+  return 0;
+}
+
+int nghttp2_hd_deflate_hd_template_bufs(nghttp2_hd_deflater *deflater,
+                                        nghttp2_bufs *bufs,
+                                        nghttp2_hd_template *tmpl,
+                                        const nghttp2_nv *nv, size_t nvlen) {
+  size_t i;
+  size_t buflen;
+  int rv;
+
+  if (tmpl == NULL) {
+    return nghttp2_hd_deflate_hd_bufs(deflater, bufs, nv, nvlen);
+  }
+
+  assert(tmpl->deflater == deflater);
+
+  if (deflater->ctx.bad) {
+    return NGHTTP2_ERR_HEADER_COMP;
+  }
+
+  buflen = nghttp2_bufs_len(bufs);
+
+  rv = hd_deflate_emit_table_size_update(deflater, bufs);
+  if (rv != 0) {
+    goto fail;
+  }
+
+  for (i = 0; i < tmpl->npseudo; ++i) {
+    rv = deflate_template_nv(deflater, bufs, tmpl, i);
     if (rv != 0) {
       goto fail;
     }
@@ -1463,8 +1721,52 @@ int nghttp2_hd_deflate_hd_bufs(nghttp2_hd_deflater *deflater,
     }
   }
 
+  for (i = tmpl->npseudo; i < tmpl->nvlen; ++i) {
+    rv = deflate_template_nv(deflater, bufs, tmpl, i);
+    if (rv != 0) {
+      goto fail;
+    }
+  }
+
+  deflater->stats.compressed_bytes += nghttp2_bufs_len(bufs) - buflen;
+
+  return 0;
+fail:
+  DEBUGF("deflatehd: error return %d\n", rv);
+
+  deflater->ctx.bad = 1;
+  return rv;
+}
+
+int nghttp2_hd_deflate_hd_bufs(nghttp2_hd_deflater *deflater,
+                               nghttp2_bufs *bufs, const nghttp2_nv *nv,
+                               size_t nvlen) {
+  size_t i;
+  size_t buflen;
+  int rv = 0;
+
+  if (deflater->ctx.bad) {
+    return NGHTTP2_ERR_HEADER_COMP;
+  }
+
+  buflen = nghttp2_bufs_len(bufs);
+
+  rv = hd_deflate_emit_table_size_update(deflater, bufs);
+  if (rv != 0) {
+    goto fail;
+  }
+
+  for (i = 0; i < nvlen; ++i) {
+    rv = deflate_nv(deflater, bufs, &nv[i]);
+    if (rv != 0) {
+      goto fail;
+    }
+  }
+
   DEBUGF("deflatehd: all input name/value pairs were deflated\n");
 
+  deflater->stats.compressed_bytes += nghttp2_bufs_len(bufs) - buflen;
+
   return 0;
 fail:
   DEBUGF("deflatehd: error return %d\n", rv);
@@ -1610,6 +1912,178 @@ void nghttp2_hd_deflate_del(nghttp2_hd_deflater *deflater) {
   nghttp2_mem_free(mem, deflater);
 }
 
+int nghttp2_hd_template_new(nghttp2_hd_template **tmpl_ptr,
+                            nghttp2_hd_deflater *deflater, nghttp2_nv *nva_copy,
+                            size_t nvlen, nghttp2_mem *mem) {
+  int rv;
+  nghttp2_hd_template *tmpl;
+  nghttp2_bufs bufs;
+  size_t i, npseudo;
+  ssize_t enclen;
+
+  for (npseudo = 0; npseudo < nvlen; ++npseudo) {
+    if (nva_copy[npseudo].namelen == 0 || nva_copy[npseudo].name[0] != ':') {
+      break;
+    }
+  }
+
+  for (i = npseudo; i < nvlen; ++i) {
+    if (nva_copy[i].namelen > 0 && nva_copy[i].name[0] == ':') {
+      nghttp2_mem_free(mem, nva_copy);
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+  }
+
+  tmpl = nghttp2_mem_calloc(mem, 1, sizeof(nghttp2_hd_template));
+  if (tmpl == NULL) {
+    rv = NGHTTP2_ERR_NOMEM;
+    goto fail_tmpl;
+  }
+
+  if (nvlen) {
+    tmpl->fields =
+        nghttp2_mem_calloc(mem, nvlen, sizeof(nghttp2_hd_template_field));
+    if (tmpl->fields == NULL) {
+      rv = NGHTTP2_ERR_NOMEM;
+      goto fail_fields;
+    }
+  }
+
+  tmpl->bound = nghttp2_hd_deflate_bound(deflater, nva_copy, nvlen);
+
+  rv = nghttp2_bufs_init(&bufs, 4096, tmpl->bound / 4096 + 1, mem);
+  if (rv != 0) {
+    goto fail_bufs;
+  }
+
+  /* Encode the header fields whose representation does not depend on
+     the dynamic table. */
+  for (i = 0; i < nvlen; ++i) {
+    nghttp2_nv *nv = &nva_copy[i];
+    nghttp2_hd_template_field *field = &tmpl->fields[i];
+    size_t offset = nghttp2_bufs_len(&bufs);
+    search_result res = {-1, 0};
+    int indexing_mode;
+
+    field->token = lookup_token(nv->name, nv->namelen);
+    field->hash = hd_nv_hash(nv, field->token);
+
+    if ((nv->flags & NGHTTP2_NV_FLAG_NO_INDEX) ||
+        field->token == NGHTTP2_TOKEN_AUTHORIZATION ||
+        (field->token == NGHTTP2_TOKEN_COOKIE && nv->valuelen < 20)) {
+      indexing_mode = NGHTTP2_HD_NEVER_INDEXING;
+    } else if (entry_room(nv->namelen, nv->valuelen) >
+               deflater->deflate_hd_table_bufsize_max * 3 / 4) {
+      indexing_mode = NGHTTP2_HD_WITHOUT_INDEXING;
+    } else {
+      indexing_mode = NGHTTP2_HD_WITH_INDEXING;
+    }
+
+    if (field->token >= 0 && field->token <= NGHTTP2_TOKEN_WWW_AUTHENTICATE) {
+      res = search_static_table(nv, field->token,
+                                indexing_mode == NGHTTP2_HD_NEVER_INDEXING);
+    }
+
+    if (res.name_value_match) {
+      rv = emit_indexed_block(&bufs, (size_t)res.index);
+    } else if (indexing_mode == NGHTTP2_HD_WITH_INDEXING) {
+      /* Added to the dynamic table when it is first emitted, unless
+         the table is too small by then */
+      continue;
+    } else if (res.index == -1) {
+      rv = emit_newname_block(&bufs, nv, indexing_mode);
+    } else {
+      rv = emit_indname_block(&bufs, (size_t)res.index, nv, indexing_mode);
+    }
+
+    if (rv != 0) {
+      goto fail_encode;
+    }
+
+    field->encoff = offset;
+    field->enclen = nghttp2_bufs_len(&bufs) - offset;
+  }
+
+  enclen = nghttp2_bufs_remove(&bufs, &tmpl->encbuf);
+  if (enclen < 0) {
+    rv = (int)enclen;
+    goto fail_encode;
+  }
+
+  nghttp2_bufs_free(&bufs);
+
+  tmpl->mem = mem;
+  tmpl->deflater = deflater;
+  tmpl->nva = nva_copy;
+  tmpl->nvlen = nvlen;
+  tmpl->npseudo = npseudo;
+  tmpl->ref = 1;
+
+  *tmpl_ptr = tmpl;
+
+  return 0;
+
+fail_encode:
+  nghttp2_bufs_free(&bufs);
+fail_bufs:
+  nghttp2_mem_free(mem, tmpl->fields);
+fail_fields:
+  nghttp2_mem_free(mem, tmpl);
+fail_tmpl:
+  nghttp2_mem_free(mem, nva_copy);
+
+  return rv;
+}
+
+void nghttp2_hd_template_incref(nghttp2_hd_template *tmpl) { ++tmpl->ref; }
+
+void nghttp2_hd_template_decref(nghttp2_hd_template *tmpl) {
+  nghttp2_mem *mem;
+
+  if (tmpl == NULL || --tmpl->ref > 0) {
+    return;
+  }
+
+  mem = tmpl->mem;
+
+  nghttp2_mem_free(mem, tmpl->encbuf);
+  nghttp2_mem_free(mem, tmpl->fields);
+  nghttp2_mem_free(mem, tmpl->nva);
+  nghttp2_mem_free(mem, tmpl);
+}
+
+void nghttp2_hd_deflate_set_indexing_callback(
+    nghttp2_hd_deflater *deflater, nghttp2_hd_deflate_indexing_callback cb,
+    void *user_data) {
+  deflater->indexing_callback = cb;
+  deflater->indexing_callback_user_data = user_data;
+}
+
+int nghttp2_hd_deflate_set_adaptive_indexing(nghttp2_hd_deflater *deflater,
+                                             int val) {
+  nghttp2_mem *mem;
+
+  mem = deflater->ctx.mem;
+
+  if (!val) {
+    nghttp2_mem_free(mem, deflater->sketch);
+    deflater->sketch = NULL;
+
+    return 0;
+  }
+
+  if (deflater->sketch) {
+    return 0;
+  }
+
+  deflater->sketch = nghttp2_mem_calloc(mem, 1, sizeof(nghttp2_hd_sketch));
+  if (deflater->sketch == NULL) {
+    return NGHTTP2_ERR_NOMEM;
+  }
+
+  return 0;
+}
+
 static void hd_inflate_set_huffman_encoded(nghttp2_hd_inflater *inflater,
                                            const uint8_t *in) {
   inflater->huffman_encoded = (*in & (1 << 7)) != 0;
@@ -1711,6 +2185,35 @@ static ssize_t hd_inflate_read(nghttp2_hd_inflater *inflater, nghttp2_buf *buf,
   return (ssize_t)len;
 }
 
+/*
+ * Makes inflater->valuercbuf refer to the header value of length
+ * inflater->left at |in| without copying it.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *   Out of memory
+ */
+static int hd_inflate_borrow_value(nghttp2_hd_inflater *inflater,
+                                   const uint8_t *in) {
+  nghttp2_rcbuf *rcbuf = inflater->spare_rcbuf;
+
+  if (rcbuf == NULL) {
+    return nghttp2_rcbuf_new_borrowed(&inflater->valuercbuf, in,
+                                      inflater->left, inflater->ctx.mem);
+  }
+
+  inflater->spare_rcbuf = NULL;
+
+  rcbuf->base = (uint8_t *)in;
+  rcbuf->len = inflater->left;
+
+  inflater->valuercbuf = rcbuf;
+
+  return 0;
+}
+
 /*
  * Finalize indexed header representation reception.  The referenced
  * header is always emitted, and |*nv_out| is filled with that value.
@@ -1719,6 +2222,10 @@ static void hd_inflate_commit_indexed(nghttp2_hd_inflater *inflater,
                                       nghttp2_hd_nv *nv_out) {
   nghttp2_hd_nv nv = nghttp2_hd_table_get(&inflater->ctx, inflater->index);
 
+  if (inflater->index >= NGHTTP2_STATIC_TABLE_LENGTH) {
+    ++inflater->stats.num_dynamic_table_hits;
+  }
+
   emit_header(nv_out, &nv);
 }
 
@@ -1813,6 +2320,20 @@ static int hd_inflate_commit_indname(nghttp2_hd_inflater *inflater,
   return 0;
 }
 
+void nghttp2_hd_inflate_set_zero_copy(nghttp2_hd_inflater *inflater, int val) {
+  inflater->zero_copy = val != 0;
+}
+
+int nghttp2_hd_inflate_unborrow(nghttp2_hd_inflater *inflater) {
+  nghttp2_rcbuf *rcbuf = inflater->nv_value_keep;
+
+  if (rcbuf == NULL || rcbuf->ref == 1) {
+    return 0;
+  }
+
+  return nghttp2_rcbuf_unborrow(rcbuf, inflater->ctx.mem);
+}
+
 ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_inflater *inflater, nghttp2_nv *nv_out,
                               int *inflate_flags, uint8_t *in, size_t inlen,
                               int in_final) {
@@ -1846,10 +2367,10 @@ ssize_t nghttp2_hd_inflate_hd2(nghttp2_hd_inflater *inflater,
   return rv;
 }
 
-ssize_t nghttp2_hd_inflate_hd_nv(nghttp2_hd_inflater *inflater,
-                                 nghttp2_hd_nv *nv_out, int *inflate_flags,
-                                 const uint8_t *in, size_t inlen,
-                                 int in_final) {
+static ssize_t hd_inflate_hd_nv(nghttp2_hd_inflater *inflater,
+                                nghttp2_hd_nv *nv_out, int *inflate_flags,
+                                const uint8_t *in, size_t inlen,
+                                int in_final) {
   ssize_t rv = 0;
   const uint8_t *first = in;
   const uint8_t *last = in + inlen;
@@ -2087,6 +2608,38 @@ ssize_t nghttp2_hd_inflate_hd_nv(nghttp2_hd_inflater *inflater,
 
       DEBUGF("inflatehd: valuelen=%zu\n", inflater->left);
 
+      /* The value which is not added to the dynamic table can be
+         passed to the application as is, if it is not Huffman
+         encoded, and the whole value is in the input buffer. */
+      if (inflater->zero_copy && !inflater->huffman_encoded &&
+          !inflater->index_required &&
+          inflater->left <= (size_t)(last - in)) {
+        rv = hd_inflate_borrow_value(inflater, in);
+        if (rv != 0) {
+          goto fail;
+        }
+
+        in += inflater->left;
+        inflater->left = 0;
+
+        DEBUGF("inflatehd: value borrowed\n");
+
+        if (inflater->opcode == NGHTTP2_HD_OPCODE_NEWNAME) {
+          rv = hd_inflate_commit_newname(inflater, nv_out);
+        } else {
+          rv = hd_inflate_commit_indname(inflater, nv_out);
+        }
+
+        if (rv != 0) {
+          goto fail;
+        }
+
+        inflater->state = NGHTTP2_HD_STATE_OPCODE;
+        *inflate_flags |= NGHTTP2_HD_INFLATE_EMIT;
+
+        return (ssize_t)(in - first);
+      }
+
       if (inflater->huffman_encoded) {
         nghttp2_hd_huff_decode_context_init(&inflater->huff_decode_ctx);
 
@@ -2215,6 +2768,28 @@ fail:
   return rv;
 }
 
+ssize_t nghttp2_hd_inflate_hd_nv(nghttp2_hd_inflater *inflater,
+                                 nghttp2_hd_nv *nv_out, int *inflate_flags,
+                                 const uint8_t *in, size_t inlen,
+                                 int in_final) {
+  ssize_t rv;
+
+  rv = hd_inflate_hd_nv(inflater, nv_out, inflate_flags, in, inlen, in_final);
+  if (rv < 0) {
+    return rv;
+  }
+
+  inflater->stats.compressed_bytes += (size_t)rv;
+
+  if (*inflate_flags & NGHTTP2_HD_INFLATE_EMIT) {
+    ++inflater->stats.num_fields;
+    inflater->stats.uncompressed_bytes +=
+        nv_out->name->len + nv_out->value->len;
+  }
+
+  return rv;
+}
+
 int nghttp2_hd_inflate_end_headers(nghttp2_hd_inflater *inflater) {
   hd_inflate_keep_free(inflater);
   inflater->state = NGHTTP2_HD_STATE_INFLATE_START;
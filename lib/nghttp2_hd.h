@@ -111,6 +111,7 @@ typedef enum {
   NGHTTP2_TOKEN_KEEP_ALIVE,
   NGHTTP2_TOKEN_PROXY_CONNECTION,
   NGHTTP2_TOKEN_UPGRADE,
+  NGHTTP2_TOKEN_PRIORITY,
 } nghttp2_token;
 
 struct nghttp2_hd_entry;
@@ -185,9 +186,9 @@ typedef enum {
 } nghttp2_hd_inflate_state;
 
 typedef enum {
-  NGHTTP2_HD_WITH_INDEXING,
-  NGHTTP2_HD_WITHOUT_INDEXING,
-  NGHTTP2_HD_NEVER_INDEXING
+  NGHTTP2_HD_WITH_INDEXING = NGHTTP2_HD_INDEXING_INCREMENTAL,
+  NGHTTP2_HD_WITHOUT_INDEXING = NGHTTP2_HD_INDEXING_NONE,
+  NGHTTP2_HD_NEVER_INDEXING = NGHTTP2_HD_INDEXING_NEVER
 } nghttp2_hd_indexing_mode;
 
 typedef struct {
@@ -215,20 +216,106 @@ typedef struct {
   nghttp2_hd_entry *table[HD_MAP_SIZE];
 } nghttp2_hd_map;
 
+/* The number of counters in each row of count-min sketch of
+   name/value pairs.  This must be power of 2. */
+#define NGHTTP2_HD_SKETCH_WIDTH 1024
+/* The number of rows of count-min sketch of name/value pairs */
+#define NGHTTP2_HD_SKETCH_DEPTH 2
+/* The number of per-name counters.  This must be power of 2. */
+#define NGHTTP2_HD_SKETCH_NAME_WIDTH 64
+/* All counters are halved after this number of header fields are
+   recorded, so that stale name/value pairs are forgotten. */
+#define NGHTTP2_HD_SKETCH_DECAY_PERIOD 512
+/* The minimum number of header fields with a given name before the
+   ratio of repeated ones is trusted. */
+#define NGHTTP2_HD_SKETCH_MIN_NAME_SEEN 8
+
+/* Recurrence statistics used by adaptive indexing */
+typedef struct {
+  /* Count-min sketch of name/value pairs */
+  uint8_t nv[NGHTTP2_HD_SKETCH_DEPTH][NGHTTP2_HD_SKETCH_WIDTH];
+  /* The number of header fields seen per name */
+  uint8_t name_seen[NGHTTP2_HD_SKETCH_NAME_WIDTH];
+  /* The number of header fields per name whose name/value pair had
+     been seen before */
+  uint8_t name_repeat[NGHTTP2_HD_SKETCH_NAME_WIDTH];
+  /* The number of header fields recorded since counters were halved
+     last time */
+  size_t nrecord;
+} nghttp2_hd_sketch;
+
+/* Counters maintained by the deflater and the inflater */
+typedef struct {
+  /* The number of bytes of header block produced or consumed */
+  uint64_t compressed_bytes;
+  /* The sum of the lengths of the names and the values */
+  uint64_t uncompressed_bytes;
+  /* The number of header fields */
+  uint64_t num_fields;
+  /* The number of header fields encoded as an index into the dynamic
+     table */
+  uint64_t num_dynamic_table_hits;
+} nghttp2_hd_stats;
+
 struct nghttp2_hd_deflater {
   nghttp2_hd_context ctx;
+  nghttp2_hd_stats stats;
   nghttp2_hd_map map;
   /* The upper limit of the header table size the deflater accepts. */
   size_t deflate_hd_table_bufsize_max;
   /* Minimum header table size notified in the next context update */
   size_t min_hd_table_bufsize_max;
+  /* Callback to override indexing decision, or NULL */
+  nghttp2_hd_deflate_indexing_callback indexing_callback;
+  void *indexing_callback_user_data;
+  /* Recurrence statistics, or NULL if adaptive indexing is
+     disabled. */
+  nghttp2_hd_sketch *sketch;
   /* If nonzero, send header table size using encoding context update
      in the next deflate process */
   uint8_t notify_table_size_change;
 };
 
+typedef struct {
+  /* The offset and the length of the pre-encoded representation of
+     the header field in nghttp2_hd_template.encbuf.  |enclen| is 0
+     if the representation depends on the dynamic table. */
+  size_t encoff;
+  size_t enclen;
+  /* The sequence number of the dynamic table entry which contains
+     the header field.  This is only valid if |seq_valid| is
+     nonzero. */
+  uint32_t seq;
+  /* The token and the hash value of the name */
+  int32_t token;
+  uint32_t hash;
+  uint8_t seq_valid;
+} nghttp2_hd_template_field;
+
+struct nghttp2_hd_template {
+  /* Doubly linked list of templates owned by the same session */
+  nghttp2_hd_template *prev, *next;
+  nghttp2_mem *mem;
+  /* The deflater which this template is used with */
+  nghttp2_hd_deflater *deflater;
+  /* The header fields.  Pseudo header fields come first. */
+  nghttp2_nv *nva;
+  nghttp2_hd_template_field *fields;
+  /* The buffer which stores pre-encoded representations */
+  uint8_t *encbuf;
+  size_t nvlen;
+  /* The number of pseudo header fields at the beginning of |nva| */
+  size_t npseudo;
+  /* The number of bytes nghttp2_hd_deflate_bound() returns for
+     |nva| */
+  size_t bound;
+  /* Reference count */
+  uint32_t ref;
+};
+
 struct nghttp2_hd_inflater {
   nghttp2_hd_context ctx;
+  nghttp2_hd_stats stats;
   /* Stores current state of huffman decoding */
   nghttp2_hd_huff_decode_context huff_decode_ctx;
   /* header buffer */
@@ -237,6 +324,9 @@ struct nghttp2_hd_inflater {
   /* Pointer to the name/value pair which are used in the current
      header emission. */
   nghttp2_rcbuf *nv_name_keep, *nv_value_keep;
+  /* nghttp2_rcbuf object which is reused for a borrowed header
+     value */
+  nghttp2_rcbuf *spare_rcbuf;
   /* The number of bytes to read */
   size_t left;
   /* The index in indexed repr or indexed name */
@@ -257,6 +347,8 @@ struct nghttp2_hd_inflater {
   /* nonzero if deflater requires that current entry must not be
      indexed */
   uint8_t no_index;
+  /* nonzero if header value may refer to the input buffer */
+  uint8_t zero_copy;
 };
 
 /*
@@ -333,6 +425,58 @@ int nghttp2_hd_deflate_hd_bufs(nghttp2_hd_deflater *deflater,
                                nghttp2_bufs *bufs, const nghttp2_nv *nva,
                                size_t nvlen);
 
+/*
+ * Deflates the header fields in |tmpl| and the |nva|, which has the
+ * |nvlen| name/value pairs, into the |bufs|.  The pseudo header
+ * fields in |tmpl| are emitted first, followed by |nva|, and then
+ * the remaining header fields in |tmpl|.  |tmpl| may be NULL.
+ *
+ * The header fields in |tmpl| are always indexed unless they must
+ * not be.  If they are found in the static table, or are not
+ * indexed, their pre-encoded representations are emitted as is.  If
+ * the dynamic table still contains the entry added for a header
+ * field in |tmpl|, the reference to it is emitted without searching
+ * the table.
+ *
+ * This function returns 0 if it succeeds, or one of the negative
+ * error codes nghttp2_hd_deflate_hd_bufs() returns.
+ */
+int nghttp2_hd_deflate_hd_template_bufs(nghttp2_hd_deflater *deflater,
+                                        nghttp2_bufs *bufs,
+                                        nghttp2_hd_template *tmpl,
+                                        const nghttp2_nv *nva, size_t nvlen);
+
+/*
+ * Creates new template which is used with |deflater|, and assigns
+ * its pointer to |*tmpl_ptr|.  This function takes ownership of
+ * |nva_copy| which must be allocated by nghttp2_nv_array_copy(), and
+ * has |nvlen| header fields.  The reference count of the template is
+ * initialized to 1.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_INVALID_ARGUMENT
+ *     A pseudo header field appears after a regular header field.
+ */
+int nghttp2_hd_template_new(nghttp2_hd_template **tmpl_ptr,
+                            nghttp2_hd_deflater *deflater, nghttp2_nv *nva_copy,
+                            size_t nvlen, nghttp2_mem *mem);
+
+/*
+ * Increments the reference count of |tmpl| by 1.
+ */
+void nghttp2_hd_template_incref(nghttp2_hd_template *tmpl);
+
+/*
+ * Decrements the reference count of |tmpl| by 1.  If the reference
+ * count becomes zero, |tmpl| is freed.  If |tmpl| is NULL, this
+ * function does nothing.
+ */
+void nghttp2_hd_template_decref(nghttp2_hd_template *tmpl);
+
 /*
  * Initializes |inflater| for inflating name/values pairs.
  *
@@ -359,6 +503,29 @@ ssize_t nghttp2_hd_inflate_hd_nv(nghttp2_hd_inflater *inflater,
                                  nghttp2_hd_nv *nv_out, int *inflate_flags,
                                  const uint8_t *in, size_t inlen, int in_final);
 
+/*
+ * Makes |inflater| pass a literal header value to the caller without
+ * copying it if |val| is nonzero.  The value which is not Huffman
+ * encoded nor added to the dynamic table is emitted as nghttp2_rcbuf
+ * referring to the input buffer if the whole value is contained in
+ * the buffer.  Such value is not NULL-terminated.  The caller must
+ * call nghttp2_hd_inflate_unborrow() after it is done with the
+ * emitted header field, and before the input buffer is gone.
+ */
+void nghttp2_hd_inflate_set_zero_copy(nghttp2_hd_inflater *inflater, int val);
+
+/*
+ * Copies the last emitted header value if it refers to the input
+ * buffer, and somebody other than |inflater| holds a reference to it.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *   Out of memory
+ */
+int nghttp2_hd_inflate_unborrow(nghttp2_hd_inflater *inflater);
+
 /* For unittesting purpose */
 int nghttp2_hd_emit_indname_block(nghttp2_bufs *bufs, size_t index,
                                   nghttp2_nv *nv, int indexing_mode);
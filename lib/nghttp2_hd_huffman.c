@@ -29,203 +29,229 @@
 #include <stdio.h>
 
 #include "nghttp2_hd.h"
+#include "nghttp2_net.h"
+
+size_t nghttp2_hd_huff_encode_count(const uint8_t *src, size_t len) {
+  size_t i;
+  size_t nbits = 0;
+
+  for (i = 0; i < len; ++i) {
+    nbits += huff_sym_table[src[i]].nbits;
+  }
+  /* pad the prefix of EOS (256) */
+  return (nbits + 7) / 8;
+}
 
 /*
- * Encodes huffman code |sym| into |*dest_ptr|, whose least |rembits|
- * bits are not filled yet.  The |rembits| must be in range [1, 8],
- * inclusive.  At the end of the process, the |*dest_ptr| is updated
- * and points where next output should be placed. The number of
- * unfilled bits in the pointed location is returned.
+ * Writes the leading |*pnbits| / 8 bytes of |*pcode| to |bufs| one
+ * byte at a time, expanding the chunk if necessary.  |*pcode| and
+ * |*pnbits| are updated to hold the remaining bits.
+ *
+ * This function returns 0 if it succeeds, or one of the negative
+ * error codes of nghttp2_bufs_addb().
  */
-static ssize_t huff_encode_sym(nghttp2_bufs *bufs, size_t *avail_ptr,
-                               size_t rembits, const nghttp2_huff_sym *sym) {
+static int huff_flush_slow(nghttp2_bufs *bufs, uint64_t *pcode,
+                           size_t *pnbits) {
   int rv;
-  size_t nbits = sym->nbits;
-  uint32_t code = sym->code;
 
-  /* We assume that sym->nbits <= 32 */
-  if (rembits > nbits) {
-    nghttp2_bufs_fast_orb_hold(bufs, (uint8_t)(code << (rembits - nbits)));
-    return (ssize_t)(rembits - nbits);
+  for (; *pnbits >= 8; *pnbits -= 8) {
+    rv = nghttp2_bufs_addb(bufs, (uint8_t)(*pcode >> 56));
+    if (rv != 0) {
+      return rv;
+    }
+    *pcode <<= 8;
   }
 
-  if (rembits == nbits) {
-    nghttp2_bufs_fast_orb(bufs, (uint8_t)code);
-    --*avail_ptr;
-    return 8;
-  }
+  return 0;
+}
+
+int nghttp2_hd_huff_encode(nghttp2_bufs *bufs, const uint8_t *src,
+                           size_t srclen) {
+  const nghttp2_huff_sym *sym;
+  const uint8_t *end = src + srclen;
+  /* The pending bits, aligned to MSB */
+  uint64_t code = 0;
+  size_t nbits = 0;
+  size_t avail;
+  uint32_t x;
+  int rv;
 
-  nghttp2_bufs_fast_orb(bufs, (uint8_t)(code >> (nbits - rembits)));
-  --*avail_ptr;
+  avail = nghttp2_bufs_cur_avail(bufs);
 
-  nbits -= rembits;
-  if (nbits & 0x7) {
-    /* align code to MSB byte boundary */
-    code <<= 8 - (nbits & 0x7);
-  }
+  for (; src != end;) {
+    sym = &huff_sym_table[*src++];
+    /* nbits < 32 and sym->nbits <= 30, so the code always fits */
+    code |= (uint64_t)sym->code << (64 - nbits - sym->nbits);
+    nbits += sym->nbits;
 
-  if (*avail_ptr < (nbits + 7) / 8) {
-    /* slow path */
-    if (nbits > 24) {
-      rv = nghttp2_bufs_addb(bufs, (uint8_t)(code >> 24));
-      if (rv != 0) {
-        return rv;
-      }
-      nbits -= 8;
+    if (nbits < 32) {
+      continue;
     }
-    if (nbits > 16) {
-      rv = nghttp2_bufs_addb(bufs, (uint8_t)(code >> 16));
-      if (rv != 0) {
-        return rv;
-      }
-      nbits -= 8;
-    }
-    if (nbits > 8) {
-      rv = nghttp2_bufs_addb(bufs, (uint8_t)(code >> 8));
-      if (rv != 0) {
-        return rv;
-      }
-      nbits -= 8;
-    }
-    if (nbits == 8) {
-      rv = nghttp2_bufs_addb(bufs, (uint8_t)code);
-      if (rv != 0) {
-        return rv;
-      }
-      *avail_ptr = nghttp2_bufs_cur_avail(bufs);
-      return 8;
+
+    if (avail >= 4) {
+      x = htonl((uint32_t)(code >> 32));
+      memcpy(bufs->cur->buf.last, &x, sizeof(x));
+      bufs->cur->buf.last += 4;
+      avail -= 4;
+      code <<= 32;
+      nbits -= 32;
+      continue;
     }
 
-    rv = nghttp2_bufs_addb_hold(bufs, (uint8_t)code);
+    /* slow path; the current chunk does not have enough space */
+    rv = huff_flush_slow(bufs, &code, &nbits);
     if (rv != 0) {
       return rv;
     }
-    *avail_ptr = nghttp2_bufs_cur_avail(bufs);
-    return (ssize_t)(8 - nbits);
-  }
-
-  /* fast path, since most code is less than 8 */
-  if (nbits < 8) {
-    nghttp2_bufs_fast_addb_hold(bufs, (uint8_t)code);
-    *avail_ptr = nghttp2_bufs_cur_avail(bufs);
-    return (ssize_t)(8 - nbits);
-  }
 
-  /* handle longer code path */
-  if (nbits > 24) {
-    nghttp2_bufs_fast_addb(bufs, (uint8_t)(code >> 24));
-    nbits -= 8;
+    avail = nghttp2_bufs_cur_avail(bufs);
   }
 
-  if (nbits > 16) {
-    nghttp2_bufs_fast_addb(bufs, (uint8_t)(code >> 16));
-    nbits -= 8;
+  for (; nbits >= 8 && avail; --avail, nbits -= 8) {
+    nghttp2_bufs_fast_addb(bufs, (uint8_t)(code >> 56));
+    code <<= 8;
   }
 
-  if (nbits > 8) {
-    nghttp2_bufs_fast_addb(bufs, (uint8_t)(code >> 8));
-    nbits -= 8;
+  rv = huff_flush_slow(bufs, &code, &nbits);
+  if (rv != 0) {
+    return rv;
   }
 
-  if (nbits == 8) {
-    nghttp2_bufs_fast_addb(bufs, (uint8_t)code);
-    *avail_ptr = nghttp2_bufs_cur_avail(bufs);
-    return 8;
+  if (nbits) {
+    /* 256 is special terminal symbol, pad with its prefix */
+    rv = nghttp2_bufs_addb(
+        bufs, (uint8_t)((uint8_t)(code >> 56) | ((1 << (8 - nbits)) - 1)));
+    if (rv != 0) {
+      return rv;
+    }
   }
 
-  nghttp2_bufs_fast_addb_hold(bufs, (uint8_t)code);
-  *avail_ptr = nghttp2_bufs_cur_avail(bufs);
-  return (ssize_t)(8 - nbits);
+  return 0;
 }
 
-size_t nghttp2_hd_huff_encode_count(const uint8_t *src, size_t len) {
-  size_t i;
-  size_t nbits = 0;
+void nghttp2_hd_huff_decode_context_init(nghttp2_hd_huff_decode_context *ctx) {
+  ctx->bits = 0;
+  ctx->nbits = 0;
+}
 
-  for (i = 0; i < len; ++i) {
-    nbits += huff_sym_table[src[i]].nbits;
+/*
+ * Returns the leading |n| bits of the |nbits| valid bits in |bits|.
+ * If |nbits| < |n|, the missing bits are filled with 1, which is the
+ * prefix of EOS.  The |n| must be in range [1, 32], inclusive.
+ */
+static uint32_t huff_peek_bits(uint64_t bits, size_t nbits, size_t n) {
+  if (nbits >= n) {
+    return (uint32_t)(bits >> (nbits - n)) & (uint32_t)((1ull << n) - 1);
   }
-  /* pad the prefix of EOS (256) */
-  return (nbits + 7) / 8;
+
+  return (uint32_t)(((bits << (n - nbits)) | ((1ull << (n - nbits)) - 1)) &
+                    ((1ull << n) - 1));
 }
 
-int nghttp2_hd_huff_encode(nghttp2_bufs *bufs, const uint8_t *src,
-                           size_t srclen) {
-  int rv;
-  ssize_t rembits = 8;
-  size_t i;
-  size_t avail;
+/*
+ * Decodes the symbol whose code is longer than
+ * NGHTTP2_HUFF_DECODE_BITS from the leading bits of |bits|, which
+ * contains |nbits| valid bits.  The number of bits of the code is
+ * assigned to |*plen|.  Because the code is canonical, the code of
+ * length L is in range [first, first + count) of
+ * huff_decode_long_table for L.
+ *
+ * This function returns the decoded symbol, which may be EOS (256).
+ */
+static uint16_t huff_decode_long(uint64_t bits, size_t nbits, size_t *plen) {
+  uint32_t code;
+  size_t len;
+  const nghttp2_huff_decode_long *t;
 
-  avail = nghttp2_bufs_cur_avail(bufs);
+  code = huff_peek_bits(bits, nbits, 30);
 
-  for (i = 0; i < srclen; ++i) {
-    const nghttp2_huff_sym *sym = &huff_sym_table[src[i]];
-    if (rembits == 8) {
-      if (avail) {
-        nghttp2_bufs_fast_addb_hold(bufs, 0);
-      } else {
-        rv = nghttp2_bufs_addb_hold(bufs, 0);
-        if (rv != 0) {
-          return rv;
-        }
-        avail = nghttp2_bufs_cur_avail(bufs);
-      }
-    }
-    rembits = huff_encode_sym(bufs, &avail, (size_t)rembits, sym);
-    if (rembits < 0) {
-      return (int)rembits;
+  for (len = NGHTTP2_HUFF_DECODE_BITS + 1;; ++len) {
+    uint32_t c = code >> (30 - len);
+
+    t = &huff_decode_long_table[len - NGHTTP2_HUFF_DECODE_BITS - 1];
+    if (c - t->first < t->count) {
+      *plen = len;
+      return huff_decode_canonical_sym_table[t->offset + c - t->first];
     }
   }
-  /* 256 is special terminal symbol, pad with its prefix */
-  if (rembits < 8) {
-    /* if rembits < 8, we should have at least 1 buffer space
-       available */
-    const nghttp2_huff_sym *sym = &huff_sym_table[256];
-    assert(avail);
-    /* Caution we no longer adjust avail here */
-    nghttp2_bufs_fast_orb(
-        bufs, (uint8_t)(sym->code >> (sym->nbits - (size_t)rembits)));
-  }
-
-  return 0;
-}
-
-void nghttp2_hd_huff_decode_context_init(nghttp2_hd_huff_decode_context *ctx) {
-  ctx->state = 0;
-  ctx->accept = 1;
 }
 
 ssize_t nghttp2_hd_huff_decode(nghttp2_hd_huff_decode_context *ctx,
                                nghttp2_buf *buf, const uint8_t *src,
                                size_t srclen, int final) {
-  size_t i;
+  const uint8_t *end = src + srclen;
+  const uint8_t *p = src;
+  uint64_t bits = ctx->bits;
+  size_t nbits = ctx->nbits;
+  const nghttp2_huff_decode *t;
+  size_t len;
+  uint16_t sym;
 
-  /* We use the decoding algorithm described in
-     http://graphics.ics.uci.edu/pub/Prefix.pdf */
-  for (i = 0; i < srclen; ++i) {
-    const nghttp2_huff_decode *t;
+  /* We look up NGHTTP2_HUFF_DECODE_BITS bits at a time, which emits
+     up to NGHTTP2_HUFF_DECODE_MAX_SYMS symbols.  The bits which do
+     not form a complete code are carried over to the next call in
+     |ctx|.  The longest code is 30 bits, and we refill |bits| up to
+     57 bits, so that we always have the complete code unless we run
+     out of input. */
+  for (;;) {
+    for (; nbits <= 56 && p != end; ++p) {
+      bits = (bits << 8) | *p;
+      nbits += 8;
+    }
 
-    t = &huff_decode_table[ctx->state][src[i] >> 4];
-    if (t->flags & NGHTTP2_HUFF_FAIL) {
-      return NGHTTP2_ERR_HEADER_COMP;
+    if (nbits == 0) {
+      break;
     }
-    if (t->flags & NGHTTP2_HUFF_SYM) {
-      *buf->last++ = t->sym;
+
+    t = &huff_decode_table[huff_peek_bits(bits, nbits,
+                                          NGHTTP2_HUFF_DECODE_BITS)];
+
+    if (t->nbits && t->nbits <= nbits) {
+      *buf->last++ = t->sym[0];
+      if (t->nbits != t->len0) {
+        *buf->last++ = t->sym[1];
+      }
+      nbits -= t->nbits;
+      continue;
     }
 
-    t = &huff_decode_table[t->state][src[i] & 0xf];
-    if (t->flags & NGHTTP2_HUFF_FAIL) {
-      return NGHTTP2_ERR_HEADER_COMP;
+    if (t->len0) {
+      if (t->len0 > nbits) {
+        break;
+      }
+      /* The second code is only partially available */
+      *buf->last++ = t->sym[0];
+      nbits -= t->len0;
+      continue;
     }
-    if (t->flags & NGHTTP2_HUFF_SYM) {
-      *buf->last++ = t->sym;
+
+    sym = huff_decode_long(bits, nbits, &len);
+    if (len > nbits) {
+      break;
+    }
+    if (sym == 256) {
+      /* EOS must not appear in the encoded string */
+      return NGHTTP2_ERR_HEADER_COMP;
     }
 
-    ctx->state = t->state;
-    ctx->accept = (t->flags & NGHTTP2_HUFF_ACCEPTED) != 0;
+    *buf->last++ = (uint8_t)sym;
+    nbits -= len;
   }
-  if (final && !ctx->accept) {
-    return NGHTTP2_ERR_HEADER_COMP;
+
+  /* Since we only break out of the loop if we need more bits than we
+     have and all input is consumed, |nbits| < 30 here. */
+  bits &= (1ull << nbits) - 1;
+
+  if (final) {
+    /* The padding must be strictly shorter than 8 bits, and must be
+       the most significant bits of EOS. */
+    if (nbits > 7 || bits != (1ull << nbits) - 1) {
+      return NGHTTP2_ERR_HEADER_COMP;
+    }
   }
-  return (ssize_t)i;
+
+  ctx->bits = bits;
+  ctx->nbits = nbits;
+
+  return (ssize_t)srclen;
 }
@@ -31,37 +31,39 @@
 
 #include <nghttp2/nghttp2.h>
 
-typedef enum {
-  /* FSA accepts this state as the end of huffman encoding
-     sequence. */
-  NGHTTP2_HUFF_ACCEPTED = 1,
-  /* This state emits symbol */
-  NGHTTP2_HUFF_SYM = (1 << 1),
-  /* If state machine reaches this state, decoding fails. */
-  NGHTTP2_HUFF_FAIL = (1 << 2)
-} nghttp2_huff_decode_flag;
+/* The number of bits looked up at once by the huffman decoder */
+#define NGHTTP2_HUFF_DECODE_BITS 12
+/* The maximum number of symbols emitted by one lookup */
+#define NGHTTP2_HUFF_DECODE_MAX_SYMS 2
 
 typedef struct {
-  /* huffman decoding state, which is actually the node ID of internal
-     huffman tree.  We have 257 leaf nodes, but they are identical to
-     root node other than emitting a symbol, so we have 256 internal
-     nodes [1..255], inclusive. */
-  uint8_t state;
-  /* bitwise OR of zero or more of the nghttp2_huff_decode_flag */
-  uint8_t flags;
-  /* symbol if NGHTTP2_HUFF_SYM flag set */
-  uint8_t sym;
+  /* The number of bits of the code of sym[0].  If it is 0, the code
+     of the first symbol is longer than NGHTTP2_HUFF_DECODE_BITS, and
+     it must be decoded using huff_decode_long_table. */
+  uint8_t len0;
+  /* The number of bits consumed by all symbols in sym.  If |nbits| ==
+     |len0|, only sym[0] is decoded. */
+  uint8_t nbits;
+  /* Decoded symbols */
+  uint8_t sym[NGHTTP2_HUFF_DECODE_MAX_SYMS];
 } nghttp2_huff_decode;
 
-typedef nghttp2_huff_decode huff_decode_table_type[16];
+typedef struct {
+  /* The first code of this length, aligned to LSB */
+  uint32_t first;
+  /* The number of codes of this length */
+  uint16_t count;
+  /* The index of the symbol of the |first| code in
+     huff_decode_canonical_sym_table */
+  uint16_t offset;
+} nghttp2_huff_decode_long;
 
 typedef struct {
-  /* Current huffman decoding state. We stripped leaf nodes, so the
-     value range is [0..255], inclusive. */
-  uint8_t state;
-  /* nonzero if we can say that the decoding process succeeds at this
-     state */
-  uint8_t accept;
+  /* Bits which are read but not decoded yet.  The valid bits are the
+     least |nbits| bits. */
+  uint64_t bits;
+  /* The number of valid bits in |bits| */
+  size_t nbits;
 } nghttp2_hd_huff_decode_context;
 
 typedef struct {
@@ -72,6 +74,11 @@ typedef struct {
 } nghttp2_huff_sym;
 
 extern const nghttp2_huff_sym huff_sym_table[];
-extern const nghttp2_huff_decode huff_decode_table[][16];
+/* Indexed by NGHTTP2_HUFF_DECODE_BITS bits of input */
+extern const nghttp2_huff_decode huff_decode_table[];
+/* Indexed by code length - NGHTTP2_HUFF_DECODE_BITS - 1 */
+extern const nghttp2_huff_decode_long huff_decode_long_table[];
+/* Symbols sorted by their codes */
+extern const uint16_t huff_decode_canonical_sym_table[];
 
 #endif /* NGHTTP2_HD_HUFFMAN_H */
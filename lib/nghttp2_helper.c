@@ -29,6 +29,25 @@
 
 #include "nghttp2_net.h"
 
+/* SIMD instruction sets used to validate header fields.  SSE2 and
+   NEON are selected at compile time.  AVX2 is compiled with the
+   function level target attribute, and selected at run time. */
+#if defined(__GNUC__) && defined(__SSE2__) &&                                 \
+    (defined(__x86_64__) || defined(__i386__))
+#  define NGHTTP2_HAVE_SSE2 1
+#  include <emmintrin.h>
+#  if defined(__clang__) || __GNUC__ >= 5
+#    define NGHTTP2_HAVE_AVX2 1
+#    define NGHTTP2_TARGET_AVX2 __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  endif /* defined(__clang__) || __GNUC__ >= 5 */
+#endif   /* defined(__GNUC__) && defined(__SSE2__) && ... */
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#  define NGHTTP2_HAVE_NEON 1
+#  include <arm_neon.h>
+#endif /* defined(__aarch64__) && defined(__ARM_NEON) */
+
 void nghttp2_put_uint16be(uint8_t *buf, uint16_t n) {
   uint16_t x = htons(n);
   memcpy(buf, &x, sizeof(uint16_t));
@@ -407,18 +426,8 @@ static const int VALID_HD_NAME_CHARS[] = {
     0 /* 0xfc */, 0 /* 0xfd */, 0 /* 0xfe */, 0 /* 0xff */
 };
 
-int nghttp2_check_header_name(const uint8_t *name, size_t len) {
+static int check_header_name_generic(const uint8_t *name, size_t len) {
   const uint8_t *last;
-  if (len == 0) {
-    return 0;
-  }
-  if (*name == ':') {
-    if (len == 1) {
-      return 0;
-    }
-    ++name;
-    --len;
-  }
   for (last = name + len; name != last; ++name) {
     if (!VALID_HD_NAME_CHARS[*name]) {
       return 0;
@@ -495,7 +504,7 @@ static const int VALID_HD_VALUE_CHARS[] = {
     1 /* 0xfc */, 1 /* 0xfd */, 1 /* 0xfe */, 1 /* 0xff */
 };
 
-int nghttp2_check_header_value(const uint8_t *value, size_t len) {
+static int check_header_value_generic(const uint8_t *value, size_t len) {
   const uint8_t *last;
   for (last = value + len; value != last; ++value) {
     if (!VALID_HD_VALUE_CHARS[*value]) {
@@ -505,6 +514,282 @@ int nghttp2_check_header_value(const uint8_t *value, size_t len) {
   return 1;
 }
 
+/*
+ * The vectorized versions of check_header_name_generic() and
+ * check_header_value_generic().  They require that |len| is at least
+ * the vector width, and validate the last block which may overlap
+ * the previous one instead of falling back to the byte by byte
+ * loop.
+ *
+ * Header field name is validated with nibble lookup if shuffle
+ * instruction is available: HD_NAME_LO_NIBBLE[c & 0xf] has bit (c >>
+ * 4) set if c is a valid header field name character.  Because all
+ * valid characters are less than 0x80, the bits for high nibble 8-15
+ * are always 0.
+ */
+#if defined(NGHTTP2_HAVE_AVX2) || defined(NGHTTP2_HAVE_NEON)
+static const uint8_t HD_NAME_LO_NIBBLE[] = {
+    0xc8, 0xcc, 0xc8, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,
+    0xc8, 0xc8, 0xc4, 0x44, 0xc0, 0x44, 0xe4, 0x60};
+
+static const uint8_t HD_NAME_HI_NIBBLE[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+                                            0x40, 0x80, 0,    0,    0,    0,
+                                            0,    0,    0,    0};
+#endif /* NGHTTP2_HAVE_AVX2 || NGHTTP2_HAVE_NEON */
+
+#ifdef NGHTTP2_HAVE_SSE2
+/*
+ * Returns the mask whose byte is 0xff if the corresponding byte in
+ * |x| is in range [lo, hi], inclusive.
+ */
+static __m128i sse2_in_range(__m128i x, uint8_t lo, uint8_t hi) {
+  return _mm_cmpeq_epi8(
+      _mm_subs_epu8(_mm_sub_epi8(x, _mm_set1_epi8((char)lo)),
+                    _mm_set1_epi8((char)(hi - lo))),
+      _mm_setzero_si128());
+}
+
+static int sse2_valid_name_block(const uint8_t *p) {
+  __m128i x = _mm_loadu_si128((const __m128i *)(const void *)p);
+  __m128i ok;
+
+  /* ^ _ ` a-z */
+  ok = sse2_in_range(x, 0x5e, 0x7a);
+  ok = _mm_or_si128(ok, sse2_in_range(x, '0', '9'));
+  /* # $ % & ' */
+  ok = _mm_or_si128(ok, sse2_in_range(x, '#', '\''));
+  ok = _mm_or_si128(ok, sse2_in_range(x, '*', '+'));
+  ok = _mm_or_si128(ok, sse2_in_range(x, '-', '.'));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(x, _mm_set1_epi8('!')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(x, _mm_set1_epi8('|')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(x, _mm_set1_epi8('~')));
+
+  return _mm_movemask_epi8(ok) == 0xffff;
+}
+
+static int check_header_name_sse2(const uint8_t *name, size_t len) {
+  const uint8_t *last = name + len - 16;
+  for (; name < last; name += 16) {
+    if (!sse2_valid_name_block(name)) {
+      return 0;
+    }
+  }
+  return sse2_valid_name_block(last);
+}
+
+static int sse2_valid_value_block(const uint8_t *p) {
+  __m128i x = _mm_loadu_si128((const __m128i *)(const void *)p);
+  __m128i ctl, bad;
+
+  /* Control characters other than HT, and DEL are not allowed */
+  ctl = _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(0x1f)),
+                       _mm_set1_epi8(0x1f));
+  bad = _mm_andnot_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\t')), ctl);
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(x, _mm_set1_epi8(0x7f)));
+
+  return _mm_movemask_epi8(bad) == 0;
+}
+
+static int check_header_value_sse2(const uint8_t *value, size_t len) {
+  const uint8_t *last = value + len - 16;
+  for (; value < last; value += 16) {
+    if (!sse2_valid_value_block(value)) {
+      return 0;
+    }
+  }
+  return sse2_valid_value_block(last);
+}
+#endif /* NGHTTP2_HAVE_SSE2 */
+
+#ifdef NGHTTP2_HAVE_AVX2
+NGHTTP2_TARGET_AVX2
+static int avx2_valid_name_block(const uint8_t *p) {
+  __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)p);
+  __m256i lo_tbl = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)(const void *)HD_NAME_LO_NIBBLE));
+  __m256i hi_tbl = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)(const void *)HD_NAME_HI_NIBBLE));
+  __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+  __m256i lo, hi;
+
+  lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(x, nibble_mask));
+  hi = _mm256_shuffle_epi8(
+      hi_tbl, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble_mask));
+
+  return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi),
+                                                _mm256_setzero_si256())) == 0;
+}
+
+NGHTTP2_TARGET_AVX2
+static int check_header_name_avx2(const uint8_t *name, size_t len) {
+  const uint8_t *last = name + len - 32;
+  for (; name < last; name += 32) {
+    if (!avx2_valid_name_block(name)) {
+      return 0;
+    }
+  }
+  return avx2_valid_name_block(last);
+}
+
+NGHTTP2_TARGET_AVX2
+static int avx2_valid_value_block(const uint8_t *p) {
+  __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)p);
+  __m256i ctl, bad;
+
+  ctl = _mm256_cmpeq_epi8(_mm256_max_epu8(x, _mm256_set1_epi8(0x1f)),
+                          _mm256_set1_epi8(0x1f));
+  bad = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')),
+                            ctl);
+  bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x7f)));
+
+  return _mm256_movemask_epi8(bad) == 0;
+}
+
+NGHTTP2_TARGET_AVX2
+static int check_header_value_avx2(const uint8_t *value, size_t len) {
+  const uint8_t *last = value + len - 32;
+  for (; value < last; value += 32) {
+    if (!avx2_valid_value_block(value)) {
+      return 0;
+    }
+  }
+  return avx2_valid_value_block(last);
+}
+
+static int cpu_has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+#endif /* NGHTTP2_HAVE_AVX2 */
+
+#ifdef NGHTTP2_HAVE_NEON
+static int neon_valid_name_block(const uint8_t *p) {
+  uint8x16_t x = vld1q_u8(p);
+  uint8x16_t lo, hi;
+
+  lo = vqtbl1q_u8(vld1q_u8(HD_NAME_LO_NIBBLE), vandq_u8(x, vdupq_n_u8(0x0f)));
+  hi = vqtbl1q_u8(vld1q_u8(HD_NAME_HI_NIBBLE), vshrq_n_u8(x, 4));
+
+  return vminvq_u8(vtstq_u8(lo, hi)) == 0xff;
+}
+
+static int check_header_name_neon(const uint8_t *name, size_t len) {
+  const uint8_t *last = name + len - 16;
+  for (; name < last; name += 16) {
+    if (!neon_valid_name_block(name)) {
+      return 0;
+    }
+  }
+  return neon_valid_name_block(last);
+}
+
+static int neon_valid_value_block(const uint8_t *p) {
+  uint8x16_t x = vld1q_u8(p);
+  uint8x16_t bad;
+
+  bad = vbicq_u8(vcltq_u8(x, vdupq_n_u8(0x20)), vceqq_u8(x, vdupq_n_u8('\t')));
+  bad = vorrq_u8(bad, vceqq_u8(x, vdupq_n_u8(0x7f)));
+
+  return vmaxvq_u8(bad) == 0;
+}
+
+static int check_header_value_neon(const uint8_t *value, size_t len) {
+  const uint8_t *last = value + len - 16;
+  for (; value < last; value += 16) {
+    if (!neon_valid_value_block(value)) {
+      return 0;
+    }
+  }
+  return neon_valid_value_block(last);
+}
+#endif /* NGHTTP2_HAVE_NEON */
+
+size_t nghttp2_check_header_impls(nghttp2_check_header_impl *impls) {
+  size_t n = 0;
+
+  impls[n].name = "generic";
+  impls[n].min_len = 0;
+  impls[n].check_name = check_header_name_generic;
+  impls[n].check_value = check_header_value_generic;
+  ++n;
+
+#ifdef NGHTTP2_HAVE_SSE2
+  impls[n].name = "sse2";
+  impls[n].min_len = 16;
+  impls[n].check_name = check_header_name_sse2;
+  impls[n].check_value = check_header_value_sse2;
+  ++n;
+#endif /* NGHTTP2_HAVE_SSE2 */
+
+#ifdef NGHTTP2_HAVE_AVX2
+  if (cpu_has_avx2()) {
+    impls[n].name = "avx2";
+    impls[n].min_len = 32;
+    impls[n].check_name = check_header_name_avx2;
+    impls[n].check_value = check_header_value_avx2;
+    ++n;
+  }
+#endif /* NGHTTP2_HAVE_AVX2 */
+
+#ifdef NGHTTP2_HAVE_NEON
+  impls[n].name = "neon";
+  impls[n].min_len = 16;
+  impls[n].check_name = check_header_name_neon;
+  impls[n].check_value = check_header_value_neon;
+  ++n;
+#endif /* NGHTTP2_HAVE_NEON */
+
+  return n;
+}
+
+int nghttp2_check_header_name(const uint8_t *name, size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  if (*name == ':') {
+    if (len == 1) {
+      return 0;
+    }
+    ++name;
+    --len;
+  }
+
+#ifdef NGHTTP2_HAVE_AVX2
+  if (len >= 32 && cpu_has_avx2()) {
+    return check_header_name_avx2(name, len);
+  }
+#endif /* NGHTTP2_HAVE_AVX2 */
+#ifdef NGHTTP2_HAVE_SSE2
+  if (len >= 16) {
+    return check_header_name_sse2(name, len);
+  }
+#endif /* NGHTTP2_HAVE_SSE2 */
+#ifdef NGHTTP2_HAVE_NEON
+  if (len >= 16) {
+    return check_header_name_neon(name, len);
+  }
+#endif /* NGHTTP2_HAVE_NEON */
+
+  return check_header_name_generic(name, len);
+}
+
+int nghttp2_check_header_value(const uint8_t *value, size_t len) {
+#ifdef NGHTTP2_HAVE_AVX2
+  if (len >= 32 && cpu_has_avx2()) {
+    return check_header_value_avx2(value, len);
+  }
+#endif /* NGHTTP2_HAVE_AVX2 */
+#ifdef NGHTTP2_HAVE_SSE2
+  if (len >= 16) {
+    return check_header_value_sse2(value, len);
+  }
+#endif /* NGHTTP2_HAVE_SSE2 */
+#ifdef NGHTTP2_HAVE_NEON
+  if (len >= 16) {
+    return check_header_value_neon(value, len);
+  }
+#endif /* NGHTTP2_HAVE_NEON */
+
+  return check_header_value_generic(value, len);
+}
+
 uint8_t *nghttp2_cpymem(uint8_t *dest, const void *src, size_t len) {
   if (len == 0) {
     return dest;
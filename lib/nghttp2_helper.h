@@ -69,6 +69,39 @@ uint32_t nghttp2_get_uint32(const uint8_t *data);
 
 void nghttp2_downcase(uint8_t *s, size_t len);
 
+/* The maximum number of nghttp2_check_header_impl */
+#define NGHTTP2_CHECK_HEADER_MAX_IMPLS 4
+
+/*
+ * The implementation of header field validation.
+ */
+typedef struct {
+  /* The name of implementation; e.g., "sse2" */
+  const char *name;
+  /* The minimum length of input which this implementation can
+     handle. */
+  size_t min_len;
+  /* Returns nonzero if all characters in |name| are valid header
+     field name characters.  Unlike nghttp2_check_header_name(), the
+     leading ':' is not treated specially. */
+  int (*check_name)(const uint8_t *name, size_t len);
+  /* Returns nonzero if all characters in |value| are valid header
+     field value characters. */
+  int (*check_value)(const uint8_t *value, size_t len);
+} nghttp2_check_header_impl;
+
+/*
+ * Stores the header field validation implementations available on
+ * the running CPU to |impls|, which must have room for at least
+ * NGHTTP2_CHECK_HEADER_MAX_IMPLS elements.  The first one is always
+ * the byte by byte generic implementation.  nghttp2_check_header_name()
+ * and nghttp2_check_header_value() choose one of them based on the
+ * input length.  This function is exposed for the unit tests.
+ *
+ * This function returns the number of implementations stored.
+ */
+size_t nghttp2_check_header_impls(nghttp2_check_header_impl *impls);
+
 /*
  * Adjusts |*local_window_size_ptr|, |*recv_window_size_ptr|,
  * |*recv_reduction_ptr| with |*delta_ptr| which is the
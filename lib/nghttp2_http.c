@@ -30,6 +30,7 @@
 
 #include "nghttp2_hd.h"
 #include "nghttp2_helper.h"
+#include "nghttp2_extpri.h"
 
 static uint8_t downcase(uint8_t c) {
   return 'A' <= c && c <= 'Z' ? (uint8_t)(c - 'A' + 'a') : c;
@@ -83,14 +84,14 @@ static int lws(const uint8_t *s, size_t n) {
 }
 
 static int check_pseudo_header(nghttp2_stream *stream, const nghttp2_hd_nv *nv,
-                               int flag) {
+                               uint32_t flag) {
   if (stream->http_flags & flag) {
     return 0;
   }
   if (lws(nv->value->base, nv->value->len)) {
     return 0;
   }
-  stream->http_flags = (uint16_t)(stream->http_flags | flag);
+  stream->http_flags = (uint32_t)(stream->http_flags | flag);
   return 1;
 }
 
@@ -114,6 +115,8 @@ static int check_path(nghttp2_stream *stream) {
 
 static int http_request_on_header(nghttp2_stream *stream, nghttp2_hd_nv *nv,
                                   int trailer) {
+  nghttp2_extpri extpri;
+
   if (nv->name->base[0] == ':') {
     if (trailer ||
         (stream->http_flags & NGHTTP2_HTTP_FLAG_PSEUDO_HEADER_DISALLOWED)) {
@@ -213,6 +216,25 @@ static int http_request_on_header(nghttp2_stream *stream, nghttp2_hd_nv *nv,
       return NGHTTP2_ERR_HTTP_HEADER;
     }
     break;
+  case NGHTTP2_TOKEN_PRIORITY:
+    /* Only requests on streams scheduled by RFC 9218 priorities care
+       about this header field.  Multiple field lines are combined
+       into the single Dictionary. */
+    if (trailer ||
+        !(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) ||
+        (stream->http_flags & NGHTTP2_HTTP_FLAG_BAD_PRIORITY)) {
+      break;
+    }
+    nghttp2_extpri_from_uint8(&extpri, stream->http_extpri);
+    if (nghttp2_extpri_parse_priority(&extpri, nv->value->base,
+                                      nv->value->len) == 0) {
+      stream->http_extpri = nghttp2_extpri_to_uint8(&extpri);
+      stream->http_flags |= NGHTTP2_HTTP_FLAG_PRIORITY;
+    } else {
+      stream->http_flags &= (uint32_t)~NGHTTP2_HTTP_FLAG_PRIORITY;
+      stream->http_flags |= NGHTTP2_HTTP_FLAG_BAD_PRIORITY;
+    }
+    break;
   default:
     if (nv->name->base[0] == ':') {
       return NGHTTP2_ERR_HTTP_HEADER;
@@ -501,15 +523,14 @@ int nghttp2_http_on_response_headers(nghttp2_stream *stream) {
   if (stream->status_code / 100 == 1) {
     /* non-final response */
     stream->http_flags =
-        (uint16_t)((stream->http_flags & NGHTTP2_HTTP_FLAG_METH_ALL) |
+        (uint32_t)((stream->http_flags & NGHTTP2_HTTP_FLAG_METH_ALL) |
                    NGHTTP2_HTTP_FLAG_EXPECT_FINAL_RESPONSE);
     stream->content_length = -1;
     stream->status_code = -1;
     return 0;
   }
 
-  stream->http_flags =
-      (uint16_t)(stream->http_flags & ~NGHTTP2_HTTP_FLAG_EXPECT_FINAL_RESPONSE);
+  stream->http_flags &= (uint32_t)~NGHTTP2_HTTP_FLAG_EXPECT_FINAL_RESPONSE;
 
   if (!expect_response_body(stream)) {
     stream->content_length = 0;
@@ -559,22 +580,24 @@ int nghttp2_http_on_data_chunk(nghttp2_stream *stream, size_t n) {
 
 void nghttp2_http_record_request_method(nghttp2_stream *stream,
                                         nghttp2_frame *frame) {
-  const nghttp2_nv *nva;
-  size_t nvlen;
-  size_t i;
-
   switch (frame->hd.type) {
   case NGHTTP2_HEADERS:
-    nva = frame->headers.nva;
-    nvlen = frame->headers.nvlen;
-    break;
+    nghttp2_http_record_request_method_nva(stream, frame->headers.nva,
+                                           frame->headers.nvlen);
+    return;
   case NGHTTP2_PUSH_PROMISE:
-    nva = frame->push_promise.nva;
-    nvlen = frame->push_promise.nvlen;
-    break;
+    nghttp2_http_record_request_method_nva(stream, frame->push_promise.nva,
+                                           frame->push_promise.nvlen);
+    return;
   default:
     return;
   }
+}
+
+void nghttp2_http_record_request_method_nva(nghttp2_stream *stream,
+                                            const nghttp2_nv *nva,
+                                            size_t nvlen) {
+  size_t i;
 
   /* TODO we should do this strictly. */
   for (i = 0; i < nvlen; ++i) {
@@ -94,4 +94,12 @@ int nghttp2_http_on_data_chunk(nghttp2_stream *stream, size_t n);
 void nghttp2_http_record_request_method(nghttp2_stream *stream,
                                         nghttp2_frame *frame);
 
+/*
+ * This function inspects header field in |nva| of length |nvlen| and
+ * records its method in stream->http_flags.
+ */
+void nghttp2_http_record_request_method_nva(nghttp2_stream *stream,
+                                            const nghttp2_nv *nva,
+                                            size_t nvlen);
+
 #endif /* NGHTTP2_HTTP_H */
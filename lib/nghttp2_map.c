@@ -25,14 +25,18 @@
 #include "nghttp2_map.h"
 
 #include <string.h>
+#include <assert.h>
 
-#define INITIAL_TABLE_LENGTH 256
+#include "nghttp2_helper.h"
+
+#define NGHTTP2_INITIAL_TABLE_LENBITS 8
 
 int nghttp2_map_init(nghttp2_map *map, nghttp2_mem *mem) {
   map->mem = mem;
-  map->tablelen = INITIAL_TABLE_LENGTH;
+  map->tablelen = 1 << NGHTTP2_INITIAL_TABLE_LENBITS;
+  map->tablelenbits = NGHTTP2_INITIAL_TABLE_LENBITS;
   map->table =
-      nghttp2_mem_calloc(mem, map->tablelen, sizeof(nghttp2_map_entry *));
+      nghttp2_mem_calloc(mem, map->tablelen, sizeof(nghttp2_map_bucket));
   if (map->table == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -50,15 +54,20 @@ void nghttp2_map_each_free(nghttp2_map *map,
                            int (*func)(nghttp2_map_entry *entry, void *ptr),
                            void *ptr) {
   uint32_t i;
+  nghttp2_map_bucket *bkt;
+
   for (i = 0; i < map->tablelen; ++i) {
-    nghttp2_map_entry *entry;
-    for (entry = map->table[i]; entry;) {
-      nghttp2_map_entry *next = entry->next;
-      func(entry, ptr);
-      entry = next;
+    bkt = &map->table[i];
+
+    if (bkt->data == NULL) {
+      continue;
     }
-    map->table[i] = NULL;
+
+    func(bkt->data, ptr);
+    bkt->data = NULL;
   }
+
+  map->size = 0;
 }
 
 int nghttp2_map_each(nghttp2_map *map,
@@ -66,74 +75,107 @@ int nghttp2_map_each(nghttp2_map *map,
                      void *ptr) {
   int rv;
   uint32_t i;
+  nghttp2_map_bucket *bkt;
+
   for (i = 0; i < map->tablelen; ++i) {
-    nghttp2_map_entry *entry;
-    for (entry = map->table[i]; entry; entry = entry->next) {
-      rv = func(entry, ptr);
-      if (rv != 0) {
-        return rv;
-      }
+    bkt = &map->table[i];
+
+    if (bkt->data == NULL) {
+      continue;
+    }
+
+    rv = func(bkt->data, ptr);
+    if (rv != 0) {
+      return rv;
     }
   }
+
   return 0;
 }
 
 void nghttp2_map_entry_init(nghttp2_map_entry *entry, key_type key) {
   entry->key = key;
-  entry->next = NULL;
 }
 
-/* Same hash function in android HashMap source code. */
-/* The |mod| must be power of 2 */
-static uint32_t hash(int32_t key, uint32_t mod) {
-  uint32_t h = (uint32_t)key;
-  h ^= (h >> 20) ^ (h >> 12);
-  h ^= (h >> 7) ^ (h >> 4);
-  return h & (mod - 1);
+/* Fibonacci hashing.  The peer chooses stream IDs, so the hash must
+   mix all bits of the key.  Otherwise, the keys spaced a power of 2
+   apart fall into the same probe sequence. */
+static uint32_t hash(key_type key, uint32_t bits) {
+  return (uint32_t)key * 2654435769u >> (32 - bits);
+}
+
+static void map_bucket_swap(nghttp2_map_bucket *bkt, uint32_t *psl,
+                            key_type *key, nghttp2_map_entry **data) {
+  uint32_t tpsl = bkt->psl;
+  key_type tkey = bkt->key;
+  nghttp2_map_entry *tdata = bkt->data;
+
+  bkt->psl = *psl;
+  bkt->key = *key;
+  bkt->data = *data;
+
+  *psl = tpsl;
+  *key = tkey;
+  *data = tdata;
 }
 
-static int insert(nghttp2_map_entry **table, uint32_t tablelen,
-                  nghttp2_map_entry *entry) {
-  uint32_t h = hash(entry->key, tablelen);
-  if (table[h] == NULL) {
-    table[h] = entry;
-  } else {
-    nghttp2_map_entry *p;
-    /* We won't allow duplicated key, so check it out. */
-    for (p = table[h]; p; p = p->next) {
-      if (p->key == entry->key) {
-        return NGHTTP2_ERR_INVALID_ARGUMENT;
-      }
+static int insert(nghttp2_map_bucket *table, uint32_t tablelen,
+                  uint32_t tablelenbits, nghttp2_map_entry *data) {
+  key_type key = data->key;
+  uint32_t idx = hash(key, tablelenbits);
+  uint32_t psl = 0;
+  nghttp2_map_bucket *bkt;
+
+  for (;;) {
+    bkt = &table[idx];
+
+    if (bkt->data == NULL) {
+      bkt->psl = psl;
+      bkt->key = key;
+      bkt->data = data;
+
+      return 0;
     }
-    entry->next = table[h];
-    table[h] = entry;
+
+    if (psl > bkt->psl) {
+      /* Take the bucket from the entry closer to its home.  The
+         displaced entry continues probing. */
+      map_bucket_swap(bkt, &psl, &key, &data);
+    } else if (bkt->key == key) {
+      /* We won't allow duplicated key.  If the key is in the table,
+         it is found before any entry is displaced. */
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+
+    ++psl;
+    idx = (idx + 1) & (tablelen - 1);
   }
-  return 0;
 }
 
 /* new_tablelen must be power of 2 */
-static int resize(nghttp2_map *map, uint32_t new_tablelen) {
+static int resize(nghttp2_map *map, uint32_t new_tablelen,
+                  uint32_t new_tablelenbits) {
   uint32_t i;
-  nghttp2_map_entry **new_table;
+  nghttp2_map_bucket *new_table;
 
   new_table =
-      nghttp2_mem_calloc(map->mem, new_tablelen, sizeof(nghttp2_map_entry *));
+      nghttp2_mem_calloc(map->mem, new_tablelen, sizeof(nghttp2_map_bucket));
   if (new_table == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
 
   for (i = 0; i < map->tablelen; ++i) {
-    nghttp2_map_entry *entry;
-    for (entry = map->table[i]; entry;) {
-      nghttp2_map_entry *next = entry->next;
-      entry->next = NULL;
-      /* This function must succeed */
-      insert(new_table, new_tablelen, entry);
-      entry = next;
+    if (map->table[i].data == NULL) {
+      continue;
     }
+
+    /* This function must succeed */
+    insert(new_table, new_tablelen, new_tablelenbits, map->table[i].data);
   }
+
   nghttp2_mem_free(map->mem, map->table);
   map->tablelen = new_tablelen;
+  map->tablelenbits = new_tablelenbits;
   map->table = new_table;
 
   return 0;
@@ -141,49 +183,90 @@ static int resize(nghttp2_map *map, uint32_t new_tablelen) {
 
 int nghttp2_map_insert(nghttp2_map *map, nghttp2_map_entry *new_entry) {
   int rv;
-  /* Load factor is 0.75 */
-  if ((map->size + 1) * 4 > map->tablelen * 3) {
-    rv = resize(map, map->tablelen * 2);
+
+  /* Load factor is 7/8.  Robin Hood hashing keeps probe sequences
+     short even at this load. */
+  if ((map->size + 1) * 8 > (size_t)map->tablelen * 7) {
+    rv = resize(map, map->tablelen * 2, map->tablelenbits + 1);
     if (rv != 0) {
       return rv;
     }
   }
-  rv = insert(map->table, map->tablelen, new_entry);
+
+  rv = insert(map->table, map->tablelen, map->tablelenbits, new_entry);
   if (rv != 0) {
     return rv;
   }
+
   ++map->size;
+
   return 0;
 }
 
 nghttp2_map_entry *nghttp2_map_find(nghttp2_map *map, key_type key) {
-  uint32_t h;
-  nghttp2_map_entry *entry;
-  h = hash(key, map->tablelen);
-  for (entry = map->table[h]; entry; entry = entry->next) {
-    if (entry->key == key) {
-      return entry;
+  uint32_t idx = hash(key, map->tablelenbits);
+  uint32_t psl = 0;
+  nghttp2_map_bucket *bkt;
+
+  for (;;) {
+    bkt = &map->table[idx];
+
+    /* If |key| were in the table, it would have displaced the entry
+       which is closer to its home than |key|. */
+    if (bkt->data == NULL || psl > bkt->psl) {
+      return NULL;
     }
+
+    if (bkt->key == key) {
+      return bkt->data;
+    }
+
+    ++psl;
+    idx = (idx + 1) & (map->tablelen - 1);
   }
-  return NULL;
 }
 
 int nghttp2_map_remove(nghttp2_map *map, key_type key) {
-  uint32_t h;
-  nghttp2_map_entry **dst;
+  uint32_t idx = hash(key, map->tablelenbits);
+  uint32_t psl = 0;
+  nghttp2_map_bucket *bkt, *next;
 
-  h = hash(key, map->tablelen);
+  for (;;) {
+    bkt = &map->table[idx];
 
-  for (dst = &map->table[h]; *dst; dst = &(*dst)->next) {
-    if ((*dst)->key != key) {
-      continue;
+    if (bkt->data == NULL || psl > bkt->psl) {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+
+    if (bkt->key == key) {
+      break;
+    }
+
+    ++psl;
+    idx = (idx + 1) & (map->tablelen - 1);
+  }
+
+  /* Shift the following entries back until the one at its home or an
+     empty bucket is found, so that no tombstone is needed. */
+  for (;;) {
+    idx = (idx + 1) & (map->tablelen - 1);
+    next = &map->table[idx];
+
+    if (next->data == NULL || next->psl == 0) {
+      bkt->data = NULL;
+      break;
     }
 
-    *dst = (*dst)->next;
-    --map->size;
-    return 0;
+    bkt->psl = next->psl - 1;
+    bkt->key = next->key;
+    bkt->data = next->data;
+
+    bkt = next;
   }
-  return NGHTTP2_ERR_INVALID_ARGUMENT;
+
+  --map->size;
+
+  return 0;
 }
 
 size_t nghttp2_map_size(nghttp2_map *map) { return map->size; }
@@ -33,12 +33,14 @@
 #include "nghttp2_int.h"
 #include "nghttp2_mem.h"
 
-/* Implementation of unordered map */
+/* Implementation of unordered map.  It is an open addressing hash
+   table with Robin Hood hashing and backward shift deletion.  The key
+   is stored in the bucket, so that probing does not touch the
+   entries. */
 
 typedef int32_t key_type;
 
 typedef struct nghttp2_map_entry {
-  struct nghttp2_map_entry *next;
   key_type key;
 #if SIZEOF_INT_P == 4
   /* we requires 8 bytes aligment */
@@ -46,11 +48,22 @@ typedef struct nghttp2_map_entry {
 #endif
 } nghttp2_map_entry;
 
+typedef struct nghttp2_map_bucket {
+  /* The distance from the bucket which |key| hashes to */
+  uint32_t psl;
+  key_type key;
+  /* The entry stored in this bucket, or NULL if this bucket is
+     empty */
+  nghttp2_map_entry *data;
+} nghttp2_map_bucket;
+
 typedef struct {
-  nghttp2_map_entry **table;
+  nghttp2_map_bucket *table;
   nghttp2_mem *mem;
   size_t size;
   uint32_t tablelen;
+  /* log2(tablelen) */
+  uint32_t tablelenbits;
 } nghttp2_map;
 
 /*
@@ -125,7 +138,8 @@ size_t nghttp2_map_size(nghttp2_map *map);
 
 /*
  * Applies the function |func| to each entry in the |map| with the
- * optional user supplied pointer |ptr|.
+ * optional user supplied pointer |ptr|.  The |func| must not insert
+ * nor remove entries.
  *
  * If the |func| returns 0, this function calls the |func| with the
  * next entry. If the |func| returns nonzero, it will not call the
@@ -24,6 +24,9 @@
  */
 #include "nghttp2_mem.h"
 
+#include <assert.h>
+#include <stdint.h>
+
 static void *default_malloc(size_t size, void *mem_user_data) {
   (void)mem_user_data;
 
@@ -72,3 +75,114 @@ void *nghttp2_mem_calloc(nghttp2_mem *mem, size_t nmemb, size_t size) {
 void *nghttp2_mem_realloc(nghttp2_mem *mem, void *ptr, size_t size) {
   return mem->realloc(ptr, size, mem->mem_user_data);
 }
+
+/* The header placed in front of memory allocated by the accounting
+   allocator.  It is a union so that the memory following it is
+   suitably aligned for any object. */
+typedef union {
+  size_t size;
+  long double ld;
+  void *p;
+  long long ll;
+} mem_acct_hd;
+
+void nghttp2_mem_acct_init(nghttp2_mem_acct *acct, nghttp2_mem *parent) {
+  acct->parent = *parent;
+  acct->current = 0;
+  acct->peak = 0;
+}
+
+static void mem_acct_add(nghttp2_mem_acct *acct, size_t size) {
+  acct->current += size;
+  if (acct->current > acct->peak) {
+    acct->peak = acct->current;
+  }
+}
+
+static void *mem_acct_on_alloc(nghttp2_mem_acct *acct, mem_acct_hd *hd,
+                               size_t size) {
+  if (hd == NULL) {
+    return NULL;
+  }
+
+  hd->size = size;
+  mem_acct_add(acct, size);
+
+  return hd + 1;
+}
+
+static void *mem_acct_malloc(size_t size, void *mem_user_data) {
+  nghttp2_mem_acct *acct = mem_user_data;
+
+  if (size > SIZE_MAX - sizeof(mem_acct_hd)) {
+    return NULL;
+  }
+
+  return mem_acct_on_alloc(
+      acct, nghttp2_mem_malloc(&acct->parent, sizeof(mem_acct_hd) + size),
+      size);
+}
+
+static void mem_acct_free(void *ptr, void *mem_user_data) {
+  nghttp2_mem_acct *acct = mem_user_data;
+  mem_acct_hd *hd;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  hd = (mem_acct_hd *)ptr - 1;
+
+  assert(acct->current >= hd->size);
+
+  acct->current -= hd->size;
+  nghttp2_mem_free(&acct->parent, hd);
+}
+
+static void *mem_acct_calloc(size_t nmemb, size_t size, void *mem_user_data) {
+  nghttp2_mem_acct *acct = mem_user_data;
+
+  if (size && nmemb > (SIZE_MAX - sizeof(mem_acct_hd)) / size) {
+    return NULL;
+  }
+
+  size *= nmemb;
+
+  return mem_acct_on_alloc(
+      acct, nghttp2_mem_calloc(&acct->parent, 1, sizeof(mem_acct_hd) + size),
+      size);
+}
+
+static void *mem_acct_realloc(void *ptr, size_t size, void *mem_user_data) {
+  nghttp2_mem_acct *acct = mem_user_data;
+  mem_acct_hd *hd;
+  size_t oldsize;
+
+  if (ptr == NULL) {
+    return mem_acct_malloc(size, mem_user_data);
+  }
+
+  if (size > SIZE_MAX - sizeof(mem_acct_hd)) {
+    return NULL;
+  }
+
+  hd = (mem_acct_hd *)ptr - 1;
+  oldsize = hd->size;
+
+  hd = nghttp2_mem_realloc(&acct->parent, hd, sizeof(mem_acct_hd) + size);
+  if (hd == NULL) {
+    return NULL;
+  }
+
+  acct->current -= oldsize;
+
+  return mem_acct_on_alloc(acct, hd, size);
+}
+
+void nghttp2_mem_acct_wrap(nghttp2_mem *mem, nghttp2_mem_acct *acct) {
+  mem->mem_user_data = acct;
+  mem->malloc = mem_acct_malloc;
+  mem->free = mem_acct_free;
+  mem->calloc = mem_acct_calloc;
+  mem->realloc = mem_acct_realloc;
+}
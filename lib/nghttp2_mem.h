@@ -42,4 +42,33 @@ void nghttp2_mem_free2(nghttp2_free free_func, void *ptr, void *mem_user_data);
 void *nghttp2_mem_calloc(nghttp2_mem *mem, size_t nmemb, size_t size);
 void *nghttp2_mem_realloc(nghttp2_mem *mem, void *ptr, size_t size);
 
+/*
+ * nghttp2_mem_acct keeps track of the number of bytes allocated
+ * through the allocator set up by nghttp2_mem_acct_wrap().  The size
+ * of each allocation is stored in a small header placed in front of
+ * the memory returned to the caller, so that it is known when the
+ * memory is freed.
+ */
+typedef struct {
+  /* The allocator which actually allocates memory */
+  nghttp2_mem parent;
+  /* The number of bytes currently allocated, excluding the headers */
+  size_t current;
+  /* The largest value |current| has ever reached */
+  size_t peak;
+} nghttp2_mem_acct;
+
+/*
+ * Initializes |acct| so that it allocates memory from |parent|.
+ */
+void nghttp2_mem_acct_init(nghttp2_mem_acct *acct, nghttp2_mem *parent);
+
+/*
+ * Initializes |mem| as the allocator which allocates memory from
+ * acct->parent and accounts it in |acct|.  Memory allocated by |mem|
+ * must be freed by |mem|, and vice versa.  |acct| must outlive all
+ * memory allocated by |mem|.
+ */
+void nghttp2_mem_acct_wrap(nghttp2_mem *mem, nghttp2_mem_acct *acct);
+
 #endif /* NGHTTP2_MEM_H */
@@ -0,0 +1,103 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_mpscq.h"
+
+#ifdef _MSC_VER
+#  include <windows.h>
+#endif /* _MSC_VER */
+
+void nghttp2_mpscq_init(nghttp2_mpscq *q) { q->head = NULL; }
+
+int nghttp2_mpscq_push(nghttp2_mpscq *q, nghttp2_mpscq_entry *ent) {
+  nghttp2_mpscq_entry *head;
+
+#if defined(_MSC_VER)
+  head = q->head;
+
+  for (;;) {
+    nghttp2_mpscq_entry *prev;
+
+    ent->next = head;
+
+    prev = InterlockedCompareExchangePointer((PVOID volatile *)&q->head, ent,
+                                             head);
+    if (prev == head) {
+      break;
+    }
+
+    head = prev;
+  }
+#elif defined(__GNUC__)
+  head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+  do {
+    ent->next = head;
+  } while (!__atomic_compare_exchange_n(&q->head, &head, ent, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#else  /* !defined(_MSC_VER) && !defined(__GNUC__) */
+  head = q->head;
+  ent->next = head;
+  q->head = ent;
+#endif /* !defined(_MSC_VER) && !defined(__GNUC__) */
+
+  return head == NULL;
+}
+
+int nghttp2_mpscq_empty(nghttp2_mpscq *q) {
+#if defined(__GNUC__) && !defined(_MSC_VER)
+  return __atomic_load_n(&q->head, __ATOMIC_RELAXED) == NULL;
+#else  /* !defined(__GNUC__) || defined(_MSC_VER) */
+  return *(nghttp2_mpscq_entry *volatile *)&q->head == NULL;
+#endif /* !defined(__GNUC__) || defined(_MSC_VER) */
+}
+
+nghttp2_mpscq_entry *nghttp2_mpscq_pop_all(nghttp2_mpscq *q) {
+  nghttp2_mpscq_entry *ent, *next, *res = NULL;
+
+  /* Avoid the atomic read-modify-write operation in the common case
+     where nothing is queued.  An entry pushed concurrently is taken
+     out by the next call. */
+  if (nghttp2_mpscq_empty(q)) {
+    return NULL;
+  }
+
+#if defined(_MSC_VER)
+  ent = InterlockedExchangePointer((PVOID volatile *)&q->head, NULL);
+#elif defined(__GNUC__)
+  ent = __atomic_exchange_n(&q->head, NULL, __ATOMIC_ACQUIRE);
+#else  /* !defined(_MSC_VER) && !defined(__GNUC__) */
+  ent = q->head;
+  q->head = NULL;
+#endif /* !defined(_MSC_VER) && !defined(__GNUC__) */
+
+  /* The list is in LIFO order.  Reverse it. */
+  for (; ent; ent = next) {
+    next = ent->next;
+    ent->next = res;
+    res = ent;
+  }
+
+  return res;
+}
@@ -0,0 +1,87 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGHTTP2_MPSCQ_H
+#define NGHTTP2_MPSCQ_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <nghttp2/nghttp2.h>
+
+/* NGHTTP2_MPSCQ_LOCK_FREE is 1 if the compiler provides the atomic
+   operations nghttp2_mpscq needs.  Otherwise, it is 0, and
+   nghttp2_mpscq must not be shared between threads. */
+#if defined(_MSC_VER) || defined(__GNUC__)
+#  define NGHTTP2_MPSCQ_LOCK_FREE 1
+#else /* !defined(_MSC_VER) && !defined(__GNUC__) */
+#  define NGHTTP2_MPSCQ_LOCK_FREE 0
+#endif /* !defined(_MSC_VER) && !defined(__GNUC__) */
+
+typedef struct nghttp2_mpscq_entry nghttp2_mpscq_entry;
+
+struct nghttp2_mpscq_entry {
+  nghttp2_mpscq_entry *next;
+};
+
+/*
+ * nghttp2_mpscq is an intrusive lock-free queue which any number of
+ * threads push entries to, and one thread takes them out of.
+ * Producers push to the head of a singly linked list with a
+ * compare-and-swap, and the consumer detaches the whole list at once
+ * and reverses it, so entries pushed by one thread are taken out in
+ * the order they were pushed.  Since the consumer never removes a
+ * single entry, the list is not subject to the ABA problem.
+ */
+typedef struct {
+  nghttp2_mpscq_entry *head;
+} nghttp2_mpscq;
+
+/*
+ * Initializes |q| to be empty.
+ */
+void nghttp2_mpscq_init(nghttp2_mpscq *q);
+
+/*
+ * Pushes |ent| to |q|.  This function is safe to call from any
+ * thread.  It returns 1 if |q| was empty, or 0 otherwise.
+ */
+int nghttp2_mpscq_push(nghttp2_mpscq *q, nghttp2_mpscq_entry *ent);
+
+/*
+ * Returns nonzero if |q| is empty.  This function is safe to call
+ * from any thread, but the result may be outdated as soon as it
+ * returns if the other threads push entries concurrently.
+ */
+int nghttp2_mpscq_empty(nghttp2_mpscq *q);
+
+/*
+ * Takes out all entries in |q|, and returns them as a list linked by
+ * next field in the order they were pushed, or NULL if |q| is empty.
+ * Only one thread may call this function at a time.
+ */
+nghttp2_mpscq_entry *nghttp2_mpscq_pop_all(nghttp2_mpscq *q);
+
+#endif /* NGHTTP2_MPSCQ_H */
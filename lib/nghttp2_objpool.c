@@ -0,0 +1,83 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_objpool.h"
+
+void nghttp2_objpool_init(nghttp2_objpool *pool, size_t objsize,
+                          size_t max_retained, nghttp2_mem *mem) {
+  if (objsize < sizeof(nghttp2_objpool_entry)) {
+    objsize = sizeof(nghttp2_objpool_entry);
+  }
+
+  pool->head = NULL;
+  pool->mem = mem;
+  pool->objsize = objsize;
+  pool->len = 0;
+  pool->max_len = max_retained / objsize;
+}
+
+void nghttp2_objpool_free(nghttp2_objpool *pool) {
+  nghttp2_objpool_entry *ent, *next;
+
+  for (ent = pool->head; ent;) {
+    next = ent->next;
+    nghttp2_mem_free(pool->mem, ent);
+    ent = next;
+  }
+
+  pool->head = NULL;
+  pool->len = 0;
+}
+
+void *nghttp2_objpool_get(nghttp2_objpool *pool) {
+  nghttp2_objpool_entry *ent;
+
+  if (pool->head == NULL) {
+    return nghttp2_mem_malloc(pool->mem, pool->objsize);
+  }
+
+  ent = pool->head;
+  pool->head = ent->next;
+  --pool->len;
+
+  return ent;
+}
+
+void nghttp2_objpool_put(nghttp2_objpool *pool, void *obj) {
+  nghttp2_objpool_entry *ent;
+
+  if (obj == NULL) {
+    return;
+  }
+
+  if (pool->len >= pool->max_len) {
+    nghttp2_mem_free(pool->mem, obj);
+    return;
+  }
+
+  ent = obj;
+  ent->next = pool->head;
+  pool->head = ent;
+  ++pool->len;
+}
@@ -0,0 +1,92 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGHTTP2_OBJPOOL_H
+#define NGHTTP2_OBJPOOL_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <nghttp2/nghttp2.h>
+
+#include "nghttp2_mem.h"
+
+/* The default upper bound of the number of bytes a single object
+   pool keeps in its free list. */
+#define NGHTTP2_DEFAULT_MAX_POOL_MEMORY (32 * 1024)
+
+typedef struct nghttp2_objpool_entry nghttp2_objpool_entry;
+
+struct nghttp2_objpool_entry {
+  nghttp2_objpool_entry *next;
+};
+
+/*
+ * nghttp2_objpool is a free list of fixed size objects.  Objects are
+ * allocated from |mem| one at a time, and returned objects are kept
+ * in the free list for later reuse, as long as the total size of
+ * retained objects does not exceed the limit given to
+ * nghttp2_objpool_init().  Objects returned beyond the limit are
+ * freed to |mem| immediately.
+ */
+typedef struct {
+  nghttp2_objpool_entry *head;
+  nghttp2_mem *mem;
+  /* The size of each object */
+  size_t objsize;
+  /* The number of objects in the free list */
+  size_t len;
+  /* The maximum number of objects in the free list */
+  size_t max_len;
+} nghttp2_objpool;
+
+/*
+ * Initializes |pool| for objects of |objsize| bytes.  At most
+ * |max_retained| bytes of free objects are kept for reuse.  If
+ * |objsize| is smaller than the size of a pointer, it is rounded up.
+ */
+void nghttp2_objpool_init(nghttp2_objpool *pool, size_t objsize,
+                          size_t max_retained, nghttp2_mem *mem);
+
+/*
+ * Frees all objects in the free list of |pool|.  Objects which have
+ * not been returned to |pool| are not affected.
+ */
+void nghttp2_objpool_free(nghttp2_objpool *pool);
+
+/*
+ * Returns an uninitialized object of pool->objsize bytes, or NULL if
+ * it cannot allocate memory.
+ */
+void *nghttp2_objpool_get(nghttp2_objpool *pool);
+
+/*
+ * Returns |obj| to |pool|.  |obj| must have been allocated with
+ * pool->mem, and be at least pool->objsize bytes long.  If |obj| is
+ * NULL, this function does nothing.
+ */
+void nghttp2_objpool_put(nghttp2_objpool *pool, void *obj);
+
+#endif /* NGHTTP2_OBJPOOL_H */
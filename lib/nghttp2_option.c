@@ -116,3 +116,60 @@ void nghttp2_option_set_no_closed_streams(nghttp2_option *option, int val) {
   option->opt_set_mask |= NGHTTP2_OPT_NO_CLOSED_STREAMS;
   option->no_closed_streams = val;
 }
+
+void nghttp2_option_set_hd_adaptive_indexing(nghttp2_option *option, int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_HD_ADAPTIVE_INDEXING;
+  option->hd_adaptive_indexing = val;
+}
+
+void nghttp2_option_set_hd_inflate_zero_copy(nghttp2_option *option,
+                                             int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_HD_INFLATE_ZERO_COPY;
+  option->hd_inflate_zero_copy = val;
+}
+
+void nghttp2_option_set_max_pool_memory(nghttp2_option *option, size_t val) {
+  option->opt_set_mask |= NGHTTP2_OPT_MAX_POOL_MEMORY;
+  option->max_pool_memory = val;
+}
+
+void nghttp2_option_set_no_rfc7540_priorities(nghttp2_option *option,
+                                              int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_NO_RFC7540_PRIORITIES;
+  option->no_rfc7540_priorities = val;
+}
+
+void nghttp2_option_set_server_fallback_rfc7540_priorities(
+    nghttp2_option *option, int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_SERVER_FALLBACK_RFC7540_PRIORITIES;
+  option->server_fallback_rfc7540_priorities = val;
+}
+
+void nghttp2_option_set_max_auto_window_size(nghttp2_option *option,
+                                             uint32_t val) {
+  option->opt_set_mask |= NGHTTP2_OPT_MAX_AUTO_WINDOW_SIZE;
+  option->max_auto_window_size = val;
+}
+
+void nghttp2_option_set_submission_queue(nghttp2_option *option, int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_SUBMISSION_QUEUE;
+  option->submission_queue = val;
+}
+
+void nghttp2_option_set_max_session_memory(nghttp2_option *option,
+                                           size_t val) {
+  option->opt_set_mask |= NGHTTP2_OPT_MAX_SESSION_MEMORY;
+  option->max_session_memory = val;
+}
+
+void nghttp2_option_set_compact_retained_streams(nghttp2_option *option,
+                                                 int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_COMPACT_RETAINED_STREAMS;
+  option->compact_retained_streams = val;
+}
+
+void nghttp2_option_set_enforce_max_header_list_size(nghttp2_option *option,
+                                                     int val) {
+  option->opt_set_mask |= NGHTTP2_OPT_ENFORCE_MAX_HEADER_LIST_SIZE;
+  option->enforce_max_header_list_size = val;
+}
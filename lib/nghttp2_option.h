@@ -66,6 +66,16 @@ typedef enum {
   NGHTTP2_OPT_MAX_SEND_HEADER_BLOCK_LENGTH = 1 << 8,
   NGHTTP2_OPT_MAX_DEFLATE_DYNAMIC_TABLE_SIZE = 1 << 9,
   NGHTTP2_OPT_NO_CLOSED_STREAMS = 1 << 10,
+  NGHTTP2_OPT_HD_ADAPTIVE_INDEXING = 1 << 11,
+  NGHTTP2_OPT_HD_INFLATE_ZERO_COPY = 1 << 12,
+  NGHTTP2_OPT_MAX_POOL_MEMORY = 1 << 13,
+  NGHTTP2_OPT_NO_RFC7540_PRIORITIES = 1 << 14,
+  NGHTTP2_OPT_SERVER_FALLBACK_RFC7540_PRIORITIES = 1 << 15,
+  NGHTTP2_OPT_MAX_AUTO_WINDOW_SIZE = 1 << 16,
+  NGHTTP2_OPT_SUBMISSION_QUEUE = 1 << 17,
+  NGHTTP2_OPT_MAX_SESSION_MEMORY = 1 << 18,
+  NGHTTP2_OPT_COMPACT_RETAINED_STREAMS = 1 << 19,
+  NGHTTP2_OPT_ENFORCE_MAX_HEADER_LIST_SIZE = 1 << 20,
 } nghttp2_option_flag;
 
 /**
@@ -80,6 +90,14 @@ struct nghttp2_option {
    * NGHTTP2_OPT_MAX_DEFLATE_DYNAMIC_TABLE_SIZE
    */
   size_t max_deflate_dynamic_table_size;
+  /**
+   * NGHTTP2_OPT_MAX_POOL_MEMORY
+   */
+  size_t max_pool_memory;
+  /**
+   * NGHTTP2_OPT_MAX_SESSION_MEMORY
+   */
+  size_t max_session_memory;
   /**
    * Bitwise OR of nghttp2_option_flag to determine that which fields
    * are specified.
@@ -97,6 +115,10 @@ struct nghttp2_option {
    * NGHTTP2_OPT_BUILTIN_RECV_EXT_TYPES
    */
   uint32_t builtin_recv_ext_types;
+  /**
+   * NGHTTP2_OPT_MAX_AUTO_WINDOW_SIZE
+   */
+  uint32_t max_auto_window_size;
   /**
    * NGHTTP2_OPT_NO_AUTO_WINDOW_UPDATE
    */
@@ -117,6 +139,34 @@ struct nghttp2_option {
    * NGHTTP2_OPT_NO_CLOSED_STREAMS
    */
   int no_closed_streams;
+  /**
+   * NGHTTP2_OPT_HD_ADAPTIVE_INDEXING
+   */
+  int hd_adaptive_indexing;
+  /**
+   * NGHTTP2_OPT_HD_INFLATE_ZERO_COPY
+   */
+  int hd_inflate_zero_copy;
+  /**
+   * NGHTTP2_OPT_NO_RFC7540_PRIORITIES
+   */
+  int no_rfc7540_priorities;
+  /**
+   * NGHTTP2_OPT_SERVER_FALLBACK_RFC7540_PRIORITIES
+   */
+  int server_fallback_rfc7540_priorities;
+  /**
+   * NGHTTP2_OPT_SUBMISSION_QUEUE
+   */
+  int submission_queue;
+  /**
+   * NGHTTP2_OPT_COMPACT_RETAINED_STREAMS
+   */
+  int compact_retained_streams;
+  /**
+   * NGHTTP2_OPT_ENFORCE_MAX_HEADER_LIST_SIZE
+   */
+  int enforce_max_header_list_size;
   /**
    * NGHTTP2_OPT_USER_RECV_EXT_TYPES
    */
@@ -49,7 +49,11 @@ void nghttp2_outbound_item_free(nghttp2_outbound_item *item, nghttp2_mem *mem) {
     nghttp2_frame_data_free(&frame->data);
     break;
   case NGHTTP2_HEADERS:
+    nghttp2_nv_array_del2(frame->headers.nva, item->aux_data.headers.nva_pool,
+                          mem);
+    frame->headers.nva = NULL;
     nghttp2_frame_headers_free(&frame->headers, mem);
+    nghttp2_hd_template_decref(item->aux_data.headers.tmpl);
     break;
   case NGHTTP2_PRIORITY:
     nghttp2_frame_priority_free(&frame->priority);
@@ -61,6 +65,9 @@ void nghttp2_outbound_item_free(nghttp2_outbound_item *item, nghttp2_mem *mem) {
     nghttp2_frame_settings_free(&frame->settings, mem);
     break;
   case NGHTTP2_PUSH_PROMISE:
+    nghttp2_nv_array_del2(frame->push_promise.nva,
+                          item->aux_data.headers.nva_pool, mem);
+    frame->push_promise.nva = NULL;
     nghttp2_frame_push_promise_free(&frame->push_promise, mem);
     break;
   case NGHTTP2_PING:
@@ -89,6 +96,9 @@ void nghttp2_outbound_item_free(nghttp2_outbound_item *item, nghttp2_mem *mem) {
     case NGHTTP2_ORIGIN:
       nghttp2_frame_origin_free(&frame->ext, mem);
       break;
+    case NGHTTP2_PRIORITY_UPDATE:
+      nghttp2_frame_priority_update_free(&frame->ext, mem);
+      break;
     default:
       assert(0);
       break;
@@ -37,6 +37,11 @@
 typedef struct {
   nghttp2_data_provider data_prd;
   void *stream_user_data;
+  /* Header template sent with this HEADERS frame, or NULL */
+  nghttp2_hd_template *tmpl;
+  /* The pool which the header field array of this frame was taken
+     from, or NULL */
+  nghttp2_objpool *nva_pool;
   /* error code when request HEADERS is canceled by RST_STREAM while
      it is in queue. */
   uint32_t error_code;
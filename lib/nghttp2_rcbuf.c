@@ -46,6 +46,7 @@ int nghttp2_rcbuf_new(nghttp2_rcbuf **rcbuf_ptr, size_t size,
   (*rcbuf_ptr)->base = p + sizeof(nghttp2_rcbuf);
   (*rcbuf_ptr)->len = size;
   (*rcbuf_ptr)->ref = 1;
+  (*rcbuf_ptr)->flags = NGHTTP2_RCBUF_FLAG_NONE;
 
   return 0;
 }
@@ -65,10 +66,53 @@ int nghttp2_rcbuf_new2(nghttp2_rcbuf **rcbuf_ptr, const uint8_t *src,
   return 0;
 }
 
+int nghttp2_rcbuf_new_borrowed(nghttp2_rcbuf **rcbuf_ptr, const uint8_t *src,
+                               size_t srclen, nghttp2_mem *mem) {
+  int rv;
+
+  rv = nghttp2_rcbuf_new(rcbuf_ptr, 0, mem);
+  if (rv != 0) {
+    return rv;
+  }
+
+  (*rcbuf_ptr)->base = (uint8_t *)src;
+  (*rcbuf_ptr)->len = srclen;
+  (*rcbuf_ptr)->flags = NGHTTP2_RCBUF_FLAG_BORROWED;
+
+  return 0;
+}
+
+int nghttp2_rcbuf_unborrow(nghttp2_rcbuf *rcbuf, nghttp2_mem *mem) {
+  uint8_t *p;
+
+  if (!(rcbuf->flags & NGHTTP2_RCBUF_FLAG_BORROWED)) {
+    return 0;
+  }
+
+  p = nghttp2_mem_malloc(mem, rcbuf->len + 1);
+  if (p == NULL) {
+    return NGHTTP2_ERR_NOMEM;
+  }
+
+  *nghttp2_cpymem(p, rcbuf->base, rcbuf->len) = '\0';
+
+  rcbuf->base = p;
+  rcbuf->flags = NGHTTP2_RCBUF_FLAG_SEPARATE_BASE;
+
+  return 0;
+}
+
+int nghttp2_rcbuf_is_borrowed(const nghttp2_rcbuf *rcbuf) {
+  return (rcbuf->flags & NGHTTP2_RCBUF_FLAG_BORROWED) != 0;
+}
+
 /*
  * Frees |rcbuf| itself, regardless of its reference cout.
  */
 void nghttp2_rcbuf_del(nghttp2_rcbuf *rcbuf) {
+  if (rcbuf->flags & NGHTTP2_RCBUF_FLAG_SEPARATE_BASE) {
+    nghttp2_mem_free2(rcbuf->free, rcbuf->base, rcbuf->mem_user_data);
+  }
   nghttp2_mem_free2(rcbuf->free, rcbuf, rcbuf->mem_user_data);
 }
 
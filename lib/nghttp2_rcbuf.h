@@ -31,6 +31,17 @@
 
 #include <nghttp2/nghttp2.h>
 
+typedef enum {
+  NGHTTP2_RCBUF_FLAG_NONE = 0,
+  /* The buffer pointed by base is not owned by nghttp2_rcbuf.  It is
+     borrowed from the input buffer, and only valid until the current
+     header field is processed. */
+  NGHTTP2_RCBUF_FLAG_BORROWED = 0x01,
+  /* The buffer pointed by base is allocated separately from
+     nghttp2_rcbuf, and must be freed with it. */
+  NGHTTP2_RCBUF_FLAG_SEPARATE_BASE = 0x02
+} nghttp2_rcbuf_flag;
+
 struct nghttp2_rcbuf {
   /* custom memory allocator belongs to the mem parameter when
      creating this object. */
@@ -42,6 +53,8 @@ struct nghttp2_rcbuf {
   size_t len;
   /* Reference count */
   int32_t ref;
+  /* Bitwise OR of zero or more of nghttp2_rcbuf_flag */
+  uint8_t flags;
 };
 
 /*
@@ -72,6 +85,41 @@ int nghttp2_rcbuf_new(nghttp2_rcbuf **rcbuf_ptr, size_t size, nghttp2_mem *mem);
 int nghttp2_rcbuf_new2(nghttp2_rcbuf **rcbuf_ptr, const uint8_t *src,
                        size_t srclen, nghttp2_mem *mem);
 
+/*
+ * Allocates nghttp2_rcbuf object which does not own the buffer.  The
+ * |rcbuf->base| points to the |src| of length |srclen|, which must
+ * outlive the object until nghttp2_rcbuf_unborrow() is called.  Note
+ * that the buffer is not NULL-terminated.  When the function
+ * succeeds, the reference count becomes 1.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM:
+ *     Out of memory.
+ */
+int nghttp2_rcbuf_new_borrowed(nghttp2_rcbuf **rcbuf_ptr, const uint8_t *src,
+                               size_t srclen, nghttp2_mem *mem);
+
+/*
+ * Copies the buffer which |rcbuf| borrows into the memory allocated
+ * by |mem|, so that |rcbuf| is usable after the borrowed buffer is
+ * gone.  The copied buffer is NULL-terminated.  This function does
+ * nothing if |rcbuf| does not borrow the buffer.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM:
+ *     Out of memory.
+ */
+int nghttp2_rcbuf_unborrow(nghttp2_rcbuf *rcbuf, nghttp2_mem *mem);
+
+/*
+ * Returns nonzero if |rcbuf| borrows the buffer.
+ */
+int nghttp2_rcbuf_is_borrowed(const nghttp2_rcbuf *rcbuf);
+
 /*
  * Frees |rcbuf| itself, regardless of its reference cout.
  */
@@ -37,6 +37,7 @@
 #include "nghttp2_http.h"
 #include "nghttp2_pq.h"
 #include "nghttp2_debug.h"
+#include "nghttp2_extpri.h"
 
 /*
  * Returns non-zero if the number of outgoing opened streams is larger
@@ -143,6 +144,15 @@ static int session_detect_idle_stream(nghttp2_session *session,
   return 0;
 }
 
+/*
+ * Returns nonzero if new streams are scheduled by RFC 9218
+ * extensible priorities instead of RFC 7540 dependency tree.
+ */
+static int session_no_rfc7540_pri_no_fallback(nghttp2_session *session) {
+  return session->pending_no_rfc7540_priorities == 1 &&
+         !session->fallback_rfc7540_priorities;
+}
+
 static int check_ext_type_set(const uint8_t *ext_types, uint8_t type) {
   return (ext_types[type / 8] & (1 << (type & 0x7))) > 0;
 }
@@ -290,9 +300,221 @@ nghttp2_stream *nghttp2_session_get_stream(nghttp2_session *session,
   return stream;
 }
 
+static void compact_stream_list_append(nghttp2_compact_stream_list *list,
+                                       nghttp2_compact_stream *cs) {
+  cs->prev = list->tail;
+  cs->next = NULL;
+
+  if (list->tail) {
+    list->tail->next = cs;
+  } else {
+    list->head = cs;
+  }
+
+  list->tail = cs;
+
+  ++list->len;
+}
+
+static void compact_stream_list_remove(nghttp2_compact_stream_list *list,
+                                       nghttp2_compact_stream *cs) {
+  if (cs->prev) {
+    cs->prev->next = cs->next;
+  } else {
+    list->head = cs->next;
+  }
+
+  if (cs->next) {
+    cs->next->prev = cs->prev;
+  } else {
+    list->tail = cs->prev;
+  }
+
+  --list->len;
+}
+
+static void compact_stream_list_free(nghttp2_compact_stream_list *list,
+                                     nghttp2_mem *mem) {
+  nghttp2_compact_stream *cs, *next;
+
+  for (cs = list->head; cs; cs = next) {
+    next = cs->next;
+    nghttp2_mem_free(mem, cs);
+  }
+
+  list->head = list->tail = NULL;
+  list->len = 0;
+}
+
+static nghttp2_compact_stream_list *
+session_get_compact_stream_list(nghttp2_session *session, uint8_t state) {
+  if (state == NGHTTP2_STREAM_IDLE) {
+    return &session->compact_idle_streams;
+  }
+
+  return &session->compact_closed_streams;
+}
+
+/*
+ * Removes |cs| from |session|, and frees it.
+ */
+static void session_del_compact_stream(nghttp2_session *session,
+                                       nghttp2_compact_stream *cs) {
+  DEBUGF("stream: delete compact stream %d\n", cs->map_entry.key);
+
+  compact_stream_list_remove(session_get_compact_stream_list(session,
+                                                             cs->state),
+                             cs);
+  nghttp2_map_remove(&session->compact_streams, cs->map_entry.key);
+  nghttp2_mem_free(&session->mem, cs);
+}
+
+/*
+ * Returns nonzero if closed or idle |stream| can be retained in
+ * compact form.
+ */
+static int session_can_compact_stream(nghttp2_session *session,
+                                      nghttp2_stream *stream) {
+  return (session->opt_flags & NGHTTP2_OPTMASK_COMPACT_RETAINED_STREAMS) &&
+         stream->dep_prev && stream->dep_next == NULL && stream->item == NULL;
+}
+
+/*
+ * Replaces |stream|, which must satisfy session_can_compact_stream()
+ * and must not be in the closed or idle stream lists, with
+ * nghttp2_compact_stream.  |stream| is freed if this function
+ * succeeds.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.  |stream| is left intact.
+ */
+static int session_compact_stream(nghttp2_session *session,
+                                  nghttp2_stream *stream) {
+  int rv;
+  nghttp2_compact_stream *cs;
+
+  DEBUGF("stream: compact stream(%p)=%d, state=%d\n", stream,
+         stream->stream_id, stream->state);
+
+  if (session->compact_streams.table == NULL) {
+    rv = nghttp2_map_init(&session->compact_streams, &session->mem);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  cs = nghttp2_mem_malloc(&session->mem, sizeof(nghttp2_compact_stream));
+  if (cs == NULL) {
+    return NGHTTP2_ERR_NOMEM;
+  }
+
+  nghttp2_map_entry_init(&cs->map_entry, stream->stream_id);
+
+  rv = nghttp2_map_insert(&session->compact_streams, &cs->map_entry);
+  if (rv != 0) {
+    nghttp2_mem_free(&session->mem, cs);
+    return rv;
+  }
+
+  cs->dep_stream_id = stream->dep_prev->stream_id;
+  cs->weight = stream->weight;
+  cs->state = (uint8_t)stream->state;
+  cs->flags = stream->flags;
+  cs->shut_flags = stream->shut_flags;
+
+  /* |stream| is a leaf without an item, so removing it from the
+     dependency tree does not allocate memory. */
+  rv = nghttp2_session_destroy_stream(session, stream);
+  assert(rv == 0);
+
+  compact_stream_list_append(
+      session_get_compact_stream_list(session, cs->state), cs);
+
+  return 0;
+}
+
+/*
+ * Turns |cs| back into nghttp2_stream, and puts it into the closed
+ * or idle stream list.  The parent stream is not promoted; if it is
+ * not in |session->streams|, the stream is attached to the root.
+ * |cs| is freed.  This function returns NULL if it runs out of
+ * memory, in which case the stream is forgotten.
+ */
+static nghttp2_stream *
+session_promote_compact_stream(nghttp2_session *session,
+                               nghttp2_compact_stream *cs) {
+  nghttp2_compact_stream c = *cs;
+  nghttp2_stream *stream, *dep_stream;
+  int rv;
+
+  DEBUGF("stream: promote compact stream %d\n", c.map_entry.key);
+
+  session_del_compact_stream(session, cs);
+
+  stream = nghttp2_objpool_get(&session->stream_pool);
+  if (stream == NULL) {
+    return NULL;
+  }
+
+  nghttp2_stream_init(stream, c.map_entry.key, c.flags,
+                      (nghttp2_stream_state)c.state, c.weight,
+                      (int32_t)session->remote_settings.initial_window_size,
+                      (int32_t)session->local_settings.initial_window_size,
+                      NULL, &session->mem);
+  stream->shut_flags = c.shut_flags;
+
+  rv = nghttp2_map_insert(&session->streams, &stream->map_entry);
+  if (rv != 0) {
+    nghttp2_stream_free(stream);
+    nghttp2_objpool_put(&session->stream_pool, stream);
+    return NULL;
+  }
+
+  dep_stream = NULL;
+
+  if (c.dep_stream_id != 0) {
+    dep_stream = (nghttp2_stream *)nghttp2_map_find(&session->streams,
+                                                    c.dep_stream_id);
+    if (dep_stream && !nghttp2_stream_in_dep_tree(dep_stream)) {
+      dep_stream = NULL;
+    }
+  }
+
+  if (dep_stream == NULL) {
+    dep_stream = &session->root;
+  }
+
+  nghttp2_stream_dep_add(dep_stream, stream);
+
+  if (c.state == NGHTTP2_STREAM_IDLE) {
+    nghttp2_session_keep_idle_stream(session, stream);
+  } else {
+    nghttp2_session_keep_closed_stream(session, stream);
+  }
+
+  return stream;
+}
+
 nghttp2_stream *nghttp2_session_get_stream_raw(nghttp2_session *session,
                                                int32_t stream_id) {
-  return (nghttp2_stream *)nghttp2_map_find(&session->streams, stream_id);
+  nghttp2_stream *stream;
+  nghttp2_compact_stream *cs;
+
+  stream = (nghttp2_stream *)nghttp2_map_find(&session->streams, stream_id);
+  if (stream || nghttp2_map_size(&session->compact_streams) == 0) {
+    return stream;
+  }
+
+  cs = (nghttp2_compact_stream *)nghttp2_map_find(&session->compact_streams,
+                                                  stream_id);
+  if (cs == NULL) {
+    return NULL;
+  }
+
+  return session_promote_compact_stream(session, cs);
 }
 
 static void session_inbound_frame_reset(nghttp2_session *session) {
@@ -376,6 +598,7 @@ static void session_inbound_frame_reset(nghttp2_session *session) {
 
   iframe->payloadleft = 0;
   iframe->padlen = 0;
+  iframe->header_list_len = 0;
 }
 
 static void init_settings(nghttp2_settings_storage *settings) {
@@ -385,14 +608,16 @@ static void init_settings(nghttp2_settings_storage *settings) {
   settings->initial_window_size = NGHTTP2_INITIAL_WINDOW_SIZE;
   settings->max_frame_size = NGHTTP2_MAX_FRAME_SIZE_MIN;
   settings->max_header_list_size = UINT32_MAX;
+  settings->no_rfc7540_priorities = 0;
 }
 
 static void active_outbound_item_reset(nghttp2_active_outbound_item *aob,
+                                       nghttp2_objpool *item_pool,
                                        nghttp2_mem *mem) {
   DEBUGF("send: reset nghttp2_active_outbound_item\n");
   DEBUGF("send: aob->item = %p\n", aob->item);
   nghttp2_outbound_item_free(aob->item, mem);
-  nghttp2_mem_free(mem, aob->item);
+  nghttp2_objpool_put(item_pool, aob->item);
   aob->item = NULL;
   nghttp2_bufs_reset(&aob->framebufs);
   aob->state = NGHTTP2_OB_POP_ITEM;
@@ -400,14 +625,31 @@ static void active_outbound_item_reset(nghttp2_active_outbound_item *aob,
 
 int nghttp2_enable_strict_preface = 1;
 
+static int session_call_select_hd_indexing(nghttp2_hd_deflater *deflater,
+                                           const nghttp2_nv *nv, int suggested,
+                                           void *user_data) {
+  nghttp2_session *session;
+
+  (void)deflater;
+
+  session = user_data;
+
+  return session->callbacks.select_hd_indexing_callback(
+      session, nv, suggested, session->user_data);
+}
+
 static int session_new(nghttp2_session **session_ptr,
                        const nghttp2_session_callbacks *callbacks,
                        void *user_data, int server,
                        const nghttp2_option *option, nghttp2_mem *mem) {
   int rv;
   size_t nbuffer;
+  size_t i;
   size_t max_deflate_dynamic_table_size =
       NGHTTP2_HD_DEFAULT_MAX_DEFLATE_BUFFER_SIZE;
+  int hd_adaptive_indexing = 0;
+  int hd_inflate_zero_copy = 0;
+  size_t max_pool_memory = NGHTTP2_DEFAULT_MAX_POOL_MEMORY;
 
   if (mem == NULL) {
     mem = nghttp2_mem_default();
@@ -419,7 +661,19 @@ static int session_new(nghttp2_session **session_ptr,
     goto fail_session;
   }
 
-  (*session_ptr)->mem = *mem;
+  nghttp2_mem_acct_init(&(*session_ptr)->mem_acct, mem);
+  (*session_ptr)->max_session_memory = SIZE_MAX;
+
+  if (option && (option->opt_set_mask & NGHTTP2_OPT_MAX_SESSION_MEMORY)) {
+    (*session_ptr)->max_session_memory = option->max_session_memory;
+    /* The session object itself is a part of the usage. */
+    (*session_ptr)->mem_acct.current = (*session_ptr)->mem_acct.peak =
+        sizeof(nghttp2_session);
+    nghttp2_mem_acct_wrap(&(*session_ptr)->mem, &(*session_ptr)->mem_acct);
+  } else {
+    (*session_ptr)->mem = *mem;
+  }
+
   mem = &(*session_ptr)->mem;
 
   /* next_stream_id is initialized in either
@@ -429,6 +683,10 @@ static int session_new(nghttp2_session **session_ptr,
                       NGHTTP2_STREAM_IDLE, NGHTTP2_DEFAULT_WEIGHT, 0, 0, NULL,
                       mem);
 
+  for (i = 0; i < NGHTTP2_EXTPRI_URGENCY_LEVELS; ++i) {
+    nghttp2_pq_init(&(*session_ptr)->sched[i], nghttp2_stream_less, mem);
+  }
+
   (*session_ptr)->remote_window_size = NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE;
   (*session_ptr)->recv_window_size = 0;
   (*session_ptr)->consumed_size = 0;
@@ -442,6 +700,7 @@ static int session_new(nghttp2_session **session_ptr,
   (*session_ptr)->pending_local_max_concurrent_stream =
       NGHTTP2_DEFAULT_MAX_CONCURRENT_STREAMS;
   (*session_ptr)->pending_enable_push = 1;
+  (*session_ptr)->pending_no_rfc7540_priorities = UINT8_MAX;
 
   if (server) {
     (*session_ptr)->server = 1;
@@ -450,6 +709,8 @@ static int session_new(nghttp2_session **session_ptr,
   init_settings(&(*session_ptr)->remote_settings);
   init_settings(&(*session_ptr)->local_settings);
 
+  (*session_ptr)->remote_settings.no_rfc7540_priorities = UINT32_MAX;
+
   (*session_ptr)->max_incoming_reserved_streams =
       NGHTTP2_MAX_INCOMING_RESERVED_STREAMS;
 
@@ -516,17 +777,80 @@ static int session_new(nghttp2_session **session_ptr,
         option->no_closed_streams) {
       (*session_ptr)->opt_flags |= NGHTTP2_OPTMASK_NO_CLOSED_STREAMS;
     }
+
+    if ((option->opt_set_mask & NGHTTP2_OPT_NO_RFC7540_PRIORITIES) &&
+        option->no_rfc7540_priorities) {
+      (*session_ptr)->opt_flags |= NGHTTP2_OPTMASK_NO_RFC7540_PRIORITIES;
+    }
+
+    if ((option->opt_set_mask &
+         NGHTTP2_OPT_SERVER_FALLBACK_RFC7540_PRIORITIES) &&
+        option->server_fallback_rfc7540_priorities) {
+      (*session_ptr)->opt_flags |=
+          NGHTTP2_OPTMASK_SERVER_FALLBACK_RFC7540_PRIORITIES;
+    }
+
+    if (option->opt_set_mask & NGHTTP2_OPT_HD_ADAPTIVE_INDEXING) {
+      hd_adaptive_indexing = option->hd_adaptive_indexing;
+    }
+
+    if (option->opt_set_mask & NGHTTP2_OPT_HD_INFLATE_ZERO_COPY) {
+      hd_inflate_zero_copy = option->hd_inflate_zero_copy;
+    }
+
+    if (option->opt_set_mask & NGHTTP2_OPT_MAX_POOL_MEMORY) {
+      max_pool_memory = option->max_pool_memory;
+    }
+
+    if (option->opt_set_mask & NGHTTP2_OPT_MAX_AUTO_WINDOW_SIZE) {
+      (*session_ptr)->window_tuner.max_window_size = (int32_t)nghttp2_min(
+          option->max_auto_window_size, NGHTTP2_MAX_WINDOW_SIZE);
+    }
+
+    if ((option->opt_set_mask & NGHTTP2_OPT_COMPACT_RETAINED_STREAMS) &&
+        option->compact_retained_streams) {
+      (*session_ptr)->opt_flags |= NGHTTP2_OPTMASK_COMPACT_RETAINED_STREAMS;
+    }
+
+    if ((option->opt_set_mask & NGHTTP2_OPT_ENFORCE_MAX_HEADER_LIST_SIZE) &&
+        option->enforce_max_header_list_size) {
+      (*session_ptr)->opt_flags |=
+          NGHTTP2_OPTMASK_ENFORCE_MAX_HEADER_LIST_SIZE;
+    }
+
+    if ((option->opt_set_mask & NGHTTP2_OPT_SUBMISSION_QUEUE) &&
+        option->submission_queue && NGHTTP2_MPSCQ_LOCK_FREE) {
+      (*session_ptr)->opt_flags |= NGHTTP2_OPTMASK_SUBMISSION_QUEUE;
+    }
   }
 
+  nghttp2_mpscq_init(&(*session_ptr)->submissionq);
+
+  nghttp2_objpool_init(&(*session_ptr)->stream_pool, sizeof(nghttp2_stream),
+                       max_pool_memory, mem);
+  nghttp2_objpool_init(&(*session_ptr)->item_pool,
+                       sizeof(nghttp2_outbound_item), max_pool_memory, mem);
+  nghttp2_objpool_init(&(*session_ptr)->nva_pool, NGHTTP2_NVA_POOL_OBJSIZE,
+                       max_pool_memory, mem);
+
   rv = nghttp2_hd_deflate_init2(&(*session_ptr)->hd_deflater,
                                 max_deflate_dynamic_table_size, mem);
   if (rv != 0) {
     goto fail_hd_deflater;
   }
+  if (hd_adaptive_indexing) {
+    rv = nghttp2_hd_deflate_set_adaptive_indexing(&(*session_ptr)->hd_deflater,
+                                                  1);
+    if (rv != 0) {
+      goto fail_hd_inflater;
+    }
+  }
   rv = nghttp2_hd_inflate_init(&(*session_ptr)->hd_inflater, mem);
   if (rv != 0) {
     goto fail_hd_inflater;
   }
+  nghttp2_hd_inflate_set_zero_copy(&(*session_ptr)->hd_inflater,
+                                   hd_inflate_zero_copy);
   rv = nghttp2_map_init(&(*session_ptr)->streams, mem);
   if (rv != 0) {
     goto fail_map;
@@ -548,11 +872,18 @@ static int session_new(nghttp2_session **session_ptr,
     goto fail_aob_framebuf;
   }
 
-  active_outbound_item_reset(&(*session_ptr)->aob, mem);
+  active_outbound_item_reset(&(*session_ptr)->aob,
+                             &(*session_ptr)->item_pool, mem);
 
   (*session_ptr)->callbacks = *callbacks;
   (*session_ptr)->user_data = user_data;
 
+  if (callbacks->select_hd_indexing_callback) {
+    nghttp2_hd_deflate_set_indexing_callback(&(*session_ptr)->hd_deflater,
+                                             session_call_select_hd_indexing,
+                                             *session_ptr);
+  }
+
   session_inbound_frame_reset(*session_ptr);
 
   if (nghttp2_enable_strict_preface) {
@@ -582,7 +913,7 @@ fail_map:
 fail_hd_inflater:
   nghttp2_hd_deflate_free(&(*session_ptr)->hd_deflater);
 fail_hd_deflater:
-  nghttp2_mem_free(mem, *session_ptr);
+  nghttp2_mem_free(&(*session_ptr)->mem_acct.parent, *session_ptr);
 fail_session:
   return rv;
 }
@@ -668,21 +999,22 @@ static int free_streams(nghttp2_map_entry *entry, void *ptr) {
 
   if (item && !item->queued && item != session->aob.item) {
     nghttp2_outbound_item_free(item, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
   }
 
   nghttp2_stream_free(stream);
-  nghttp2_mem_free(mem, stream);
+  nghttp2_objpool_put(&session->stream_pool, stream);
 
   return 0;
 }
 
-static void ob_q_free(nghttp2_outbound_queue *q, nghttp2_mem *mem) {
+static void ob_q_free(nghttp2_outbound_queue *q, nghttp2_objpool *item_pool,
+                      nghttp2_mem *mem) {
   nghttp2_outbound_item *item, *next;
   for (item = q->head; item;) {
     next = item->qnext;
     nghttp2_outbound_item_free(item, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(item_pool, item);
     item = next;
   }
 }
@@ -721,9 +1053,61 @@ static void inflight_settings_del(nghttp2_inflight_settings *settings,
   nghttp2_mem_free(mem, settings);
 }
 
+/*
+ * Invokes on_data_ref_release_callback for each application data
+ * referenced by the last nghttp2_session_mem_sendv() call, and
+ * forgets them.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+static int session_release_data_refs(nghttp2_session *session) {
+  nghttp2_sendv_batch *sendv = &session->sendv;
+  nghttp2_data_ref *ref;
+  size_t i;
+  int rv = 0;
+
+  if (session->callbacks.on_data_ref_release_callback) {
+    for (i = 0; i < sendv->nrefs; ++i) {
+      ref = &sendv->refs[i];
+
+      if (session->callbacks.on_data_ref_release_callback(
+              session, ref->stream_id, ref->data, ref->len,
+              session->user_data) != 0) {
+        rv = NGHTTP2_ERR_CALLBACK_FAILURE;
+      }
+    }
+  }
+
+  sendv->nrefs = 0;
+
+  return rv;
+}
+
+static void session_sendv_batch_free(nghttp2_session *session) {
+  nghttp2_sendv_batch *sendv = &session->sendv;
+  nghttp2_mem *mem = &session->mem;
+  nghttp2_buf_chain *chain, *next;
+
+  session_release_data_refs(session);
+
+  for (chain = sendv->head; chain; chain = next) {
+    next = chain->next;
+    nghttp2_buf_free(&chain->buf, mem);
+    nghttp2_mem_free(mem, chain);
+  }
+
+  nghttp2_mem_free(mem, sendv->refs);
+}
+
 void nghttp2_session_del(nghttp2_session *session) {
   nghttp2_mem *mem;
   nghttp2_inflight_settings *settings;
+  nghttp2_mpscq_entry *qe, *qnext;
+  size_t i;
 
   if (session == NULL) {
     return;
@@ -737,6 +1121,10 @@ void nghttp2_session_del(nghttp2_session *session) {
     settings = next;
   }
 
+  for (i = 0; i < NGHTTP2_EXTPRI_URGENCY_LEVELS; ++i) {
+    nghttp2_pq_free(&session->sched[i]);
+  }
+
   nghttp2_stream_free(&session->root);
 
   /* Have to free streams first, so that we can check
@@ -744,16 +1132,235 @@ void nghttp2_session_del(nghttp2_session *session) {
   nghttp2_map_each_free(&session->streams, free_streams, session);
   nghttp2_map_free(&session->streams);
 
-  ob_q_free(&session->ob_urgent, mem);
-  ob_q_free(&session->ob_reg, mem);
-  ob_q_free(&session->ob_syn, mem);
+  compact_stream_list_free(&session->compact_closed_streams, mem);
+  compact_stream_list_free(&session->compact_idle_streams, mem);
+  if (session->compact_streams.table) {
+    nghttp2_map_free(&session->compact_streams);
+  }
 
-  active_outbound_item_reset(&session->aob, mem);
+  ob_q_free(&session->ob_urgent, &session->item_pool, mem);
+  ob_q_free(&session->ob_reg, &session->item_pool, mem);
+  ob_q_free(&session->ob_syn, &session->item_pool, mem);
+
+  active_outbound_item_reset(&session->aob, &session->item_pool, mem);
   session_inbound_frame_reset(session);
+
+  while (session->hd_templates) {
+    nghttp2_session_del_hd_template(session, session->hd_templates);
+  }
+
   nghttp2_hd_deflate_free(&session->hd_deflater);
   nghttp2_hd_inflate_free(&session->hd_inflater);
   nghttp2_bufs_free(&session->aob.framebufs);
-  nghttp2_mem_free(mem, session);
+  session_sendv_batch_free(session);
+
+  for (qe = nghttp2_mpscq_pop_all(&session->submissionq); qe; qe = qnext) {
+    qnext = qe->next;
+    nghttp2_mem_free(&session->mem_acct.parent, qe);
+  }
+
+  /* All objects taken from the pools have been returned by now. */
+  nghttp2_objpool_free(&session->nva_pool);
+  nghttp2_objpool_free(&session->item_pool);
+  nghttp2_objpool_free(&session->stream_pool);
+  nghttp2_mem_free(&session->mem_acct.parent, session);
+}
+
+/*
+ * Returns the cycle of the stream at the top of |pq|, or 0 if |pq| is
+ * empty.
+ */
+static uint32_t pq_get_first_cycle(nghttp2_pq *pq) {
+  nghttp2_stream *stream;
+
+  if (nghttp2_pq_empty(pq)) {
+    return 0;
+  }
+
+  stream = nghttp2_struct_of(nghttp2_pq_top(pq), nghttp2_stream, pq_entry);
+  return stream->cycle;
+}
+
+/*
+ * Queues |stream| to the urgency bucket it belongs to.  The stream
+ * joins the current round of its bucket, and streams in the same
+ * round are served in the ascending order of stream ID.
+ */
+static int session_ob_data_push(nghttp2_session *session,
+                                nghttp2_stream *stream) {
+  int rv;
+  uint32_t urgency;
+  nghttp2_pq *pq;
+
+  assert(stream->queued == 0);
+
+  urgency = nghttp2_extpri_uint8_urgency(stream->extpri);
+
+  assert(urgency < NGHTTP2_EXTPRI_URGENCY_LEVELS);
+
+  pq = &session->sched[urgency];
+
+  stream->cycle = pq_get_first_cycle(pq);
+  stream->seq = (uint64_t)stream->stream_id;
+
+  rv = nghttp2_pq_push(pq, &stream->pq_entry);
+  if (rv != 0) {
+    return rv;
+  }
+
+  stream->queued = 1;
+
+  return 0;
+}
+
+static void session_ob_data_remove(nghttp2_session *session,
+                                   nghttp2_stream *stream) {
+  uint32_t urgency;
+
+  assert(stream->queued == 1);
+
+  urgency = nghttp2_extpri_uint8_urgency(stream->extpri);
+
+  assert(urgency < NGHTTP2_EXTPRI_URGENCY_LEVELS);
+
+  nghttp2_pq_remove(&session->sched[urgency], &stream->pq_entry);
+
+  stream->queued = 0;
+}
+
+static int session_attach_stream_item(nghttp2_session *session,
+                                      nghttp2_stream *stream,
+                                      nghttp2_outbound_item *item) {
+  int rv;
+
+  rv = nghttp2_stream_attach_item(stream, item);
+  if (rv != 0) {
+    return rv;
+  }
+
+  if (!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES)) {
+    return 0;
+  }
+
+  rv = session_ob_data_push(session, stream);
+  if (rv != 0) {
+    nghttp2_stream_detach_item(stream);
+    return rv;
+  }
+
+  return 0;
+}
+
+static int session_detach_stream_item(nghttp2_session *session,
+                                      nghttp2_stream *stream) {
+  int rv;
+
+  rv = nghttp2_stream_detach_item(stream);
+  if (rv != 0) {
+    return rv;
+  }
+
+  if (!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) ||
+      !stream->queued) {
+    return 0;
+  }
+
+  session_ob_data_remove(session, stream);
+
+  return 0;
+}
+
+static int session_defer_stream_item(nghttp2_session *session,
+                                     nghttp2_stream *stream, uint8_t flags) {
+  int rv;
+
+  rv = nghttp2_stream_defer_item(stream, flags);
+  if (rv != 0) {
+    return rv;
+  }
+
+  if (!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) ||
+      !stream->queued) {
+    return 0;
+  }
+
+  session_ob_data_remove(session, stream);
+
+  return 0;
+}
+
+static int session_resume_deferred_stream_item(nghttp2_session *session,
+                                               nghttp2_stream *stream,
+                                               uint8_t flags) {
+  int rv;
+
+  rv = nghttp2_stream_resume_deferred_item(stream, flags);
+  if (rv != 0) {
+    return rv;
+  }
+
+  if (!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) ||
+      (stream->flags & NGHTTP2_STREAM_FLAG_DEFERRED_ALL) || stream->queued) {
+    return 0;
+  }
+
+  return session_ob_data_push(session, stream);
+}
+
+/*
+ * Moves |stream| to the urgency bucket for |u8extpri| if it is
+ * queued, and updates its priority.
+ */
+static int session_update_stream_priority(nghttp2_session *session,
+                                          nghttp2_stream *stream,
+                                          uint8_t u8extpri) {
+  if (stream->extpri == u8extpri) {
+    return 0;
+  }
+
+  if (!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) ||
+      !stream->queued) {
+    stream->extpri = u8extpri;
+
+    return 0;
+  }
+
+  session_ob_data_remove(session, stream);
+
+  stream->extpri = u8extpri;
+
+  return session_ob_data_push(session, stream);
+}
+
+static nghttp2_outbound_item *
+session_sched_get_next_outbound_item(nghttp2_session *session) {
+  size_t i;
+  nghttp2_pq_entry *ent;
+  nghttp2_stream *stream;
+
+  for (i = 0; i < NGHTTP2_EXTPRI_URGENCY_LEVELS; ++i) {
+    ent = nghttp2_pq_top(&session->sched[i]);
+    if (!ent) {
+      continue;
+    }
+
+    stream = nghttp2_struct_of(ent, nghttp2_stream, pq_entry);
+    return stream->item;
+  }
+
+  return NULL;
+}
+
+static int session_sched_empty(nghttp2_session *session) {
+  size_t i;
+
+  for (i = 0; i < NGHTTP2_EXTPRI_URGENCY_LEVELS; ++i) {
+    if (!nghttp2_pq_empty(&session->sched[i])) {
+      return 0;
+    }
+  }
+
+  return 1;
 }
 
 int nghttp2_session_reprioritize_stream(
@@ -852,7 +1459,7 @@ int nghttp2_session_add_item(nghttp2_session *session,
       return NGHTTP2_ERR_DATA_EXIST;
     }
 
-    rv = nghttp2_stream_attach_item(stream, item);
+    rv = session_attach_stream_item(session, stream, item);
 
     if (rv != 0) {
       return rv;
@@ -940,9 +1547,7 @@ int nghttp2_session_add_rst_stream(nghttp2_session *session, int32_t stream_id,
   nghttp2_outbound_item *item;
   nghttp2_frame *frame;
   nghttp2_stream *stream;
-  nghttp2_mem *mem;
 
-  mem = &session->mem;
   stream = nghttp2_session_get_stream(session, stream_id);
   if (stream && stream->state == NGHTTP2_STREAM_CLOSING) {
     return 0;
@@ -982,7 +1587,7 @@ int nghttp2_session_add_rst_stream(nghttp2_session *session, int32_t stream_id,
     }
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -995,12 +1600,32 @@ int nghttp2_session_add_rst_stream(nghttp2_session *session, int32_t stream_id,
   rv = nghttp2_session_add_item(session, item);
   if (rv != 0) {
     nghttp2_frame_rst_stream_free(&frame->rst_stream);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
   return 0;
 }
 
+static size_t stats_frame_type_index(uint8_t type) {
+  return nghttp2_min(type, NGHTTP2_STATS_FRAME_TYPE_OTHER);
+}
+
+static void session_stats_on_frame_recv(nghttp2_session *session,
+                                        const nghttp2_frame_hd *hd) {
+  size_t idx = stats_frame_type_index(hd->type);
+
+  ++session->stats.frames_recv[idx];
+  session->stats.bytes_recv[idx] += hd->length + NGHTTP2_FRAME_HDLEN;
+}
+
+static void session_stats_on_stream_opened(nghttp2_session *session) {
+  ++session->stats.num_streams_opened;
+  session->stats.max_concurrent_streams =
+      nghttp2_max(session->stats.max_concurrent_streams,
+                  session->num_outgoing_streams +
+                      session->num_incoming_streams);
+}
+
 nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
                                             int32_t stream_id, uint8_t flags,
                                             nghttp2_priority_spec *pri_spec_in,
@@ -1019,14 +1644,21 @@ nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
 
   if (stream) {
     assert(stream->state == NGHTTP2_STREAM_IDLE);
-    assert(nghttp2_stream_in_dep_tree(stream));
+    assert((stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) ||
+           nghttp2_stream_in_dep_tree(stream));
+
     nghttp2_session_detach_idle_stream(session, stream);
-    rv = nghttp2_stream_dep_remove(stream);
-    if (rv != 0) {
-      return NULL;
+
+    if (nghttp2_stream_in_dep_tree(stream)) {
+      assert(!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES));
+
+      rv = nghttp2_stream_dep_remove(stream);
+      if (rv != 0) {
+        return NULL;
+      }
     }
   } else {
-    stream = nghttp2_mem_malloc(mem, sizeof(nghttp2_stream));
+    stream = nghttp2_objpool_get(&session->stream_pool);
     if (stream == NULL) {
       return NULL;
     }
@@ -1034,7 +1666,14 @@ nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
     stream_alloc = 1;
   }
 
-  if (pri_spec->stream_id != 0) {
+  if (session_no_rfc7540_pri_no_fallback(session)) {
+    /* RFC 7540 priority information is ignored, and the stream is
+       scheduled by its urgency instead. */
+    nghttp2_priority_spec_default_init(&pri_spec_default);
+    pri_spec = &pri_spec_default;
+
+    flags |= NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES;
+  } else if (pri_spec->stream_id != 0) {
     dep_stream = nghttp2_session_get_stream_raw(session, pri_spec->stream_id);
 
     if (!dep_stream &&
@@ -1049,7 +1688,7 @@ nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
 
       if (dep_stream == NULL) {
         if (stream_alloc) {
-          nghttp2_mem_free(mem, stream);
+          nghttp2_objpool_put(&session->stream_pool, stream);
         }
 
         return NULL;
@@ -1083,7 +1722,7 @@ nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
     rv = nghttp2_map_insert(&session->streams, &stream->map_entry);
     if (rv != 0) {
       nghttp2_stream_free(stream);
-      nghttp2_mem_free(mem, stream);
+      nghttp2_objpool_put(&session->stream_pool, stream);
       return NULL;
     }
   } else {
@@ -1117,6 +1756,11 @@ nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
     } else {
       ++session->num_incoming_streams;
     }
+    session_stats_on_stream_opened(session);
+  }
+
+  if (stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) {
+    return stream;
   }
 
   if (pri_spec->stream_id == 0) {
@@ -1158,7 +1802,7 @@ int nghttp2_session_close_stream(nghttp2_session *session, int32_t stream_id,
 
     item = stream->item;
 
-    rv = nghttp2_stream_detach_item(stream);
+    rv = session_detach_stream_item(session, stream);
 
     if (rv != 0) {
       return rv;
@@ -1170,7 +1814,7 @@ int nghttp2_session_close_stream(nghttp2_session *session, int32_t stream_id,
        free the item. */
     if (!item->queued && item != session->aob.item) {
       nghttp2_outbound_item_free(item, mem);
-      nghttp2_mem_free(mem, item);
+      nghttp2_objpool_put(&session->item_pool, item);
     }
   }
 
@@ -1214,7 +1858,10 @@ int nghttp2_session_close_stream(nghttp2_session *session, int32_t stream_id,
     /* On server side, retain stream at most MAX_CONCURRENT_STREAMS
        combined with the current active incoming streams to make
        dependency tree work better. */
-    nghttp2_session_keep_closed_stream(session, stream);
+    if (!session_can_compact_stream(session, stream) ||
+        session_compact_stream(session, stream) != 0) {
+      nghttp2_session_keep_closed_stream(session, stream);
+    }
   } else {
     rv = nghttp2_session_destroy_stream(session, stream);
     if (rv != 0) {
@@ -1227,13 +1874,10 @@ int nghttp2_session_close_stream(nghttp2_session *session, int32_t stream_id,
 
 int nghttp2_session_destroy_stream(nghttp2_session *session,
                                    nghttp2_stream *stream) {
-  nghttp2_mem *mem;
   int rv;
 
   DEBUGF("stream: destroy closed stream(%p)=%d\n", stream, stream->stream_id);
 
-  mem = &session->mem;
-
   if (nghttp2_stream_in_dep_tree(stream)) {
     rv = nghttp2_stream_dep_remove(stream);
     if (rv != 0) {
@@ -1243,7 +1887,7 @@ int nghttp2_session_destroy_stream(nghttp2_session *session,
 
   nghttp2_map_remove(&session->streams, stream->stream_id);
   nghttp2_stream_free(stream);
-  nghttp2_mem_free(mem, stream);
+  nghttp2_objpool_put(&session->stream_pool, stream);
 
   return 0;
 }
@@ -1308,11 +1952,22 @@ void nghttp2_session_detach_idle_stream(nghttp2_session *session,
   --session->num_idle_streams;
 }
 
+/*
+ * Returns nonzero if the memory usage of |session| exceeds 3/4 of
+ * its memory budget.  In this state, the session keeps no closed and
+ * idle streams, and refuses new incoming streams.
+ */
+static int session_is_memory_tight(nghttp2_session *session) {
+  return session->mem_acct.current > session->max_session_memory / 4 * 3;
+}
+
 int nghttp2_session_adjust_closed_stream(nghttp2_session *session) {
   size_t num_stream_max;
   int rv;
 
-  if (session->local_settings.max_concurrent_streams ==
+  if (session_is_memory_tight(session)) {
+    num_stream_max = 0;
+  } else if (session->local_settings.max_concurrent_streams ==
       NGHTTP2_DEFAULT_MAX_CONCURRENT_STREAMS) {
     num_stream_max = session->pending_local_max_concurrent_stream;
   } else {
@@ -1324,6 +1979,15 @@ int nghttp2_session_adjust_closed_stream(nghttp2_session *session) {
          session->num_closed_streams, session->num_incoming_streams,
          num_stream_max);
 
+  /* Compact streams have no dependent streams, so they are deleted
+     first. */
+  while (session->compact_closed_streams.len > 0 &&
+         session->num_closed_streams + session->compact_closed_streams.len +
+                 session->num_incoming_streams >
+             num_stream_max) {
+    session_del_compact_stream(session, session->compact_closed_streams.head);
+  }
+
   while (session->num_closed_streams > 0 &&
          session->num_closed_streams + session->num_incoming_streams >
              num_stream_max) {
@@ -1363,14 +2027,24 @@ int nghttp2_session_adjust_idle_stream(nghttp2_session *session) {
 
   /* Make minimum number of idle streams 16, and maximum 100, which
      are arbitrary chosen numbers. */
-  max = nghttp2_min(
-      100, nghttp2_max(
-               16, nghttp2_min(session->local_settings.max_concurrent_streams,
-                               session->pending_local_max_concurrent_stream)));
+  if (session_is_memory_tight(session)) {
+    max = 0;
+  } else {
+    max = nghttp2_min(
+        100,
+        nghttp2_max(16,
+                    nghttp2_min(session->local_settings.max_concurrent_streams,
+                                session->pending_local_max_concurrent_stream)));
+  }
 
   DEBUGF("stream: adjusting kept idle streams num_idle_streams=%zu, max=%zu\n",
          session->num_idle_streams, max);
 
+  while (session->compact_idle_streams.len > 0 &&
+         session->num_idle_streams + session->compact_idle_streams.len > max) {
+    session_del_compact_stream(session, session->compact_idle_streams.head);
+  }
+
   while (session->num_idle_streams > max) {
     nghttp2_stream *head;
     nghttp2_stream *next;
@@ -1401,6 +2075,52 @@ int nghttp2_session_adjust_idle_stream(nghttp2_session *session) {
   return 0;
 }
 
+/*
+ * Enforces the memory budget of |session|.  If the memory usage is
+ * tight, this function releases the closed and idle streams, and the
+ * free lists of the object pools.  If the usage still exceeds the
+ * budget, this function terminates |session| with
+ * NGHTTP2_ENHANCE_YOUR_CALM.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ */
+static int session_enforce_memory_budget(nghttp2_session *session) {
+  int rv;
+
+  if (!session_is_memory_tight(session)) {
+    return 0;
+  }
+
+  DEBUGF("session: memory usage %zu is tight, budget=%zu\n",
+         session->mem_acct.current, session->max_session_memory);
+
+  rv = nghttp2_session_adjust_closed_stream(session);
+  if (rv != 0) {
+    return rv;
+  }
+
+  rv = nghttp2_session_adjust_idle_stream(session);
+  if (rv != 0) {
+    return rv;
+  }
+
+  nghttp2_objpool_free(&session->nva_pool);
+  nghttp2_objpool_free(&session->item_pool);
+  nghttp2_objpool_free(&session->stream_pool);
+
+  if (session->mem_acct.current <= session->max_session_memory) {
+    return 0;
+  }
+
+  return session_terminate_session(session, session->last_proc_stream_id,
+                                   NGHTTP2_ENHANCE_YOUR_CALM,
+                                   "memory budget exceeded");
+}
+
 /*
  * Closes stream with stream ID |stream_id| if both transmission and
  * reception of the stream were disallowed. The |error_code| indicates
@@ -1762,6 +2482,28 @@ static int session_predicate_origin_send(nghttp2_session *session) {
   return 0;
 }
 
+static int session_predicate_priority_update_send(nghttp2_session *session,
+                                                  int32_t stream_id) {
+  nghttp2_stream *stream;
+
+  if (session_is_closing(session)) {
+    return NGHTTP2_ERR_SESSION_CLOSING;
+  }
+
+  stream = nghttp2_session_get_stream(session, stream_id);
+  if (stream == NULL) {
+    return 0;
+  }
+  if (stream->state == NGHTTP2_STREAM_CLOSING) {
+    return NGHTTP2_ERR_STREAM_CLOSING;
+  }
+  if (stream->shut_flags & NGHTTP2_SHUT_RD) {
+    return NGHTTP2_ERR_INVALID_STREAM_STATE;
+  }
+
+  return 0;
+}
+
 /* Take into account settings max frame size and both connection-level
    flow control here */
 static ssize_t
@@ -1956,6 +2698,67 @@ static int session_pack_extension(nghttp2_session *session, nghttp2_bufs *bufs,
   return 0;
 }
 
+/*
+ * If nghttp2_session_mem_send_batch() is running and its destination
+ * has room for a DATA frame of at most |datamax| bytes of payload,
+ * replaces the head buffer of session->aob.framebufs with the free
+ * space of the destination, so that the frame is packed there
+ * directly.  Padding, read_length_callback, which may reallocate the
+ * buffer, and NGHTTP2_DATA_FLAG_NO_COPY keep using the regular
+ * buffer.
+ */
+static void session_send_batch_wrap_framebuf(nghttp2_session *session,
+                                             size_t datamax) {
+  nghttp2_send_batch *batch = &session->send_batch;
+  nghttp2_bufs *framebufs = &session->aob.framebufs;
+  nghttp2_buf *buf;
+
+  if (batch->dest == NULL || session->callbacks.select_padding_callback ||
+      session->callbacks.read_length_callback ||
+      session->callbacks.send_data_callback ||
+      session->callbacks.get_data_ref_callback ||
+      nghttp2_buf_avail(batch->dest) < NGHTTP2_FRAME_HDLEN + datamax) {
+    return;
+  }
+
+  assert(framebufs->head == framebufs->cur);
+
+  if (!batch->framebuf_swapped) {
+    batch->framebuf = framebufs->head->buf;
+    batch->framebuf_swapped = 1;
+  }
+
+  buf = &framebufs->head->buf;
+
+  /* Without padding, no space is needed for Pad Length field. */
+  nghttp2_buf_wrap_init(buf, batch->dest->last,
+                        NGHTTP2_FRAME_HDLEN + datamax);
+  nghttp2_buf_shift_right(buf, NGHTTP2_FRAME_HDLEN);
+}
+
+/*
+ * Puts back the head buffer of session->aob.framebufs replaced by
+ * session_send_batch_wrap_framebuf().  Whatever was packed in the
+ * destination is considered to be sent.
+ */
+static void session_send_batch_restore_framebuf(nghttp2_session *session) {
+  nghttp2_send_batch *batch = &session->send_batch;
+  nghttp2_bufs *framebufs = &session->aob.framebufs;
+  nghttp2_buf *buf;
+
+  if (!batch->framebuf_swapped) {
+    return;
+  }
+
+  buf = &framebufs->head->buf;
+
+  *buf = batch->framebuf;
+  nghttp2_buf_reset(buf);
+  nghttp2_buf_shift_right(buf, framebufs->offset);
+
+  batch->framebuf_swapped = 0;
+}
+
 /*
  * This function serializes frame for transmission.
  *
@@ -1991,7 +2794,7 @@ static int session_prep_frame(nghttp2_session *session,
       if (stream) {
         int rv2;
 
-        rv2 = nghttp2_stream_detach_item(stream);
+        rv2 = session_detach_stream_item(session, stream);
 
         if (nghttp2_is_fatal(rv2)) {
           return rv2;
@@ -2010,37 +2813,45 @@ static int session_prep_frame(nghttp2_session *session,
          queue when session->remote_window_size > 0 */
       assert(session->remote_window_size > 0);
 
-      rv = nghttp2_stream_defer_item(stream,
+      rv = session_defer_stream_item(session, stream,
                                      NGHTTP2_STREAM_FLAG_DEFERRED_FLOW_CONTROL);
 
       if (nghttp2_is_fatal(rv)) {
         return rv;
       }
 
+      ++session->stats.stream_flow_control_blocked;
+
       session->aob.item = NULL;
-      active_outbound_item_reset(&session->aob, mem);
+      active_outbound_item_reset(&session->aob, &session->item_pool, mem);
       return NGHTTP2_ERR_DEFERRED;
     }
 
+    session_send_batch_wrap_framebuf(session, next_readmax);
+
     rv = nghttp2_session_pack_data(session, &session->aob.framebufs,
                                    next_readmax, frame, &item->aux_data.data,
                                    stream);
+    if (rv != 0) {
+      session_send_batch_restore_framebuf(session);
+    }
     if (rv == NGHTTP2_ERR_PAUSE) {
       return rv;
     }
     if (rv == NGHTTP2_ERR_DEFERRED) {
-      rv = nghttp2_stream_defer_item(stream, NGHTTP2_STREAM_FLAG_DEFERRED_USER);
+      rv = session_defer_stream_item(session, stream,
+                                     NGHTTP2_STREAM_FLAG_DEFERRED_USER);
 
       if (nghttp2_is_fatal(rv)) {
         return rv;
       }
 
       session->aob.item = NULL;
-      active_outbound_item_reset(&session->aob, mem);
+      active_outbound_item_reset(&session->aob, &session->item_pool, mem);
       return NGHTTP2_ERR_DEFERRED;
     }
     if (rv == NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE) {
-      rv = nghttp2_stream_detach_item(stream);
+      rv = session_detach_stream_item(session, stream);
 
       if (nghttp2_is_fatal(rv)) {
         return rv;
@@ -2056,7 +2867,7 @@ static int session_prep_frame(nghttp2_session *session,
     if (rv != 0) {
       int rv2;
 
-      rv2 = nghttp2_stream_detach_item(stream);
+      rv2 = session_detach_stream_item(session, stream);
 
       if (nghttp2_is_fatal(rv2)) {
         return rv2;
@@ -2095,6 +2906,11 @@ static int session_prep_frame(nghttp2_session *session,
 
       if (session_enforce_http_messaging(session)) {
         nghttp2_http_record_request_method(stream, frame);
+
+        if (aux_data->tmpl) {
+          nghttp2_http_record_request_method_nva(stream, aux_data->tmpl->nva,
+                                                 aux_data->tmpl->nvlen);
+        }
       }
     } else {
       nghttp2_stream *stream;
@@ -2129,12 +2945,16 @@ static int session_prep_frame(nghttp2_session *session,
         session, frame->headers.nva, frame->headers.nvlen,
         NGHTTP2_PRIORITY_SPECLEN);
 
+    if (aux_data->tmpl) {
+      estimated_payloadlen += aux_data->tmpl->bound;
+    }
+
     if (estimated_payloadlen > session->max_send_header_block_length) {
       return NGHTTP2_ERR_FRAME_SIZE_ERROR;
     }
 
-    rv = nghttp2_frame_pack_headers(&session->aob.framebufs, &frame->headers,
-                                    &session->hd_deflater);
+    rv = nghttp2_frame_pack_headers2(&session->aob.framebufs, &frame->headers,
+                                     aux_data->tmpl, &session->hd_deflater);
 
     if (rv != 0) {
       return rv;
@@ -2306,6 +3126,18 @@ static int session_prep_frame(nghttp2_session *session,
       }
 
       return 0;
+    case NGHTTP2_PRIORITY_UPDATE: {
+      nghttp2_ext_priority_update *priority_update = frame->ext.payload;
+      rv = session_predicate_priority_update_send(session,
+                                                  priority_update->stream_id);
+      if (rv != 0) {
+        return rv;
+      }
+
+      nghttp2_frame_pack_priority_update(&session->aob.framebufs, &frame->ext);
+
+      return 0;
+    }
     default:
       /* Unreachable here */
       assert(0);
@@ -2317,6 +3149,8 @@ static int session_prep_frame(nghttp2_session *session,
 
 nghttp2_outbound_item *
 nghttp2_session_get_next_ob_item(nghttp2_session *session) {
+  nghttp2_outbound_item *item;
+
   if (nghttp2_outbound_queue_top(&session->ob_urgent)) {
     return nghttp2_outbound_queue_top(&session->ob_urgent);
   }
@@ -2332,7 +3166,12 @@ nghttp2_session_get_next_ob_item(nghttp2_session *session) {
   }
 
   if (session->remote_window_size > 0) {
-    return nghttp2_stream_next_outbound_item(&session->root);
+    item = nghttp2_stream_next_outbound_item(&session->root);
+    if (item) {
+      return item;
+    }
+
+    return session_sched_get_next_outbound_item(session);
   }
 
   return NULL;
@@ -2366,7 +3205,12 @@ nghttp2_session_pop_next_ob_item(nghttp2_session *session) {
   }
 
   if (session->remote_window_size > 0) {
-    return nghttp2_stream_next_outbound_item(&session->root);
+    item = nghttp2_stream_next_outbound_item(&session->root);
+    if (item) {
+      return item;
+    }
+
+    return session_sched_get_next_outbound_item(session);
   }
 
   return NULL;
@@ -2476,26 +3320,114 @@ static int session_close_stream_on_goaway(nghttp2_session *session,
   return 0;
 }
 
-static void reschedule_stream(nghttp2_stream *stream) {
-  stream->last_writelen = stream->item->frame.hd.length;
+/*
+ * Moves |stream| behind the other streams of the same urgency after
+ * one DATA frame is written if it is incremental.  Non-incremental
+ * stream keeps its position so that it is served until it completes.
+ */
+static void session_reschedule_stream(nghttp2_session *session,
+                                      nghttp2_stream *stream) {
+  nghttp2_pq *pq;
+  uint32_t urgency;
+
+  stream->last_writelen = stream->item->frame.hd.length;
+
+  if (!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES)) {
+    nghttp2_stream_reschedule(stream);
+    return;
+  }
+
+  if (!stream->queued || !nghttp2_extpri_uint8_inc(stream->extpri)) {
+    return;
+  }
+
+  urgency = nghttp2_extpri_uint8_urgency(stream->extpri);
+  pq = &session->sched[urgency];
+
+  if (nghttp2_pq_size(pq) == 1) {
+    return;
+  }
+
+  nghttp2_pq_remove(pq, &stream->pq_entry);
+
+  ++stream->cycle;
+
+  /* This does not fail because we have just removed an entry. */
+  nghttp2_pq_push(pq, &stream->pq_entry);
+}
+
+static int session_update_stream_consumed_size(nghttp2_session *session,
+                                               nghttp2_stream *stream,
+                                               size_t delta_size);
+
+static int session_update_connection_consumed_size(nghttp2_session *session,
+                                                   size_t delta_size);
+
+static int session_update_recv_connection_window_size(nghttp2_session *session,
+                                                      size_t delta_size);
+
+static int session_update_recv_stream_window_size(nghttp2_session *session,
+                                                  nghttp2_stream *stream,
+                                                  size_t delta_size,
+                                                  int send_window_update);
+
+/*
+ * Counts the frame in |session->aob| which was just sent.  HEADERS
+ * and PUSH_PROMISE are reported once for each buffer in
+ * |session->aob.framebufs|, all but the first of which are
+ * CONTINUATION frames.
+ */
+static void session_stats_on_frame_sent(nghttp2_session *session) {
+  nghttp2_session_stats *stats = &session->stats;
+  nghttp2_bufs *framebufs = &session->aob.framebufs;
+  nghttp2_frame *frame = &session->aob.item->frame;
+  nghttp2_buf_chain *ci;
+  size_t idx;
+  size_t payloadlen;
+
+  payloadlen = frame->hd.length;
+
+  switch (frame->hd.type) {
+  case NGHTTP2_HEADERS:
+  case NGHTTP2_PUSH_PROMISE:
+    if (framebufs->cur != framebufs->head) {
+      ci = framebufs->cur;
+
+      ++stats->frames_sent[NGHTTP2_CONTINUATION];
+      stats->bytes_sent[NGHTTP2_CONTINUATION] +=
+          (size_t)(ci->buf.last - ci->buf.begin) - framebufs->offset +
+          NGHTTP2_FRAME_HDLEN;
+
+      return;
+    }
+
+    /* The rest of the header block is stored in the following buffers
+       after the offset.  Unused buffers have nothing after it. */
+    for (ci = framebufs->head->next; ci; ci = ci->next) {
+      payloadlen -= (size_t)(ci->buf.last - ci->buf.begin) - framebufs->offset;
+    }
 
-  nghttp2_stream_reschedule(stream);
-}
+    break;
+  case NGHTTP2_RST_STREAM:
+    ++stats->num_streams_reset_sent;
+    if (frame->rst_stream.error_code == NGHTTP2_REFUSED_STREAM) {
+      ++stats->num_streams_refused_sent;
+    }
 
-static int session_update_stream_consumed_size(nghttp2_session *session,
-                                               nghttp2_stream *stream,
-                                               size_t delta_size);
+    break;
+  case NGHTTP2_DATA:
+    if (session->remote_window_size <= (int32_t)payloadlen) {
+      ++stats->connection_flow_control_blocked;
+    }
 
-static int session_update_connection_consumed_size(nghttp2_session *session,
-                                                   size_t delta_size);
+    break;
+  }
 
-static int session_update_recv_connection_window_size(nghttp2_session *session,
-                                                      size_t delta_size);
+  idx = stats_frame_type_index(frame->hd.type);
 
-static int session_update_recv_stream_window_size(nghttp2_session *session,
-                                                  nghttp2_stream *stream,
-                                                  size_t delta_size,
-                                                  int send_window_update);
+  ++stats->frames_sent[idx];
+  stats->bytes_sent[idx] += payloadlen + NGHTTP2_FRAME_HDLEN;
+}
 
 /*
  * Called after a frame is sent.  This function runs
@@ -2521,6 +3453,8 @@ static int session_after_frame_sent1(nghttp2_session *session) {
 
   frame = &item->frame;
 
+  session_stats_on_frame_sent(session);
+
   if (frame->hd.type == NGHTTP2_DATA) {
     nghttp2_data_aux_data *aux_data;
 
@@ -2536,13 +3470,13 @@ static int session_after_frame_sent1(nghttp2_session *session) {
     }
 
     if (stream && aux_data->eof) {
-      rv = nghttp2_stream_detach_item(stream);
+      rv = session_detach_stream_item(session, stream);
       if (nghttp2_is_fatal(rv)) {
         return rv;
       }
 
       /* Call on_frame_send_callback after
-         nghttp2_stream_detach_item(), so that application can issue
+         session_detach_stream_item(), so that application can issue
          nghttp2_submit_data() in the callback. */
       if (session->callbacks.on_frame_send_callback) {
         rv = session_call_on_frame_send(session, frame);
@@ -2630,6 +3564,7 @@ static int session_after_frame_sent1(nghttp2_session *session) {
     case NGHTTP2_HCAT_PUSH_RESPONSE:
       stream->flags = (uint8_t)(stream->flags & ~NGHTTP2_STREAM_FLAG_PUSH);
       ++session->num_outgoing_streams;
+      session_stats_on_stream_opened(session);
     /* Fall through */
     case NGHTTP2_HCAT_RESPONSE:
       stream->state = NGHTTP2_STREAM_OPENED;
@@ -2809,7 +3744,7 @@ static int session_after_frame_sent2(nghttp2_session *session) {
       }
     }
 
-    active_outbound_item_reset(&session->aob, mem);
+    active_outbound_item_reset(&session->aob, &session->item_pool, mem);
 
     return 0;
   }
@@ -2823,7 +3758,7 @@ static int session_after_frame_sent2(nghttp2_session *session) {
      on_frame_send_callback (call from session_after_frame_sent1),
      which attach data to stream.  We don't want to detach it. */
   if (aux_data->eof) {
-    active_outbound_item_reset(aob, mem);
+    active_outbound_item_reset(aob, &session->item_pool, mem);
 
     return 0;
   }
@@ -2837,20 +3772,20 @@ static int session_after_frame_sent2(nghttp2_session *session) {
      further data. */
   if (nghttp2_session_predicate_data_send(session, stream) != 0) {
     if (stream) {
-      rv = nghttp2_stream_detach_item(stream);
+      rv = session_detach_stream_item(session, stream);
 
       if (nghttp2_is_fatal(rv)) {
         return rv;
       }
     }
 
-    active_outbound_item_reset(aob, mem);
+    active_outbound_item_reset(aob, &session->item_pool, mem);
 
     return 0;
   }
 
   aob->item = NULL;
-  active_outbound_item_reset(&session->aob, mem);
+  active_outbound_item_reset(&session->aob, &session->item_pool, mem);
 
   return 0;
 }
@@ -2864,6 +3799,13 @@ static int session_call_send_data(nghttp2_session *session,
   nghttp2_frame *frame;
   nghttp2_data_aux_data *aux_data;
 
+  if (session->callbacks.send_data_callback == NULL) {
+    DEBUGF("send: send_data_callback is required without "
+           "nghttp2_session_mem_sendv\n");
+
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+
   buf = &framebufs->cur->buf;
   frame = &item->frame;
   length = frame->hd.length - frame->data.padlen;
@@ -2884,9 +3826,106 @@ static int session_call_send_data(nghttp2_session *session,
   }
 }
 
+/*
+ * Returns the next chunk of serialized data in |*data_ptr|.  If
+ * |ref| is not NULL, DATA frame with NGHTTP2_DATA_FLAG_NO_COPY is
+ * not sent by send_data_callback.  Instead, this function returns
+ * its frame header, and assigns the application data obtained by
+ * get_data_ref_callback to |*ref|.
+ */
+static int session_call_get_data_ref(nghttp2_session *session,
+                                     nghttp2_outbound_item *item,
+                                     nghttp2_vec *ref) {
+  int rv;
+  size_t length;
+  nghttp2_frame *frame;
+  nghttp2_data_aux_data *aux_data;
+  const uint8_t *data = NULL;
+
+  if (session->callbacks.get_data_ref_callback == NULL) {
+    DEBUGF("send: nghttp2_session_mem_sendv requires "
+           "get_data_ref_callback for NGHTTP2_DATA_FLAG_NO_COPY\n");
+
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+
+  frame = &item->frame;
+  length = frame->hd.length - frame->data.padlen;
+  aux_data = &item->aux_data.data;
+
+  rv = session->callbacks.get_data_ref_callback(session, frame, length, &data,
+                                                &aux_data->data_prd.source,
+                                                session->user_data);
+
+  switch (rv) {
+  case 0:
+    if (data == NULL && length) {
+      return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+
+    ref->base = (uint8_t *)data;
+    ref->len = length;
+
+    return 0;
+  case NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE:
+    return rv;
+  default:
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+}
+
+/*
+ * Carries out the operations enqueued by nghttp2_session_enqueue_*()
+ * functions in the order they were enqueued.  Non-fatal errors, such
+ * as the stream being closed in the meantime, are ignored like the
+ * application would do when it calls the corresponding functions
+ * itself.
+ *
+ * This function returns 0 if it succeeds, or one of the fatal error
+ * codes.
+ */
+static int session_process_submissions(nghttp2_session *session) {
+  nghttp2_mpscq_entry *qe, *next;
+  nghttp2_submission *sub;
+  int rv = 0;
+
+  qe = nghttp2_mpscq_pop_all(&session->submissionq);
+
+  for (; qe; qe = next) {
+    next = qe->next;
+    sub = (nghttp2_submission *)qe;
+
+    if (rv == 0) {
+      switch (sub->type) {
+      case NGHTTP2_SUBMISSION_DATA:
+        rv = nghttp2_submit_data(session, sub->flags, sub->stream_id,
+                                 &sub->data_prd);
+        break;
+      case NGHTTP2_SUBMISSION_RESUME_DATA:
+        rv = nghttp2_session_resume_data(session, sub->stream_id);
+        break;
+      case NGHTTP2_SUBMISSION_RST_STREAM:
+        rv = nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE,
+                                       sub->stream_id, sub->error_code);
+        break;
+      }
+
+      if (!nghttp2_is_fatal(rv)) {
+        rv = 0;
+      }
+    }
+
+    /* After a fatal error, the rest is just freed. */
+    nghttp2_mem_free(&session->mem_acct.parent, sub);
+  }
+
+  return rv;
+}
+
 static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
                                                  const uint8_t **data_ptr,
-                                                 int fast_cb) {
+                                                 int fast_cb,
+                                                 nghttp2_vec *ref) {
   int rv;
   nghttp2_active_outbound_item *aob;
   nghttp2_bufs *framebufs;
@@ -2896,6 +3935,11 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
   aob = &session->aob;
   framebufs = &aob->framebufs;
 
+  rv = session_process_submissions(session);
+  if (rv != 0) {
+    return rv;
+  }
+
   /* We may have idle streams more than we expect (e.g.,
      nghttp2_session_change_stream_priority() or
      nghttp2_session_create_idle_stream()).  Adjust them here. */
@@ -2941,7 +3985,7 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
                   session, frame, rv, session->user_data) != 0) {
 
             nghttp2_outbound_item_free(item, mem);
-            nghttp2_mem_free(mem, item);
+            nghttp2_objpool_put(&session->item_pool, item);
 
             return NGHTTP2_ERR_CALLBACK_FAILURE;
           }
@@ -2977,8 +4021,8 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
         }
 
         nghttp2_outbound_item_free(item, mem);
-        nghttp2_mem_free(mem, item);
-        active_outbound_item_reset(aob, mem);
+        nghttp2_objpool_put(&session->item_pool, item);
+        active_outbound_item_reset(aob, &session->item_pool, mem);
 
         if (rv == NGHTTP2_ERR_HEADER_COMP) {
           /* If header compression error occurred, should terminiate
@@ -3051,7 +4095,7 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
             }
           }
 
-          active_outbound_item_reset(aob, mem);
+          active_outbound_item_reset(aob, &session->item_pool, mem);
 
           break;
         }
@@ -3118,24 +4162,35 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
 
       DEBUGF("send: no copy DATA\n");
 
+      if (session->send_batch.dest &&
+          nghttp2_buf_len(session->send_batch.dest)) {
+        /* send_data_callback writes DATA on its own.  Let the
+           application write out the batch before it. */
+        return 0;
+      }
+
       frame = &aob->item->frame;
 
       stream = nghttp2_session_get_stream(session, frame->hd.stream_id);
       if (stream == NULL) {
         DEBUGF("send: no copy DATA cancelled because stream was closed\n");
 
-        active_outbound_item_reset(aob, mem);
+        active_outbound_item_reset(aob, &session->item_pool, mem);
 
         break;
       }
 
-      rv = session_call_send_data(session, aob->item, framebufs);
+      if (ref) {
+        rv = session_call_get_data_ref(session, aob->item, ref);
+      } else {
+        rv = session_call_send_data(session, aob->item, framebufs);
+      }
       if (nghttp2_is_fatal(rv)) {
         return rv;
       }
 
       if (rv == NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE) {
-        rv = nghttp2_stream_detach_item(stream);
+        rv = session_detach_stream_item(session, stream);
 
         if (nghttp2_is_fatal(rv)) {
           return rv;
@@ -3147,11 +4202,25 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
           return rv;
         }
 
-        active_outbound_item_reset(aob, mem);
+        active_outbound_item_reset(aob, &session->item_pool, mem);
 
         break;
       }
 
+      if (ref) {
+        nghttp2_buf *buf;
+
+        /* framebufs only has frame header.  The rest of buffer is
+           left uninitialized. */
+        buf = &framebufs->cur->buf;
+        *data_ptr = buf->pos;
+        buf->pos = buf->last;
+
+        aob->state = NGHTTP2_OB_SEND_DATA;
+
+        return NGHTTP2_FRAME_HDLEN;
+      }
+
       if (rv == NGHTTP2_ERR_WOULDBLOCK) {
         return 0;
       }
@@ -3185,7 +4254,7 @@ static ssize_t nghttp2_session_mem_send_internal(nghttp2_session *session,
 
       if (buf->pos == buf->last) {
         DEBUGF("send: end transmission of client magic\n");
-        active_outbound_item_reset(aob, mem);
+        active_outbound_item_reset(aob, &session->item_pool, mem);
         break;
       }
 
@@ -3207,7 +4276,14 @@ ssize_t nghttp2_session_mem_send(nghttp2_session *session,
 
   *data_ptr = NULL;
 
-  len = nghttp2_session_mem_send_internal(session, data_ptr, 1);
+  if (session->sendv.nrefs) {
+    rv = session_release_data_refs(session);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  len = nghttp2_session_mem_send_internal(session, data_ptr, 1, NULL);
   if (len <= 0) {
     return len;
   }
@@ -3227,16 +4303,316 @@ ssize_t nghttp2_session_mem_send(nghttp2_session *session,
   return len;
 }
 
+/*
+ * Rewinds the buffers of the last batch.  Buffers of the default size
+ * are kept for the next batch, and larger ones are freed.
+ */
+static void session_sendv_batch_reset(nghttp2_session *session) {
+  nghttp2_sendv_batch *sendv = &session->sendv;
+  nghttp2_mem *mem = &session->mem;
+  nghttp2_buf_chain *chain, **pchain;
+
+  for (pchain = &sendv->head; *pchain;) {
+    chain = *pchain;
+
+    if (nghttp2_buf_cap(&chain->buf) != NGHTTP2_FRAMEBUF_CHUNKLEN) {
+      *pchain = chain->next;
+      nghttp2_buf_free(&chain->buf, mem);
+      nghttp2_mem_free(mem, chain);
+      continue;
+    }
+
+    nghttp2_buf_reset(&chain->buf);
+    pchain = &chain->next;
+  }
+
+  sendv->cur = sendv->head;
+}
+
+/*
+ * Returns |len| bytes of contiguous memory from the batch buffers, or
+ * NULL if it fails to allocate memory.
+ */
+static uint8_t *session_sendv_alloc(nghttp2_session *session, size_t len) {
+  nghttp2_sendv_batch *sendv = &session->sendv;
+  nghttp2_mem *mem = &session->mem;
+  nghttp2_buf_chain *chain;
+  uint8_t *p;
+  int rv;
+
+  if (sendv->cur == NULL || nghttp2_buf_avail(&sendv->cur->buf) < len) {
+    if (sendv->cur && sendv->cur->next &&
+        nghttp2_buf_avail(&sendv->cur->next->buf) >= len) {
+      sendv->cur = sendv->cur->next;
+    } else {
+      chain = nghttp2_mem_malloc(mem, sizeof(nghttp2_buf_chain));
+      if (chain == NULL) {
+        return NULL;
+      }
+
+      rv = nghttp2_buf_init2(
+          &chain->buf, nghttp2_max(len, NGHTTP2_FRAMEBUF_CHUNKLEN), mem);
+      if (rv != 0) {
+        nghttp2_mem_free(mem, chain);
+        return NULL;
+      }
+
+      /* Insert after the current buffer so that the retained buffers
+         are still reachable. */
+      if (sendv->cur) {
+        chain->next = sendv->cur->next;
+        sendv->cur->next = chain;
+      } else {
+        chain->next = sendv->head;
+        sendv->head = chain;
+      }
+
+      sendv->cur = chain;
+    }
+  }
+
+  p = sendv->cur->buf.last;
+  sendv->cur->buf.last += len;
+
+  return p;
+}
+
+/*
+ * Appends [|data|, |data| + |len|) to |vec|.  If it immediately
+ * follows the last element, they are coalesced.
+ */
+static void sendv_add(nghttp2_vec *vec, size_t *pnvec, const uint8_t *data,
+                      size_t len) {
+  nghttp2_vec *last;
+
+  if (len == 0) {
+    return;
+  }
+
+  if (*pnvec) {
+    last = &vec[*pnvec - 1];
+
+    if (last->base + last->len == data) {
+      last->len += len;
+      return;
+    }
+  }
+
+  vec[*pnvec].base = (uint8_t *)data;
+  vec[*pnvec].len = len;
+  ++*pnvec;
+}
+
+static int session_sendv_add_ref(nghttp2_session *session, int32_t stream_id,
+                                 const nghttp2_vec *data) {
+  nghttp2_sendv_batch *sendv = &session->sendv;
+  nghttp2_mem *mem = &session->mem;
+  nghttp2_data_ref *refs;
+  size_t refcap;
+
+  if (sendv->nrefs == sendv->refcap) {
+    refcap = nghttp2_max(sendv->refcap * 2, 16);
+
+    refs = nghttp2_mem_realloc(mem, sendv->refs,
+                               sizeof(nghttp2_data_ref) * refcap);
+    if (refs == NULL) {
+      return NGHTTP2_ERR_NOMEM;
+    }
+
+    sendv->refs = refs;
+    sendv->refcap = refcap;
+  }
+
+  sendv->refs[sendv->nrefs].data = data->base;
+  sendv->refs[sendv->nrefs].len = data->len;
+  sendv->refs[sendv->nrefs].stream_id = stream_id;
+  ++sendv->nrefs;
+
+  return 0;
+}
+
+ssize_t nghttp2_session_mem_sendv(nghttp2_session *session, nghttp2_vec *vec,
+                                  size_t veccnt) {
+  int rv;
+  ssize_t len;
+  const uint8_t *data;
+  nghttp2_vec ref;
+  nghttp2_frame *frame;
+  size_t nvec = 0;
+  size_t padlen;
+  int no_copy;
+  uint8_t *p;
+
+  if (veccnt < NGHTTP2_MEM_SENDV_MIN_VECCNT) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  rv = session_release_data_refs(session);
+  if (rv != 0) {
+    return rv;
+  }
+
+  session_sendv_batch_reset(session);
+
+  /* One iteration produces at most 3 elements: frame header, DATA
+     payload by reference, and padding. */
+  while (veccnt - nvec >= NGHTTP2_MEM_SENDV_MIN_VECCNT) {
+    ref.base = NULL;
+    ref.len = 0;
+
+    data = NULL;
+
+    len = nghttp2_session_mem_send_internal(session, &data, 1, &ref);
+    if (len < 0) {
+      return len;
+    }
+
+    if (len == 0) {
+      break;
+    }
+
+    frame = session->aob.item ? &session->aob.item->frame : NULL;
+    no_copy = frame && frame->hd.type == NGHTTP2_DATA &&
+              session->aob.item->aux_data.data.no_copy;
+    padlen = no_copy ? frame->data.padlen : 0;
+
+    p = session_sendv_alloc(session, (size_t)len + (padlen > 0));
+    if (p == NULL) {
+      return NGHTTP2_ERR_NOMEM;
+    }
+
+    memcpy(p, data, (size_t)len);
+
+    if (padlen) {
+      /* Pad Length field */
+      p[len] = (uint8_t)(padlen - 1);
+    }
+
+    sendv_add(vec, &nvec, p, (size_t)len + (padlen > 0));
+
+    if (no_copy) {
+      if (ref.len) {
+        rv = session_sendv_add_ref(session, frame->hd.stream_id, &ref);
+        if (rv != 0) {
+          return rv;
+        }
+
+        sendv_add(vec, &nvec, ref.base, ref.len);
+      }
+
+      if (padlen > 1) {
+        p = session_sendv_alloc(session, padlen - 1);
+        if (p == NULL) {
+          return NGHTTP2_ERR_NOMEM;
+        }
+
+        memset(p, 0, padlen - 1);
+
+        sendv_add(vec, &nvec, p, padlen - 1);
+      }
+    }
+
+    if (session->aob.item) {
+      /* See nghttp2_session_mem_send() */
+      rv = session_after_frame_sent1(session);
+      if (rv < 0) {
+        assert(nghttp2_is_fatal(rv));
+        return (ssize_t)rv;
+      }
+    }
+  }
+
+  return (ssize_t)nvec;
+}
+
+ssize_t nghttp2_session_mem_send_batch(nghttp2_session *session,
+                                       uint8_t *buf, size_t buflen) {
+  int rv;
+  ssize_t datalen;
+  const uint8_t *data;
+  nghttp2_buf dest;
+  nghttp2_bufs *framebufs;
+  size_t n;
+
+  framebufs = &session->aob.framebufs;
+  datalen = 0;
+
+  if (session->sendv.nrefs) {
+    rv = session_release_data_refs(session);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  nghttp2_buf_wrap_init(&dest, buf, buflen);
+
+  session->send_batch.dest = &dest;
+
+  while (nghttp2_buf_avail(&dest)) {
+    data = NULL;
+
+    datalen = nghttp2_session_mem_send_internal(session, &data, 1, NULL);
+
+    session_send_batch_restore_framebuf(session);
+
+    if (datalen <= 0) {
+      break;
+    }
+
+    n = nghttp2_min((size_t)datalen, nghttp2_buf_avail(&dest));
+
+    /* DATA may have been packed in place. */
+    if (data != dest.last) {
+      memcpy(dest.last, data, n);
+    }
+
+    dest.last += n;
+
+    if (n < (size_t)datalen) {
+      /* The rest is returned by the next call. */
+      framebufs->cur->buf.pos -= (size_t)datalen - n;
+      break;
+    }
+
+    if (session->aob.item) {
+      /* See nghttp2_session_mem_send() */
+      rv = session_after_frame_sent1(session);
+      if (rv < 0) {
+        assert(nghttp2_is_fatal(rv));
+        datalen = rv;
+        break;
+      }
+    }
+  }
+
+  session->send_batch.dest = NULL;
+
+  if (datalen < 0) {
+    return datalen;
+  }
+
+  return (ssize_t)nghttp2_buf_len(&dest);
+}
+
 int nghttp2_session_send(nghttp2_session *session) {
   const uint8_t *data = NULL;
   ssize_t datalen;
   ssize_t sentlen;
   nghttp2_bufs *framebufs;
 
+  int rv;
+
   framebufs = &session->aob.framebufs;
 
+  if (session->sendv.nrefs) {
+    rv = session_release_data_refs(session);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
   for (;;) {
-    datalen = nghttp2_session_mem_send_internal(session, &data, 0);
+    datalen = nghttp2_session_mem_send_internal(session, &data, 0, NULL);
     if (datalen <= 0) {
       return (int)datalen;
     }
@@ -3323,9 +4699,17 @@ static int session_call_on_header(nghttp2_session *session,
                                   const nghttp2_frame *frame,
                                   const nghttp2_hd_nv *nv) {
   int rv = 0;
+  int rv2;
   if (session->callbacks.on_header_callback2) {
     rv = session->callbacks.on_header_callback2(
         session, frame, nv->name, nv->value, nv->flags, session->user_data);
+
+    /* The application may keep the header value which refers to the
+       input buffer. */
+    rv2 = nghttp2_hd_inflate_unborrow(&session->hd_inflater);
+    if (rv2 != 0) {
+      return rv2;
+    }
   } else if (session->callbacks.on_header_callback) {
     rv = session->callbacks.on_header_callback(
         session, frame, nv->name->base, nv->name->len, nv->value->base,
@@ -3345,10 +4729,17 @@ static int session_call_on_header(nghttp2_session *session,
 static int session_call_on_invalid_header(nghttp2_session *session,
                                           const nghttp2_frame *frame,
                                           const nghttp2_hd_nv *nv) {
-  int rv;
+  int rv, rv2;
   if (session->callbacks.on_invalid_header_callback2) {
     rv = session->callbacks.on_invalid_header_callback2(
         session, frame, nv->name, nv->value, nv->flags, session->user_data);
+
+    /* The application may keep the header value which refers to the
+       input buffer. */
+    rv2 = nghttp2_hd_inflate_unborrow(&session->hd_inflater);
+    if (rv2 != 0) {
+      return rv2;
+    }
   } else if (session->callbacks.on_invalid_header_callback) {
     rv = session->callbacks.on_invalid_header_callback(
         session, frame, nv->name->base, nv->name->len, nv->value->base,
@@ -3532,6 +4923,71 @@ static int session_inflate_handle_invalid_connection(nghttp2_session *session,
   return NGHTTP2_ERR_IGN_HEADER_BLOCK;
 }
 
+/*
+ * Adds the size of |nv| to the size of the header list being
+ * received, if NGHTTP2_OPTMASK_ENFORCE_MAX_HEADER_LIST_SIZE is set.
+ * Header fields are counted as they are decoded from each HEADERS,
+ * PUSH_PROMISE or CONTINUATION chunk, so that the limit is enforced
+ * without buffering the header list.  If the size exceeds the
+ * SETTINGS_MAX_HEADER_LIST_SIZE we advertised, |subject_stream| is
+ * reset with ENHANCE_YOUR_CALM.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE
+ *     The header list is too large.  The rest of header block must be
+ *     decoded without invoking callbacks.
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+static int session_add_header_list_len(nghttp2_session *session,
+                                       nghttp2_frame *frame,
+                                       nghttp2_stream *subject_stream,
+                                       const nghttp2_hd_nv *nv) {
+  nghttp2_inbound_frame *iframe = &session->iframe;
+  int rv;
+
+  if (!(session->opt_flags & NGHTTP2_OPTMASK_ENFORCE_MAX_HEADER_LIST_SIZE)) {
+    return 0;
+  }
+
+  iframe->header_list_len +=
+      nv->name->len + nv->value->len + NGHTTP2_HD_ENTRY_OVERHEAD;
+
+  if (iframe->header_list_len <=
+      session->local_settings.max_header_list_size) {
+    return 0;
+  }
+
+  DEBUGF("recv: header list too large: stream=%d, size=%zu, limit=%u\n",
+         frame->hd.stream_id, iframe->header_list_len,
+         session->local_settings.max_header_list_size);
+
+  rv = session_call_error_callback(
+      session, NGHTTP2_ERR_HTTP_HEADER,
+      "Header list is larger than SETTINGS_MAX_HEADER_LIST_SIZE: frame "
+      "type: %u, stream: %d, limit: %u",
+      frame->hd.type, frame->hd.stream_id,
+      session->local_settings.max_header_list_size);
+
+  if (nghttp2_is_fatal(rv)) {
+    return rv;
+  }
+
+  if (subject_stream) {
+    rv = nghttp2_session_add_rst_stream(session, subject_stream->stream_id,
+                                        NGHTTP2_ENHANCE_YOUR_CALM);
+    if (nghttp2_is_fatal(rv)) {
+      return rv;
+    }
+  }
+
+  return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+}
+
 /*
  * Inflates header block in the memory pointed by |in| with |inlen|
  * bytes. If this function returns NGHTTP2_ERR_PAUSE, the caller must
@@ -3551,7 +5007,9 @@ static int session_inflate_handle_invalid_connection(nghttp2_session *session,
  *     The callback function failed.
  * NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE
  *     The callback returns this error code, indicating that this
- *     stream should be RST_STREAMed.
+ *     stream should be RST_STREAMed, or the header list exceeds
+ *     SETTINGS_MAX_HEADER_LIST_SIZE (see
+ *     session_add_header_list_len()).
  * NGHTTP2_ERR_NOMEM
  *     Out of memory.
  * NGHTTP2_ERR_PAUSE
@@ -3618,7 +5076,11 @@ static int inflate_header_block(nghttp2_session *session, nghttp2_frame *frame,
     DEBUGF("recv: proclen=%zd\n", proclen);
 
     if (call_header_cb && (inflate_flags & NGHTTP2_HD_INFLATE_EMIT)) {
-      rv = 0;
+      rv = session_add_header_list_len(session, frame, subject_stream, &nv);
+      if (rv != 0) {
+        return rv;
+      }
+
       if (subject_stream && session_enforce_http_messaging(session)) {
         rv = nghttp2_http_on_header(session, subject_stream, frame, &nv,
                                     trailer);
@@ -3793,6 +5255,18 @@ static int session_after_header_block_received(nghttp2_session *session) {
   }
 
   if (call_cb) {
+    if (session->server && frame->hd.type == NGHTTP2_HEADERS &&
+        frame->headers.cat == NGHTTP2_HCAT_REQUEST &&
+        (stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) &&
+        (stream->http_flags & NGHTTP2_HTTP_FLAG_PRIORITY) &&
+        !(stream->flags & NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES)) {
+      rv = session_update_stream_priority(session, stream, stream->http_extpri);
+      if (rv != 0) {
+        assert(nghttp2_is_fatal(rv));
+        return rv;
+      }
+    }
+
     rv = session_call_on_frame_received(session, frame);
     if (nghttp2_is_fatal(rv)) {
       return rv;
@@ -3884,7 +5358,8 @@ int nghttp2_session_on_request_headers_received(nghttp2_session *session,
         session, frame, NGHTTP2_ERR_PROTO, "request HEADERS: depend on itself");
   }
 
-  if (session_is_incoming_concurrent_streams_pending_max(session)) {
+  if (session_is_incoming_concurrent_streams_pending_max(session) ||
+      session_is_memory_tight(session)) {
     return session_inflate_handle_invalid_stream(session, frame,
                                                  NGHTTP2_ERR_REFUSED_STREAM);
   }
@@ -3970,7 +5445,8 @@ int nghttp2_session_on_push_response_headers_received(nghttp2_session *session,
     return NGHTTP2_ERR_IGN_HEADER_BLOCK;
   }
 
-  if (session_is_incoming_concurrent_streams_pending_max(session)) {
+  if (session_is_incoming_concurrent_streams_pending_max(session) ||
+      session_is_memory_tight(session)) {
     return session_inflate_handle_invalid_stream(session, frame,
                                                  NGHTTP2_ERR_REFUSED_STREAM);
   }
@@ -3980,6 +5456,7 @@ int nghttp2_session_on_push_response_headers_received(nghttp2_session *session,
     --session->num_incoming_reserved_streams;
   }
   ++session->num_incoming_streams;
+  session_stats_on_stream_opened(session);
   rv = session_call_on_begin_headers(session, frame);
   if (rv != 0) {
     return rv;
@@ -4103,6 +5580,15 @@ int nghttp2_session_on_priority_received(nghttp2_session *session,
       return NGHTTP2_ERR_NOMEM;
     }
 
+    /* Nothing depends on the new idle stream yet */
+    if (session_can_compact_stream(session, stream)) {
+      nghttp2_session_detach_idle_stream(session, stream);
+
+      if (session_compact_stream(session, stream) != 0) {
+        nghttp2_session_keep_idle_stream(session, stream);
+      }
+    }
+
     rv = nghttp2_session_adjust_idle_stream(session);
     if (nghttp2_is_fatal(rv)) {
       return rv;
@@ -4147,6 +5633,11 @@ int nghttp2_session_on_rst_stream_received(nghttp2_session *session,
                                              "RST_STREAM: stream in idle");
   }
 
+  ++session->stats.num_streams_reset_recv;
+  if (frame->rst_stream.error_code == NGHTTP2_REFUSED_STREAM) {
+    ++session->stats.num_streams_refused_recv;
+  }
+
   stream = nghttp2_session_get_stream(session, frame->hd.stream_id);
   if (stream) {
     /* We may use stream->shut_flags for strict error checking. */
@@ -4195,8 +5686,8 @@ static int update_remote_initial_window_size_func(nghttp2_map_entry *entry,
   if (stream->remote_window_size > 0 &&
       nghttp2_stream_check_deferred_by_flow_control(stream)) {
 
-    rv = nghttp2_stream_resume_deferred_item(
-        stream, NGHTTP2_STREAM_FLAG_DEFERRED_FLOW_CONTROL);
+    rv = session_resume_deferred_stream_item(
+        arg->session, stream, NGHTTP2_STREAM_FLAG_DEFERRED_FLOW_CONTROL);
 
     if (nghttp2_is_fatal(rv)) {
       return rv;
@@ -4361,6 +5852,9 @@ int nghttp2_session_update_local_settings(nghttp2_session *session,
     case NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE:
       session->local_settings.max_header_list_size = iv[i].value;
       break;
+    case NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES:
+      session->local_settings.no_rfc7540_priorities = iv[i].value;
+      break;
     }
   }
 
@@ -4500,6 +5994,36 @@ int nghttp2_session_on_settings_received(nghttp2_session *session,
       session->remote_settings.max_header_list_size = entry->value;
 
       break;
+    case NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES:
+
+      if (entry->value != 0 && entry->value != 1) {
+        return session_handle_invalid_connection(
+            session, frame, NGHTTP2_ERR_PROTO,
+            "SETTINGS: invalid SETTINGS_NO_RFC7540_PRIORITIES");
+      }
+
+      if (session->remote_settings.no_rfc7540_priorities != UINT32_MAX &&
+          session->remote_settings.no_rfc7540_priorities != entry->value) {
+        return session_handle_invalid_connection(
+            session, frame, NGHTTP2_ERR_PROTO,
+            "SETTINGS: SETTINGS_NO_RFC7540_PRIORITIES cannot be changed");
+      }
+
+      session->remote_settings.no_rfc7540_priorities = entry->value;
+
+      break;
+    }
+  }
+
+  /* The first SETTINGS decides SETTINGS_NO_RFC7540_PRIORITIES for the
+     lifetime of the connection. */
+  if (session->remote_settings.no_rfc7540_priorities == UINT32_MAX) {
+    session->remote_settings.no_rfc7540_priorities = 0;
+
+    if (session->server && session->pending_no_rfc7540_priorities == 1 &&
+        (session->opt_flags &
+         NGHTTP2_OPTMASK_SERVER_FALLBACK_RFC7540_PRIORITIES)) {
+      session->fallback_rfc7540_priorities = 1;
     }
   }
 
@@ -4602,7 +6126,8 @@ int nghttp2_session_on_push_promise_received(nghttp2_session *session,
   if (!stream || stream->state == NGHTTP2_STREAM_CLOSING ||
       !session->pending_enable_push ||
       session->num_incoming_reserved_streams >=
-          session->max_incoming_reserved_streams) {
+          session->max_incoming_reserved_streams ||
+      session_is_memory_tight(session)) {
     /* Currently, client does not retain closed stream, so we don't
        check NGHTTP2_SHUT_RD condition here. */
 
@@ -4658,6 +6183,139 @@ static int session_process_push_promise_frame(nghttp2_session *session) {
   return nghttp2_session_on_push_promise_received(session, frame);
 }
 
+static const uint8_t WINDOW_TUNING_PING_MAGIC[] = {'w', 'n', 'd', 't'};
+
+/*
+ * Accounts |delta_size| bytes of DATA consumed for automatic window
+ * tuning.  If no round trip is being measured, this function sends
+ * PING to start a new measurement.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ */
+static int session_window_tuning_on_consumed(nghttp2_session *session,
+                                             size_t delta_size) {
+  nghttp2_window_tuner *wt = &session->window_tuner;
+  uint8_t opaque_data[8];
+  int rv;
+
+  if (wt->max_window_size == 0 || delta_size == 0) {
+    return 0;
+  }
+
+  if (wt->ping_outstanding) {
+    wt->bytes += delta_size;
+    return 0;
+  }
+
+  if (session_is_closing(session)) {
+    return 0;
+  }
+
+  if (wt->min_window_size == 0) {
+    wt->min_window_size = session->local_window_size;
+  }
+
+  memcpy(opaque_data, WINDOW_TUNING_PING_MAGIC,
+         sizeof(WINDOW_TUNING_PING_MAGIC));
+  nghttp2_put_uint32be(&opaque_data[4], ++wt->ping_seq);
+
+  rv = nghttp2_session_add_ping(session, NGHTTP2_FLAG_NONE, opaque_data);
+  if (rv != 0) {
+    return rv;
+  }
+
+  wt->ping_outstanding = 1;
+  wt->bytes = 0;
+
+  return 0;
+}
+
+/*
+ * Finishes the measurement if |opaque_data| is the one of the PING
+ * sent by session_window_tuning_on_consumed(), and grows or shrinks
+ * the connection window based on the result.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ */
+static int session_window_tuning_on_ping_ack(nghttp2_session *session,
+                                             const uint8_t *opaque_data) {
+  nghttp2_window_tuner *wt = &session->window_tuner;
+  int32_t window_size;
+  uint64_t new_window_size;
+  uint8_t action;
+  int rv;
+
+  if (!wt->ping_outstanding ||
+      memcmp(opaque_data, WINDOW_TUNING_PING_MAGIC,
+             sizeof(WINDOW_TUNING_PING_MAGIC)) != 0 ||
+      nghttp2_get_uint32(&opaque_data[4]) != wt->ping_seq) {
+    return 0;
+  }
+
+  wt->ping_outstanding = 0;
+  wt->bdp = wt->bytes;
+  ++wt->num_samples;
+  wt->last_action = NGHTTP2_WINDOW_TUNING_ACTION_NONE;
+
+  window_size = session->local_window_size;
+
+  if (wt->bdp * 3 >= (uint64_t)window_size * 2) {
+    wt->num_low_samples = 0;
+
+    new_window_size = nghttp2_min(wt->bdp * 2, (uint64_t)wt->max_window_size);
+    if (new_window_size <= (uint64_t)window_size) {
+      return 0;
+    }
+
+    action = NGHTTP2_WINDOW_TUNING_ACTION_GROW;
+  } else if (wt->bdp * 8 < (uint64_t)window_size &&
+             window_size > wt->min_window_size) {
+    if (++wt->num_low_samples < NGHTTP2_WINDOW_TUNING_SHRINK_SAMPLES) {
+      return 0;
+    }
+
+    wt->num_low_samples = 0;
+
+    new_window_size =
+        (uint64_t)nghttp2_max(window_size / 2, wt->min_window_size);
+
+    action = NGHTTP2_WINDOW_TUNING_ACTION_SHRINK;
+  } else {
+    wt->num_low_samples = 0;
+
+    return 0;
+  }
+
+  rv = nghttp2_session_set_local_window_size(session, NGHTTP2_FLAG_NONE, 0,
+                                             (int32_t)new_window_size);
+  if (rv != 0) {
+    if (nghttp2_is_fatal(rv)) {
+      return rv;
+    }
+
+    return 0;
+  }
+
+  wt->window_size = (int32_t)new_window_size;
+  wt->last_action = action;
+
+  if (action == NGHTTP2_WINDOW_TUNING_ACTION_GROW) {
+    ++wt->num_grows;
+  } else {
+    ++wt->num_shrinks;
+  }
+
+  return 0;
+}
+
 int nghttp2_session_on_ping_received(nghttp2_session *session,
                                      nghttp2_frame *frame) {
   int rv = 0;
@@ -4665,6 +6323,12 @@ int nghttp2_session_on_ping_received(nghttp2_session *session,
     return session_handle_invalid_connection(session, frame, NGHTTP2_ERR_PROTO,
                                              "PING: stream_id != 0");
   }
+  if (frame->hd.flags & NGHTTP2_FLAG_ACK) {
+    rv = session_window_tuning_on_ping_ack(session, frame->ping.opaque_data);
+    if (rv != 0) {
+      return rv;
+    }
+  }
   if ((session->opt_flags & NGHTTP2_OPTMASK_NO_AUTO_PING_ACK) == 0 &&
       (frame->hd.flags & NGHTTP2_FLAG_ACK) == 0 &&
       !session_is_closing(session)) {
@@ -4785,8 +6449,8 @@ static int session_on_stream_window_update_received(nghttp2_session *session,
   if (stream->remote_window_size > 0 &&
       nghttp2_stream_check_deferred_by_flow_control(stream)) {
 
-    rv = nghttp2_stream_resume_deferred_item(
-        stream, NGHTTP2_STREAM_FLAG_DEFERRED_FLOW_CONTROL);
+    rv = session_resume_deferred_stream_item(
+        session, stream, NGHTTP2_STREAM_FLAG_DEFERRED_FLOW_CONTROL);
 
     if (nghttp2_is_fatal(rv)) {
       return rv;
@@ -4891,6 +6555,98 @@ static int session_process_origin_frame(nghttp2_session *session) {
   return nghttp2_session_on_origin_received(session, frame);
 }
 
+int nghttp2_session_on_priority_update_received(nghttp2_session *session,
+                                                nghttp2_frame *frame) {
+  nghttp2_ext_priority_update *priority_update;
+  nghttp2_stream *stream;
+  nghttp2_priority_spec pri_spec;
+  nghttp2_extpri extpri;
+  int rv;
+
+  assert(session->server);
+
+  priority_update = frame->ext.payload;
+
+  if (frame->hd.stream_id != 0) {
+    return session_handle_invalid_connection(
+        session, frame, NGHTTP2_ERR_PROTO,
+        "PRIORITY_UPDATE: frame stream_id != 0");
+  }
+
+  if (priority_update->stream_id == 0) {
+    return session_handle_invalid_connection(session, frame, NGHTTP2_ERR_PROTO,
+                                             "PRIORITY_UPDATE: stream_id == 0");
+  }
+
+  if (nghttp2_session_is_my_stream_id(session, priority_update->stream_id)) {
+    if (session_detect_idle_stream(session, priority_update->stream_id)) {
+      return session_handle_invalid_connection(
+          session, frame, NGHTTP2_ERR_PROTO,
+          "PRIORITY_UPDATE: prioritizing idle push is not allowed");
+    }
+
+    /* RFC 9218, section 7.1 allows a client to reprioritize a pushed
+       stream.  The priority of a pushed stream is left to the server
+       application, so the signal is only passed to it. */
+    return session_call_on_frame_received(session, frame);
+  }
+
+  stream = nghttp2_session_get_stream_raw(session, priority_update->stream_id);
+  if (stream) {
+    /* Stream already reprioritized by application. */
+    if (stream->flags & NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES) {
+      return session_call_on_frame_received(session, frame);
+    }
+  } else if (session_detect_idle_stream(session, priority_update->stream_id)) {
+    if (session->num_idle_streams + session->num_incoming_streams >=
+        session->local_settings.max_concurrent_streams) {
+      return session_handle_invalid_connection(
+          session, frame, NGHTTP2_ERR_PROTO,
+          "PRIORITY_UPDATE: max concurrent streams exceeded");
+    }
+
+    nghttp2_priority_spec_default_init(&pri_spec);
+    stream = nghttp2_session_open_stream(session, priority_update->stream_id,
+                                         NGHTTP2_FLAG_NONE, &pri_spec,
+                                         NGHTTP2_STREAM_IDLE, NULL);
+    if (!stream) {
+      return NGHTTP2_ERR_NOMEM;
+    }
+  } else {
+    return session_call_on_frame_received(session, frame);
+  }
+
+  extpri.urgency = NGHTTP2_EXTPRI_DEFAULT_URGENCY;
+  extpri.inc = 0;
+
+  rv = nghttp2_extpri_parse_priority(&extpri, priority_update->field_value,
+                                     priority_update->field_value_len);
+  if (rv != 0) {
+    /* Just ignore field_value if it cannot be parsed. */
+    return session_call_on_frame_received(session, frame);
+  }
+
+  rv = session_update_stream_priority(session, stream,
+                                      nghttp2_extpri_to_uint8(&extpri));
+  if (rv != 0) {
+    if (nghttp2_is_fatal(rv)) {
+      return rv;
+    }
+  }
+
+  return session_call_on_frame_received(session, frame);
+}
+
+static int session_process_priority_update_frame(nghttp2_session *session) {
+  nghttp2_inbound_frame *iframe = &session->iframe;
+  nghttp2_frame *frame = &iframe->frame;
+
+  nghttp2_frame_unpack_priority_update_payload(
+      &frame->ext, iframe->lbuf.pos, nghttp2_buf_len(&iframe->lbuf));
+
+  return nghttp2_session_on_priority_update_received(session, frame);
+}
+
 static int session_process_extension_frame(nghttp2_session *session) {
   int rv;
   nghttp2_inbound_frame *iframe = &session->iframe;
@@ -4985,6 +6741,43 @@ static int adjust_recv_window_size(int32_t *recv_window_size_ptr, size_t delta,
   return 0;
 }
 
+/*
+ * Changes the local window size of |stream| to the one chosen by
+ * automatic window tuning, if any.  The stream window is never made
+ * smaller than the initial window size.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ */
+static int session_window_tuning_update_stream(nghttp2_session *session,
+                                               nghttp2_stream *stream) {
+  int32_t window_size;
+  int rv;
+
+  if (session->window_tuner.window_size == 0) {
+    return 0;
+  }
+
+  window_size =
+      nghttp2_max(session->window_tuner.window_size,
+                  (int32_t)session->local_settings.initial_window_size);
+
+  if (stream->local_window_size == window_size) {
+    return 0;
+  }
+
+  rv = nghttp2_session_set_local_window_size(session, NGHTTP2_FLAG_NONE,
+                                             stream->stream_id, window_size);
+  if (nghttp2_is_fatal(rv)) {
+    return rv;
+  }
+
+  return 0;
+}
+
 /*
  * Accumulates received bytes |delta_size| for stream-level flow
  * control and decides whether to send WINDOW_UPDATE to that stream.
@@ -5026,6 +6819,10 @@ static int session_update_recv_stream_window_size(nghttp2_session *session,
 
     stream->recv_window_size = 0;
   }
+  if (send_window_update &&
+      !(session->opt_flags & NGHTTP2_OPTMASK_NO_AUTO_WINDOW_UPDATE)) {
+    return session_window_tuning_update_stream(session, stream);
+  }
   return 0;
 }
 
@@ -5064,6 +6861,9 @@ static int session_update_recv_connection_window_size(nghttp2_session *session,
 
     session->recv_window_size = 0;
   }
+  if (!(session->opt_flags & NGHTTP2_OPTMASK_NO_AUTO_WINDOW_UPDATE)) {
+    return session_window_tuning_on_consumed(session, delta_size);
+  }
   return 0;
 }
 
@@ -5108,17 +6908,31 @@ static int session_update_consumed_size(nghttp2_session *session,
 static int session_update_stream_consumed_size(nghttp2_session *session,
                                                nghttp2_stream *stream,
                                                size_t delta_size) {
-  return session_update_consumed_size(
+  int rv;
+
+  rv = session_update_consumed_size(
       session, &stream->consumed_size, &stream->recv_window_size,
       stream->window_update_queued, stream->stream_id, delta_size,
       stream->local_window_size);
+  if (rv != 0) {
+    return rv;
+  }
+
+  return session_window_tuning_update_stream(session, stream);
 }
 
 static int session_update_connection_consumed_size(nghttp2_session *session,
                                                    size_t delta_size) {
-  return session_update_consumed_size(
+  int rv;
+
+  rv = session_update_consumed_size(
       session, &session->consumed_size, &session->recv_window_size,
       session->window_update_queued, 0, delta_size, session->local_window_size);
+  if (rv != 0) {
+    return rv;
+  }
+
+  return session_window_tuning_on_consumed(session, delta_size);
 }
 
 /*
@@ -5228,7 +7042,37 @@ static size_t inbound_frame_buf_read(nghttp2_inbound_frame *iframe,
   readlen =
       nghttp2_min((size_t)(last - in), nghttp2_buf_mark_avail(&iframe->sbuf));
 
-  iframe->sbuf.last = nghttp2_cpymem(iframe->sbuf.last, in, readlen);
+  iframe->sbuf.last = nghttp2_cpymem(iframe->sbuf.last, in, readlen);
+
+  return readlen;
+}
+
+/*
+ * Works like inbound_frame_buf_read(), but if nothing has been read
+ * into iframe->sbuf yet, and [in, last) contains all bytes up to its
+ * mark, makes iframe->sbuf refer to them in place instead of copying
+ * them.  This is the common case where the whole frame is in the
+ * input buffer.
+ *
+ * iframe->sbuf.begin still points to iframe->raw_sbuf, so the next
+ * inbound_frame_set_mark() or session_inbound_frame_reset() makes
+ * iframe->sbuf use its own storage again.  Since the input buffer is
+ * only valid during nghttp2_session_mem_recv(), the caller must not
+ * use this function if iframe->sbuf is referred to after the input
+ * buffer might have gone.
+ */
+static size_t inbound_frame_buf_read_inplace(nghttp2_inbound_frame *iframe,
+                                             const uint8_t *in,
+                                             const uint8_t *last) {
+  size_t readlen = nghttp2_buf_mark_avail(&iframe->sbuf);
+
+  if (nghttp2_buf_len(&iframe->sbuf) || (size_t)(last - in) < readlen) {
+    return inbound_frame_buf_read(iframe, in, last);
+  }
+
+  /* The bytes are never written through iframe->sbuf. */
+  iframe->sbuf.pos = (uint8_t *)in;
+  iframe->sbuf.last = iframe->sbuf.mark = iframe->sbuf.pos + readlen;
 
   return readlen;
 }
@@ -5250,6 +7094,7 @@ static void inbound_frame_set_settings_entry(nghttp2_inbound_frame *iframe) {
   case NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
   case NGHTTP2_SETTINGS_MAX_FRAME_SIZE:
   case NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE:
+  case NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES:
     break;
   default:
     DEBUGF("recv: unknown settings id=0x%02x\n", iv.settings_id);
@@ -5343,8 +7188,8 @@ static ssize_t inbound_frame_effective_readlen(nghttp2_inbound_frame *iframe,
   return (ssize_t)(readlen);
 }
 
-ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
-                                 size_t inlen) {
+static ssize_t session_mem_recv(nghttp2_session *session, const uint8_t *in,
+                                size_t inlen) {
   const uint8_t *first = in, *last = in + inlen;
   nghttp2_inbound_frame *iframe = &session->iframe;
   size_t readlen;
@@ -5361,6 +7206,11 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
 
   mem = &session->mem;
 
+  rv = session_process_submissions(session);
+  if (rv != 0) {
+    return rv;
+  }
+
   /* We may have idle streams more than we expect (e.g.,
      nghttp2_session_change_stream_priority() or
      nghttp2_session_create_idle_stream()).  Adjust them here. */
@@ -5396,7 +7246,7 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
     case NGHTTP2_IB_READ_FIRST_SETTINGS:
       DEBUGF("recv: [IB_READ_FIRST_SETTINGS]\n");
 
-      readlen = inbound_frame_buf_read(iframe, in, last);
+      readlen = inbound_frame_buf_read_inplace(iframe, in, last);
       in += readlen;
 
       if (nghttp2_buf_mark_avail(&iframe->sbuf)) {
@@ -5433,7 +7283,7 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
 
       DEBUGF("recv: [IB_READ_HEAD]\n");
 
-      readlen = inbound_frame_buf_read(iframe, in, last);
+      readlen = inbound_frame_buf_read_inplace(iframe, in, last);
       in += readlen;
 
       if (nghttp2_buf_mark_avail(&iframe->sbuf)) {
@@ -5443,6 +7293,8 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
       nghttp2_frame_unpack_frame_hd(&iframe->frame.hd, iframe->sbuf.pos);
       iframe->payloadleft = iframe->frame.hd.length;
 
+      session_stats_on_frame_recv(session, &iframe->frame.hd);
+
       DEBUGF("recv: payloadlen=%zu, type=%u, flags=0x%02x, stream_id=%d\n",
              iframe->frame.hd.length, iframe->frame.hd.type,
              iframe->frame.hd.flags, iframe->frame.hd.stream_id);
@@ -5837,6 +7689,51 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
 
             iframe->state = NGHTTP2_IB_READ_ORIGIN_PAYLOAD;
 
+            break;
+          case NGHTTP2_PRIORITY_UPDATE:
+            if ((session->builtin_recv_ext_types &
+                 NGHTTP2_TYPEMASK_PRIORITY_UPDATE) == 0 &&
+                !session_no_rfc7540_pri_no_fallback(session)) {
+              busy = 1;
+              iframe->state = NGHTTP2_IB_IGN_PAYLOAD;
+              break;
+            }
+
+            DEBUGF("recv: PRIORITY_UPDATE\n");
+
+            iframe->frame.hd.flags = NGHTTP2_FLAG_NONE;
+            iframe->frame.ext.payload =
+                &iframe->ext_frame_payload.priority_update;
+
+            if (!session->server) {
+              rv = nghttp2_session_terminate_session_with_reason(
+                  session, NGHTTP2_PROTOCOL_ERROR,
+                  "PRIORITY_UPDATE is received from server");
+              if (nghttp2_is_fatal(rv)) {
+                return rv;
+              }
+              return (ssize_t)inlen;
+            }
+
+            if (iframe->payloadleft < 4) {
+              busy = 1;
+              iframe->state = NGHTTP2_IB_FRAME_SIZE_ERROR;
+              break;
+            }
+
+            /* The payload is copied into lbuf so that field_value of
+               any length can be parsed at once. */
+            iframe->raw_lbuf = nghttp2_mem_malloc(mem, iframe->payloadleft);
+
+            if (iframe->raw_lbuf == NULL) {
+              return NGHTTP2_ERR_NOMEM;
+            }
+
+            nghttp2_buf_wrap_init(&iframe->lbuf, iframe->raw_lbuf,
+                                  iframe->payloadleft);
+
+            iframe->state = NGHTTP2_IB_READ_PRIORITY_UPDATE_PAYLOAD;
+
             break;
           default:
             busy = 1;
@@ -5870,7 +7767,17 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
     case NGHTTP2_IB_READ_NBYTE:
       DEBUGF("recv: [IB_READ_NBYTE]\n");
 
-      readlen = inbound_frame_buf_read(iframe, in, last);
+      switch (iframe->frame.hd.type) {
+      case NGHTTP2_GOAWAY:
+      case NGHTTP2_ALTSVC:
+        /* These frames refer to the fixed length fields after the rest
+           of the payload is read, which may be in the later call. */
+        readlen = inbound_frame_buf_read(iframe, in, last);
+        break;
+      default:
+        readlen = inbound_frame_buf_read_inplace(iframe, in, last);
+      }
+
       in += readlen;
       iframe->payloadleft -= readlen;
 
@@ -6278,7 +8185,7 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
     case NGHTTP2_IB_READ_SETTINGS:
       DEBUGF("recv: [IB_READ_SETTINGS]\n");
 
-      readlen = inbound_frame_buf_read(iframe, in, last);
+      readlen = inbound_frame_buf_read_inplace(iframe, in, last);
       iframe->payloadleft -= readlen;
       in += readlen;
 
@@ -6354,7 +8261,7 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
       }
 #endif /* DEBUGBUILD */
 
-      readlen = inbound_frame_buf_read(iframe, in, last);
+      readlen = inbound_frame_buf_read_inplace(iframe, in, last);
       in += readlen;
 
       if (nghttp2_buf_mark_avail(&iframe->sbuf)) {
@@ -6364,6 +8271,8 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
       nghttp2_frame_unpack_frame_hd(&cont_hd, iframe->sbuf.pos);
       iframe->payloadleft = cont_hd.length;
 
+      session_stats_on_frame_recv(session, &cont_hd);
+
       DEBUGF("recv: payloadlen=%zu, type=%u, flags=0x%02x, stream_id=%d\n",
              cont_hd.length, cont_hd.type, cont_hd.flags, cont_hd.stream_id);
 
@@ -6407,7 +8316,7 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
     case NGHTTP2_IB_READ_PAD_DATA:
       DEBUGF("recv: [IB_READ_PAD_DATA]\n");
 
-      readlen = inbound_frame_buf_read(iframe, in, last);
+      readlen = inbound_frame_buf_read_inplace(iframe, in, last);
       in += readlen;
       iframe->payloadleft -= readlen;
 
@@ -6731,6 +8640,39 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
 
       session_inbound_frame_reset(session);
 
+      break;
+    case NGHTTP2_IB_READ_PRIORITY_UPDATE_PAYLOAD:
+      DEBUGF("recv: [IB_READ_PRIORITY_UPDATE_PAYLOAD]\n");
+
+      readlen = inbound_frame_payload_readlen(iframe, in, last);
+
+      if (readlen > 0) {
+        iframe->lbuf.last = nghttp2_cpymem(iframe->lbuf.last, in, readlen);
+
+        iframe->payloadleft -= readlen;
+        in += readlen;
+      }
+
+      DEBUGF("recv: readlen=%zu, payloadleft=%zu\n", readlen,
+             iframe->payloadleft);
+
+      if (iframe->payloadleft) {
+        assert(nghttp2_buf_avail(&iframe->lbuf) > 0);
+
+        break;
+      }
+
+      rv = session_process_priority_update_frame(session);
+      if (nghttp2_is_fatal(rv)) {
+        return rv;
+      }
+
+      if (iframe->state == NGHTTP2_IB_IGN_ALL) {
+        return (ssize_t)inlen;
+      }
+
+      session_inbound_frame_reset(session);
+
       break;
     }
 
@@ -6746,6 +8688,24 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
   return in - first;
 }
 
+ssize_t nghttp2_session_mem_recv(nghttp2_session *session, const uint8_t *in,
+                                 size_t inlen) {
+  ssize_t nread;
+  int rv;
+
+  nread = session_mem_recv(session, in, inlen);
+  if (nread < 0) {
+    return nread;
+  }
+
+  rv = session_enforce_memory_budget(session);
+  if (rv != 0) {
+    return rv;
+  }
+
+  return nread;
+}
+
 int nghttp2_session_recv(nghttp2_session *session) {
   uint8_t buf[NGHTTP2_INBOUND_BUFFER_LENGTH];
   while (1) {
@@ -6807,6 +8767,13 @@ int nghttp2_session_want_write(nghttp2_session *session) {
     return 0;
   }
 
+  /* The operations queued by other threads are carried out by
+     nghttp2_session_send(), and most of them produce frames. */
+  if ((session->opt_flags & NGHTTP2_OPTMASK_SUBMISSION_QUEUE) &&
+      !nghttp2_mpscq_empty(&session->submissionq)) {
+    return 1;
+  }
+
   /*
    * Unless termination GOAWAY is sent or received, we want to write
    * frames if there is pending ones. If pending frame is request/push
@@ -6815,7 +8782,8 @@ int nghttp2_session_want_write(nghttp2_session *session) {
    */
   return session->aob.item || nghttp2_outbound_queue_top(&session->ob_urgent) ||
          nghttp2_outbound_queue_top(&session->ob_reg) ||
-         (!nghttp2_pq_empty(&session->root.obq) &&
+         ((!nghttp2_stream_obq_empty(&session->root) ||
+           !session_sched_empty(session)) &&
           session->remote_window_size > 0) ||
          (nghttp2_outbound_queue_top(&session->ob_syn) &&
           !session_is_outgoing_concurrent_streams_max(session));
@@ -6826,16 +8794,13 @@ int nghttp2_session_add_ping(nghttp2_session *session, uint8_t flags,
   int rv;
   nghttp2_outbound_item *item;
   nghttp2_frame *frame;
-  nghttp2_mem *mem;
-
-  mem = &session->mem;
 
   if ((flags & NGHTTP2_FLAG_ACK) &&
       session->obq_flood_counter_ >= NGHTTP2_MAX_OBQ_FLOOD_ITEM) {
     return NGHTTP2_ERR_FLOODED;
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -6850,7 +8815,7 @@ int nghttp2_session_add_ping(nghttp2_session *session, uint8_t flags,
 
   if (rv != 0) {
     nghttp2_frame_ping_free(&frame->ping);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
 
@@ -6888,7 +8853,7 @@ int nghttp2_session_add_goaway(nghttp2_session *session, int32_t last_stream_id,
     memcpy(opaque_data_copy, opaque_data, opaque_data_len);
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     nghttp2_mem_free(mem, opaque_data_copy);
     return NGHTTP2_ERR_NOMEM;
@@ -6911,7 +8876,7 @@ int nghttp2_session_add_goaway(nghttp2_session *session, int32_t last_stream_id,
   rv = nghttp2_session_add_item(session, item);
   if (rv != 0) {
     nghttp2_frame_goaway_free(&frame->goaway, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
   return 0;
@@ -6923,10 +8888,8 @@ int nghttp2_session_add_window_update(nghttp2_session *session, uint8_t flags,
   int rv;
   nghttp2_outbound_item *item;
   nghttp2_frame *frame;
-  nghttp2_mem *mem;
 
-  mem = &session->mem;
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -6942,7 +8905,7 @@ int nghttp2_session_add_window_update(nghttp2_session *session, uint8_t flags,
 
   if (rv != 0) {
     nghttp2_frame_window_update_free(&frame->window_update);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
   return 0;
@@ -6968,6 +8931,8 @@ int nghttp2_session_add_settings(nghttp2_session *session, uint8_t flags,
   int rv;
   nghttp2_mem *mem;
   nghttp2_inflight_settings *inflight_settings = NULL;
+  nghttp2_settings_entry *iv_ext;
+  uint8_t no_rfc7540_pri = UINT8_MAX;
 
   mem = &session->mem;
 
@@ -6985,7 +8950,48 @@ int nghttp2_session_add_settings(nghttp2_session *session, uint8_t flags,
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  for (i = niv; i > 0; --i) {
+    if (iv[i - 1].settings_id == NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES) {
+      no_rfc7540_pri = (uint8_t)iv[i - 1].value;
+      break;
+    }
+  }
+
+  /* SETTINGS_NO_RFC7540_PRIORITIES must not change after the first
+     SETTINGS. */
+  if (session->pending_no_rfc7540_priorities != UINT8_MAX &&
+      no_rfc7540_pri != UINT8_MAX &&
+      no_rfc7540_pri != session->pending_no_rfc7540_priorities) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  if ((flags & NGHTTP2_FLAG_ACK) == 0 &&
+      session->pending_no_rfc7540_priorities == UINT8_MAX &&
+      no_rfc7540_pri == UINT8_MAX &&
+      (session->opt_flags & NGHTTP2_OPTMASK_NO_RFC7540_PRIORITIES)) {
+    /* Announce RFC 9218 priorities in the first SETTINGS on behalf of
+       application. */
+    iv_ext =
+        nghttp2_mem_malloc(mem, sizeof(nghttp2_settings_entry) * (niv + 1));
+    if (iv_ext == NULL) {
+      return NGHTTP2_ERR_NOMEM;
+    }
+
+    if (niv) {
+      memcpy(iv_ext, iv, sizeof(nghttp2_settings_entry) * niv);
+    }
+
+    iv_ext[niv].settings_id = NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES;
+    iv_ext[niv].value = 1;
+
+    rv = nghttp2_session_add_settings(session, flags, iv_ext, niv + 1);
+
+    nghttp2_mem_free(mem, iv_ext);
+
+    return rv;
+  }
+
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -6993,7 +8999,7 @@ int nghttp2_session_add_settings(nghttp2_session *session, uint8_t flags,
   if (niv > 0) {
     iv_copy = nghttp2_frame_iv_copy(iv, niv, mem);
     if (iv_copy == NULL) {
-      nghttp2_mem_free(mem, item);
+      nghttp2_objpool_put(&session->item_pool, item);
       return NGHTTP2_ERR_NOMEM;
     }
   } else {
@@ -7005,7 +9011,7 @@ int nghttp2_session_add_settings(nghttp2_session *session, uint8_t flags,
     if (rv != 0) {
       assert(nghttp2_is_fatal(rv));
       nghttp2_mem_free(mem, iv_copy);
-      nghttp2_mem_free(mem, item);
+      nghttp2_objpool_put(&session->item_pool, item);
       return rv;
     }
   }
@@ -7023,7 +9029,7 @@ int nghttp2_session_add_settings(nghttp2_session *session, uint8_t flags,
     inflight_settings_del(inflight_settings, mem);
 
     nghttp2_frame_settings_free(&frame->settings, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
 
     return rv;
   }
@@ -7052,6 +9058,12 @@ int nghttp2_session_add_settings(nghttp2_session *session, uint8_t flags,
     }
   }
 
+  if ((flags & NGHTTP2_FLAG_ACK) == 0 &&
+      session->pending_no_rfc7540_priorities == UINT8_MAX) {
+    session->pending_no_rfc7540_priorities =
+        no_rfc7540_pri == UINT8_MAX ? 0 : no_rfc7540_pri;
+  }
+
   return 0;
 }
 
@@ -7150,8 +9162,10 @@ int nghttp2_session_pack_data(nghttp2_session *session, nghttp2_bufs *bufs,
   }
 
   if (data_flags & NGHTTP2_DATA_FLAG_NO_COPY) {
-    if (session->callbacks.send_data_callback == NULL) {
-      DEBUGF("NGHTTP2_DATA_FLAG_NO_COPY requires send_data_callback set\n");
+    if (session->callbacks.send_data_callback == NULL &&
+        session->callbacks.get_data_ref_callback == NULL) {
+      DEBUGF("NGHTTP2_DATA_FLAG_NO_COPY requires send_data_callback or "
+             "get_data_ref_callback set\n");
 
       return NGHTTP2_ERR_CALLBACK_FAILURE;
     }
@@ -7180,7 +9194,7 @@ int nghttp2_session_pack_data(nghttp2_session *session, nghttp2_bufs *bufs,
     return rv;
   }
 
-  reschedule_stream(stream);
+  session_reschedule_stream(session, stream);
 
   if (frame->hd.length == 0 && (data_flags & NGHTTP2_DATA_FLAG_EOF) &&
       (data_flags & NGHTTP2_DATA_FLAG_NO_END_STREAM)) {
@@ -7254,7 +9268,7 @@ int nghttp2_session_resume_data(nghttp2_session *session, int32_t stream_id) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
 
-  rv = nghttp2_stream_resume_deferred_item(stream,
+  rv = session_resume_deferred_stream_item(session, stream,
                                            NGHTTP2_STREAM_FLAG_DEFERRED_USER);
 
   if (nghttp2_is_fatal(rv)) {
@@ -7264,6 +9278,109 @@ int nghttp2_session_resume_data(nghttp2_session *session, int32_t stream_id) {
   return 0;
 }
 
+static void session_enqueue_submission(nghttp2_session *session,
+                                       nghttp2_submission *sub) {
+  if (nghttp2_mpscq_push(&session->submissionq, &sub->qe) &&
+      session->callbacks.submission_wakeup_callback) {
+    session->callbacks.submission_wakeup_callback(session,
+                                                  session->user_data);
+  }
+}
+
+static nghttp2_submission *
+session_new_submission(nghttp2_session *session, int32_t stream_id,
+                       nghttp2_submission_type type) {
+  nghttp2_submission *sub;
+
+  sub = nghttp2_mem_malloc(&session->mem_acct.parent,
+                           sizeof(nghttp2_submission));
+  if (sub == NULL) {
+    return NULL;
+  }
+
+  memset(sub, 0, sizeof(nghttp2_submission));
+
+  sub->stream_id = stream_id;
+  sub->type = type;
+
+  return sub;
+}
+
+int nghttp2_session_enqueue_data(nghttp2_session *session, uint8_t flags,
+                                 int32_t stream_id,
+                                 const nghttp2_data_provider *data_prd) {
+  nghttp2_submission *sub;
+
+  if ((session->opt_flags & NGHTTP2_OPTMASK_SUBMISSION_QUEUE) == 0) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (stream_id <= 0 || data_prd == NULL) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  sub = session_new_submission(session, stream_id, NGHTTP2_SUBMISSION_DATA);
+  if (sub == NULL) {
+    return NGHTTP2_ERR_NOMEM;
+  }
+
+  sub->data_prd = *data_prd;
+  sub->flags = flags;
+
+  session_enqueue_submission(session, sub);
+
+  return 0;
+}
+
+int nghttp2_session_enqueue_resume_data(nghttp2_session *session,
+                                        int32_t stream_id) {
+  nghttp2_submission *sub;
+
+  if ((session->opt_flags & NGHTTP2_OPTMASK_SUBMISSION_QUEUE) == 0) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (stream_id <= 0) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  sub = session_new_submission(session, stream_id,
+                               NGHTTP2_SUBMISSION_RESUME_DATA);
+  if (sub == NULL) {
+    return NGHTTP2_ERR_NOMEM;
+  }
+
+  session_enqueue_submission(session, sub);
+
+  return 0;
+}
+
+int nghttp2_session_enqueue_rst_stream(nghttp2_session *session,
+                                       int32_t stream_id,
+                                       uint32_t error_code) {
+  nghttp2_submission *sub;
+
+  if ((session->opt_flags & NGHTTP2_OPTMASK_SUBMISSION_QUEUE) == 0) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (stream_id <= 0) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  sub = session_new_submission(session, stream_id,
+                               NGHTTP2_SUBMISSION_RST_STREAM);
+  if (sub == NULL) {
+    return NGHTTP2_ERR_NOMEM;
+  }
+
+  sub->error_code = error_code;
+
+  session_enqueue_submission(session, sub);
+
+  return 0;
+}
+
 size_t nghttp2_session_get_outbound_queue_size(nghttp2_session *session) {
   return nghttp2_outbound_queue_size(&session->ob_urgent) +
          nghttp2_outbound_queue_size(&session->ob_reg) +
@@ -7360,6 +9477,12 @@ uint32_t nghttp2_session_get_remote_settings(nghttp2_session *session,
     return session->remote_settings.max_frame_size;
   case NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE:
     return session->remote_settings.max_header_list_size;
+  case NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES:
+    /* UINT32_MAX means that SETTINGS has not been received yet. */
+    if (session->remote_settings.no_rfc7540_priorities == UINT32_MAX) {
+      return 0;
+    }
+    return session->remote_settings.no_rfc7540_priorities;
   }
 
   assert(0);
@@ -7381,6 +9504,8 @@ uint32_t nghttp2_session_get_local_settings(nghttp2_session *session,
     return session->local_settings.max_frame_size;
   case NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE:
     return session->local_settings.max_header_list_size;
+  case NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES:
+    return session->local_settings.no_rfc7540_priorities;
   }
 
   assert(0);
@@ -7729,6 +9854,156 @@ nghttp2_session_get_hd_deflate_dynamic_table_size(nghttp2_session *session) {
   return nghttp2_hd_deflate_get_dynamic_table_size(&session->hd_deflater);
 }
 
+size_t nghttp2_session_get_memory_usage(nghttp2_session *session) {
+  return session->mem_acct.current;
+}
+
+size_t nghttp2_session_get_peak_memory_usage(nghttp2_session *session) {
+  return session->mem_acct.peak;
+}
+
 void nghttp2_session_set_user_data(nghttp2_session *session, void *user_data) {
   session->user_data = user_data;
 }
+
+int nghttp2_session_create_hd_template(nghttp2_session *session,
+                                       nghttp2_hd_template **tmpl_ptr,
+                                       const nghttp2_nv *nva, size_t nvlen) {
+  int rv;
+  nghttp2_nv *nva_copy;
+  nghttp2_hd_template *tmpl;
+  nghttp2_mem *mem;
+
+  mem = &session->mem;
+
+  rv = nghttp2_nv_array_copy(&nva_copy, nva, nvlen, mem);
+  if (rv < 0) {
+    return rv;
+  }
+
+  rv = nghttp2_hd_template_new(&tmpl, &session->hd_deflater, nva_copy, nvlen,
+                               mem);
+  if (rv != 0) {
+    return rv;
+  }
+
+  tmpl->next = session->hd_templates;
+  if (tmpl->next) {
+    tmpl->next->prev = tmpl;
+  }
+  session->hd_templates = tmpl;
+
+  *tmpl_ptr = tmpl;
+
+  return 0;
+}
+
+void nghttp2_session_del_hd_template(nghttp2_session *session,
+                                     nghttp2_hd_template *tmpl) {
+  if (tmpl->prev) {
+    tmpl->prev->next = tmpl->next;
+  } else {
+    session->hd_templates = tmpl->next;
+  }
+
+  if (tmpl->next) {
+    tmpl->next->prev = tmpl->prev;
+  }
+
+  tmpl->prev = tmpl->next = NULL;
+
+  /* HEADERS frames in queue may still refer to |tmpl| */
+  nghttp2_hd_template_decref(tmpl);
+}
+
+int nghttp2_session_change_extpri_stream_priority(
+    nghttp2_session *session, int32_t stream_id,
+    const nghttp2_extpri *extpri_in, int ignore_client_signal) {
+  nghttp2_stream *stream;
+  nghttp2_extpri extpri = *extpri_in;
+
+  if (!session->server || !session_no_rfc7540_pri_no_fallback(session)) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (stream_id == 0) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  stream = nghttp2_session_get_stream_raw(session, stream_id);
+  if (!stream) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  if (extpri.urgency > NGHTTP2_EXTPRI_URGENCY_LOW) {
+    extpri.urgency = NGHTTP2_EXTPRI_URGENCY_LOW;
+  }
+
+  if (ignore_client_signal) {
+    stream->flags |= NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES;
+  } else {
+    stream->flags &= (uint8_t)~NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES;
+  }
+
+  return session_update_stream_priority(session, stream,
+                                        nghttp2_extpri_to_uint8(&extpri));
+}
+
+int nghttp2_session_get_extpri_stream_priority(nghttp2_session *session,
+                                               nghttp2_extpri *extpri,
+                                               int32_t stream_id) {
+  nghttp2_stream *stream;
+
+  if (!session->server || !session_no_rfc7540_pri_no_fallback(session)) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (stream_id == 0) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  stream = nghttp2_session_get_stream_raw(session, stream_id);
+  if (!stream) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  nghttp2_extpri_from_uint8(extpri, stream->extpri);
+
+  return 0;
+}
+
+int nghttp2_session_get_window_tuning_stats(
+    nghttp2_session *session, nghttp2_window_tuning_stats *stats) {
+  nghttp2_window_tuner *wt = &session->window_tuner;
+
+  if (wt->max_window_size == 0) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  stats->bdp = wt->bdp;
+  stats->num_samples = wt->num_samples;
+  stats->num_grows = wt->num_grows;
+  stats->num_shrinks = wt->num_shrinks;
+  stats->window_size = session->local_window_size;
+  stats->max_window_size = wt->max_window_size;
+  stats->last_action = (nghttp2_window_tuning_action)wt->last_action;
+
+  return 0;
+}
+
+void nghttp2_session_get_stats(nghttp2_session *session,
+                               nghttp2_session_stats *stats) {
+  const nghttp2_hd_stats *dstats = &session->hd_deflater.stats;
+  const nghttp2_hd_stats *istats = &session->hd_inflater.stats;
+
+  *stats = session->stats;
+
+  stats->hd_deflate_compressed_bytes = dstats->compressed_bytes;
+  stats->hd_deflate_uncompressed_bytes = dstats->uncompressed_bytes;
+  stats->hd_deflate_num_fields = dstats->num_fields;
+  stats->hd_deflate_num_dynamic_table_hits = dstats->num_dynamic_table_hits;
+  stats->hd_inflate_compressed_bytes = istats->compressed_bytes;
+  stats->hd_inflate_uncompressed_bytes = istats->uncompressed_bytes;
+  stats->hd_inflate_num_fields = istats->num_fields;
+  stats->hd_inflate_num_dynamic_table_hits = istats->num_dynamic_table_hits;
+}
@@ -39,6 +39,8 @@
 #include "nghttp2_buf.h"
 #include "nghttp2_callbacks.h"
 #include "nghttp2_mem.h"
+#include "nghttp2_objpool.h"
+#include "nghttp2_mpscq.h"
 
 /* The global variable for tests where we want to disable strict
    preface handling. */
@@ -52,7 +54,12 @@ typedef enum {
   NGHTTP2_OPTMASK_NO_RECV_CLIENT_MAGIC = 1 << 1,
   NGHTTP2_OPTMASK_NO_HTTP_MESSAGING = 1 << 2,
   NGHTTP2_OPTMASK_NO_AUTO_PING_ACK = 1 << 3,
-  NGHTTP2_OPTMASK_NO_CLOSED_STREAMS = 1 << 4
+  NGHTTP2_OPTMASK_NO_CLOSED_STREAMS = 1 << 4,
+  NGHTTP2_OPTMASK_NO_RFC7540_PRIORITIES = 1 << 5,
+  NGHTTP2_OPTMASK_SERVER_FALLBACK_RFC7540_PRIORITIES = 1 << 6,
+  NGHTTP2_OPTMASK_SUBMISSION_QUEUE = 1 << 7,
+  NGHTTP2_OPTMASK_COMPACT_RETAINED_STREAMS = 1 << 8,
+  NGHTTP2_OPTMASK_ENFORCE_MAX_HEADER_LIST_SIZE = 1 << 9
 } nghttp2_optmask;
 
 /*
@@ -62,7 +69,8 @@ typedef enum {
 typedef enum {
   NGHTTP2_TYPEMASK_NONE = 0,
   NGHTTP2_TYPEMASK_ALTSVC = 1 << 0,
-  NGHTTP2_TYPEMASK_ORIGIN = 1 << 1
+  NGHTTP2_TYPEMASK_ORIGIN = 1 << 1,
+  NGHTTP2_TYPEMASK_PRIORITY_UPDATE = 1 << 2
 } nghttp2_typemask;
 
 typedef enum {
@@ -78,6 +86,129 @@ typedef struct {
   nghttp2_outbound_state state;
 } nghttp2_active_outbound_item;
 
+/* Application data handed out by reference in
+   nghttp2_session_mem_sendv() */
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+  int32_t stream_id;
+} nghttp2_data_ref;
+
+/* The state of the last batch returned by nghttp2_session_mem_sendv().
+   The memory is retained until the next call of the send
+   functions. */
+typedef struct {
+  /* The buffers which store frame headers and non-DATA frames.  Each
+     serialized chunk is stored contiguously in one buffer. */
+  nghttp2_buf_chain *head;
+  /* The buffer which is currently written. */
+  nghttp2_buf_chain *cur;
+  /* The application data referenced by the batch */
+  nghttp2_data_ref *refs;
+  size_t nrefs;
+  size_t refcap;
+} nghttp2_sendv_batch;
+
+/* The state of nghttp2_session_mem_send_batch() while it is
+   running */
+typedef struct {
+  /* The caller supplied buffer, or NULL if
+     nghttp2_session_mem_send_batch() is not running. */
+  nghttp2_buf *dest;
+  /* The original head buffer of aob.framebufs while it is replaced
+     with the free space of dest to pack DATA there directly. */
+  nghttp2_buf framebuf;
+  /* nonzero if the head buffer of aob.framebufs is replaced */
+  uint8_t framebuf_swapped;
+} nghttp2_send_batch;
+
+typedef enum {
+  NGHTTP2_SUBMISSION_DATA,
+  NGHTTP2_SUBMISSION_RESUME_DATA,
+  NGHTTP2_SUBMISSION_RST_STREAM
+} nghttp2_submission_type;
+
+/* An operation enqueued by nghttp2_session_enqueue_*() functions,
+   which is carried out by the thread owning the session. */
+typedef struct {
+  nghttp2_mpscq_entry qe;
+  /* NGHTTP2_SUBMISSION_DATA */
+  nghttp2_data_provider data_prd;
+  int32_t stream_id;
+  /* NGHTTP2_SUBMISSION_RST_STREAM */
+  uint32_t error_code;
+  nghttp2_submission_type type;
+  /* NGHTTP2_SUBMISSION_DATA */
+  uint8_t flags;
+} nghttp2_submission;
+
+typedef struct nghttp2_compact_stream nghttp2_compact_stream;
+
+/*
+ * The compact form of a closed or idle stream which is retained only
+ * as a node of the RFC 7540 dependency tree, and has no dependent
+ * streams.  It records just enough to put the stream back into the
+ * tree.  It is turned into nghttp2_stream again when it is looked up
+ * by nghttp2_session_get_stream_raw().
+ */
+struct nghttp2_compact_stream {
+  /* Intrusive Map.  The key is the stream ID. */
+  nghttp2_map_entry map_entry;
+  nghttp2_compact_stream *prev, *next;
+  /* The stream ID of the parent stream, or 0 for the root */
+  int32_t dep_stream_id;
+  int32_t weight;
+  /* nghttp2_stream_state */
+  uint8_t state;
+  /* Bitwise OR of zero or more of nghttp2_stream_flag */
+  uint8_t flags;
+  /* Bitwise OR of zero or more of nghttp2_shut_flag */
+  uint8_t shut_flags;
+};
+
+/* The list of nghttp2_compact_stream, from the oldest to the
+   latest */
+typedef struct {
+  nghttp2_compact_stream *head, *tail;
+  size_t len;
+} nghttp2_compact_stream_list;
+
+/* The state of automatic receive window tuning */
+typedef struct {
+  /* The number of bytes consumed since the outstanding PING was
+     sent */
+  uint64_t bytes;
+  /* The number of bytes consumed during the last measured round
+     trip */
+  uint64_t bdp;
+  uint64_t num_samples;
+  uint64_t num_grows;
+  uint64_t num_shrinks;
+  /* The maximum window size.  0 if tuning is disabled. */
+  int32_t max_window_size;
+  /* The minimum connection window size, which is the size in effect
+     when the first PING is sent. */
+  int32_t min_window_size;
+  /* The tuned window size.  0 until the windows are changed for the
+     first time. */
+  int32_t window_size;
+  /* The sequence number of the last PING sent */
+  uint32_t ping_seq;
+  /* The number of consecutive round trips which used a small
+     fraction of the window */
+  size_t num_low_samples;
+  /* Nonzero if PING is sent and its ACK is not received yet */
+  uint8_t ping_outstanding;
+  /* One of nghttp2_window_tuning_action */
+  uint8_t last_action;
+} nghttp2_window_tuner;
+
+/* Automatic window tuning grows the windows if the bytes consumed
+   in one round trip reach 2/3 of the connection window, and shrinks
+   them by half after this number of consecutive round trips which
+   consumed less than 1/8 of it. */
+#define NGHTTP2_WINDOW_TUNING_SHRINK_SAMPLES 3
+
 /* Buffer length for inbound raw byte stream used in
    nghttp2_session_recv(). */
 #define NGHTTP2_INBOUND_BUFFER_LENGTH 16384
@@ -102,6 +233,10 @@ typedef struct {
 /* The default value of maximum number of concurrent streams. */
 #define NGHTTP2_DEFAULT_MAX_CONCURRENT_STREAMS 0xffffffffu
 
+/* The size of a buffer in nghttp2_session.nva_pool.  Header field
+   arrays which do not fit in it are allocated separately. */
+#define NGHTTP2_NVA_POOL_OBJSIZE 1024
+
 /* Internal state when receiving incoming frame */
 typedef enum {
   /* Receiving frame header */
@@ -123,6 +258,7 @@ typedef enum {
   NGHTTP2_IB_IGN_ALL,
   NGHTTP2_IB_READ_ALTSVC_PAYLOAD,
   NGHTTP2_IB_READ_ORIGIN_PAYLOAD,
+  NGHTTP2_IB_READ_PRIORITY_UPDATE_PAYLOAD,
   NGHTTP2_IB_READ_EXTENSION_PAYLOAD
 } nghttp2_inbound_state;
 
@@ -150,6 +286,10 @@ typedef struct {
   size_t payloadleft;
   /* padding length for the current frame */
   size_t padlen;
+  /* The sum of the length of name and value, and
+     NGHTTP2_HD_ENTRY_OVERHEAD, of the header fields decoded so far
+     from the current header block. */
+  size_t header_list_len;
   nghttp2_inbound_state state;
   /* Small buffer.  Currently the largest contiguous chunk to buffer
      is frame header.  We buffer part of payload, but they are smaller
@@ -164,6 +304,9 @@ typedef struct {
   uint32_t initial_window_size;
   uint32_t max_frame_size;
   uint32_t max_header_list_size;
+  /* UINT32_MAX in remote_settings means that the remote endpoint has
+     not sent this setting. */
+  uint32_t no_rfc7540_priorities;
 } nghttp2_settings_storage;
 
 typedef enum {
@@ -193,6 +336,10 @@ struct nghttp2_session {
   nghttp2_map /* <nghttp2_stream*> */ streams;
   /* root of dependency tree*/
   nghttp2_stream root;
+  /* Queues of streams scheduled by RFC 9218 extensible priorities,
+     indexed by urgency.  Only streams with
+     NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES are queued here. */
+  nghttp2_pq sched[NGHTTP2_EXTPRI_URGENCY_LEVELS];
   /* Queue for outbound urgent frames (PING and SETTINGS) */
   nghttp2_outbound_queue ob_urgent;
   /* Queue for non-DATA frames */
@@ -202,12 +349,37 @@ struct nghttp2_session {
      SETTINGS_MAX_CONCURRENT_STREAMS limit. */
   nghttp2_outbound_queue ob_syn;
   nghttp2_active_outbound_item aob;
+  nghttp2_sendv_batch sendv;
+  nghttp2_send_batch send_batch;
+  /* The queue of nghttp2_submission enqueued by other threads */
+  nghttp2_mpscq submissionq;
+  nghttp2_window_tuner window_tuner;
+  /* Counters exposed by nghttp2_session_get_stats().  The HPACK
+     counters are kept in hd_deflater and hd_inflater. */
+  nghttp2_session_stats stats;
   nghttp2_inbound_frame iframe;
   nghttp2_hd_deflater hd_deflater;
   nghttp2_hd_inflater hd_inflater;
+  /* Header templates created by the application */
+  nghttp2_hd_template *hd_templates;
+  /* Free lists of nghttp2_stream, nghttp2_outbound_item, and header
+     field arrays copied by nghttp2_submit_* functions */
+  nghttp2_objpool stream_pool;
+  nghttp2_objpool item_pool;
+  nghttp2_objpool nva_pool;
   nghttp2_session_callbacks callbacks;
-  /* Memory allocator */
+  /* Memory allocator.  If the memory budget is enabled, this wraps
+     mem_acct.parent and accounts memory in mem_acct. */
   nghttp2_mem mem;
+  /* The memory accounting state.  mem_acct.parent is always the
+     allocator given by the application, which is also used for the
+     session object itself and the objects allocated by other
+     threads. */
+  nghttp2_mem_acct mem_acct;
+  /* The memory budget given by
+     nghttp2_option_set_max_session_memory().  SIZE_MAX if it is not
+     set. */
+  size_t max_session_memory;
   /* Base value when we schedule next DATA frame write.  This is
      updated when one frame was written. */
   uint64_t last_cycle;
@@ -226,6 +398,12 @@ struct nghttp2_session {
   /* Points to the oldest idle stream.  NULL if there is no idle
      stream.  Only used when session is initialized as erver. */
   nghttp2_stream *idle_stream_tail;
+  /* Closed and idle streams kept in compact form, keyed by stream
+     ID.  They are not in |streams|.  The table is allocated when the
+     first stream is compacted. */
+  nghttp2_map /* <nghttp2_compact_stream*> */ compact_streams;
+  nghttp2_compact_stream_list compact_closed_streams;
+  nghttp2_compact_stream_list compact_idle_streams;
   /* Queue of In-flight SETTINGS values.  SETTINGS bearing ACK is not
      considered as in-flight. */
   nghttp2_inflight_settings *inflight_settings_head;
@@ -321,6 +499,13 @@ struct nghttp2_session {
   /* Unacked local ENABLE_PUSH value.  We use this to refuse
      PUSH_PROMISE before SETTINGS ACK is received. */
   uint8_t pending_enable_push;
+  /* Unacked local SETTINGS_NO_RFC7540_PRIORITIES value, which is
+     effective before it is acknowledged.  UINT8_MAX until the first
+     SETTINGS is submitted. */
+  uint8_t pending_no_rfc7540_priorities;
+  /* Nonzero if server turned RFC 9218 priorities off because client
+     did not send SETTINGS_NO_RFC7540_PRIORITIES = 1. */
+  uint8_t fallback_rfc7540_priorities;
   /* Nonzero if the session is server side. */
   uint8_t server;
   /* Flags indicating GOAWAY is sent and/or received. The flags are
@@ -503,8 +688,10 @@ nghttp2_stream *nghttp2_session_open_stream(nghttp2_session *session,
  *
  * If the session is initialized as server and |stream| is incoming
  * stream, stream is just marked closed and this function calls
- * nghttp2_session_keep_closed_stream() with |stream|.  Otherwise,
- * |stream| will be deleted from memory.
+ * nghttp2_session_keep_closed_stream() with |stream|, or keeps it in
+ * compact form if NGHTTP2_OPTMASK_COMPACT_RETAINED_STREAMS is set and
+ * |stream| has no dependent streams.  Otherwise, |stream| will be
+ * deleted from memory.
  *
  * This function returns 0 if it succeeds, or one the following
  * negative error codes:
@@ -766,6 +953,21 @@ int nghttp2_session_on_altsvc_received(nghttp2_session *session,
 int nghttp2_session_on_origin_received(nghttp2_session *session,
                                        nghttp2_frame *frame);
 
+/*
+ * Called when PRIORITY_UPDATE is received, assuming |frame| is
+ * properly initialized.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+int nghttp2_session_on_priority_update_received(nghttp2_session *session,
+                                                nghttp2_frame *frame);
+
 /*
  * Called when DATA is received, assuming |frame| is properly
  * initialized.
@@ -792,7 +994,9 @@ nghttp2_stream *nghttp2_session_get_stream(nghttp2_session *session,
 /*
  * This function behaves like nghttp2_session_get_stream(), but it
  * returns stream object even if it is marked as closed or in
- * NGHTTP2_STREAM_IDLE state.
+ * NGHTTP2_STREAM_IDLE state.  If the stream is kept in compact form,
+ * it is turned into nghttp2_stream first.  If that fails due to out
+ * of memory, the stream is forgotten, and this function returns NULL.
  */
 nghttp2_stream *nghttp2_session_get_stream_raw(nghttp2_session *session,
                                                int32_t stream_id);
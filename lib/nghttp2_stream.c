@@ -42,7 +42,7 @@
    fact. */
 #define NGHTTP2_MAX_CYCLE_DISTANCE (16384 * 256 + 255)
 
-static int stream_less(const void *lhsx, const void *rhsx) {
+int nghttp2_stream_less(const void *lhsx, const void *rhsx) {
   const nghttp2_stream *lhs, *rhs;
 
   lhs = nghttp2_struct_of(lhsx, nghttp2_stream, pq_entry);
@@ -65,7 +65,7 @@ void nghttp2_stream_init(nghttp2_stream *stream, int32_t stream_id,
                          int32_t local_initial_window_size,
                          void *stream_user_data, nghttp2_mem *mem) {
   nghttp2_map_entry_init(&stream->map_entry, (key_type)stream_id);
-  nghttp2_pq_init(&stream->obq, stream_less, mem);
+  nghttp2_pq_init(&stream->obq, nghttp2_stream_less, mem);
 
   stream->stream_id = stream_id;
   stream->flags = flags;
@@ -103,9 +103,14 @@ void nghttp2_stream_init(nghttp2_stream *stream, int32_t stream_id,
   stream->descendant_next_seq = 0;
   stream->seq = 0;
   stream->last_writelen = 0;
+  stream->obq_wheel = NULL;
+  stream->extpri = stream->http_extpri = NGHTTP2_EXTPRI_DEFAULT_URGENCY;
 }
 
 void nghttp2_stream_free(nghttp2_stream *stream) {
+  if (stream->obq_wheel) {
+    nghttp2_mem_free(stream->obq.mem, stream->obq_wheel);
+  }
   nghttp2_pq_free(&stream->obq);
   /* We don't free stream->item.  If it is assigned to aob, then
      active_outbound_item_reset() will delete it.  Otherwise,
@@ -125,11 +130,123 @@ static int stream_active(nghttp2_stream *stream) {
          (stream->flags & NGHTTP2_STREAM_FLAG_DEFERRED_ALL) == 0;
 }
 
+int nghttp2_stream_obq_empty(nghttp2_stream *stream) {
+  if (stream->obq_wheel) {
+    return nghttp2_wheel_empty(stream->obq_wheel);
+  }
+
+  return nghttp2_pq_empty(&stream->obq);
+}
+
+#ifdef STREAM_DEP_DEBUG
+static size_t obq_size(nghttp2_stream *stream) {
+  if (stream->obq_wheel) {
+    return nghttp2_wheel_size(stream->obq_wheel);
+  }
+
+  return nghttp2_pq_size(&stream->obq);
+}
+#endif /* STREAM_DEP_DEBUG */
+
+/*
+ * Moves the direct descendants in obq of |stream| to newly allocated
+ * nghttp2_wheel.  If memory allocation fails, |stream| keeps using
+ * nghttp2_pq, which is still correct, just slower.
+ */
+static void obq_use_wheel(nghttp2_stream *stream) {
+  nghttp2_wheel *wheel;
+  nghttp2_pq_entry *ent;
+  nghttp2_stream *si;
+
+  wheel = nghttp2_mem_malloc(stream->obq.mem, sizeof(nghttp2_wheel));
+  if (wheel == NULL) {
+    return;
+  }
+
+  nghttp2_wheel_init(wheel);
+
+  while ((ent = nghttp2_pq_top(&stream->obq)) != NULL) {
+    si = nghttp2_struct_of(ent, nghttp2_stream, pq_entry);
+
+    nghttp2_pq_pop(&stream->obq);
+    nghttp2_wheel_push(wheel, &si->wheel_entry, si->cycle);
+  }
+
+  stream->obq_wheel = wheel;
+
+  DEBUGF("stream: stream=%d obq switched to wheel\n", stream->stream_id);
+}
+
+/*
+ * Adds |stream| to obq of |dep_stream| with stream->cycle.
+ */
+static int obq_push(nghttp2_stream *dep_stream, nghttp2_stream *stream) {
+  /* A flat tree, where all streams depend on the root, puts
+     thousands of streams in one obq, which nghttp2_wheel handles in
+     constant time.  Other obqs are usually small. */
+  if (dep_stream->obq_wheel == NULL && dep_stream->dep_prev == NULL &&
+      nghttp2_pq_size(&dep_stream->obq) + 1 >=
+          NGHTTP2_STREAM_OBQ_WHEEL_THRESHOLD) {
+    obq_use_wheel(dep_stream);
+  }
+
+  if (dep_stream->obq_wheel) {
+    nghttp2_wheel_push(dep_stream->obq_wheel, &stream->wheel_entry,
+                       stream->cycle);
+    return 0;
+  }
+
+  return nghttp2_pq_push(&dep_stream->obq, &stream->pq_entry);
+}
+
+/*
+ * Removes |stream| from obq of |dep_stream|.
+ */
+static void obq_remove(nghttp2_stream *dep_stream, nghttp2_stream *stream) {
+  if (dep_stream->obq_wheel == NULL) {
+    nghttp2_pq_remove(&dep_stream->obq, &stream->pq_entry);
+    return;
+  }
+
+  nghttp2_wheel_remove(dep_stream->obq_wheel, &stream->wheel_entry);
+
+  if (nghttp2_wheel_empty(dep_stream->obq_wheel)) {
+    /* Go back to nghttp2_pq, which is exact, and does not hold the
+       bucket array. */
+    nghttp2_mem_free(dep_stream->obq.mem, dep_stream->obq_wheel);
+    dep_stream->obq_wheel = NULL;
+  }
+}
+
+/*
+ * Returns the direct descendant of |stream| which should be scheduled
+ * next, or NULL if there is none.
+ */
+static nghttp2_stream *obq_top(nghttp2_stream *stream) {
+  nghttp2_pq_entry *ent;
+  nghttp2_wheel_entry *went;
+
+  if (stream->obq_wheel) {
+    went = nghttp2_wheel_top(stream->obq_wheel);
+    if (!went) {
+      return NULL;
+    }
+    return nghttp2_struct_of(went, nghttp2_stream, wheel_entry);
+  }
+
+  ent = nghttp2_pq_top(&stream->obq);
+  if (!ent) {
+    return NULL;
+  }
+
+  return nghttp2_struct_of(ent, nghttp2_stream, pq_entry);
+}
+
 /*
  * Returns nonzero if |stream| or one of its descendants is active
  */
 static int stream_subtree_active(nghttp2_stream *stream) {
-  return stream_active(stream) || !nghttp2_pq_empty(&stream->obq);
+  return stream_active(stream) || !nghttp2_stream_obq_empty(stream);
 }
 
 /*
@@ -159,7 +276,7 @@ static int stream_obq_push(nghttp2_stream *dep_stream, nghttp2_stream *stream) {
     DEBUGF("stream: push stream %d to stream %d\n", stream->stream_id,
            dep_stream->stream_id);
 
-    rv = nghttp2_pq_push(&dep_stream->obq, &stream->pq_entry);
+    rv = obq_push(dep_stream, stream);
     if (rv != 0) {
       return rv;
     }
@@ -187,7 +304,7 @@ static void stream_obq_remove(nghttp2_stream *stream) {
     DEBUGF("stream: remove stream %d from stream %d\n", stream->stream_id,
            dep_stream->stream_id);
 
-    nghttp2_pq_remove(&dep_stream->obq, &stream->pq_entry);
+    obq_remove(dep_stream, stream);
 
     assert(stream->queued);
 
@@ -205,8 +322,8 @@ static void stream_obq_remove(nghttp2_stream *stream) {
 
 /*
  * Moves |stream| from |src|'s obq to |dest|'s obq.  Removal from
- * |src|'s obq is just done calling nghttp2_pq_remove(), so it does
- * not recursively remove |src| and ancestors, like
+ * |src|'s obq is just done calling obq_remove(), so it does not
+ * recursively remove |src| and ancestors, like
  * stream_obq_remove().
  */
 static int stream_obq_move(nghttp2_stream *dest, nghttp2_stream *src,
@@ -218,7 +335,7 @@ static int stream_obq_move(nghttp2_stream *dest, nghttp2_stream *src,
   DEBUGF("stream: remove stream %d from stream %d (move)\n", stream->stream_id,
          src->stream_id);
 
-  nghttp2_pq_remove(&src->obq, &stream->pq_entry);
+  obq_remove(src, stream);
   stream->queued = 0;
 
   return stream_obq_push(dest, stream);
@@ -232,12 +349,12 @@ void nghttp2_stream_reschedule(nghttp2_stream *stream) {
   dep_stream = stream->dep_prev;
 
   for (; dep_stream; stream = dep_stream, dep_stream = dep_stream->dep_prev) {
-    nghttp2_pq_remove(&dep_stream->obq, &stream->pq_entry);
+    obq_remove(dep_stream, stream);
 
     stream_next_cycle(stream, dep_stream->descendant_last_cycle);
     stream->seq = dep_stream->descendant_next_seq++;
 
-    nghttp2_pq_push(&dep_stream->obq, &stream->pq_entry);
+    obq_push(dep_stream, stream);
 
     DEBUGF("stream: stream=%d obq resched cycle=%d\n", stream->stream_id,
            stream->cycle);
@@ -271,7 +388,7 @@ void nghttp2_stream_change_weight(nghttp2_stream *stream, int32_t weight) {
     return;
   }
 
-  nghttp2_pq_remove(&dep_stream->obq, &stream->pq_entry);
+  obq_remove(dep_stream, stream);
 
   wlen_penalty = (uint32_t)stream->last_writelen * NGHTTP2_MAX_WEIGHT;
 
@@ -297,7 +414,7 @@ void nghttp2_stream_change_weight(nghttp2_stream *stream, int32_t weight) {
 
   /* Continue to use same stream->seq */
 
-  nghttp2_pq_push(&dep_stream->obq, &stream->pq_entry);
+  obq_push(dep_stream, stream);
 
   DEBUGF("stream: stream=%d obq resched cycle=%d\n", stream->stream_id,
          stream->cycle);
@@ -334,9 +451,9 @@ static void ensure_inactive(nghttp2_stream *stream) {
     assert(0);
   }
 
-  if (!nghttp2_pq_empty(&stream->obq)) {
+  if (!nghttp2_stream_obq_empty(stream)) {
     fprintf(stderr, "stream(%p)=%d, nghttp2_pq_size() = %zu; want 0\n", stream,
-            stream->stream_id, nghttp2_pq_size(&stream->obq));
+            stream->stream_id, obq_size(stream));
     assert(0);
   }
 
@@ -353,9 +470,9 @@ static void check_queued(nghttp2_stream *stream) {
     if (!stream_subtree_active(stream)) {
       fprintf(stderr,
               "stream(%p)=%d, stream->queued == 1, but "
-              "stream_active() == %d and nghttp2_pq_size(&stream->obq) = %zu\n",
+              "stream_active() == %d and obq_size(stream) = %zu\n",
               stream, stream->stream_id, stream_active(stream),
-              nghttp2_pq_size(&stream->obq));
+              obq_size(stream));
       assert(0);
     }
     if (!stream_active(stream)) {
@@ -378,13 +495,13 @@ static void check_queued(nghttp2_stream *stream) {
       check_queued(si);
     }
   } else {
-    if (stream_active(stream) || !nghttp2_pq_empty(&stream->obq)) {
+    if (stream_active(stream) || !nghttp2_stream_obq_empty(stream)) {
       fprintf(stderr,
               "stream(%p) = %d, stream->queued == 0, but "
               "stream_active(stream) == %d and "
-              "nghttp2_pq_size(&stream->obq) = %zu\n",
+              "obq_size(stream) = %zu\n",
               stream, stream->stream_id, stream_active(stream),
-              nghttp2_pq_size(&stream->obq));
+              obq_size(stream));
       assert(0);
     }
     for (si = stream->dep_next; si; si = si->sib_next) {
@@ -437,7 +554,7 @@ static void validate_tree(nghttp2_stream *stream) {
   assert(!stream->queued);
 
   fprintf(stderr, "checking...\n");
-  if (nghttp2_pq_empty(&stream->obq)) {
+  if (nghttp2_stream_obq_empty(stream)) {
     fprintf(stderr, "root obq empty\n");
     for (si = stream->dep_next; si; si = si->sib_next) {
       ensure_inactive(si);
@@ -468,7 +585,7 @@ static int stream_update_dep_on_attach_item(nghttp2_stream *stream) {
 }
 
 static int stream_update_dep_on_detach_item(nghttp2_stream *stream) {
-  if (nghttp2_pq_empty(&stream->obq)) {
+  if (nghttp2_stream_obq_empty(stream)) {
     stream_obq_remove(stream);
   }
 
@@ -488,6 +605,10 @@ int nghttp2_stream_attach_item(nghttp2_stream *stream,
 
   stream->item = item;
 
+  if (stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) {
+    return 0;
+  }
+
   rv = stream_update_dep_on_attach_item(stream);
   if (rv != 0) {
     /* This may relave stream->queued == 1, but stream->item == NULL.
@@ -507,6 +628,10 @@ int nghttp2_stream_detach_item(nghttp2_stream *stream) {
   stream->item = NULL;
   stream->flags = (uint8_t)(stream->flags & ~NGHTTP2_STREAM_FLAG_DEFERRED_ALL);
 
+  if (stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) {
+    return 0;
+  }
+
   return stream_update_dep_on_detach_item(stream);
 }
 
@@ -518,6 +643,10 @@ int nghttp2_stream_defer_item(nghttp2_stream *stream, uint8_t flags) {
 
   stream->flags |= flags;
 
+  if (stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES) {
+    return 0;
+  }
+
   return stream_update_dep_on_detach_item(stream);
 }
 
@@ -529,7 +658,8 @@ int nghttp2_stream_resume_deferred_item(nghttp2_stream *stream, uint8_t flags) {
 
   stream->flags = (uint8_t)(stream->flags & ~flags);
 
-  if (stream->flags & NGHTTP2_STREAM_FLAG_DEFERRED_ALL) {
+  if (stream->flags & (NGHTTP2_STREAM_FLAG_DEFERRED_ALL |
+                       NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES)) {
     return 0;
   }
 
@@ -925,7 +1055,6 @@ int nghttp2_stream_in_dep_tree(nghttp2_stream *stream) {
 
 nghttp2_outbound_item *
 nghttp2_stream_next_outbound_item(nghttp2_stream *stream) {
-  nghttp2_pq_entry *ent;
   nghttp2_stream *si;
 
   for (;;) {
@@ -937,11 +1066,10 @@ nghttp2_stream_next_outbound_item(nghttp2_stream *stream) {
       }
       return stream->item;
     }
-    ent = nghttp2_pq_top(&stream->obq);
-    if (!ent) {
+    stream = obq_top(stream);
+    if (!stream) {
       return NULL;
     }
-    stream = nghttp2_struct_of(ent, nghttp2_stream, pq_entry);
   }
 }
 
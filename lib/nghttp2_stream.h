@@ -33,8 +33,15 @@
 #include "nghttp2_outbound_item.h"
 #include "nghttp2_map.h"
 #include "nghttp2_pq.h"
+#include "nghttp2_wheel.h"
 #include "nghttp2_int.h"
 
+/* The number of queued direct descendants at which the root of
+   dependency tree switches from nghttp2_pq to nghttp2_wheel.  Below
+   this, the binary heap is cheap enough, schedules exactly, and does
+   not need the bucket array of nghttp2_wheel. */
+#define NGHTTP2_STREAM_OBQ_WHEEL_THRESHOLD 32
+
 /*
  * If local peer is stream initiator:
  * NGHTTP2_STREAM_OPENING : upon sending request HEADERS
@@ -90,8 +97,13 @@ typedef enum {
   NGHTTP2_STREAM_FLAG_DEFERRED_USER = 0x08,
   /* bitwise OR of NGHTTP2_STREAM_FLAG_DEFERRED_FLOW_CONTROL and
      NGHTTP2_STREAM_FLAG_DEFERRED_USER. */
-  NGHTTP2_STREAM_FLAG_DEFERRED_ALL = 0x0c
-
+  NGHTTP2_STREAM_FLAG_DEFERRED_ALL = 0x0c,
+  /* Indicates that this stream is not subject to RFC7540
+     priorities scheme, and is scheduled by RFC 9218 urgency buckets
+     in nghttp2_session. */
+  NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES = 0x10,
+  /* Ignore client RFC 9218 priority signal. */
+  NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES = 0x20
 } nghttp2_stream_flag;
 
 /* HTTP related flags to enforce HTTP semantics */
@@ -130,7 +142,11 @@ typedef enum {
   /* "http" or "https" scheme */
   NGHTTP2_HTTP_FLAG_SCHEME_HTTP = 1 << 13,
   /* set if final response is expected */
-  NGHTTP2_HTTP_FLAG_EXPECT_FINAL_RESPONSE = 1 << 14
+  NGHTTP2_HTTP_FLAG_EXPECT_FINAL_RESPONSE = 1 << 14,
+  /* priority header field is received and parsed successfully */
+  NGHTTP2_HTTP_FLAG_PRIORITY = 1 << 15,
+  /* priority header field is received, but it is malformed */
+  NGHTTP2_HTTP_FLAG_BAD_PRIORITY = 1 << 16
 } nghttp2_http_flag;
 
 struct nghttp2_stream {
@@ -142,6 +158,13 @@ struct nghttp2_stream {
      streams which itself has some data to send, or has a descendant
      which has some data to sent. */
   nghttp2_pq obq;
+  /* Entry for dep_prev->obq_wheel */
+  nghttp2_wheel_entry wheel_entry;
+  /* If not NULL, direct descendants are stored in this instead of
+     obq.  Only the root of dependency tree switches to it, when it
+     has NGHTTP2_STREAM_OBQ_WHEEL_THRESHOLD queued descendants, and
+     switches back when it becomes empty. */
+  nghttp2_wheel *obq_wheel;
   /* Content-Length of request/response body.  -1 if unknown. */
   int64_t content_length;
   /* Received body so far */
@@ -205,7 +228,7 @@ struct nghttp2_stream {
   /* status code from remote server */
   int16_t status_code;
   /* Bitwise OR of zero or more nghttp2_http_flag values */
-  uint16_t http_flags;
+  uint32_t http_flags;
   /* This is bitwise-OR of 0 or more of nghttp2_stream_flag. */
   uint8_t flags;
   /* Bitwise OR of zero or more nghttp2_shut_flag values */
@@ -219,6 +242,13 @@ struct nghttp2_stream {
      this stream.  The nonzero does not necessarily mean WINDOW_UPDATE
      is not queued. */
   uint8_t window_update_queued;
+  /* RFC 9218 extensible priorities of this stream, encoded by
+     nghttp2_extpri_to_uint8. */
+  uint8_t extpri;
+  /* RFC 9218 priorities signaled by priority request header field.
+     This is only set if NGHTTP2_HTTP_FLAG_PRIORITY is set in
+     http_flags. */
+  uint8_t http_extpri;
 };
 
 void nghttp2_stream_init(nghttp2_stream *stream, int32_t stream_id,
@@ -229,6 +259,12 @@ void nghttp2_stream_init(nghttp2_stream *stream, int32_t stream_id,
 
 void nghttp2_stream_free(nghttp2_stream *stream);
 
+/*
+ * The less function for nghttp2_pq which orders nghttp2_stream by
+ * cycle, and then by seq.
+ */
+int nghttp2_stream_less(const void *lhsx, const void *rhsx);
+
 /*
  * Disallow either further receptions or transmissions, or both.
  * |flag| is bitwise OR of one or more of nghttp2_shut_flag.
@@ -426,6 +462,11 @@ void nghttp2_stream_reschedule(nghttp2_stream *stream);
  */
 void nghttp2_stream_change_weight(nghttp2_stream *stream, int32_t weight);
 
+/*
+ * Returns nonzero if no descendant of |stream| has an item to send.
+ */
+int nghttp2_stream_obq_empty(nghttp2_stream *stream);
+
 /*
  * Returns a stream which has highest priority, updating
  * descendant_last_cycle of selected stream's ancestors.
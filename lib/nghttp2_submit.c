@@ -61,13 +61,15 @@ static int detect_self_dependency(nghttp2_session *session, int32_t stream_id,
   return 0;
 }
 
-/* This function takes ownership of |nva_copy|. Regardless of the
-   return value, the caller must not free |nva_copy| after this
-   function returns. */
+/* This function takes ownership of |nva_copy|, which was taken from
+   |nva_pool| if it is not NULL. Regardless of the return value, the
+   caller must not free |nva_copy| after this function returns. */
 static int32_t submit_headers_shared(nghttp2_session *session, uint8_t flags,
                                      int32_t stream_id,
                                      const nghttp2_priority_spec *pri_spec,
+                                     nghttp2_hd_template *tmpl,
                                      nghttp2_nv *nva_copy, size_t nvlen,
+                                     nghttp2_objpool *nva_pool,
                                      const nghttp2_data_provider *data_prd,
                                      void *stream_user_data) {
   int rv;
@@ -79,7 +81,7 @@ static int32_t submit_headers_shared(nghttp2_session *session, uint8_t flags,
 
   mem = &session->mem;
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     rv = NGHTTP2_ERR_NOMEM;
     goto fail;
@@ -92,6 +94,7 @@ static int32_t submit_headers_shared(nghttp2_session *session, uint8_t flags,
   }
 
   item->aux_data.headers.stream_user_data = stream_user_data;
+  item->aux_data.headers.nva_pool = nva_pool;
 
   flags_copy =
       (uint8_t)((flags & (NGHTTP2_FLAG_END_STREAM | NGHTTP2_FLAG_PRIORITY)) |
@@ -120,10 +123,15 @@ static int32_t submit_headers_shared(nghttp2_session *session, uint8_t flags,
   rv = nghttp2_session_add_item(session, item);
 
   if (rv != 0) {
-    nghttp2_frame_headers_free(&frame->headers, mem);
+    nghttp2_outbound_item_free(item, mem);
     goto fail2;
   }
 
+  if (tmpl) {
+    nghttp2_hd_template_incref(tmpl);
+    item->aux_data.headers.tmpl = tmpl;
+  }
+
   if (hcat == NGHTTP2_HCAT_REQUEST) {
     return stream_id;
   }
@@ -132,9 +140,9 @@ static int32_t submit_headers_shared(nghttp2_session *session, uint8_t flags,
 
 fail:
   /* nghttp2_frame_headers_init() takes ownership of nva_copy. */
-  nghttp2_nv_array_del(nva_copy, mem);
+  nghttp2_nv_array_del2(nva_copy, nva_pool, mem);
 fail2:
-  nghttp2_mem_free(mem, item);
+  nghttp2_objpool_put(&session->item_pool, item);
 
   return rv;
 }
@@ -142,11 +150,13 @@ fail2:
 static int32_t submit_headers_shared_nva(nghttp2_session *session,
                                          uint8_t flags, int32_t stream_id,
                                          const nghttp2_priority_spec *pri_spec,
+                                         nghttp2_hd_template *tmpl,
                                          const nghttp2_nv *nva, size_t nvlen,
                                          const nghttp2_data_provider *data_prd,
                                          void *stream_user_data) {
   int rv;
   nghttp2_nv *nva_copy;
+  nghttp2_objpool *nva_pool;
   nghttp2_priority_spec copy_pri_spec;
   nghttp2_mem *mem;
 
@@ -159,13 +169,16 @@ static int32_t submit_headers_shared_nva(nghttp2_session *session,
     nghttp2_priority_spec_default_init(&copy_pri_spec);
   }
 
-  rv = nghttp2_nv_array_copy(&nva_copy, nva, nvlen, mem);
+  nva_pool = &session->nva_pool;
+
+  rv = nghttp2_nv_array_copy2(&nva_copy, &nva_pool, nva, nvlen, mem);
   if (rv < 0) {
     return rv;
   }
 
-  return submit_headers_shared(session, flags, stream_id, &copy_pri_spec,
-                               nva_copy, nvlen, data_prd, stream_user_data);
+  return submit_headers_shared(session, flags, stream_id, &copy_pri_spec, tmpl,
+                               nva_copy, nvlen, nva_pool, data_prd,
+                               stream_user_data);
 }
 
 int nghttp2_submit_trailer(nghttp2_session *session, int32_t stream_id,
@@ -175,8 +188,8 @@ int nghttp2_submit_trailer(nghttp2_session *session, int32_t stream_id,
   }
 
   return (int)submit_headers_shared_nva(session, NGHTTP2_FLAG_END_STREAM,
-                                        stream_id, NULL, nva, nvlen, NULL,
-                                        NULL);
+                                        stream_id, NULL, NULL, nva, nvlen,
+                                        NULL, NULL);
 }
 
 int32_t nghttp2_submit_headers(nghttp2_session *session, uint8_t flags,
@@ -184,6 +197,16 @@ int32_t nghttp2_submit_headers(nghttp2_session *session, uint8_t flags,
                                const nghttp2_priority_spec *pri_spec,
                                const nghttp2_nv *nva, size_t nvlen,
                                void *stream_user_data) {
+  return nghttp2_submit_headers2(session, flags, stream_id, pri_spec, NULL, nva,
+                                 nvlen, stream_user_data);
+}
+
+int32_t nghttp2_submit_headers2(nghttp2_session *session, uint8_t flags,
+                                int32_t stream_id,
+                                const nghttp2_priority_spec *pri_spec,
+                                nghttp2_hd_template *tmpl,
+                                const nghttp2_nv *nva, size_t nvlen,
+                                void *stream_user_data) {
   int rv;
 
   if (stream_id == -1) {
@@ -207,8 +230,8 @@ int32_t nghttp2_submit_headers(nghttp2_session *session, uint8_t flags,
     pri_spec = NULL;
   }
 
-  return submit_headers_shared_nva(session, flags, stream_id, pri_spec, nva,
-                                   nvlen, NULL, stream_user_data);
+  return submit_headers_shared_nva(session, flags, stream_id, pri_spec, tmpl,
+                                   nva, nvlen, NULL, stream_user_data);
 }
 
 int nghttp2_submit_ping(nghttp2_session *session, uint8_t flags,
@@ -224,11 +247,8 @@ int nghttp2_submit_priority(nghttp2_session *session, uint8_t flags,
   nghttp2_outbound_item *item;
   nghttp2_frame *frame;
   nghttp2_priority_spec copy_pri_spec;
-  nghttp2_mem *mem;
   (void)flags;
 
-  mem = &session->mem;
-
   if (stream_id == 0 || pri_spec == NULL) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
@@ -241,7 +261,7 @@ int nghttp2_submit_priority(nghttp2_session *session, uint8_t flags,
 
   nghttp2_priority_spec_normalize_weight(&copy_pri_spec);
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
 
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
@@ -257,7 +277,7 @@ int nghttp2_submit_priority(nghttp2_session *session, uint8_t flags,
 
   if (rv != 0) {
     nghttp2_frame_priority_free(&frame->priority);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
 
     return rv;
   }
@@ -335,7 +355,7 @@ int32_t nghttp2_submit_push_promise(nghttp2_session *session, uint8_t flags,
     return NGHTTP2_ERR_STREAM_ID_NOT_AVAILABLE;
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -346,9 +366,12 @@ int32_t nghttp2_submit_push_promise(nghttp2_session *session, uint8_t flags,
 
   frame = &item->frame;
 
-  rv = nghttp2_nv_array_copy(&nva_copy, nva, nvlen, mem);
+  item->aux_data.headers.nva_pool = &session->nva_pool;
+
+  rv = nghttp2_nv_array_copy2(&nva_copy, &item->aux_data.headers.nva_pool, nva,
+                              nvlen, mem);
   if (rv < 0) {
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
 
@@ -363,8 +386,8 @@ int32_t nghttp2_submit_push_promise(nghttp2_session *session, uint8_t flags,
   rv = nghttp2_session_add_item(session, item);
 
   if (rv != 0) {
-    nghttp2_frame_push_promise_free(&frame->push_promise, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_outbound_item_free(item, mem);
+    nghttp2_objpool_put(&session->item_pool, item);
 
     return rv;
   }
@@ -537,7 +560,7 @@ int nghttp2_submit_altsvc(nghttp2_session *session, uint8_t flags,
   }
   *p++ = '\0';
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     rv = NGHTTP2_ERR_NOMEM;
     goto fail_item_malloc;
@@ -558,7 +581,7 @@ int nghttp2_submit_altsvc(nghttp2_session *session, uint8_t flags,
   rv = nghttp2_session_add_item(session, item);
   if (rv != 0) {
     nghttp2_frame_altsvc_free(&frame->ext, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
 
     return rv;
   }
@@ -621,7 +644,7 @@ int nghttp2_submit_origin(nghttp2_session *session, uint8_t flags,
     ov_copy = NULL;
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     rv = NGHTTP2_ERR_NOMEM;
     goto fail_item_malloc;
@@ -641,7 +664,7 @@ int nghttp2_submit_origin(nghttp2_session *session, uint8_t flags,
   rv = nghttp2_session_add_item(session, item);
   if (rv != 0) {
     nghttp2_frame_origin_free(&frame->ext, mem);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
 
     return rv;
   }
@@ -654,6 +677,78 @@ fail_item_malloc:
   return rv;
 }
 
+int nghttp2_submit_priority_update(nghttp2_session *session, uint8_t flags,
+                                   int32_t stream_id,
+                                   const uint8_t *field_value,
+                                   size_t field_value_len) {
+  nghttp2_mem *mem;
+  uint8_t *buf, *p;
+  nghttp2_outbound_item *item;
+  nghttp2_frame *frame;
+  nghttp2_ext_priority_update *priority_update;
+  int rv;
+  (void)flags;
+
+  mem = &session->mem;
+
+  if (session->server) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (session->remote_settings.no_rfc7540_priorities == 0) {
+    return NGHTTP2_ERR_INVALID_STATE;
+  }
+
+  if (stream_id == 0 || 4 + field_value_len > NGHTTP2_MAX_PAYLOADLEN) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+
+  if (field_value_len) {
+    buf = nghttp2_mem_malloc(mem, field_value_len + 1);
+    if (buf == NULL) {
+      return NGHTTP2_ERR_NOMEM;
+    }
+
+    p = nghttp2_cpymem(buf, field_value, field_value_len);
+    *p = '\0';
+  } else {
+    buf = NULL;
+  }
+
+  item = nghttp2_objpool_get(&session->item_pool);
+  if (item == NULL) {
+    rv = NGHTTP2_ERR_NOMEM;
+    goto fail_item_malloc;
+  }
+
+  nghttp2_outbound_item_init(item);
+
+  item->aux_data.ext.builtin = 1;
+
+  priority_update = &item->ext_frame_payload.priority_update;
+
+  frame = &item->frame;
+  frame->ext.payload = priority_update;
+
+  nghttp2_frame_priority_update_init(&frame->ext, stream_id, buf,
+                                     field_value_len);
+
+  rv = nghttp2_session_add_item(session, item);
+  if (rv != 0) {
+    nghttp2_frame_priority_update_free(&frame->ext, mem);
+    nghttp2_objpool_put(&session->item_pool, item);
+
+    return rv;
+  }
+
+  return 0;
+
+fail_item_malloc:
+  nghttp2_mem_free(mem, buf);
+
+  return rv;
+}
+
 static uint8_t set_request_flags(const nghttp2_priority_spec *pri_spec,
                                  const nghttp2_data_provider *data_prd) {
   uint8_t flags = NGHTTP2_FLAG_NONE;
@@ -691,8 +786,8 @@ int32_t nghttp2_submit_request(nghttp2_session *session,
 
   flags = set_request_flags(pri_spec, data_prd);
 
-  return submit_headers_shared_nva(session, flags, -1, pri_spec, nva, nvlen,
-                                   data_prd, stream_user_data);
+  return submit_headers_shared_nva(session, flags, -1, pri_spec, NULL, nva,
+                                   nvlen, data_prd, stream_user_data);
 }
 
 static uint8_t set_response_flags(const nghttp2_data_provider *data_prd) {
@@ -706,6 +801,14 @@ static uint8_t set_response_flags(const nghttp2_data_provider *data_prd) {
 int nghttp2_submit_response(nghttp2_session *session, int32_t stream_id,
                             const nghttp2_nv *nva, size_t nvlen,
                             const nghttp2_data_provider *data_prd) {
+  return nghttp2_submit_response2(session, stream_id, NULL, nva, nvlen,
+                                  data_prd);
+}
+
+int nghttp2_submit_response2(nghttp2_session *session, int32_t stream_id,
+                             nghttp2_hd_template *tmpl, const nghttp2_nv *nva,
+                             size_t nvlen,
+                             const nghttp2_data_provider *data_prd) {
   uint8_t flags;
 
   if (stream_id <= 0) {
@@ -717,8 +820,8 @@ int nghttp2_submit_response(nghttp2_session *session, int32_t stream_id,
   }
 
   flags = set_response_flags(data_prd);
-  return submit_headers_shared_nva(session, flags, stream_id, NULL, nva, nvlen,
-                                   data_prd, NULL);
+  return submit_headers_shared_nva(session, flags, stream_id, NULL, tmpl, nva,
+                                   nvlen, data_prd, NULL);
 }
 
 int nghttp2_submit_data(nghttp2_session *session, uint8_t flags,
@@ -729,15 +832,12 @@ int nghttp2_submit_data(nghttp2_session *session, uint8_t flags,
   nghttp2_frame *frame;
   nghttp2_data_aux_data *aux_data;
   uint8_t nflags = flags & NGHTTP2_FLAG_END_STREAM;
-  nghttp2_mem *mem;
-
-  mem = &session->mem;
 
   if (stream_id == 0) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -756,7 +856,7 @@ int nghttp2_submit_data(nghttp2_session *session, uint8_t flags,
   rv = nghttp2_session_add_item(session, item);
   if (rv != 0) {
     nghttp2_frame_data_free(&frame->data);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
   return 0;
@@ -781,9 +881,6 @@ int nghttp2_submit_extension(nghttp2_session *session, uint8_t type,
   int rv;
   nghttp2_outbound_item *item;
   nghttp2_frame *frame;
-  nghttp2_mem *mem;
-
-  mem = &session->mem;
 
   if (type <= NGHTTP2_CONTINUATION) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
@@ -793,7 +890,7 @@ int nghttp2_submit_extension(nghttp2_session *session, uint8_t type,
     return NGHTTP2_ERR_INVALID_STATE;
   }
 
-  item = nghttp2_mem_malloc(mem, sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if (item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -806,7 +903,7 @@ int nghttp2_submit_extension(nghttp2_session *session, uint8_t type,
   rv = nghttp2_session_add_item(session, item);
   if (rv != 0) {
     nghttp2_frame_extension_free(&frame->ext);
-    nghttp2_mem_free(mem, item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return rv;
   }
 
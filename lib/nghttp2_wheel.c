@@ -0,0 +1,154 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_wheel.h"
+
+#include <string.h>
+#include <assert.h>
+
+#include "nghttp2_helper.h"
+
+#define NGHTTP2_WHEEL_MASK (NGHTTP2_WHEEL_NBUCKET - 1)
+
+void nghttp2_wheel_init(nghttp2_wheel *wheel) {
+  memset(wheel, 0, sizeof(*wheel));
+}
+
+/*
+ * Returns the number of trailing zero bits in |x|, which must not be
+ * 0.
+ */
+static size_t wheel_ctz(uint64_t x) {
+#if defined(__GNUC__)
+  return (size_t)__builtin_ctzll(x);
+#else  /* !defined(__GNUC__) */
+  size_t n = 0;
+
+  for (; (x & 1) == 0; x >>= 1, ++n)
+    ;
+
+  return n;
+#endif /* !defined(__GNUC__) */
+}
+
+void nghttp2_wheel_push(nghttp2_wheel *wheel, nghttp2_wheel_entry *ent,
+                        uint32_t key) {
+  uint32_t d;
+  size_t n;
+  nghttp2_wheel_bucket *b;
+
+  if (wheel->length == 0) {
+    wheel->base = key & ~((1u << NGHTTP2_WHEEL_BUCKET_SHIFT) - 1);
+    wheel->cur = (key >> NGHTTP2_WHEEL_BUCKET_SHIFT) & NGHTTP2_WHEEL_MASK;
+  }
+
+  d = key - wheel->base;
+
+  if (d > UINT32_MAX / 2) {
+    /* key is smaller than base */
+    n = 0;
+  } else {
+    /* Keys beyond the range of buckets are put into the last
+       bucket. */
+    n = nghttp2_min((size_t)(d >> NGHTTP2_WHEEL_BUCKET_SHIFT),
+                    (size_t)NGHTTP2_WHEEL_NBUCKET - 1);
+  }
+
+  ent->bucket = (wheel->cur + n) & NGHTTP2_WHEEL_MASK;
+  ent->next = NULL;
+
+  b = &wheel->buckets[ent->bucket];
+
+  ent->prev = b->tail;
+
+  if (b->tail) {
+    b->tail->next = ent;
+  } else {
+    b->head = ent;
+    wheel->nonempty[ent->bucket / 64] |= 1ull << (ent->bucket % 64);
+  }
+
+  b->tail = ent;
+
+  ++wheel->length;
+}
+
+nghttp2_wheel_entry *nghttp2_wheel_top(nghttp2_wheel *wheel) {
+  size_t i, k;
+  uint64_t bits;
+
+  if (wheel->length == 0) {
+    return NULL;
+  }
+
+  i = wheel->cur;
+
+  /* The word which includes cur is visited twice: first for the
+     buckets from cur, and last for the ones before cur. */
+  for (k = 0; k <= NGHTTP2_WHEEL_NBUCKET / 64; ++k) {
+    bits = wheel->nonempty[i / 64] & (~0ull << (i % 64));
+    if (bits) {
+      i = i / 64 * 64 + wheel_ctz(bits);
+      break;
+    }
+
+    i = (i / 64 + 1) * 64 & NGHTTP2_WHEEL_MASK;
+  }
+
+  assert(wheel->buckets[i].head);
+
+  wheel->base += (uint32_t)((i - wheel->cur) & NGHTTP2_WHEEL_MASK)
+                 << NGHTTP2_WHEEL_BUCKET_SHIFT;
+  wheel->cur = i;
+
+  return wheel->buckets[i].head;
+}
+
+void nghttp2_wheel_remove(nghttp2_wheel *wheel, nghttp2_wheel_entry *ent) {
+  nghttp2_wheel_bucket *b = &wheel->buckets[ent->bucket];
+
+  if (ent->prev) {
+    ent->prev->next = ent->next;
+  } else {
+    b->head = ent->next;
+  }
+
+  if (ent->next) {
+    ent->next->prev = ent->prev;
+  } else {
+    b->tail = ent->prev;
+  }
+
+  if (b->head == NULL) {
+    wheel->nonempty[ent->bucket / 64] &= ~(1ull << (ent->bucket % 64));
+  }
+
+  ent->prev = ent->next = NULL;
+
+  --wheel->length;
+}
+
+int nghttp2_wheel_empty(nghttp2_wheel *wheel) { return wheel->length == 0; }
+
+size_t nghttp2_wheel_size(nghttp2_wheel *wheel) { return wheel->length; }
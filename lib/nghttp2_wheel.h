@@ -0,0 +1,108 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGHTTP2_WHEEL_H
+#define NGHTTP2_WHEEL_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <nghttp2/nghttp2.h>
+
+/* The number of buckets in nghttp2_wheel */
+#define NGHTTP2_WHEEL_NBUCKET 512
+
+/* log2 of the range of keys one bucket covers.  The buckets cover
+   NGHTTP2_WHEEL_NBUCKET << NGHTTP2_WHEEL_BUCKET_SHIFT keys in total,
+   which must be larger than the distance between the smallest and
+   the largest key in a wheel. */
+#define NGHTTP2_WHEEL_BUCKET_SHIFT 14
+
+typedef struct nghttp2_wheel_entry nghttp2_wheel_entry;
+
+struct nghttp2_wheel_entry {
+  nghttp2_wheel_entry *prev, *next;
+  /* The index of bucket this entry is in */
+  size_t bucket;
+};
+
+typedef struct {
+  nghttp2_wheel_entry *head, *tail;
+} nghttp2_wheel_bucket;
+
+/*
+ * nghttp2_wheel is a priority queue keyed by uint32_t virtual time,
+ * which is allowed to wrap around.  Keys are grouped into buckets of
+ * 1 << NGHTTP2_WHEEL_BUCKET_SHIFT, and entries in a bucket are kept
+ * in insertion order, so that push, remove and top run in constant
+ * time, at the cost of ordering entries whose keys fall in the same
+ * bucket by arrival rather than by key.  A key which is smaller than
+ * the one of the current top bucket is put into the top bucket.
+ */
+typedef struct {
+  nghttp2_wheel_bucket buckets[NGHTTP2_WHEEL_NBUCKET];
+  /* Bit i is set if buckets[i] is not empty */
+  uint64_t nonempty[NGHTTP2_WHEEL_NBUCKET / 64];
+  /* The smallest key which belongs to buckets[cur] */
+  uint32_t base;
+  /* The index of the bucket which the smallest entry is in */
+  size_t cur;
+  /* The number of entries stored */
+  size_t length;
+} nghttp2_wheel;
+
+/*
+ * Initializes |wheel| to be empty.
+ */
+void nghttp2_wheel_init(nghttp2_wheel *wheel);
+
+/*
+ * Adds |ent| to |wheel| with the |key|.
+ */
+void nghttp2_wheel_push(nghttp2_wheel *wheel, nghttp2_wheel_entry *ent,
+                        uint32_t key);
+
+/*
+ * Returns the entry in the first non-empty bucket which was pushed
+ * first, or NULL if |wheel| is empty.
+ */
+nghttp2_wheel_entry *nghttp2_wheel_top(nghttp2_wheel *wheel);
+
+/*
+ * Removes |ent| from |wheel|.
+ */
+void nghttp2_wheel_remove(nghttp2_wheel *wheel, nghttp2_wheel_entry *ent);
+
+/*
+ * Returns nonzero if |wheel| is empty.
+ */
+int nghttp2_wheel_empty(nghttp2_wheel *wheel);
+
+/*
+ * Returns the number of entries in |wheel|.
+ */
+size_t nghttp2_wheel_size(nghttp2_wheel *wheel);
+
+#endif /* NGHTTP2_WHEEL_H */
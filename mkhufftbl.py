@@ -5,6 +5,12 @@
 # and decoding tables in C language.  The resulting code is used in
 # lib/nghttp2_hd_huffman.h and lib/nghttp2_hd_huffman_data.c
 #
+# The decoder looks up DECODE_BITS bits at a time.  The primary
+# decoding table is indexed by those bits, and gives up to
+# DECODE_MAX_SYMS symbols whose codes entirely fit in them.  The codes
+# longer than DECODE_BITS are decoded using the fact that the code is
+# canonical.
+#
 # [1] http://http2.github.io/http2-spec/compression.html
 
 from __future__ import unicode_literals
@@ -279,21 +285,12 @@ class Node:
         self.term = term
         self.left = None
         self.right = None
-        self.trans = []
-        self.id = None
-        self.accept = False
 
 class Context:
 
     def __init__(self):
-        self.next_id_ = 0
         self.root = Node()
 
-    def next_id(self):
-        id = self.next_id_
-        self.next_id_ += 1
-        return id
-
 def _add(node, sym, bits):
     if len(bits) == 0:
         node.term = sym
@@ -312,85 +309,83 @@ def _add(node, sym, bits):
 def huffman_tree_add(ctx, sym, bits):
     _add(ctx.root, sym, bits)
 
-def _set_node_id(ctx, node, prefix):
-    if node.term is not None:
-        return
-    if len(prefix) <= 7 and [1] * len(prefix) == prefix:
-        node.accept = True
-    node.id = ctx.next_id()
-    _set_node_id(ctx, node.left, prefix + [0])
-    _set_node_id(ctx, node.right, prefix + [1])
-
-def huffman_tree_set_node_id(ctx):
-    _set_node_id(ctx, ctx.root, [])
+# The number of bits the decoder looks up at once
+DECODE_BITS = 12
 
-def _traverse(node, sym, start_node, root, left):
-    if left == 0:
-        if sym == 256:
-            sym = None
-            node = None
-        start_node.trans.append((node, sym))
-        return
-
-    if node.term is not None:
-        node = root
+# The maximum number of symbols emitted by one lookup
+DECODE_MAX_SYMS = 2
 
-    def go(node):
-        if node.term is not None:
-            assert sym is None
-            nsym = node.term
+def _decode_window(ctx, w):
+    # Decodes at most DECODE_MAX_SYMS symbols whose codes entirely fit
+    # in DECODE_BITS bits window |w|.  Returns the list of (sym,
+    # nbits).
+    res = []
+    node = ctx.root
+    nbits = 0
+    for i in range(DECODE_BITS - 1, -1, -1):
+        if (w >> i) & 1:
+            node = node.right
         else:
-            nsym = sym
-
-        _traverse(node, nsym, start_node, root, left - 1)
-
-    go(node.left)
-    go(node.right)
-
-def _build_transition_table(ctx, node):
-    if node is None:
-        return
-    _traverse(node, None, node, ctx.root, 4)
-    _build_transition_table(ctx, node.left)
-    _build_transition_table(ctx, node.right)
+            node = node.left
+        nbits += 1
+        if node.term is not None:
+            assert node.term != 256
+            res.append((node.term, nbits))
+            if len(res) == DECODE_MAX_SYMS:
+                break
+            node = ctx.root
+            nbits = 0
+    return res
 
-def huffman_tree_build_transition_table(ctx):
-    _build_transition_table(ctx, ctx.root)
+def huffman_print_decode_table(ctx):
+    print '''\
+const nghttp2_huff_decode huff_decode_table[] = {'''
+    for w in range(1 << DECODE_BITS):
+        syms = _decode_window(ctx, w)
+        len0 = 0
+        nbits = 0
+        out = [0] * DECODE_MAX_SYMS
+        for i, (sym, n) in enumerate(syms):
+            if i == 0:
+                len0 = n
+            nbits += n
+            out[i] = sym
+        print '  {{{}, {}, {{{}}}}},'.format(
+            len0, nbits, ', '.join([str(x) for x in out]))
+    print '};'
 
-NGHTTP2_HUFF_ACCEPTED = 1
-NGHTTP2_HUFF_SYM = 1 << 1
-NGHTTP2_HUFF_FAIL = 1 << 2
+def huffman_print_decode_long_table(symbol_tbl):
+    # The code is canonical: sorting symbols by (nbits, sym) gives
+    # consecutive code values within the same length.
+    order = sorted(range(257), key = lambda x: (symbol_tbl[x][0], x))
+    prev_code, prev_nbits = -1, 0
+    first = {}
+    count = {}
+    offset = {}
+    for i, sym in enumerate(order):
+        nbits, code = symbol_tbl[sym][0], int(symbol_tbl[sym][1], 16)
+        assert code == (prev_code + 1) << (nbits - prev_nbits)
+        if nbits not in first:
+            first[nbits] = code
+            count[nbits] = 0
+            offset[nbits] = i
+        count[nbits] += 1
+        prev_code, prev_nbits = code, nbits
 
-def _print_transition_table(node):
-    if node.term is not None:
-        return
-    print '/* {} */'.format(node.id)
-    print '{'
-    for nd, sym in node.trans:
-        flags = 0
-        if sym is None:
-            out = 0
-        else:
-            out = sym
-            flags |= NGHTTP2_HUFF_SYM
-        if nd is None:
-            id = 0
-            flags |= NGHTTP2_HUFF_FAIL
-        else:
-            id = nd.id
-            if id is None:
-                # if nd.id is None, it is a leaf node
-                id = 0
-                flags |= NGHTTP2_HUFF_ACCEPTED
-            elif nd.accept:
-                flags |= NGHTTP2_HUFF_ACCEPTED
-        print '  {{{}, 0x{:02x}, {}}},'.format(id, flags, out)
-    print '},'
-    _print_transition_table(node.left)
-    _print_transition_table(node.right)
+    print '''\
+const nghttp2_huff_decode_long huff_decode_long_table[] = {'''
+    for nbits in range(DECODE_BITS + 1, 31):
+        print '  {{0x{:x}u, {}, {}}},'.format(first.get(nbits, 0),
+                                            count.get(nbits, 0),
+                                            offset.get(nbits, 0))
+    print '};'
+    print ''
 
-def huffman_tree_print_transition_table(ctx):
-    _print_transition_table(ctx.root)
+    print '''\
+const uint16_t huff_decode_canonical_sym_table[] = {'''
+    for sym in order:
+        print '  {},'.format(sym)
+    print '};'
 
 if __name__ == '__main__':
     ctx = Context()
@@ -410,9 +405,6 @@ if __name__ == '__main__':
             symbol_tbl[sym] = (nbits, code)
             huffman_tree_add(ctx, sym, bits)
 
-    huffman_tree_set_node_id(ctx)
-    huffman_tree_build_transition_table(ctx)
-
     print '''\
 typedef struct {
   uint32_t nbits;
@@ -430,22 +422,27 @@ const nghttp2_huff_sym huff_sym_table[] = {'''
     print ''
 
     print '''\
-enum {{
-  NGHTTP2_HUFF_ACCEPTED = {},
-  NGHTTP2_HUFF_SYM = {},
-  NGHTTP2_HUFF_FAIL = {},
-}} nghttp2_huff_decode_flag;
-'''.format(NGHTTP2_HUFF_ACCEPTED, NGHTTP2_HUFF_SYM, NGHTTP2_HUFF_FAIL)
+#define NGHTTP2_HUFF_DECODE_BITS {}
+#define NGHTTP2_HUFF_DECODE_MAX_SYMS {}
+'''.format(DECODE_BITS, DECODE_MAX_SYMS)
 
     print '''\
 typedef struct {
-  uint8_t state;
-  uint8_t flags;
-  uint8_t sym;
+  uint8_t len0;
+  uint8_t nbits;
+  uint8_t sym[NGHTTP2_HUFF_DECODE_MAX_SYMS];
 } nghttp2_huff_decode;
 '''
 
+    huffman_print_decode_table(ctx)
+    print ''
+
     print '''\
-const nghttp2_huff_decode huff_decode_table[][16] = {'''
-    huffman_tree_print_transition_table(ctx)
-    print '};'
+typedef struct {
+  uint32_t first;
+  uint16_t count;
+  uint16_t offset;
+} nghttp2_huff_decode_long;
+'''
+
+    huffman_print_decode_long_table(symbol_tbl)
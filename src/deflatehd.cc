@@ -53,6 +53,7 @@ typedef struct {
   size_t deflate_table_size;
   int http1text;
   int dump_header_table;
+  int adaptive_indexing;
 } deflate_config;
 
 static deflate_config config;
@@ -184,6 +185,9 @@ static nghttp2_hd_deflater *init_deflater() {
   if (config.table_size != NGHTTP2_DEFAULT_HEADER_TABLE_SIZE) {
     nghttp2_hd_deflate_change_table_size(deflater, config.table_size);
   }
+  if (config.adaptive_indexing) {
+    nghttp2_hd_deflate_set_adaptive_indexing(deflater, 1);
+  }
   return deflater;
 }
 
@@ -369,7 +373,10 @@ OPTIONS:
                       buffer.
                       Default: 4096
     -d, --dump-header-table
-                      Output dynamic header table.)"
+                      Output dynamic header table.
+    -a, --adaptive-indexing
+                      Decide  which  header  fields   are  indexed  from
+                      their recurrence.)"
             << std::endl;
 }
 
@@ -378,6 +385,7 @@ constexpr static struct option long_options[] = {
     {"table-size", required_argument, nullptr, 's'},
     {"deflate-table-size", required_argument, nullptr, 'S'},
     {"dump-header-table", no_argument, nullptr, 'd'},
+    {"adaptive-indexing", no_argument, nullptr, 'a'},
     {nullptr, 0, nullptr, 0}};
 
 int main(int argc, char **argv) {
@@ -387,9 +395,10 @@ int main(int argc, char **argv) {
   config.deflate_table_size = 4_k;
   config.http1text = 0;
   config.dump_header_table = 0;
+  config.adaptive_indexing = 0;
   while (1) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "S:dhs:t", long_options, &option_index);
+    int c = getopt_long(argc, argv, "S:adhs:t", long_options, &option_index);
     if (c == -1) {
       break;
     }
@@ -423,6 +432,10 @@ int main(int argc, char **argv) {
       // --dump-header-table
       config.dump_header_table = 1;
       break;
+    case 'a':
+      // --adaptive-indexing
+      config.adaptive_indexing = 1;
+      break;
     case '?':
       exit(EXIT_FAILURE);
     default:
@@ -0,0 +1,124 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include "nghttp2_config.h"
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+#include "template.h"
+
+namespace nghttp2 {
+
+// MPSCRing is a bounded lock-free queue which allows multiple
+// producers and a single consumer.  Each slot carries a sequence
+// number which tells whether the slot is ready to be written by a
+// producer or read by the consumer, so neither side ever takes a
+// lock.  T must be copy assignable.
+template <typename T> class MPSCRing {
+public:
+  // Creates ring which can hold at least |n| items.  |n| is rounded
+  // up to the power of 2.
+  explicit MPSCRing(size_t n) : mask_(round_up(n) - 1), head_(0), tail_(0) {
+    cells_ = make_unique<Cell[]>(mask_ + 1);
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  MPSCRing(const MPSCRing &) = delete;
+  MPSCRing &operator=(const MPSCRing &) = delete;
+
+  // Appends |v| to the ring.  This function returns false if the
+  // ring is full.  It is safe to call this function from multiple
+  // threads concurrently.
+  bool push(const T &v) {
+    auto pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &cell = cells_[pos & mask_];
+      auto seq = cell.seq.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.data = v;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+        // pos is updated by compare_exchange_weak on failure.
+        continue;
+      }
+      if (diff < 0) {
+        return false;
+      }
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Removes the oldest item from the ring, and assigns it to |v|.
+  // This function returns false if the ring is empty.  Only one
+  // thread may call this function.
+  bool pop(T &v) {
+    auto &cell = cells_[tail_ & mask_];
+    auto seq = cell.seq.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(tail_ + 1) < 0) {
+      return false;
+    }
+    v = cell.data;
+    cell.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+private:
+  static size_t round_up(size_t n) {
+    size_t m = 1;
+    while (m < n) {
+      m <<= 1;
+    }
+    return m;
+  }
+
+  struct Cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  // Producers and the consumer update different indexes.  Keep them
+  // in separate cache lines to avoid false sharing.
+  std::atomic<size_t> head_;
+  uint8_t pad_[64 - sizeof(std::atomic<size_t>)];
+  size_t tail_;
+};
+
+} // namespace nghttp2
+
+#endif // MPSC_RING_H
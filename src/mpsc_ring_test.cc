@@ -0,0 +1,130 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "mpsc_ring_test.h"
+
+#include <vector>
+#ifndef NOTHREADS
+#  include <thread>
+#endif // NOTHREADS
+
+#include <CUnit/CUnit.h>
+
+#include "mpsc_ring.h"
+
+namespace nghttp2 {
+
+void test_mpsc_ring_push_pop(void) {
+  MPSCRing<int> ring(3);
+  int v;
+
+  CU_ASSERT(4 == ring.capacity());
+  CU_ASSERT(!ring.pop(v));
+
+  for (int i = 0; i < 4; ++i) {
+    CU_ASSERT(ring.push(i));
+  }
+
+  // ring is full
+  CU_ASSERT(!ring.push(4));
+
+  CU_ASSERT(ring.pop(v));
+  CU_ASSERT(0 == v);
+
+  // wrap around
+  CU_ASSERT(ring.push(4));
+  CU_ASSERT(!ring.push(5));
+
+  for (int i = 1; i < 5; ++i) {
+    CU_ASSERT(ring.pop(v));
+    CU_ASSERT(i == v);
+  }
+
+  CU_ASSERT(!ring.pop(v));
+
+  // Keep going around the ring many times.
+  for (int i = 0; i < 1000; ++i) {
+    CU_ASSERT(ring.push(i));
+    CU_ASSERT(ring.push(i + 1));
+    CU_ASSERT(ring.pop(v));
+    CU_ASSERT(i == v);
+    CU_ASSERT(ring.pop(v));
+    CU_ASSERT(i + 1 == v);
+  }
+
+  CU_ASSERT(!ring.pop(v));
+}
+
+void test_mpsc_ring_concurrent_push(void) {
+#ifndef NOTHREADS
+  constexpr int NPRODUCER = 4;
+  constexpr int NITEM = 100000;
+
+  MPSCRing<std::pair<int, int>> ring(64);
+  std::vector<std::thread> producers;
+
+  for (int i = 0; i < NPRODUCER; ++i) {
+    producers.emplace_back([&ring, i]() {
+      for (int j = 0; j < NITEM;) {
+        if (ring.push({i, j})) {
+          ++j;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Items from the same producer must be received in order.
+  std::vector<int> next(NPRODUCER);
+  std::pair<int, int> v;
+  auto ok = true;
+
+  // Keep draining even after a failure so that producers can finish.
+  for (int n = 0; n < NPRODUCER * NITEM;) {
+    if (!ring.pop(v)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    ++n;
+
+    if (v.first < 0 || v.first >= NPRODUCER || next[v.first] != v.second) {
+      ok = false;
+      continue;
+    }
+
+    ++next[v.first];
+  }
+
+  for (auto &t : producers) {
+    t.join();
+  }
+
+  CU_ASSERT(ok);
+  CU_ASSERT(!ring.pop(v));
+#endif // !NOTHREADS
+}
+
+} // namespace nghttp2
@@ -34,11 +34,13 @@
 #include "shrpx_downstream_test.h"
 #include "shrpx_config_test.h"
 #include "shrpx_worker_test.h"
+#include "shrpx_load_balancer_test.h"
 #include "http2_test.h"
 #include "util_test.h"
 #include "nghttp2_gzip_test.h"
 #include "buffer_test.h"
 #include "memchunk_test.h"
+#include "mpsc_ring_test.h"
 #include "template_test.h"
 #include "shrpx_http_test.h"
 #include "base64_test.h"
@@ -127,8 +129,24 @@ int main(int argc, char *argv[]) {
                    shrpx::test_shrpx_config_read_tls_ticket_key_file) ||
       !CU_add_test(pSuite, "config_read_tls_ticket_key_file_aes_256",
                    shrpx::test_shrpx_config_read_tls_ticket_key_file_aes_256) ||
+      !CU_add_test(pSuite, "config_parse_backend_retry",
+                   shrpx::test_shrpx_config_parse_backend_retry) ||
+      !CU_add_test(pSuite, "config_parse_backend_health_check",
+                   shrpx::test_shrpx_config_parse_backend_health_check) ||
+      !CU_add_test(pSuite, "config_parse_backend_eject",
+                   shrpx::test_shrpx_config_parse_backend_eject) ||
       !CU_add_test(pSuite, "worker_match_downstream_addr_group",
                    shrpx::test_shrpx_worker_match_downstream_addr_group) ||
+      !CU_add_test(pSuite, "worker_retry_budget",
+                   shrpx::test_shrpx_worker_retry_budget) ||
+      !CU_add_test(pSuite, "worker_record_downstream_result",
+                   shrpx::test_shrpx_worker_record_downstream_result) ||
+      !CU_add_test(pSuite, "worker_eject_recovery",
+                   shrpx::test_shrpx_worker_eject_recovery) ||
+      !CU_add_test(pSuite, "lb_weighted_round_robin",
+                   shrpx::test_shrpx_lb_weighted_round_robin) ||
+      !CU_add_test(pSuite, "lb_p2c", shrpx::test_shrpx_lb_p2c) ||
+      !CU_add_test(pSuite, "lb_simulation", shrpx::test_shrpx_lb_simulation) ||
       !CU_add_test(pSuite, "http_create_forwarded",
                    shrpx::test_shrpx_http_create_forwarded) ||
       !CU_add_test(pSuite, "http_create_via_header_value",
@@ -212,6 +230,10 @@ int main(int argc, char *argv[]) {
                    nghttp2::test_peek_memchunks_disable_peek_no_drain) ||
       !CU_add_test(pSuite, "peek_memchunk_reset",
                    nghttp2::test_peek_memchunks_reset) ||
+      !CU_add_test(pSuite, "mpsc_ring_push_pop",
+                   nghttp2::test_mpsc_ring_push_pop) ||
+      !CU_add_test(pSuite, "mpsc_ring_concurrent_push",
+                   nghttp2::test_mpsc_ring_concurrent_push) ||
       !CU_add_test(pSuite, "template_immutable_string",
                    nghttp2::test_template_immutable_string) ||
       !CU_add_test(pSuite, "template_string_ref",
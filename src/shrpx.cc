@@ -758,6 +758,23 @@ int create_tcp_server_socket(UpstreamAddr &faddr,
     if (found != std::end(iaddrs)) {
       (*found).used = true;
       fd = (*found).fd;
+
+#ifdef SO_REUSEPORT
+      // The inherited socket may have been created without
+      // SO_REUSEPORT.  Set it so that the sockets created by worker
+      // threads can join its group.
+      if (listenerconf.reuseport) {
+        int val = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val,
+                       static_cast<socklen_t>(sizeof(val))) == -1) {
+          auto error = errno;
+          LOG(WARN) << "Failed to set SO_REUSEPORT option to inherited "
+                       "listener socket: "
+                    << xsi_strerror(error, errbuf.data(), errbuf.size());
+        }
+      }
+#endif // SO_REUSEPORT
+
       break;
     }
 
@@ -790,6 +807,19 @@ int create_tcp_server_socket(UpstreamAddr &faddr,
       continue;
     }
 
+#ifdef SO_REUSEPORT
+    if (listenerconf.reuseport) {
+      if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val,
+                     static_cast<socklen_t>(sizeof(val))) == -1) {
+        auto error = errno;
+        LOG(WARN) << "Failed to set SO_REUSEPORT option to listener socket: "
+                  << xsi_strerror(error, errbuf.data(), errbuf.size());
+        close(fd);
+        continue;
+      }
+    }
+#endif // SO_REUSEPORT
+
 #ifdef IPV6_V6ONLY
     if (faddr.family == AF_INET6) {
       if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &val,
@@ -1585,6 +1615,8 @@ void fill_default_config(Config *config) {
       // Keep alive timeout for HTTP/1 upstream connection
       timeoutconf.idle_read = 1_min;
     }
+
+    upstreamconf.worker_accept_batch = 16;
   }
 
   {
@@ -1735,13 +1767,18 @@ Connections:
               The  parameters are  delimited  by  ";".  The  available
               parameters       are:      "proto=<PROTO>",       "tls",
               "sni=<SNI_HOST>",         "fall=<N>",        "rise=<N>",
-              "affinity=<METHOD>",    "dns",    "redirect-if-not-tls",
-              "upgrade-scheme",  and  "mruby=<PATH>".   The  parameter
-              consists of keyword, and  optionally followed by "=" and
-              value.  For  example, the parameter  "proto=h2" consists
-              of the  keyword "proto"  and value "h2".   The parameter
-              "tls" consists of the keyword "tls" without value.  Each
-              parameter is described as follows.
+              "health-check=<PATH>",   "health-check-method=<METHOD>",
+              "health-check-status=<CODE>",               "eject=<N>",
+              "health-check-interval=<DURATION>",         "retry=<N>",
+              "retry-budget=<PERCENT>",    "retry-backoff=<DURATION>",
+              "weight=<N>", "lb=<POLICY>", "affinity=<METHOD>", "dns",
+              "redirect-if-not-tls",       "upgrade-scheme",       and
+              "mruby=<PATH>".  The parameter  consists of keyword, and
+              optionally followed by "="  and value.  For example, the
+              parameter "proto=h2" consists of the keyword "proto" and
+              value "h2".  The parameter "tls" consists of the keyword
+              "tls"  without value.   Each parameter  is described  as
+              follows.
 
               The backend application protocol  can be specified using
               optional  "proto"   parameter,  and   in  the   form  of
@@ -1776,6 +1813,89 @@ Connections:
               backend  is permanently  offline, once  it goes  in that
               state, and this is the default behaviour.
 
+              Active   health   check   is  enabled   using   optional
+              "health-check=<PATH>"  parameter.  nghttpx  periodically
+              sends a  request to <PATH>  of this backend, and  if the
+              response  status code  is not  the expected  one, or  no
+              response is received within  the interval or the backend
+              read  timeout, whichever  is shorter,  the check  fails.
+              The     request      method     is      specified     by
+              "health-check-method=<METHOD>",  and it  must be  one of
+              GET,  HEAD  and OPTIONS.   It  defaults  to "GET".   The
+              expected     status     code     is     specified     by
+              "health-check-status=<CODE>",  and it  defaults to  200.
+              The   interval   between   requests  is   specified   by
+              "health-check-interval=<DURATION>",  and it  defaults to
+              5s.   If the  check fails  "fall"  times in  a row,  the
+              backend is  assumed to  be offline,  and if  it succeeds
+              "rise"  times in  a row,  the backend  is assumed  to be
+              online  again.  If  "fall" or  "rise"  is 0,  1 is  used
+              instead.   Only one  worker  thread  sends health  check
+              requests to  each backend, and  the result is  shared by
+              all worker threads.  The  health check is configured per
+              <PATTERN>.  If  at least one backend  has "health-check"
+              parameter, it  is used  for all backend  servers sharing
+              the same <PATTERN>.
+
+              Using  "eject=<N>" parameter,  if this  backend responds
+              with 5xx status code, or the request to it times out <N>
+              times in a  row in a worker thread, it  is assumed to be
+              offline   in   that   worker   thread.    nghttpx   then
+              periodically attempts to make a connection to it, and if
+              the connection  is made  successfully "rise" times  in a
+              row, or once if "rise" is  0, it is brought back online.
+              If "health-check"  is used,  the next  successful active
+              health check brings  it back online instead.   If <N> is
+              0, this feature is disabled, and this is the default.
+
+              Using  "retry=<N>" parameter,  if  the  connection to  a
+              backend is lost,  or times out after a  request is sent,
+              or  the  backend  responds  with 503  status  code,  the
+              request is  sent again  to another  backend at  most <N>
+              times.   Only the  request  whose method  is GET,  HEAD,
+              OPTIONS,  TRACE,  PUT,  or  DELETE, and  whose  body  is
+              received  completely and  is at  most 16KiB  is retried.
+              The request is  not retried if response  header has been
+              received,  except  for  503.   If <N>  is  0,  retry  is
+              disabled,  and  this  is  the default.   The  number  of
+              retries is  limited by the  retry budget of  the backend
+              group  specified  by "retry-budget=<PERCENT>".   Retries
+              can be at most <PERCENT>%  of the requests to the group,
+              plus a small burst.  <PERCENT> must be an integer from 1
+              to  100, and  it defaults  to 20.   Before a  request is
+              retried,  nghttpx waits  for the  duration specified  by
+              "retry-backoff=<DURATION>",  which is  doubled for  each
+              retry of  the same request.   It defaults to  50ms.  The
+              retry configuration  is per <PATTERN>.  If  at least one
+              backend  has  "retry"  parameter,  it is  used  for  all
+              backend servers sharing the same <PATTERN>.
+
+              "weight=<N>"  parameter  specifies the  weight  of  this
+              backend in  load balancing.  <N>  must be an  integer in
+              [1,  256].   The  backend with  larger  weight  receives
+              proportionally more requests.  The  default weight is 1.
+              The weight is ignored if session affinity is enabled.
+
+              "lb=<POLICY>"  parameter  specifies  how  a  backend  is
+              selected among the backends  sharing the same <PATTERN>.
+              If  "round-robin" is  given  in  <POLICY>, backends  are
+              selected  in  weighted  round-robin,  and  this  is  the
+              default.  If  "least-outstanding" is given,  the backend
+              which  has  the  least number  of  outstanding  requests
+              divided by its weight is selected.  If "p2c" is given, 2
+              backends are  chosen at  random, and  the one  which has
+              less  outstanding  requests  divided by  its  weight  is
+              selected.  If "ewma" is given, the backend which has the
+              least exponentially weighted moving  average of response
+              header latency  multiplied by the number  of outstanding
+              requests, and  divided by its  weight is  selected.  The
+              number of  outstanding requests and latency  are tracked
+              per worker  thread.  If  at least  one backend  has "lb"
+              parameter, and  its <POLICY>  is not  "round-robin", the
+              policy is used for all  backend servers sharing the same
+              <PATTERN>.  The policy is ignored if session affinity is
+              enabled.
+
               The     session     affinity    is     enabled     using
               "affinity=<METHOD>"  parameter.   If  "ip" is  given  in
               <METHOD>, client  IP based session affinity  is enabled.
@@ -1964,6 +2084,14 @@ Performance:
               accepts.  Setting 0 means unlimited.
               Default: )"
       << config->conn.upstream.worker_connections << R"(
+  --worker-accept-batch=<N>
+              Set  the maximum  number  of  new connections  a  worker
+              thread takes from its connection queue in one event loop
+              iteration.  A larger  value lets a worker  absorb accept
+              bursts faster,  at the  cost of a  longer delay  for the
+              existing connections.
+              Default: )"
+      << config->conn.upstream.worker_accept_batch << R"(
   --backend-connections-per-host=<N>
               Set  maximum number  of  backend concurrent  connections
               (and/or  streams in  case  of HTTP/2)  per origin  host.
@@ -2004,6 +2132,30 @@ Performance:
               value is 0 then fast open is disabled.
               Default: )"
       << config->conn.listener.fastopen << R"(
+  --frontend-reuseport
+              Let each  worker thread accept connections  from its own
+              listening  socket bound  with  SO_REUSEPORT, instead  of
+              accepting them in the main  thread and handing them over
+              to  worker  threads.   The kernel  distributes  incoming
+              connections  among the  sockets.   The listening  socket
+              created   by   the   master  process   keeps   accepting
+              connections in the main thread  as a fallback, and it is
+              the one  inherited on  reload and binary  upgrade.  This
+              option  has  no  effect  for  UNIX  domain  socket,  API
+              endpoint, and when --single-thread is used.
+  --frontend-reuseport-cbpf
+              Attach a  classic BPF  program to SO_REUSEPORT  group to
+              select a  worker thread  by the  CPU which  received the
+              connection.  Connections received by  CPU N are accepted
+              by  worker  thread  #(N  %  <workers>).   This  is  only
+              effective if worker threads and NIC queues are pinned to
+              CPUs  accordingly.   The mapping  is  exact  only for  a
+              freshly  started   process.   After  reload   or  binary
+              upgrade, the sockets of the old worker process leave the
+              group in arbitrary order, and the mapping stays shuffled
+              until nghttpx is restarted.   Steering is best-effort in
+              that  case, and  connections are  still accepted.   This
+              option requires Linux and --frontend-reuseport.
   --no-kqueue Don't use  kqueue.  This  option is only  applicable for
               the platforms  which have kqueue.  For  other platforms,
               this option will be simply ignored.
@@ -2570,6 +2722,9 @@ Logging:
                 request.  "-" if backend host is not available.
               * $backend_port:  backend  port   used  to  fulfill  the
                 request.  "-" if backend host is not available.
+              * $backend_retries: the number of  times the request was
+                sent again to a backend (see "retry" parameter of
+                --backend option).
 
               The  variable  can  be  enclosed  by  "{"  and  "}"  for
               disambiguation (e.g., ${remote_addr}).
@@ -2895,6 +3050,30 @@ int process_options(Config *config,
     config->num_worker = 1;
   }
 
+  {
+    auto &listenerconf = config->conn.listener;
+
+#ifndef SO_REUSEPORT
+    if (listenerconf.reuseport) {
+      LOG(WARN) << "frontend-reuseport: SO_REUSEPORT is not supported on this "
+                   "platform; disabled";
+      listenerconf.reuseport = false;
+    }
+#endif // !SO_REUSEPORT
+
+    if (listenerconf.reuseport && config->single_thread) {
+      LOG(WARN) << "frontend-reuseport: ignored because single-thread is "
+                   "enabled";
+      listenerconf.reuseport = false;
+    }
+
+    if (listenerconf.reuseport_cbpf && !listenerconf.reuseport) {
+      LOG(WARN) << "frontend-reuseport-cbpf: ignored because "
+                   "frontend-reuseport is disabled";
+      listenerconf.reuseport_cbpf = false;
+    }
+  }
+
   auto &http2conf = config->http2;
   {
     auto &dumpconf = http2conf.upstream.debug.dump;
@@ -3481,6 +3660,9 @@ int main(int argc, char **argv) {
         {SHRPX_OPT_TLS13_CLIENT_CIPHERS.c_str(), required_argument, &flag, 165},
         {SHRPX_OPT_NO_STRIP_INCOMING_EARLY_DATA.c_str(), no_argument, &flag,
          166},
+        {SHRPX_OPT_FRONTEND_REUSEPORT.c_str(), no_argument, &flag, 167},
+        {SHRPX_OPT_FRONTEND_REUSEPORT_CBPF.c_str(), no_argument, &flag, 168},
+        {SHRPX_OPT_WORKER_ACCEPT_BATCH.c_str(), required_argument, &flag, 169},
         {nullptr, 0, nullptr, 0}};
 
     int option_index = 0;
@@ -4274,6 +4456,21 @@ int main(int argc, char **argv) {
         cmdcfgs.emplace_back(SHRPX_OPT_NO_STRIP_INCOMING_EARLY_DATA,
                              StringRef::from_lit("yes"));
         break;
+      case 167:
+        // --frontend-reuseport
+        cmdcfgs.emplace_back(SHRPX_OPT_FRONTEND_REUSEPORT,
+                             StringRef::from_lit("yes"));
+        break;
+      case 168:
+        // --frontend-reuseport-cbpf
+        cmdcfgs.emplace_back(SHRPX_OPT_FRONTEND_REUSEPORT_CBPF,
+                             StringRef::from_lit("yes"));
+        break;
+      case 169:
+        // --worker-accept-batch
+        cmdcfgs.emplace_back(SHRPX_OPT_WORKER_ACCEPT_BATCH,
+                             StringRef{optarg});
+        break;
       default:
         break;
       }
@@ -29,8 +29,10 @@
 #endif // HAVE_UNISTD_H
 
 #include <cerrno>
+#include <chrono>
 
 #include "shrpx_connection_handler.h"
+#include "shrpx_worker.h"
 #include "shrpx_config.h"
 #include "shrpx_log.h"
 #include "util.h"
@@ -47,15 +49,30 @@ void acceptcb(struct ev_loop *loop, ev_io *w, int revent) {
 } // namespace
 
 AcceptHandler::AcceptHandler(const UpstreamAddr *faddr, ConnectionHandler *h)
-    : conn_hnr_(h), faddr_(faddr) {
-  ev_io_init(&wev_, acceptcb, faddr_->fd, EV_READ);
+    : loop_(h->get_loop()),
+      conn_hnr_(h),
+      worker_(nullptr),
+      faddr_(faddr),
+      fd_(faddr->fd) {
+  ev_io_init(&wev_, acceptcb, fd_, EV_READ);
   wev_.data = this;
-  ev_io_start(conn_hnr_->get_loop(), &wev_);
+  ev_io_start(loop_, &wev_);
+}
+
+AcceptHandler::AcceptHandler(const UpstreamAddr *faddr, int fd, Worker *worker)
+    : loop_(worker->get_loop()),
+      conn_hnr_(worker->get_connection_handler()),
+      worker_(worker),
+      faddr_(faddr),
+      fd_(fd) {
+  ev_io_init(&wev_, acceptcb, fd_, EV_READ);
+  wev_.data = this;
+  ev_io_start(loop_, &wev_);
 }
 
 AcceptHandler::~AcceptHandler() {
-  ev_io_stop(conn_hnr_->get_loop(), &wev_);
-  close(faddr_->fd);
+  ev_io_stop(loop_, &wev_);
+  close(fd_);
 }
 
 void AcceptHandler::accept_connection() {
@@ -64,9 +81,9 @@ void AcceptHandler::accept_connection() {
 
 #ifdef HAVE_ACCEPT4
   auto cfd =
-      accept4(faddr_->fd, &sockaddr.sa, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      accept4(fd_, &sockaddr.sa, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 #else  // !HAVE_ACCEPT4
-  auto cfd = accept(faddr_->fd, &sockaddr.sa, &addrlen);
+  auto cfd = accept(fd_, &sockaddr.sa, &addrlen);
 #endif // !HAVE_ACCEPT4
 
   if (cfd == -1) {
@@ -87,7 +104,11 @@ void AcceptHandler::accept_connection() {
     case ENFILE:
       LOG(WARN) << "acceptor: running out file descriptor; disable acceptor "
                    "temporarily";
-      conn_hnr_->sleep_acceptor(get_config()->conn.listener.timeout.sleep);
+      if (worker_) {
+        worker_->sleep_acceptor(get_config()->conn.listener.timeout.sleep);
+      } else {
+        conn_hnr_->sleep_acceptor(get_config()->conn.listener.timeout.sleep);
+      }
       return;
     default:
       return;
@@ -99,13 +120,22 @@ void AcceptHandler::accept_connection() {
   util::make_socket_closeonexec(cfd);
 #endif // !HAVE_ACCEPT4
 
-  conn_hnr_->handle_connection(cfd, &sockaddr.sa, addrlen, faddr_);
+  auto accept_time = std::chrono::steady_clock::now();
+
+  if (worker_) {
+    worker_->handle_connection(cfd, &sockaddr.sa, addrlen, faddr_,
+                               accept_time);
+    return;
+  }
+
+  conn_hnr_->handle_connection(cfd, &sockaddr.sa, addrlen, faddr_,
+                               accept_time);
 }
 
-void AcceptHandler::enable() { ev_io_start(conn_hnr_->get_loop(), &wev_); }
+void AcceptHandler::enable() { ev_io_start(loop_, &wev_); }
 
-void AcceptHandler::disable() { ev_io_stop(conn_hnr_->get_loop(), &wev_); }
+void AcceptHandler::disable() { ev_io_stop(loop_, &wev_); }
 
-int AcceptHandler::get_fd() const { return faddr_->fd; }
+int AcceptHandler::get_fd() const { return fd_; }
 
 } // namespace shrpx
@@ -32,11 +32,17 @@
 namespace shrpx {
 
 class ConnectionHandler;
+class Worker;
 struct UpstreamAddr;
 
 class AcceptHandler {
 public:
   AcceptHandler(const UpstreamAddr *faddr, ConnectionHandler *h);
+  // Creates AcceptHandler which accepts connections from |fd| in the
+  // event loop of |worker|, and hands them to |worker| directly.
+  // |fd| must be a listening socket bound to the same address as
+  // |faddr|.  This object takes ownership of |fd|.
+  AcceptHandler(const UpstreamAddr *faddr, int fd, Worker *worker);
   ~AcceptHandler();
   void accept_connection();
   void enable();
@@ -45,8 +51,13 @@ public:
 
 private:
   ev_io wev_;
+  struct ev_loop *loop_;
   ConnectionHandler *conn_hnr_;
+  // Worker which owns this object.  nullptr if this object belongs
+  // to ConnectionHandler.
+  Worker *worker_;
   const UpstreamAddr *faddr_;
+  int fd_;
 };
 
 } // namespace shrpx
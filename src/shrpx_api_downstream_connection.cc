@@ -40,8 +40,8 @@ namespace shrpx {
 
 namespace {
 // List of API endpoints
-const std::array<APIEndpoint, 2> &apis() {
-  static const auto apis = new std::array<APIEndpoint, 2>{{
+const std::array<APIEndpoint, 3> &apis() {
+  static const auto apis = new std::array<APIEndpoint, 3>{{
       APIEndpoint{
           StringRef::from_lit("/api/v1beta1/backendconfig"),
           true,
@@ -54,6 +54,12 @@ const std::array<APIEndpoint, 2> &apis() {
           (1 << API_METHOD_GET),
           &APIDownstreamConnection::handle_configrevision,
       },
+      APIEndpoint{
+          StringRef::from_lit("/api/v1beta1/workerstats"),
+          false,
+          (1 << API_METHOD_GET),
+          &APIDownstreamConnection::handle_workerstats,
+      },
   }};
 
   return *apis;
@@ -173,6 +179,15 @@ int APIDownstreamConnection::send_reply(unsigned int http_status,
 namespace {
 const APIEndpoint *lookup_api(const StringRef &path) {
   switch (path.size()) {
+  case 24:
+    switch (path[23]) {
+    case 's':
+      if (util::streq_l("/api/v1beta1/workerstat", std::begin(path), 23)) {
+        return &apis()[2];
+      }
+      break;
+    }
+    break;
   case 26:
     switch (path[25]) {
     case 'g':
@@ -456,6 +471,50 @@ int APIDownstreamConnection::handle_configrevision() {
   return 0;
 }
 
+int APIDownstreamConnection::handle_workerstats() {
+  auto conn_handler = worker_->get_connection_handler();
+
+  // Construct the following string:
+  //   ,
+  //   "data":{
+  //     "workers":[
+  //       {
+  //         "acceptLatency":{
+  //           "count": N,
+  //           "sumNs": N,
+  //           "maxNs": N
+  //         }
+  //       }, ...
+  //     ]
+  //   }
+  std::string data = R"(,"data":{"workers":[)";
+
+  auto first = true;
+  for (auto wstat : conn_handler->get_worker_stats()) {
+    if (!first) {
+      data += ',';
+    }
+    first = false;
+
+    data += R"({"acceptLatency":{"count":)";
+    data += util::utos(
+        wstat->accept_latency_count.load(std::memory_order_relaxed));
+    data += R"(,"sumNs":)";
+    data +=
+        util::utos(wstat->accept_latency_sum.load(std::memory_order_relaxed));
+    data += R"(,"maxNs":)";
+    data +=
+        util::utos(wstat->accept_latency_max.load(std::memory_order_relaxed));
+    data += "}}";
+  }
+
+  data += "]}";
+
+  send_reply(200, API_SUCCESS, StringRef{data});
+
+  return 0;
+}
+
 void APIDownstreamConnection::pause_read(IOCtrlReason reason) {}
 
 int APIDownstreamConnection::resume_read(IOCtrlReason reason, size_t consumed) {
@@ -618,7 +618,15 @@ int ClientHandler::validate_next_proto() {
   return -1;
 }
 
-int ClientHandler::do_read() { return read_(*this); }
+int ClientHandler::do_read() {
+  if (accept_time_ != std::chrono::steady_clock::time_point()) {
+    record_accept_latency(worker_->get_worker_stat(),
+                          std::chrono::steady_clock::now() - accept_time_);
+    accept_time_ = std::chrono::steady_clock::time_point();
+  }
+
+  return read_(*this);
+}
 int ClientHandler::do_write() { return write_(*this); }
 
 int ClientHandler::on_read() {
@@ -660,7 +668,8 @@ void ClientHandler::pool_downstream_connection(
 
   auto &shared_addr = group->shared_addr;
 
-  if (shared_addr->affinity.type == AFFINITY_NONE) {
+  if (shared_addr->affinity.type == AFFINITY_NONE &&
+      !shared_addr->lb_enabled) {
     auto &dconn_pool = group->shared_addr->dconn_pool;
     dconn_pool.add_downstream_connection(std::move(dconn));
 
@@ -763,25 +772,38 @@ bool load_lighter(const DownstreamAddr *lhs, const DownstreamAddr *rhs) {
 } // namespace
 
 Http2Session *ClientHandler::select_http2_session(
-    const std::shared_ptr<DownstreamAddrGroup> &group) {
+    const std::shared_ptr<DownstreamAddrGroup> &group,
+    const DownstreamAddr *avoid) {
   auto &shared_addr = group->shared_addr;
 
   // First count the working backend addresses.
   size_t min = 0;
+  auto avoid_working = false;
   for (const auto &addr : shared_addr->addrs) {
     if (addr.proto != PROTO_HTTP2 || addr.connect_blocker->blocked()) {
       continue;
     }
 
+    if (&addr == avoid) {
+      avoid_working = true;
+      continue;
+    }
+
     ++min;
   }
 
   if (min == 0) {
-    if (LOG_ENABLED(INFO)) {
-      CLOG(INFO, this) << "No working backend address found";
+    if (!avoid_working) {
+      if (LOG_ENABLED(INFO)) {
+        CLOG(INFO, this) << "No working backend address found";
+      }
+
+      return nullptr;
     }
 
-    return nullptr;
+    // |avoid| is the only working address.
+    avoid = nullptr;
+    min = 1;
   }
 
   auto &http2_avail_freelist = shared_addr->http2_avail_freelist;
@@ -790,6 +812,12 @@ Http2Session *ClientHandler::select_http2_session(
     for (auto session = http2_avail_freelist.head; session;) {
       auto next = session->dlnext;
 
+      if (session->get_addr() == avoid) {
+        session = next;
+
+        continue;
+      }
+
       session->remove_from_freelist();
 
       // session may be in graceful shutdown period now.
@@ -825,7 +853,7 @@ Http2Session *ClientHandler::select_http2_session(
   DownstreamAddr *selected_addr = nullptr;
 
   for (auto &addr : shared_addr->addrs) {
-    if (addr.in_avail || addr.proto != PROTO_HTTP2 ||
+    if (&addr == avoid || addr.in_avail || addr.proto != PROTO_HTTP2 ||
         (addr.http2_extra_freelist.size() == 0 &&
          addr.connect_blocker->blocked())) {
       continue;
@@ -1003,6 +1031,11 @@ ClientHandler::get_downstream_connection(int &err, Downstream *downstream,
   auto &group = groups[group_idx];
   auto &shared_addr = group->shared_addr;
 
+  // Retries of the same request do not earn the retry budget.
+  if (downstream->get_num_retry() == 0) {
+    retry_budget_deposit(*shared_addr);
+  }
+
   if (shared_addr->affinity.type != AFFINITY_NONE) {
     uint32_t hash;
     switch (shared_addr->affinity.type) {
@@ -1122,7 +1155,19 @@ ClientHandler::get_downstream_connection(int &err, Downstream *downstream,
                        << " Create new one";
     }
 
-    auto http2session = select_http2_session(group);
+    Http2Session *http2session;
+
+    if (shared_addr->lb_enabled) {
+      auto addr =
+          select_downstream_addr(*shared_addr, PROTO_HTTP2,
+                                 downstream->get_failed_addr(),
+                                 worker_->get_randgen());
+      http2session =
+          addr ? select_http2_session_with_affinity(group, addr) : nullptr;
+    } else {
+      http2session =
+          select_http2_session(group, downstream->get_failed_addr());
+    }
 
     if (http2session == nullptr) {
       err = -1;
@@ -1136,10 +1181,57 @@ ClientHandler::get_downstream_connection(int &err, Downstream *downstream,
     return std::move(dconn);
   }
 
+  if (shared_addr->lb_enabled) {
+    auto addr =
+        select_downstream_addr(*shared_addr, PROTO_HTTP1,
+                               downstream->get_failed_addr(),
+                               worker_->get_randgen());
+    if (addr == nullptr) {
+      if (LOG_ENABLED(INFO)) {
+        CLOG(INFO, this) << "No working downstream address found";
+      }
+
+      err = -1;
+      return nullptr;
+    }
+
+    auto addr_idx = static_cast<size_t>(addr - shared_addr->addrs.data());
+
+    if (LOG_ENABLED(INFO)) {
+      CLOG(INFO, this) << "Selected DownstreamAddr=" << addr
+                       << ", index=" << addr_idx;
+    }
+
+    auto dconn = addr->dconn_pool->pop_downstream_connection();
+
+    if (!dconn) {
+      dconn = make_unique<HttpDownstreamConnection>(group, addr_idx,
+                                                    conn_.loop, worker_);
+    }
+
+    dconn->set_client_handler(this);
+
+    return dconn;
+  }
+
   auto &dconn_pool = shared_addr->dconn_pool;
+  auto failed_addr = downstream->get_failed_addr();
 
-  // pool connection must be HTTP/1.1 connection
-  auto dconn = dconn_pool.pop_downstream_connection();
+  std::unique_ptr<DownstreamConnection> dconn;
+
+  if (failed_addr && shared_addr->addrs.size() > 1) {
+    // A retry must go to another address.  The pool is shared by
+    // all addresses in the group, so bypass it, and open a new
+    // connection starting from the address next to |failed_addr|.
+    auto &addrs = shared_addr->addrs;
+    if (&addrs[shared_addr->next] == failed_addr &&
+        ++shared_addr->next >= addrs.size()) {
+      shared_addr->next = 0;
+    }
+  } else {
+    // pool connection must be HTTP/1.1 connection
+    dconn = dconn_pool.pop_downstream_connection();
+  }
 
   if (dconn) {
     if (LOG_ENABLED(INFO)) {
@@ -1523,4 +1615,9 @@ StringRef ClientHandler::get_alpn() const { return alpn_; }
 
 BlockAllocator &ClientHandler::get_block_allocator() { return balloc_; }
 
+void ClientHandler::set_accept_time(
+    const std::chrono::steady_clock::time_point &t) {
+  accept_time_ = t;
+}
+
 } // namespace shrpx
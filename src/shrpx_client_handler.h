@@ -28,6 +28,7 @@
 #include "shrpx.h"
 
 #include <memory>
+#include <chrono>
 
 #include <ev.h>
 
@@ -149,8 +150,12 @@ public:
   // header field.
   StringRef get_forwarded_for() const;
 
+  // Selects Http2Session for |group|.  The session connected to
+  // |avoid| is not selected unless it is the only working address.
+  // |avoid| may be nullptr.
   Http2Session *
-  select_http2_session(const std::shared_ptr<DownstreamAddrGroup> &group);
+  select_http2_session(const std::shared_ptr<DownstreamAddrGroup> &group,
+                       const DownstreamAddr *avoid);
 
   Http2Session *select_http2_session_with_affinity(
       const std::shared_ptr<DownstreamAddrGroup> &group, DownstreamAddr *addr);
@@ -178,6 +183,10 @@ public:
 
   BlockAllocator &get_block_allocator();
 
+  // Sets the time when this connection was accepted.  The latency
+  // until the first read event is recorded in WorkerStat.
+  void set_accept_time(const std::chrono::steady_clock::time_point &t);
+
 private:
   // Allocator to allocate memory for connection-wide objects.  Make
   // sure that the allocations must be bounded, and not proportional
@@ -203,6 +212,9 @@ private:
   // Address of frontend listening socket
   const UpstreamAddr *faddr_;
   Worker *worker_;
+  // The time when this connection was accepted.  This is reset to
+  // the epoch once the first read event is processed.
+  std::chrono::steady_clock::time_point accept_time_;
   // The number of bytes of HTTP/2 client connection header to read
   size_t left_connhd_len_;
   // hash for session affinity using client IP
@@ -499,6 +499,11 @@ LogFragmentType log_var_lookup_token(const char *name, size_t namelen) {
         return SHRPX_LOGF_BODY_BYTES_SENT;
       }
       break;
+    case 's':
+      if (util::strieq_l("backend_retrie", name, 14)) {
+        return SHRPX_LOGF_BACKEND_RETRIES;
+      }
+      break;
     }
     break;
   case 17:
@@ -812,8 +817,13 @@ struct DownstreamParams {
   StringRef sni;
   StringRef mruby;
   AffinityConfig affinity;
+  HealthCheckConfig health_check;
+  RetryConfig retry;
   size_t fall;
   size_t rise;
+  size_t eject;
+  uint32_t weight;
+  shrpx_lb_policy lb_policy;
   shrpx_proto proto;
   bool tls;
   bool dns;
@@ -876,6 +886,127 @@ int parse_downstream_params(DownstreamParams &out,
       }
 
       out.rise = n;
+    } else if (util::istarts_with_l(param, "eject=")) {
+      auto valstr = StringRef{first + str_size("eject="), end};
+      if (valstr.empty()) {
+        LOG(ERROR) << "backend: eject: non-negative integer is expected";
+        return -1;
+      }
+
+      auto n = util::parse_uint(valstr);
+      if (n == -1) {
+        LOG(ERROR) << "backend: eject: non-negative integer is expected";
+        return -1;
+      }
+
+      out.eject = n;
+    } else if (util::istarts_with_l(param, "health-check=")) {
+      auto valstr = StringRef{first + str_size("health-check="), end};
+      if (valstr.empty() || valstr[0] != '/') {
+        LOG(ERROR) << "backend: health-check: path must start with '/'";
+        return -1;
+      }
+
+      out.health_check.path = valstr;
+    } else if (util::istarts_with_l(param, "health-check-method=")) {
+      auto valstr = StringRef{first + str_size("health-check-method="), end};
+      // Health check request has no body, and must not change the
+      // state of backend.
+      switch (http2::lookup_method_token(valstr)) {
+      case HTTP_GET:
+      case HTTP_HEAD:
+      case HTTP_OPTIONS:
+        break;
+      default:
+        LOG(ERROR) << "backend: health-check-method: GET, HEAD or OPTIONS "
+                      "is expected";
+        return -1;
+      }
+
+      out.health_check.method = valstr;
+    } else if (util::istarts_with_l(param, "health-check-status=")) {
+      auto valstr = StringRef{first + str_size("health-check-status="), end};
+      auto n = util::parse_uint(valstr);
+      if (n < 200 || n > 599) {
+        LOG(ERROR)
+            << "backend: health-check-status: integer in [200, 599] is expected";
+        return -1;
+      }
+
+      out.health_check.status = n;
+    } else if (util::istarts_with_l(param, "health-check-interval=")) {
+      auto valstr = StringRef{first + str_size("health-check-interval="), end};
+      if (parse_duration(&out.health_check.interval,
+                         StringRef::from_lit("backend: health-check-interval"),
+                         valstr) != 0) {
+        return -1;
+      }
+
+      if (out.health_check.interval <= 0.) {
+        LOG(ERROR) << "backend: health-check-interval: must be positive";
+        return -1;
+      }
+    } else if (util::istarts_with_l(param, "retry=")) {
+      auto valstr = StringRef{first + str_size("retry="), end};
+      if (valstr.empty()) {
+        LOG(ERROR) << "backend: retry: non-negative integer is expected";
+        return -1;
+      }
+
+      auto n = util::parse_uint(valstr);
+      if (n == -1) {
+        LOG(ERROR) << "backend: retry: non-negative integer is expected";
+        return -1;
+      }
+
+      out.retry.max = n;
+    } else if (util::istarts_with_l(param, "retry-budget=")) {
+      auto valstr = StringRef{first + str_size("retry-budget="), end};
+      auto n = util::parse_uint(valstr);
+      if (n < 1 || n > 100) {
+        LOG(ERROR) << "backend: retry-budget: integer in [1, 100] is expected";
+        return -1;
+      }
+
+      out.retry.budget = n;
+    } else if (util::istarts_with_l(param, "retry-backoff=")) {
+      auto valstr = StringRef{first + str_size("retry-backoff="), end};
+      if (parse_duration(&out.retry.backoff,
+                         StringRef::from_lit("backend: retry-backoff"),
+                         valstr) != 0) {
+        return -1;
+      }
+    } else if (util::istarts_with_l(param, "weight=")) {
+      auto valstr = StringRef{first + str_size("weight="), end};
+      if (valstr.empty()) {
+        LOG(ERROR) << "backend: weight: integer in [1, " << LB_WEIGHT_MAX
+                   << "] is expected";
+        return -1;
+      }
+
+      auto n = util::parse_uint(valstr);
+      if (n < 1 || n > LB_WEIGHT_MAX) {
+        LOG(ERROR) << "backend: weight: integer in [1, " << LB_WEIGHT_MAX
+                   << "] is expected";
+        return -1;
+      }
+
+      out.weight = n;
+    } else if (util::istarts_with_l(param, "lb=")) {
+      auto valstr = StringRef{first + str_size("lb="), end};
+      if (util::strieq_l("round-robin", valstr)) {
+        out.lb_policy = LB_ROUND_ROBIN;
+      } else if (util::strieq_l("least-outstanding", valstr)) {
+        out.lb_policy = LB_LEAST_OUTSTANDING;
+      } else if (util::strieq_l("p2c", valstr)) {
+        out.lb_policy = LB_P2C;
+      } else if (util::strieq_l("ewma", valstr)) {
+        out.lb_policy = LB_EWMA;
+      } else {
+        LOG(ERROR) << "backend: lb: value must be one of round-robin, "
+                      "least-outstanding, p2c, and ewma";
+        return -1;
+      }
     } else if (util::strieq_l("tls", param)) {
       out.tls = true;
     } else if (util::strieq_l("no-tls", param)) {
@@ -944,6 +1075,19 @@ int parse_downstream_params(DownstreamParams &out,
 }
 } // namespace
 
+namespace {
+// Returns a copy of |src| whose strings are allocated by |balloc|.
+HealthCheckConfig make_health_check_config(BlockAllocator &balloc,
+                                           const HealthCheckConfig &src) {
+  auto hc = src;
+
+  hc.method = make_string_ref(balloc, src.method);
+  hc.path = make_string_ref(balloc, src.path);
+
+  return hc;
+}
+} // namespace
+
 namespace {
 // Parses host-path mapping patterns in |src_pattern|, and stores
 // mappings in config.  We will store each host-path pattern found in
@@ -964,6 +1108,12 @@ int parse_mapping(Config *config, DownstreamAddrConfig &addr,
 
   DownstreamParams params{};
   params.proto = PROTO_HTTP1;
+  params.weight = 1;
+  params.health_check.method = StringRef::from_lit("GET");
+  params.health_check.status = 200;
+  params.health_check.interval = 5.;
+  params.retry.budget = 20;
+  params.retry.backoff = 0.05;
 
   if (parse_downstream_params(params, src_params) != 0) {
     return -1;
@@ -983,6 +1133,8 @@ int parse_mapping(Config *config, DownstreamAddrConfig &addr,
 
   addr.fall = params.fall;
   addr.rise = params.rise;
+  addr.eject = params.eject;
+  addr.weight = params.weight;
   addr.proto = params.proto;
   addr.tls = params.tls;
   addr.sni = make_string_ref(downstreamconf.balloc, params.sni);
@@ -1047,6 +1199,50 @@ int parse_mapping(Config *config, DownstreamAddrConfig &addr,
           return -1;
         }
       }
+      // All backends in the same group must have the same lb policy.
+      // If some backend does not specify it, the one specified by the
+      // other backend is used.
+      if (params.lb_policy != LB_ROUND_ROBIN) {
+        if (g.lb_policy == LB_ROUND_ROBIN) {
+          g.lb_policy = params.lb_policy;
+        } else if (g.lb_policy != params.lb_policy) {
+          LOG(ERROR) << "backend: lb: multiple different lb policies found "
+                        "in a single group";
+          return -1;
+        }
+      }
+      // All backends in the same group must have the same health
+      // check configuration.  If some backend does not specify it,
+      // the one specified by the other backend is used.
+      if (!params.health_check.path.empty()) {
+        auto &hc = g.health_check;
+        if (hc.path.empty()) {
+          hc = make_health_check_config(downstreamconf.balloc,
+                                        params.health_check);
+        } else if (hc.path != params.health_check.path ||
+                   hc.method != params.health_check.method ||
+                   hc.status != params.health_check.status ||
+                   hc.interval != params.health_check.interval) {
+          LOG(ERROR) << "backend: health-check: multiple different health "
+                        "check configurations found in a single group";
+          return -1;
+        }
+      }
+      // All backends in the same group must have the same retry
+      // configuration.  If some backend does not specify it, the one
+      // specified by the other backend is used.
+      if (params.retry.max) {
+        auto &retry = g.retry;
+        if (retry.max == 0) {
+          retry = params.retry;
+        } else if (retry.max != params.retry.max ||
+                   retry.budget != params.retry.budget ||
+                   retry.backoff != params.retry.backoff) {
+          LOG(ERROR) << "backend: retry: multiple different retry "
+                        "configurations found in a single group";
+          return -1;
+        }
+      }
       // If at least one backend requires frontend TLS connection,
       // enable it for all backends sharing the same pattern.
       if (params.redirect_if_not_tls) {
@@ -1083,6 +1279,14 @@ int parse_mapping(Config *config, DownstreamAddrConfig &addr,
       }
       g.affinity.cookie.secure = params.affinity.cookie.secure;
     }
+    g.lb_policy = params.lb_policy;
+    if (!params.health_check.path.empty()) {
+      g.health_check =
+          make_health_check_config(downstreamconf.balloc, params.health_check);
+    }
+    if (params.retry.max) {
+      g.retry = params.retry;
+    }
     g.redirect_if_not_tls = params.redirect_if_not_tls;
     g.mruby_file = make_string_ref(downstreamconf.balloc, params.mruby);
 
@@ -1907,6 +2111,9 @@ int option_lookup_token(const char *name, size_t namelen) {
       if (util::strieq_l("dns-lookup-timeou", name, 17)) {
         return SHRPX_OPTID_DNS_LOOKUP_TIMEOUT;
       }
+      if (util::strieq_l("frontend-reusepor", name, 17)) {
+        return SHRPX_OPTID_FRONTEND_REUSEPORT;
+      }
       if (util::strieq_l("worker-write-burs", name, 17)) {
         return SHRPX_OPTID_WORKER_WRITE_BURST;
       }
@@ -1928,6 +2135,11 @@ int option_lookup_token(const char *name, size_t namelen) {
         return SHRPX_OPTID_BACKEND_MAX_BACKOFF;
       }
       break;
+    case 'h':
+      if (util::strieq_l("worker-accept-batc", name, 18)) {
+        return SHRPX_OPTID_WORKER_ACCEPT_BATCH;
+      }
+      break;
     case 'r':
       if (util::strieq_l("add-response-heade", name, 18)) {
         return SHRPX_OPTID_ADD_RESPONSE_HEADER;
@@ -2063,6 +2275,11 @@ int option_lookup_token(const char *name, size_t namelen) {
         return SHRPX_OPTID_PRIVATE_KEY_PASSWD_FILE;
       }
       break;
+    case 'f':
+      if (util::strieq_l("frontend-reuseport-cbp", name, 22)) {
+        return SHRPX_OPTID_FRONTEND_REUSEPORT_CBPF;
+      }
+      break;
     case 'r':
       if (util::strieq_l("backend-response-buffe", name, 22)) {
         return SHRPX_OPTID_BACKEND_RESPONSE_BUFFER;
@@ -3635,6 +3852,31 @@ int parse_config(Config *config, int optid, const StringRef &opt,
     config->http.early_data.strip_incoming = !util::strieq_l("yes", optarg);
 
     return 0;
+  case SHRPX_OPTID_FRONTEND_REUSEPORT:
+    config->conn.listener.reuseport = util::strieq_l("yes", optarg);
+
+    return 0;
+  case SHRPX_OPTID_FRONTEND_REUSEPORT_CBPF:
+    config->conn.listener.reuseport_cbpf = util::strieq_l("yes", optarg);
+
+    return 0;
+  case SHRPX_OPTID_WORKER_ACCEPT_BATCH: {
+    size_t n;
+
+    if (parse_uint(&n, opt, optarg) != 0) {
+      return -1;
+    }
+
+    if (n == 0) {
+      LOG(ERROR) << opt << ": specify an integer strictly more than 0";
+
+      return -1;
+    }
+
+    config->conn.upstream.worker_accept_batch = n;
+
+    return 0;
+  }
   case SHRPX_OPTID_CONF:
     LOG(WARN) << "conf: ignored";
 
@@ -3967,6 +4209,9 @@ int configure_downstream_group(Config *config, bool http2_proxy,
 
   for (auto &g : addr_groups) {
     for (auto &addr : g.addrs) {
+      if (!g.health_check.path.empty()) {
+        addr.health = std::make_shared<SharedHealthState>();
+      }
 
       if (addr.host_unix) {
         // for AF_UNIX socket, we use "localhost" as host for backend
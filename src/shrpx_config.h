@@ -43,6 +43,7 @@
 #include <vector>
 #include <memory>
 #include <set>
+#include <atomic>
 
 #include <openssl/ssl.h>
 
@@ -51,6 +52,7 @@
 #include <nghttp2/nghttp2.h>
 
 #include "shrpx_router.h"
+#include "shrpx_load_balancer.h"
 #include "template.h"
 #include "http2.h"
 #include "network.h"
@@ -63,6 +65,7 @@ namespace shrpx {
 struct LogFragment;
 class ConnectBlocker;
 class Http2Session;
+class LiveCheck;
 
 namespace tls {
 
@@ -356,6 +359,12 @@ constexpr auto SHRPX_OPT_TLS13_CLIENT_CIPHERS =
     StringRef::from_lit("tls13-client-ciphers");
 constexpr auto SHRPX_OPT_NO_STRIP_INCOMING_EARLY_DATA =
     StringRef::from_lit("no-strip-incoming-early-data");
+constexpr auto SHRPX_OPT_FRONTEND_REUSEPORT =
+    StringRef::from_lit("frontend-reuseport");
+constexpr auto SHRPX_OPT_FRONTEND_REUSEPORT_CBPF =
+    StringRef::from_lit("frontend-reuseport-cbpf");
+constexpr auto SHRPX_OPT_WORKER_ACCEPT_BATCH =
+    StringRef::from_lit("worker-accept-batch");
 
 constexpr size_t SHRPX_OBFUSCATED_NODE_LENGTH = 8;
 
@@ -452,6 +461,22 @@ struct UpstreamAddr {
   int fd;
 };
 
+// The result of active health check of a backend address.  This is
+// shared by all worker threads so that only one of them sends health
+// check requests to the address.
+struct SharedHealthState {
+  SharedHealthState() : owner{nullptr}, seq{0}, healthy{true} {}
+
+  // LiveCheck object which is responsible for sending health check
+  // requests.  nullptr if no one has taken it yet.
+  std::atomic<LiveCheck *> owner;
+  // Incremented each time a health check completes.  |healthy| must
+  // be written before this is incremented.
+  std::atomic<uint64_t> seq;
+  // true if the address is considered healthy.
+  std::atomic<bool> healthy;
+};
+
 struct DownstreamAddrConfig {
   // Resolved address if |dns| is false
   Address addr;
@@ -465,6 +490,14 @@ struct DownstreamAddrConfig {
   StringRef sni;
   size_t fall;
   size_t rise;
+  // The number of consecutive 5xx responses or timeouts after which
+  // this address is considered offline.  0 disables it.
+  size_t eject;
+  // The result of active health check.  nullptr if active health
+  // check is disabled.
+  std::shared_ptr<SharedHealthState> health;
+  // Load balancing weight of this address.
+  uint32_t weight;
   // Application protocol used in this group
   shrpx_proto proto;
   // backend port.  0 if |host_unix| is true.
@@ -489,9 +522,36 @@ struct AffinityHash {
   uint32_t hash;
 };
 
+struct HealthCheckConfig {
+  // Request method and path of health check request.  If |path| is
+  // empty, active health check is disabled.
+  StringRef method;
+  StringRef path;
+  // The status code which a healthy backend responds with.
+  unsigned int status;
+  // Interval between health check requests.
+  ev_tstamp interval;
+};
+
+struct RetryConfig {
+  // The maximum number of times a request is sent again to a backend
+  // after the previous attempt failed.  0 disables retry.
+  size_t max;
+  // The percentage of requests to this group which can be retried.
+  unsigned int budget;
+  // The base delay before a request is retried.  It is doubled for
+  // each retry of the same request.
+  ev_tstamp backoff;
+};
+
 struct DownstreamAddrGroupConfig {
   DownstreamAddrGroupConfig(const StringRef &pattern)
-      : pattern(pattern), affinity{AFFINITY_NONE}, redirect_if_not_tls(false) {}
+      : pattern(pattern),
+        health_check{},
+        retry{},
+        affinity{AFFINITY_NONE},
+        lb_policy(LB_ROUND_ROBIN),
+        redirect_if_not_tls(false) {}
 
   StringRef pattern;
   StringRef mruby_file;
@@ -499,8 +559,15 @@ struct DownstreamAddrGroupConfig {
   // Bunch of session affinity hash.  Only used if affinity ==
   // AFFINITY_IP.
   std::vector<AffinityHash> affinity_hash;
+  // Active health check configuration.
+  HealthCheckConfig health_check;
+  // Request retry configuration.
+  RetryConfig retry;
   // Cookie based session affinity configuration.
   AffinityConfig affinity;
+  // Load balancing policy.  This is ignored if session affinity is
+  // enabled.
+  shrpx_lb_policy lb_policy;
   // true if this group requires that client connection must be TLS,
   // and the request must be redirected to https URI.
   bool redirect_if_not_tls;
@@ -876,6 +943,13 @@ struct ConnectionConfig {
     // TCP fastopen.  If this is positive, it is passed to
     // setsockopt() along with TCP_FASTOPEN.
     int fastopen;
+    // true if each worker thread accepts connections from its own
+    // listening socket bound with SO_REUSEPORT.
+    bool reuseport;
+    // true if classic BPF program is attached to SO_REUSEPORT group
+    // to select a worker thread by the CPU which received the
+    // connection.
+    bool reuseport_cbpf;
   } listener;
 
   struct {
@@ -890,6 +964,9 @@ struct ConnectionConfig {
       RateLimitConfig write;
     } ratelimit;
     size_t worker_connections;
+    // The maximum number of new connections a worker takes from its
+    // connection queue in one event loop iteration.
+    size_t worker_accept_batch;
     // Deprecated.  See UpstreamAddr.accept_proxy_protocol.
     bool accept_proxy_protocol;
   } upstream;
@@ -1081,6 +1158,8 @@ enum {
   SHRPX_OPTID_FRONTEND_MAX_REQUESTS,
   SHRPX_OPTID_FRONTEND_NO_TLS,
   SHRPX_OPTID_FRONTEND_READ_TIMEOUT,
+  SHRPX_OPTID_FRONTEND_REUSEPORT,
+  SHRPX_OPTID_FRONTEND_REUSEPORT_CBPF,
   SHRPX_OPTID_FRONTEND_WRITE_TIMEOUT,
   SHRPX_OPTID_HEADER_FIELD_BUFFER,
   SHRPX_OPTID_HOST_REWRITE,
@@ -1161,6 +1240,7 @@ enum {
   SHRPX_OPTID_VERIFY_CLIENT,
   SHRPX_OPTID_VERIFY_CLIENT_CACERT,
   SHRPX_OPTID_VERIFY_CLIENT_TOLERATE_EXPIRED,
+  SHRPX_OPTID_WORKER_ACCEPT_BATCH,
   SHRPX_OPTID_WORKER_FRONTEND_CONNECTIONS,
   SHRPX_OPTID_WORKER_READ_BURST,
   SHRPX_OPTID_WORKER_READ_RATE,
@@ -29,6 +29,8 @@
 #endif // HAVE_UNISTD_H
 
 #include <cstdlib>
+#include <set>
+#include <map>
 
 #include <CUnit/CUnit.h>
 
@@ -246,4 +248,198 @@ void test_shrpx_config_read_tls_ticket_key_file_aes_256(void) {
                        "a..............................b"));
 }
 
+namespace {
+// Parses |optargs| as the values of backend option in order.  It
+// returns the result of the last parse_config() call, or -1 if the
+// other call fails.
+int parse_backends(Config &config,
+                   std::initializer_list<StringRef> optargs) {
+  std::set<StringRef> included_set;
+  std::map<StringRef, size_t> pattern_addr_indexer;
+
+  config.conn.downstream = std::make_shared<DownstreamConfig>();
+
+  auto rv = 0;
+  for (auto &optarg : optargs) {
+    if (rv != 0) {
+      return -1;
+    }
+    rv = parse_config(&config, SHRPX_OPT_BACKEND, optarg, included_set,
+                      pattern_addr_indexer);
+  }
+
+  return rv;
+}
+} // namespace
+
+void test_shrpx_config_parse_backend_retry(void) {
+  Config config;
+
+  CU_ASSERT(0 == parse_backends(config, {StringRef::from_lit(
+                                            "127.0.0.1,3000;;retry=2")}));
+  {
+    auto &retry = config.conn.downstream->addr_groups[0].retry;
+    CU_ASSERT(2 == retry.max);
+    CU_ASSERT(20 == retry.budget);
+    CU_ASSERT(0.05 == retry.backoff);
+  }
+
+  CU_ASSERT(0 == parse_backends(config,
+                                {StringRef::from_lit(
+                                    "127.0.0.1,3000;;retry=3;retry-budget=50;"
+                                    "retry-backoff=100ms")}));
+  {
+    auto &retry = config.conn.downstream->addr_groups[0].retry;
+    CU_ASSERT(3 == retry.max);
+    CU_ASSERT(50 == retry.budget);
+    CU_ASSERT(0.1 == retry.backoff);
+  }
+
+  // Retry is disabled by default.
+  CU_ASSERT(0 == parse_backends(config,
+                                {StringRef::from_lit("127.0.0.1,3000;;")}));
+  CU_ASSERT(0 == config.conn.downstream->addr_groups[0].retry.max);
+
+  CU_ASSERT(-1 == parse_backends(config, {StringRef::from_lit(
+                                             "127.0.0.1,3000;;retry=")}));
+  CU_ASSERT(-1 == parse_backends(config, {StringRef::from_lit(
+                                             "127.0.0.1,3000;;retry=a")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config, {StringRef::from_lit(
+                                       "127.0.0.1,3000;;retry-budget=0")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config, {StringRef::from_lit(
+                                       "127.0.0.1,3000;;retry-budget=101")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config, {StringRef::from_lit(
+                                       "127.0.0.1,3000;;retry-backoff=a")}));
+
+  // The backend without retry parameter shares the one specified by
+  // the other backend in the same group.
+  CU_ASSERT(0 == parse_backends(
+                     config, {StringRef::from_lit("127.0.0.1,3000;;retry=2"),
+                              StringRef::from_lit("127.0.0.1,3001;;")}));
+  CU_ASSERT(2 == config.conn.downstream->addr_groups[0].retry.max);
+
+  CU_ASSERT(-1 == parse_backends(
+                      config, {StringRef::from_lit("127.0.0.1,3000;;retry=2"),
+                               StringRef::from_lit("127.0.0.1,3001;;retry=3")}));
+  CU_ASSERT(-1 ==
+            parse_backends(
+                config,
+                {StringRef::from_lit("127.0.0.1,3000;;retry=2"),
+                 StringRef::from_lit("127.0.0.1,3001;;retry=2;retry-budget=50")}));
+}
+
+void test_shrpx_config_parse_backend_health_check(void) {
+  Config config;
+
+  CU_ASSERT(0 ==
+            parse_backends(config, {StringRef::from_lit(
+                                       "127.0.0.1,3000;;health-check=/alive")}));
+  {
+    auto &hc = config.conn.downstream->addr_groups[0].health_check;
+    CU_ASSERT("/alive" == hc.path);
+    CU_ASSERT("GET" == hc.method);
+    CU_ASSERT(200 == hc.status);
+    CU_ASSERT(5. == hc.interval);
+  }
+
+  CU_ASSERT(0 == parse_backends(
+                     config, {StringRef::from_lit(
+                                 "127.0.0.1,3000;;health-check=/;"
+                                 "health-check-method=HEAD;health-check-status="
+                                 "204;health-check-interval=500ms")}));
+  {
+    auto &hc = config.conn.downstream->addr_groups[0].health_check;
+    CU_ASSERT("/" == hc.path);
+    CU_ASSERT("HEAD" == hc.method);
+    CU_ASSERT(204 == hc.status);
+    CU_ASSERT(0.5 == hc.interval);
+  }
+
+  CU_ASSERT(0 == parse_backends(config, {StringRef::from_lit(
+                                            "127.0.0.1,3000;;health-check=/;"
+                                            "health-check-method=OPTIONS")}));
+  CU_ASSERT("OPTIONS" ==
+            config.conn.downstream->addr_groups[0].health_check.method);
+
+  // Health check is disabled by default.
+  CU_ASSERT(0 == parse_backends(config,
+                                {StringRef::from_lit("127.0.0.1,3000;;")}));
+  CU_ASSERT(config.conn.downstream->addr_groups[0].health_check.path.empty());
+
+  CU_ASSERT(-1 == parse_backends(config, {StringRef::from_lit(
+                                             "127.0.0.1,3000;;health-check=")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config, {StringRef::from_lit(
+                                       "127.0.0.1,3000;;health-check=alive")}));
+  // The method must be safe, and must not have request body.
+  for (auto &method : {"CONNECT", "POST", "PUT", "DELETE", "get", "FOO", ""}) {
+    auto optarg =
+        std::string("127.0.0.1,3000;;health-check=/;health-check-method=") +
+        method;
+    CU_ASSERT(-1 == parse_backends(config, {StringRef{optarg}}));
+  }
+  CU_ASSERT(-1 == parse_backends(config,
+                                 {StringRef::from_lit(
+                                     "127.0.0.1,3000;;health-check-status=199")}));
+  CU_ASSERT(-1 == parse_backends(config,
+                                 {StringRef::from_lit(
+                                     "127.0.0.1,3000;;health-check-status=600")}));
+  CU_ASSERT(-1 == parse_backends(config,
+                                 {StringRef::from_lit(
+                                     "127.0.0.1,3000;;health-check-interval=0")}));
+  CU_ASSERT(-1 == parse_backends(config,
+                                 {StringRef::from_lit(
+                                     "127.0.0.1,3000;;health-check-interval=a")}));
+
+  // The backend without health-check parameter shares the one
+  // specified by the other backend in the same group.
+  CU_ASSERT(0 ==
+            parse_backends(config,
+                           {StringRef::from_lit("127.0.0.1,3000;;"),
+                            StringRef::from_lit("127.0.0.1,3001;;health-check=/"),
+                            StringRef::from_lit("127.0.0.1,3002;;")}));
+  CU_ASSERT("/" == config.conn.downstream->addr_groups[0].health_check.path);
+
+  CU_ASSERT(-1 == parse_backends(
+                      config,
+                      {StringRef::from_lit("127.0.0.1,3000;;health-check=/"),
+                       StringRef::from_lit("127.0.0.1,3001;;health-check=/a")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config,
+                           {StringRef::from_lit("127.0.0.1,3000;;health-check=/"),
+                            StringRef::from_lit("127.0.0.1,3001;;health-check=/;"
+                                                "health-check-method=HEAD")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config,
+                           {StringRef::from_lit("127.0.0.1,3000;;health-check=/"),
+                            StringRef::from_lit("127.0.0.1,3001;;health-check=/;"
+                                                "health-check-status=204")}));
+  CU_ASSERT(-1 ==
+            parse_backends(config,
+                           {StringRef::from_lit("127.0.0.1,3000;;health-check=/"),
+                            StringRef::from_lit("127.0.0.1,3001;;health-check=/;"
+                                                "health-check-interval=1s")}));
+}
+
+void test_shrpx_config_parse_backend_eject(void) {
+  Config config;
+
+  CU_ASSERT(0 == parse_backends(config, {StringRef::from_lit(
+                                            "127.0.0.1,3000;;eject=3")}));
+  CU_ASSERT(3 == config.conn.downstream->addr_groups[0].addrs[0].eject);
+
+  // Ejection is disabled by default.
+  CU_ASSERT(0 == parse_backends(config,
+                                {StringRef::from_lit("127.0.0.1,3000;;")}));
+  CU_ASSERT(0 == config.conn.downstream->addr_groups[0].addrs[0].eject);
+
+  CU_ASSERT(-1 == parse_backends(config, {StringRef::from_lit(
+                                             "127.0.0.1,3000;;eject=")}));
+  CU_ASSERT(-1 == parse_backends(config, {StringRef::from_lit(
+                                             "127.0.0.1,3000;;eject=-1")}));
+}
+
 } // namespace shrpx
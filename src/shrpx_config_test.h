@@ -36,6 +36,9 @@ void test_shrpx_config_parse_log_format(void);
 void test_shrpx_config_read_tls_ticket_key_file(void);
 void test_shrpx_config_read_tls_ticket_key_file_aes_256(void);
 void test_shrpx_config_match_downstream_addr_group(void);
+void test_shrpx_config_parse_backend_retry(void);
+void test_shrpx_config_parse_backend_health_check(void);
+void test_shrpx_config_parse_backend_eject(void);
 
 } // namespace shrpx
 
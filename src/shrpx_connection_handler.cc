@@ -29,6 +29,13 @@
 #endif // HAVE_UNISTD_H
 #include <sys/types.h>
 #include <sys/wait.h>
+#ifdef HAVE_NETINET_IN_H
+#  include <netinet/in.h>
+#endif // HAVE_NETINET_IN_H
+#include <netinet/tcp.h>
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+#  include <linux/filter.h>
+#endif // SO_ATTACH_REUSEPORT_CBPF
 
 #include <cerrno>
 #include <thread>
@@ -47,6 +54,7 @@
 #include "shrpx_log.h"
 #include "util.h"
 #include "template.h"
+#include "xsi_strerror.h"
 
 using namespace nghttp2;
 
@@ -122,7 +130,8 @@ ConnectionHandler::ConnectionHandler(struct ev_loop *loop, std::mt19937 &gen)
       tls_ticket_key_memcached_fail_count_(0),
       worker_round_robin_cnt_(get_config()->api.enabled ? 1 : 0),
       graceful_shutdown_(false),
-      enable_acceptor_on_ocsp_completion_(false) {
+      enable_acceptor_on_ocsp_completion_(false),
+      worker_acceptor_(false) {
   ev_timer_init(&disable_acceptor_timer_, acceptor_disable_cb, 0., 0.);
   disable_acceptor_timer_.data = this;
 
@@ -314,7 +323,17 @@ int ConnectionHandler::create_worker_thread(size_t num) {
     LLOG(NOTICE, this) << "Created worker thread #" << workers_.size() - 1;
   }
 
+  if (config->conn.listener.reuseport) {
+    create_worker_acceptor();
+  }
+
   for (auto &worker : workers_) {
+    // Worker threads have not started yet, so it is safe to touch
+    // their acceptors here.
+    if (enable_acceptor_on_ocsp_completion_) {
+      worker->disable_acceptor();
+    }
+
     worker->run_async();
   }
 
@@ -323,6 +342,216 @@ int ConnectionHandler::create_worker_thread(size_t num) {
   return 0;
 }
 
+namespace {
+// Creates a listening socket which is bound to the same address as
+// |faddr|.  The socket joins SO_REUSEPORT group of faddr.fd.  This
+// function returns the file descriptor if it succeeds, or -1.
+int create_reuseport_socket(const UpstreamAddr &faddr) {
+#ifdef SO_REUSEPORT
+  std::array<char, STRERROR_BUFSIZE> errbuf;
+  auto &listenerconf = get_config()->conn.listener;
+
+  sockaddr_union su;
+  socklen_t salen = sizeof(su);
+
+  if (getsockname(faddr.fd, &su.sa, &salen) != 0) {
+    auto error = errno;
+    LOG(WARN) << "getsockname() syscall failed (fd=" << faddr.fd
+              << "): " << xsi_strerror(error, errbuf.data(), errbuf.size());
+    return -1;
+  }
+
+  auto fd = util::create_nonblock_socket(su.storage.ss_family);
+  if (fd == -1) {
+    auto error = errno;
+    LOG(WARN) << "socket() syscall failed: "
+              << xsi_strerror(error, errbuf.data(), errbuf.size());
+    return -1;
+  }
+
+  int val = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &val,
+                 static_cast<socklen_t>(sizeof(val))) == -1 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val,
+                 static_cast<socklen_t>(sizeof(val))) == -1) {
+    auto error = errno;
+    LOG(WARN) << "Failed to set SO_REUSEADDR or SO_REUSEPORT option to "
+                 "listener socket: "
+              << xsi_strerror(error, errbuf.data(), errbuf.size());
+    close(fd);
+    return -1;
+  }
+
+#  ifdef IPV6_V6ONLY
+  if (su.storage.ss_family == AF_INET6) {
+    if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &val,
+                   static_cast<socklen_t>(sizeof(val))) == -1) {
+      auto error = errno;
+      LOG(WARN) << "Failed to set IPV6_V6ONLY option to listener socket: "
+                << xsi_strerror(error, errbuf.data(), errbuf.size());
+      close(fd);
+      return -1;
+    }
+  }
+#  endif // IPV6_V6ONLY
+
+#  ifdef TCP_DEFER_ACCEPT
+  val = 3;
+  if (setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &val,
+                 static_cast<socklen_t>(sizeof(val))) == -1) {
+    auto error = errno;
+    LOG(WARN) << "Failed to set TCP_DEFER_ACCEPT option to listener socket: "
+              << xsi_strerror(error, errbuf.data(), errbuf.size());
+  }
+#  endif // TCP_DEFER_ACCEPT
+
+  if (bind(fd, &su.sa, salen) == -1) {
+    auto error = errno;
+    LOG(WARN) << "bind() syscall failed: "
+              << xsi_strerror(error, errbuf.data(), errbuf.size());
+    close(fd);
+    return -1;
+  }
+
+#  ifdef TCP_FASTOPEN
+  if (listenerconf.fastopen > 0) {
+    val = listenerconf.fastopen;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &val,
+                   static_cast<socklen_t>(sizeof(val))) == -1) {
+      auto error = errno;
+      LOG(WARN) << "Failed to set TCP_FASTOPEN option to listener socket: "
+                << xsi_strerror(error, errbuf.data(), errbuf.size());
+    }
+  }
+#  endif // TCP_FASTOPEN
+
+  if (listen(fd, listenerconf.backlog) == -1) {
+    auto error = errno;
+    LOG(WARN) << "listen() syscall failed: "
+              << xsi_strerror(error, errbuf.data(), errbuf.size());
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+#else  // !SO_REUSEPORT
+  return -1;
+#endif // !SO_REUSEPORT
+}
+} // namespace
+
+namespace {
+// Attaches classic BPF program to SO_REUSEPORT group which |fd|
+// belongs to.  The program selects the socket by the CPU which
+// received the packet.  The kernel indexes the sockets in a group in
+// the order they start listening.  The socket created by the master
+// process has index 0, and the |n| sockets created for worker
+// threads follow it.  The program returns (cpu % n) + 1, so that the
+// master socket is only used as a fallback.
+//
+// The order above only holds for a freshly started process.  After
+// reload (SIGHUP) or binary upgrade (SIGUSR2), the master socket is
+// inherited, and the sockets of the old worker process are still in
+// the group.  When a socket leaves the group, the kernel moves the
+// last socket into its slot, so that the mapping from CPU to worker
+// thread is shuffled once the old process exits.  We cannot reorder
+// the group from user space, so the steering is best-effort after
+// reload.  It never drops connections: if the returned index is out
+// of range, the kernel falls back to the hash based selection.
+int attach_reuseport_cbpf(int fd, size_t n) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+  std::array<char, STRERROR_BUFSIZE> errbuf;
+
+  sock_filter code[] = {
+      // A = CPU number
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0,
+       static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      // A = A % n
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(n)},
+      // A = A + 1
+      {BPF_ALU | BPF_ADD | BPF_K, 0, 0, 1},
+      // return A
+      {BPF_RET | BPF_A, 0, 0, 0},
+  };
+
+  sock_fprog prog{};
+  prog.len = array_size(code);
+  prog.filter = code;
+
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                 static_cast<socklen_t>(sizeof(prog))) == -1) {
+    auto error = errno;
+    LOG(WARN) << "Failed to set SO_ATTACH_REUSEPORT_CBPF option to listener "
+                 "socket: "
+              << xsi_strerror(error, errbuf.data(), errbuf.size());
+    return -1;
+  }
+
+  return 0;
+#else  // !SO_ATTACH_REUSEPORT_CBPF
+  LOG(WARN) << "SO_ATTACH_REUSEPORT_CBPF is not supported on this platform";
+
+  return -1;
+#endif // !SO_ATTACH_REUSEPORT_CBPF
+}
+} // namespace
+
+void ConnectionHandler::create_worker_acceptor() {
+  auto config = get_config();
+  auto &listenerconf = config->conn.listener;
+
+  // Worker #0 is dedicated to API request if API is enabled.
+  size_t first = config->api.enabled ? 1 : 0;
+  auto nworker = workers_.size() - first;
+
+  for (auto &addr : listenerconf.addrs) {
+    // API requests are always processed by worker #0, and UNIX
+    // domain socket does not support SO_REUSEPORT.
+    if (addr.host_unix || addr.alt_mode == ALTMODE_API) {
+      continue;
+    }
+
+    std::vector<int> fds;
+    fds.reserve(nworker);
+
+    for (size_t i = 0; i < nworker; ++i) {
+      auto fd = create_reuseport_socket(addr);
+      if (fd == -1) {
+        break;
+      }
+
+      fds.push_back(fd);
+    }
+
+    if (fds.size() != nworker) {
+      LOG(WARN) << "Could not create per-worker listening socket for "
+                << addr.hostport
+                << "; connections are accepted by the main thread";
+
+      for (auto fd : fds) {
+        close(fd);
+      }
+
+      continue;
+    }
+
+    if (listenerconf.reuseport_cbpf) {
+      // The program is shared by all sockets in the group.
+      (void)attach_reuseport_cbpf(fds.back(), nworker);
+    }
+
+    for (size_t i = 0; i < nworker; ++i) {
+      auto worker = workers_[first + i].get();
+      worker->add_acceptor(make_unique<AcceptHandler>(&addr, fds[i], worker));
+    }
+
+    worker_acceptor_ = true;
+
+    LOG(NOTICE) << "Listening on " << addr.hostport << " in " << nworker
+                << " worker threads with SO_REUSEPORT";
+  }
+}
+
 void ConnectionHandler::join_worker() {
 #ifndef NOTHREADS
   int n = 0;
@@ -370,8 +599,9 @@ void ConnectionHandler::graceful_shutdown_worker() {
 #endif // NOTHREADS
 }
 
-int ConnectionHandler::handle_connection(int fd, sockaddr *addr, int addrlen,
-                                         const UpstreamAddr *faddr) {
+int ConnectionHandler::handle_connection(
+    int fd, sockaddr *addr, int addrlen, const UpstreamAddr *faddr,
+    const std::chrono::steady_clock::time_point &accept_time) {
   if (LOG_ENABLED(INFO)) {
     LLOG(INFO, this) << "Accepted connection from "
                      << util::numeric_name(addr, addrlen) << ", fd=" << fd;
@@ -380,29 +610,8 @@ int ConnectionHandler::handle_connection(int fd, sockaddr *addr, int addrlen,
   auto config = get_config();
 
   if (single_worker_) {
-    auto &upstreamconf = config->conn.upstream;
-    if (single_worker_->get_worker_stat()->num_connections >=
-        upstreamconf.worker_connections) {
-
-      if (LOG_ENABLED(INFO)) {
-        LLOG(INFO, this) << "Too many connections >="
-                         << upstreamconf.worker_connections;
-      }
-
-      close(fd);
-      return -1;
-    }
-
-    auto client =
-        tls::accept_connection(single_worker_.get(), fd, addr, addrlen, faddr);
-    if (!client) {
-      LLOG(ERROR, this) << "ClientHandler creation failed";
-
-      close(fd);
-      return -1;
-    }
-
-    return 0;
+    return single_worker_->handle_connection(fd, addr, addrlen, faddr,
+                                             accept_time);
   }
 
   Worker *worker;
@@ -431,15 +640,48 @@ int ConnectionHandler::handle_connection(int fd, sockaddr *addr, int addrlen,
     }
   }
 
+  ConnectionEvent cev;
+  cev.client_fd = fd;
+  memcpy(&cev.client_addr, addr, addrlen);
+  cev.client_addrlen = addrlen;
+  cev.faddr = faddr;
+  cev.accept_time = accept_time;
+
+  if (worker->send_connection(cev)) {
+    return 0;
+  }
+
+  // The connection queue of the selected worker is full.  Try the
+  // other workers, except for the one dedicated to API request.
+  if (faddr->alt_mode != ALTMODE_API) {
+    size_t first = config->api.enabled ? 1 : 0;
+
+    for (size_t i = first; i < workers_.size(); ++i) {
+      auto w = workers_[i].get();
+      if (w != worker && w->send_connection(cev)) {
+        return 0;
+      }
+    }
+  }
+
+  // All workers are overloaded.  Do not drop this connection, but
+  // stop accepting new connections for a while so that workers can
+  // catch up.
+  LLOG(WARN, this) << "Connection queue of all workers is full; disable "
+                      "acceptor temporarily";
+
   WorkerEvent wev{};
   wev.type = NEW_CONNECTION;
   wev.client_fd = fd;
   memcpy(&wev.client_addr, addr, addrlen);
   wev.client_addrlen = addrlen;
   wev.faddr = faddr;
+  wev.accept_time = accept_time;
 
   worker->send(wev);
 
+  sleep_acceptor(10_ms);
+
   return 0;
 }
 
@@ -451,6 +693,22 @@ Worker *ConnectionHandler::get_single_worker() const {
   return single_worker_.get();
 }
 
+std::vector<const WorkerStat *> ConnectionHandler::get_worker_stats() const {
+  std::vector<const WorkerStat *> stats;
+
+  if (single_worker_) {
+    stats.push_back(single_worker_->get_worker_stat());
+
+    return stats;
+  }
+
+  for (auto &worker : workers_) {
+    stats.push_back(worker->get_worker_stat());
+  }
+
+  return stats;
+}
+
 void ConnectionHandler::add_acceptor(std::unique_ptr<AcceptHandler> h) {
   acceptors_.push_back(std::move(h));
 }
@@ -461,12 +719,30 @@ void ConnectionHandler::enable_acceptor() {
   for (auto &a : acceptors_) {
     a->enable();
   }
+
+  if (worker_acceptor_) {
+    WorkerEvent wev{};
+    wev.type = ENABLE_ACCEPTOR;
+
+    for (auto &worker : workers_) {
+      worker->send(wev);
+    }
+  }
 }
 
 void ConnectionHandler::disable_acceptor() {
   for (auto &a : acceptors_) {
     a->disable();
   }
+
+  if (worker_acceptor_) {
+    WorkerEvent wev{};
+    wev.type = DISABLE_ACCEPTOR;
+
+    for (auto &worker : workers_) {
+      worker->send(wev);
+    }
+  }
 }
 
 void ConnectionHandler::sleep_acceptor(ev_tstamp t) {
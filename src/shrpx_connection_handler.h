@@ -36,6 +36,7 @@
 #include <memory>
 #include <vector>
 #include <random>
+#include <chrono>
 #ifndef NOTHREADS
 #  include <future>
 #endif // NOTHREADS
@@ -102,8 +103,11 @@ class ConnectionHandler {
 public:
   ConnectionHandler(struct ev_loop *loop, std::mt19937 &gen);
   ~ConnectionHandler();
-  int handle_connection(int fd, sockaddr *addr, int addrlen,
-                        const UpstreamAddr *faddr);
+  // Dispatches the accepted connection |fd| to a worker.
+  // |accept_time| is the time when |fd| was accepted.
+  int handle_connection(
+      int fd, sockaddr *addr, int addrlen, const UpstreamAddr *faddr,
+      const std::chrono::steady_clock::time_point &accept_time);
   // Creates Worker object for single threaded configuration.
   int create_single_worker();
   // Creates |num| Worker objects for multi threaded configuration.
@@ -116,6 +120,10 @@ public:
   const std::shared_ptr<TicketKeys> &get_ticket_keys() const;
   struct ev_loop *get_loop() const;
   Worker *get_single_worker() const;
+  // Returns WorkerStat of all workers.  In multi threaded mode, only
+  // the fields which are safe to read from the other threads can be
+  // used.
+  std::vector<const WorkerStat *> get_worker_stats() const;
   void add_acceptor(std::unique_ptr<AcceptHandler> h);
   void delete_acceptor();
   void enable_acceptor();
@@ -177,6 +185,12 @@ public:
   void set_enable_acceptor_on_ocsp_completion(bool f);
 
 private:
+  // Creates SO_REUSEPORT listening sockets for each worker thread so
+  // that they accept connections in their own event loop.  If a
+  // socket cannot be created for a frontend address, connections to
+  // it are accepted by the main thread as usual.
+  void create_worker_acceptor();
+
   // Stores all SSL_CTX objects.
   std::vector<SSL_CTX *> all_ssl_ctx_;
   // Stores all SSL_CTX objects in a way that its index is stored in
@@ -225,6 +239,8 @@ private:
   // true if acceptors should be enabled after the initial ocsp update
   // has finished.
   bool enable_acceptor_on_ocsp_completion_;
+  // true if at least one worker thread has its own acceptors.
+  bool worker_acceptor_;
 };
 
 } // namespace shrpx
@@ -111,6 +111,66 @@ void downstream_wtimeoutcb(struct ev_loop *loop, ev_timer *w, int revents) {
 }
 } // namespace
 
+namespace {
+void retry_timeoutcb(struct ev_loop *loop, ev_timer *w, int revents) {
+  auto downstream = static_cast<Downstream *>(w->data);
+  auto upstream = downstream->get_upstream();
+
+  if (LOG_ENABLED(INFO)) {
+    DLOG(INFO, downstream) << "Retrying request; retry="
+                           << downstream->get_request_retries();
+  }
+
+  // Failure is allowed only for HTTP/1 upstream where upstream is not
+  // shared by multiple Downstreams.
+  if (upstream->on_downstream_reset(downstream, false) != 0) {
+    delete upstream->get_client_handler();
+  }
+}
+} // namespace
+
+namespace {
+// The maximum size of request body which is kept to retry the
+// request.
+constexpr size_t RETRY_REQUEST_BODY_MAX = 16_k;
+} // namespace
+
+namespace {
+// Returns SharedDownstreamAddr of the backend group which |dconn|
+// belongs to if request retry is enabled for the group.  Otherwise,
+// returns nullptr.
+SharedDownstreamAddr *get_retry_shared_addr(DownstreamConnection *dconn) {
+  if (!dconn) {
+    return nullptr;
+  }
+
+  const auto &group = dconn->get_downstream_addr_group();
+  if (!group || group->shared_addr->retry.max == 0) {
+    return nullptr;
+  }
+
+  return group->shared_addr.get();
+}
+} // namespace
+
+namespace {
+// Returns true if the request with |method| may be sent again to
+// another backend.
+bool method_retriable(int method) {
+  switch (method) {
+  case HTTP_GET:
+  case HTTP_HEAD:
+  case HTTP_OPTIONS:
+  case HTTP_TRACE:
+  case HTTP_PUT:
+  case HTTP_DELETE:
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace
+
 // upstream could be nullptr for unittests
 Downstream::Downstream(Upstream *upstream, MemchunkPool *mcpool,
                        int32_t stream_id)
@@ -124,10 +184,14 @@ Downstream::Downstream(Upstream *upstream, MemchunkPool *mcpool,
       blocked_request_buf_(mcpool),
       request_buf_(mcpool),
       response_buf_(mcpool),
+      retry_request_buf_(mcpool),
       upstream_(upstream),
       blocked_link_(nullptr),
       addr_(nullptr),
+      lb_addr_(nullptr),
+      failed_addr_(nullptr),
       num_retry_(0),
+      num_request_retries_(0),
       stream_id_(stream_id),
       assoc_stream_id_(-1),
       downstream_stream_id_(-1),
@@ -144,7 +208,8 @@ Downstream::Downstream(Upstream *upstream, MemchunkPool *mcpool,
       request_header_sent_(false),
       accesslog_written_(false),
       new_affinity_cookie_(false),
-      blocked_request_data_eof_(false) {
+      blocked_request_data_eof_(false),
+      retry_request_buf_incomplete_(false) {
 
   auto &timeoutconf = get_config()->http2.timeout;
 
@@ -156,11 +221,13 @@ Downstream::Downstream(Upstream *upstream, MemchunkPool *mcpool,
                 timeoutconf.stream_read);
   ev_timer_init(&downstream_wtimer_, &downstream_wtimeoutcb, 0.,
                 timeoutconf.stream_write);
+  ev_timer_init(&retry_timer_, &retry_timeoutcb, 0., 0.);
 
   upstream_rtimer_.data = this;
   upstream_wtimer_.data = this;
   downstream_rtimer_.data = this;
   downstream_wtimer_.data = this;
+  retry_timer_.data = this;
 
   rcbufs_.reserve(32);
 }
@@ -178,6 +245,7 @@ Downstream::~Downstream() {
     ev_timer_stop(loop, &upstream_wtimer_);
     ev_timer_stop(loop, &downstream_rtimer_);
     ev_timer_stop(loop, &downstream_wtimer_);
+    ev_timer_stop(loop, &retry_timer_);
 
 #ifdef HAVE_MRUBY
     auto handler = upstream_->get_client_handler();
@@ -198,6 +266,8 @@ Downstream::~Downstream() {
   }
 #endif // HAVE_MRUBY
 
+  lb_release();
+
   // DownstreamConnection may refer to this object.  Delete it now
   // explicitly.
   dconn_.reset();
@@ -219,14 +289,53 @@ int Downstream::attach_downstream_connection(
 
   dconn_ = std::move(dconn);
 
+  lb_acquire();
+
   return 0;
 }
 
+void Downstream::lb_acquire() {
+  lb_release();
+
+  lb_addr_ = dconn_->get_addr();
+  if (!lb_addr_) {
+    return;
+  }
+
+  ++lb_addr_->lb.num_outstanding;
+  lb_start_time_ = std::chrono::steady_clock::now();
+}
+
+void Downstream::lb_release() {
+  if (!lb_addr_) {
+    return;
+  }
+
+  --lb_addr_->lb.num_outstanding;
+  lb_addr_ = nullptr;
+}
+
+void Downstream::record_backend_latency() {
+  if (!lb_addr_ ||
+      lb_start_time_ == std::chrono::steady_clock::time_point()) {
+    return;
+  }
+
+  auto d = std::chrono::steady_clock::now() - lb_start_time_;
+
+  lb_update_latency(lb_addr_->lb,
+                    std::chrono::duration<double>(d).count());
+
+  lb_start_time_ = std::chrono::steady_clock::time_point();
+}
+
 void Downstream::detach_downstream_connection() {
   if (!dconn_) {
     return;
   }
 
+  lb_release();
+
 #ifdef HAVE_MRUBY
   const auto &group = dconn_->get_downstream_addr_group();
   if (group) {
@@ -248,6 +357,8 @@ DownstreamConnection *Downstream::get_downstream_connection() {
 }
 
 std::unique_ptr<DownstreamConnection> Downstream::pop_downstream_connection() {
+  lb_release();
+
 #ifdef HAVE_MRUBY
   if (!dconn_) {
     return nullptr;
@@ -638,6 +749,20 @@ int Downstream::push_request_headers() {
 int Downstream::push_upload_data_chunk(const uint8_t *data, size_t datalen) {
   req_.recv_body_length += datalen;
 
+  // If dconn_ is not attached yet, we do not know whether retry is
+  // enabled or not.  Keep the body just in case, unless the method
+  // rules out retry.
+  if (!retry_request_buf_incomplete_) {
+    if (!method_retriable(req_.method) ||
+        (dconn_ && !get_retry_shared_addr(dconn_.get())) ||
+        retry_request_buf_.rleft() + datalen > RETRY_REQUEST_BODY_MAX) {
+      retry_request_buf_incomplete_ = true;
+      retry_request_buf_.reset();
+    } else {
+      retry_request_buf_.append(data, datalen);
+    }
+  }
+
   if (!request_header_sent_) {
     blocked_request_buf_.append(data, datalen);
     req_.unconsumed_body_length += datalen;
@@ -1008,6 +1133,93 @@ void Downstream::add_retry() { ++num_retry_; }
 
 bool Downstream::no_more_retry() const { return num_retry_ > 50; }
 
+size_t Downstream::get_num_retry() const { return num_retry_; }
+
+bool Downstream::request_retriable() const {
+  auto shared_addr = get_retry_shared_addr(dconn_.get());
+  if (!shared_addr) {
+    return false;
+  }
+
+  if (!method_retriable(req_.method)) {
+    return false;
+  }
+
+  return !upgraded_ && !req_.upgrade_request &&
+         request_state_ == Downstream::MSG_COMPLETE &&
+         response_state_ == Downstream::INITIAL &&
+         !retry_request_buf_incomplete_ &&
+         num_request_retries_ < shared_addr->retry.max &&
+         shared_addr->retry_tokens >= 1.;
+}
+
+int Downstream::retry_request() {
+  if (!request_retriable()) {
+    return -1;
+  }
+
+  auto shared_addr = get_retry_shared_addr(dconn_.get());
+  if (!retry_budget_withdraw(*shared_addr)) {
+    return -1;
+  }
+
+  auto &retryconf = shared_addr->retry;
+
+  ++num_request_retries_;
+  failed_addr_ = dconn_->get_addr();
+
+  if (LOG_ENABLED(INFO)) {
+    DLOG(INFO, this) << "Request will be retried; retry="
+                     << num_request_retries_;
+  }
+
+  pop_downstream_connection();
+
+  disable_downstream_rtimer();
+  disable_downstream_wtimer();
+
+  // Rewind the request so that it is sent as if it has not been sent
+  // yet.
+  request_header_sent_ = false;
+  request_pending_ = false;
+  downstream_stream_id_ = -1;
+  request_buf_.reset();
+  blocked_request_buf_.reset();
+  for (auto m = retry_request_buf_.head; m; m = m->next) {
+    blocked_request_buf_.append(m->pos, m->len());
+  }
+  blocked_request_data_eof_ = true;
+
+  // Discard the response which might have been partially received.
+  resp_.fs.clear_headers();
+  resp_.fs.content_length = -1;
+  resp_.recv_body_length = 0;
+  resp_.connection_close = false;
+  resp_.headers_only = false;
+  reset_response();
+  chunked_response_ = false;
+  expect_final_response_ = false;
+
+  // Exponential backoff with jitter.
+  auto worker = upstream_->get_client_handler()->get_worker();
+  auto backoff =
+      retryconf.backoff *
+      (1 << std::min(num_request_retries_ - 1, static_cast<size_t>(16)));
+  auto dist = std::uniform_real_distribution<>(backoff / 2, backoff);
+  auto loop = upstream_->get_client_handler()->get_loop();
+
+  ev_timer_set(&retry_timer_, dist(worker->get_randgen()), 0.);
+  ev_timer_start(loop, &retry_timer_);
+
+  return 0;
+}
+
+size_t Downstream::get_request_retries() const { return num_request_retries_; }
+
+const DownstreamAddr *Downstream::get_failed_addr() const {
+  return failed_addr_;
+}
+
 void Downstream::set_request_downstream_host(const StringRef &host) {
   request_downstream_host_ = host;
 }
@@ -425,6 +425,25 @@ public:
   void add_retry();
   // true if retry attempt should not be done.
   bool no_more_retry() const;
+  size_t get_num_retry() const;
+
+  // Returns true if the request can be sent to a backend again after
+  // it has been sent to the current one, and the attempt failed.
+  // This requires that request retry is enabled for the backend
+  // group, the request method is idempotent, the whole request body
+  // has been received and kept, and no response header has been
+  // received.
+  bool request_retriable() const;
+  // Detaches the current downstream connection, and sends the
+  // request to the backend again after backoff.  The backend address
+  // of the current connection is avoided if possible.  This function
+  // returns 0 if it succeeds, or -1 if the request cannot be retried.
+  int retry_request();
+  // Returns the number of times the request was retried by
+  // retry_request().
+  size_t get_request_retries() const;
+  // Returns the backend address which the last attempt failed on.
+  const DownstreamAddr *get_failed_addr() const;
 
   int get_dispatch_state() const;
   void set_dispatch_state(int s);
@@ -447,6 +466,11 @@ public:
 
   const DownstreamAddr *get_addr() const;
 
+  // Records the latency of response header from backend for load
+  // balancing.  Call this function when response header is received
+  // from backend.
+  void record_backend_latency();
+
   void set_accesslog_written(bool f);
 
   // Finds affinity cookie from request header fields.  The name of
@@ -480,6 +504,12 @@ public:
   int64_t response_sent_body_length;
 
 private:
+  // Counts this request as outstanding for the backend address of
+  // dconn_.
+  void lb_acquire();
+  // Stops counting this request as outstanding.
+  void lb_release();
+
   BlockAllocator balloc_;
 
   std::vector<nghttp2_rcbuf *> rcbufs_;
@@ -499,6 +529,9 @@ private:
   DefaultMemchunks blocked_request_buf_;
   DefaultMemchunks request_buf_;
   DefaultMemchunks response_buf_;
+  // The copy of request body to send it again when the request is
+  // retried.
+  DefaultMemchunks retry_request_buf_;
 
   ev_timer upstream_rtimer_;
   ev_timer upstream_wtimer_;
@@ -506,6 +539,9 @@ private:
   ev_timer downstream_rtimer_;
   ev_timer downstream_wtimer_;
 
+  // Fires when the request should be retried.
+  ev_timer retry_timer_;
+
   Upstream *upstream_;
   std::unique_ptr<DownstreamConnection> dconn_;
 
@@ -515,8 +551,18 @@ private:
   // logging purpose.
   std::shared_ptr<DownstreamAddrGroup> group_;
   const DownstreamAddr *addr_;
+  // The backend address which this request is counted as an
+  // outstanding request of for load balancing.
+  DownstreamAddr *lb_addr_;
+  // The time when this request is assigned to lb_addr_.  This is
+  // reset after the latency is recorded.
+  std::chrono::steady_clock::time_point lb_start_time_;
+  // The backend address which the last attempt failed on.
+  const DownstreamAddr *failed_addr_;
   // How many times we tried in backend connection
   size_t num_retry_;
+  // How many times the request was retried by retry_request().
+  size_t num_request_retries_;
   // The stream ID in frontend connection
   int32_t stream_id_;
   // The associated stream ID in frontend connection if this is pushed
@@ -556,6 +602,8 @@ private:
   // true if eof is received from client before sending header fields
   // to backend.
   bool blocked_request_data_eof_;
+  // true if retry_request_buf_ does not have the whole request body.
+  bool retry_request_buf_incomplete_;
 };
 
 } // namespace shrpx
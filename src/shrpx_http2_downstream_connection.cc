@@ -586,6 +586,8 @@ Http2DownstreamConnection::get_downstream_addr_group() const {
   return http2session_->get_downstream_addr_group();
 }
 
-DownstreamAddr *Http2DownstreamConnection::get_addr() const { return nullptr; }
+DownstreamAddr *Http2DownstreamConnection::get_addr() const {
+  return http2session_->get_addr();
+}
 
 } // namespace shrpx
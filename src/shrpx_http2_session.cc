@@ -841,6 +841,10 @@ int on_stream_close_callback(nghttp2_session *session, int32_t stream_id,
       // This will avoid to send RST_STREAM to backend
       downstream->set_response_state(Downstream::MSG_RESET);
       upstream->cancel_premature_downstream(downstream);
+    } else if (downstream->get_response_state() == Downstream::INITIAL &&
+               downstream->retry_request() == 0) {
+      // The stream was closed before response header was received.
+      // The request will be sent again, and dconn was deleted.
     } else {
       if (downstream->get_upgraded() &&
           downstream->get_response_state() == Downstream::HEADER_COMPLETE) {
@@ -1109,6 +1113,17 @@ int on_response_headers(Http2Session *http2session, Downstream *downstream,
   downstream->set_downstream_addr_group(
       http2session->get_downstream_addr_group());
   downstream->set_addr(http2session->get_addr());
+  downstream->record_backend_latency();
+
+  if (status_code / 100 != 1) {
+    record_downstream_result(http2session->get_addr(), status_code / 100 == 5);
+  }
+
+  // Send the request to another backend if possible.  This deletes
+  // the downstream connection, and resets the stream.
+  if (status_code == 503 && downstream->retry_request() == 0) {
+    return -1;
+  }
 
   if (LOG_ENABLED(INFO)) {
     std::stringstream ss;
@@ -2386,6 +2401,12 @@ void Http2Session::on_timeout() {
     downstream_failure(addr_, raddr_);
     break;
   }
+  case CONNECTED:
+    // Requests in flight on this connection timed out.
+    if (dconns_.size()) {
+      record_downstream_result(addr_, true);
+    }
+    break;
   }
 }
 
@@ -1291,6 +1291,10 @@ int Http2Upstream::downstream_eof(DownstreamConnection *dconn) {
     DCLOG(INFO, dconn) << "EOF. stream_id=" << downstream->get_stream_id();
   }
 
+  if (downstream->retry_request() == 0) {
+    return 0;
+  }
+
   // Delete downstream connection. If we don't delete it here, it will
   // be pooled in on_stream_close_callback.
   downstream->pop_downstream_connection();
@@ -1335,6 +1339,10 @@ int Http2Upstream::downstream_error(DownstreamConnection *dconn, int events) {
     }
   }
 
+  if (downstream->retry_request() == 0) {
+    return 0;
+  }
+
   // Delete downstream connection. If we don't delete it here, it will
   // be pooled in on_stream_close_callback.
   downstream->pop_downstream_connection();
@@ -2015,6 +2023,11 @@ int Http2Upstream::on_downstream_reset(Downstream *downstream, bool no_retry) {
   }
 
   if (!downstream->request_submission_ready()) {
+    // The request has been sent already.  Send it again if it is
+    // safe to do so.
+    if (!no_retry && downstream->retry_request() == 0) {
+      return 0;
+    }
     if (downstream->get_response_state() == Downstream::MSG_COMPLETE) {
       // We have got all response body already.  Send it off.
       downstream->pop_downstream_connection();
@@ -66,6 +66,8 @@ void timeoutcb(struct ev_loop *loop, ev_timer *w, int revents) {
   // Do this so that dconn is not pooled
   resp.connection_close = true;
 
+  record_downstream_result(dconn->get_addr(), true);
+
   if (upstream->downstream_error(dconn, Downstream::EVENT_TIMEOUT) != 0) {
     delete handler;
   }
@@ -256,11 +258,12 @@ int HttpDownstreamConnection::initiate_connection() {
     auto &shared_addr = group_->shared_addr;
     auto &addrs = shared_addr->addrs;
 
-    // If session affinity is enabled, we always start with address at
-    // initial_addr_idx_.
+    // If session affinity or load balancing policy is enabled, we
+    // always start with address at initial_addr_idx_.
     size_t temp_idx = initial_addr_idx_;
 
-    auto &next_downstream = shared_addr->affinity.type == AFFINITY_NONE
+    auto &next_downstream = shared_addr->affinity.type == AFFINITY_NONE &&
+                                    !shared_addr->lb_enabled
                                 ? shared_addr->next
                                 : temp_idx;
     auto end = next_downstream;
@@ -792,7 +795,8 @@ void remove_from_pool(HttpDownstreamConnection *dconn) {
   auto &group = dconn->get_downstream_addr_group();
   auto &shared_addr = group->shared_addr;
 
-  if (shared_addr->affinity.type == AFFINITY_NONE) {
+  if (shared_addr->affinity.type == AFFINITY_NONE &&
+      !shared_addr->lb_enabled) {
     auto &dconn_pool =
         dconn->get_downstream_addr_group()->shared_addr->dconn_pool;
     dconn_pool.remove_downstream_connection(dconn);
@@ -917,6 +921,17 @@ int htp_hdrs_completecb(http_parser *htp) {
 
   downstream->set_downstream_addr_group(dconn->get_downstream_addr_group());
   downstream->set_addr(dconn->get_addr());
+  downstream->record_backend_latency();
+
+  if (resp.http_status / 100 != 1) {
+    record_downstream_result(dconn->get_addr(), resp.http_status / 100 == 5);
+  }
+
+  // Fail here so that Upstream::downstream_error() sends the request
+  // to another backend.
+  if (resp.http_status == 503 && downstream->request_retriable()) {
+    return -1;
+  }
 
   // Server MUST NOT send Transfer-Encoding with a status code 1xx or
   // 204.  Also server MUST NOT send Transfer-Encoding with a status
@@ -834,6 +834,9 @@ int HttpsUpstream::downstream_eof(DownstreamConnection *dconn) {
   }
 
   if (downstream->get_response_state() == Downstream::INITIAL) {
+    if (downstream->retry_request() == 0) {
+      return 0;
+    }
     // we did not send any response headers, so we can reply error
     // message.
     if (LOG_ENABLED(INFO)) {
@@ -866,6 +869,10 @@ int HttpsUpstream::downstream_error(DownstreamConnection *dconn, int events) {
     return -1;
   }
 
+  if (downstream->retry_request() == 0) {
+    return 0;
+  }
+
   unsigned int status;
   if (events & Downstream::EVENT_TIMEOUT) {
     status = 504;
@@ -1364,6 +1371,13 @@ int HttpsUpstream::on_downstream_reset(Downstream *downstream, bool no_retry) {
 
   assert(downstream == downstream_.get());
 
+  // The request has been sent already.  Send it again if it is safe
+  // to do so.
+  if (!no_retry && !downstream_->request_submission_ready() &&
+      downstream_->retry_request() == 0) {
+    return 0;
+  }
+
   downstream_->pop_downstream_connection();
 
   if (!downstream_->request_submission_ready()) {
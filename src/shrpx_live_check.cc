@@ -27,6 +27,7 @@
 #include "shrpx_connect_blocker.h"
 #include "shrpx_tls.h"
 #include "shrpx_log.h"
+#include "http2.h"
 
 namespace shrpx {
 
@@ -100,8 +101,29 @@ void settings_timeout_cb(struct ev_loop *loop, ev_timer *w, int revents) {
 }
 } // namespace
 
+namespace {
+void probe_timeoutcb(struct ev_loop *loop, ev_timer *w, int revents) {
+  auto live_check = static_cast<LiveCheck *>(w->data);
+
+  if (LOG_ENABLED(INFO)) {
+    LOG(INFO) << "Health check timeout";
+  }
+
+  live_check->on_failure();
+}
+} // namespace
+
+namespace {
+void health_check_timeoutcb(struct ev_loop *loop, ev_timer *w, int revents) {
+  auto live_check = static_cast<LiveCheck *>(w->data);
+
+  live_check->on_health_check_timer();
+}
+} // namespace
+
 LiveCheck::LiveCheck(struct ev_loop *loop, SSL_CTX *ssl_ctx, Worker *worker,
-                     DownstreamAddr *addr, std::mt19937 &gen)
+                     DownstreamAddr *addr, const HealthCheckConfig *hcconf,
+                     std::mt19937 &gen)
     : conn_(loop, -1, nullptr, worker->get_mcpool(),
             worker->get_downstream_config()->timeout.write,
             worker->get_downstream_config()->timeout.read, {}, {}, writecb,
@@ -114,12 +136,15 @@ LiveCheck::LiveCheck(struct ev_loop *loop, SSL_CTX *ssl_ctx, Worker *worker,
       worker_(worker),
       ssl_ctx_(ssl_ctx),
       addr_(addr),
+      hcconf_(hcconf),
       session_(nullptr),
       raddr_(nullptr),
       success_count_(0),
       fail_count_(0),
+      health_seq_(0),
       settings_ack_received_(false),
-      session_closing_(false) {
+      session_closing_(false),
+      response_ok_(false) {
   ev_timer_init(&backoff_timer_, backoff_timeoutcb, 0., 0.);
   backoff_timer_.data = this;
 
@@ -127,9 +152,19 @@ LiveCheck::LiveCheck(struct ev_loop *loop, SSL_CTX *ssl_ctx, Worker *worker,
   // assume that connection is broken.
   ev_timer_init(&settings_timer_, settings_timeout_cb, 0., 0.);
   settings_timer_.data = this;
+
+  ev_timer_init(&health_check_timer_, health_check_timeoutcb, 0., 0.);
+  health_check_timer_.data = this;
+
+  // Each health check must finish in time, so that the next one
+  // starts on schedule.
+  ev_timer_init(&probe_timer_, probe_timeoutcb, 0., 0.);
+  probe_timer_.data = this;
 }
 
 LiveCheck::~LiveCheck() {
+  stop_health_check();
+
   disconnect();
 
   ev_timer_stop(conn_.loop, &backoff_timer_);
@@ -150,6 +185,7 @@ void LiveCheck::disconnect() {
   conn_.wlimit.stopw();
 
   ev_timer_stop(conn_.loop, &settings_timer_);
+  ev_timer_stop(conn_.loop, &probe_timer_);
 
   read_ = write_ = &LiveCheck::noop;
 
@@ -160,6 +196,7 @@ void LiveCheck::disconnect() {
 
   settings_ack_received_ = false;
   session_closing_ = false;
+  response_ok_ = false;
 
   wb_.reset();
 }
@@ -187,6 +224,65 @@ void LiveCheck::schedule() {
   ev_timer_start(conn_.loop, &backoff_timer_);
 }
 
+bool LiveCheck::scheduled() const { return ev_is_active(&backoff_timer_); }
+
+void LiveCheck::start_health_check() {
+  if (!hcconf_) {
+    return;
+  }
+
+  // Spread the first check over the interval so that the checks for
+  // all backends do not happen at once.
+  auto dist = std::uniform_real_distribution<>(0., hcconf_->interval);
+
+  ev_timer_set(&health_check_timer_, dist(gen_), hcconf_->interval);
+  ev_timer_start(conn_.loop, &health_check_timer_);
+}
+
+void LiveCheck::stop_health_check() {
+  if (!hcconf_) {
+    return;
+  }
+
+  ev_timer_stop(conn_.loop, &health_check_timer_);
+
+  disconnect();
+
+  LiveCheck *owner = this;
+  addr_->health->owner.compare_exchange_strong(owner, nullptr);
+}
+
+void LiveCheck::on_health_check_timer() {
+  sync_health();
+
+  // The previous check is still in progress.  probe_timer_ may
+  // expire at the same time as this timer; count it as a failure
+  // here, and start the next check on schedule.
+  if (conn_.fd != -1 || dns_query_) {
+    on_failure();
+  }
+
+  // Only one worker sends health check request to a backend address.
+  // The others just follow the result.
+  auto &owner = addr_->health->owner;
+  LiveCheck *expected = nullptr;
+  if (owner.load() != this && !owner.compare_exchange_strong(expected, this)) {
+    return;
+  }
+
+  // A backend which accepts a connection but never responds must
+  // count as a failure before the next check is due.
+  ev_timer_set(&probe_timer_,
+               std::min(hcconf_->interval,
+                        worker_->get_downstream_config()->timeout.read),
+               0.);
+  ev_timer_start(conn_.loop, &probe_timer_);
+
+  if (initiate_connection() != 0) {
+    on_failure();
+  }
+}
+
 int LiveCheck::do_read() { return read_(*this); }
 
 int LiveCheck::do_write() { return write_(*this); }
@@ -372,6 +468,15 @@ int LiveCheck::connected() {
     return 0;
   }
 
+  if (hcconf_) {
+    read_ = &LiveCheck::read_clear;
+    write_ = &LiveCheck::write_clear;
+
+    submit_http1_request();
+
+    return 0;
+  }
+
   on_success();
 
   return 0;
@@ -441,6 +546,15 @@ int LiveCheck::tls_handshake() {
     break;
   }
 
+  if (hcconf_) {
+    read_ = &LiveCheck::read_tls;
+    write_ = &LiveCheck::write_tls;
+
+    submit_http1_request();
+
+    return 0;
+  }
+
   on_success();
 
   return 0;
@@ -467,6 +581,14 @@ int LiveCheck::read_tls() {
     if (on_read(buf.data(), nread) != 0) {
       return -1;
     }
+
+    // HTTP/1 health check completes when the response header is
+    // received.  We do not read response body.
+    if (addr_->proto == PROTO_HTTP1 && response_ok_) {
+      on_success();
+
+      return 0;
+    }
   }
 }
 
@@ -512,7 +634,7 @@ int LiveCheck::write_tls() {
   conn_.wlimit.stopw();
   ev_timer_stop(conn_.loop, &conn_.wt);
 
-  if (settings_ack_received_) {
+  if (probe_completed()) {
     on_success();
   }
 
@@ -538,6 +660,14 @@ int LiveCheck::read_clear() {
     if (on_read(buf.data(), nread) != 0) {
       return -1;
     }
+
+    // HTTP/1 health check completes when the response header is
+    // received.  We do not read response body.
+    if (addr_->proto == PROTO_HTTP1 && response_ok_) {
+      on_success();
+
+      return 0;
+    }
   }
 }
 
@@ -580,7 +710,7 @@ int LiveCheck::write_clear() {
   conn_.wlimit.stopw();
   ev_timer_stop(conn_.loop, &conn_.wt);
 
-  if (settings_ack_received_) {
+  if (probe_completed()) {
     on_success();
   }
 
@@ -590,6 +720,10 @@ int LiveCheck::write_clear() {
 int LiveCheck::on_read(const uint8_t *data, size_t len) {
   ssize_t rv;
 
+  if (addr_->proto == PROTO_HTTP1) {
+    return on_read_http1(data, len);
+  }
+
   rv = nghttp2_session_mem_recv(session_, data, len);
   if (rv < 0) {
     LOG(ERROR) << "nghttp2_session_mem_recv() returned error: "
@@ -597,7 +731,7 @@ int LiveCheck::on_read(const uint8_t *data, size_t len) {
     return -1;
   }
 
-  if (settings_ack_received_ && !session_closing_) {
+  if (probe_completed() && !session_closing_) {
     session_closing_ = true;
     rv = nghttp2_session_terminate_session(session_, NGHTTP2_NO_ERROR);
     if (rv != 0) {
@@ -611,8 +745,9 @@ int LiveCheck::on_read(const uint8_t *data, size_t len) {
       LOG(INFO) << "No more read/write for this session";
     }
 
-    // If we have SETTINGS ACK already, we treat this success.
-    if (settings_ack_received_) {
+    // If we have SETTINGS ACK (or health check response) already, we
+    // treat this success.
+    if (probe_completed()) {
       return 0;
     }
 
@@ -625,6 +760,11 @@ int LiveCheck::on_read(const uint8_t *data, size_t len) {
 }
 
 int LiveCheck::on_write() {
+  // HTTP/1 request has been written to wb_ already.
+  if (addr_->proto == PROTO_HTTP1) {
+    return 0;
+  }
+
   for (;;) {
     const uint8_t *data;
     auto datalen = nghttp2_session_mem_send(session_, &data);
@@ -650,7 +790,7 @@ int LiveCheck::on_write() {
       LOG(INFO) << "No more read/write for this session";
     }
 
-    if (settings_ack_received_) {
+    if (probe_completed()) {
       return 0;
     }
 
@@ -661,6 +801,11 @@ int LiveCheck::on_write() {
 }
 
 void LiveCheck::on_failure() {
+  if (hcconf_) {
+    health_check_done(false);
+    return;
+  }
+
   ++fail_count_;
 
   if (LOG_ENABLED(INFO)) {
@@ -674,6 +819,11 @@ void LiveCheck::on_failure() {
 }
 
 void LiveCheck::on_success() {
+  if (hcconf_) {
+    health_check_done(true);
+    return;
+  }
+
   ++success_count_;
   fail_count_ = 0;
 
@@ -700,6 +850,77 @@ void LiveCheck::on_success() {
   disconnect();
 }
 
+void LiveCheck::health_check_done(bool success) {
+  disconnect();
+
+  auto &health = *addr_->health;
+  auto healthy = health.healthy.load(std::memory_order_relaxed);
+
+  if (success) {
+    ++success_count_;
+    fail_count_ = 0;
+
+    if (LOG_ENABLED(INFO)) {
+      LOG(INFO) << "Health check for " << addr_->host << ":" << addr_->port
+                << " succeeded " << success_count_ << " time(s) in a row";
+    }
+
+    if (!healthy && success_count_ >= std::max(addr_->rise, size_t(1))) {
+      LOG(NOTICE) << "Health check for " << addr_->host << ":" << addr_->port
+                  << " succeeded " << success_count_
+                  << " times in a row; considered as online";
+
+      healthy = true;
+    }
+  } else {
+    ++fail_count_;
+    success_count_ = 0;
+
+    if (LOG_ENABLED(INFO)) {
+      LOG(INFO) << "Health check for " << addr_->host << ":" << addr_->port
+                << " failed " << fail_count_ << " time(s) in a row";
+    }
+
+    if (healthy && fail_count_ >= std::max(addr_->fall, size_t(1))) {
+      LOG(WARN) << "Health check for " << addr_->host << ":" << addr_->port
+                << " failed " << fail_count_
+                << " times in a row; considered as offline";
+
+      healthy = false;
+    }
+  }
+
+  health.healthy.store(healthy, std::memory_order_relaxed);
+  health.seq.fetch_add(1, std::memory_order_release);
+
+  sync_health();
+}
+
+void LiveCheck::sync_health() {
+  auto &health = *addr_->health;
+
+  auto seq = health.seq.load(std::memory_order_acquire);
+  if (seq == health_seq_) {
+    return;
+  }
+
+  health_seq_ = seq;
+
+  const auto &connect_blocker = addr_->connect_blocker;
+
+  if (health.healthy.load(std::memory_order_relaxed)) {
+    // This also brings back the address which was ejected by
+    // record_downstream_result().
+    if (connect_blocker->in_offline()) {
+      connect_blocker->online();
+    }
+
+    return;
+  }
+
+  connect_blocker->offline();
+}
+
 int LiveCheck::noop() { return 0; }
 
 void LiveCheck::start_settings_timer() {
@@ -715,6 +936,97 @@ void LiveCheck::stop_settings_timer() {
 
 void LiveCheck::settings_ack_received() { settings_ack_received_ = true; }
 
+bool LiveCheck::probe_completed() const {
+  return hcconf_ ? response_ok_ : settings_ack_received_;
+}
+
+int LiveCheck::on_response_status(int status) {
+  // Skip non-final response
+  if (status / 100 == 1) {
+    return 0;
+  }
+
+  if (status != static_cast<int>(hcconf_->status)) {
+    if (LOG_ENABLED(INFO)) {
+      LOG(INFO) << "Health check for " << addr_->host << ":" << addr_->port
+                << " got unexpected status code " << status;
+    }
+
+    return -1;
+  }
+
+  response_ok_ = true;
+
+  return 0;
+}
+
+int LiveCheck::on_stream_close() { return response_ok_ ? 0 : -1; }
+
+namespace {
+int htp_hdrs_completecb(http_parser *htp) {
+  // Wait for the final response.
+  if (htp->status_code / 100 == 1) {
+    return 0;
+  }
+
+  // We just check status code, and do not read response body.
+  http_parser_pause(htp, 1);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+constexpr http_parser_settings htp_hooks = {
+    nullptr,             // http_cb      on_message_begin;
+    nullptr,             // http_data_cb on_url;
+    nullptr,             // http_data_cb on_status;
+    nullptr,             // http_data_cb on_header_field;
+    nullptr,             // http_data_cb on_header_value;
+    htp_hdrs_completecb, // http_cb      on_headers_complete;
+    nullptr,             // http_data_cb on_body;
+    nullptr              // http_cb      on_message_complete;
+};
+} // namespace
+
+void LiveCheck::submit_http1_request() {
+  http_parser_init(&htp_, HTTP_RESPONSE);
+  htp_.data = this;
+
+  std::string req{std::begin(hcconf_->method), std::end(hcconf_->method)};
+  req += ' ';
+  req.append(hcconf_->path.c_str(), hcconf_->path.size());
+  req += " HTTP/1.1\r\nHost: ";
+  req.append(addr_->hostport.c_str(), addr_->hostport.size());
+  req += "\r\nConnection: close\r\n\r\n";
+
+  wb_.append(req);
+
+  signal_write();
+}
+
+int LiveCheck::on_read_http1(const uint8_t *data, size_t len) {
+  http_parser_execute(&htp_, &htp_hooks, reinterpret_cast<const char *>(data),
+                      len);
+
+  auto htperr = HTTP_PARSER_ERRNO(&htp_);
+
+  if (htperr == HPE_PAUSED) {
+    return on_response_status(htp_.status_code);
+  }
+
+  if (htperr != HPE_OK) {
+    if (LOG_ENABLED(INFO)) {
+      LOG(INFO) << "Health check response parse failure: "
+                << http_errno_name(htperr);
+    }
+
+    return -1;
+  }
+
+  return 0;
+}
+
 namespace {
 int on_frame_send_callback(nghttp2_session *session, const nghttp2_frame *frame,
                            void *user_data) {
@@ -748,6 +1060,40 @@ int on_frame_recv_callback(nghttp2_session *session, const nghttp2_frame *frame,
 }
 } // namespace
 
+namespace {
+int on_header_callback(nghttp2_session *session, const nghttp2_frame *frame,
+                       const uint8_t *name, size_t namelen,
+                       const uint8_t *value, size_t valuelen, uint8_t flags,
+                       void *user_data) {
+  auto live_check = static_cast<LiveCheck *>(user_data);
+
+  if (frame->hd.type != NGHTTP2_HEADERS ||
+      !util::streq_l(":status", name, namelen)) {
+    return 0;
+  }
+
+  if (live_check->on_response_status(http2::parse_http_status_code(
+          StringRef{value, valuelen})) != 0) {
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+int on_stream_close_callback(nghttp2_session *session, int32_t stream_id,
+                             uint32_t error_code, void *user_data) {
+  auto live_check = static_cast<LiveCheck *>(user_data);
+
+  if (live_check->on_stream_close() != 0) {
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return 0;
+}
+} // namespace
+
 int LiveCheck::connection_made() {
   int rv;
 
@@ -761,6 +1107,12 @@ int LiveCheck::connection_made() {
                                                        on_frame_send_callback);
   nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks,
                                                        on_frame_recv_callback);
+  if (hcconf_) {
+    nghttp2_session_callbacks_set_on_header_callback(callbacks,
+                                                     on_header_callback);
+    nghttp2_session_callbacks_set_on_stream_close_callback(
+        callbacks, on_stream_close_callback);
+  }
 
   rv = nghttp2_session_client_new(&session_, callbacks, this);
 
@@ -775,6 +1127,22 @@ int LiveCheck::connection_made() {
     return -1;
   }
 
+  if (hcconf_) {
+    auto nva = std::array<nghttp2_nv, 4>{
+        {http2::make_nv_ls_nocopy(":method", hcconf_->method),
+         http2::make_nv_ls_nocopy(":scheme",
+                                  addr_->tls ? StringRef::from_lit("https")
+                                             : StringRef::from_lit("http")),
+         http2::make_nv_ls_nocopy(":authority", addr_->hostport),
+         http2::make_nv_ls_nocopy(":path", hcconf_->path)}};
+
+    auto stream_id = nghttp2_submit_request(session_, nullptr, nva.data(),
+                                            nva.size(), nullptr, nullptr);
+    if (stream_id < 0) {
+      return -1;
+    }
+  }
+
   auto must_terminate =
       addr_->tls && !nghttp2::tls::check_http2_requirement(conn_.tls.ssl);
 
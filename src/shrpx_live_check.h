@@ -36,6 +36,8 @@
 
 #include <nghttp2/nghttp2.h>
 
+#include "http-parser/http_parser.h"
+
 #include "shrpx_connection.h"
 
 namespace shrpx {
@@ -43,11 +45,20 @@ namespace shrpx {
 class Worker;
 struct DownstreamAddr;
 struct DNSQuery;
+struct HealthCheckConfig;
 
+// LiveCheck checks whether a backend address is online.  If active
+// health check is disabled, it is only used to bring offline address
+// back online.  Otherwise, it sends health check request
+// periodically, and shares the result with the other workers through
+// DownstreamAddr::health.
 class LiveCheck {
 public:
+  // |hcconf| is the configuration of active health check.  It is
+  // nullptr if active health check is disabled.
   LiveCheck(struct ev_loop *loop, SSL_CTX *ssl_ctx, Worker *worker,
-            DownstreamAddr *addr, std::mt19937 &gen);
+            DownstreamAddr *addr, const HealthCheckConfig *hcconf,
+            std::mt19937 &gen);
   ~LiveCheck();
 
   void disconnect();
@@ -59,6 +70,17 @@ public:
 
   // Schedules next connection attempt
   void schedule();
+  // Returns true if the next connection attempt is scheduled.
+  bool scheduled() const;
+
+  // Starts periodic active health check.  This function does nothing
+  // if active health check is disabled.
+  void start_health_check();
+  // Stops active health check, and lets the other worker take over
+  // sending health check request if this object has been doing it.
+  void stop_health_check();
+  // Called periodically while active health check is running.
+  void on_health_check_timer();
 
   // Low level I/O operation callback; they are called from do_read()
   // or do_write().
@@ -88,21 +110,47 @@ public:
   // Call this function when SETTINGS ACK was received from server.
   void settings_ack_received();
 
+  // Call this function when the status code |status| of health check
+  // response was received.  It returns -1 if |status| is not the
+  // expected one.
+  int on_response_status(int status);
+  // Call this function when HTTP/2 stream of health check request
+  // was closed.  It returns -1 if no response was received.
+  int on_stream_close();
+
   void signal_write();
 
 private:
+  // Returns true if this check completed successfully.
+  bool probe_completed() const;
+  // Writes HTTP/1 health check request to wb_.
+  void submit_http1_request();
+  int on_read_http1(const uint8_t *data, size_t len);
+  // Updates the shared health check result with |success|.
+  void health_check_done(bool success);
+  // Makes connect_blocker of addr_ reflect the shared health check
+  // result if it has been updated since the last call.
+  void sync_health();
+
   Connection conn_;
   DefaultMemchunks wb_;
   std::mt19937 &gen_;
   ev_timer backoff_timer_;
   ev_timer settings_timer_;
+  ev_timer health_check_timer_;
+  // Limits the time to finish a single health check
+  ev_timer probe_timer_;
   std::function<int(LiveCheck &)> read_, write_;
   Worker *worker_;
   // nullptr if no TLS is configured
   SSL_CTX *ssl_ctx_;
   // Address of remote endpoint
   DownstreamAddr *addr_;
+  // nullptr if active health check is disabled
+  const HealthCheckConfig *hcconf_;
   nghttp2_session *session_;
+  // Parses HTTP/1 health check response
+  http_parser htp_;
   // Actual remote address used to contact backend.  This is initially
   // nullptr, and may point to either &addr_->addr, or
   // resolved_addr_.get().
@@ -114,10 +162,16 @@ private:
   size_t success_count_;
   // The number of unsuccessful connect attempt in a row.
   size_t fail_count_;
+  // The last value of DownstreamAddr::health->seq which this object
+  // has seen.
+  uint64_t health_seq_;
   // true when SETTINGS ACK has been received from server.
   bool settings_ack_received_;
   // true when GOAWAY has been queued.
   bool session_closing_;
+  // true when health check response with the expected status code
+  // has been received.
+  bool response_ok_;
 };
 
 } // namespace shrpx
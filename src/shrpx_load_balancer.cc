@@ -0,0 +1,197 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_load_balancer.h"
+
+#include <cassert>
+#include <algorithm>
+#include <cstdlib>
+
+namespace shrpx {
+
+namespace {
+// The virtual time advanced by one selection of an address of weight
+// 1.  An address of weight w advances LB_STRIDE / w.
+constexpr uint64_t LB_STRIDE = 1 << 16;
+} // namespace
+
+namespace {
+// The smoothing factor of EWMA of response latency.  The larger
+// value makes the recent samples more significant.
+constexpr double LB_EWMA_ALPHA = 0.3;
+} // namespace
+
+void lb_init(LBState &st, uint32_t weight) {
+  st.weight = weight;
+  st.pass = 0;
+  st.num_outstanding = 0;
+  st.ewma_latency = -1.;
+}
+
+namespace {
+// Returns the cost of |st| which is proportional to the number of
+// outstanding requests, and inversely proportional to its weight.
+double outstanding_cost(const LBState &st) {
+  return static_cast<double>(st.num_outstanding + 1) / st.weight;
+}
+} // namespace
+
+namespace {
+// Returns true if |lhs| should be chosen rather than |rhs| given their
+// costs |lcost| and |rcost|.  Ties are broken by weighted round-robin.
+bool lb_less(const LBState *lhs, double lcost, const LBState *rhs,
+             double rcost) {
+  if (lcost != rcost) {
+    return lcost < rcost;
+  }
+
+  return lhs->pass < rhs->pass;
+}
+} // namespace
+
+size_t lb_select(shrpx_lb_policy policy, LBState *const *cands,
+                 size_t ncands, uint64_t &vtime, std::mt19937 &gen) {
+  assert(ncands > 0);
+
+  // An address which has not been a candidate for a while (e.g., it
+  // was offline) does not earn credits.  Otherwise, it would take
+  // all requests until it catches up with the others.
+  for (size_t i = 0; i < ncands; ++i) {
+    if (cands[i]->pass < vtime) {
+      cands[i]->pass = vtime;
+    }
+  }
+
+  size_t idx = 0;
+
+  switch (policy) {
+  case LB_ROUND_ROBIN:
+    for (size_t i = 1; i < ncands; ++i) {
+      if (cands[i]->pass < cands[idx]->pass) {
+        idx = i;
+      }
+    }
+
+    break;
+  case LB_LEAST_OUTSTANDING: {
+    auto cost = outstanding_cost(*cands[0]);
+
+    for (size_t i = 1; i < ncands; ++i) {
+      auto c = outstanding_cost(*cands[i]);
+      if (lb_less(cands[i], c, cands[idx], cost)) {
+        idx = i;
+        cost = c;
+      }
+    }
+
+    break;
+  }
+  case LB_P2C: {
+    if (ncands == 1) {
+      break;
+    }
+
+    // Draw 2 distinct candidates uniformly.
+    auto i = std::uniform_int_distribution<size_t>(0, ncands - 1)(gen);
+    auto j = std::uniform_int_distribution<size_t>(0, ncands - 2)(gen);
+    if (j >= i) {
+      ++j;
+    }
+
+    idx = lb_less(cands[i], outstanding_cost(*cands[i]), cands[j],
+                  outstanding_cost(*cands[j]))
+              ? i
+              : j;
+
+    break;
+  }
+  case LB_EWMA: {
+    // An address which has no sample yet is assumed to be as slow as
+    // the slowest one.  If there is no sample at all, this is
+    // equivalent to LB_LEAST_OUTSTANDING.
+    auto max_latency = 0.;
+    for (size_t i = 0; i < ncands; ++i) {
+      max_latency = std::max(max_latency, cands[i]->ewma_latency);
+    }
+    if (max_latency == 0.) {
+      max_latency = 1.;
+    }
+
+    auto ewma_cost = [max_latency](const LBState &st) {
+      return (st.ewma_latency < 0. ? max_latency : st.ewma_latency) *
+             outstanding_cost(st);
+    };
+
+    auto cost = ewma_cost(*cands[0]);
+
+    for (size_t i = 1; i < ncands; ++i) {
+      auto c = ewma_cost(*cands[i]);
+      if (lb_less(cands[i], c, cands[idx], cost)) {
+        idx = i;
+        cost = c;
+      }
+    }
+
+    break;
+  }
+  default:
+    assert(0);
+  }
+
+  auto st = cands[idx];
+
+  vtime = st->pass;
+  st->pass += LB_STRIDE / st->weight;
+
+  return idx;
+}
+
+void lb_update_latency(LBState &st, double latency) {
+  if (st.ewma_latency < 0.) {
+    st.ewma_latency = latency;
+    return;
+  }
+
+  st.ewma_latency =
+      LB_EWMA_ALPHA * latency + (1. - LB_EWMA_ALPHA) * st.ewma_latency;
+}
+
+StringRef strlbpolicy(shrpx_lb_policy policy) {
+  switch (policy) {
+  case LB_ROUND_ROBIN:
+    return StringRef::from_lit("round-robin");
+  case LB_LEAST_OUTSTANDING:
+    return StringRef::from_lit("least-outstanding");
+  case LB_P2C:
+    return StringRef::from_lit("p2c");
+  case LB_EWMA:
+    return StringRef::from_lit("ewma");
+  }
+
+  // gcc needs this.
+  assert(0);
+  abort();
+}
+
+} // namespace shrpx
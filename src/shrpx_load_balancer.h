@@ -0,0 +1,92 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef SHRPX_LOAD_BALANCER_H
+#define SHRPX_LOAD_BALANCER_H
+
+#include "shrpx.h"
+
+#include <cstdint>
+#include <random>
+
+#include "template.h"
+
+using namespace nghttp2;
+
+namespace shrpx {
+
+enum shrpx_lb_policy {
+  // Weighted round-robin.
+  LB_ROUND_ROBIN,
+  // Choose the backend address which has the least number of
+  // outstanding requests relative to its weight.
+  LB_LEAST_OUTSTANDING,
+  // Choose 2 backend addresses at random, and use the one which has
+  // less outstanding requests relative to its weight.
+  LB_P2C,
+  // Choose the backend address which has the least EWMA of response
+  // latency multiplied by the number of outstanding requests, relative
+  // to its weight.
+  LB_EWMA,
+};
+
+// The maximum weight of a backend address.
+constexpr uint32_t LB_WEIGHT_MAX = 256;
+
+// LBState is the load balancing state of a backend address.  Each
+// worker has its own copy.
+struct LBState {
+  // Weight of this address in [1, LB_WEIGHT_MAX].
+  uint32_t weight;
+  // The virtual time when this address is due next in weighted
+  // round-robin.  The other policies also use this to break ties.
+  uint64_t pass;
+  // The number of requests which are assigned to this address, and
+  // not finished yet.
+  size_t num_outstanding;
+  // EWMA of response latency in seconds.  This is negative if no
+  // response has been received yet.
+  double ewma_latency;
+};
+
+// Initializes |st| with |weight|.
+void lb_init(LBState &st, uint32_t weight);
+
+// Selects one of |ncands| backend addresses in |cands| according to
+// |policy|, and returns its index in |cands|.  |vtime| is the virtual
+// time of weighted round-robin shared by all addresses in a backend
+// group, and it is updated by this function.  |gen| is used by
+// LB_P2C.  |ncands| must be strictly greater than 0.
+size_t lb_select(shrpx_lb_policy policy, LBState *const *cands,
+                 size_t ncands, uint64_t &vtime, std::mt19937 &gen);
+
+// Updates EWMA of response latency of |st| with |latency| in seconds.
+void lb_update_latency(LBState &st, double latency);
+
+// Returns the name of |policy|.
+StringRef strlbpolicy(shrpx_lb_policy policy);
+
+} // namespace shrpx
+
+#endif // SHRPX_LOAD_BALANCER_H
@@ -0,0 +1,167 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_load_balancer_test.h"
+
+#include <array>
+#include <queue>
+#include <vector>
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_load_balancer.h"
+
+namespace shrpx {
+
+void test_shrpx_lb_weighted_round_robin(void) {
+  std::array<LBState, 3> sts;
+  std::array<LBState *, 3> cands;
+  std::array<size_t, 3> cnt{};
+  uint64_t vtime = 0;
+  std::mt19937 gen(1);
+
+  lb_init(sts[0], 1);
+  lb_init(sts[1], 2);
+  lb_init(sts[2], 5);
+
+  for (size_t i = 0; i < sts.size(); ++i) {
+    cands[i] = &sts[i];
+  }
+
+  for (size_t i = 0; i < 800; ++i) {
+    ++cnt[lb_select(LB_ROUND_ROBIN, cands.data(), cands.size(), vtime, gen)];
+  }
+
+  CU_ASSERT(100 == cnt[0]);
+  CU_ASSERT(200 == cnt[1]);
+  CU_ASSERT(500 == cnt[2]);
+
+  // sts[0] leaves for a while, and then comes back.  It must not take
+  // all requests to catch up with the others.
+  for (size_t i = 0; i < 800; ++i) {
+    lb_select(LB_ROUND_ROBIN, cands.data() + 1, cands.size() - 1, vtime,
+              gen);
+  }
+
+  cnt = {};
+
+  for (size_t i = 0; i < 16; ++i) {
+    ++cnt[lb_select(LB_ROUND_ROBIN, cands.data(), cands.size(), vtime, gen)];
+  }
+
+  CU_ASSERT(cnt[0] <= 3);
+  CU_ASSERT(cnt[2] >= 9);
+}
+
+void test_shrpx_lb_p2c(void) {
+  std::array<LBState, 4> sts;
+  std::array<LBState *, 4> cands;
+  std::array<size_t, 4> cnt{};
+  uint64_t vtime = 0;
+  std::mt19937 gen(1);
+  constexpr size_t nreqs = 60000;
+
+  // The cost of sts[i] is i + 1.  If each of 6 pairs is drawn with
+  // the same probability, sts[i] is chosen in (3 - i) / 6 of them.
+  for (size_t i = 0; i < sts.size(); ++i) {
+    lb_init(sts[i], 1);
+    sts[i].num_outstanding = i;
+    cands[i] = &sts[i];
+  }
+
+  for (size_t i = 0; i < nreqs; ++i) {
+    ++cnt[lb_select(LB_P2C, cands.data(), cands.size(), vtime, gen)];
+  }
+
+  CU_ASSERT(0 == cnt[3]);
+
+  for (size_t i = 0; i < 3; ++i) {
+    auto expected = nreqs * (3 - i) / 6;
+
+    CU_ASSERT(cnt[i] > expected - nreqs / 100);
+    CU_ASSERT(cnt[i] < expected + nreqs / 100);
+  }
+}
+
+namespace {
+// Runs a discrete event simulation of |nreqs| requests which arrive
+// one per tick, and are distributed by |policy| to the backends whose
+// service time in ticks is |service_times|.  Each backend serves
+// requests concurrently.  Returns the number of requests assigned to
+// each backend.
+std::vector<size_t> lb_simulate(shrpx_lb_policy policy,
+                                const std::vector<uint64_t> &service_times,
+                                size_t nreqs) {
+  auto n = service_times.size();
+  auto sts = std::vector<LBState>(n);
+  auto cands = std::vector<LBState *>(n);
+  auto cnt = std::vector<size_t>(n);
+  uint64_t vtime = 0;
+  std::mt19937 gen(1);
+
+  for (size_t i = 0; i < n; ++i) {
+    lb_init(sts[i], 1);
+    cands[i] = &sts[i];
+  }
+
+  // Pairs of completion tick and backend index, earliest first.
+  using Event = std::pair<uint64_t, size_t>;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> evq;
+
+  for (uint64_t now = 0; now < nreqs; ++now) {
+    for (; !evq.empty() && evq.top().first <= now; evq.pop()) {
+      auto &st = sts[evq.top().second];
+      --st.num_outstanding;
+      lb_update_latency(st, service_times[evq.top().second]);
+    }
+
+    auto idx = lb_select(policy, cands.data(), n, vtime, gen);
+
+    ++cnt[idx];
+    ++sts[idx].num_outstanding;
+    evq.emplace(now + service_times[idx], idx);
+  }
+
+  return cnt;
+}
+} // namespace
+
+void test_shrpx_lb_simulation(void) {
+  // 2 fast backends, and 1 slow backend.
+  auto service_times = std::vector<uint64_t>{2, 2, 100};
+  constexpr size_t nreqs = 30000;
+
+  auto cnt = lb_simulate(LB_ROUND_ROBIN, service_times, nreqs);
+
+  CU_ASSERT(nreqs / 3 == cnt[2]);
+
+  for (auto policy : {LB_LEAST_OUTSTANDING, LB_P2C, LB_EWMA}) {
+    cnt = lb_simulate(policy, service_times, nreqs);
+
+    CU_ASSERT(cnt[2] < nreqs / 30);
+    CU_ASSERT(cnt[0] + cnt[1] + cnt[2] == nreqs);
+  }
+}
+
+} // namespace shrpx
@@ -808,6 +808,9 @@ void upstream_accesslog(const std::vector<LogFragment> &lfv,
       }
       std::tie(p, last) = copy(downstream_addr->port, p, last);
       break;
+    case SHRPX_LOGF_BACKEND_RETRIES:
+      std::tie(p, last) = copy(downstream->get_request_retries(), p, last);
+      break;
     case SHRPX_LOGF_NONE:
       break;
     default:
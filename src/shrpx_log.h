@@ -239,6 +239,7 @@ enum LogFragmentType {
   SHRPX_LOGF_TLS_CLIENT_SUBJECT_NAME,
   SHRPX_LOGF_BACKEND_HOST,
   SHRPX_LOGF_BACKEND_PORT,
+  SHRPX_LOGF_BACKEND_RETRIES,
 };
 
 struct LogFragment {
@@ -29,6 +29,7 @@
 #endif // HAVE_UNISTD_H
 
 #include <memory>
+#include <limits>
 
 #include "shrpx_tls.h"
 #include "shrpx_log.h"
@@ -36,6 +37,7 @@
 #include "shrpx_http2_session.h"
 #include "shrpx_log_config.h"
 #include "shrpx_memcached_dispatcher.h"
+#include "shrpx_accept_handler.h"
 #ifdef HAVE_MRUBY
 #  include "shrpx_mruby.h"
 #endif // HAVE_MRUBY
@@ -44,6 +46,13 @@
 
 namespace shrpx {
 
+namespace {
+// The maximum number of retries which can be accumulated in the retry
+// budget of a backend group.  This also allows a few retries when
+// the group receives little traffic.
+constexpr double RETRY_BUDGET_MAX_TOKENS = 10.;
+} // namespace
+
 namespace {
 void eventcb(struct ev_loop *loop, ev_async *w, int revents) {
   auto worker = static_cast<Worker *>(w->data);
@@ -68,16 +77,33 @@ void proc_wev_cb(struct ev_loop *loop, ev_timer *w, int revents) {
 }
 } // namespace
 
+namespace {
+void acceptor_disable_cb(struct ev_loop *loop, ev_timer *w, int revents) {
+  auto worker = static_cast<Worker *>(w->data);
+
+  // If we are in graceful shutdown period, we must not enable
+  // acceptors again.
+  if (worker->get_graceful_shutdown()) {
+    return;
+  }
+
+  worker->enable_acceptor();
+}
+} // namespace
+
 DownstreamAddrGroup::DownstreamAddrGroup() : retired{false} {}
 
 DownstreamAddrGroup::~DownstreamAddrGroup() {}
 
 // DownstreamKey is used to index SharedDownstreamAddr in order to
 // find the same configuration.
-using DownstreamKey = std::tuple<
-    std::vector<std::tuple<StringRef, StringRef, size_t, size_t, shrpx_proto,
-                           uint16_t, bool, bool, bool, bool>>,
-    bool, int, StringRef, StringRef, int>;
+using DownstreamKey =
+    std::tuple<std::vector<std::tuple<StringRef, StringRef, size_t, size_t,
+                                      size_t, uint32_t, shrpx_proto, uint16_t,
+                                      bool, bool, bool, bool>>,
+               bool, int, StringRef, StringRef, int, int, StringRef,
+               StringRef, unsigned int, ev_tstamp, size_t, unsigned int,
+               ev_tstamp>;
 
 namespace {
 DownstreamKey create_downstream_key(
@@ -92,12 +118,14 @@ DownstreamKey create_downstream_key(
     std::get<1>(*p) = a.sni;
     std::get<2>(*p) = a.fall;
     std::get<3>(*p) = a.rise;
-    std::get<4>(*p) = a.proto;
-    std::get<5>(*p) = a.port;
-    std::get<6>(*p) = a.host_unix;
-    std::get<7>(*p) = a.tls;
-    std::get<8>(*p) = a.dns;
-    std::get<9>(*p) = a.upgrade_scheme;
+    std::get<4>(*p) = a.eject;
+    std::get<5>(*p) = a.lb.weight;
+    std::get<6>(*p) = a.proto;
+    std::get<7>(*p) = a.port;
+    std::get<8>(*p) = a.host_unix;
+    std::get<9>(*p) = a.tls;
+    std::get<10>(*p) = a.dns;
+    std::get<11>(*p) = a.upgrade_scheme;
     ++p;
   }
   std::sort(std::begin(addrs), std::end(addrs));
@@ -109,6 +137,18 @@ DownstreamKey create_downstream_key(
   std::get<3>(dkey) = affinity.cookie.name;
   std::get<4>(dkey) = affinity.cookie.path;
   std::get<5>(dkey) = affinity.cookie.secure;
+  std::get<6>(dkey) = shared_addr->lb_policy;
+
+  auto &hc = shared_addr->health_check;
+  std::get<7>(dkey) = hc.method;
+  std::get<8>(dkey) = hc.path;
+  std::get<9>(dkey) = hc.status;
+  std::get<10>(dkey) = hc.interval;
+
+  auto &retry = shared_addr->retry;
+  std::get<11>(dkey) = retry.max;
+  std::get<12>(dkey) = retry.budget;
+  std::get<13>(dkey) = retry.backoff;
 
   return dkey;
 }
@@ -120,7 +160,8 @@ Worker::Worker(struct ev_loop *loop, SSL_CTX *sv_ssl_ctx, SSL_CTX *cl_ssl_ctx,
                const std::shared_ptr<TicketKeys> &ticket_keys,
                ConnectionHandler *conn_handler,
                std::shared_ptr<DownstreamConfig> downstreamconf)
-    : randgen_(util::make_mt19937()),
+    : conn_q_(WORKER_CONNECTION_QUEUE_SIZE),
+      randgen_(util::make_mt19937()),
       worker_stat_{},
       dns_tracker_(loop),
       loop_(loop),
@@ -142,6 +183,9 @@ Worker::Worker(struct ev_loop *loop, SSL_CTX *sv_ssl_ctx, SSL_CTX *cl_ssl_ctx,
   ev_timer_init(&proc_wev_timer_, proc_wev_cb, 0., 0.);
   proc_wev_timer_.data = this;
 
+  ev_timer_init(&disable_acceptor_timer_, acceptor_disable_cb, 0., 0.);
+  disable_acceptor_timer_.data = this;
+
   auto &session_cacheconf = get_config()->tls.session_cache;
 
   if (!session_cacheconf.memcached.host.empty()) {
@@ -161,7 +205,12 @@ void Worker::replace_downstream_config(
 
     auto &shared_addr = g->shared_addr;
 
-    if (shared_addr->affinity.type == AFFINITY_NONE) {
+    for (auto &addr : shared_addr->addrs) {
+      addr.live_check->stop_health_check();
+    }
+
+    if (shared_addr->affinity.type == AFFINITY_NONE &&
+        !shared_addr->lb_enabled) {
       shared_addr->dconn_pool.remove_all();
       continue;
     }
@@ -221,6 +270,20 @@ void Worker::replace_downstream_config(
     }
     shared_addr->affinity_hash = src.affinity_hash;
     shared_addr->redirect_if_not_tls = src.redirect_if_not_tls;
+    if (src.affinity.type == AFFINITY_NONE) {
+      shared_addr->lb_policy = src.lb_policy;
+      shared_addr->lb_enabled = src.lb_policy != LB_ROUND_ROBIN;
+    }
+    if (!src.health_check.path.empty()) {
+      auto &hc = shared_addr->health_check;
+      hc = src.health_check;
+      hc.method = make_string_ref(shared_addr->balloc, src.health_check.method);
+      hc.path = make_string_ref(shared_addr->balloc, src.health_check.path);
+    }
+    if (src.retry.max) {
+      shared_addr->retry = src.retry;
+      shared_addr->retry_tokens = RETRY_BUDGET_MAX_TOKENS;
+    }
 
     size_t num_http1 = 0;
     size_t num_http2 = 0;
@@ -240,9 +303,18 @@ void Worker::replace_downstream_config(
       dst_addr.sni = make_string_ref(shared_addr->balloc, src_addr.sni);
       dst_addr.fall = src_addr.fall;
       dst_addr.rise = src_addr.rise;
+      dst_addr.eject = src_addr.eject;
+      dst_addr.health = src_addr.health;
       dst_addr.dns = src_addr.dns;
       dst_addr.upgrade_scheme = src_addr.upgrade_scheme;
 
+      lb_init(dst_addr.lb, src_addr.weight);
+
+      if (src.affinity.type == AFFINITY_NONE &&
+          src_addr.weight != src.addrs[0].weight) {
+        shared_addr->lb_enabled = true;
+      }
+
       auto shared_addr_ptr = shared_addr.get();
 
       dst_addr.connect_blocker =
@@ -272,8 +344,11 @@ void Worker::replace_downstream_config(
                                         }
                                       });
 
-      dst_addr.live_check =
-          make_unique<LiveCheck>(loop_, cl_ssl_ctx_, this, &dst_addr, randgen_);
+      dst_addr.live_check = make_unique<LiveCheck>(
+          loop_, cl_ssl_ctx_, this, &dst_addr,
+          shared_addr->health_check.path.empty() ? nullptr
+                                                 : &shared_addr->health_check,
+          randgen_);
 
       if (dst_addr.proto == PROTO_HTTP2) {
         ++num_http2;
@@ -298,12 +373,17 @@ void Worker::replace_downstream_config(
       shared_addr->http1_pri.weight = num_http1;
       shared_addr->http2_pri.weight = num_http2;
 
-      if (shared_addr->affinity.type != AFFINITY_NONE) {
+      if (shared_addr->affinity.type != AFFINITY_NONE ||
+          shared_addr->lb_enabled) {
         for (auto &addr : shared_addr->addrs) {
           addr.dconn_pool = make_unique<DownstreamConnectionPool>();
         }
       }
 
+      for (auto &addr : shared_addr->addrs) {
+        addr.live_check->start_health_check();
+      }
+
       dst->shared_addr = shared_addr;
 
       addr_groups_indexer.emplace(std::move(dkey), i);
@@ -322,6 +402,11 @@ Worker::~Worker() {
   ev_async_stop(loop_, &w_);
   ev_timer_stop(loop_, &mcpool_clear_timer_);
   ev_timer_stop(loop_, &proc_wev_timer_);
+  ev_timer_stop(loop_, &disable_acceptor_timer_);
+
+  for (ConnectionEvent cev; conn_q_.pop(cev);) {
+    close(cev.client_fd);
+  }
 }
 
 void Worker::schedule_clear_mcpool() {
@@ -357,18 +442,51 @@ void Worker::send(const WorkerEvent &event) {
   ev_async_send(loop_, &w_);
 }
 
+bool Worker::send_connection(const ConnectionEvent &cev) {
+  if (!conn_q_.push(cev)) {
+    return false;
+  }
+
+  ev_async_send(loop_, &w_);
+
+  return true;
+}
+
+size_t Worker::process_connection_events(size_t max) {
+  size_t n = 0;
+
+  for (ConnectionEvent cev; n < max && conn_q_.pop(cev); ++n) {
+    if (LOG_ENABLED(INFO)) {
+      WLOG(INFO, this) << "ConnectionEvent: client_fd=" << cev.client_fd
+                       << ", addrlen=" << cev.client_addrlen;
+    }
+
+    handle_connection(cev.client_fd, &cev.client_addr.sa, cev.client_addrlen,
+                      cev.faddr, cev.accept_time);
+  }
+
+  return n;
+}
+
 void Worker::process_events() {
+  // Accepting large number of new connections at once may delay time
+  // to 1st byte for existing connections.  Take at most
+  // worker_accept_batch connections in one iteration.
+  auto nconns = process_connection_events(
+      get_config()->conn.upstream.worker_accept_batch);
+
   WorkerEvent wev;
   {
     std::lock_guard<std::mutex> g(m_);
 
-    // Process event one at a time.  This is important for
-    // NEW_CONNECTION event since accepting large number of new
-    // connections at once may delay time to 1st byte for existing
-    // connections.
+    // Process event one at a time.
 
     if (q_.empty()) {
-      ev_timer_stop(loop_, &proc_wev_timer_);
+      if (nconns == 0) {
+        ev_timer_stop(loop_, &proc_wev_timer_);
+      } else {
+        ev_timer_start(loop_, &proc_wev_timer_);
+      }
       return;
     }
 
@@ -380,8 +498,6 @@ void Worker::process_events() {
 
   auto config = get_config();
 
-  auto worker_connections = config->conn.upstream.worker_connections;
-
   switch (wev.type) {
   case NEW_CONNECTION: {
     if (LOG_ENABLED(INFO)) {
@@ -389,31 +505,9 @@ void Worker::process_events() {
                        << ", addrlen=" << wev.client_addrlen;
     }
 
-    if (worker_stat_.num_connections >= worker_connections) {
-
-      if (LOG_ENABLED(INFO)) {
-        WLOG(INFO, this) << "Too many connections >= " << worker_connections;
-      }
-
-      close(wev.client_fd);
-
-      break;
-    }
-
-    auto client_handler =
-        tls::accept_connection(this, wev.client_fd, &wev.client_addr.sa,
-                               wev.client_addrlen, wev.faddr);
-    if (!client_handler) {
-      if (LOG_ENABLED(INFO)) {
-        WLOG(ERROR, this) << "ClientHandler creation failed";
-      }
-      close(wev.client_fd);
-      break;
-    }
-
-    if (LOG_ENABLED(INFO)) {
-      WLOG(INFO, this) << "CLIENT_HANDLER:" << client_handler << " created ";
-    }
+    handle_connection(wev.client_fd, &wev.client_addr.sa,
+                      static_cast<int>(wev.client_addrlen), wev.faddr,
+                      wev.accept_time);
 
     break;
   }
@@ -427,6 +521,10 @@ void Worker::process_events() {
   case GRACEFUL_SHUTDOWN:
     WLOG(NOTICE, this) << "Graceful shutdown commencing";
 
+    process_connection_events(std::numeric_limits<size_t>::max());
+    accept_pending_connection();
+    delete_acceptor();
+
     graceful_shutdown_ = true;
 
     if (worker_stat_.num_connections == 0) {
@@ -441,6 +539,16 @@ void Worker::process_events() {
 
     replace_downstream_config(wev.downstreamconf);
 
+    break;
+  case ENABLE_ACCEPTOR:
+    if (!graceful_shutdown_) {
+      enable_acceptor();
+    }
+
+    break;
+  case DISABLE_ACCEPTOR:
+    disable_acceptor();
+
     break;
   default:
     if (LOG_ENABLED(INFO)) {
@@ -449,6 +557,79 @@ void Worker::process_events() {
   }
 }
 
+int Worker::handle_connection(
+    int fd, sockaddr *addr, int addrlen, const UpstreamAddr *faddr,
+    const std::chrono::steady_clock::time_point &accept_time) {
+  auto worker_connections = get_config()->conn.upstream.worker_connections;
+
+  if (worker_stat_.num_connections >= worker_connections) {
+
+    if (LOG_ENABLED(INFO)) {
+      WLOG(INFO, this) << "Too many connections >= " << worker_connections;
+    }
+
+    close(fd);
+
+    return -1;
+  }
+
+  auto client_handler = tls::accept_connection(this, fd, addr, addrlen, faddr);
+  if (!client_handler) {
+    if (LOG_ENABLED(INFO)) {
+      WLOG(ERROR, this) << "ClientHandler creation failed";
+    }
+    close(fd);
+    return -1;
+  }
+
+  client_handler->set_accept_time(accept_time);
+
+  if (LOG_ENABLED(INFO)) {
+    WLOG(INFO, this) << "CLIENT_HANDLER:" << client_handler << " created ";
+  }
+
+  return 0;
+}
+
+void Worker::add_acceptor(std::unique_ptr<AcceptHandler> h) {
+  acceptors_.push_back(std::move(h));
+}
+
+void Worker::delete_acceptor() {
+  ev_timer_stop(loop_, &disable_acceptor_timer_);
+
+  acceptors_.clear();
+}
+
+void Worker::enable_acceptor() {
+  for (auto &a : acceptors_) {
+    a->enable();
+  }
+}
+
+void Worker::disable_acceptor() {
+  for (auto &a : acceptors_) {
+    a->disable();
+  }
+}
+
+void Worker::sleep_acceptor(ev_tstamp t) {
+  if (t == 0. || ev_is_active(&disable_acceptor_timer_)) {
+    return;
+  }
+
+  disable_acceptor();
+
+  ev_timer_set(&disable_acceptor_timer_, t, 0.);
+  ev_timer_start(loop_, &disable_acceptor_timer_);
+}
+
+void Worker::accept_pending_connection() {
+  for (auto &a : acceptors_) {
+    a->accept_connection();
+  }
+}
+
 tls::CertLookupTree *Worker::get_cert_lookup_tree() const { return cert_tree_; }
 
 std::shared_ptr<TicketKeys> Worker::get_ticket_keys() {
@@ -692,10 +873,131 @@ void downstream_failure(DownstreamAddr *addr, const Address *raddr) {
 
     connect_blocker->offline();
 
-    if (addr->rise) {
+    // If active health check is enabled, it brings this address back
+    // online.
+    if (addr->rise && !addr->health) {
       addr->live_check->schedule();
     }
   }
 }
 
+void record_downstream_result(DownstreamAddr *addr, bool error) {
+  if (!addr || addr->eject == 0) {
+    return;
+  }
+
+  if (!error) {
+    addr->num_errors = 0;
+    return;
+  }
+
+  if (++addr->num_errors < addr->eject) {
+    return;
+  }
+
+  addr->num_errors = 0;
+
+  const auto &connect_blocker = addr->connect_blocker;
+
+  if (connect_blocker->in_offline()) {
+    return;
+  }
+
+  LOG(WARN) << "Backend " << addr->host << ":" << addr->port << " failed "
+            << addr->eject << " requests in a row; considered as offline";
+
+  connect_blocker->offline();
+
+  // Unlike downstream_failure(), the address is brought back online
+  // even if "rise" is 0, because it may still accept connections.
+  // If active health check is enabled, it does this instead.
+  if (!addr->health) {
+    addr->live_check->schedule();
+  }
+}
+
+DownstreamAddr *select_downstream_addr(SharedDownstreamAddr &shared_addr,
+                                       shrpx_proto proto,
+                                       const DownstreamAddr *avoid,
+                                       std::mt19937 &gen) {
+  assert(shared_addr.lb_enabled);
+
+  auto &addrs = shared_addr.lb_addrs;
+  auto &states = shared_addr.lb_states;
+
+  addrs.clear();
+  states.clear();
+
+  for (auto &addr : shared_addr.addrs) {
+    if (addr.proto != proto) {
+      continue;
+    }
+
+    // HTTP/2 backend which is blocked can still be used if it has a
+    // connection established.
+    if (addr.connect_blocker->blocked() &&
+        (proto != PROTO_HTTP2 || addr.http2_extra_freelist.size() == 0)) {
+      continue;
+    }
+
+    addrs.push_back(&addr);
+    states.push_back(&addr.lb);
+  }
+
+  if (addrs.empty()) {
+    return nullptr;
+  }
+
+  if (avoid && addrs.size() > 1) {
+    auto it = std::find(std::begin(addrs), std::end(addrs), avoid);
+    if (it != std::end(addrs)) {
+      states.erase(std::begin(states) + std::distance(std::begin(addrs), it));
+      addrs.erase(it);
+    }
+  }
+
+  auto idx = lb_select(shared_addr.lb_policy, states.data(), states.size(),
+                       shared_addr.lb_vtime, gen);
+
+  return addrs[idx];
+}
+
+void retry_budget_deposit(SharedDownstreamAddr &shared_addr) {
+  auto &retry = shared_addr.retry;
+
+  if (retry.max == 0) {
+    return;
+  }
+
+  shared_addr.retry_tokens =
+      std::min(shared_addr.retry_tokens + retry.budget / 100.,
+               RETRY_BUDGET_MAX_TOKENS);
+}
+
+bool retry_budget_withdraw(SharedDownstreamAddr &shared_addr) {
+  if (shared_addr.retry_tokens < 1.) {
+    return false;
+  }
+
+  shared_addr.retry_tokens -= 1.;
+
+  return true;
+}
+
+void record_accept_latency(WorkerStat *wstat, std::chrono::nanoseconds d) {
+  // Only the owner thread writes these values, so plain load and
+  // store are enough.
+  auto ns = d.count() < 0 ? 0 : static_cast<uint64_t>(d.count());
+
+  wstat->accept_latency_count.store(
+      wstat->accept_latency_count.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+  wstat->accept_latency_sum.store(
+      wstat->accept_latency_sum.load(std::memory_order_relaxed) + ns,
+      std::memory_order_relaxed);
+  if (wstat->accept_latency_max.load(std::memory_order_relaxed) < ns) {
+    wstat->accept_latency_max.store(ns, std::memory_order_relaxed);
+  }
+}
+
 } // namespace shrpx
@@ -33,6 +33,8 @@
 #include <unordered_map>
 #include <deque>
 #include <thread>
+#include <atomic>
+#include <chrono>
 #ifndef NOTHREADS
 #  include <future>
 #endif // NOTHREADS
@@ -50,6 +52,7 @@
 #include "shrpx_connect_blocker.h"
 #include "shrpx_dns_tracker.h"
 #include "allocator.h"
+#include "mpsc_ring.h"
 
 using namespace nghttp2;
 
@@ -60,6 +63,7 @@ class ConnectBlocker;
 class MemcachedDispatcher;
 struct UpstreamAddr;
 class ConnectionHandler;
+class AcceptHandler;
 
 #ifdef HAVE_MRUBY
 namespace mruby {
@@ -87,6 +91,10 @@ struct DownstreamAddr {
   // sni field to send remote server if TLS is enabled.
   StringRef sni;
 
+  // The result of active health check shared by all workers.
+  // nullptr if active health check is disabled.  This must outlive
+  // live_check.
+  std::shared_ptr<SharedHealthState> health;
   std::unique_ptr<ConnectBlocker> connect_blocker;
   std::unique_ptr<LiveCheck> live_check;
   // Connection pool for this particular address if session affinity
@@ -94,6 +102,11 @@ struct DownstreamAddr {
   std::unique_ptr<DownstreamConnectionPool> dconn_pool;
   size_t fall;
   size_t rise;
+  // The number of consecutive errors after which this address is
+  // considered offline.  0 disables it.
+  size_t eject;
+  // The number of consecutive 5xx responses or timeouts.
+  size_t num_errors;
   // Client side TLS session cache
   tls::TLSSessionCache tls_session_cache;
   // Http2Session object created for this address.  This list chains
@@ -109,6 +122,8 @@ struct DownstreamAddr {
   // total number of streams created in HTTP/2 connections for this
   // address.
   size_t num_dconn;
+  // Load balancing state of this address.
+  LBState lb;
   // Application protocol used in this backend
   shrpx_proto proto;
   // true if TLS is used in this backend
@@ -141,6 +156,12 @@ struct SharedDownstreamAddr {
         next{0},
         http1_pri{},
         http2_pri{},
+        health_check{},
+        retry{},
+        retry_tokens{0},
+        lb_policy{LB_ROUND_ROBIN},
+        lb_vtime{0},
+        lb_enabled{false},
         redirect_if_not_tls{false} {}
 
   SharedDownstreamAddr(const SharedDownstreamAddr &) = delete;
@@ -176,6 +197,31 @@ struct SharedDownstreamAddr {
   // HTTP/1.1.  Otherwise, choose HTTP/2.
   WeightedPri http1_pri;
   WeightedPri http2_pri;
+  // Active health check configuration.  If health_check.path is
+  // empty, it is disabled.
+  HealthCheckConfig health_check;
+  // Request retry configuration.  If retry.max is 0, it is disabled.
+  RetryConfig retry;
+  // The number of retries which requests to this group can make
+  // now.  Each request adds retry.budget / 100 to it, and each retry
+  // takes 1 from it.
+  double retry_tokens;
+  // Load balancing policy.  This is only used if lb_enabled is true.
+  shrpx_lb_policy lb_policy;
+  // The virtual time of weighted round-robin.
+  uint64_t lb_vtime;
+  // Scratch buffers to collect candidate addresses in
+  // select_downstream_addr().
+  std::vector<DownstreamAddr *> lb_addrs;
+  std::vector<LBState *> lb_states;
+  // true if backend address is selected by lb_policy and the weight
+  // of each address.  This is true if lb_policy is not
+  // LB_ROUND_ROBIN, or addresses have different weights.  If this is
+  // false, addresses are selected in round-robin using |next| (or
+  // http2_avail_freelist for HTTP/2).  This is always false if
+  // session affinity is enabled.  If either this is true or session
+  // affinity is enabled, each address has its own connection pool.
+  bool lb_enabled;
   // Session affinity
   // true if this group requires that client connection must be TLS,
   // and the request must be redirected to https URI.
@@ -204,13 +250,28 @@ struct DownstreamAddrGroup {
 
 struct WorkerStat {
   size_t num_connections;
+  // The number of connections whose latency between accept(2) and
+  // the first read event in a worker thread was measured, and the
+  // sum and the maximum of those latencies in nanoseconds.  They are
+  // only written by the worker thread, but read by the other threads
+  // through API.
+  std::atomic<uint64_t> accept_latency_count;
+  std::atomic<uint64_t> accept_latency_sum;
+  std::atomic<uint64_t> accept_latency_max;
 };
 
+// Records |d| as the latency between accept(2) and the first read
+// event of a connection.  This function must be called from the
+// thread which owns |wstat|.
+void record_accept_latency(WorkerStat *wstat, std::chrono::nanoseconds d);
+
 enum WorkerEventType {
   NEW_CONNECTION = 0x01,
   REOPEN_LOG = 0x02,
   GRACEFUL_SHUTDOWN = 0x03,
   REPLACE_DOWNSTREAM = 0x04,
+  ENABLE_ACCEPTOR = 0x05,
+  DISABLE_ACCEPTOR = 0x06,
 };
 
 struct WorkerEvent {
@@ -221,10 +282,27 @@ struct WorkerEvent {
     int client_fd;
     const UpstreamAddr *faddr;
   };
+  std::chrono::steady_clock::time_point accept_time;
   std::shared_ptr<TicketKeys> ticket_keys;
   std::shared_ptr<DownstreamConfig> downstreamconf;
 };
 
+// ConnectionEvent is a new connection handed over from the main
+// thread to a worker thread through the worker's connection queue.
+// Unlike WorkerEvent, it has no shared_ptr so that copying it into
+// and out of the queue is cheap.
+struct ConnectionEvent {
+  sockaddr_union client_addr;
+  int client_addrlen;
+  int client_fd;
+  const UpstreamAddr *faddr;
+  // The time when the connection was accepted.
+  std::chrono::steady_clock::time_point accept_time;
+};
+
+// The maximum number of new connections queued to a worker.
+constexpr size_t WORKER_CONNECTION_QUEUE_SIZE = 1024;
+
 class Worker {
 public:
   Worker(struct ev_loop *loop, SSL_CTX *sv_ssl_ctx, SSL_CTX *cl_ssl_ctx,
@@ -238,6 +316,27 @@ public:
   void wait();
   void process_events();
   void send(const WorkerEvent &event);
+  // Queues new connection |cev| to this worker without taking a
+  // lock.  This function returns false if the connection queue is
+  // full.  In that case, the ownership of the file descriptor stays
+  // with the caller.
+  bool send_connection(const ConnectionEvent &cev);
+  // Creates ClientHandler for the accepted connection |fd| on this
+  // worker.  |accept_time| is the time when |fd| was accepted.  This
+  // function must be called from this worker's thread.
+  int handle_connection(
+      int fd, sockaddr *addr, int addrlen, const UpstreamAddr *faddr,
+      const std::chrono::steady_clock::time_point &accept_time);
+
+  // Acceptors owned by this worker.  They exist only if
+  // --frontend-reuseport is enabled, and are only touched from this
+  // worker's thread once it started.
+  void add_acceptor(std::unique_ptr<AcceptHandler> h);
+  void delete_acceptor();
+  void enable_acceptor();
+  void disable_acceptor();
+  void sleep_acceptor(ev_tstamp t);
+  void accept_pending_connection();
 
   tls::CertLookupTree *get_cert_lookup_tree() const;
 
@@ -282,15 +381,24 @@ public:
   DNSTracker *get_dns_tracker();
 
 private:
+  // Takes at most |max| new connections from conn_q_, and creates
+  // ClientHandler for them.  This function returns the number of
+  // connections taken.
+  size_t process_connection_events(size_t max);
+
 #ifndef NOTHREADS
   std::future<void> fut_;
 #endif // NOTHREADS
   std::mutex m_;
+  // Control events other than new connections.
   std::deque<WorkerEvent> q_;
+  // New connections.  This is accessed without locking m_.
+  MPSCRing<ConnectionEvent> conn_q_;
   std::mt19937 randgen_;
   ev_async w_;
   ev_timer mcpool_clear_timer_;
   ev_timer proc_wev_timer_;
+  ev_timer disable_acceptor_timer_;
   MemchunkPool mcpool_;
   WorkerStat worker_stat_;
   DNSTracker dns_tracker_;
@@ -317,6 +425,7 @@ private:
   // Worker level blocker for downstream connection.  For example,
   // this is used when file decriptor is exhausted.
   std::unique_ptr<ConnectBlocker> connect_blocker_;
+  std::vector<std::unique_ptr<AcceptHandler>> acceptors_;
 
   bool graceful_shutdown_;
 };
@@ -333,11 +442,36 @@ size_t match_downstream_addr_group(
     const std::vector<std::shared_ptr<DownstreamAddrGroup>> &groups,
     size_t catch_all, BlockAllocator &balloc);
 
+// Selects a backend address for a new request from |shared_addr|
+// whose protocol is |proto| according to the load balancing policy.
+// This function returns nullptr if no address is available.
+// |avoid| is not selected unless it is the only available address;
+// it may be nullptr.  shared_addr.lb_enabled must be true.
+DownstreamAddr *select_downstream_addr(SharedDownstreamAddr &shared_addr,
+                                       shrpx_proto proto,
+                                       const DownstreamAddr *avoid,
+                                       std::mt19937 &gen);
+
 // Calls this function if connecting to backend failed.  |raddr| is
 // the actual address used to connect to backend, and it could be
 // nullptr.  This function may schedule live check.
 void downstream_failure(DownstreamAddr *addr, const Address *raddr);
 
+// Calls this function when a request to |addr| finished.  |error| is
+// true if |addr| responded with 5xx status code, or the request timed
+// out.  If |addr| fails addr->eject times in a row, it is considered
+// offline.  |addr| may be nullptr.
+void record_downstream_result(DownstreamAddr *addr, bool error);
+
+// Calls this function when a new request is assigned to
+// |shared_addr|.  It earns the retry budget of |shared_addr|.
+void retry_budget_deposit(SharedDownstreamAddr &shared_addr);
+
+// Takes one retry from the retry budget of |shared_addr|.  This
+// function returns true if it succeeds, or false if the budget is
+// exhausted.
+bool retry_budget_withdraw(SharedDownstreamAddr &shared_addr);
+
 } // namespace shrpx
 
 #endif // SHRPX_WORKER_H
@@ -494,6 +494,14 @@ int worker_process_event_loop(WorkerProcessConfig *wpconf) {
     }
   }
 
+  if (tls::upstream_tls_enabled(config->conn) && !config->tls.ocsp.disabled &&
+      config->tls.ocsp.startup) {
+    // Do this before creating worker threads so that their acceptors
+    // (see --frontend-reuseport) are disabled as well.
+    conn_handler->set_enable_acceptor_on_ocsp_completion(true);
+    conn_handler->disable_acceptor();
+  }
+
   if (config->single_thread) {
     rv = conn_handler->create_single_worker();
     if (rv != 0) {
@@ -540,11 +548,6 @@ int worker_process_event_loop(WorkerProcessConfig *wpconf) {
   ev_io_start(loop, &ipcev);
 
   if (tls::upstream_tls_enabled(config->conn) && !config->tls.ocsp.disabled) {
-    if (config->tls.ocsp.startup) {
-      conn_handler->set_enable_acceptor_on_ocsp_completion(true);
-      conn_handler->disable_acceptor();
-    }
-
     conn_handler->proceed_next_cert_ocsp();
   }
 
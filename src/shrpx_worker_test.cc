@@ -34,6 +34,7 @@
 
 #include "shrpx_worker.h"
 #include "shrpx_connect_blocker.h"
+#include "shrpx_live_check.h"
 #include "shrpx_log.h"
 
 namespace shrpx {
@@ -244,4 +245,143 @@ void test_shrpx_worker_match_downstream_addr_group(void) {
                       StringRef{}, groups, 255, balloc));
 }
 
+void test_shrpx_worker_retry_budget(void) {
+  SharedDownstreamAddr shared_addr;
+
+  // No budget is earned if retry is disabled.
+  retry_budget_deposit(shared_addr);
+  CU_ASSERT(0. == shared_addr.retry_tokens);
+  CU_ASSERT(!retry_budget_withdraw(shared_addr));
+
+  shared_addr.retry.max = 2;
+  shared_addr.retry.budget = 50;
+
+  // Each request earns 50% of a retry.
+  retry_budget_deposit(shared_addr);
+  CU_ASSERT(0.5 == shared_addr.retry_tokens);
+  CU_ASSERT(!retry_budget_withdraw(shared_addr));
+  CU_ASSERT(0.5 == shared_addr.retry_tokens);
+
+  retry_budget_deposit(shared_addr);
+  CU_ASSERT(1. == shared_addr.retry_tokens);
+  CU_ASSERT(retry_budget_withdraw(shared_addr));
+  CU_ASSERT(0. == shared_addr.retry_tokens);
+  CU_ASSERT(!retry_budget_withdraw(shared_addr));
+
+  // The budget is capped, so that a long quiet period does not allow
+  // a retry storm.
+  for (size_t i = 0; i < 1000; ++i) {
+    retry_budget_deposit(shared_addr);
+  }
+
+  size_t n = 0;
+  for (; retry_budget_withdraw(shared_addr); ++n)
+    ;
+
+  CU_ASSERT(10 == n);
+  CU_ASSERT(shared_addr.retry_tokens < 1.);
+}
+
+namespace {
+// Returns the configuration of a single backend 127.0.0.1:3000 which
+// is ejected after |eject| failures in a row, and makes it current.
+std::shared_ptr<DownstreamConfig> make_eject_downstream_config(size_t eject) {
+  auto downstreamconf = std::make_shared<DownstreamConfig>();
+
+  DownstreamAddrGroupConfig g(StringRef::from_lit("/"));
+
+  DownstreamAddrConfig addrconf{};
+  addrconf.host = StringRef::from_lit("127.0.0.1");
+  addrconf.hostport = StringRef::from_lit("127.0.0.1:3000");
+  addrconf.port = 3000;
+  addrconf.proto = PROTO_HTTP1;
+  addrconf.weight = 1;
+  addrconf.eject = eject;
+
+  g.addrs.push_back(addrconf);
+  downstreamconf->addr_groups.push_back(std::move(g));
+
+  // LiveCheck reads the backoff timeout from the global configuration.
+  mod_config()->conn.downstream = downstreamconf;
+
+  return downstreamconf;
+}
+} // namespace
+
+void test_shrpx_worker_record_downstream_result(void) {
+  auto loop = ev_loop_new(0);
+
+  {
+    Worker worker(loop, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                  make_eject_downstream_config(0));
+
+    auto &addr = worker.get_downstream_addr_groups()[0]->shared_addr->addrs[0];
+
+    // Nothing happens if ejection is disabled.
+    for (size_t i = 0; i < 10; ++i) {
+      record_downstream_result(&addr, true);
+    }
+
+    CU_ASSERT(!addr.connect_blocker->in_offline());
+
+    addr.eject = 3;
+
+    record_downstream_result(&addr, true);
+    record_downstream_result(&addr, true);
+
+    CU_ASSERT(2 == addr.num_errors);
+    CU_ASSERT(!addr.connect_blocker->in_offline());
+
+    // Success resets the count of the failures in a row.
+    record_downstream_result(&addr, false);
+
+    CU_ASSERT(0 == addr.num_errors);
+
+    record_downstream_result(&addr, true);
+    record_downstream_result(&addr, true);
+
+    CU_ASSERT(!addr.connect_blocker->in_offline());
+
+    record_downstream_result(&addr, true);
+
+    CU_ASSERT(addr.connect_blocker->in_offline());
+    CU_ASSERT(addr.connect_blocker->blocked());
+    CU_ASSERT(0 == addr.num_errors);
+
+    // nullptr is ignored.
+    record_downstream_result(nullptr, true);
+  }
+
+  ev_loop_destroy(loop);
+}
+
+void test_shrpx_worker_eject_recovery(void) {
+  auto loop = ev_loop_new(0);
+
+  {
+    Worker worker(loop, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                  make_eject_downstream_config(2));
+
+    auto &addr = worker.get_downstream_addr_groups()[0]->shared_addr->addrs[0];
+
+    CU_ASSERT(0 == addr.rise);
+
+    record_downstream_result(&addr, true);
+    record_downstream_result(&addr, true);
+
+    CU_ASSERT(addr.connect_blocker->in_offline());
+
+    // Even if "rise" is 0, nghttpx attempts to connect to an ejected
+    // address, and brings it back online if it succeeds.
+    CU_ASSERT(addr.live_check->scheduled());
+
+    addr.live_check->on_success();
+
+    CU_ASSERT(!addr.connect_blocker->in_offline());
+    CU_ASSERT(!addr.connect_blocker->blocked());
+  }
+
+  ev_loop_destroy(loop);
+}
+
 } // namespace shrpx
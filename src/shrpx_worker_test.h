@@ -32,6 +32,9 @@
 namespace shrpx {
 
 void test_shrpx_worker_match_downstream_addr_group(void);
+void test_shrpx_worker_retry_budget(void);
+void test_shrpx_worker_record_downstream_result(void);
+void test_shrpx_worker_eject_recovery(void);
 
 } // namespace shrpx
 
@@ -33,6 +33,10 @@
 #include "nghttp2_pq_test.h"
 #include "nghttp2_map_test.h"
 #include "nghttp2_queue_test.h"
+#include "nghttp2_objpool_test.h"
+#include "nghttp2_mpscq_test.h"
+#include "nghttp2_wheel_test.h"
+#include "nghttp2_extpri_test.h"
 #include "nghttp2_session_test.h"
 #include "nghttp2_frame_test.h"
 #include "nghttp2_stream_test.h"
@@ -71,7 +75,16 @@ int main() {
       !CU_add_test(pSuite, "map", test_nghttp2_map) ||
       !CU_add_test(pSuite, "map_functional", test_nghttp2_map_functional) ||
       !CU_add_test(pSuite, "map_each_free", test_nghttp2_map_each_free) ||
+      !CU_add_test(pSuite, "map_collision", test_nghttp2_map_collision) ||
+      !CU_add_test(pSuite, "map_churn", test_nghttp2_map_churn) ||
+      !CU_add_test(pSuite, "map_strided", test_nghttp2_map_strided) ||
       !CU_add_test(pSuite, "queue", test_nghttp2_queue) ||
+      !CU_add_test(pSuite, "objpool", test_nghttp2_objpool) ||
+      !CU_add_test(pSuite, "mpscq", test_nghttp2_mpscq) ||
+      !CU_add_test(pSuite, "wheel", test_nghttp2_wheel) ||
+      !CU_add_test(pSuite, "extpri_parse_priority",
+                   test_nghttp2_extpri_parse_priority) ||
+      !CU_add_test(pSuite, "extpri_to_uint8", test_nghttp2_extpri_to_uint8) ||
       !CU_add_test(pSuite, "npn", test_nghttp2_npn) ||
       !CU_add_test(pSuite, "session_recv", test_nghttp2_session_recv) ||
       !CU_add_test(pSuite, "session_recv_invalid_stream_id",
@@ -85,6 +98,8 @@ int main() {
                    test_nghttp2_session_recv_data_no_auto_flow_control) ||
       !CU_add_test(pSuite, "session_recv_continuation",
                    test_nghttp2_session_recv_continuation) ||
+      !CU_add_test(pSuite, "session_recv_header_list_too_large",
+                   test_nghttp2_session_recv_header_list_too_large) ||
       !CU_add_test(pSuite, "session_recv_headers_with_priority",
                    test_nghttp2_session_recv_headers_with_priority) ||
       !CU_add_test(pSuite, "session_recv_headers_with_padding",
@@ -109,6 +124,8 @@ int main() {
                    test_nghttp2_session_recv_altsvc) ||
       !CU_add_test(pSuite, "session_recv_origin",
                    test_nghttp2_session_recv_origin) ||
+      !CU_add_test(pSuite, "session_recv_priority_update",
+                   test_nghttp2_session_recv_priority_update) ||
       !CU_add_test(pSuite, "session_continue", test_nghttp2_session_continue) ||
       !CU_add_test(pSuite, "session_add_frame",
                    test_nghttp2_session_add_frame) ||
@@ -209,6 +226,8 @@ int main() {
       !CU_add_test(pSuite, "submit_extension", test_nghttp2_submit_extension) ||
       !CU_add_test(pSuite, "submit_altsvc", test_nghttp2_submit_altsvc) ||
       !CU_add_test(pSuite, "submit_origin", test_nghttp2_submit_origin) ||
+      !CU_add_test(pSuite, "submit_priority_update",
+                   test_nghttp2_submit_priority_update) ||
       !CU_add_test(pSuite, "session_open_stream",
                    test_nghttp2_session_open_stream) ||
       !CU_add_test(pSuite, "session_open_stream_with_idle_stream_dep",
@@ -247,6 +266,14 @@ int main() {
                    test_nghttp2_session_data_backoff_by_high_pri_frame) ||
       !CU_add_test(pSuite, "session_pack_data_with_padding",
                    test_nghttp2_session_pack_data_with_padding) ||
+      !CU_add_test(pSuite, "session_select_hd_indexing",
+                   test_nghttp2_session_select_hd_indexing) ||
+      !CU_add_test(pSuite, "session_hd_template",
+                   test_nghttp2_session_hd_template) ||
+      !CU_add_test(pSuite, "session_hd_inflate_zero_copy",
+                   test_nghttp2_session_hd_inflate_zero_copy) ||
+      !CU_add_test(pSuite, "session_object_pool",
+                   test_nghttp2_session_object_pool) ||
       !CU_add_test(pSuite, "session_pack_headers_with_padding",
                    test_nghttp2_session_pack_headers_with_padding) ||
       !CU_add_test(pSuite, "pack_settings_payload",
@@ -280,6 +307,8 @@ int main() {
                    test_nghttp2_session_detach_idle_stream) ||
       !CU_add_test(pSuite, "session_large_dep_tree",
                    test_nghttp2_session_large_dep_tree) ||
+      !CU_add_test(pSuite, "session_flat_tree_scheduling",
+                   test_nghttp2_session_flat_tree_scheduling) ||
       !CU_add_test(pSuite, "session_graceful_shutdown",
                    test_nghttp2_session_graceful_shutdown) ||
       !CU_add_test(pSuite, "session_on_header_temporal_failure",
@@ -296,6 +325,21 @@ int main() {
                    test_nghttp2_session_reset_pending_headers) ||
       !CU_add_test(pSuite, "session_send_data_callback",
                    test_nghttp2_session_send_data_callback) ||
+      !CU_add_test(pSuite, "session_mem_sendv",
+                   test_nghttp2_session_mem_sendv) ||
+      !CU_add_test(pSuite, "session_mem_send_batch",
+                   test_nghttp2_session_mem_send_batch) ||
+      !CU_add_test(pSuite, "session_submission_queue",
+                   test_nghttp2_session_submission_queue) ||
+      !CU_add_test(pSuite, "session_max_session_memory",
+                   test_nghttp2_session_max_session_memory) ||
+      !CU_add_test(pSuite, "session_compact_retained_streams",
+                   test_nghttp2_session_compact_retained_streams) ||
+      !CU_add_test(pSuite, "session_auto_window_tuning",
+                   test_nghttp2_session_auto_window_tuning) ||
+      !CU_add_test(pSuite, "session_stats", test_nghttp2_session_stats) ||
+      !CU_add_test(pSuite, "session_mem_recv_split",
+                   test_nghttp2_session_mem_recv_split) ||
       !CU_add_test(pSuite, "session_on_begin_headers_temporal_failure",
                    test_nghttp2_session_on_begin_headers_temporal_failure) ||
       !CU_add_test(pSuite, "session_defer_then_close",
@@ -305,6 +349,12 @@ int main() {
       !CU_add_test(pSuite, "session_flooding", test_nghttp2_session_flooding) ||
       !CU_add_test(pSuite, "session_change_stream_priority",
                    test_nghttp2_session_change_stream_priority) ||
+      !CU_add_test(pSuite, "session_extpri_scheduling",
+                   test_nghttp2_session_extpri_scheduling) ||
+      !CU_add_test(pSuite, "session_change_extpri_stream_priority",
+                   test_nghttp2_session_change_extpri_stream_priority) ||
+      !CU_add_test(pSuite, "session_no_rfc7540_priorities",
+                   test_nghttp2_session_no_rfc7540_priorities) ||
       !CU_add_test(pSuite, "session_repeated_priority_change",
                    test_nghttp2_session_repeated_priority_change) ||
       !CU_add_test(pSuite, "session_repeated_priority_submission",
@@ -362,6 +412,8 @@ int main() {
                    test_nghttp2_frame_pack_altsvc) ||
       !CU_add_test(pSuite, "frame_pack_origin",
                    test_nghttp2_frame_pack_origin) ||
+      !CU_add_test(pSuite, "frame_pack_priority_update",
+                   test_nghttp2_frame_pack_priority_update) ||
       !CU_add_test(pSuite, "nv_array_copy", test_nghttp2_nv_array_copy) ||
       !CU_add_test(pSuite, "iv_check", test_nghttp2_iv_check) ||
       !CU_add_test(pSuite, "hd_deflate", test_nghttp2_hd_deflate) ||
@@ -387,6 +439,8 @@ int main() {
                    test_nghttp2_hd_inflate_expect_table_size_update) ||
       !CU_add_test(pSuite, "hd_inflate_unexpected_table_size_update",
                    test_nghttp2_hd_inflate_unexpected_table_size_update) ||
+      !CU_add_test(pSuite, "hd_inflate_zero_copy",
+                   test_nghttp2_hd_inflate_zero_copy) ||
       !CU_add_test(pSuite, "hd_ringbuf_reserve",
                    test_nghttp2_hd_ringbuf_reserve) ||
       !CU_add_test(pSuite, "hd_change_table_size",
@@ -394,18 +448,31 @@ int main() {
       !CU_add_test(pSuite, "hd_deflate_inflate",
                    test_nghttp2_hd_deflate_inflate) ||
       !CU_add_test(pSuite, "hd_no_index", test_nghttp2_hd_no_index) ||
+      !CU_add_test(pSuite, "hd_deflate_adaptive_indexing",
+                   test_nghttp2_hd_deflate_adaptive_indexing) ||
+      !CU_add_test(pSuite, "hd_deflate_indexing_callback",
+                   test_nghttp2_hd_deflate_indexing_callback) ||
+      !CU_add_test(pSuite, "hd_deflate_template",
+                   test_nghttp2_hd_deflate_template) ||
+      !CU_add_test(pSuite, "hd_deflate_template_shrink",
+                   test_nghttp2_hd_deflate_template_shrink) ||
       !CU_add_test(pSuite, "hd_deflate_bound", test_nghttp2_hd_deflate_bound) ||
       !CU_add_test(pSuite, "hd_public_api", test_nghttp2_hd_public_api) ||
       !CU_add_test(pSuite, "hd_deflate_hd_vec",
                    test_nghttp2_hd_deflate_hd_vec) ||
       !CU_add_test(pSuite, "hd_decode_length", test_nghttp2_hd_decode_length) ||
       !CU_add_test(pSuite, "hd_huff_encode", test_nghttp2_hd_huff_encode) ||
+      !CU_add_test(pSuite, "hd_huff_encode_random",
+                   test_nghttp2_hd_huff_encode_random) ||
+      !CU_add_test(pSuite, "hd_huff_decode", test_nghttp2_hd_huff_decode) ||
       !CU_add_test(pSuite, "adjust_local_window_size",
                    test_nghttp2_adjust_local_window_size) ||
       !CU_add_test(pSuite, "check_header_name",
                    test_nghttp2_check_header_name) ||
       !CU_add_test(pSuite, "check_header_value",
                    test_nghttp2_check_header_value) ||
+      !CU_add_test(pSuite, "check_header_impls",
+                   test_nghttp2_check_header_impls) ||
       !CU_add_test(pSuite, "bufs_add", test_nghttp2_bufs_add) ||
       !CU_add_test(pSuite, "bufs_add_stack_buffer_overflow_bug",
                    test_nghttp2_bufs_add_stack_buffer_overflow_bug) ||
@@ -0,0 +1,117 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_extpri_test.h"
+
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "nghttp2_extpri.h"
+
+#define MAKE_VALUE(S) (const uint8_t *)(S), sizeof(S) - 1
+
+void test_nghttp2_extpri_parse_priority(void) {
+  nghttp2_extpri extpri;
+
+  /* Empty value keeps the defaults */
+  extpri.urgency = NGHTTP2_EXTPRI_DEFAULT_URGENCY;
+  extpri.inc = 0;
+
+  CU_ASSERT(0 == nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("")));
+  CU_ASSERT(NGHTTP2_EXTPRI_DEFAULT_URGENCY == extpri.urgency);
+  CU_ASSERT(0 == extpri.inc);
+
+  CU_ASSERT(0 == nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("u=0")));
+  CU_ASSERT(0 == extpri.urgency);
+  CU_ASSERT(0 == extpri.inc);
+
+  /* Bare key means true */
+  extpri.urgency = NGHTTP2_EXTPRI_DEFAULT_URGENCY;
+  extpri.inc = 0;
+
+  CU_ASSERT(0 == nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("u=5, i")));
+  CU_ASSERT(5 == extpri.urgency);
+  CU_ASSERT(1 == extpri.inc);
+
+  CU_ASSERT(0 == nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("i=?0")));
+  CU_ASSERT(5 == extpri.urgency);
+  CU_ASSERT(0 == extpri.inc);
+
+  /* The last value wins */
+  CU_ASSERT(0 == nghttp2_extpri_parse_priority(&extpri,
+                                               MAKE_VALUE("u=1,u=7;a=b")));
+  CU_ASSERT(7 == extpri.urgency);
+
+  /* Unknown keys and members of invalid type are ignored */
+  extpri.urgency = NGHTTP2_EXTPRI_DEFAULT_URGENCY;
+  extpri.inc = 0;
+
+  CU_ASSERT(0 == nghttp2_extpri_parse_priority(
+                     &extpri, MAKE_VALUE("foo=(\"bar\" 1);x, u=8, i=1, "
+                                         "u=\"2\", bar=?1")));
+  CU_ASSERT(NGHTTP2_EXTPRI_DEFAULT_URGENCY == extpri.urgency);
+  CU_ASSERT(0 == extpri.inc);
+
+  /* Malformed dictionary leaves extpri untouched */
+  extpri.urgency = 2;
+  extpri.inc = 1;
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("u=0,")));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("U=0")));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("u=0 i")));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_extpri_parse_priority(&extpri, MAKE_VALUE("u=0;")));
+  CU_ASSERT(2 == extpri.urgency);
+  CU_ASSERT(1 == extpri.inc);
+}
+
+void test_nghttp2_extpri_to_uint8(void) {
+  nghttp2_extpri extpri, oextpri;
+  uint8_t u8extpri;
+
+  extpri.urgency = NGHTTP2_EXTPRI_URGENCY_LOW;
+  extpri.inc = 1;
+
+  u8extpri = nghttp2_extpri_to_uint8(&extpri);
+
+  CU_ASSERT(NGHTTP2_EXTPRI_URGENCY_LOW ==
+            nghttp2_extpri_uint8_urgency(u8extpri));
+  CU_ASSERT(nghttp2_extpri_uint8_inc(u8extpri));
+
+  nghttp2_extpri_from_uint8(&oextpri, u8extpri);
+
+  CU_ASSERT(NGHTTP2_EXTPRI_URGENCY_LOW == oextpri.urgency);
+  CU_ASSERT(1 == oextpri.inc);
+
+  extpri.urgency = NGHTTP2_EXTPRI_URGENCY_HIGH;
+  extpri.inc = 0;
+
+  u8extpri = nghttp2_extpri_to_uint8(&extpri);
+
+  CU_ASSERT(0 == u8extpri);
+}
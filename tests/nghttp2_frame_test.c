@@ -600,6 +600,61 @@ void test_nghttp2_frame_pack_origin(void) {
   nghttp2_bufs_free(&bufs);
 }
 
+void test_nghttp2_frame_pack_priority_update(void) {
+  nghttp2_extension frame, oframe;
+  nghttp2_ext_priority_update priority_update, opriority_update;
+  nghttp2_bufs bufs;
+  int rv;
+  size_t payloadlen;
+  static const uint8_t field_value[] = "i";
+
+  frame_pack_bufs_init(&bufs);
+
+  frame.payload = &priority_update;
+  oframe.payload = &opriority_update;
+
+  nghttp2_frame_priority_update_init(&frame, 1000000007, (uint8_t *)field_value,
+                                     sizeof(field_value) - 1);
+
+  payloadlen = 4 + sizeof(field_value) - 1;
+
+  rv = nghttp2_frame_pack_priority_update(&bufs, &frame);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + payloadlen == nghttp2_bufs_len(&bufs));
+
+  rv = unpack_framebuf((nghttp2_frame *)&oframe, &bufs);
+
+  CU_ASSERT(0 == rv);
+
+  check_frame_header(payloadlen, NGHTTP2_PRIORITY_UPDATE, NGHTTP2_FLAG_NONE, 0,
+                     &oframe.hd);
+
+  CU_ASSERT(1000000007 == opriority_update.stream_id);
+  CU_ASSERT(sizeof(field_value) - 1 == opriority_update.field_value_len);
+  CU_ASSERT(0 == memcmp(field_value, opriority_update.field_value,
+                        sizeof(field_value) - 1));
+
+  nghttp2_bufs_reset(&bufs);
+
+  /* Empty field value */
+  nghttp2_frame_priority_update_init(&frame, 1, NULL, 0);
+
+  rv = nghttp2_frame_pack_priority_update(&bufs, &frame);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + 4 == nghttp2_bufs_len(&bufs));
+
+  rv = unpack_framebuf((nghttp2_frame *)&oframe, &bufs);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == opriority_update.stream_id);
+  CU_ASSERT(NULL == opriority_update.field_value);
+  CU_ASSERT(0 == opriority_update.field_value_len);
+
+  nghttp2_bufs_free(&bufs);
+}
+
 void test_nghttp2_nv_array_copy(void) {
   nghttp2_nv *nva;
   ssize_t rv;
@@ -607,6 +662,7 @@ void test_nghttp2_nv_array_copy(void) {
   nghttp2_nv nv[] = {MAKE_NV("alpha", "bravo"), MAKE_NV("charlie", "delta")};
   nghttp2_nv bignv;
   nghttp2_mem *mem;
+  nghttp2_objpool pool, *pool_ptr;
 
   mem = nghttp2_mem_default();
 
@@ -649,6 +705,39 @@ void test_nghttp2_nv_array_copy(void) {
 
   nghttp2_nv_array_del(nva, mem);
 
+  /* Copy into a buffer taken from pool */
+  nghttp2_objpool_init(&pool, 256, 256, mem);
+
+  pool_ptr = &pool;
+  rv = nghttp2_nv_array_copy2(&nva, &pool_ptr, nv, ARRLEN(nv), mem);
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(&pool == pool_ptr);
+  CU_ASSERT(nva[1].valuelen == 5);
+  CU_ASSERT(0 == memcmp("delta", nva[1].value, 5));
+
+  nghttp2_nv_array_del2(nva, pool_ptr, mem);
+
+  CU_ASSERT(1 == pool.len);
+
+  rv = nghttp2_nv_array_copy2(&nva, &pool_ptr, nv, ARRLEN(nv), mem);
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(&pool == pool_ptr);
+  CU_ASSERT(0 == pool.len);
+
+  nghttp2_nv_array_del2(nva, pool_ptr, mem);
+
+  /* Too large to fit in the buffer of pool */
+  rv = nghttp2_nv_array_copy2(&nva, &pool_ptr, &bignv, 1, mem);
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NULL == pool_ptr);
+  CU_ASSERT(1 == pool.len);
+
+  nghttp2_nv_array_del2(nva, pool_ptr, mem);
+
+  CU_ASSERT(1 == pool.len);
+
+  nghttp2_objpool_free(&pool);
+
   mem->free(bignv.value, NULL);
 }
 
@@ -25,6 +25,7 @@
 #include "nghttp2_hd_test.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 
 #include <CUnit/CUnit.h>
@@ -657,6 +658,97 @@ void test_nghttp2_hd_inflate_unexpected_table_size_update(void) {
   nghttp2_hd_inflate_free(&inflater);
 }
 
+void test_nghttp2_hd_inflate_zero_copy(void) {
+  nghttp2_hd_inflater inflater;
+  nghttp2_hd_nv nv;
+  /* cookie: sid=0123456789 (literal without indexing, indexed name) */
+  const uint8_t in1[] = {0x0f, 0x11, 0x0e, 's', 'i', 'd', '=', '0', '1',
+                         '2',  '3',  '4',  '5', '6', '7', '8', '9'};
+  /* x: y (literal with incremental indexing, new name) */
+  const uint8_t in2[] = {0x40, 0x01, 'x', 0x01, 'y'};
+  /* a: bcd (literal never indexed, new name) */
+  const uint8_t in3[] = {0x10, 0x01, 'a', 0x03, 'b', 'c', 'd'};
+  nghttp2_rcbuf *kept, *borrowed;
+  int inflate_flags;
+  ssize_t rv;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+
+  nghttp2_hd_inflate_init(&inflater, mem);
+  nghttp2_hd_inflate_set_zero_copy(&inflater, 1);
+
+  rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in1,
+                                sizeof(in1), 1);
+
+  CU_ASSERT((ssize_t)sizeof(in1) == rv);
+  CU_ASSERT(inflate_flags & NGHTTP2_HD_INFLATE_EMIT);
+  CU_ASSERT(nghttp2_rcbuf_is_borrowed(nv.value));
+  CU_ASSERT(in1 + 3 == nv.value->base);
+  CU_ASSERT(14 == nv.value->len);
+
+  /* Application keeps the value */
+  kept = nv.value;
+  nghttp2_rcbuf_incref(kept);
+
+  CU_ASSERT(0 == nghttp2_hd_inflate_unborrow(&inflater));
+  CU_ASSERT(!nghttp2_rcbuf_is_borrowed(kept));
+  CU_ASSERT(in1 + 3 != kept->base);
+  CU_ASSERT(14 == kept->len);
+  CU_ASSERT(0 == memcmp("sid=0123456789", kept->base, 15));
+
+  /* The value which is added to the dynamic table is copied */
+  rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in2,
+                                sizeof(in2), 1);
+
+  CU_ASSERT((ssize_t)sizeof(in2) == rv);
+  CU_ASSERT(!nghttp2_rcbuf_is_borrowed(nv.value));
+  CU_ASSERT(1 == inflater.ctx.hd_table.len);
+
+  rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in3,
+                                sizeof(in3), 1);
+
+  CU_ASSERT((ssize_t)sizeof(in3) == rv);
+  CU_ASSERT(NGHTTP2_NV_FLAG_NO_INDEX == nv.flags);
+  CU_ASSERT(nghttp2_rcbuf_is_borrowed(nv.value));
+  CU_ASSERT(in3 + 4 == nv.value->base);
+
+  borrowed = nv.value;
+
+  /* Nobody keeps the value, so it is not copied */
+  CU_ASSERT(0 == nghttp2_hd_inflate_unborrow(&inflater));
+  CU_ASSERT(nghttp2_rcbuf_is_borrowed(borrowed));
+
+  /* The object is reused for the next borrowed value */
+  rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in1,
+                                sizeof(in1), 1);
+
+  CU_ASSERT((ssize_t)sizeof(in1) == rv);
+  CU_ASSERT(borrowed == nv.value);
+  CU_ASSERT(in1 + 3 == nv.value->base);
+
+  /* The value which is not contained in the input buffer is copied */
+  rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in1, 5, 0);
+
+  CU_ASSERT(5 == rv);
+  CU_ASSERT(0 == (inflate_flags & NGHTTP2_HD_INFLATE_EMIT));
+
+  rv = nghttp2_hd_inflate_hd_nv(&inflater, &nv, &inflate_flags, in1 + 5,
+                                sizeof(in1) - 5, 1);
+
+  CU_ASSERT((ssize_t)sizeof(in1) - 5 == rv);
+  CU_ASSERT(inflate_flags & NGHTTP2_HD_INFLATE_EMIT);
+  CU_ASSERT(!nghttp2_rcbuf_is_borrowed(nv.value));
+  CU_ASSERT(0 == memcmp("sid=0123456789", nv.value->base, 15));
+
+  nghttp2_hd_inflate_free(&inflater);
+
+  /* The kept value outlives inflater */
+  CU_ASSERT(0 == memcmp("sid=0123456789", kept->base, 15));
+
+  nghttp2_rcbuf_decref(kept);
+}
+
 void test_nghttp2_hd_ringbuf_reserve(void) {
   nghttp2_hd_deflater deflater;
   nghttp2_hd_inflater inflater;
@@ -1208,6 +1300,400 @@ void test_nghttp2_hd_no_index(void) {
   nghttp2_hd_deflate_free(&deflater);
 }
 
+void test_nghttp2_hd_deflate_adaptive_indexing(void) {
+  nghttp2_hd_deflater deflater;
+  nghttp2_hd_inflater inflater;
+  nghttp2_bufs bufs;
+  ssize_t blocklen;
+  nghttp2_nv path = MAKE_NV(":path", "/api/v1/poll");
+  nghttp2_nv nv;
+  char value[32];
+  size_t i, len;
+  nva_out out;
+  int rv;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+
+  frame_pack_bufs_init(&bufs);
+
+  nva_out_init(&out);
+
+  /* By default, :path is never indexed */
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  for (i = 0; i < 4; ++i) {
+    rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &path, 1);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(0 == deflater.ctx.hd_table.len);
+
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  nghttp2_hd_deflate_free(&deflater);
+
+  /* With adaptive indexing, :path which recurs is indexed */
+  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_hd_inflate_init(&inflater, mem);
+
+  rv = nghttp2_hd_deflate_set_adaptive_indexing(&deflater, 1);
+
+  CU_ASSERT(0 == rv);
+
+  for (i = 0; i < 4; ++i) {
+    rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &path, 1);
+    blocklen = (ssize_t)nghttp2_bufs_len(&bufs);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(blocklen == inflate_hd(&inflater, &out, &bufs, 0, mem));
+    CU_ASSERT(1 == out.nvlen);
+    assert_nv_equal(&path, out.nva, 1, mem);
+
+    switch (i) {
+    case 0:
+    case 1:
+      CU_ASSERT(0 == deflater.ctx.hd_table.len);
+      break;
+    case 2:
+      CU_ASSERT(1 == deflater.ctx.hd_table.len);
+      break;
+    case 3:
+      /* Indexed Header Field Representation */
+      CU_ASSERT(1 == blocklen);
+      break;
+    }
+
+    nva_out_reset(&out, mem);
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  nghttp2_hd_inflate_free(&inflater);
+  nghttp2_hd_deflate_free(&deflater);
+
+  /* With adaptive indexing, header field whose value always changes
+     is not indexed once enough header fields are seen. */
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  rv = nghttp2_hd_deflate_set_adaptive_indexing(&deflater, 1);
+
+  CU_ASSERT(0 == rv);
+
+  nv.name = (uint8_t *)"x-request-id";
+  nv.namelen = strlen("x-request-id");
+  nv.value = (uint8_t *)value;
+  nv.flags = NGHTTP2_NV_FLAG_NONE;
+
+  len = 0;
+
+  for (i = 0; i < 32; ++i) {
+    nv.valuelen = (size_t)snprintf(value, sizeof(value), "%zu", i * 7919);
+
+    rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &nv, 1);
+
+    CU_ASSERT(0 == rv);
+
+    if (i == NGHTTP2_HD_SKETCH_MIN_NAME_SEEN) {
+      len = deflater.ctx.hd_table.len;
+    }
+
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  CU_ASSERT(len > 0);
+  CU_ASSERT(len == deflater.ctx.hd_table.len);
+
+  nghttp2_hd_deflate_free(&deflater);
+
+  /* Disabling adaptive indexing restores the default behaviour */
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  rv = nghttp2_hd_deflate_set_adaptive_indexing(&deflater, 1);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NULL != deflater.sketch);
+
+  rv = nghttp2_hd_deflate_set_adaptive_indexing(&deflater, 0);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NULL == deflater.sketch);
+
+  for (i = 0; i < 4; ++i) {
+    rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &path, 1);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(0 == deflater.ctx.hd_table.len);
+
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  nghttp2_hd_deflate_free(&deflater);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+static int indexing_callback(nghttp2_hd_deflater *deflater,
+                             const nghttp2_nv *nv, int suggested,
+                             void *user_data) {
+  size_t *pncalled = user_data;
+
+  (void)deflater;
+
+  ++*pncalled;
+
+  if (nv->namelen == strlen(":path") && memcmp(nv->name, ":path", 5) == 0) {
+    return NGHTTP2_HD_INDEXING_INCREMENTAL;
+  }
+
+  if (nv->namelen == strlen("x-secret") &&
+      memcmp(nv->name, "x-secret", 8) == 0) {
+    return NGHTTP2_HD_INDEXING_NEVER;
+  }
+
+  if (nv->namelen == strlen("x-bad") && memcmp(nv->name, "x-bad", 5) == 0) {
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return suggested;
+}
+
+void test_nghttp2_hd_deflate_indexing_callback(void) {
+  nghttp2_hd_deflater deflater;
+  nghttp2_hd_inflater inflater;
+  nghttp2_bufs bufs;
+  ssize_t blocklen;
+  nghttp2_nv nva[] = {
+      MAKE_NV(":path", "/api/v1/poll"),
+      MAKE_NV("x-secret", "alpha"),
+      MAKE_NV("user-agent", "nghttp2"),
+      MAKE_NV("x-private", "bravo"),
+  };
+  nghttp2_nv bad = MAKE_NV("x-bad", "charlie");
+  size_t ncalled;
+  nva_out out;
+  int rv;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+
+  nva[3].flags = NGHTTP2_NV_FLAG_NO_INDEX;
+
+  frame_pack_bufs_init(&bufs);
+
+  nva_out_init(&out);
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_hd_inflate_init(&inflater, mem);
+
+  ncalled = 0;
+  nghttp2_hd_deflate_set_indexing_callback(&deflater, indexing_callback,
+                                           &ncalled);
+
+  rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, nva, ARRLEN(nva));
+  blocklen = (ssize_t)nghttp2_bufs_len(&bufs);
+
+  CU_ASSERT(0 == rv);
+  /* Not called for the header field with NGHTTP2_NV_FLAG_NO_INDEX */
+  CU_ASSERT(3 == ncalled);
+  CU_ASSERT(blocklen == inflate_hd(&inflater, &out, &bufs, 0, mem));
+  CU_ASSERT(ARRLEN(nva) == out.nvlen);
+  assert_nv_equal(nva, out.nva, ARRLEN(nva), mem);
+
+  CU_ASSERT(NGHTTP2_NV_FLAG_NONE == out.nva[0].flags);
+  CU_ASSERT(NGHTTP2_NV_FLAG_NO_INDEX == out.nva[1].flags);
+  CU_ASSERT(NGHTTP2_NV_FLAG_NONE == out.nva[2].flags);
+  CU_ASSERT(NGHTTP2_NV_FLAG_NO_INDEX == out.nva[3].flags);
+
+  /* :path and user-agent are indexed */
+  CU_ASSERT(2 == deflater.ctx.hd_table.len);
+
+  nva_out_reset(&out, mem);
+  nghttp2_bufs_reset(&bufs);
+
+  rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &bad, 1);
+
+  CU_ASSERT(NGHTTP2_ERR_CALLBACK_FAILURE == rv);
+
+  nghttp2_bufs_reset(&bufs);
+
+  rv = nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, nva, 1);
+
+  CU_ASSERT(NGHTTP2_ERR_HEADER_COMP == rv);
+
+  nghttp2_bufs_free(&bufs);
+  nghttp2_hd_inflate_free(&inflater);
+  nghttp2_hd_deflate_free(&deflater);
+}
+
+void test_nghttp2_hd_deflate_template(void) {
+  nghttp2_hd_deflater deflater;
+  nghttp2_hd_inflater inflater;
+  nghttp2_hd_template *tmpl;
+  nghttp2_bufs bufs;
+  ssize_t blocklen, first_blocklen;
+  nghttp2_nv tmpl_nva[] = {
+      MAKE_NV(":status", "200"),
+      MAKE_NV("server", "nghttp2"),
+      MAKE_NV("content-type", "application/json"),
+      MAKE_NV("x-secret", "alpha"),
+      MAKE_NV("etag", "\"5b73e6a1-1d4c\""),
+  };
+  nghttp2_nv nva[] = {MAKE_NV("content-length", "1234")};
+  nghttp2_nv expected[] = {
+      MAKE_NV(":status", "200"),
+      MAKE_NV("content-length", "1234"),
+      MAKE_NV("server", "nghttp2"),
+      MAKE_NV("content-type", "application/json"),
+      MAKE_NV("x-secret", "alpha"),
+      MAKE_NV("etag", "\"5b73e6a1-1d4c\""),
+  };
+  nghttp2_nv bad_nva[] = {MAKE_NV("server", "nghttp2"),
+                          MAKE_NV(":status", "200")};
+  nghttp2_nv *nva_copy;
+  size_t i;
+  nva_out out;
+  int rv;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+
+  tmpl_nva[3].flags = NGHTTP2_NV_FLAG_NO_INDEX;
+  expected[4].flags = NGHTTP2_NV_FLAG_NO_INDEX;
+
+  frame_pack_bufs_init(&bufs);
+
+  nva_out_init(&out);
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_hd_inflate_init(&inflater, mem);
+
+  nghttp2_nv_array_copy(&nva_copy, bad_nva, ARRLEN(bad_nva), mem);
+  rv = nghttp2_hd_template_new(&tmpl, &deflater, nva_copy, ARRLEN(bad_nva),
+                               mem);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+
+  nghttp2_nv_array_copy(&nva_copy, tmpl_nva, ARRLEN(tmpl_nva), mem);
+  rv = nghttp2_hd_template_new(&tmpl, &deflater, nva_copy, ARRLEN(tmpl_nva),
+                               mem);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == tmpl->npseudo);
+  /* :status: 200 and x-secret are pre-encoded */
+  CU_ASSERT(0 < tmpl->fields[0].enclen);
+  CU_ASSERT(0 == tmpl->fields[1].enclen);
+  CU_ASSERT(0 == tmpl->fields[2].enclen);
+  CU_ASSERT(0 < tmpl->fields[3].enclen);
+  CU_ASSERT(0 == tmpl->fields[4].enclen);
+
+  first_blocklen = 0;
+
+  for (i = 0; i < 4; ++i) {
+    if (i == 2) {
+      /* Evict all entries in dynamic table */
+      nghttp2_hd_deflate_change_table_size(&deflater, 0);
+      nghttp2_hd_deflate_change_table_size(&deflater, 4096);
+    }
+
+    rv = nghttp2_hd_deflate_hd_template_bufs(&deflater, &bufs, tmpl, nva,
+                                             ARRLEN(nva));
+    blocklen = (ssize_t)nghttp2_bufs_len(&bufs);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(blocklen == inflate_hd(&inflater, &out, &bufs, 0, mem));
+    CU_ASSERT(ARRLEN(expected) == out.nvlen);
+    assert_nv_equal(expected, out.nva, ARRLEN(expected), mem);
+    CU_ASSERT(NGHTTP2_NV_FLAG_NO_INDEX == out.nva[4].flags);
+    /* server, content-type, and etag */
+    CU_ASSERT(3 == deflater.ctx.hd_table.len);
+
+    switch (i) {
+    case 0:
+      first_blocklen = blocklen;
+      break;
+    case 1:
+    case 3:
+      CU_ASSERT(blocklen < first_blocklen);
+      CU_ASSERT(tmpl->fields[1].seq_valid);
+      CU_ASSERT(tmpl->fields[2].seq_valid);
+      CU_ASSERT(tmpl->fields[4].seq_valid);
+      break;
+    }
+
+    nva_out_reset(&out, mem);
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  nghttp2_hd_template_decref(tmpl);
+
+  nghttp2_bufs_free(&bufs);
+  nghttp2_hd_inflate_free(&inflater);
+  nghttp2_hd_deflate_free(&deflater);
+}
+
+void test_nghttp2_hd_deflate_template_shrink(void) {
+  nghttp2_hd_deflater deflater;
+  nghttp2_hd_inflater inflater;
+  nghttp2_hd_template *tmpl;
+  nghttp2_bufs bufs;
+  ssize_t blocklen;
+  uint8_t value[100];
+  nghttp2_nv nv = MAKE_NV("x-custom", "");
+  nghttp2_nv *nva_copy;
+  size_t i;
+  nva_out out;
+  int rv;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+
+  memset(value, 'a', sizeof(value));
+  nv.value = value;
+  nv.valuelen = sizeof(value);
+
+  frame_pack_bufs_init(&bufs);
+
+  nva_out_init(&out);
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_hd_inflate_init(&inflater, mem);
+
+  nghttp2_nv_array_copy(&nva_copy, &nv, 1, mem);
+  rv = nghttp2_hd_template_new(&tmpl, &deflater, nva_copy, 1, mem);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == tmpl->fields[0].enclen);
+
+  /* The entry takes 140 bytes, which is more than 3/4 of the new
+     table size, so it must not be indexed. */
+  nghttp2_hd_deflate_change_table_size(&deflater, 160);
+
+  for (i = 0; i < 2; ++i) {
+    if (i == 1) {
+      nghttp2_hd_deflate_change_table_size(&deflater, 4096);
+    }
+
+    rv = nghttp2_hd_deflate_hd_template_bufs(&deflater, &bufs, tmpl, NULL, 0);
+    blocklen = (ssize_t)nghttp2_bufs_len(&bufs);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(blocklen == inflate_hd(&inflater, &out, &bufs, 0, mem));
+    CU_ASSERT(1 == out.nvlen);
+    assert_nv_equal(&nv, out.nva, 1, mem);
+    CU_ASSERT(i == deflater.ctx.hd_table.len);
+    CU_ASSERT(i == inflater.ctx.hd_table.len);
+
+    nva_out_reset(&out, mem);
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  nghttp2_hd_template_decref(tmpl);
+
+  nghttp2_bufs_free(&bufs);
+  nghttp2_hd_inflate_free(&inflater);
+  nghttp2_hd_deflate_free(&deflater);
+}
+
 void test_nghttp2_hd_deflate_bound(void) {
   nghttp2_hd_deflater deflater;
   nghttp2_nv nva[] = {MAKE_NV(":method", "GET"), MAKE_NV("alpha", "bravo")};
@@ -1538,3 +2024,236 @@ void test_nghttp2_hd_huff_encode(void) {
 
   nghttp2_bufs_free(&bufs);
 }
+
+/*
+ * Encodes |src| of length |srclen| bit by bit using huff_sym_table,
+ * and writes the result to |dest|.  Returns the number of bytes
+ * written.
+ */
+static size_t huff_encode_reference(uint8_t *dest, const uint8_t *src,
+                                    size_t srclen) {
+  size_t i, j, nbits = 0;
+  const nghttp2_huff_sym *sym;
+
+  memset(dest, 0, nghttp2_hd_huff_encode_count(src, srclen));
+
+  for (i = 0; i < srclen; ++i) {
+    sym = &huff_sym_table[src[i]];
+    for (j = sym->nbits; j > 0; --j, ++nbits) {
+      if ((sym->code >> (j - 1)) & 1) {
+        dest[nbits / 8] = (uint8_t)(dest[nbits / 8] | (0x80 >> (nbits % 8)));
+      }
+    }
+  }
+
+  /* pad with the prefix of EOS */
+  for (; nbits % 8; ++nbits) {
+    dest[nbits / 8] = (uint8_t)(dest[nbits / 8] | (0x80 >> (nbits % 8)));
+  }
+
+  return nbits / 8;
+}
+
+void test_nghttp2_hd_huff_encode_random(void) {
+  nghttp2_mem *mem = nghttp2_mem_default();
+  nghttp2_bufs bufs;
+  nghttp2_buf_chain *ci;
+  uint8_t src[128], expected[512], out[1024];
+  size_t srclen, explen, outlen, prefixlen, chunklen, i, j;
+  int rv;
+
+  srand(1000000009);
+
+  for (i = 0; i < 10000; ++i) {
+    srclen = (size_t)rand() % sizeof(src);
+    for (j = 0; j < srclen; ++j) {
+      src[j] = (uint8_t)(rand() % 2 ? 0x20 + rand() % 0x5f : rand() % 256);
+    }
+
+    explen = huff_encode_reference(expected, src, srclen);
+
+    /* Small chunks exercise the path which crosses chunk boundary,
+       and the prefix changes the alignment of the output. */
+    chunklen = (size_t)rand() % 2 ? (size_t)rand() % 8 + 1 : 4096;
+    prefixlen = (size_t)rand() % 4;
+
+    rv = nghttp2_bufs_init(&bufs, chunklen, 1024, mem);
+
+    CU_ASSERT(0 == rv);
+
+    for (j = 0; j < prefixlen; ++j) {
+      nghttp2_bufs_addb(&bufs, 0xa5);
+    }
+
+    rv = nghttp2_hd_huff_encode(&bufs, src, srclen);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(prefixlen + explen == nghttp2_bufs_len(&bufs));
+
+    outlen = 0;
+    for (ci = bufs.head; ci; ci = ci->next) {
+      memcpy(out + outlen, ci->buf.pos, nghttp2_buf_len(&ci->buf));
+      outlen += nghttp2_buf_len(&ci->buf);
+    }
+
+    CU_ASSERT(prefixlen + explen == outlen);
+    CU_ASSERT(0 == memcmp(expected, out + prefixlen, explen));
+
+    nghttp2_bufs_free(&bufs);
+  }
+}
+
+/*
+ * Decodes |src| of length |srclen| bit by bit using huff_sym_table,
+ * and writes the result to |dest|.  Returns the number of bytes
+ * written, or -1 if |src| is not a valid huffman encoded string.
+ */
+static ssize_t huff_decode_reference(uint8_t *dest, const uint8_t *src,
+                                     size_t srclen) {
+  uint32_t code = 0;
+  size_t nbits = 0;
+  size_t i, j;
+  uint8_t *p = dest;
+
+  for (i = 0; i < srclen * 8; ++i) {
+    code = (code << 1) | ((src[i / 8] >> (7 - i % 8)) & 1);
+    ++nbits;
+
+    for (j = 0; j < 257; ++j) {
+      if (huff_sym_table[j].nbits == nbits && huff_sym_table[j].code == code) {
+        break;
+      }
+    }
+
+    if (j == 257) {
+      continue;
+    }
+
+    if (j == 256) {
+      return -1;
+    }
+
+    *p++ = (uint8_t)j;
+    code = 0;
+    nbits = 0;
+  }
+
+  if (nbits > 7 || code != (1u << nbits) - 1) {
+    return -1;
+  }
+
+  return p - dest;
+}
+
+void test_nghttp2_hd_huff_decode(void) {
+  const uint8_t eos_in_middle[] = {0x1f, 0xff, 0xff, 0xff, 0xff};
+  const uint8_t too_long_padding[] = {0x1f, 0xff};
+  const uint8_t zero_padding[] = {0x18};
+  nghttp2_hd_huff_decode_context ctx;
+  nghttp2_bufs bufs;
+  nghttp2_buf outbuf;
+  uint8_t src[64], enc[256], b[512], expected[512];
+  ssize_t len, explen;
+  size_t srclen, enclen, i, j, k, off, n;
+  int rv;
+
+  srand(1000000007);
+
+  nghttp2_buf_wrap_init(&outbuf, b, sizeof(b));
+
+  /* "0" followed by EOS */
+  nghttp2_hd_huff_decode_context_init(&ctx);
+  len = nghttp2_hd_huff_decode(&ctx, &outbuf, eos_in_middle,
+                               sizeof(eos_in_middle), 1);
+
+  CU_ASSERT(NGHTTP2_ERR_HEADER_COMP == len);
+
+  /* "0" followed by 11 bits of padding */
+  nghttp2_buf_reset(&outbuf);
+  nghttp2_hd_huff_decode_context_init(&ctx);
+  len = nghttp2_hd_huff_decode(&ctx, &outbuf, too_long_padding,
+                               sizeof(too_long_padding), 1);
+
+  CU_ASSERT(NGHTTP2_ERR_HEADER_COMP == len);
+
+  /* "3" followed by padding with 0 */
+  nghttp2_buf_reset(&outbuf);
+  nghttp2_hd_huff_decode_context_init(&ctx);
+  len = nghttp2_hd_huff_decode(&ctx, &outbuf, zero_padding,
+                               sizeof(zero_padding), 1);
+
+  CU_ASSERT(NGHTTP2_ERR_HEADER_COMP == len);
+
+  /* Round trip with all symbols, fed in random sized chunks */
+  for (i = 0; i < 1000; ++i) {
+    srclen = (size_t)rand() % sizeof(src);
+    for (j = 0; j < srclen; ++j) {
+      /* Prefer printable characters which have short codes */
+      src[j] = (uint8_t)(rand() % 4 ? 0x20 + rand() % 0x5f : rand() % 256);
+    }
+
+    frame_pack_bufs_init(&bufs);
+
+    rv = nghttp2_hd_huff_encode(&bufs, src, srclen);
+
+    CU_ASSERT(0 == rv);
+
+    enclen = nghttp2_bufs_len(&bufs);
+
+    nghttp2_buf_reset(&outbuf);
+    nghttp2_hd_huff_decode_context_init(&ctx);
+
+    for (off = 0; off < enclen; off += n) {
+      n = (size_t)rand() % 8 + 1;
+      if (n > enclen - off) {
+        n = enclen - off;
+      }
+      len = nghttp2_hd_huff_decode(&ctx, &outbuf, bufs.head->buf.pos + off,
+                                   n, off + n == enclen);
+
+      CU_ASSERT((ssize_t)n == len);
+    }
+
+    CU_ASSERT(srclen == nghttp2_buf_len(&outbuf));
+    CU_ASSERT(0 == memcmp(src, outbuf.pos, srclen));
+
+    nghttp2_bufs_free(&bufs);
+  }
+
+  /* Compare against the reference decoder with arbitrary input,
+     which is mostly invalid. */
+  for (i = 0; i < 10000; ++i) {
+    enclen = (size_t)rand() % 16;
+    for (j = 0; j < enclen; ++j) {
+      k = (size_t)rand() % 3;
+      /* Bias toward 1 bits to exercise long codes and padding */
+      enc[j] = (uint8_t)(k == 0 ? rand() % 256 : k == 1 ? 0xff : rand() | 0xf0);
+    }
+
+    explen = huff_decode_reference(expected, enc, enclen);
+
+    nghttp2_buf_reset(&outbuf);
+    nghttp2_hd_huff_decode_context_init(&ctx);
+
+    len = 0;
+    for (off = 0; off < enclen || off == 0; off += n) {
+      n = (size_t)rand() % 4;
+      if (n > enclen - off) {
+        n = enclen - off;
+      }
+      len = nghttp2_hd_huff_decode(&ctx, &outbuf, enc + off, n,
+                                   off + n == enclen);
+      if (len < 0 || enclen == 0) {
+        break;
+      }
+    }
+
+    if (explen < 0) {
+      CU_ASSERT(NGHTTP2_ERR_HEADER_COMP == len);
+    } else {
+      CU_ASSERT(len >= 0);
+      CU_ASSERT((size_t)explen == nghttp2_buf_len(&outbuf));
+      CU_ASSERT(0 == memcmp(expected, outbuf.pos, (size_t)explen));
+    }
+  }
+}
@@ -24,6 +24,9 @@
  */
 #include "nghttp2_helper_test.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <CUnit/CUnit.h>
 
 #include "nghttp2_helper.h"
@@ -167,3 +170,60 @@ void test_nghttp2_check_header_value(void) {
   CU_ASSERT(!check_header_value(badval1));
   CU_ASSERT(!check_header_value(badval2));
 }
+
+void test_nghttp2_check_header_impls(void) {
+  nghttp2_check_header_impl impls[NGHTTP2_CHECK_HEADER_MAX_IMPLS];
+  const nghttp2_check_header_impl *generic = &impls[0];
+  size_t nimpls, i, len, pos, j;
+  int c;
+  uint8_t buf[80];
+
+  nimpls = nghttp2_check_header_impls(impls);
+
+  CU_ASSERT(nimpls >= 1);
+  CU_ASSERT(0 == strcmp("generic", generic->name));
+
+  /* Put every byte at every position for all input lengths which
+     cover several vector blocks and their overlapping tail. */
+  for (i = 0; i < nimpls; ++i) {
+    const nghttp2_check_header_impl *impl = &impls[i];
+
+    for (len = nghttp2_max(impl->min_len, 1); len <= sizeof(buf); ++len) {
+      for (pos = 0; pos < len; ++pos) {
+        for (c = 0; c < 256; ++c) {
+          memset(buf, 'a', len);
+          buf[pos] = (uint8_t)c;
+
+          CU_ASSERT(generic->check_name(buf, len) ==
+                    impl->check_name(buf, len));
+          CU_ASSERT(generic->check_value(buf, len) ==
+                    impl->check_value(buf, len));
+        }
+      }
+    }
+  }
+
+  /* The public functions with random input */
+  srand(1000000007);
+
+  for (j = 0; j < 100000; ++j) {
+    len = (size_t)rand() % sizeof(buf);
+    for (pos = 0; pos < len; ++pos) {
+      /* Mostly valid characters to reach the end of input */
+      buf[pos] = (uint8_t)(rand() % 64 ? 'a' + rand() % 26 : rand() % 256);
+    }
+    if (len && rand() % 4 == 0) {
+      buf[0] = ':';
+    }
+
+    if (len > 1 && buf[0] == ':') {
+      CU_ASSERT(generic->check_name(buf + 1, len - 1) ==
+                nghttp2_check_header_name(buf, len));
+    } else {
+      CU_ASSERT((len && generic->check_name(buf, len)) ==
+                nghttp2_check_header_name(buf, len));
+    }
+    CU_ASSERT(generic->check_value(buf, len) ==
+              nghttp2_check_header_value(buf, len));
+  }
+}
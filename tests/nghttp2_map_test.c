@@ -27,6 +27,7 @@
 #include <CUnit/CUnit.h>
 
 #include "nghttp2_map.h"
+#include "nghttp2_test_helper.h"
 
 typedef struct strentry {
   nghttp2_map_entry map_entry;
@@ -130,13 +131,16 @@ void test_nghttp2_map_functional(void) {
   /* find */
   shuffle(order, NUM_ENT);
   for (i = 0; i < NUM_ENT; ++i) {
-    nghttp2_map_find(&map, order[i]);
+    CU_ASSERT(&arr[order[i] - 1].map_entry ==
+              nghttp2_map_find(&map, order[i]));
   }
   /* remove */
   shuffle(order, NUM_ENT);
   for (i = 0; i < NUM_ENT; ++i) {
     CU_ASSERT(0 == nghttp2_map_remove(&map, order[i]));
+    CU_ASSERT(NULL == nghttp2_map_find(&map, order[i]));
   }
+  CU_ASSERT(0 == nghttp2_map_size(&map));
 
   /* each_free (but no op function for testing purpose) */
   for (i = 0; i < NUM_ENT; ++i) {
@@ -179,3 +183,166 @@ void test_nghttp2_map_each_free(void) {
   nghttp2_map_each_free(&map, entry_free, mem);
   nghttp2_map_free(&map);
 }
+
+static int counteachfun(nghttp2_map_entry *entry, void *ptr) {
+  size_t *pcount = ptr;
+  (void)entry;
+
+  ++*pcount;
+
+  return 0;
+}
+
+/* Same as hash() in nghttp2_map.c */
+static uint32_t map_hash(key_type key, uint32_t bits) {
+  return (uint32_t)key * 2654435769u >> (32 - bits);
+}
+
+/* Returns the first key greater than |key| which is hashed to
+   |idx|. */
+static key_type next_key_with_hash(key_type key, uint32_t idx,
+                                   uint32_t bits) {
+  for (++key; map_hash(key, bits) != idx; ++key)
+    ;
+
+  return key;
+}
+
+void test_nghttp2_map_collision(void) {
+  strentry ents[16];
+  nghttp2_map map;
+  uint32_t tablelen, bits, idx;
+  key_type key;
+  size_t i, count;
+
+  nghttp2_map_init(&map, nghttp2_mem_default());
+
+  tablelen = map.tablelen;
+  bits = map.tablelenbits;
+  idx = map_hash(1, bits);
+
+  /* All keys are hashed to the same bucket */
+  key = 0;
+  for (i = 0; i < ARRLEN(ents); ++i) {
+    key = next_key_with_hash(key, idx, bits);
+    strentry_init(&ents[i], key, "foo");
+    CU_ASSERT(0 == nghttp2_map_insert(&map, &ents[i].map_entry));
+  }
+
+  CU_ASSERT(ARRLEN(ents) == nghttp2_map_size(&map));
+
+  /* Keys hashed to the buckets occupied by the colliding keys */
+  strentry_init(&arr[0],
+                next_key_with_hash(0, (idx + 1) & (tablelen - 1), bits), "bar");
+  strentry_init(&arr[1],
+                next_key_with_hash(0, (idx + 2) & (tablelen - 1), bits), "baz");
+
+  CU_ASSERT(0 == nghttp2_map_insert(&map, &arr[0].map_entry));
+  CU_ASSERT(0 == nghttp2_map_insert(&map, &arr[1].map_entry));
+
+  /* Duplicated key is detected after the other keys */
+  strentry_init(&arr[2], ents[15].map_entry.key, "FOO");
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_map_insert(&map, &arr[2].map_entry));
+
+  /* Remove the keys in the middle of the probe sequence */
+  for (i = 0; i < ARRLEN(ents); i += 2) {
+    CU_ASSERT(0 == nghttp2_map_remove(&map, ents[i].map_entry.key));
+  }
+
+  CU_ASSERT(ARRLEN(ents) / 2 + 2 == nghttp2_map_size(&map));
+
+  for (i = 0; i < ARRLEN(ents); ++i) {
+    if (i % 2 == 0) {
+      CU_ASSERT(NULL == nghttp2_map_find(&map, ents[i].map_entry.key));
+    } else {
+      CU_ASSERT(&ents[i].map_entry ==
+                nghttp2_map_find(&map, ents[i].map_entry.key));
+    }
+  }
+
+  CU_ASSERT(&arr[0].map_entry == nghttp2_map_find(&map, arr[0].map_entry.key));
+  CU_ASSERT(&arr[1].map_entry == nghttp2_map_find(&map, arr[1].map_entry.key));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_map_remove(&map, ents[0].map_entry.key));
+
+  count = 0;
+  nghttp2_map_each(&map, counteachfun, &count);
+
+  CU_ASSERT(nghttp2_map_size(&map) == count);
+
+  nghttp2_map_free(&map);
+}
+
+void test_nghttp2_map_churn(void) {
+  nghttp2_map map;
+  int i;
+  key_type key;
+
+  nghttp2_map_init(&map, nghttp2_mem_default());
+
+  /* Keep NUM_ENT / 2 streams open, and open and close streams like a
+     busy connection does. */
+  for (i = 0; i < NUM_ENT / 2; ++i) {
+    strentry_init(&arr[i], 2 * i + 1, "foo");
+    CU_ASSERT(0 == nghttp2_map_insert(&map, &arr[i].map_entry));
+  }
+
+  key = NUM_ENT + 1;
+
+  for (i = 0; i < NUM_ENT * 4; ++i) {
+    strentry *ent = &arr[i % (NUM_ENT / 2)];
+
+    CU_ASSERT(0 == nghttp2_map_remove(&map, ent->map_entry.key));
+    CU_ASSERT(NULL == nghttp2_map_find(&map, ent->map_entry.key));
+
+    strentry_init(ent, key, "foo");
+    CU_ASSERT(0 == nghttp2_map_insert(&map, &ent->map_entry));
+    CU_ASSERT(&ent->map_entry == nghttp2_map_find(&map, key));
+
+    key += 2;
+  }
+
+  CU_ASSERT(NUM_ENT / 2 == nghttp2_map_size(&map));
+
+  for (i = 0; i < NUM_ENT / 2; ++i) {
+    CU_ASSERT(&arr[i].map_entry ==
+              nghttp2_map_find(&map, arr[i].map_entry.key));
+  }
+
+  nghttp2_map_free(&map);
+}
+
+void test_nghttp2_map_strided(void) {
+  nghttp2_map map;
+  int i;
+  uint32_t j, maxpsl;
+
+  nghttp2_map_init(&map, nghttp2_mem_default());
+
+  /* The peer can choose stream IDs spaced a power of 2 apart.  They
+     must not end up in the same probe sequence. */
+  for (i = 0; i < NUM_ENT; ++i) {
+    strentry_init(&arr[i], (key_type)(1 + i * 65536), "foo");
+    CU_ASSERT(0 == nghttp2_map_insert(&map, &arr[i].map_entry));
+  }
+
+  CU_ASSERT(NUM_ENT == nghttp2_map_size(&map));
+
+  for (i = 0; i < NUM_ENT; ++i) {
+    CU_ASSERT(&arr[i].map_entry ==
+              nghttp2_map_find(&map, arr[i].map_entry.key));
+  }
+
+  maxpsl = 0;
+  for (j = 0; j < map.tablelen; ++j) {
+    if (map.table[j].data && map.table[j].psl > maxpsl) {
+      maxpsl = map.table[j].psl;
+    }
+  }
+
+  CU_ASSERT(maxpsl < 32);
+
+  nghttp2_map_free(&map);
+}
@@ -32,5 +32,8 @@
 void test_nghttp2_map(void);
 void test_nghttp2_map_functional(void);
 void test_nghttp2_map_each_free(void);
+void test_nghttp2_map_collision(void);
+void test_nghttp2_map_churn(void);
+void test_nghttp2_map_strided(void);
 
 #endif /* NGHTTP2_MAP_TEST_H */
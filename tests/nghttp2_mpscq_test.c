@@ -0,0 +1,65 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_mpscq_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "nghttp2_mpscq.h"
+
+void test_nghttp2_mpscq(void) {
+  nghttp2_mpscq q;
+  nghttp2_mpscq_entry ents[4];
+  nghttp2_mpscq_entry *ent;
+
+  nghttp2_mpscq_init(&q);
+
+  CU_ASSERT(nghttp2_mpscq_empty(&q));
+  CU_ASSERT(NULL == nghttp2_mpscq_pop_all(&q));
+
+  /* Only the first push sees the empty queue */
+  CU_ASSERT(1 == nghttp2_mpscq_push(&q, &ents[0]));
+  CU_ASSERT(0 == nghttp2_mpscq_push(&q, &ents[1]));
+  CU_ASSERT(0 == nghttp2_mpscq_push(&q, &ents[2]));
+  CU_ASSERT(!nghttp2_mpscq_empty(&q));
+
+  /* Entries come out in the order they were pushed */
+  ent = nghttp2_mpscq_pop_all(&q);
+
+  CU_ASSERT(&ents[0] == ent);
+  CU_ASSERT(&ents[1] == ent->next);
+  CU_ASSERT(&ents[2] == ent->next->next);
+  CU_ASSERT(NULL == ent->next->next->next);
+
+  CU_ASSERT(nghttp2_mpscq_empty(&q));
+  CU_ASSERT(NULL == nghttp2_mpscq_pop_all(&q));
+
+  /* The queue is empty again after it is drained */
+  CU_ASSERT(1 == nghttp2_mpscq_push(&q, &ents[3]));
+
+  ent = nghttp2_mpscq_pop_all(&q);
+
+  CU_ASSERT(&ents[3] == ent);
+  CU_ASSERT(NULL == ent->next);
+}
@@ -0,0 +1,118 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_objpool_test.h"
+
+#include <stdlib.h>
+
+#include <CUnit/CUnit.h>
+
+#include "nghttp2_objpool.h"
+
+typedef struct {
+  size_t nmalloc;
+  size_t nfree;
+} alloc_count;
+
+static void *count_malloc(size_t size, void *mem_user_data) {
+  alloc_count *count = mem_user_data;
+
+  ++count->nmalloc;
+
+  return malloc(size);
+}
+
+static void count_free(void *ptr, void *mem_user_data) {
+  alloc_count *count = mem_user_data;
+
+  if (ptr) {
+    ++count->nfree;
+  }
+
+  free(ptr);
+}
+
+void test_nghttp2_objpool(void) {
+  alloc_count count = {0, 0};
+  nghttp2_mem mem = {&count, count_malloc, count_free, NULL, NULL};
+  nghttp2_objpool pool;
+  void *a, *b, *c;
+
+  /* Keeps at most 2 objects of 64 bytes */
+  nghttp2_objpool_init(&pool, 64, 128, &mem);
+
+  CU_ASSERT(64 == pool.objsize);
+  CU_ASSERT(2 == pool.max_len);
+
+  a = nghttp2_objpool_get(&pool);
+  b = nghttp2_objpool_get(&pool);
+  c = nghttp2_objpool_get(&pool);
+
+  CU_ASSERT(NULL != a);
+  CU_ASSERT(NULL != b);
+  CU_ASSERT(NULL != c);
+  CU_ASSERT(3 == count.nmalloc);
+
+  nghttp2_objpool_put(&pool, a);
+  nghttp2_objpool_put(&pool, b);
+
+  CU_ASSERT(2 == pool.len);
+  CU_ASSERT(0 == count.nfree);
+
+  /* The free list is full; c is returned to mem */
+  nghttp2_objpool_put(&pool, c);
+
+  CU_ASSERT(2 == pool.len);
+  CU_ASSERT(1 == count.nfree);
+
+  /* The most recently returned object is reused first */
+  CU_ASSERT(b == nghttp2_objpool_get(&pool));
+  CU_ASSERT(a == nghttp2_objpool_get(&pool));
+  CU_ASSERT(0 == pool.len);
+  CU_ASSERT(3 == count.nmalloc);
+
+  nghttp2_objpool_put(&pool, a);
+  nghttp2_objpool_put(&pool, b);
+  nghttp2_objpool_put(&pool, NULL);
+
+  CU_ASSERT(2 == pool.len);
+
+  nghttp2_objpool_free(&pool);
+
+  CU_ASSERT(0 == pool.len);
+  CU_ASSERT(count.nmalloc == count.nfree);
+
+  /* 0 disables retaining objects */
+  nghttp2_objpool_init(&pool, 1, 0, &mem);
+
+  CU_ASSERT(sizeof(void *) == pool.objsize);
+
+  a = nghttp2_objpool_get(&pool);
+  nghttp2_objpool_put(&pool, a);
+
+  CU_ASSERT(0 == pool.len);
+  CU_ASSERT(count.nmalloc == count.nfree);
+
+  nghttp2_objpool_free(&pool);
+}
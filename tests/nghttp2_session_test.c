@@ -35,6 +35,7 @@
 #include "nghttp2_helper.h"
 #include "nghttp2_test_helper.h"
 #include "nghttp2_priority_spec.h"
+#include "nghttp2_extpri.h"
 
 typedef struct {
   uint8_t buf[65535];
@@ -78,6 +79,11 @@ typedef struct {
   int begin_frame_cb_called;
   nghttp2_buf scratchbuf;
   size_t data_source_read_cb_paused;
+  int data_ref_release_cb_called;
+  int32_t data_ref_stream_id;
+  const uint8_t *data_ref;
+  const uint8_t *data_source_buf;
+  int submission_wakeup_cb_called;
 } my_user_data;
 
 static const nghttp2_nv reqnv[] = {
@@ -350,6 +356,32 @@ static ssize_t fixed_length_data_source_read_callback(
   return (ssize_t)wlen;
 }
 
+/* Like fixed_length_data_source_read_callback, but writes the
+   payload as well. */
+static ssize_t pattern_data_source_read_callback(
+    nghttp2_session *session, int32_t stream_id, uint8_t *buf, size_t len,
+    uint32_t *data_flags, nghttp2_data_source *source, void *user_data) {
+  my_user_data *ud = (my_user_data *)user_data;
+  size_t wlen;
+  size_t i;
+  (void)session;
+  (void)stream_id;
+  (void)source;
+
+  wlen = nghttp2_min(len, ud->data_source_length);
+
+  for (i = 0; i < wlen; ++i) {
+    buf[i] = (uint8_t)(ud->data_source_length - i);
+  }
+
+  ud->data_source_buf = buf;
+  ud->data_source_length -= wlen;
+  if (ud->data_source_length == 0) {
+    *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+  }
+  return (ssize_t)wlen;
+}
+
 static ssize_t temporal_failure_data_source_read_callback(
     nghttp2_session *session, int32_t stream_id, uint8_t *buf, size_t len,
     uint32_t *data_flags, nghttp2_data_source *source, void *user_data) {
@@ -1422,6 +1454,158 @@ void test_nghttp2_session_recv_continuation(void) {
   nghttp2_session_del(session);
 }
 
+/* Packs HEADERS with |nva| for |stream_id| into |data|, moving all
+   but the first byte of header block into a CONTINUATION frame.
+   Returns the number of bytes written. */
+static size_t pack_headers_with_continuation(uint8_t *data,
+                                             nghttp2_bufs *bufs,
+                                             nghttp2_hd_deflater *deflater,
+                                             int32_t stream_id,
+                                             const nghttp2_nv *nva_in,
+                                             size_t nvlen, nghttp2_mem *mem) {
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  nghttp2_buf *buf;
+  nghttp2_frame_hd cont_hd;
+  size_t datalen;
+  int rv;
+
+  nghttp2_nv_array_copy(&nva, nva_in, nvlen, mem);
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_STREAM,
+                             stream_id, NGHTTP2_HCAT_REQUEST, NULL, nva,
+                             nvlen);
+  nghttp2_bufs_reset(bufs);
+  rv = nghttp2_frame_pack_headers(bufs, &frame.headers, deflater);
+
+  assert(0 == rv);
+
+  nghttp2_frame_headers_free(&frame.headers, mem);
+
+  buf = &bufs->head->buf;
+  assert(nghttp2_bufs_len(bufs) == nghttp2_buf_len(buf));
+
+  /* HEADERS's payload is 1 byte, without END_HEADERS */
+  memcpy(data, buf->pos, NGHTTP2_FRAME_HDLEN + 1);
+  datalen = NGHTTP2_FRAME_HDLEN + 1;
+  buf->pos += NGHTTP2_FRAME_HDLEN + 1;
+
+  nghttp2_put_uint32be(data, (uint32_t)((1 << 8) + data[3]));
+  data[4] &= (uint8_t)~NGHTTP2_FLAG_END_HEADERS;
+
+  nghttp2_frame_hd_init(&cont_hd, nghttp2_buf_len(buf), NGHTTP2_CONTINUATION,
+                        NGHTTP2_FLAG_END_HEADERS, stream_id);
+
+  nghttp2_frame_pack_frame_hd(data + datalen, &cont_hd);
+  datalen += NGHTTP2_FRAME_HDLEN;
+
+  memcpy(data + datalen, buf->pos, cont_hd.length);
+  datalen += cont_hd.length;
+  buf->pos += cont_hd.length;
+
+  return datalen;
+}
+
+void test_nghttp2_session_recv_header_list_too_large(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_option *option;
+  nghttp2_bufs bufs;
+  nghttp2_hd_deflater deflater;
+  nghttp2_outbound_item *item;
+  my_user_data ud;
+  uint8_t data[1024];
+  uint8_t value[100];
+  size_t datalen;
+  ssize_t rv;
+  nghttp2_mem *mem;
+  nghttp2_nv nva[] = {MAKE_NV(":method", "GET"), MAKE_NV(":path", "/"),
+                      MAKE_NV(":scheme", "https"),
+                      MAKE_NV(":authority", "localhost"),
+                      MAKE_NV("x-large", "")};
+
+  mem = nghttp2_mem_default();
+  frame_pack_bufs_init(&bufs);
+
+  memset(value, 'a', sizeof(value));
+  nva[4].value = value;
+  nva[4].valuelen = sizeof(value);
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.on_header_callback = on_header_callback;
+  callbacks.on_frame_recv_callback = on_frame_recv_callback;
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_enforce_max_header_list_size(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, &ud, option);
+  /* pseudo header fields fit, but x-large does not */
+  session->local_settings.max_header_list_size = 200;
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  datalen = pack_headers_with_continuation(data, &bufs, &deflater, 1, nva,
+                                           ARRLEN(nva), mem);
+
+  ud.header_cb_called = 0;
+  ud.frame_recv_cb_called = 0;
+
+  rv = nghttp2_session_mem_recv(session, data, datalen);
+
+  CU_ASSERT((ssize_t)datalen == rv);
+  CU_ASSERT(4 == ud.header_cb_called);
+  CU_ASSERT(0 == ud.frame_recv_cb_called);
+
+  item = nghttp2_session_get_next_ob_item(session);
+
+  CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
+  CU_ASSERT(1 == item->frame.hd.stream_id);
+  CU_ASSERT(NGHTTP2_ENHANCE_YOUR_CALM == item->frame.rst_stream.error_code);
+
+  /* The remaining header block was still decoded, so HPACK dynamic
+     table is in sync with the peer. */
+  CU_ASSERT(nghttp2_hd_deflate_get_num_table_entries(&deflater) ==
+            nghttp2_hd_inflate_get_num_table_entries(&session->hd_inflater));
+
+  /* The next request within the limit is processed normally */
+  datalen = pack_headers_with_continuation(data, &bufs, &deflater, 3, nva,
+                                           ARRLEN(nva) - 1, mem);
+
+  ud.header_cb_called = 0;
+  ud.frame_recv_cb_called = 0;
+
+  rv = nghttp2_session_mem_recv(session, data, datalen);
+
+  CU_ASSERT((ssize_t)datalen == rv);
+  CU_ASSERT(4 == ud.header_cb_called);
+  CU_ASSERT(1 == ud.frame_recv_cb_called);
+
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Without option, SETTINGS_MAX_HEADER_LIST_SIZE is advisory only */
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+  session->local_settings.max_header_list_size = 200;
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  datalen = pack_headers_with_continuation(data, &bufs, &deflater, 1, nva,
+                                           ARRLEN(nva), mem);
+
+  ud.header_cb_called = 0;
+  ud.frame_recv_cb_called = 0;
+
+  rv = nghttp2_session_mem_recv(session, data, datalen);
+
+  CU_ASSERT((ssize_t)datalen == rv);
+  CU_ASSERT(5 == ud.header_cb_called);
+  CU_ASSERT(1 == ud.frame_recv_cb_called);
+
+  nghttp2_bufs_free(&bufs);
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_session_del(session);
+}
+
 void test_nghttp2_session_recv_headers_with_priority(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
@@ -2583,142 +2767,351 @@ void test_nghttp2_session_recv_origin(void) {
   nghttp2_bufs_free(&bufs);
 }
 
-void test_nghttp2_session_continue(void) {
+void test_nghttp2_session_recv_priority_update(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  my_user_data user_data;
-  const nghttp2_nv nv1[] = {MAKE_NV(":method", "GET"), MAKE_NV(":path", "/")};
-  const nghttp2_nv nv2[] = {MAKE_NV("user-agent", "nghttp2/1.0.0"),
-                            MAKE_NV("alpha", "bravo")};
+  my_user_data ud;
   nghttp2_bufs bufs;
-  nghttp2_buf *buf;
-  size_t framelen1, framelen2;
   ssize_t rv;
-  uint8_t buffer[4096];
-  nghttp2_buf databuf;
-  nghttp2_frame frame;
-  nghttp2_nv *nva;
-  size_t nvlen;
-  const nghttp2_frame *recv_frame;
-  nghttp2_frame_hd data_hd;
+  nghttp2_option *option;
+  nghttp2_extension frame;
+  nghttp2_ext_priority_update priority_update;
+  nghttp2_stream *stream;
   nghttp2_hd_deflater deflater;
   nghttp2_mem *mem;
+  uint8_t large_field_value[sizeof(session->iframe.raw_sbuf) + 1];
+  size_t i;
+  int32_t stream_id;
+  static const uint8_t field_value[] = "u=2,i";
 
   mem = nghttp2_mem_default();
+
+  memset(large_field_value, ' ', sizeof(large_field_value));
+  memcpy(large_field_value, field_value, sizeof(field_value) - 1);
+
   frame_pack_bufs_init(&bufs);
-  nghttp2_buf_wrap_init(&databuf, buffer, sizeof(buffer));
+
+  frame.payload = &priority_update;
 
   memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
-  callbacks.send_callback = null_send_callback;
   callbacks.on_frame_recv_callback = on_frame_recv_callback;
-  callbacks.on_data_chunk_recv_callback = pause_on_data_chunk_recv_callback;
-  callbacks.on_header_callback = pause_on_header_callback;
-  callbacks.on_begin_headers_callback = on_begin_headers_callback;
 
-  nghttp2_session_server_new(&session, &callbacks, &user_data);
-  /* disable strict HTTP layering checks */
-  session->opt_flags |= NGHTTP2_OPTMASK_NO_HTTP_MESSAGING;
+  nghttp2_option_new(&option);
+  nghttp2_option_set_no_rfc7540_priorities(option, 1);
 
-  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_session_server_new2(&session, &callbacks, &ud, option);
 
-  /* Make 2 HEADERS frames */
-  nvlen = ARRLEN(nv1);
-  nghttp2_nv_array_copy(&nva, nv1, nvlen, mem);
-  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 1,
-                             NGHTTP2_HCAT_HEADERS, NULL, nva, nvlen);
-  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
 
-  CU_ASSERT(0 == rv);
-  CU_ASSERT(nghttp2_bufs_len(&bufs) > 0);
+  /* PRIORITY_UPDATE to idle stream creates that idle stream */
+  nghttp2_frame_priority_update_init(&frame, 1, (uint8_t *)field_value,
+                                     sizeof(field_value) - 1);
 
-  nghttp2_frame_headers_free(&frame.headers, mem);
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
 
-  buf = &bufs.head->buf;
-  assert(nghttp2_bufs_len(&bufs) == nghttp2_buf_len(buf));
+  ud.frame_recv_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
 
-  framelen1 = nghttp2_buf_len(buf);
-  databuf.last = nghttp2_cpymem(databuf.last, buf->pos, nghttp2_buf_len(buf));
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+  CU_ASSERT(1 == ud.frame_recv_cb_called);
+  CU_ASSERT(NGHTTP2_PRIORITY_UPDATE == ud.recv_frame_hd.type);
+
+  stream = nghttp2_session_get_stream_raw(session, 1);
+
+  CU_ASSERT(NGHTTP2_STREAM_IDLE == stream->state);
+  CU_ASSERT(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES);
+  CU_ASSERT(2 == nghttp2_extpri_uint8_urgency(stream->extpri));
+  CU_ASSERT(1 == nghttp2_extpri_uint8_inc(stream->extpri));
 
-  nvlen = ARRLEN(nv2);
-  nghttp2_nv_array_copy(&nva, nv2, nvlen, mem);
-  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 3,
-                             NGHTTP2_HCAT_HEADERS, NULL, nva, nvlen);
   nghttp2_bufs_reset(&bufs);
-  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
 
-  CU_ASSERT(0 == rv);
-  CU_ASSERT(nghttp2_bufs_len(&bufs) > 0);
+  /* Field value which does not fit in the small buffer */
+  nghttp2_frame_priority_update_init(&frame, 3, large_field_value,
+                                     sizeof(large_field_value));
 
-  nghttp2_frame_headers_free(&frame.headers, mem);
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
 
-  assert(nghttp2_bufs_len(&bufs) == nghttp2_buf_len(buf));
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
 
-  framelen2 = nghttp2_buf_len(buf);
-  databuf.last = nghttp2_cpymem(databuf.last, buf->pos, nghttp2_buf_len(buf));
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
 
-  /* Receive 1st HEADERS and pause */
-  user_data.begin_headers_cb_called = 0;
-  user_data.header_cb_called = 0;
-  rv =
-      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+  stream = nghttp2_session_get_stream_raw(session, 3);
 
-  CU_ASSERT(rv >= 0);
-  databuf.pos += rv;
+  CU_ASSERT(2 == nghttp2_extpri_uint8_urgency(stream->extpri));
+  CU_ASSERT(1 == nghttp2_extpri_uint8_inc(stream->extpri));
 
-  recv_frame = user_data.frame;
-  CU_ASSERT(NGHTTP2_HEADERS == recv_frame->hd.type);
-  CU_ASSERT(framelen1 - NGHTTP2_FRAME_HDLEN == recv_frame->hd.length);
+  nghttp2_bufs_reset(&bufs);
 
-  CU_ASSERT(1 == user_data.begin_headers_cb_called);
-  CU_ASSERT(1 == user_data.header_cb_called);
+  /* priority header field in request HEADERS */
+  nghttp2_hd_deflate_init(&deflater, mem);
 
-  CU_ASSERT(nghttp2_nv_equal(&nv1[0], &user_data.nv));
+  {
+    nghttp2_nv nva[] = {MAKE_NV(":method", "GET"), MAKE_NV(":scheme", "https"),
+                        MAKE_NV(":authority", "localhost"),
+                        MAKE_NV(":path", "/"), MAKE_NV("priority", "u=5")};
 
-  /* get 2nd header field */
-  user_data.begin_headers_cb_called = 0;
-  user_data.header_cb_called = 0;
-  rv =
-      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+    rv = pack_headers(&bufs, &deflater, 5,
+                      NGHTTP2_FLAG_END_HEADERS | NGHTTP2_FLAG_END_STREAM, nva,
+                      ARRLEN(nva), mem);
+  }
 
-  CU_ASSERT(rv >= 0);
-  databuf.pos += rv;
+  CU_ASSERT(0 == rv);
 
-  CU_ASSERT(0 == user_data.begin_headers_cb_called);
-  CU_ASSERT(1 == user_data.header_cb_called);
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
 
-  CU_ASSERT(nghttp2_nv_equal(&nv1[1], &user_data.nv));
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
 
-  /* will call end_headers_callback and receive 2nd HEADERS and pause */
-  user_data.begin_headers_cb_called = 0;
-  user_data.header_cb_called = 0;
-  rv =
-      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+  stream = nghttp2_session_get_stream(session, 5);
 
-  CU_ASSERT(rv >= 0);
-  databuf.pos += rv;
+  CU_ASSERT(5 == nghttp2_extpri_uint8_urgency(stream->extpri));
+  CU_ASSERT(0 == nghttp2_extpri_uint8_inc(stream->extpri));
 
-  recv_frame = user_data.frame;
-  CU_ASSERT(NGHTTP2_HEADERS == recv_frame->hd.type);
-  CU_ASSERT(framelen2 - NGHTTP2_FRAME_HDLEN == recv_frame->hd.length);
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_bufs_reset(&bufs);
 
-  CU_ASSERT(1 == user_data.begin_headers_cb_called);
-  CU_ASSERT(1 == user_data.header_cb_called);
+  /* Unparsable field value is ignored */
+  nghttp2_frame_priority_update_init(&frame, 5, (uint8_t *)"u=", 2);
 
-  CU_ASSERT(nghttp2_nv_equal(&nv2[0], &user_data.nv));
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
 
-  /* get 2nd header field */
-  user_data.begin_headers_cb_called = 0;
-  user_data.header_cb_called = 0;
-  rv =
-      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+  ud.frame_recv_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
 
-  CU_ASSERT(rv >= 0);
-  databuf.pos += rv;
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+  CU_ASSERT(1 == ud.frame_recv_cb_called);
+  CU_ASSERT(5 == nghttp2_extpri_uint8_urgency(stream->extpri));
 
-  CU_ASSERT(0 == user_data.begin_headers_cb_called);
-  CU_ASSERT(1 == user_data.header_cb_called);
+  nghttp2_bufs_reset(&bufs);
 
-  CU_ASSERT(nghttp2_nv_equal(&nv2[1], &user_data.nv));
+  /* Prioritizing stream 0 is a connection error */
+  nghttp2_frame_priority_update_init(&frame, 0, NULL, 0);
+
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
+
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
+
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+
+  CU_ASSERT(session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND);
+
+  nghttp2_session_del(session);
+  nghttp2_bufs_reset(&bufs);
+
+  /* Too many idle streams created by PRIORITY_UPDATE */
+  nghttp2_session_server_new2(&session, &callbacks, &ud, option);
+
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
+
+  session->local_settings.max_concurrent_streams = 2;
+
+  for (i = 0; i < 3; ++i) {
+    stream_id = (int32_t)(i * 2 + 1);
+
+    nghttp2_frame_priority_update_init(&frame, stream_id,
+                                       (uint8_t *)field_value,
+                                       sizeof(field_value) - 1);
+
+    nghttp2_frame_pack_priority_update(&bufs, &frame);
+
+    rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                  nghttp2_bufs_len(&bufs));
+
+    CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+
+    nghttp2_bufs_reset(&bufs);
+  }
+
+  CU_ASSERT(session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND);
+
+  nghttp2_session_del(session);
+
+  /* PRIORITY_UPDATE must not be sent by server */
+  nghttp2_session_client_new2(&session, &callbacks, &ud, option);
+
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
+
+  nghttp2_frame_priority_update_init(&frame, 1, (uint8_t *)field_value,
+                                     sizeof(field_value) - 1);
+
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
+
+  ud.frame_recv_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
+
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+  CU_ASSERT(0 == ud.frame_recv_cb_called);
+
+  CU_ASSERT(session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND);
+
+  nghttp2_session_del(session);
+  nghttp2_bufs_reset(&bufs);
+
+  nghttp2_option_del(option);
+
+  /* PRIORITY_UPDATE is ignored unless extensible priorities are
+     enabled */
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  nghttp2_frame_priority_update_init(&frame, 1, (uint8_t *)field_value,
+                                     sizeof(field_value) - 1);
+
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
+
+  ud.frame_recv_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
+
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+  CU_ASSERT(0 == ud.frame_recv_cb_called);
+  CU_ASSERT(NULL == nghttp2_session_get_stream_raw(session, 1));
+
+  nghttp2_session_del(session);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+void test_nghttp2_session_continue(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data user_data;
+  const nghttp2_nv nv1[] = {MAKE_NV(":method", "GET"), MAKE_NV(":path", "/")};
+  const nghttp2_nv nv2[] = {MAKE_NV("user-agent", "nghttp2/1.0.0"),
+                            MAKE_NV("alpha", "bravo")};
+  nghttp2_bufs bufs;
+  nghttp2_buf *buf;
+  size_t framelen1, framelen2;
+  ssize_t rv;
+  uint8_t buffer[4096];
+  nghttp2_buf databuf;
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  size_t nvlen;
+  const nghttp2_frame *recv_frame;
+  nghttp2_frame_hd data_hd;
+  nghttp2_hd_deflater deflater;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+  frame_pack_bufs_init(&bufs);
+  nghttp2_buf_wrap_init(&databuf, buffer, sizeof(buffer));
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_recv_callback = on_frame_recv_callback;
+  callbacks.on_data_chunk_recv_callback = pause_on_data_chunk_recv_callback;
+  callbacks.on_header_callback = pause_on_header_callback;
+  callbacks.on_begin_headers_callback = on_begin_headers_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, &user_data);
+  /* disable strict HTTP layering checks */
+  session->opt_flags |= NGHTTP2_OPTMASK_NO_HTTP_MESSAGING;
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  /* Make 2 HEADERS frames */
+  nvlen = ARRLEN(nv1);
+  nghttp2_nv_array_copy(&nva, nv1, nvlen, mem);
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 1,
+                             NGHTTP2_HCAT_HEADERS, NULL, nva, nvlen);
+  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(nghttp2_bufs_len(&bufs) > 0);
+
+  nghttp2_frame_headers_free(&frame.headers, mem);
+
+  buf = &bufs.head->buf;
+  assert(nghttp2_bufs_len(&bufs) == nghttp2_buf_len(buf));
+
+  framelen1 = nghttp2_buf_len(buf);
+  databuf.last = nghttp2_cpymem(databuf.last, buf->pos, nghttp2_buf_len(buf));
+
+  nvlen = ARRLEN(nv2);
+  nghttp2_nv_array_copy(&nva, nv2, nvlen, mem);
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 3,
+                             NGHTTP2_HCAT_HEADERS, NULL, nva, nvlen);
+  nghttp2_bufs_reset(&bufs);
+  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(nghttp2_bufs_len(&bufs) > 0);
+
+  nghttp2_frame_headers_free(&frame.headers, mem);
+
+  assert(nghttp2_bufs_len(&bufs) == nghttp2_buf_len(buf));
+
+  framelen2 = nghttp2_buf_len(buf);
+  databuf.last = nghttp2_cpymem(databuf.last, buf->pos, nghttp2_buf_len(buf));
+
+  /* Receive 1st HEADERS and pause */
+  user_data.begin_headers_cb_called = 0;
+  user_data.header_cb_called = 0;
+  rv =
+      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+
+  CU_ASSERT(rv >= 0);
+  databuf.pos += rv;
+
+  recv_frame = user_data.frame;
+  CU_ASSERT(NGHTTP2_HEADERS == recv_frame->hd.type);
+  CU_ASSERT(framelen1 - NGHTTP2_FRAME_HDLEN == recv_frame->hd.length);
+
+  CU_ASSERT(1 == user_data.begin_headers_cb_called);
+  CU_ASSERT(1 == user_data.header_cb_called);
+
+  CU_ASSERT(nghttp2_nv_equal(&nv1[0], &user_data.nv));
+
+  /* get 2nd header field */
+  user_data.begin_headers_cb_called = 0;
+  user_data.header_cb_called = 0;
+  rv =
+      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+
+  CU_ASSERT(rv >= 0);
+  databuf.pos += rv;
+
+  CU_ASSERT(0 == user_data.begin_headers_cb_called);
+  CU_ASSERT(1 == user_data.header_cb_called);
+
+  CU_ASSERT(nghttp2_nv_equal(&nv1[1], &user_data.nv));
+
+  /* will call end_headers_callback and receive 2nd HEADERS and pause */
+  user_data.begin_headers_cb_called = 0;
+  user_data.header_cb_called = 0;
+  rv =
+      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+
+  CU_ASSERT(rv >= 0);
+  databuf.pos += rv;
+
+  recv_frame = user_data.frame;
+  CU_ASSERT(NGHTTP2_HEADERS == recv_frame->hd.type);
+  CU_ASSERT(framelen2 - NGHTTP2_FRAME_HDLEN == recv_frame->hd.length);
+
+  CU_ASSERT(1 == user_data.begin_headers_cb_called);
+  CU_ASSERT(1 == user_data.header_cb_called);
+
+  CU_ASSERT(nghttp2_nv_equal(&nv2[0], &user_data.nv));
+
+  /* get 2nd header field */
+  user_data.begin_headers_cb_called = 0;
+  user_data.header_cb_called = 0;
+  rv =
+      nghttp2_session_mem_recv(session, databuf.pos, nghttp2_buf_len(&databuf));
+
+  CU_ASSERT(rv >= 0);
+  databuf.pos += rv;
+
+  CU_ASSERT(0 == user_data.begin_headers_cb_called);
+  CU_ASSERT(1 == user_data.header_cb_called);
+
+  CU_ASSERT(nghttp2_nv_equal(&nv2[1], &user_data.nv));
 
   /* No input data, frame_recv_callback is called */
   user_data.begin_headers_cb_called = 0;
@@ -6290,6 +6683,79 @@ void test_nghttp2_submit_origin(void) {
   nghttp2_session_del(session);
 }
 
+void test_nghttp2_submit_priority_update(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data ud;
+  nghttp2_outbound_item *item;
+  nghttp2_settings_entry iv;
+  nghttp2_frame frame;
+  int rv;
+  static const uint8_t field_value[] = "u=7";
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  /* PRIORITY_UPDATE can be sent before server SETTINGS arrives */
+  rv = nghttp2_submit_priority_update(session, NGHTTP2_FLAG_NONE, 1,
+                                      field_value, sizeof(field_value) - 1);
+
+  CU_ASSERT(0 == rv);
+
+  item = nghttp2_session_get_next_ob_item(session);
+
+  CU_ASSERT(NGHTTP2_PRIORITY_UPDATE == item->frame.hd.type);
+
+  ud.frame_send_cb_called = 0;
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == ud.frame_send_cb_called);
+  CU_ASSERT(NGHTTP2_PRIORITY_UPDATE == ud.sent_frame_type);
+
+  /* stream_id must not be 0 */
+  rv = nghttp2_submit_priority_update(session, NGHTTP2_FLAG_NONE, 0,
+                                      field_value, sizeof(field_value) - 1);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+
+  /* field_value is too large */
+  rv = nghttp2_submit_priority_update(session, NGHTTP2_FLAG_NONE, 1,
+                                      field_value, 16381);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+
+  /* Server did not enable extensible priorities */
+  iv.settings_id = NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  iv.value = 100;
+
+  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE, &iv, 1);
+
+  rv = nghttp2_session_on_settings_received(session, &frame, 1);
+
+  CU_ASSERT(0 == rv);
+
+  rv = nghttp2_submit_priority_update(session, NGHTTP2_FLAG_NONE, 1,
+                                      field_value, sizeof(field_value) - 1);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE == rv);
+
+  nghttp2_session_del(session);
+
+  /* Server cannot submit PRIORITY_UPDATE */
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  rv = nghttp2_submit_priority_update(session, NGHTTP2_FLAG_NONE, 1,
+                                      field_value, sizeof(field_value) - 1);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE == rv);
+
+  nghttp2_session_del(session);
+}
+
 void test_nghttp2_session_open_stream(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
@@ -7307,13 +7773,120 @@ void test_nghttp2_session_set_option(void) {
 
   nghttp2_session_del(session);
   nghttp2_option_del(option);
-}
 
-void test_nghttp2_session_data_backoff_by_high_pri_frame(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  my_user_data ud;
-  nghttp2_data_provider data_prd;
+  /* Test for nghttp2_option_set_hd_adaptive_indexing */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_hd_adaptive_indexing(option, 1);
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(NULL != session->hd_deflater.sketch);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_hd_inflate_zero_copy */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_hd_inflate_zero_copy(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(1 == session->hd_inflater.zero_copy);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_max_pool_memory */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_pool_memory(option, 4096);
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(4096 / sizeof(nghttp2_stream) == session->stream_pool.max_len);
+  CU_ASSERT(4096 / sizeof(nghttp2_outbound_item) ==
+            session->item_pool.max_len);
+  CU_ASSERT(4096 / NGHTTP2_NVA_POOL_OBJSIZE == session->nva_pool.max_len);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_no_rfc7540_priorities */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_no_rfc7540_priorities(option, 1);
+  nghttp2_option_set_server_fallback_rfc7540_priorities(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(session->opt_flags & NGHTTP2_OPTMASK_NO_RFC7540_PRIORITIES);
+  CU_ASSERT(session->opt_flags &
+            NGHTTP2_OPTMASK_SERVER_FALLBACK_RFC7540_PRIORITIES);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_max_auto_window_size */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_auto_window_size(option, UINT32_MAX);
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(NGHTTP2_MAX_WINDOW_SIZE == session->window_tuner.max_window_size);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_submission_queue */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_submission_queue(option, 1);
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(session->opt_flags & NGHTTP2_OPTMASK_SUBMISSION_QUEUE);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_compact_retained_streams */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_compact_retained_streams(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(session->opt_flags & NGHTTP2_OPTMASK_COMPACT_RETAINED_STREAMS);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_enforce_max_header_list_size */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_enforce_max_header_list_size(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(session->opt_flags &
+            NGHTTP2_OPTMASK_ENFORCE_MAX_HEADER_LIST_SIZE);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+
+  /* Test for nghttp2_option_set_max_session_memory */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_session_memory(option, 1000000);
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  CU_ASSERT(1000000 == session->max_session_memory);
+  CU_ASSERT(&session->mem_acct == session->mem.mem_user_data);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+}
+
+void test_nghttp2_session_data_backoff_by_high_pri_frame(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data ud;
+  nghttp2_data_provider data_prd;
   nghttp2_stream *stream;
 
   memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
@@ -7427,235 +8000,454 @@ void test_nghttp2_session_pack_data_with_padding(void) {
   nghttp2_session_del(session);
 }
 
-void test_nghttp2_session_pack_headers_with_padding(void) {
-  nghttp2_session *session, *sv_session;
-  accumulator acc;
-  my_user_data ud;
+static int select_hd_indexing_callback(nghttp2_session *session,
+                                       const nghttp2_nv *nv, int suggested,
+                                       void *user_data) {
+  size_t *pncalled = user_data;
+  (void)session;
+  (void)nv;
+  (void)suggested;
+
+  ++*pncalled;
+
+  return NGHTTP2_HD_INDEXING_NEVER;
+}
+
+void test_nghttp2_session_select_hd_indexing(void) {
+  nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
+  size_t ncalled;
 
   memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.send_callback = accumulator_send_callback;
-  callbacks.on_frame_send_callback = on_frame_send_callback;
-  callbacks.select_padding_callback = select_padding_callback;
-  callbacks.on_frame_recv_callback = on_frame_recv_callback;
-
-  acc.length = 0;
-  ud.acc = &acc;
+  callbacks.send_callback = null_send_callback;
+  callbacks.select_hd_indexing_callback = select_hd_indexing_callback;
 
-  nghttp2_session_client_new(&session, &callbacks, &ud);
-  nghttp2_session_server_new(&sv_session, &callbacks, &ud);
+  ncalled = 0;
 
-  ud.padlen = 163;
+  nghttp2_session_client_new(&session, &callbacks, &ncalled);
 
   CU_ASSERT(1 == nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv),
                                         NULL, NULL));
   CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(ARRLEN(reqnv) == ncalled);
+  CU_ASSERT(0 == session->hd_deflater.ctx.hd_table.len);
 
-  CU_ASSERT(acc.length < NGHTTP2_MAX_PAYLOADLEN);
-  ud.frame_recv_cb_called = 0;
-  CU_ASSERT((ssize_t)acc.length ==
-            nghttp2_session_mem_recv(sv_session, acc.buf, acc.length));
-  CU_ASSERT(1 == ud.frame_recv_cb_called);
-  CU_ASSERT(NULL == nghttp2_session_get_next_ob_item(sv_session));
-
-  nghttp2_session_del(sv_session);
   nghttp2_session_del(session);
 }
 
-void test_nghttp2_pack_settings_payload(void) {
-  nghttp2_settings_entry iv[2];
-  uint8_t buf[64];
-  ssize_t len;
-  nghttp2_settings_entry *resiv;
-  size_t resniv;
-  nghttp2_mem *mem;
-
-  mem = nghttp2_mem_default();
-
-  iv[0].settings_id = NGHTTP2_SETTINGS_HEADER_TABLE_SIZE;
-  iv[0].value = 1023;
-  iv[1].settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
-  iv[1].value = 4095;
+static int keep_cookie_on_header_callback2(nghttp2_session *session,
+                                           const nghttp2_frame *frame,
+                                           nghttp2_rcbuf *name,
+                                           nghttp2_rcbuf *value, uint8_t flags,
+                                           void *user_data) {
+  nghttp2_rcbuf **pkept = user_data;
+  nghttp2_vec namebuf = nghttp2_rcbuf_get_buf(name);
+  (void)session;
+  (void)frame;
+  (void)flags;
 
-  len = nghttp2_pack_settings_payload(buf, sizeof(buf), iv, 2);
-  CU_ASSERT(2 * NGHTTP2_FRAME_SETTINGS_ENTRY_LENGTH == len);
-  CU_ASSERT(0 == nghttp2_frame_unpack_settings_payload2(&resiv, &resniv, buf,
-                                                        (size_t)len, mem));
-  CU_ASSERT(2 == resniv);
-  CU_ASSERT(NGHTTP2_SETTINGS_HEADER_TABLE_SIZE == resiv[0].settings_id);
-  CU_ASSERT(1023 == resiv[0].value);
-  CU_ASSERT(NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE == resiv[1].settings_id);
-  CU_ASSERT(4095 == resiv[1].value);
+  if (namebuf.len == sizeof("cookie") - 1 &&
+      memcmp("cookie", namebuf.base, namebuf.len) == 0) {
+    CU_ASSERT(nghttp2_rcbuf_is_borrowed(value));
 
-  mem->free(resiv, NULL);
+    nghttp2_rcbuf_incref(value);
+    *pkept = value;
+  }
 
-  len = nghttp2_pack_settings_payload(buf, 9 /* too small */, iv, 2);
-  CU_ASSERT(NGHTTP2_ERR_INSUFF_BUFSIZE == len);
+  return 0;
 }
 
-#define check_stream_dep_sib(STREAM, DEP_PREV, DEP_NEXT, SIB_PREV, SIB_NEXT)   \
-  do {                                                                         \
-    CU_ASSERT(DEP_PREV == STREAM->dep_prev);                                   \
-    CU_ASSERT(DEP_NEXT == STREAM->dep_next);                                   \
-    CU_ASSERT(SIB_PREV == STREAM->sib_prev);                                   \
-    CU_ASSERT(SIB_NEXT == STREAM->sib_next);                                   \
-  } while (0)
-
-/* nghttp2_stream_dep_add() and its families functions should be
-   tested in nghttp2_stream_test.c, but it is easier to use
-   nghttp2_session_open_stream().  Therefore, we test them here. */
-void test_nghttp2_session_stream_dep_add(void) {
+void test_nghttp2_session_hd_inflate_zero_copy(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *a, *b, *c, *d, *e, *root;
+  nghttp2_option *option;
+  nghttp2_bufs bufs;
+  nghttp2_buf *buf;
+  nghttp2_hd_deflater deflater;
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  nghttp2_mem *mem;
+  nghttp2_rcbuf *kept;
+  nghttp2_vec value;
+  /* Characters which have long Huffman code so that the value is
+     sent as is. */
+  const char cookie[] = "{<^~|~^>}{<^~|~^>}{<^~|~^>}{<^~|~^>}";
+  nghttp2_nv reqnv_cookie[] = {
+      MAKE_NV(":method", "GET"),
+      MAKE_NV(":path", "/"),
+      MAKE_NV(":scheme", "https"),
+      MAKE_NV(":authority", "localhost"),
+      MAKE_NV("cookie", cookie),
+  };
+  ssize_t rv;
 
-  memset(&callbacks, 0, sizeof(callbacks));
+  mem = nghttp2_mem_default();
+  frame_pack_bufs_init(&bufs);
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  reqnv_cookie[4].flags = NGHTTP2_NV_FLAG_NO_INDEX;
 
-  root = &session->root;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_header_callback2 = keep_cookie_on_header_callback2;
 
-  a = open_stream(session, 1);
+  nghttp2_option_new(&option);
+  nghttp2_option_set_hd_inflate_zero_copy(option, 1);
 
-  c = open_stream_with_dep(session, 5, a);
-  b = open_stream_with_dep(session, 3, a);
-  d = open_stream_with_dep(session, 7, c);
+  nghttp2_session_server_new2(&session, &callbacks, &kept, option);
 
-  /* a
-   * |
-   * b--c
-   *    |
-   *    d
-   */
+  nghttp2_hd_deflate_init(&deflater, mem);
 
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT * 2 == a->sum_dep_weight);
-  CU_ASSERT(0 == b->sum_dep_weight);
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
-  CU_ASSERT(0 == d->sum_dep_weight);
+  nghttp2_nv_array_copy(&nva, reqnv_cookie, ARRLEN(reqnv_cookie), mem);
+  nghttp2_frame_headers_init(&frame.headers,
+                             NGHTTP2_FLAG_END_HEADERS | NGHTTP2_FLAG_END_STREAM,
+                             1, NGHTTP2_HCAT_REQUEST, NULL, nva,
+                             ARRLEN(reqnv_cookie));
+  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
 
-  check_stream_dep_sib(a, root, b, NULL, NULL);
-  check_stream_dep_sib(b, a, NULL, NULL, c);
-  check_stream_dep_sib(c, a, d, b, NULL);
-  check_stream_dep_sib(d, c, NULL, NULL, NULL);
+  CU_ASSERT(0 == rv);
 
-  CU_ASSERT(a == session->root.dep_next);
+  nghttp2_frame_headers_free(&frame.headers, mem);
 
-  e = open_stream_with_dep_excl(session, 9, a);
+  buf = &bufs.head->buf;
+  kept = NULL;
 
-  /* a
-   * |
-   * e
-   * |
-   * b--c
-   *    |
-   *    d
-   */
+  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
 
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == a->sum_dep_weight);
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT * 2 == e->sum_dep_weight);
-  CU_ASSERT(0 == b->sum_dep_weight);
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
-  CU_ASSERT(0 == d->sum_dep_weight);
+  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+  CU_ASSERT(NULL != kept);
 
-  check_stream_dep_sib(a, root, e, NULL, NULL);
-  check_stream_dep_sib(e, a, b, NULL, NULL);
-  check_stream_dep_sib(b, e, NULL, NULL, c);
-  check_stream_dep_sib(c, e, d, b, NULL);
-  check_stream_dep_sib(d, c, NULL, NULL, NULL);
+  /* The retained value must not refer to the input buffer */
+  memset(buf->pos, 0, nghttp2_buf_len(buf));
 
-  CU_ASSERT(a == session->root.dep_next);
+  value = nghttp2_rcbuf_get_buf(kept);
+
+  CU_ASSERT(sizeof(cookie) - 1 == value.len);
+  CU_ASSERT(0 == memcmp(cookie, value.base, sizeof(cookie)));
 
   nghttp2_session_del(session);
+
+  nghttp2_rcbuf_decref(kept);
+
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_option_del(option);
+  nghttp2_bufs_free(&bufs);
 }
 
-void test_nghttp2_session_stream_dep_remove(void) {
+void test_nghttp2_session_object_pool(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *a, *b, *c, *d, *e, *f, *root;
+  nghttp2_option *option;
+  nghttp2_stream *stream;
+  int32_t stream_id;
 
   memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
 
-  /* Remove root */
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  nghttp2_session_client_new(&session, &callbacks, NULL);
 
-  root = &session->root;
+  stream_id = nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), NULL,
+                                     NULL);
 
-  a = open_stream(session, 1);
-  b = open_stream_with_dep(session, 3, a);
-  c = open_stream_with_dep(session, 5, a);
-  d = open_stream_with_dep(session, 7, c);
+  CU_ASSERT(1 == stream_id);
+  CU_ASSERT(0 == session->item_pool.len);
+  CU_ASSERT(0 == session->nva_pool.len);
 
-  /* a
-   * |
-   * c--b
-   * |
-   * d
-   */
+  CU_ASSERT(0 == nghttp2_session_send(session));
 
-  nghttp2_stream_dep_remove(a);
+  stream = nghttp2_session_get_stream(session, stream_id);
 
-  /* becomes:
-   * c    b
-   * |
-   * d
-   */
+  /* HEADERS and its header fields are returned to the pools after
+     they are sent. */
+  CU_ASSERT(1 == session->item_pool.len);
+  CU_ASSERT(1 == session->nva_pool.len);
 
-  CU_ASSERT(0 == a->sum_dep_weight);
-  CU_ASSERT(0 == b->sum_dep_weight);
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
-  CU_ASSERT(0 == d->sum_dep_weight);
+  CU_ASSERT(0 == nghttp2_session_close_stream(session, stream_id,
+                                              NGHTTP2_NO_ERROR));
+  CU_ASSERT(1 == session->stream_pool.len);
 
-  check_stream_dep_sib(a, NULL, NULL, NULL, NULL);
-  check_stream_dep_sib(b, root, NULL, c, NULL);
-  check_stream_dep_sib(c, root, d, NULL, b);
-  check_stream_dep_sib(d, c, NULL, NULL, NULL);
+  stream_id = nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), NULL,
+                                     NULL);
 
-  CU_ASSERT(c == session->root.dep_next);
+  CU_ASSERT(3 == stream_id);
+  CU_ASSERT(0 == session->item_pool.len);
+  CU_ASSERT(0 == session->nva_pool.len);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  /* The memory of the closed stream is reused. */
+  CU_ASSERT(stream == nghttp2_session_get_stream(session, stream_id));
+  CU_ASSERT(0 == session->stream_pool.len);
 
   nghttp2_session_del(session);
 
-  /* Remove right most stream */
+  /* Disable recycling */
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_pool_memory(option, 0);
+
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
+
+  nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), NULL, NULL);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(0 == session->item_pool.len);
+  CU_ASSERT(0 == session->nva_pool.len);
+
+  CU_ASSERT(0 == nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR));
+  CU_ASSERT(0 == session->stream_pool.len);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+}
+
+void test_nghttp2_session_hd_template(void) {
+  nghttp2_session *session, *cl_session;
+  nghttp2_session_callbacks callbacks;
+  accumulator acc;
+  my_user_data ud;
+  nghttp2_hd_template *tmpl;
+  const nghttp2_nv tmpl_nva[] = {
+      MAKE_NV(":status", "200"),
+      MAKE_NV("server", "nghttp2"),
+      MAKE_NV("content-type", "text/plain"),
+  };
+  const nghttp2_nv nva[] = {MAKE_NV("date", "Thu, 15 Oct 2026 00:00:00 GMT")};
+  const nghttp2_nv bad_nva[] = {MAKE_NV("server", "nghttp2"),
+                                MAKE_NV(":status", "200")};
+  size_t table_size;
+  int rv;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = accumulator_send_callback;
+  callbacks.on_header_callback = on_header_callback;
+
+  acc.length = 0;
+  ud.acc = &acc;
+
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+  nghttp2_session_client_new(&cl_session, &callbacks, &ud);
+
+  rv = nghttp2_session_create_hd_template(session, &tmpl, bad_nva,
+                                          ARRLEN(bad_nva));
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = nghttp2_session_create_hd_template(session, &tmpl, tmpl_nva,
+                                          ARRLEN(tmpl_nva));
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(tmpl == session->hd_templates);
+
+  open_recv_stream(session, 1);
+  open_recv_stream(session, 3);
+  open_sent_stream3(cl_session, 1, NGHTTP2_STREAM_FLAG_NONE, &pri_spec_default,
+                    NGHTTP2_STREAM_OPENING, NULL);
+  open_sent_stream3(cl_session, 3, NGHTTP2_STREAM_FLAG_NONE, &pri_spec_default,
+                    NGHTTP2_STREAM_OPENING, NULL);
+
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
+
+  rv = nghttp2_submit_response2(session, 1, tmpl, nva, ARRLEN(nva), NULL);
+
+  CU_ASSERT(0 == rv);
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+
+  /* "server" and "content-type" are added to the dynamic table */
+  table_size = nghttp2_session_get_hd_deflate_dynamic_table_size(session);
+
+  CU_ASSERT(table_size > 0);
+
+  rv = nghttp2_submit_response2(session, 3, tmpl, nva, ARRLEN(nva), NULL);
+
+  CU_ASSERT(0 == rv);
+
+  /* Submitted HEADERS keeps template alive */
+  nghttp2_session_del_hd_template(session, tmpl);
+
+  CU_ASSERT(NULL == session->hd_templates);
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(table_size ==
+            nghttp2_session_get_hd_deflate_dynamic_table_size(session));
+
+  ud.header_cb_called = 0;
+
+  CU_ASSERT((ssize_t)acc.length ==
+            nghttp2_session_mem_recv(cl_session, acc.buf, acc.length));
+  CU_ASSERT(2 * (ARRLEN(tmpl_nva) + ARRLEN(nva)) == ud.header_cb_called);
+
+  nghttp2_session_del(cl_session);
+  nghttp2_session_del(session);
+
+  /* Templates which are not deleted are freed with session */
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  rv = nghttp2_session_create_hd_template(session, &tmpl, tmpl_nva,
+                                          ARRLEN(tmpl_nva));
+
+  CU_ASSERT(0 == rv);
+
+  open_recv_stream(session, 1);
+
+  rv = nghttp2_submit_response2(session, 1, tmpl, nva, ARRLEN(nva), NULL);
+
+  CU_ASSERT(0 == rv);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_pack_headers_with_padding(void) {
+  nghttp2_session *session, *sv_session;
+  accumulator acc;
+  my_user_data ud;
+  nghttp2_session_callbacks callbacks;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = accumulator_send_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+  callbacks.select_padding_callback = select_padding_callback;
+  callbacks.on_frame_recv_callback = on_frame_recv_callback;
+
+  acc.length = 0;
+  ud.acc = &acc;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+  nghttp2_session_server_new(&sv_session, &callbacks, &ud);
+
+  ud.padlen = 163;
+
+  CU_ASSERT(1 == nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv),
+                                        NULL, NULL));
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT(acc.length < NGHTTP2_MAX_PAYLOADLEN);
+  ud.frame_recv_cb_called = 0;
+  CU_ASSERT((ssize_t)acc.length ==
+            nghttp2_session_mem_recv(sv_session, acc.buf, acc.length));
+  CU_ASSERT(1 == ud.frame_recv_cb_called);
+  CU_ASSERT(NULL == nghttp2_session_get_next_ob_item(sv_session));
+
+  nghttp2_session_del(sv_session);
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_pack_settings_payload(void) {
+  nghttp2_settings_entry iv[2];
+  uint8_t buf[64];
+  ssize_t len;
+  nghttp2_settings_entry *resiv;
+  size_t resniv;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+
+  iv[0].settings_id = NGHTTP2_SETTINGS_HEADER_TABLE_SIZE;
+  iv[0].value = 1023;
+  iv[1].settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  iv[1].value = 4095;
+
+  len = nghttp2_pack_settings_payload(buf, sizeof(buf), iv, 2);
+  CU_ASSERT(2 * NGHTTP2_FRAME_SETTINGS_ENTRY_LENGTH == len);
+  CU_ASSERT(0 == nghttp2_frame_unpack_settings_payload2(&resiv, &resniv, buf,
+                                                        (size_t)len, mem));
+  CU_ASSERT(2 == resniv);
+  CU_ASSERT(NGHTTP2_SETTINGS_HEADER_TABLE_SIZE == resiv[0].settings_id);
+  CU_ASSERT(1023 == resiv[0].value);
+  CU_ASSERT(NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE == resiv[1].settings_id);
+  CU_ASSERT(4095 == resiv[1].value);
+
+  mem->free(resiv, NULL);
+
+  len = nghttp2_pack_settings_payload(buf, 9 /* too small */, iv, 2);
+  CU_ASSERT(NGHTTP2_ERR_INSUFF_BUFSIZE == len);
+}
+
+#define check_stream_dep_sib(STREAM, DEP_PREV, DEP_NEXT, SIB_PREV, SIB_NEXT)   \
+  do {                                                                         \
+    CU_ASSERT(DEP_PREV == STREAM->dep_prev);                                   \
+    CU_ASSERT(DEP_NEXT == STREAM->dep_next);                                   \
+    CU_ASSERT(SIB_PREV == STREAM->sib_prev);                                   \
+    CU_ASSERT(SIB_NEXT == STREAM->sib_next);                                   \
+  } while (0)
+
+/* nghttp2_stream_dep_add() and its families functions should be
+   tested in nghttp2_stream_test.c, but it is easier to use
+   nghttp2_session_open_stream().  Therefore, we test them here. */
+void test_nghttp2_session_stream_dep_add(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *a, *b, *c, *d, *e, *root;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
   nghttp2_session_server_new(&session, &callbacks, NULL);
 
   root = &session->root;
 
   a = open_stream(session, 1);
-  b = open_stream_with_dep(session, 3, a);
+
   c = open_stream_with_dep(session, 5, a);
+  b = open_stream_with_dep(session, 3, a);
   d = open_stream_with_dep(session, 7, c);
 
   /* a
    * |
-   * c--b
-   * |
-   * d
+   * b--c
+   *    |
+   *    d
    */
 
-  nghttp2_stream_dep_remove(b);
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT * 2 == a->sum_dep_weight);
+  CU_ASSERT(0 == b->sum_dep_weight);
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
+  CU_ASSERT(0 == d->sum_dep_weight);
 
-  /* becomes:
-   * a
+  check_stream_dep_sib(a, root, b, NULL, NULL);
+  check_stream_dep_sib(b, a, NULL, NULL, c);
+  check_stream_dep_sib(c, a, d, b, NULL);
+  check_stream_dep_sib(d, c, NULL, NULL, NULL);
+
+  CU_ASSERT(a == session->root.dep_next);
+
+  e = open_stream_with_dep_excl(session, 9, a);
+
+  /* a
    * |
-   * c
+   * e
    * |
-   * d
+   * b--c
+   *    |
+   *    d
    */
 
   CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == a->sum_dep_weight);
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT * 2 == e->sum_dep_weight);
+  CU_ASSERT(0 == b->sum_dep_weight);
   CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
   CU_ASSERT(0 == d->sum_dep_weight);
-  CU_ASSERT(0 == b->sum_dep_weight);
 
-  check_stream_dep_sib(a, root, c, NULL, NULL);
-  check_stream_dep_sib(b, NULL, NULL, NULL, NULL);
-  check_stream_dep_sib(c, a, d, NULL, NULL);
+  check_stream_dep_sib(a, root, e, NULL, NULL);
+  check_stream_dep_sib(e, a, b, NULL, NULL);
+  check_stream_dep_sib(b, e, NULL, NULL, c);
+  check_stream_dep_sib(c, e, d, b, NULL);
   check_stream_dep_sib(d, c, NULL, NULL, NULL);
 
   CU_ASSERT(a == session->root.dep_next);
 
   nghttp2_session_del(session);
+}
 
-  /* Remove left most stream */
+void test_nghttp2_session_stream_dep_remove(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *a, *b, *c, *d, *e, *f, *root;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  /* Remove root */
   nghttp2_session_server_new(&session, &callbacks, NULL);
 
   root = &session->root;
@@ -7664,38 +8456,118 @@ void test_nghttp2_session_stream_dep_remove(void) {
   b = open_stream_with_dep(session, 3, a);
   c = open_stream_with_dep(session, 5, a);
   d = open_stream_with_dep(session, 7, c);
-  e = open_stream_with_dep(session, 9, c);
 
   /* a
    * |
    * c--b
    * |
-   * e--d
+   * d
    */
 
-  nghttp2_stream_dep_remove(c);
+  nghttp2_stream_dep_remove(a);
 
   /* becomes:
-   * a
+   * c    b
    * |
-   * e--d--b
+   * d
    */
 
-  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT * 2 == a->sum_dep_weight);
+  CU_ASSERT(0 == a->sum_dep_weight);
   CU_ASSERT(0 == b->sum_dep_weight);
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
   CU_ASSERT(0 == d->sum_dep_weight);
-  CU_ASSERT(0 == c->sum_dep_weight);
-  CU_ASSERT(0 == e->sum_dep_weight);
 
-  check_stream_dep_sib(a, root, e, NULL, NULL);
-  check_stream_dep_sib(b, a, NULL, d, NULL);
-  check_stream_dep_sib(c, NULL, NULL, NULL, NULL);
-  check_stream_dep_sib(d, a, NULL, e, b);
-  check_stream_dep_sib(e, a, NULL, NULL, d);
+  check_stream_dep_sib(a, NULL, NULL, NULL, NULL);
+  check_stream_dep_sib(b, root, NULL, c, NULL);
+  check_stream_dep_sib(c, root, d, NULL, b);
+  check_stream_dep_sib(d, c, NULL, NULL, NULL);
+
+  CU_ASSERT(c == session->root.dep_next);
 
   nghttp2_session_del(session);
 
-  /* Remove middle stream */
+  /* Remove right most stream */
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  root = &session->root;
+
+  a = open_stream(session, 1);
+  b = open_stream_with_dep(session, 3, a);
+  c = open_stream_with_dep(session, 5, a);
+  d = open_stream_with_dep(session, 7, c);
+
+  /* a
+   * |
+   * c--b
+   * |
+   * d
+   */
+
+  nghttp2_stream_dep_remove(b);
+
+  /* becomes:
+   * a
+   * |
+   * c
+   * |
+   * d
+   */
+
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == a->sum_dep_weight);
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == c->sum_dep_weight);
+  CU_ASSERT(0 == d->sum_dep_weight);
+  CU_ASSERT(0 == b->sum_dep_weight);
+
+  check_stream_dep_sib(a, root, c, NULL, NULL);
+  check_stream_dep_sib(b, NULL, NULL, NULL, NULL);
+  check_stream_dep_sib(c, a, d, NULL, NULL);
+  check_stream_dep_sib(d, c, NULL, NULL, NULL);
+
+  CU_ASSERT(a == session->root.dep_next);
+
+  nghttp2_session_del(session);
+
+  /* Remove left most stream */
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  root = &session->root;
+
+  a = open_stream(session, 1);
+  b = open_stream_with_dep(session, 3, a);
+  c = open_stream_with_dep(session, 5, a);
+  d = open_stream_with_dep(session, 7, c);
+  e = open_stream_with_dep(session, 9, c);
+
+  /* a
+   * |
+   * c--b
+   * |
+   * e--d
+   */
+
+  nghttp2_stream_dep_remove(c);
+
+  /* becomes:
+   * a
+   * |
+   * e--d--b
+   */
+
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT * 2 == a->sum_dep_weight);
+  CU_ASSERT(0 == b->sum_dep_weight);
+  CU_ASSERT(0 == d->sum_dep_weight);
+  CU_ASSERT(0 == c->sum_dep_weight);
+  CU_ASSERT(0 == e->sum_dep_weight);
+
+  check_stream_dep_sib(a, root, e, NULL, NULL);
+  check_stream_dep_sib(b, a, NULL, d, NULL);
+  check_stream_dep_sib(c, NULL, NULL, NULL, NULL);
+  check_stream_dep_sib(d, a, NULL, e, b);
+  check_stream_dep_sib(e, a, NULL, NULL, d);
+
+  nghttp2_session_del(session);
+
+  /* Remove middle stream */
   nghttp2_session_server_new(&session, &callbacks, NULL);
 
   root = &session->root;
@@ -8854,545 +9726,1846 @@ void test_nghttp2_session_stream_get_state(void) {
 
   rv = nghttp2_session_send(session);
 
-  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == rv);
+
+  stream = nghttp2_session_find_stream(session, 2);
+
+  CU_ASSERT(NGHTTP2_STREAM_STATE_RESERVED_LOCAL ==
+            nghttp2_stream_get_state(stream));
+
+  /* Send resposne to push stream 2 with END_STREAM set */
+  nghttp2_submit_response(session, 2, resnv, ARRLEN(resnv), NULL);
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+
+  stream = nghttp2_session_find_stream(session, 2);
+
+  /* At server, pushed stream object is not retained after closed */
+  CU_ASSERT(NULL == stream);
+
+  /* Push stream 4 associated to stream 5 */
+  rv = nghttp2_submit_push_promise(session, NGHTTP2_FLAG_NONE, 5, reqnv,
+                                   ARRLEN(reqnv), NULL);
+
+  CU_ASSERT(4 == rv);
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+
+  stream = nghttp2_session_find_stream(session, 4);
+
+  CU_ASSERT(NGHTTP2_STREAM_STATE_RESERVED_LOCAL ==
+            nghttp2_stream_get_state(stream));
+
+  /* Send response to push stream 4 without closing */
+  data_prd.read_callback = defer_data_source_read_callback;
+
+  nghttp2_submit_response(session, 4, resnv, ARRLEN(resnv), &data_prd);
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+
+  stream = nghttp2_session_find_stream(session, 4);
+
+  CU_ASSERT(NGHTTP2_STREAM_STATE_HALF_CLOSED_REMOTE ==
+            nghttp2_stream_get_state(stream));
+
+  /* Create idle stream by PRIORITY frame */
+  nghttp2_frame_priority_init(&frame.priority, 7, &pri_spec_default);
+
+  rv = nghttp2_frame_pack_priority(&bufs, &frame.priority);
+
+  CU_ASSERT(0 == rv);
+
+  nghttp2_frame_priority_free(&frame.priority);
+
+  buf = &bufs.head->buf;
+  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
+
+  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+
+  stream = nghttp2_session_find_stream(session, 7);
+
+  CU_ASSERT(NGHTTP2_STREAM_STATE_IDLE == nghttp2_stream_get_state(stream));
+
+  nghttp2_bufs_reset(&bufs);
+
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_session_del(session);
+
+  /* Test for client side */
+
+  nghttp2_session_client_new(&session, &callbacks, NULL);
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), NULL, NULL);
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+
+  /* Receive PUSH_PROMISE 2 associated to stream 1 */
+  pack_push_promise(&bufs, &deflater, 1, NGHTTP2_FLAG_END_HEADERS, 2, reqnv,
+                    ARRLEN(reqnv), mem);
+
+  buf = &bufs.head->buf;
+  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
+
+  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+
+  stream = nghttp2_session_find_stream(session, 2);
+
+  CU_ASSERT(NGHTTP2_STREAM_STATE_RESERVED_REMOTE ==
+            nghttp2_stream_get_state(stream));
+
+  nghttp2_bufs_reset(&bufs);
+
+  /* Receive push response for stream 2 without END_STREAM set */
+  pack_headers(&bufs, &deflater, 2, NGHTTP2_FLAG_END_HEADERS, resnv,
+               ARRLEN(resnv), mem);
+
+  buf = &bufs.head->buf;
+  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
+
+  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+
+  stream = nghttp2_session_find_stream(session, 2);
+
+  CU_ASSERT(NGHTTP2_STREAM_STATE_HALF_CLOSED_LOCAL ==
+            nghttp2_stream_get_state(stream));
+
+  nghttp2_bufs_reset(&bufs);
+
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_session_del(session);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+void test_nghttp2_session_stream_get_something(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *a, *b, *c;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  a = open_stream(session, 1);
+
+  CU_ASSERT(nghttp2_session_get_root_stream(session) ==
+            nghttp2_stream_get_parent(a));
+  CU_ASSERT(NULL == nghttp2_stream_get_previous_sibling(a));
+  CU_ASSERT(NULL == nghttp2_stream_get_next_sibling(a));
+  CU_ASSERT(NULL == nghttp2_stream_get_first_child(a));
+
+  b = open_stream_with_dep(session, 3, a);
+  c = open_stream_with_dep_weight(session, 5, 11, a);
+
+  CU_ASSERT(a == nghttp2_stream_get_parent(c));
+  CU_ASSERT(a == nghttp2_stream_get_parent(b));
+
+  CU_ASSERT(c == nghttp2_stream_get_first_child(a));
+
+  CU_ASSERT(b == nghttp2_stream_get_next_sibling(c));
+  CU_ASSERT(c == nghttp2_stream_get_previous_sibling(b));
+
+  CU_ASSERT(27 == nghttp2_stream_get_sum_dependency_weight(a));
+
+  CU_ASSERT(11 == nghttp2_stream_get_weight(c));
+  CU_ASSERT(5 == nghttp2_stream_get_stream_id(c));
+  CU_ASSERT(0 == nghttp2_stream_get_stream_id(&session->root));
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_find_stream(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *stream;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  open_recv_stream(session, 1);
+
+  stream = nghttp2_session_find_stream(session, 1);
+
+  CU_ASSERT(NULL != stream);
+  CU_ASSERT(1 == stream->stream_id);
+
+  stream = nghttp2_session_find_stream(session, 0);
+
+  CU_ASSERT(&session->root == stream);
+  CU_ASSERT(0 == stream->stream_id);
+
+  stream = nghttp2_session_find_stream(session, 2);
+
+  CU_ASSERT(NULL == stream);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_keep_closed_stream(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  const size_t max_concurrent_streams = 5;
+  nghttp2_settings_entry iv = {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
+                               (uint32_t)max_concurrent_streams};
+  size_t i;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, &iv, 1);
+
+  for (i = 0; i < max_concurrent_streams; ++i) {
+    open_recv_stream(session, (int32_t)i * 2 + 1);
+  }
+
+  CU_ASSERT(0 == session->num_closed_streams);
+
+  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(1 == session->closed_stream_tail->stream_id);
+  CU_ASSERT(session->closed_stream_tail == session->closed_stream_head);
+
+  nghttp2_session_close_stream(session, 5, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(2 == session->num_closed_streams);
+  CU_ASSERT(5 == session->closed_stream_tail->stream_id);
+  CU_ASSERT(1 == session->closed_stream_head->stream_id);
+  CU_ASSERT(session->closed_stream_head ==
+            session->closed_stream_tail->closed_prev);
+  CU_ASSERT(NULL == session->closed_stream_tail->closed_next);
+  CU_ASSERT(session->closed_stream_tail ==
+            session->closed_stream_head->closed_next);
+  CU_ASSERT(NULL == session->closed_stream_head->closed_prev);
+
+  open_recv_stream(session, 11);
+  nghttp2_session_adjust_closed_stream(session);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(5 == session->closed_stream_tail->stream_id);
+  CU_ASSERT(session->closed_stream_tail == session->closed_stream_head);
+  CU_ASSERT(NULL == session->closed_stream_head->closed_prev);
+  CU_ASSERT(NULL == session->closed_stream_head->closed_next);
+
+  open_recv_stream(session, 13);
+  nghttp2_session_adjust_closed_stream(session);
+
+  CU_ASSERT(0 == session->num_closed_streams);
+  CU_ASSERT(NULL == session->closed_stream_tail);
+  CU_ASSERT(NULL == session->closed_stream_head);
+
+  nghttp2_session_close_stream(session, 3, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(3 == session->closed_stream_head->stream_id);
+
+  /* server initiated stream is not counted to max concurrent limit */
+  open_sent_stream(session, 2);
+  nghttp2_session_adjust_closed_stream(session);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(3 == session->closed_stream_head->stream_id);
+
+  nghttp2_session_close_stream(session, 2, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(3 == session->closed_stream_head->stream_id);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_keep_idle_stream(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  const size_t max_concurrent_streams = 1;
+  nghttp2_settings_entry iv = {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
+                               (uint32_t)max_concurrent_streams};
+  int i;
+  int32_t stream_id;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, &iv, 1);
+
+  /* We at least allow NGHTTP2_MIN_IDLE_STREAM idle streams even if
+     max concurrent streams is very low. */
+  for (i = 0; i < NGHTTP2_MIN_IDLE_STREAMS; ++i) {
+    open_recv_stream2(session, i * 2 + 1, NGHTTP2_STREAM_IDLE);
+    nghttp2_session_adjust_idle_stream(session);
+  }
+
+  CU_ASSERT(NGHTTP2_MIN_IDLE_STREAMS == session->num_idle_streams);
+
+  stream_id = (NGHTTP2_MIN_IDLE_STREAMS - 1) * 2 + 1;
+  CU_ASSERT(1 == session->idle_stream_head->stream_id);
+  CU_ASSERT(stream_id == session->idle_stream_tail->stream_id);
+
+  stream_id += 2;
+
+  open_recv_stream2(session, stream_id, NGHTTP2_STREAM_IDLE);
+  nghttp2_session_adjust_idle_stream(session);
+
+  CU_ASSERT(NGHTTP2_MIN_IDLE_STREAMS == session->num_idle_streams);
+  CU_ASSERT(3 == session->idle_stream_head->stream_id);
+  CU_ASSERT(stream_id == session->idle_stream_tail->stream_id);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_detach_idle_stream(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  int i;
+  nghttp2_stream *stream;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  for (i = 1; i <= 3; ++i) {
+    nghttp2_session_open_stream(session, i, NGHTTP2_STREAM_FLAG_NONE,
+                                &pri_spec_default, NGHTTP2_STREAM_IDLE, NULL);
+  }
+
+  CU_ASSERT(3 == session->num_idle_streams);
+
+  /* Detach middle stream */
+  stream = nghttp2_session_get_stream_raw(session, 2);
+
+  CU_ASSERT(session->idle_stream_head == stream->closed_prev);
+  CU_ASSERT(session->idle_stream_tail == stream->closed_next);
+  CU_ASSERT(stream == session->idle_stream_head->closed_next);
+  CU_ASSERT(stream == session->idle_stream_tail->closed_prev);
+
+  nghttp2_session_detach_idle_stream(session, stream);
+
+  CU_ASSERT(2 == session->num_idle_streams);
+
+  CU_ASSERT(NULL == stream->closed_prev);
+  CU_ASSERT(NULL == stream->closed_next);
+
+  CU_ASSERT(session->idle_stream_head ==
+            session->idle_stream_tail->closed_prev);
+  CU_ASSERT(session->idle_stream_tail ==
+            session->idle_stream_head->closed_next);
+
+  /* Detach head stream */
+  stream = session->idle_stream_head;
+
+  nghttp2_session_detach_idle_stream(session, stream);
+
+  CU_ASSERT(1 == session->num_idle_streams);
+
+  CU_ASSERT(session->idle_stream_head == session->idle_stream_tail);
+  CU_ASSERT(NULL == session->idle_stream_head->closed_prev);
+  CU_ASSERT(NULL == session->idle_stream_head->closed_next);
+
+  /* Detach last stream */
+
+  stream = session->idle_stream_head;
+
+  nghttp2_session_detach_idle_stream(session, stream);
+
+  CU_ASSERT(0 == session->num_idle_streams);
+
+  CU_ASSERT(NULL == session->idle_stream_head);
+  CU_ASSERT(NULL == session->idle_stream_tail);
+
+  for (i = 4; i <= 5; ++i) {
+    nghttp2_session_open_stream(session, i, NGHTTP2_STREAM_FLAG_NONE,
+                                &pri_spec_default, NGHTTP2_STREAM_IDLE, NULL);
+  }
+
+  CU_ASSERT(2 == session->num_idle_streams);
+
+  /* Detach tail stream */
+
+  stream = session->idle_stream_tail;
+
+  nghttp2_session_detach_idle_stream(session, stream);
+
+  CU_ASSERT(1 == session->num_idle_streams);
+
+  CU_ASSERT(session->idle_stream_head == session->idle_stream_tail);
+  CU_ASSERT(NULL == session->idle_stream_head->closed_prev);
+  CU_ASSERT(NULL == session->idle_stream_head->closed_next);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_large_dep_tree(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  size_t i;
+  nghttp2_stream *dep_stream = NULL;
+  nghttp2_stream *stream;
+  int32_t stream_id;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  stream_id = 1;
+  for (i = 0; i < 250; ++i, stream_id += 2) {
+    dep_stream = open_stream_with_dep(session, stream_id, dep_stream);
+  }
+
+  stream_id = 1;
+  for (i = 0; i < 250; ++i, stream_id += 2) {
+    stream = nghttp2_session_get_stream(session, stream_id);
+    CU_ASSERT(nghttp2_stream_dep_find_ancestor(stream, &session->root));
+    CU_ASSERT(nghttp2_stream_in_dep_tree(stream));
+  }
+
+  nghttp2_session_del(session);
+}
+
+#define FLAT_TREE_NSTREAMS (NGHTTP2_STREAM_OBQ_WHEEL_THRESHOLD * 2)
+
+typedef struct {
+  size_t nbytes[FLAT_TREE_NSTREAMS];
+} flat_tree_send_log;
+
+static int flat_tree_on_frame_send_callback(nghttp2_session *session,
+                                            const nghttp2_frame *frame,
+                                            void *user_data) {
+  flat_tree_send_log *log = user_data;
+  (void)session;
+
+  if (frame->hd.type == NGHTTP2_DATA) {
+    log->nbytes[(frame->hd.stream_id - 1) / 2] += frame->hd.length;
+  }
+
+  return 0;
+}
+
+static ssize_t flat_tree_data_source_read_callback(
+    nghttp2_session *session, int32_t stream_id, uint8_t *buf, size_t len,
+    uint32_t *data_flags, nghttp2_data_source *source, void *user_data) {
+  (void)session;
+  (void)stream_id;
+  (void)buf;
+  (void)data_flags;
+  (void)source;
+  (void)user_data;
+
+  return (ssize_t)len;
+}
+
+void test_nghttp2_session_flat_tree_scheduling(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_data_provider data_prd;
+  nghttp2_stream *stream;
+  flat_tree_send_log log;
+  size_t i, nframes, total;
+  int32_t stream_id;
+  int rv;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_send_callback = flat_tree_on_frame_send_callback;
+
+  data_prd.read_callback = flat_tree_data_source_read_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, &log);
+
+  /* Every stream depends on the root.  Odd numbered ones have twice
+     the weight of the others. */
+  for (i = 0; i < FLAT_TREE_NSTREAMS; ++i) {
+    stream_id = (int32_t)(i * 2 + 1);
+    stream = open_recv_stream_with_dep_weight(session, stream_id,
+                                              i % 2 ? 32 : 16, NULL);
+    stream->remote_window_size = NGHTTP2_MAX_WINDOW_SIZE;
+
+    rv = nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, stream_id,
+                             &data_prd);
+
+    CU_ASSERT(0 == rv);
+  }
+
+  CU_ASSERT(NULL != session->root.obq_wheel);
+
+  /* Enough for 4 frames per weight 16 stream, and 8 frames per weight
+     32 stream. */
+  session->remote_window_size =
+      FLAT_TREE_NSTREAMS / 2 * 12 * NGHTTP2_MAX_PAYLOADLEN;
+
+  memset(&log, 0, sizeof(log));
+
+  rv = nghttp2_session_send(session);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == session->remote_window_size);
+
+  total = 0;
+
+  for (i = 0; i < FLAT_TREE_NSTREAMS; ++i) {
+    nframes = log.nbytes[i] / NGHTTP2_MAX_PAYLOADLEN;
+
+    if (i % 2) {
+      CU_ASSERT(7 <= nframes && nframes <= 9);
+    } else {
+      CU_ASSERT(3 <= nframes && nframes <= 5);
+    }
+
+    total += log.nbytes[i];
+  }
+
+  CU_ASSERT(FLAT_TREE_NSTREAMS / 2 * 12 * NGHTTP2_MAX_PAYLOADLEN == total);
+
+  /* The root goes back to nghttp2_pq when the last stream leaves. */
+  for (i = 0; i < FLAT_TREE_NSTREAMS; ++i) {
+    nghttp2_session_close_stream(session, (int32_t)(i * 2 + 1),
+                                 NGHTTP2_NO_ERROR);
+  }
+
+  CU_ASSERT(NULL == session->root.obq_wheel);
+  CU_ASSERT(nghttp2_stream_obq_empty(&session->root));
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_graceful_shutdown(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data ud;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+  callbacks.on_stream_close_callback = on_stream_close_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  open_recv_stream(session, 301);
+  open_sent_stream(session, 302);
+  open_recv_stream(session, 309);
+  open_recv_stream(session, 311);
+  open_recv_stream(session, 319);
+
+  CU_ASSERT(0 == nghttp2_submit_shutdown_notice(session));
+
+  ud.frame_send_cb_called = 0;
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT(1 == ud.frame_send_cb_called);
+  CU_ASSERT((1u << 31) - 1 == session->local_last_stream_id);
+
+  CU_ASSERT(0 == nghttp2_submit_goaway(session, NGHTTP2_FLAG_NONE, 311,
+                                       NGHTTP2_NO_ERROR, NULL, 0));
+
+  ud.frame_send_cb_called = 0;
+  ud.stream_close_cb_called = 0;
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT(1 == ud.frame_send_cb_called);
+  CU_ASSERT(311 == session->local_last_stream_id);
+  CU_ASSERT(1 == ud.stream_close_cb_called);
+
+  CU_ASSERT(0 ==
+            nghttp2_session_terminate_session2(session, 301, NGHTTP2_NO_ERROR));
+
+  ud.frame_send_cb_called = 0;
+  ud.stream_close_cb_called = 0;
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT(1 == ud.frame_send_cb_called);
+  CU_ASSERT(301 == session->local_last_stream_id);
+  CU_ASSERT(2 == ud.stream_close_cb_called);
+
+  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 301));
+  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 302));
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 309));
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 311));
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 319));
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_on_header_temporal_failure(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data ud;
+  nghttp2_bufs bufs;
+  nghttp2_buf *buf;
+  nghttp2_hd_deflater deflater;
+  nghttp2_nv nv[] = {MAKE_NV("alpha", "bravo"), MAKE_NV("charlie", "delta")};
+  nghttp2_nv *nva;
+  size_t hdpos;
+  ssize_t rv;
+  nghttp2_frame frame;
+  nghttp2_frame_hd hd;
+  nghttp2_outbound_item *item;
+  nghttp2_mem *mem;
+
+  mem = nghttp2_mem_default();
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_header_callback = temporal_failure_on_header_callback;
+
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  frame_pack_bufs_init(&bufs);
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  nghttp2_nv_array_copy(&nva, reqnv, ARRLEN(reqnv), mem);
+
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_STREAM, 1,
+                             NGHTTP2_HCAT_REQUEST, NULL, nva, ARRLEN(reqnv));
+  nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+  nghttp2_frame_headers_free(&frame.headers, mem);
+
+  /* We are going to create CONTINUATION.  First serialize header
+     block, and then frame header. */
+  hdpos = nghttp2_bufs_len(&bufs);
+
+  buf = &bufs.head->buf;
+  buf->last += NGHTTP2_FRAME_HDLEN;
+
+  nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &nv[1], 1);
+
+  nghttp2_frame_hd_init(&hd,
+                        nghttp2_bufs_len(&bufs) - hdpos - NGHTTP2_FRAME_HDLEN,
+                        NGHTTP2_CONTINUATION, NGHTTP2_FLAG_END_HEADERS, 1);
+
+  nghttp2_frame_pack_frame_hd(&buf->pos[hdpos], &hd);
+
+  ud.header_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_bufs_len(&bufs));
+
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+  CU_ASSERT(1 == ud.header_cb_called);
+
+  item = nghttp2_session_get_next_ob_item(session);
+
+  CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
+  CU_ASSERT(1 == item->frame.hd.stream_id);
+
+  /* Make sure no header decompression error occurred */
+  CU_ASSERT(NGHTTP2_GOAWAY_NONE == session->goaway_flags);
+
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_session_del(session);
+
+  nghttp2_bufs_reset(&bufs);
+
+  /* Check for PUSH_PROMISE */
+  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  open_sent_stream(session, 1);
+
+  rv = pack_push_promise(&bufs, &deflater, 1, NGHTTP2_FLAG_END_HEADERS, 2,
+                         reqnv, ARRLEN(reqnv), mem);
+  CU_ASSERT(0 == rv);
+
+  ud.header_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
+  CU_ASSERT(1 == ud.header_cb_called);
+
+  item = nghttp2_session_get_next_ob_item(session);
+  CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
+  CU_ASSERT(2 == item->frame.hd.stream_id);
+  CU_ASSERT(NGHTTP2_INTERNAL_ERROR == item->frame.rst_stream.error_code);
+
+  nghttp2_session_del(session);
+  nghttp2_hd_deflate_free(&deflater);
+  nghttp2_bufs_free(&bufs);
+}
+
+void test_nghttp2_session_recv_client_magic(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  ssize_t rv;
+  nghttp2_frame ping_frame;
+  uint8_t buf[16];
+
+  /* enable global nghttp2_enable_strict_preface here */
+  nghttp2_enable_strict_preface = 1;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  /* Check success case */
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  rv = nghttp2_session_mem_recv(session, (const uint8_t *)NGHTTP2_CLIENT_MAGIC,
+                                NGHTTP2_CLIENT_MAGIC_LEN);
+
+  CU_ASSERT(rv == NGHTTP2_CLIENT_MAGIC_LEN);
+  CU_ASSERT(NGHTTP2_IB_READ_FIRST_SETTINGS == session->iframe.state);
+
+  /* Receiving PING is error because we want SETTINGS. */
+  nghttp2_frame_ping_init(&ping_frame.ping, NGHTTP2_FLAG_NONE, NULL);
+
+  nghttp2_frame_pack_frame_hd(buf, &ping_frame.ping.hd);
+
+  rv = nghttp2_session_mem_recv(session, buf, NGHTTP2_FRAME_HDLEN);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN == rv);
+  CU_ASSERT(NGHTTP2_IB_IGN_ALL == session->iframe.state);
+  CU_ASSERT(0 == session->iframe.payloadleft);
+
+  nghttp2_frame_ping_free(&ping_frame.ping);
+
+  nghttp2_session_del(session);
+
+  /* Check bad case */
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  /* Feed magic with one byte less */
+  rv = nghttp2_session_mem_recv(session, (const uint8_t *)NGHTTP2_CLIENT_MAGIC,
+                                NGHTTP2_CLIENT_MAGIC_LEN - 1);
+
+  CU_ASSERT(rv == NGHTTP2_CLIENT_MAGIC_LEN - 1);
+  CU_ASSERT(NGHTTP2_IB_READ_CLIENT_MAGIC == session->iframe.state);
+  CU_ASSERT(1 == session->iframe.payloadleft);
+
+  rv = nghttp2_session_mem_recv(session, (const uint8_t *)"\0", 1);
+
+  CU_ASSERT(NGHTTP2_ERR_BAD_CLIENT_MAGIC == rv);
+
+  nghttp2_session_del(session);
+
+  /* disable global nghttp2_enable_strict_preface here */
+  nghttp2_enable_strict_preface = 0;
+}
+
+void test_nghttp2_session_delete_data_item(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *a;
+  nghttp2_data_provider prd;
+
+  memset(&callbacks, 0, sizeof(callbacks));
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  a = open_recv_stream(session, 1);
+  open_recv_stream_with_dep(session, 3, a);
+
+  /* We don't care about these members, since we won't send data */
+  prd.source.ptr = NULL;
+  prd.read_callback = fail_data_source_read_callback;
+
+  CU_ASSERT(0 == nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, 1, &prd));
+  CU_ASSERT(0 == nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, 3, &prd));
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_open_idle_stream(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *stream;
+  nghttp2_stream *opened_stream;
+  nghttp2_priority_spec pri_spec;
+  nghttp2_frame frame;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  nghttp2_priority_spec_init(&pri_spec, 0, 3, 0);
+
+  nghttp2_frame_priority_init(&frame.priority, 1, &pri_spec);
+
+  CU_ASSERT(0 == nghttp2_session_on_priority_received(session, &frame));
+
+  stream = nghttp2_session_get_stream_raw(session, 1);
+
+  CU_ASSERT(NGHTTP2_STREAM_IDLE == stream->state);
+  CU_ASSERT(NULL == stream->closed_prev);
+  CU_ASSERT(NULL == stream->closed_next);
+  CU_ASSERT(1 == session->num_idle_streams);
+  CU_ASSERT(session->idle_stream_head == stream);
+  CU_ASSERT(session->idle_stream_tail == stream);
+
+  opened_stream = open_recv_stream2(session, 1, NGHTTP2_STREAM_OPENING);
+
+  CU_ASSERT(stream == opened_stream);
+  CU_ASSERT(NGHTTP2_STREAM_OPENING == stream->state);
+  CU_ASSERT(0 == session->num_idle_streams);
+  CU_ASSERT(NULL == session->idle_stream_head);
+  CU_ASSERT(NULL == session->idle_stream_tail);
+
+  nghttp2_frame_priority_free(&frame.priority);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_cancel_reserved_remote(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *stream;
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  size_t nvlen;
+  nghttp2_hd_deflater deflater;
+  nghttp2_mem *mem;
+  nghttp2_bufs bufs;
+  ssize_t rv;
+
+  mem = nghttp2_mem_default();
+  frame_pack_bufs_init(&bufs);
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+
+  nghttp2_session_client_new(&session, &callbacks, NULL);
+
+  nghttp2_hd_deflate_init(&deflater, mem);
+
+  stream = open_recv_stream2(session, 2, NGHTTP2_STREAM_RESERVED);
+
+  nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, 2, NGHTTP2_CANCEL);
+
+  CU_ASSERT(NGHTTP2_STREAM_CLOSING == stream->state);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  nvlen = ARRLEN(resnv);
+  nghttp2_nv_array_copy(&nva, resnv, nvlen, mem);
+
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 2,
+                             NGHTTP2_HCAT_PUSH_RESPONSE, NULL, nva, nvlen);
+  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+
+  CU_ASSERT(0 == rv);
+
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_buf_len(&bufs.head->buf));
+
+  CU_ASSERT((ssize_t)nghttp2_buf_len(&bufs.head->buf) == rv);
+
+  /* stream is not dangling, so assign NULL */
+  stream = NULL;
+
+  /* No RST_STREAM or GOAWAY is generated since stream should be in
+     NGHTTP2_STREAM_CLOSING and push response should be ignored. */
+  CU_ASSERT(0 == nghttp2_outbound_queue_size(&session->ob_reg));
+
+  /* Check that we can receive push response HEADERS while RST_STREAM
+     is just queued. */
+  open_recv_stream2(session, 4, NGHTTP2_STREAM_RESERVED);
+
+  nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, 2, NGHTTP2_CANCEL);
+
+  nghttp2_bufs_reset(&bufs);
+
+  frame.hd.stream_id = 4;
+  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+
+  CU_ASSERT(0 == rv);
+
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_buf_len(&bufs.head->buf));
+
+  CU_ASSERT((ssize_t)nghttp2_buf_len(&bufs.head->buf) == rv);
+
+  CU_ASSERT(1 == nghttp2_outbound_queue_size(&session->ob_reg));
+
+  nghttp2_frame_headers_free(&frame.headers, mem);
+
+  nghttp2_hd_deflate_free(&deflater);
+
+  nghttp2_session_del(session);
+
+  nghttp2_bufs_free(&bufs);
+}
+
+void test_nghttp2_session_reset_pending_headers(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_stream *stream;
+  int32_t stream_id;
+  my_user_data ud;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+  callbacks.on_frame_not_send_callback = on_frame_not_send_callback;
+  callbacks.on_stream_close_callback = on_stream_close_callback;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  stream_id = nghttp2_submit_request(session, NULL, NULL, 0, NULL, NULL);
+  CU_ASSERT(stream_id >= 1);
+
+  nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id,
+                            NGHTTP2_CANCEL);
+
+  session->remote_settings.max_concurrent_streams = 0;
+
+  /* RST_STREAM cancels pending HEADERS and is not actually sent. */
+  ud.frame_send_cb_called = 0;
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT(0 == ud.frame_send_cb_called);
+
+  stream = nghttp2_session_get_stream(session, stream_id);
+
+  CU_ASSERT(NULL == stream);
+
+  /* See HEADERS is not sent.  on_stream_close is called just like
+     transmission failure. */
+  session->remote_settings.max_concurrent_streams = 1;
+
+  ud.frame_not_send_cb_called = 0;
+  ud.stream_close_error_code = 0;
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT(1 == ud.frame_not_send_cb_called);
+  CU_ASSERT(NGHTTP2_HEADERS == ud.not_sent_frame_type);
+  CU_ASSERT(NGHTTP2_CANCEL == ud.stream_close_error_code);
+
+  stream = nghttp2_session_get_stream(session, stream_id);
+
+  CU_ASSERT(NULL == stream);
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_send_data_callback(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_data_provider data_prd;
+  my_user_data ud;
+  accumulator acc;
+  nghttp2_frame_hd hd;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = accumulator_send_callback;
+  callbacks.send_data_callback = send_data_callback;
+
+  data_prd.read_callback = no_copy_data_source_read_callback;
+
+  acc.length = 0;
+  ud.acc = &acc;
+
+  ud.data_source_length = NGHTTP2_DATA_PAYLOADLEN * 2;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  open_sent_stream(session, 1);
+
+  nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM, 1, &data_prd);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  CU_ASSERT((NGHTTP2_FRAME_HDLEN + NGHTTP2_DATA_PAYLOADLEN) * 2 == acc.length);
+
+  nghttp2_frame_unpack_frame_hd(&hd, acc.buf);
+
+  CU_ASSERT(16384 == hd.length);
+  CU_ASSERT(NGHTTP2_DATA == hd.type);
+  CU_ASSERT(NGHTTP2_FLAG_NONE == hd.flags);
+
+  nghttp2_frame_unpack_frame_hd(&hd, acc.buf + NGHTTP2_FRAME_HDLEN + hd.length);
+
+  CU_ASSERT(16384 == hd.length);
+  CU_ASSERT(NGHTTP2_DATA == hd.type);
+  CU_ASSERT(NGHTTP2_FLAG_END_STREAM == hd.flags);
+
+  nghttp2_session_del(session);
+}
+
+static uint8_t data_ref_buf[NGHTTP2_DATA_PAYLOADLEN];
+
+static int get_data_ref_callback(nghttp2_session *session,
+                                 nghttp2_frame *frame, size_t length,
+                                 const uint8_t **pdata,
+                                 nghttp2_data_source *source,
+                                 void *user_data) {
+  (void)session;
+  (void)frame;
+  (void)source;
+  (void)user_data;
+
+  assert(length <= sizeof(data_ref_buf));
+
+  *pdata = data_ref_buf;
+
+  return 0;
+}
+
+static int on_data_ref_release_callback(nghttp2_session *session,
+                                        int32_t stream_id, const uint8_t *data,
+                                        size_t length, void *user_data) {
+  my_user_data *ud = (my_user_data *)user_data;
+  (void)session;
+  (void)length;
+
+  ++ud->data_ref_release_cb_called;
+  ud->data_ref_stream_id = stream_id;
+  ud->data_ref = data;
+
+  return 0;
+}
+
+void test_nghttp2_session_mem_sendv(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_data_provider data_prd;
+  my_user_data ud;
+  nghttp2_vec vec[16];
+  nghttp2_frame_hd hd;
+  ssize_t nvec;
+  size_t i;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.get_data_ref_callback = get_data_ref_callback;
+  callbacks.on_data_ref_release_callback = on_data_ref_release_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+
+  data_prd.read_callback = no_copy_data_source_read_callback;
+
+  memset(&ud, 0, sizeof(ud));
+  ud.data_source_length = 100;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  open_sent_stream(session, 1);
+
+  nghttp2_submit_ping(session, NGHTTP2_FLAG_NONE, NULL);
+  nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM, 1, &data_prd);
+
+  /* Too small vector */
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_session_mem_sendv(session, vec, 2));
+
+  nvec = nghttp2_session_mem_sendv(session, vec, ARRLEN(vec));
+
+  /* PING and DATA frame header are coalesced, and DATA payload is
+     passed by reference. */
+  CU_ASSERT(2 == nvec);
+  CU_ASSERT(2 == ud.frame_send_cb_called);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + 8 + NGHTTP2_FRAME_HDLEN == vec[0].len);
+
+  nghttp2_frame_unpack_frame_hd(&hd, vec[0].base);
+
+  CU_ASSERT(NGHTTP2_PING == hd.type);
+
+  nghttp2_frame_unpack_frame_hd(&hd, vec[0].base + NGHTTP2_FRAME_HDLEN + 8);
+
+  CU_ASSERT(NGHTTP2_DATA == hd.type);
+  CU_ASSERT(100 == hd.length);
+  CU_ASSERT(NGHTTP2_FLAG_END_STREAM == hd.flags);
+  CU_ASSERT(data_ref_buf == vec[1].base);
+  CU_ASSERT(100 == vec[1].len);
+  CU_ASSERT(0 == ud.data_ref_release_cb_called);
+
+  /* The next call releases the application data */
+  nvec = nghttp2_session_mem_sendv(session, vec, ARRLEN(vec));
+
+  CU_ASSERT(0 == nvec);
+  CU_ASSERT(1 == ud.data_ref_release_cb_called);
+  CU_ASSERT(1 == ud.data_ref_stream_id);
+  CU_ASSERT(data_ref_buf == ud.data_ref);
+
+  nghttp2_session_del(session);
+
+  /* Padded DATA */
+  callbacks.select_padding_callback = select_padding_callback;
+
+  memset(&ud, 0, sizeof(ud));
+  ud.data_source_length = 100;
+  ud.padlen = 10;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  open_sent_stream(session, 1);
+
+  nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM, 1, &data_prd);
+
+  nvec = nghttp2_session_mem_sendv(session, vec, ARRLEN(vec));
+
+  CU_ASSERT(3 == nvec);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + 1 == vec[0].len);
+
+  nghttp2_frame_unpack_frame_hd(&hd, vec[0].base);
+
+  CU_ASSERT(NGHTTP2_DATA == hd.type);
+  CU_ASSERT(110 == hd.length);
+  CU_ASSERT((NGHTTP2_FLAG_END_STREAM | NGHTTP2_FLAG_PADDED) == hd.flags);
+  CU_ASSERT(9 == vec[0].base[NGHTTP2_FRAME_HDLEN]);
+  CU_ASSERT(data_ref_buf == vec[1].base);
+  CU_ASSERT(100 == vec[1].len);
+  CU_ASSERT(9 == vec[2].len);
+
+  for (i = 0; i < vec[2].len; ++i) {
+    CU_ASSERT(0 == vec[2].base[i]);
+  }
+
+  /* nghttp2_session_del releases the application data as well */
+  nghttp2_session_del(session);
+
+  CU_ASSERT(1 == ud.data_ref_release_cb_called);
+
+  /* Data is copied unless NGHTTP2_DATA_FLAG_NO_COPY is used */
+  callbacks.select_padding_callback = NULL;
+  data_prd.read_callback = fixed_length_data_source_read_callback;
+
+  memset(&ud, 0, sizeof(ud));
+  ud.data_source_length = NGHTTP2_DATA_PAYLOADLEN * 2;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  open_sent_stream(session, 1);
+
+  nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM, 1, &data_prd);
+
+  nvec = nghttp2_session_mem_sendv(session, vec, ARRLEN(vec));
+
+  CU_ASSERT(2 == nvec);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + NGHTTP2_DATA_PAYLOADLEN == vec[0].len);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + NGHTTP2_DATA_PAYLOADLEN == vec[1].len);
+  CU_ASSERT(0 == ud.data_ref_release_cb_called);
+
+  nghttp2_session_del(session);
+
+  /* get_data_ref_callback is required for NGHTTP2_DATA_FLAG_NO_COPY */
+  callbacks.get_data_ref_callback = NULL;
+  callbacks.send_data_callback = send_data_callback;
+  data_prd.read_callback = no_copy_data_source_read_callback;
+
+  memset(&ud, 0, sizeof(ud));
+  ud.data_source_length = 100;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  open_sent_stream(session, 1);
+
+  nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM, 1, &data_prd);
+
+  CU_ASSERT(NGHTTP2_ERR_CALLBACK_FAILURE ==
+            nghttp2_session_mem_sendv(session, vec, ARRLEN(vec)));
+
+  nghttp2_session_del(session);
+}
+
+static void recv_data_frame(nghttp2_session *session, int32_t stream_id,
+                            size_t len) {
+  uint8_t data[NGHTTP2_FRAME_HDLEN + NGHTTP2_DATA_PAYLOADLEN];
+  nghttp2_frame_hd hd;
+  ssize_t rv;
+
+  assert(len <= NGHTTP2_DATA_PAYLOADLEN);
+
+  memset(data, 0, sizeof(data));
+  nghttp2_frame_hd_init(&hd, len, NGHTTP2_DATA, NGHTTP2_FLAG_NONE, stream_id);
+  nghttp2_frame_pack_frame_hd(data, &hd);
+
+  rv = nghttp2_session_mem_recv(session, data, NGHTTP2_FRAME_HDLEN + len);
+
+  CU_ASSERT((ssize_t)(NGHTTP2_FRAME_HDLEN + len) == rv);
+}
+
+/* Sends out the PING queued by automatic window tuning, and receives
+   its ACK. */
+static void ack_window_tuning_ping(nghttp2_session *session) {
+  uint8_t data[NGHTTP2_FRAME_HDLEN + 8];
+  nghttp2_outbound_item *item;
+  nghttp2_frame_hd hd;
+  const uint8_t *pos;
+  ssize_t rv;
+
+  item = nghttp2_outbound_queue_top(&session->ob_urgent);
+
+  CU_ASSERT(NGHTTP2_PING == item->frame.hd.type);
+  CU_ASSERT(0 == (item->frame.hd.flags & NGHTTP2_FLAG_ACK));
+
+  memcpy(data + NGHTTP2_FRAME_HDLEN, item->frame.ping.opaque_data, 8);
+
+  while (nghttp2_session_mem_send(session, &pos) > 0)
+    ;
+
+  nghttp2_frame_hd_init(&hd, 8, NGHTTP2_PING, NGHTTP2_FLAG_ACK, 0);
+  nghttp2_frame_pack_frame_hd(data, &hd);
+
+  rv = nghttp2_session_mem_recv(session, data, sizeof(data));
 
-  stream = nghttp2_session_find_stream(session, 2);
+  CU_ASSERT((ssize_t)sizeof(data) == rv);
+}
 
-  CU_ASSERT(NGHTTP2_STREAM_STATE_RESERVED_LOCAL ==
-            nghttp2_stream_get_state(stream));
+void test_nghttp2_session_mem_send_batch(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_data_provider data_prd;
+  my_user_data ud;
+  accumulator acc;
+  nghttp2_nv nva[] = {MAKE_NV(":method", "POST"), MAKE_NV(":scheme", "https"),
+                      MAKE_NV(":authority", "example.org"),
+                      MAKE_NV(":path", "/")};
+  const size_t buflens[] = {1, 1000, NGHTTP2_FRAMEBUF_CHUNKLEN, 1 << 16};
+  static uint8_t expected[1 << 16];
+  static uint8_t buf[1 << 16];
+  size_t expectedlen, len;
+  const uint8_t *data;
+  ssize_t rv;
+  size_t i;
 
-  /* Send resposne to push stream 2 with END_STREAM set */
-  nghttp2_submit_response(session, 2, resnv, ARRLEN(resnv), NULL);
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
 
-  rv = nghttp2_session_send(session);
+  data_prd.read_callback = pattern_data_source_read_callback;
 
-  CU_ASSERT(0 == rv);
+  /* Serialize the same frames with nghttp2_session_mem_send() and
+     nghttp2_session_mem_send_batch() using various buffer sizes. */
+  for (i = 0; i <= ARRLEN(buflens); ++i) {
+    memset(&ud, 0, sizeof(ud));
+    ud.data_source_length = 40000;
 
-  stream = nghttp2_session_find_stream(session, 2);
+    nghttp2_session_client_new(&session, &callbacks, &ud);
 
-  /* At server, pushed stream object is not retained after closed */
-  CU_ASSERT(NULL == stream);
+    CU_ASSERT(1 == nghttp2_submit_request(session, NULL, nva, ARRLEN(nva),
+                                          &data_prd, NULL));
+    nghttp2_submit_ping(session, NGHTTP2_FLAG_NONE, NULL);
 
-  /* Push stream 4 associated to stream 5 */
-  rv = nghttp2_submit_push_promise(session, NGHTTP2_FLAG_NONE, 5, reqnv,
-                                   ARRLEN(reqnv), NULL);
+    len = 0;
 
-  CU_ASSERT(4 == rv);
+    if (i == 0) {
+      while ((rv = nghttp2_session_mem_send(session, &data)) > 0) {
+        assert(len + (size_t)rv <= sizeof(expected));
 
-  rv = nghttp2_session_send(session);
+        memcpy(expected + len, data, (size_t)rv);
+        len += (size_t)rv;
+      }
 
-  CU_ASSERT(0 == rv);
+      expectedlen = len;
+    } else {
+      for (;;) {
+        rv = nghttp2_session_mem_send_batch(
+            session, buf + len, nghttp2_min(buflens[i - 1], sizeof(buf) - len));
+        if (rv <= 0) {
+          break;
+        }
+
+        len += (size_t)rv;
+      }
+
+      CU_ASSERT(expectedlen == len);
+      CU_ASSERT(0 == memcmp(expected, buf, len));
+
+      if (buflens[i - 1] == 1 << 16) {
+        /* The last DATA was read into the destination directly. */
+        CU_ASSERT(ud.data_source_buf >= buf);
+        CU_ASSERT(ud.data_source_buf < buf + len);
+      }
+    }
 
-  stream = nghttp2_session_find_stream(session, 4);
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(0 == ud.data_source_length);
+    CU_ASSERT(NULL == nghttp2_session_get_next_ob_item(session));
 
-  CU_ASSERT(NGHTTP2_STREAM_STATE_RESERVED_LOCAL ==
-            nghttp2_stream_get_state(stream));
+    nghttp2_session_del(session);
+  }
 
-  /* Send response to push stream 4 without closing */
-  data_prd.read_callback = defer_data_source_read_callback;
+  /* The batch is returned before send_data_callback is invoked. */
+  callbacks.send_data_callback = send_data_callback;
 
-  nghttp2_submit_response(session, 4, resnv, ARRLEN(resnv), &data_prd);
+  data_prd.read_callback = no_copy_data_source_read_callback;
 
-  rv = nghttp2_session_send(session);
+  memset(&ud, 0, sizeof(ud));
+  ud.data_source_length = 100;
+  ud.acc = &acc;
+  acc.length = 0;
 
-  CU_ASSERT(0 == rv);
+  nghttp2_session_client_new(&session, &callbacks, &ud);
 
-  stream = nghttp2_session_find_stream(session, 4);
+  CU_ASSERT(1 == nghttp2_submit_request(session, NULL, nva, ARRLEN(nva),
+                                        &data_prd, NULL));
 
-  CU_ASSERT(NGHTTP2_STREAM_STATE_HALF_CLOSED_REMOTE ==
-            nghttp2_stream_get_state(stream));
+  rv = nghttp2_session_mem_send_batch(session, buf, sizeof(buf));
 
-  /* Create idle stream by PRIORITY frame */
-  nghttp2_frame_priority_init(&frame.priority, 7, &pri_spec_default);
+  CU_ASSERT(rv > 0);
+  CU_ASSERT(0 == acc.length);
 
-  rv = nghttp2_frame_pack_priority(&bufs, &frame.priority);
+  rv = nghttp2_session_mem_send_batch(session, buf, sizeof(buf));
 
   CU_ASSERT(0 == rv);
+  CU_ASSERT(NGHTTP2_FRAME_HDLEN + 100 == acc.length);
 
-  nghttp2_frame_priority_free(&frame.priority);
+  nghttp2_session_del(session);
+}
 
-  buf = &bufs.head->buf;
-  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
+static void submission_wakeup_callback(nghttp2_session *session,
+                                       void *user_data) {
+  my_user_data *ud = (my_user_data *)user_data;
+  (void)session;
 
-  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+  ++ud->submission_wakeup_cb_called;
+}
 
-  stream = nghttp2_session_find_stream(session, 7);
+void test_nghttp2_session_submission_queue(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_option *option;
+  nghttp2_data_provider data_prd;
+  nghttp2_stream *stream;
+  my_user_data ud;
 
-  CU_ASSERT(NGHTTP2_STREAM_STATE_IDLE == nghttp2_stream_get_state(stream));
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+  callbacks.submission_wakeup_callback = submission_wakeup_callback;
 
-  nghttp2_bufs_reset(&bufs);
+  data_prd.read_callback = defer_data_source_read_callback;
 
-  nghttp2_hd_deflate_free(&deflater);
-  nghttp2_session_del(session);
+  /* The queue is not enabled by default */
+  nghttp2_session_server_new(&session, &callbacks, &ud);
 
-  /* Test for client side */
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE ==
+            nghttp2_session_enqueue_resume_data(session, 1));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE ==
+            nghttp2_session_enqueue_data(session, NGHTTP2_FLAG_NONE, 1,
+                                         &data_prd));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE ==
+            nghttp2_session_enqueue_rst_stream(session, 1, NGHTTP2_CANCEL));
 
-  nghttp2_session_client_new(&session, &callbacks, NULL);
-  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_session_del(session);
 
-  nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), NULL, NULL);
+  nghttp2_option_new(&option);
+  nghttp2_option_set_submission_queue(option, 1);
 
-  rv = nghttp2_session_send(session);
+  memset(&ud, 0, sizeof(ud));
 
-  CU_ASSERT(0 == rv);
+  nghttp2_session_server_new2(&session, &callbacks, &ud, option);
 
-  /* Receive PUSH_PROMISE 2 associated to stream 1 */
-  pack_push_promise(&bufs, &deflater, 1, NGHTTP2_FLAG_END_HEADERS, 2, reqnv,
-                    ARRLEN(reqnv), mem);
+  stream = open_recv_stream(session, 1);
+  open_recv_stream(session, 3);
 
-  buf = &bufs.head->buf;
-  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_session_enqueue_data(session, NGHTTP2_FLAG_NONE, 0,
+                                         &data_prd));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_session_enqueue_data(session, NGHTTP2_FLAG_NONE, 1, NULL));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_session_enqueue_resume_data(session, 0));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT ==
+            nghttp2_session_enqueue_rst_stream(session, -1, NGHTTP2_CANCEL));
+  CU_ASSERT(0 == ud.submission_wakeup_cb_called);
+  CU_ASSERT(0 == nghttp2_session_want_write(session));
 
-  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+  /* Only the first operation wakes up the owning thread */
+  CU_ASSERT(0 == nghttp2_session_enqueue_data(session, NGHTTP2_FLAG_END_STREAM,
+                                              1, &data_prd));
+  CU_ASSERT(0 ==
+            nghttp2_session_enqueue_rst_stream(session, 3, NGHTTP2_CANCEL));
+  CU_ASSERT(1 == ud.submission_wakeup_cb_called);
 
-  stream = nghttp2_session_find_stream(session, 2);
+  /* Nothing happens until the owning thread sends, but it wants to
+     send */
+  CU_ASSERT(NULL == stream->item);
+  CU_ASSERT(nghttp2_session_want_write(session));
 
-  CU_ASSERT(NGHTTP2_STREAM_STATE_RESERVED_REMOTE ==
-            nghttp2_stream_get_state(stream));
+  CU_ASSERT(0 == nghttp2_session_send(session));
 
-  nghttp2_bufs_reset(&bufs);
+  CU_ASSERT(1 == ud.frame_send_cb_called);
+  CU_ASSERT(NGHTTP2_RST_STREAM == ud.sent_frame_type);
+  CU_ASSERT(NULL != stream->item);
+  CU_ASSERT(nghttp2_stream_check_deferred_item(stream));
 
-  /* Receive push response for stream 2 without END_STREAM set */
-  pack_headers(&bufs, &deflater, 2, NGHTTP2_FLAG_END_HEADERS, resnv,
-               ARRLEN(resnv), mem);
+  /* Resume the deferred DATA */
+  stream->item->aux_data.data.data_prd.read_callback =
+      fixed_length_data_source_read_callback;
+  ud.data_source_length = 10;
 
-  buf = &bufs.head->buf;
-  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf));
+  CU_ASSERT(0 == nghttp2_session_want_write(session));
+  CU_ASSERT(0 == nghttp2_session_enqueue_resume_data(session, 1));
+  CU_ASSERT(2 == ud.submission_wakeup_cb_called);
+  CU_ASSERT(nghttp2_session_want_write(session));
 
-  CU_ASSERT((ssize_t)nghttp2_buf_len(buf) == rv);
+  CU_ASSERT(0 == nghttp2_session_send(session));
 
-  stream = nghttp2_session_find_stream(session, 2);
+  CU_ASSERT(2 == ud.frame_send_cb_called);
+  CU_ASSERT(NGHTTP2_DATA == ud.sent_frame_type);
+  CU_ASSERT(0 == ud.data_source_length);
 
-  CU_ASSERT(NGHTTP2_STREAM_STATE_HALF_CLOSED_LOCAL ==
-            nghttp2_stream_get_state(stream));
+  /* Operations on a closed stream are ignored */
+  CU_ASSERT(0 == nghttp2_session_enqueue_resume_data(session, 1));
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(2 == ud.frame_send_cb_called);
 
-  nghttp2_bufs_reset(&bufs);
+  /* Operations left in the queue are freed */
+  CU_ASSERT(0 == nghttp2_session_enqueue_data(session, NGHTTP2_FLAG_NONE, 5,
+                                              &data_prd));
 
-  nghttp2_hd_deflate_free(&deflater);
   nghttp2_session_del(session);
-
-  nghttp2_bufs_free(&bufs);
+  nghttp2_option_del(option);
 }
 
-void test_nghttp2_session_stream_get_something(void) {
+void test_nghttp2_session_auto_window_tuning(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *a, *b, *c;
-
-  memset(&callbacks, 0, sizeof(callbacks));
-
-  nghttp2_session_server_new(&session, &callbacks, NULL);
-
-  a = open_stream(session, 1);
+  nghttp2_option *option;
+  nghttp2_window_tuning_stats stats;
+  nghttp2_stream *stream;
+  nghttp2_frame frame;
+  const uint8_t *pos;
+  int i;
 
-  CU_ASSERT(nghttp2_session_get_root_stream(session) ==
-            nghttp2_stream_get_parent(a));
-  CU_ASSERT(NULL == nghttp2_stream_get_previous_sibling(a));
-  CU_ASSERT(NULL == nghttp2_stream_get_next_sibling(a));
-  CU_ASSERT(NULL == nghttp2_stream_get_first_child(a));
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
 
-  b = open_stream_with_dep(session, 3, a);
-  c = open_stream_with_dep_weight(session, 5, 11, a);
+  /* Disabled by default */
+  nghttp2_session_client_new(&session, &callbacks, NULL);
 
-  CU_ASSERT(a == nghttp2_stream_get_parent(c));
-  CU_ASSERT(a == nghttp2_stream_get_parent(b));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE ==
+            nghttp2_session_get_window_tuning_stats(session, &stats));
 
-  CU_ASSERT(c == nghttp2_stream_get_first_child(a));
+  nghttp2_session_del(session);
 
-  CU_ASSERT(b == nghttp2_stream_get_next_sibling(c));
-  CU_ASSERT(c == nghttp2_stream_get_previous_sibling(b));
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_auto_window_size(option, 1 << 20);
 
-  CU_ASSERT(27 == nghttp2_stream_get_sum_dependency_weight(a));
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
 
-  CU_ASSERT(11 == nghttp2_stream_get_weight(c));
-  CU_ASSERT(5 == nghttp2_stream_get_stream_id(c));
-  CU_ASSERT(0 == nghttp2_stream_get_stream_id(&session->root));
+  stream = open_sent_stream2(session, 1, NGHTTP2_STREAM_OPENED);
 
-  nghttp2_session_del(session);
-}
+  /* The first DATA starts the measurement */
+  recv_data_frame(session, 1, NGHTTP2_DATA_PAYLOADLEN);
 
-void test_nghttp2_session_find_stream(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  nghttp2_stream *stream;
+  CU_ASSERT(session->window_tuner.ping_outstanding);
 
-  memset(&callbacks, 0, sizeof(callbacks));
+  /* 48000 bytes consumed in one round trip, which is more than 2/3 of
+     the connection window */
+  for (i = 0; i < 3; ++i) {
+    recv_data_frame(session, 1, 16000);
+  }
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  ack_window_tuning_ping(session);
 
-  open_recv_stream(session, 1);
+  CU_ASSERT(0 == nghttp2_session_get_window_tuning_stats(session, &stats));
+  CU_ASSERT(48000 == stats.bdp);
+  CU_ASSERT(1 == stats.num_samples);
+  CU_ASSERT(1 == stats.num_grows);
+  CU_ASSERT(0 == stats.num_shrinks);
+  CU_ASSERT(96000 == stats.window_size);
+  CU_ASSERT(1 << 20 == stats.max_window_size);
+  CU_ASSERT(NGHTTP2_WINDOW_TUNING_ACTION_GROW == stats.last_action);
+  CU_ASSERT(96000 == session->local_window_size);
+  CU_ASSERT(NGHTTP2_INITIAL_WINDOW_SIZE == stream->local_window_size);
 
-  stream = nghttp2_session_find_stream(session, 1);
+  /* The stream window follows when the stream receives DATA */
+  recv_data_frame(session, 1, 100);
 
-  CU_ASSERT(NULL != stream);
-  CU_ASSERT(1 == stream->stream_id);
+  CU_ASSERT(96000 == stream->local_window_size);
 
-  stream = nghttp2_session_find_stream(session, 0);
+  /* PING ACK which was not sent by window tuning is ignored */
+  nghttp2_frame_ping_init(&frame.ping, NGHTTP2_FLAG_ACK, NULL);
 
-  CU_ASSERT(&session->root == stream);
-  CU_ASSERT(0 == stream->stream_id);
+  CU_ASSERT(0 == nghttp2_session_on_ping_received(session, &frame));
 
-  stream = nghttp2_session_find_stream(session, 2);
+  nghttp2_frame_ping_free(&frame.ping);
 
-  CU_ASSERT(NULL == stream);
+  CU_ASSERT(0 == nghttp2_session_get_window_tuning_stats(session, &stats));
+  CU_ASSERT(1 == stats.num_samples);
 
-  nghttp2_session_del(session);
-}
+  /* Round trips which consume little shrink the windows */
+  for (i = 0; i < NGHTTP2_WINDOW_TUNING_SHRINK_SAMPLES; ++i) {
+    if (i > 0) {
+      recv_data_frame(session, 1, 100);
+    }
 
-void test_nghttp2_session_keep_closed_stream(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  const size_t max_concurrent_streams = 5;
-  nghttp2_settings_entry iv = {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
-                               (uint32_t)max_concurrent_streams};
-  size_t i;
+    ack_window_tuning_ping(session);
 
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.send_callback = null_send_callback;
+    CU_ASSERT(0 == nghttp2_session_get_window_tuning_stats(session, &stats));
+    CU_ASSERT(0 == stats.bdp);
+    CU_ASSERT((uint64_t)i + 2 == stats.num_samples);
+  }
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  CU_ASSERT(1 == stats.num_shrinks);
+  CU_ASSERT(NGHTTP2_WINDOW_TUNING_ACTION_SHRINK == stats.last_action);
+  CU_ASSERT(NGHTTP2_INITIAL_WINDOW_SIZE == session->local_window_size);
 
-  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, &iv, 1);
+  recv_data_frame(session, 1, 100);
 
-  for (i = 0; i < max_concurrent_streams; ++i) {
-    open_recv_stream(session, (int32_t)i * 2 + 1);
-  }
+  CU_ASSERT(NGHTTP2_INITIAL_WINDOW_SIZE == stream->local_window_size);
 
-  CU_ASSERT(0 == session->num_closed_streams);
+  nghttp2_session_del(session);
 
-  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
+  /* With nghttp2_option_set_no_auto_window_update, consumed bytes
+     are counted. */
+  nghttp2_option_set_no_auto_window_update(option, 1);
 
-  CU_ASSERT(1 == session->num_closed_streams);
-  CU_ASSERT(1 == session->closed_stream_tail->stream_id);
-  CU_ASSERT(session->closed_stream_tail == session->closed_stream_head);
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
 
-  nghttp2_session_close_stream(session, 5, NGHTTP2_NO_ERROR);
+  open_sent_stream2(session, 1, NGHTTP2_STREAM_OPENED);
 
-  CU_ASSERT(2 == session->num_closed_streams);
-  CU_ASSERT(5 == session->closed_stream_tail->stream_id);
-  CU_ASSERT(1 == session->closed_stream_head->stream_id);
-  CU_ASSERT(session->closed_stream_head ==
-            session->closed_stream_tail->closed_prev);
-  CU_ASSERT(NULL == session->closed_stream_tail->closed_next);
-  CU_ASSERT(session->closed_stream_tail ==
-            session->closed_stream_head->closed_next);
-  CU_ASSERT(NULL == session->closed_stream_head->closed_prev);
+  recv_data_frame(session, 1, 100);
 
-  open_recv_stream(session, 11);
-  nghttp2_session_adjust_closed_stream(session);
+  CU_ASSERT(!session->window_tuner.ping_outstanding);
 
-  CU_ASSERT(1 == session->num_closed_streams);
-  CU_ASSERT(5 == session->closed_stream_tail->stream_id);
-  CU_ASSERT(session->closed_stream_tail == session->closed_stream_head);
-  CU_ASSERT(NULL == session->closed_stream_head->closed_prev);
-  CU_ASSERT(NULL == session->closed_stream_head->closed_next);
+  CU_ASSERT(0 == nghttp2_session_consume(session, 1, 100));
+  CU_ASSERT(session->window_tuner.ping_outstanding);
 
-  open_recv_stream(session, 13);
-  nghttp2_session_adjust_closed_stream(session);
+  while (nghttp2_session_mem_send(session, &pos) > 0)
+    ;
 
-  CU_ASSERT(0 == session->num_closed_streams);
-  CU_ASSERT(NULL == session->closed_stream_tail);
-  CU_ASSERT(NULL == session->closed_stream_head);
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+}
 
-  nghttp2_session_close_stream(session, 3, NGHTTP2_NO_ERROR);
+/* Serializes all pending frames of |session| into |buf|, and counts
+   them per frame type. */
+static size_t send_and_count_frames(nghttp2_session *session, uint8_t *buf,
+                                    size_t buflen, uint64_t *frames,
+                                    uint64_t *bytes) {
+  const uint8_t *data;
+  ssize_t datalen;
+  size_t len = 0;
+  size_t idx;
+  nghttp2_frame_hd hd;
+  const uint8_t *p;
 
-  CU_ASSERT(1 == session->num_closed_streams);
-  CU_ASSERT(3 == session->closed_stream_head->stream_id);
+  memset(frames, 0, sizeof(uint64_t) * NGHTTP2_STATS_FRAME_TYPE_LEN);
+  memset(bytes, 0, sizeof(uint64_t) * NGHTTP2_STATS_FRAME_TYPE_LEN);
 
-  /* server initiated stream is not counted to max concurrent limit */
-  open_sent_stream(session, 2);
-  nghttp2_session_adjust_closed_stream(session);
+  while ((datalen = nghttp2_session_mem_send(session, &data)) > 0) {
+    assert(len + (size_t)datalen <= buflen);
 
-  CU_ASSERT(1 == session->num_closed_streams);
-  CU_ASSERT(3 == session->closed_stream_head->stream_id);
+    memcpy(buf + len, data, (size_t)datalen);
+    len += (size_t)datalen;
+  }
 
-  nghttp2_session_close_stream(session, 2, NGHTTP2_NO_ERROR);
+  for (p = buf; p != buf + len; p += NGHTTP2_FRAME_HDLEN + hd.length) {
+    nghttp2_frame_unpack_frame_hd(&hd, p);
 
-  CU_ASSERT(1 == session->num_closed_streams);
-  CU_ASSERT(3 == session->closed_stream_head->stream_id);
+    idx = nghttp2_min(hd.type, NGHTTP2_STATS_FRAME_TYPE_OTHER);
 
-  nghttp2_session_del(session);
+    ++frames[idx];
+    bytes[idx] += NGHTTP2_FRAME_HDLEN + hd.length;
+  }
+
+  return len;
 }
 
-void test_nghttp2_session_keep_idle_stream(void) {
-  nghttp2_session *session;
+void test_nghttp2_session_stats(void) {
+  nghttp2_session *client, *server;
   nghttp2_session_callbacks callbacks;
-  const size_t max_concurrent_streams = 1;
-  nghttp2_settings_entry iv = {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
-                               (uint32_t)max_concurrent_streams};
-  int i;
-  int32_t stream_id;
+  nghttp2_session_stats cstats, sstats;
+  nghttp2_data_provider data_prd;
+  my_user_data ud;
+  uint8_t value[40000];
+  nghttp2_nv nva[] = {MAKE_NV(":method", "GET"), MAKE_NV(":scheme", "https"),
+                      MAKE_NV(":authority", "example.org"),
+                      MAKE_NV(":path", "/"), MAKE_NV("big", "")};
+  static uint8_t buf[1 << 17];
+  size_t buflen;
+  uint64_t frames[NGHTTP2_STATS_FRAME_TYPE_LEN];
+  uint64_t bytes[NGHTTP2_STATS_FRAME_TYPE_LEN];
+  uint64_t nvbytes = 0;
+  size_t i;
 
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.send_callback = null_send_callback;
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  for (i = 0; i < sizeof(value); ++i) {
+    value[i] = (uint8_t)('a' + i % 26);
+  }
 
-  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, &iv, 1);
+  nva[4].value = value;
+  nva[4].valuelen = sizeof(value);
 
-  /* We at least allow NGHTTP2_MIN_IDLE_STREAM idle streams even if
-     max concurrent streams is very low. */
-  for (i = 0; i < NGHTTP2_MIN_IDLE_STREAMS; ++i) {
-    open_recv_stream2(session, i * 2 + 1, NGHTTP2_STREAM_IDLE);
-    nghttp2_session_adjust_idle_stream(session);
+  for (i = 0; i < ARRLEN(nva); ++i) {
+    nvbytes += nva[i].namelen + nva[i].valuelen;
   }
 
-  CU_ASSERT(NGHTTP2_MIN_IDLE_STREAMS == session->num_idle_streams);
+  nghttp2_session_client_new(&client, &callbacks, NULL);
+  nghttp2_session_server_new(&server, &callbacks, NULL);
 
-  stream_id = (NGHTTP2_MIN_IDLE_STREAMS - 1) * 2 + 1;
-  CU_ASSERT(1 == session->idle_stream_head->stream_id);
-  CU_ASSERT(stream_id == session->idle_stream_tail->stream_id);
+  CU_ASSERT(1 == nghttp2_submit_request(client, NULL, nva, ARRLEN(nva), NULL,
+                                        NULL));
+  nghttp2_submit_ping(client, NGHTTP2_FLAG_NONE, NULL);
 
-  stream_id += 2;
+  buflen = send_and_count_frames(client, buf, sizeof(buf), frames, bytes);
 
-  open_recv_stream2(session, stream_id, NGHTTP2_STREAM_IDLE);
-  nghttp2_session_adjust_idle_stream(session);
+  /* The header block does not fit in one frame */
+  CU_ASSERT(frames[NGHTTP2_CONTINUATION] > 0);
 
-  CU_ASSERT(NGHTTP2_MIN_IDLE_STREAMS == session->num_idle_streams);
-  CU_ASSERT(3 == session->idle_stream_head->stream_id);
-  CU_ASSERT(stream_id == session->idle_stream_tail->stream_id);
+  nghttp2_session_get_stats(client, &cstats);
 
-  nghttp2_session_del(session);
-}
+  for (i = 0; i < NGHTTP2_STATS_FRAME_TYPE_LEN; ++i) {
+    CU_ASSERT(frames[i] == cstats.frames_sent[i]);
+    CU_ASSERT(bytes[i] == cstats.bytes_sent[i]);
+    CU_ASSERT(0 == cstats.frames_recv[i]);
+  }
 
-void test_nghttp2_session_detach_idle_stream(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  int i;
-  nghttp2_stream *stream;
+  CU_ASSERT(ARRLEN(nva) == cstats.hd_deflate_num_fields);
+  CU_ASSERT(nvbytes == cstats.hd_deflate_uncompressed_bytes);
+  CU_ASSERT(bytes[NGHTTP2_HEADERS] + bytes[NGHTTP2_CONTINUATION] -
+                (frames[NGHTTP2_HEADERS] + frames[NGHTTP2_CONTINUATION]) *
+                    NGHTTP2_FRAME_HDLEN ==
+            cstats.hd_deflate_compressed_bytes);
+  CU_ASSERT(0 == cstats.hd_deflate_num_dynamic_table_hits);
+  CU_ASSERT(1 == cstats.num_streams_opened);
+  CU_ASSERT(1 == cstats.max_concurrent_streams);
 
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.send_callback = null_send_callback;
+  CU_ASSERT((ssize_t)buflen == nghttp2_session_mem_recv(server, buf, buflen));
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  nghttp2_session_get_stats(server, &sstats);
 
-  for (i = 1; i <= 3; ++i) {
-    nghttp2_session_open_stream(session, i, NGHTTP2_STREAM_FLAG_NONE,
-                                &pri_spec_default, NGHTTP2_STREAM_IDLE, NULL);
+  for (i = 0; i < NGHTTP2_STATS_FRAME_TYPE_LEN; ++i) {
+    CU_ASSERT(frames[i] == sstats.frames_recv[i]);
+    CU_ASSERT(bytes[i] == sstats.bytes_recv[i]);
   }
 
-  CU_ASSERT(3 == session->num_idle_streams);
+  CU_ASSERT(ARRLEN(nva) == sstats.hd_inflate_num_fields);
+  CU_ASSERT(nvbytes == sstats.hd_inflate_uncompressed_bytes);
+  CU_ASSERT(cstats.hd_deflate_compressed_bytes ==
+            sstats.hd_inflate_compressed_bytes);
+  CU_ASSERT(1 == sstats.num_streams_opened);
 
-  /* Detach middle stream */
-  stream = nghttp2_session_get_stream_raw(session, 2);
+  /* The second request finds the fields in the dynamic table */
+  CU_ASSERT(3 == nghttp2_submit_request(client, NULL, nva, 4, NULL, NULL));
 
-  CU_ASSERT(session->idle_stream_head == stream->closed_prev);
-  CU_ASSERT(session->idle_stream_tail == stream->closed_next);
-  CU_ASSERT(stream == session->idle_stream_head->closed_next);
-  CU_ASSERT(stream == session->idle_stream_tail->closed_prev);
+  buflen = send_and_count_frames(client, buf, sizeof(buf), frames, bytes);
 
-  nghttp2_session_detach_idle_stream(session, stream);
+  CU_ASSERT((ssize_t)buflen == nghttp2_session_mem_recv(server, buf, buflen));
 
-  CU_ASSERT(2 == session->num_idle_streams);
+  nghttp2_session_get_stats(client, &cstats);
+  nghttp2_session_get_stats(server, &sstats);
 
-  CU_ASSERT(NULL == stream->closed_prev);
-  CU_ASSERT(NULL == stream->closed_next);
+  CU_ASSERT(cstats.hd_deflate_num_dynamic_table_hits > 0);
+  CU_ASSERT(cstats.hd_deflate_num_dynamic_table_hits ==
+            sstats.hd_inflate_num_dynamic_table_hits);
+  CU_ASSERT(2 == cstats.max_concurrent_streams);
+  CU_ASSERT(2 == sstats.max_concurrent_streams);
 
-  CU_ASSERT(session->idle_stream_head ==
-            session->idle_stream_tail->closed_prev);
-  CU_ASSERT(session->idle_stream_tail ==
-            session->idle_stream_head->closed_next);
+  /* Refusing a stream */
+  nghttp2_submit_rst_stream(server, NGHTTP2_FLAG_NONE, 3,
+                            NGHTTP2_REFUSED_STREAM);
+  nghttp2_submit_rst_stream(server, NGHTTP2_FLAG_NONE, 1, NGHTTP2_CANCEL);
 
-  /* Detach head stream */
-  stream = session->idle_stream_head;
+  buflen = send_and_count_frames(server, buf, sizeof(buf), frames, bytes);
 
-  nghttp2_session_detach_idle_stream(session, stream);
+  CU_ASSERT((ssize_t)buflen == nghttp2_session_mem_recv(client, buf, buflen));
 
-  CU_ASSERT(1 == session->num_idle_streams);
+  nghttp2_session_get_stats(client, &cstats);
+  nghttp2_session_get_stats(server, &sstats);
 
-  CU_ASSERT(session->idle_stream_head == session->idle_stream_tail);
-  CU_ASSERT(NULL == session->idle_stream_head->closed_prev);
-  CU_ASSERT(NULL == session->idle_stream_head->closed_next);
+  CU_ASSERT(2 == sstats.num_streams_reset_sent);
+  CU_ASSERT(1 == sstats.num_streams_refused_sent);
+  CU_ASSERT(2 == cstats.num_streams_reset_recv);
+  CU_ASSERT(1 == cstats.num_streams_refused_recv);
+  CU_ASSERT(0 == cstats.num_streams_reset_sent);
 
-  /* Detach last stream */
+  nghttp2_session_del(server);
+  nghttp2_session_del(client);
 
-  stream = session->idle_stream_head;
+  /* Connection level flow control */
+  data_prd.read_callback = fixed_length_data_source_read_callback;
 
-  nghttp2_session_detach_idle_stream(session, stream);
+  memset(&ud, 0, sizeof(ud));
+  ud.data_source_length = NGHTTP2_INITIAL_WINDOW_SIZE + 1;
 
-  CU_ASSERT(0 == session->num_idle_streams);
+  nghttp2_session_client_new(&client, &callbacks, &ud);
 
-  CU_ASSERT(NULL == session->idle_stream_head);
-  CU_ASSERT(NULL == session->idle_stream_tail);
+  nghttp2_submit_request(client, NULL, nva, 4, &data_prd, NULL);
 
-  for (i = 4; i <= 5; ++i) {
-    nghttp2_session_open_stream(session, i, NGHTTP2_STREAM_FLAG_NONE,
-                                &pri_spec_default, NGHTTP2_STREAM_IDLE, NULL);
-  }
+  send_and_count_frames(client, buf, sizeof(buf), frames, bytes);
 
-  CU_ASSERT(2 == session->num_idle_streams);
+  nghttp2_session_get_stats(client, &cstats);
 
-  /* Detach tail stream */
+  CU_ASSERT(1 == cstats.connection_flow_control_blocked);
+  CU_ASSERT(0 == cstats.stream_flow_control_blocked);
+  CU_ASSERT(NGHTTP2_INITIAL_WINDOW_SIZE +
+                frames[NGHTTP2_DATA] * NGHTTP2_FRAME_HDLEN ==
+            cstats.bytes_sent[NGHTTP2_DATA]);
 
-  stream = session->idle_stream_tail;
+  nghttp2_session_del(client);
 
-  nghttp2_session_detach_idle_stream(session, stream);
+  /* Stream level flow control */
+  ud.data_source_length = NGHTTP2_INITIAL_WINDOW_SIZE + 1;
 
-  CU_ASSERT(1 == session->num_idle_streams);
+  nghttp2_session_client_new(&client, &callbacks, &ud);
 
-  CU_ASSERT(session->idle_stream_head == session->idle_stream_tail);
-  CU_ASSERT(NULL == session->idle_stream_head->closed_prev);
-  CU_ASSERT(NULL == session->idle_stream_head->closed_next);
+  client->remote_window_size = 1 << 20;
 
-  nghttp2_session_del(session);
+  nghttp2_submit_request(client, NULL, nva, 4, &data_prd, NULL);
+
+  send_and_count_frames(client, buf, sizeof(buf), frames, bytes);
+
+  nghttp2_session_get_stats(client, &cstats);
+
+  CU_ASSERT(0 == cstats.connection_flow_control_blocked);
+  CU_ASSERT(1 == cstats.stream_flow_control_blocked);
+
+  nghttp2_session_del(client);
 }
 
-void test_nghttp2_session_large_dep_tree(void) {
-  nghttp2_session *session;
+void test_nghttp2_session_mem_recv_split(void) {
+  nghttp2_session *client, *server[2];
   nghttp2_session_callbacks callbacks;
+  nghttp2_session_stats stats[2];
+  nghttp2_data_provider data_prd;
+  nghttp2_settings_entry iv[2];
+  my_user_data ud[2];
+  uint8_t value[20000];
+  const uint8_t opaque_data[] = "debug";
+  nghttp2_nv nva[] = {MAKE_NV(":method", "POST"), MAKE_NV(":scheme", "https"),
+                      MAKE_NV(":authority", "example.org"),
+                      MAKE_NV(":path", "/"), MAKE_NV("big", "")};
+  static uint8_t buf[1 << 16];
+  size_t buflen;
+  const uint8_t *data;
+  ssize_t datalen;
+  ssize_t rv;
   size_t i;
-  nghttp2_stream *dep_stream = NULL;
-  nghttp2_stream *stream;
-  int32_t stream_id;
 
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.send_callback = null_send_callback;
-
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.on_frame_recv_callback = on_frame_recv_callback;
+  callbacks.on_data_chunk_recv_callback = on_data_chunk_recv_callback;
 
-  stream_id = 1;
-  for (i = 0; i < 250; ++i, stream_id += 2) {
-    dep_stream = open_stream_with_dep(session, stream_id, dep_stream);
-  }
+  memset(value, 'a', sizeof(value));
 
-  stream_id = 1;
-  for (i = 0; i < 250; ++i, stream_id += 2) {
-    stream = nghttp2_session_get_stream(session, stream_id);
-    CU_ASSERT(nghttp2_stream_dep_find_ancestor(stream, &session->root));
-    CU_ASSERT(nghttp2_stream_in_dep_tree(stream));
-  }
+  nva[4].value = value;
+  nva[4].valuelen = sizeof(value);
 
-  nghttp2_session_del(session);
-}
+  data_prd.read_callback = fixed_length_data_source_read_callback;
 
-void test_nghttp2_session_graceful_shutdown(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  my_user_data ud;
+  memset(ud, 0, sizeof(ud));
+  ud[0].data_source_length = 100;
 
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.send_callback = null_send_callback;
-  callbacks.on_frame_send_callback = on_frame_send_callback;
-  callbacks.on_stream_close_callback = on_stream_close_callback;
+  nghttp2_session_client_new(&client, &callbacks, &ud[0]);
 
-  nghttp2_session_server_new(&session, &callbacks, &ud);
+  iv[0].settings_id = NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  iv[0].value = 100;
+  iv[1].settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  iv[1].value = 1 << 20;
 
-  open_recv_stream(session, 301);
-  open_sent_stream(session, 302);
-  open_recv_stream(session, 309);
-  open_recv_stream(session, 311);
-  open_recv_stream(session, 319);
+  nghttp2_submit_settings(client, NGHTTP2_FLAG_NONE, iv, ARRLEN(iv));
+  CU_ASSERT(1 == nghttp2_submit_request(client, NULL, nva, ARRLEN(nva),
+                                        &data_prd, NULL));
+  nghttp2_submit_ping(client, NGHTTP2_FLAG_NONE, NULL);
+  nghttp2_submit_window_update(client, NGHTTP2_FLAG_NONE, 0, 1000);
 
-  CU_ASSERT(0 == nghttp2_submit_shutdown_notice(session));
+  buflen = 0;
 
-  ud.frame_send_cb_called = 0;
+  for (i = 0; i < 2; ++i) {
+    while ((datalen = nghttp2_session_mem_send(client, &data)) > 0) {
+      assert(buflen + (size_t)datalen <= sizeof(buf));
 
-  CU_ASSERT(0 == nghttp2_session_send(session));
+      memcpy(buf + buflen, data, (size_t)datalen);
+      buflen += (size_t)datalen;
+    }
 
-  CU_ASSERT(1 == ud.frame_send_cb_called);
-  CU_ASSERT((1u << 31) - 1 == session->local_last_stream_id);
+    if (i == 0) {
+      /* GOAWAY goes last; once it is received, the server stops
+         reading if it has no active streams. */
+      nghttp2_submit_goaway(client, NGHTTP2_FLAG_NONE, 0, NGHTTP2_NO_ERROR,
+                            opaque_data, sizeof(opaque_data) - 1);
+    }
+  }
 
-  CU_ASSERT(0 == nghttp2_submit_goaway(session, NGHTTP2_FLAG_NONE, 311,
-                                       NGHTTP2_NO_ERROR, NULL, 0));
+  nghttp2_session_del(client);
 
-  ud.frame_send_cb_called = 0;
-  ud.stream_close_cb_called = 0;
+  memset(ud, 0, sizeof(ud));
 
-  CU_ASSERT(0 == nghttp2_session_send(session));
+  /* The whole input at once */
+  nghttp2_session_server_new(&server[0], &callbacks, &ud[0]);
 
-  CU_ASSERT(1 == ud.frame_send_cb_called);
-  CU_ASSERT(311 == session->local_last_stream_id);
-  CU_ASSERT(1 == ud.stream_close_cb_called);
+  rv = nghttp2_session_mem_recv(server[0], buf, buflen);
 
-  CU_ASSERT(0 ==
-            nghttp2_session_terminate_session2(session, 301, NGHTTP2_NO_ERROR));
+  CU_ASSERT((ssize_t)buflen == rv);
 
-  ud.frame_send_cb_called = 0;
-  ud.stream_close_cb_called = 0;
+  /* One byte at a time, so that nothing can be read in place */
+  nghttp2_session_server_new(&server[1], &callbacks, &ud[1]);
 
-  CU_ASSERT(0 == nghttp2_session_send(session));
+  for (i = 0; i < buflen; ++i) {
+    rv = nghttp2_session_mem_recv(server[1], buf + i, 1);
 
-  CU_ASSERT(1 == ud.frame_send_cb_called);
-  CU_ASSERT(301 == session->local_last_stream_id);
-  CU_ASSERT(2 == ud.stream_close_cb_called);
+    CU_ASSERT(1 == rv);
+  }
 
-  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 301));
-  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 302));
-  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 309));
-  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 311));
-  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 319));
+  for (i = 0; i < 2; ++i) {
+    nghttp2_session_get_stats(server[i], &stats[i]);
+  }
 
-  nghttp2_session_del(session);
+  CU_ASSERT(6 == ud[0].frame_recv_cb_called);
+  CU_ASSERT(ud[0].frame_recv_cb_called == ud[1].frame_recv_cb_called);
+  CU_ASSERT(100 == ud[0].data_chunk_len);
+  CU_ASSERT(0 == memcmp(stats[0].frames_recv, stats[1].frames_recv,
+                        sizeof(stats[0].frames_recv)));
+  CU_ASSERT(0 == memcmp(stats[0].bytes_recv, stats[1].bytes_recv,
+                        sizeof(stats[0].bytes_recv)));
+
+  for (i = 0; i < 2; ++i) {
+    CU_ASSERT(100 == server[i]->remote_settings.max_concurrent_streams);
+    CU_ASSERT((1 << 20) == server[i]->remote_settings.initial_window_size);
+    CU_ASSERT(NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE + 1000 ==
+              server[i]->remote_window_size);
+    CU_ASSERT(server[i]->goaway_flags & NGHTTP2_GOAWAY_RECV);
+    CU_ASSERT(NULL != nghttp2_session_get_stream(server[i], 1));
+
+    nghttp2_session_del(server[i]);
+  }
 }
 
-void test_nghttp2_session_on_header_temporal_failure(void) {
+void test_nghttp2_session_on_begin_headers_temporal_failure(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
   my_user_data ud;
   nghttp2_bufs bufs;
-  nghttp2_buf *buf;
-  nghttp2_hd_deflater deflater;
-  nghttp2_nv nv[] = {MAKE_NV("alpha", "bravo"), MAKE_NV("charlie", "delta")};
-  nghttp2_nv *nva;
-  size_t hdpos;
+  nghttp2_mem *mem;
   ssize_t rv;
-  nghttp2_frame frame;
-  nghttp2_frame_hd hd;
+  nghttp2_hd_deflater deflater;
   nghttp2_outbound_item *item;
-  nghttp2_mem *mem;
 
   mem = nghttp2_mem_default();
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.on_header_callback = temporal_failure_on_header_callback;
-
-  nghttp2_session_server_new(&session, &callbacks, &ud);
-
   frame_pack_bufs_init(&bufs);
-
   nghttp2_hd_deflate_init(&deflater, mem);
 
-  nghttp2_nv_array_copy(&nva, reqnv, ARRLEN(reqnv), mem);
-
-  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_STREAM, 1,
-                             NGHTTP2_HCAT_REQUEST, NULL, nva, ARRLEN(reqnv));
-  nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
-  nghttp2_frame_headers_free(&frame.headers, mem);
-
-  /* We are going to create CONTINUATION.  First serialize header
-     block, and then frame header. */
-  hdpos = nghttp2_bufs_len(&bufs);
-
-  buf = &bufs.head->buf;
-  buf->last += NGHTTP2_FRAME_HDLEN;
-
-  nghttp2_hd_deflate_hd_bufs(&deflater, &bufs, &nv[1], 1);
-
-  nghttp2_frame_hd_init(&hd,
-                        nghttp2_bufs_len(&bufs) - hdpos - NGHTTP2_FRAME_HDLEN,
-                        NGHTTP2_CONTINUATION, NGHTTP2_FLAG_END_HEADERS, 1);
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.on_begin_headers_callback =
+      temporal_failure_on_begin_headers_callback;
+  callbacks.on_header_callback = on_header_callback;
+  callbacks.on_frame_recv_callback = on_frame_recv_callback;
+  callbacks.send_callback = null_send_callback;
+  nghttp2_session_server_new(&session, &callbacks, &ud);
 
-  nghttp2_frame_pack_frame_hd(&buf->pos[hdpos], &hd);
+  rv = pack_headers(&bufs, &deflater, 1, NGHTTP2_FLAG_END_HEADERS, reqnv,
+                    ARRLEN(reqnv), mem);
+  CU_ASSERT(0 == rv);
 
   ud.header_cb_called = 0;
-  rv = nghttp2_session_mem_recv(session, buf->pos, nghttp2_bufs_len(&bufs));
-
+  ud.frame_recv_cb_called = 0;
+  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                nghttp2_bufs_len(&bufs));
   CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
-  CU_ASSERT(1 == ud.header_cb_called);
+  CU_ASSERT(0 == ud.header_cb_called);
+  CU_ASSERT(0 == ud.frame_recv_cb_called);
 
   item = nghttp2_session_get_next_ob_item(session);
-
   CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
   CU_ASSERT(1 == item->frame.hd.stream_id);
+  CU_ASSERT(NGHTTP2_INTERNAL_ERROR == item->frame.rst_stream.error_code);
 
-  /* Make sure no header decompression error occurred */
-  CU_ASSERT(NGHTTP2_GOAWAY_NONE == session->goaway_flags);
-
-  nghttp2_hd_deflate_free(&deflater);
   nghttp2_session_del(session);
+  nghttp2_hd_deflate_free(&deflater);
 
   nghttp2_bufs_reset(&bufs);
-
-  /* Check for PUSH_PROMISE */
+  /* check for PUSH_PROMISE */
   nghttp2_hd_deflate_init(&deflater, mem);
   nghttp2_session_client_new(&session, &callbacks, &ud);
 
@@ -9403,10 +11576,12 @@ void test_nghttp2_session_on_header_temporal_failure(void) {
   CU_ASSERT(0 == rv);
 
   ud.header_cb_called = 0;
+  ud.frame_recv_cb_called = 0;
   rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
                                 nghttp2_bufs_len(&bufs));
   CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
-  CU_ASSERT(1 == ud.header_cb_called);
+  CU_ASSERT(0 == ud.header_cb_called);
+  CU_ASSERT(0 == ud.frame_recv_cb_called);
 
   item = nghttp2_session_get_next_ob_item(session);
   CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
@@ -9418,589 +11593,616 @@ void test_nghttp2_session_on_header_temporal_failure(void) {
   nghttp2_bufs_free(&bufs);
 }
 
-void test_nghttp2_session_recv_client_magic(void) {
+void test_nghttp2_session_defer_then_close(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  ssize_t rv;
-  nghttp2_frame ping_frame;
-  uint8_t buf[16];
-
-  /* enable global nghttp2_enable_strict_preface here */
-  nghttp2_enable_strict_preface = 1;
+  nghttp2_data_provider prd;
+  int rv;
+  const uint8_t *datap;
+  ssize_t datalen;
+  nghttp2_frame frame;
 
-  memset(&callbacks, 0, sizeof(callbacks));
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
 
-  /* Check success case */
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  nghttp2_session_client_new(&session, &callbacks, NULL);
 
-  rv = nghttp2_session_mem_recv(session, (const uint8_t *)NGHTTP2_CLIENT_MAGIC,
-                                NGHTTP2_CLIENT_MAGIC_LEN);
+  prd.read_callback = defer_data_source_read_callback;
 
-  CU_ASSERT(rv == NGHTTP2_CLIENT_MAGIC_LEN);
-  CU_ASSERT(NGHTTP2_IB_READ_FIRST_SETTINGS == session->iframe.state);
+  rv = nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), &prd, NULL);
+  CU_ASSERT(rv > 0);
 
-  /* Receiving PING is error because we want SETTINGS. */
-  nghttp2_frame_ping_init(&ping_frame.ping, NGHTTP2_FLAG_NONE, NULL);
+  /* This sends HEADERS */
+  datalen = nghttp2_session_mem_send(session, &datap);
 
-  nghttp2_frame_pack_frame_hd(buf, &ping_frame.ping.hd);
+  CU_ASSERT(datalen > 0);
 
-  rv = nghttp2_session_mem_recv(session, buf, NGHTTP2_FRAME_HDLEN);
-  CU_ASSERT(NGHTTP2_FRAME_HDLEN == rv);
-  CU_ASSERT(NGHTTP2_IB_IGN_ALL == session->iframe.state);
-  CU_ASSERT(0 == session->iframe.payloadleft);
+  /* This makes DATA item deferred */
+  datalen = nghttp2_session_mem_send(session, &datap);
 
-  nghttp2_frame_ping_free(&ping_frame.ping);
+  CU_ASSERT(datalen == 0);
 
-  nghttp2_session_del(session);
+  nghttp2_frame_rst_stream_init(&frame.rst_stream, 1, NGHTTP2_CANCEL);
 
-  /* Check bad case */
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  /* Assertion failure; GH-264 */
+  rv = nghttp2_session_on_rst_stream_received(session, &frame);
 
-  /* Feed magic with one byte less */
-  rv = nghttp2_session_mem_recv(session, (const uint8_t *)NGHTTP2_CLIENT_MAGIC,
-                                NGHTTP2_CLIENT_MAGIC_LEN - 1);
+  CU_ASSERT(rv == 0);
 
-  CU_ASSERT(rv == NGHTTP2_CLIENT_MAGIC_LEN - 1);
-  CU_ASSERT(NGHTTP2_IB_READ_CLIENT_MAGIC == session->iframe.state);
-  CU_ASSERT(1 == session->iframe.payloadleft);
+  nghttp2_session_del(session);
+}
 
-  rv = nghttp2_session_mem_recv(session, (const uint8_t *)"\0", 1);
+static int submit_response_on_stream_close(nghttp2_session *session,
+                                           int32_t stream_id,
+                                           uint32_t error_code,
+                                           void *user_data) {
+  nghttp2_data_provider data_prd;
+  (void)error_code;
+  (void)user_data;
 
-  CU_ASSERT(NGHTTP2_ERR_BAD_CLIENT_MAGIC == rv);
+  data_prd.read_callback = temporal_failure_data_source_read_callback;
 
-  nghttp2_session_del(session);
+  // Attempt to submit response or data to the stream being closed
+  switch (stream_id) {
+  case 1:
+    CU_ASSERT(0 == nghttp2_submit_response(session, stream_id, resnv,
+                                           ARRLEN(resnv), &data_prd));
+    break;
+  case 3:
+    CU_ASSERT(0 == nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, stream_id,
+                                       &data_prd));
+    break;
+  }
 
-  /* disable global nghttp2_enable_strict_preface here */
-  nghttp2_enable_strict_preface = 0;
+  return 0;
 }
 
-void test_nghttp2_session_delete_data_item(void) {
+void test_nghttp2_session_detach_item_from_closed_stream(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *a;
-  nghttp2_data_provider prd;
 
   memset(&callbacks, 0, sizeof(callbacks));
 
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_stream_close_callback = submit_response_on_stream_close;
+
   nghttp2_session_server_new(&session, &callbacks, NULL);
 
-  a = open_recv_stream(session, 1);
-  open_recv_stream_with_dep(session, 3, a);
+  open_recv_stream(session, 1);
+  open_recv_stream(session, 3);
 
-  /* We don't care about these members, since we won't send data */
-  prd.source.ptr = NULL;
-  prd.read_callback = fail_data_source_read_callback;
+  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
+  nghttp2_session_close_stream(session, 3, NGHTTP2_NO_ERROR);
 
-  CU_ASSERT(0 == nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, 1, &prd));
-  CU_ASSERT(0 == nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, 3, &prd));
+  CU_ASSERT(0 == nghttp2_session_send(session));
 
   nghttp2_session_del(session);
 }
 
-void test_nghttp2_session_open_idle_stream(void) {
+void test_nghttp2_session_flooding(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *stream;
-  nghttp2_stream *opened_stream;
-  nghttp2_priority_spec pri_spec;
+  nghttp2_bufs bufs;
+  nghttp2_buf *buf;
   nghttp2_frame frame;
+  nghttp2_mem *mem;
+  size_t i;
 
-  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  mem = nghttp2_mem_default();
+
+  frame_pack_bufs_init(&bufs);
+
+  memset(&callbacks, 0, sizeof(callbacks));
 
+  /* PING ACK */
   nghttp2_session_server_new(&session, &callbacks, NULL);
 
-  nghttp2_priority_spec_init(&pri_spec, 0, 3, 0);
+  nghttp2_frame_ping_init(&frame.ping, NGHTTP2_FLAG_NONE, NULL);
+  nghttp2_frame_pack_ping(&bufs, &frame.ping);
+  nghttp2_frame_ping_free(&frame.ping);
 
-  nghttp2_frame_priority_init(&frame.priority, 1, &pri_spec);
+  buf = &bufs.head->buf;
 
-  CU_ASSERT(0 == nghttp2_session_on_priority_received(session, &frame));
+  for (i = 0; i < NGHTTP2_MAX_OBQ_FLOOD_ITEM; ++i) {
+    CU_ASSERT(
+        (ssize_t)nghttp2_buf_len(buf) ==
+        nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
+  }
 
-  stream = nghttp2_session_get_stream_raw(session, 1);
+  CU_ASSERT(NGHTTP2_ERR_FLOODED ==
+            nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
 
-  CU_ASSERT(NGHTTP2_STREAM_IDLE == stream->state);
-  CU_ASSERT(NULL == stream->closed_prev);
-  CU_ASSERT(NULL == stream->closed_next);
-  CU_ASSERT(1 == session->num_idle_streams);
-  CU_ASSERT(session->idle_stream_head == stream);
-  CU_ASSERT(session->idle_stream_tail == stream);
+  nghttp2_session_del(session);
 
-  opened_stream = open_recv_stream2(session, 1, NGHTTP2_STREAM_OPENING);
+  /* SETTINGS ACK */
+  nghttp2_bufs_reset(&bufs);
 
-  CU_ASSERT(stream == opened_stream);
-  CU_ASSERT(NGHTTP2_STREAM_OPENING == stream->state);
-  CU_ASSERT(0 == session->num_idle_streams);
-  CU_ASSERT(NULL == session->idle_stream_head);
-  CU_ASSERT(NULL == session->idle_stream_tail);
+  nghttp2_session_server_new(&session, &callbacks, NULL);
 
-  nghttp2_frame_priority_free(&frame.priority);
+  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE, NULL, 0);
+  nghttp2_frame_pack_settings(&bufs, &frame.settings);
+  nghttp2_frame_settings_free(&frame.settings, mem);
+
+  buf = &bufs.head->buf;
+
+  for (i = 0; i < NGHTTP2_MAX_OBQ_FLOOD_ITEM; ++i) {
+    CU_ASSERT(
+        (ssize_t)nghttp2_buf_len(buf) ==
+        nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
+  }
+
+  CU_ASSERT(NGHTTP2_ERR_FLOODED ==
+            nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
 
   nghttp2_session_del(session);
+  nghttp2_bufs_free(&bufs);
 }
 
-void test_nghttp2_session_cancel_reserved_remote(void) {
+void test_nghttp2_session_change_stream_priority(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *stream;
-  nghttp2_frame frame;
-  nghttp2_nv *nva;
-  size_t nvlen;
-  nghttp2_hd_deflater deflater;
-  nghttp2_mem *mem;
-  nghttp2_bufs bufs;
-  ssize_t rv;
+  nghttp2_stream *stream1, *stream2, *stream3, *stream5;
+  nghttp2_priority_spec pri_spec;
+  int rv;
 
-  mem = nghttp2_mem_default();
-  frame_pack_bufs_init(&bufs);
+  memset(&callbacks, 0, sizeof(callbacks));
 
-  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
-  callbacks.send_callback = null_send_callback;
+  nghttp2_session_server_new(&session, &callbacks, NULL);
 
-  nghttp2_session_client_new(&session, &callbacks, NULL);
+  stream1 = open_recv_stream(session, 1);
+  stream3 = open_recv_stream_with_dep_weight(session, 3, 199, stream1);
+  stream2 = open_sent_stream_with_dep_weight(session, 2, 101, stream3);
 
-  nghttp2_hd_deflate_init(&deflater, mem);
+  nghttp2_priority_spec_init(&pri_spec, 1, 256, 0);
 
-  stream = open_recv_stream2(session, 2, NGHTTP2_STREAM_RESERVED);
+  rv = nghttp2_session_change_stream_priority(session, 2, &pri_spec);
 
-  nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, 2, NGHTTP2_CANCEL);
+  CU_ASSERT(0 == rv);
 
-  CU_ASSERT(NGHTTP2_STREAM_CLOSING == stream->state);
+  CU_ASSERT(stream1 == stream2->dep_prev);
+  CU_ASSERT(256 == stream2->weight);
 
-  CU_ASSERT(0 == nghttp2_session_send(session));
+  /* Cannot change stream which does not exist */
+  rv = nghttp2_session_change_stream_priority(session, 5, &pri_spec);
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
 
-  nvlen = ARRLEN(resnv);
-  nghttp2_nv_array_copy(&nva, resnv, nvlen, mem);
+  /* It is an error to depend on itself */
+  rv = nghttp2_session_change_stream_priority(session, 1, &pri_spec);
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
 
-  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 2,
-                             NGHTTP2_HCAT_PUSH_RESPONSE, NULL, nva, nvlen);
-  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+  /* It is an error to change priority of root stream (0) */
+  rv = nghttp2_session_change_stream_priority(session, 0, &pri_spec);
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
 
-  CU_ASSERT(0 == rv);
+  /* Depends on the non-existing idle stream.  This creates that idle
+     stream. */
+  nghttp2_priority_spec_init(&pri_spec, 5, 9, 1);
 
-  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
-                                nghttp2_buf_len(&bufs.head->buf));
+  rv = nghttp2_session_change_stream_priority(session, 2, &pri_spec);
 
-  CU_ASSERT((ssize_t)nghttp2_buf_len(&bufs.head->buf) == rv);
+  CU_ASSERT(0 == rv);
 
-  /* stream is not dangling, so assign NULL */
-  stream = NULL;
+  stream5 = nghttp2_session_get_stream_raw(session, 5);
 
-  /* No RST_STREAM or GOAWAY is generated since stream should be in
-     NGHTTP2_STREAM_CLOSING and push response should be ignored. */
-  CU_ASSERT(0 == nghttp2_outbound_queue_size(&session->ob_reg));
+  CU_ASSERT(NULL != stream5);
+  CU_ASSERT(&session->root == stream5->dep_prev);
+  CU_ASSERT(stream5 == stream2->dep_prev);
+  CU_ASSERT(9 == stream2->weight);
 
-  /* Check that we can receive push response HEADERS while RST_STREAM
-     is just queued. */
-  open_recv_stream2(session, 4, NGHTTP2_STREAM_RESERVED);
+  nghttp2_session_del(session);
 
-  nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, 2, NGHTTP2_CANCEL);
+  /* Check that this works in client session too */
+  nghttp2_session_client_new(&session, &callbacks, NULL);
 
-  nghttp2_bufs_reset(&bufs);
+  stream1 = open_sent_stream(session, 1);
 
-  frame.hd.stream_id = 4;
-  rv = nghttp2_frame_pack_headers(&bufs, &frame.headers, &deflater);
+  nghttp2_priority_spec_init(&pri_spec, 5, 9, 1);
+
+  rv = nghttp2_session_change_stream_priority(session, 1, &pri_spec);
 
   CU_ASSERT(0 == rv);
 
-  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
-                                nghttp2_buf_len(&bufs.head->buf));
+  stream5 = nghttp2_session_get_stream_raw(session, 5);
 
-  CU_ASSERT((ssize_t)nghttp2_buf_len(&bufs.head->buf) == rv);
+  CU_ASSERT(NULL != stream5);
+  CU_ASSERT(&session->root == stream5->dep_prev);
+  CU_ASSERT(stream5 == stream1->dep_prev);
+  CU_ASSERT(9 == stream1->weight);
 
-  CU_ASSERT(1 == nghttp2_outbound_queue_size(&session->ob_reg));
+  nghttp2_session_del(session);
+}
 
-  nghttp2_frame_headers_free(&frame.headers, mem);
+typedef struct {
+  int32_t stream_ids[128];
+  size_t n;
+} extpri_send_log;
+
+static int extpri_on_frame_send_callback(nghttp2_session *session,
+                                         const nghttp2_frame *frame,
+                                         void *user_data) {
+  extpri_send_log *log = user_data;
+  (void)session;
 
-  nghttp2_hd_deflate_free(&deflater);
+  if (frame->hd.type == NGHTTP2_DATA && log->n < ARRLEN(log->stream_ids)) {
+    log->stream_ids[log->n++] = frame->hd.stream_id;
+  }
 
-  nghttp2_session_del(session);
+  return 0;
+}
+
+static ssize_t extpri_data_source_read_callback(
+    nghttp2_session *session, int32_t stream_id, uint8_t *buf, size_t len,
+    uint32_t *data_flags, nghttp2_data_source *source, void *user_data) {
+  (void)session;
+  (void)stream_id;
+  (void)buf;
+  (void)data_flags;
+  (void)source;
+  (void)user_data;
 
-  nghttp2_bufs_free(&bufs);
+  return (ssize_t)nghttp2_min(len, 1024);
 }
 
-void test_nghttp2_session_reset_pending_headers(void) {
+void test_nghttp2_session_extpri_scheduling(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_stream *stream;
-  int32_t stream_id;
-  my_user_data ud;
+  nghttp2_option *option;
+  nghttp2_data_provider data_prd;
+  nghttp2_extpri extpri;
+  extpri_send_log log;
+  size_t i;
+  int rv;
 
   memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
   callbacks.send_callback = null_send_callback;
-  callbacks.on_frame_send_callback = on_frame_send_callback;
-  callbacks.on_frame_not_send_callback = on_frame_not_send_callback;
-  callbacks.on_stream_close_callback = on_stream_close_callback;
-
-  nghttp2_session_client_new(&session, &callbacks, &ud);
-
-  stream_id = nghttp2_submit_request(session, NULL, NULL, 0, NULL, NULL);
-  CU_ASSERT(stream_id >= 1);
-
-  nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id,
-                            NGHTTP2_CANCEL);
-
-  session->remote_settings.max_concurrent_streams = 0;
+  callbacks.on_frame_send_callback = extpri_on_frame_send_callback;
 
-  /* RST_STREAM cancels pending HEADERS and is not actually sent. */
-  ud.frame_send_cb_called = 0;
-  CU_ASSERT(0 == nghttp2_session_send(session));
+  data_prd.read_callback = extpri_data_source_read_callback;
 
-  CU_ASSERT(0 == ud.frame_send_cb_called);
+  nghttp2_option_new(&option);
+  nghttp2_option_set_no_rfc7540_priorities(option, 1);
 
-  stream = nghttp2_session_get_stream(session, stream_id);
+  nghttp2_session_server_new2(&session, &callbacks, &log, option);
 
-  CU_ASSERT(NULL == stream);
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
 
-  /* See HEADERS is not sent.  on_stream_close is called just like
-     transmission failure. */
-  session->remote_settings.max_concurrent_streams = 1;
+  for (i = 0; i < 4; ++i) {
+    open_recv_stream(session, (int32_t)(i * 2 + 1));
 
-  ud.frame_not_send_cb_called = 0;
-  ud.stream_close_error_code = 0;
-  CU_ASSERT(0 == nghttp2_session_send(session));
+    rv = nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM,
+                             (int32_t)(i * 2 + 1), &data_prd);
 
-  CU_ASSERT(1 == ud.frame_not_send_cb_called);
-  CU_ASSERT(NGHTTP2_HEADERS == ud.not_sent_frame_type);
-  CU_ASSERT(NGHTTP2_CANCEL == ud.stream_close_error_code);
+    CU_ASSERT(0 == rv);
+  }
 
-  stream = nghttp2_session_get_stream(session, stream_id);
+  /* Stream 3 and 5 are incremental, and the most urgent. */
+  extpri.urgency = 1;
+  extpri.inc = 1;
 
-  CU_ASSERT(NULL == stream);
+  nghttp2_session_change_extpri_stream_priority(session, 3, &extpri, 1);
+  nghttp2_session_change_extpri_stream_priority(session, 5, &extpri, 1);
 
-  nghttp2_session_del(session);
-}
+  /* Stream 1 and 7 are not incremental. */
+  extpri.urgency = 3;
+  extpri.inc = 0;
 
-void test_nghttp2_session_send_data_callback(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  nghttp2_data_provider data_prd;
-  my_user_data ud;
-  accumulator acc;
-  nghttp2_frame_hd hd;
+  nghttp2_session_change_extpri_stream_priority(session, 7, &extpri, 1);
 
-  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
-  callbacks.send_callback = accumulator_send_callback;
-  callbacks.send_data_callback = send_data_callback;
+  log.n = 0;
 
-  data_prd.read_callback = no_copy_data_source_read_callback;
+  rv = nghttp2_session_send(session);
 
-  acc.length = 0;
-  ud.acc = &acc;
+  CU_ASSERT(0 == rv);
 
-  ud.data_source_length = NGHTTP2_DATA_PAYLOADLEN * 2;
+  /* Connection window is exhausted; stream 3 and 5 share it in round
+     robin fashion. */
+  CU_ASSERT(64 == log.n);
 
-  nghttp2_session_client_new(&session, &callbacks, &ud);
+  for (i = 0; i < log.n; ++i) {
+    CU_ASSERT((i % 2 == 0 ? 3 : 5) == log.stream_ids[i]);
+  }
 
-  open_sent_stream(session, 1);
+  /* Make stream 3 and 5 less urgent than the others. */
+  extpri.urgency = NGHTTP2_EXTPRI_URGENCY_LOW;
+  extpri.inc = 1;
 
-  nghttp2_submit_data(session, NGHTTP2_FLAG_END_STREAM, 1, &data_prd);
+  nghttp2_session_change_extpri_stream_priority(session, 3, &extpri, 1);
+  nghttp2_session_change_extpri_stream_priority(session, 5, &extpri, 1);
 
-  CU_ASSERT(0 == nghttp2_session_send(session));
+  session->remote_window_size = 4096;
 
-  CU_ASSERT((NGHTTP2_FRAME_HDLEN + NGHTTP2_DATA_PAYLOADLEN) * 2 == acc.length);
+  log.n = 0;
 
-  nghttp2_frame_unpack_frame_hd(&hd, acc.buf);
+  rv = nghttp2_session_send(session);
 
-  CU_ASSERT(16384 == hd.length);
-  CU_ASSERT(NGHTTP2_DATA == hd.type);
-  CU_ASSERT(NGHTTP2_FLAG_NONE == hd.flags);
+  CU_ASSERT(0 == rv);
 
-  nghttp2_frame_unpack_frame_hd(&hd, acc.buf + NGHTTP2_FRAME_HDLEN + hd.length);
+  /* Non-incremental streams are served one by one in stream ID
+     order. */
+  CU_ASSERT(4 == log.n);
 
-  CU_ASSERT(16384 == hd.length);
-  CU_ASSERT(NGHTTP2_DATA == hd.type);
-  CU_ASSERT(NGHTTP2_FLAG_END_STREAM == hd.flags);
+  for (i = 0; i < log.n; ++i) {
+    CU_ASSERT(1 == log.stream_ids[i]);
+  }
 
   nghttp2_session_del(session);
+  nghttp2_option_del(option);
 }
 
-void test_nghttp2_session_on_begin_headers_temporal_failure(void) {
+void test_nghttp2_session_change_extpri_stream_priority(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  my_user_data ud;
+  nghttp2_option *option;
   nghttp2_bufs bufs;
-  nghttp2_mem *mem;
-  ssize_t rv;
-  nghttp2_hd_deflater deflater;
-  nghttp2_outbound_item *item;
+  nghttp2_extension frame;
+  nghttp2_ext_priority_update priority_update;
+  nghttp2_stream *stream;
+  nghttp2_extpri extpri;
+  ssize_t nread;
+  int rv;
+  static const uint8_t field_value[] = "u=2";
 
-  mem = nghttp2_mem_default();
   frame_pack_bufs_init(&bufs);
-  nghttp2_hd_deflate_init(&deflater, mem);
+
+  frame.payload = &priority_update;
 
   memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
-  callbacks.on_begin_headers_callback =
-      temporal_failure_on_begin_headers_callback;
-  callbacks.on_header_callback = on_header_callback;
-  callbacks.on_frame_recv_callback = on_frame_recv_callback;
-  callbacks.send_callback = null_send_callback;
-  nghttp2_session_server_new(&session, &callbacks, &ud);
 
-  rv = pack_headers(&bufs, &deflater, 1, NGHTTP2_FLAG_END_HEADERS, reqnv,
-                    ARRLEN(reqnv), mem);
-  CU_ASSERT(0 == rv);
+  nghttp2_option_new(&option);
+  nghttp2_option_set_no_rfc7540_priorities(option, 1);
 
-  ud.header_cb_called = 0;
-  ud.frame_recv_cb_called = 0;
-  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
-                                nghttp2_bufs_len(&bufs));
-  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
-  CU_ASSERT(0 == ud.header_cb_called);
-  CU_ASSERT(0 == ud.frame_recv_cb_called);
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
 
-  item = nghttp2_session_get_next_ob_item(session);
-  CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
-  CU_ASSERT(1 == item->frame.hd.stream_id);
-  CU_ASSERT(NGHTTP2_INTERNAL_ERROR == item->frame.rst_stream.error_code);
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
 
-  nghttp2_session_del(session);
-  nghttp2_hd_deflate_free(&deflater);
+  stream = open_recv_stream(session, 1);
 
-  nghttp2_bufs_reset(&bufs);
-  /* check for PUSH_PROMISE */
-  nghttp2_hd_deflate_init(&deflater, mem);
-  nghttp2_session_client_new(&session, &callbacks, &ud);
+  extpri.urgency = NGHTTP2_EXTPRI_URGENCY_LOW + 1;
+  extpri.inc = 1;
 
-  open_sent_stream(session, 1);
+  rv = nghttp2_session_change_extpri_stream_priority(session, 1, &extpri,
+                                                     /* ignore_client_signal =
+                                                      */ 1);
 
-  rv = pack_push_promise(&bufs, &deflater, 1, NGHTTP2_FLAG_END_HEADERS, 2,
-                         reqnv, ARRLEN(reqnv), mem);
   CU_ASSERT(0 == rv);
+  CU_ASSERT(NGHTTP2_EXTPRI_URGENCY_LOW ==
+            nghttp2_extpri_uint8_urgency(stream->extpri));
+  CU_ASSERT(1 == nghttp2_extpri_uint8_inc(stream->extpri));
+  CU_ASSERT(stream->flags & NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES);
 
-  ud.header_cb_called = 0;
-  ud.frame_recv_cb_called = 0;
-  rv = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
-                                nghttp2_bufs_len(&bufs));
-  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == rv);
-  CU_ASSERT(0 == ud.header_cb_called);
-  CU_ASSERT(0 == ud.frame_recv_cb_called);
+  memset(&extpri, 0, sizeof(extpri));
 
-  item = nghttp2_session_get_next_ob_item(session);
-  CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
-  CU_ASSERT(2 == item->frame.hd.stream_id);
-  CU_ASSERT(NGHTTP2_INTERNAL_ERROR == item->frame.rst_stream.error_code);
+  rv = nghttp2_session_get_extpri_stream_priority(session, &extpri, 1);
 
-  nghttp2_session_del(session);
-  nghttp2_hd_deflate_free(&deflater);
-  nghttp2_bufs_free(&bufs);
-}
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NGHTTP2_EXTPRI_URGENCY_LOW == extpri.urgency);
+  CU_ASSERT(1 == extpri.inc);
 
-void test_nghttp2_session_defer_then_close(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  nghttp2_data_provider prd;
-  int rv;
-  const uint8_t *datap;
-  ssize_t datalen;
-  nghttp2_frame frame;
+  /* PRIORITY_UPDATE is ignored */
+  nghttp2_frame_priority_update_init(&frame, 1, (uint8_t *)field_value,
+                                     sizeof(field_value) - 1);
 
-  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
-  callbacks.send_callback = null_send_callback;
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
 
-  nghttp2_session_client_new(&session, &callbacks, NULL);
+  nread = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                   nghttp2_bufs_len(&bufs));
 
-  prd.read_callback = defer_data_source_read_callback;
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == nread);
+  CU_ASSERT(NGHTTP2_EXTPRI_URGENCY_LOW ==
+            nghttp2_extpri_uint8_urgency(stream->extpri));
+  CU_ASSERT(1 == nghttp2_extpri_uint8_inc(stream->extpri));
 
-  rv = nghttp2_submit_request(session, NULL, reqnv, ARRLEN(reqnv), &prd, NULL);
-  CU_ASSERT(rv > 0);
+  nghttp2_bufs_reset(&bufs);
 
-  /* This sends HEADERS */
-  datalen = nghttp2_session_mem_send(session, &datap);
+  extpri.urgency = NGHTTP2_EXTPRI_URGENCY_HIGH;
+  extpri.inc = 0;
 
-  CU_ASSERT(datalen > 0);
+  rv = nghttp2_session_change_extpri_stream_priority(session, 1, &extpri,
+                                                     /* ignore_client_signal =
+                                                      */ 0);
 
-  /* This makes DATA item deferred */
-  datalen = nghttp2_session_mem_send(session, &datap);
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(NGHTTP2_EXTPRI_URGENCY_HIGH ==
+            nghttp2_extpri_uint8_urgency(stream->extpri));
+  CU_ASSERT(0 == nghttp2_extpri_uint8_inc(stream->extpri));
+  CU_ASSERT(!(stream->flags & NGHTTP2_STREAM_FLAG_IGNORE_CLIENT_PRIORITIES));
 
-  CU_ASSERT(datalen == 0);
+  /* PRIORITY_UPDATE is now honored */
+  nghttp2_frame_pack_priority_update(&bufs, &frame);
 
-  nghttp2_frame_rst_stream_init(&frame.rst_stream, 1, NGHTTP2_CANCEL);
+  nread = nghttp2_session_mem_recv(session, bufs.head->buf.pos,
+                                   nghttp2_bufs_len(&bufs));
 
-  /* Assertion failure; GH-264 */
-  rv = nghttp2_session_on_rst_stream_received(session, &frame);
+  CU_ASSERT((ssize_t)nghttp2_bufs_len(&bufs) == nread);
+  CU_ASSERT(2 == nghttp2_extpri_uint8_urgency(stream->extpri));
 
-  CU_ASSERT(rv == 0);
+  nghttp2_bufs_reset(&bufs);
+
+  /* Invalid stream */
+  rv = nghttp2_session_change_extpri_stream_priority(session, 0, &extpri, 0);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = nghttp2_session_change_extpri_stream_priority(session, 3, &extpri, 0);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = nghttp2_session_get_extpri_stream_priority(session, &extpri, 3);
+
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
 
   nghttp2_session_del(session);
-}
 
-static int submit_response_on_stream_close(nghttp2_session *session,
-                                           int32_t stream_id,
-                                           uint32_t error_code,
-                                           void *user_data) {
-  nghttp2_data_provider data_prd;
-  (void)error_code;
-  (void)user_data;
+  /* Client session */
+  nghttp2_session_client_new2(&session, &callbacks, NULL, option);
 
-  data_prd.read_callback = temporal_failure_data_source_read_callback;
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
 
-  // Attempt to submit response or data to the stream being closed
-  switch (stream_id) {
-  case 1:
-    CU_ASSERT(0 == nghttp2_submit_response(session, stream_id, resnv,
-                                           ARRLEN(resnv), &data_prd));
-    break;
-  case 3:
-    CU_ASSERT(0 == nghttp2_submit_data(session, NGHTTP2_FLAG_NONE, stream_id,
-                                       &data_prd));
-    break;
-  }
+  open_sent_stream(session, 1);
 
-  return 0;
-}
+  rv = nghttp2_session_change_extpri_stream_priority(session, 1, &extpri, 0);
 
-void test_nghttp2_session_detach_item_from_closed_stream(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE == rv);
 
-  memset(&callbacks, 0, sizeof(callbacks));
+  rv = nghttp2_session_get_extpri_stream_priority(session, &extpri, 1);
 
-  callbacks.send_callback = null_send_callback;
-  callbacks.on_stream_close_callback = submit_response_on_stream_close;
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE == rv);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
 
+  /* Extensible priorities are not enabled */
   nghttp2_session_server_new(&session, &callbacks, NULL);
 
   open_recv_stream(session, 1);
-  open_recv_stream(session, 3);
 
-  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
-  nghttp2_session_close_stream(session, 3, NGHTTP2_NO_ERROR);
+  rv = nghttp2_session_change_extpri_stream_priority(session, 1, &extpri, 0);
 
-  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE == rv);
 
   nghttp2_session_del(session);
+
+  nghttp2_bufs_free(&bufs);
 }
 
-void test_nghttp2_session_flooding(void) {
+void test_nghttp2_session_no_rfc7540_priorities(void) {
   nghttp2_session *session;
   nghttp2_session_callbacks callbacks;
-  nghttp2_bufs bufs;
-  nghttp2_buf *buf;
+  nghttp2_option *option;
+  nghttp2_outbound_item *item;
+  nghttp2_settings_entry iv[2];
   nghttp2_frame frame;
+  nghttp2_stream *stream;
   nghttp2_mem *mem;
-  size_t i;
+  int rv;
 
   mem = nghttp2_mem_default();
 
-  frame_pack_bufs_init(&bufs);
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_no_rfc7540_priorities(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
+
+  /* SETTINGS_NO_RFC7540_PRIORITIES is added automatically */
+  iv[0].settings_id = NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  iv[0].value = 100;
+
+  rv = nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, iv, 1);
+
+  CU_ASSERT(0 == rv);
+
+  item = nghttp2_session_get_next_ob_item(session);
+
+  CU_ASSERT(NGHTTP2_SETTINGS == item->frame.hd.type);
+  CU_ASSERT(2 == item->frame.settings.niv);
+  CU_ASSERT(NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS ==
+            item->frame.settings.iv[0].settings_id);
+  CU_ASSERT(NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES ==
+            item->frame.settings.iv[1].settings_id);
+  CU_ASSERT(1 == item->frame.settings.iv[1].value);
+  CU_ASSERT(1 == session->pending_no_rfc7540_priorities);
+
+  /* The value cannot be changed later */
+  iv[0].settings_id = NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES;
+  iv[0].value = 0;
 
-  memset(&callbacks, 0, sizeof(callbacks));
+  rv = nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, iv, 1);
 
-  /* PING ACK */
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
 
-  nghttp2_frame_ping_init(&frame.ping, NGHTTP2_FLAG_NONE, NULL);
-  nghttp2_frame_pack_ping(&bufs, &frame.ping);
-  nghttp2_frame_ping_free(&frame.ping);
+  /* Value other than 0 or 1 is invalid */
+  iv[0].value = 2;
 
-  buf = &bufs.head->buf;
+  rv = nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, iv, 1);
 
-  for (i = 0; i < NGHTTP2_MAX_OBQ_FLOOD_ITEM; ++i) {
-    CU_ASSERT(
-        (ssize_t)nghttp2_buf_len(buf) ==
-        nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
-  }
+  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
 
-  CU_ASSERT(NGHTTP2_ERR_FLOODED ==
-            nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
+  /* Streams are scheduled by RFC 9218 */
+  stream = open_recv_stream(session, 1);
 
-  nghttp2_session_del(session);
+  CU_ASSERT(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES);
+  CU_ASSERT(!nghttp2_stream_in_dep_tree(stream));
 
-  /* SETTINGS ACK */
-  nghttp2_bufs_reset(&bufs);
+  /* Remote value other than 0 or 1 is a connection error */
+  iv[0].value = 2;
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE,
+                              dup_iv(iv, 1), 1);
 
-  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE, NULL, 0);
-  nghttp2_frame_pack_settings(&bufs, &frame.settings);
-  nghttp2_frame_settings_free(&frame.settings, mem);
+  rv = nghttp2_session_on_settings_received(session, &frame, 0);
 
-  buf = &bufs.head->buf;
+  CU_ASSERT(0 == rv);
 
-  for (i = 0; i < NGHTTP2_MAX_OBQ_FLOOD_ITEM; ++i) {
-    CU_ASSERT(
-        (ssize_t)nghttp2_buf_len(buf) ==
-        nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
-  }
+  nghttp2_frame_settings_free(&frame.settings, mem);
 
-  CU_ASSERT(NGHTTP2_ERR_FLOODED ==
-            nghttp2_session_mem_recv(session, buf->pos, nghttp2_buf_len(buf)));
+  CU_ASSERT(session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND);
 
   nghttp2_session_del(session);
-  nghttp2_bufs_free(&bufs);
-}
-
-void test_nghttp2_session_change_stream_priority(void) {
-  nghttp2_session *session;
-  nghttp2_session_callbacks callbacks;
-  nghttp2_stream *stream1, *stream2, *stream3, *stream5;
-  nghttp2_priority_spec pri_spec;
-  int rv;
-
-  memset(&callbacks, 0, sizeof(callbacks));
 
-  nghttp2_session_server_new(&session, &callbacks, NULL);
+  /* Remote value cannot be changed */
+  nghttp2_session_client_new(&session, &callbacks, NULL);
 
-  stream1 = open_recv_stream(session, 1);
-  stream3 = open_recv_stream_with_dep_weight(session, 3, 199, stream1);
-  stream2 = open_sent_stream_with_dep_weight(session, 2, 101, stream3);
+  iv[0].settings_id = NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES;
+  iv[0].value = 1;
 
-  nghttp2_priority_spec_init(&pri_spec, 1, 256, 0);
+  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE,
+                              dup_iv(iv, 1), 1);
 
-  rv = nghttp2_session_change_stream_priority(session, 2, &pri_spec);
+  rv = nghttp2_session_on_settings_received(session, &frame, 0);
 
   CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == nghttp2_session_get_remote_settings(
+                     session, NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES));
 
-  CU_ASSERT(stream1 == stream2->dep_prev);
-  CU_ASSERT(256 == stream2->weight);
-
-  /* Cannot change stream which does not exist */
-  rv = nghttp2_session_change_stream_priority(session, 5, &pri_spec);
-  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
-
-  /* It is an error to depend on itself */
-  rv = nghttp2_session_change_stream_priority(session, 1, &pri_spec);
-  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+  nghttp2_frame_settings_free(&frame.settings, mem);
 
-  /* It is an error to change priority of root stream (0) */
-  rv = nghttp2_session_change_stream_priority(session, 0, &pri_spec);
-  CU_ASSERT(NGHTTP2_ERR_INVALID_ARGUMENT == rv);
+  iv[0].value = 0;
 
-  /* Depends on the non-existing idle stream.  This creates that idle
-     stream. */
-  nghttp2_priority_spec_init(&pri_spec, 5, 9, 1);
+  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE,
+                              dup_iv(iv, 1), 1);
 
-  rv = nghttp2_session_change_stream_priority(session, 2, &pri_spec);
+  rv = nghttp2_session_on_settings_received(session, &frame, 0);
 
   CU_ASSERT(0 == rv);
 
-  stream5 = nghttp2_session_get_stream_raw(session, 5);
+  nghttp2_frame_settings_free(&frame.settings, mem);
 
-  CU_ASSERT(NULL != stream5);
-  CU_ASSERT(&session->root == stream5->dep_prev);
-  CU_ASSERT(stream5 == stream2->dep_prev);
-  CU_ASSERT(9 == stream2->weight);
+  CU_ASSERT(session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND);
 
   nghttp2_session_del(session);
 
-  /* Check that this works in client session too */
-  nghttp2_session_client_new(&session, &callbacks, NULL);
+  /* Server falls back to RFC 7540 priorities if client does not send
+     SETTINGS_NO_RFC7540_PRIORITIES = 1 */
+  nghttp2_option_set_server_fallback_rfc7540_priorities(option, 1);
 
-  stream1 = open_sent_stream(session, 1);
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
 
-  nghttp2_priority_spec_init(&pri_spec, 5, 9, 1);
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, NULL, 0);
 
-  rv = nghttp2_session_change_stream_priority(session, 1, &pri_spec);
+  iv[0].settings_id = NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  iv[0].value = 100;
+
+  nghttp2_frame_settings_init(&frame.settings, NGHTTP2_FLAG_NONE,
+                              dup_iv(iv, 1), 1);
+
+  rv = nghttp2_session_on_settings_received(session, &frame, 0);
 
   CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == session->fallback_rfc7540_priorities);
+  CU_ASSERT(0 == nghttp2_session_get_remote_settings(
+                     session, NGHTTP2_SETTINGS_NO_RFC7540_PRIORITIES));
 
-  stream5 = nghttp2_session_get_stream_raw(session, 5);
+  nghttp2_frame_settings_free(&frame.settings, mem);
 
-  CU_ASSERT(NULL != stream5);
-  CU_ASSERT(&session->root == stream5->dep_prev);
-  CU_ASSERT(stream5 == stream1->dep_prev);
-  CU_ASSERT(9 == stream1->weight);
+  stream = open_recv_stream(session, 1);
+
+  CU_ASSERT(!(stream->flags & NGHTTP2_STREAM_FLAG_NO_RFC7540_PRIORITIES));
+  CU_ASSERT(nghttp2_stream_in_dep_tree(stream));
 
   nghttp2_session_del(session);
+  nghttp2_option_del(option);
 }
 
 void test_nghttp2_session_create_idle_stream(void) {
@@ -11830,3 +14032,222 @@ void test_nghttp2_http_head_method_upgrade_workaround(void) {
   nghttp2_session_del(session);
   nghttp2_bufs_free(&bufs);
 }
+
+void test_nghttp2_session_max_session_memory(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_option *option;
+  nghttp2_frame frame;
+  nghttp2_outbound_item *item;
+  size_t usage;
+  my_user_data ud;
+  const uint8_t ping[] = {0, 0, 8, NGHTTP2_PING, 0, 0, 0, 0, 0,
+                          1, 2, 3, 4, 5, 6, 7, 8};
+  nghttp2_mem *mem;
+  int32_t i;
+
+  mem = nghttp2_mem_default();
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_invalid_frame_recv_callback = on_invalid_frame_recv_callback;
+
+  /* Memory is not accounted by default */
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  CU_ASSERT(0 == nghttp2_session_get_memory_usage(session));
+  CU_ASSERT(0 == nghttp2_session_get_peak_memory_usage(session));
+
+  nghttp2_session_del(session);
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_max_session_memory(option, SIZE_MAX);
+
+  nghttp2_session_server_new2(&session, &callbacks, &ud, option);
+
+  usage = nghttp2_session_get_memory_usage(session);
+
+  CU_ASSERT(usage > sizeof(nghttp2_session));
+  CU_ASSERT(usage == nghttp2_session_get_peak_memory_usage(session));
+
+  for (i = 1; i <= 7; i += 2) {
+    open_recv_stream(session, i);
+  }
+
+  CU_ASSERT(nghttp2_session_get_memory_usage(session) > usage);
+
+  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
+  nghttp2_session_close_stream(session, 3, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(2 == session->num_closed_streams);
+
+  usage = nghttp2_session_get_memory_usage(session);
+
+  /* Above 3/4 of the budget, retained streams are released, and new
+     streams are refused. */
+  session->max_session_memory = usage;
+
+  CU_ASSERT(17 == nghttp2_session_mem_recv(session, ping, sizeof(ping)));
+  CU_ASSERT(0 == session->num_closed_streams);
+  CU_ASSERT(nghttp2_session_get_memory_usage(session) < usage);
+  CU_ASSERT(nghttp2_session_get_peak_memory_usage(session) >= usage);
+  CU_ASSERT(NULL == nghttp2_session_get_stream_raw(session, 1));
+  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 5));
+  CU_ASSERT(0 == (session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND));
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS, 9,
+                             NGHTTP2_HCAT_REQUEST, NULL, NULL, 0);
+  ud.invalid_frame_recv_cb_called = 0;
+
+  CU_ASSERT(NGHTTP2_ERR_IGN_HEADER_BLOCK ==
+            nghttp2_session_on_request_headers_received(session, &frame));
+  CU_ASSERT(1 == ud.invalid_frame_recv_cb_called);
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 9));
+
+  item = nghttp2_session_get_next_ob_item(session);
+
+  CU_ASSERT(NGHTTP2_RST_STREAM == item->frame.hd.type);
+  CU_ASSERT(9 == item->frame.hd.stream_id);
+  CU_ASSERT(NGHTTP2_REFUSED_STREAM == item->frame.rst_stream.error_code);
+
+  nghttp2_frame_headers_free(&frame.headers, mem);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+
+  /* Above the budget, the session is terminated */
+  session->max_session_memory = nghttp2_session_get_memory_usage(session) / 2;
+
+  CU_ASSERT(17 == nghttp2_session_mem_recv(session, ping, sizeof(ping)));
+  CU_ASSERT(session->goaway_flags & NGHTTP2_GOAWAY_TERM_ON_SEND);
+
+  item = nghttp2_outbound_queue_top(&session->ob_reg);
+
+  CU_ASSERT(NGHTTP2_GOAWAY == item->frame.hd.type);
+  CU_ASSERT(NGHTTP2_ENHANCE_YOUR_CALM == item->frame.goaway.error_code);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+}
+
+void test_nghttp2_session_compact_retained_streams(void) {
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  nghttp2_option *option;
+  nghttp2_stream *stream, *dep_stream;
+  nghttp2_priority_spec pri_spec;
+  nghttp2_frame frame;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+
+  /* Closed streams are kept in full by default */
+  nghttp2_session_server_new(&session, &callbacks, NULL);
+
+  open_recv_stream(session, 1);
+  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(0 == session->compact_closed_streams.len);
+
+  nghttp2_session_del(session);
+
+  nghttp2_option_new(&option);
+  nghttp2_option_set_compact_retained_streams(option, 1);
+
+  nghttp2_session_server_new2(&session, &callbacks, NULL, option);
+
+  open_recv_stream(session, 1);
+  open_recv_stream(session, 3);
+
+  nghttp2_session_close_stream(session, 1, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(0 == session->num_closed_streams);
+  CU_ASSERT(1 == session->compact_closed_streams.len);
+  CU_ASSERT(NULL == nghttp2_map_find(&session->streams, 1));
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == session->root.sum_dep_weight);
+
+  /* A stream depending on the compact stream restores it */
+  nghttp2_priority_spec_init(&pri_spec, 1, 32, 0);
+  stream = open_recv_stream3(session, 5, NGHTTP2_FLAG_NONE, &pri_spec,
+                             NGHTTP2_STREAM_OPENED, NULL);
+  dep_stream = nghttp2_session_get_stream_raw(session, 1);
+
+  CU_ASSERT(0 == session->compact_closed_streams.len);
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(dep_stream == session->closed_stream_head);
+  CU_ASSERT(dep_stream->flags & NGHTTP2_STREAM_FLAG_CLOSED);
+  CU_ASSERT(NGHTTP2_DEFAULT_WEIGHT == dep_stream->weight);
+  CU_ASSERT(&session->root == dep_stream->dep_prev);
+  CU_ASSERT(dep_stream == stream->dep_prev);
+  CU_ASSERT(32 == stream->weight);
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 1));
+
+  /* A closed stream with dependent streams is kept in full */
+  nghttp2_session_close_stream(session, 5, NGHTTP2_NO_ERROR);
+  nghttp2_session_close_stream(session, 3, NGHTTP2_NO_ERROR);
+
+  CU_ASSERT(1 == session->num_closed_streams);
+  CU_ASSERT(2 == session->compact_closed_streams.len);
+  CU_ASSERT(NULL == dep_stream->dep_next);
+
+  /* The compact stream remembers its parent */
+  stream = nghttp2_session_find_stream(session, 5);
+
+  CU_ASSERT(NULL != stream);
+  CU_ASSERT(dep_stream == stream->dep_prev);
+  CU_ASSERT(32 == stream->weight);
+  CU_ASSERT(2 == session->num_closed_streams);
+  CU_ASSERT(1 == session->compact_closed_streams.len);
+
+  /* Compact streams are deleted first */
+  session->local_settings.max_concurrent_streams = 2;
+
+  CU_ASSERT(0 == nghttp2_session_adjust_closed_stream(session));
+  CU_ASSERT(0 == session->compact_closed_streams.len);
+  CU_ASSERT(2 == session->num_closed_streams);
+  CU_ASSERT(NULL == nghttp2_session_find_stream(session, 3));
+
+  /* Idle stream created by PRIORITY is kept in compact form */
+  nghttp2_priority_spec_init(&pri_spec, 0, 100, 0);
+  nghttp2_frame_priority_init(&frame.priority, 11, &pri_spec);
+
+  CU_ASSERT(0 == nghttp2_session_on_priority_received(session, &frame));
+  CU_ASSERT(0 == session->num_idle_streams);
+  CU_ASSERT(1 == session->compact_idle_streams.len);
+
+  nghttp2_frame_priority_free(&frame.priority);
+
+  /* Opening the idle stream restores it first */
+  stream = open_recv_stream(session, 11);
+
+  CU_ASSERT(NGHTTP2_STREAM_OPENED == stream->state);
+  CU_ASSERT(0 == session->num_idle_streams);
+  CU_ASSERT(0 == session->compact_idle_streams.len);
+
+  nghttp2_priority_spec_init(&pri_spec, 0, 100, 0);
+  nghttp2_frame_priority_init(&frame.priority, 13, &pri_spec);
+
+  CU_ASSERT(0 == nghttp2_session_on_priority_received(session, &frame));
+
+  nghttp2_frame_priority_free(&frame.priority);
+
+  stream = nghttp2_session_find_stream(session, 13);
+
+  CU_ASSERT(NGHTTP2_STREAM_IDLE == stream->state);
+  CU_ASSERT(100 == stream->weight);
+  CU_ASSERT(&session->root == stream->dep_prev);
+  CU_ASSERT(1 == session->num_idle_streams);
+  CU_ASSERT(0 == session->compact_idle_streams.len);
+
+  /* Compact streams left are freed */
+  nghttp2_frame_priority_init(&frame.priority, 15, &pri_spec);
+
+  CU_ASSERT(0 == nghttp2_session_on_priority_received(session, &frame));
+  CU_ASSERT(1 == session->compact_idle_streams.len);
+
+  nghttp2_frame_priority_free(&frame.priority);
+
+  nghttp2_session_del(session);
+  nghttp2_option_del(option);
+}
@@ -36,6 +36,7 @@ void test_nghttp2_session_recv_eof(void);
 void test_nghttp2_session_recv_data(void);
 void test_nghttp2_session_recv_data_no_auto_flow_control(void);
 void test_nghttp2_session_recv_continuation(void);
+void test_nghttp2_session_recv_header_list_too_large(void);
 void test_nghttp2_session_recv_headers_with_priority(void);
 void test_nghttp2_session_recv_headers_with_padding(void);
 void test_nghttp2_session_recv_headers_early_response(void);
@@ -48,6 +49,7 @@ void test_nghttp2_session_recv_too_large_frame_length(void);
 void test_nghttp2_session_recv_extension(void);
 void test_nghttp2_session_recv_altsvc(void);
 void test_nghttp2_session_recv_origin(void);
+void test_nghttp2_session_recv_priority_update(void);
 void test_nghttp2_session_continue(void);
 void test_nghttp2_session_add_frame(void);
 void test_nghttp2_session_on_request_headers_received(void);
@@ -102,6 +104,7 @@ void test_nghttp2_submit_invalid_nv(void);
 void test_nghttp2_submit_extension(void);
 void test_nghttp2_submit_altsvc(void);
 void test_nghttp2_submit_origin(void);
+void test_nghttp2_submit_priority_update(void);
 void test_nghttp2_session_open_stream(void);
 void test_nghttp2_session_open_stream_with_idle_stream_dep(void);
 void test_nghttp2_session_get_next_ob_item(void);
@@ -121,6 +124,10 @@ void test_nghttp2_session_get_effective_local_window_size(void);
 void test_nghttp2_session_set_option(void);
 void test_nghttp2_session_data_backoff_by_high_pri_frame(void);
 void test_nghttp2_session_pack_data_with_padding(void);
+void test_nghttp2_session_select_hd_indexing(void);
+void test_nghttp2_session_hd_template(void);
+void test_nghttp2_session_hd_inflate_zero_copy(void);
+void test_nghttp2_session_object_pool(void);
 void test_nghttp2_session_pack_headers_with_padding(void);
 void test_nghttp2_pack_settings_payload(void);
 void test_nghttp2_session_stream_dep_add(void);
@@ -137,6 +144,7 @@ void test_nghttp2_session_keep_closed_stream(void);
 void test_nghttp2_session_keep_idle_stream(void);
 void test_nghttp2_session_detach_idle_stream(void);
 void test_nghttp2_session_large_dep_tree(void);
+void test_nghttp2_session_flat_tree_scheduling(void);
 void test_nghttp2_session_graceful_shutdown(void);
 void test_nghttp2_session_on_header_temporal_failure(void);
 void test_nghttp2_session_recv_client_magic(void);
@@ -145,11 +153,22 @@ void test_nghttp2_session_open_idle_stream(void);
 void test_nghttp2_session_cancel_reserved_remote(void);
 void test_nghttp2_session_reset_pending_headers(void);
 void test_nghttp2_session_send_data_callback(void);
+void test_nghttp2_session_mem_sendv(void);
+void test_nghttp2_session_mem_send_batch(void);
+void test_nghttp2_session_submission_queue(void);
+void test_nghttp2_session_max_session_memory(void);
+void test_nghttp2_session_compact_retained_streams(void);
+void test_nghttp2_session_auto_window_tuning(void);
+void test_nghttp2_session_stats(void);
+void test_nghttp2_session_mem_recv_split(void);
 void test_nghttp2_session_on_begin_headers_temporal_failure(void);
 void test_nghttp2_session_defer_then_close(void);
 void test_nghttp2_session_detach_item_from_closed_stream(void);
 void test_nghttp2_session_flooding(void);
 void test_nghttp2_session_change_stream_priority(void);
+void test_nghttp2_session_extpri_scheduling(void);
+void test_nghttp2_session_change_extpri_stream_priority(void);
+void test_nghttp2_session_no_rfc7540_priorities(void);
 void test_nghttp2_session_create_idle_stream(void);
 void test_nghttp2_session_repeated_priority_change(void);
 void test_nghttp2_session_repeated_priority_submission(void);
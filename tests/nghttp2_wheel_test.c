@@ -0,0 +1,109 @@
+/*
+ * nghttp2 - HTTP/2 C Library
+ *
+ * Copyright (c) 2026 nghttp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_wheel_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "nghttp2_wheel.h"
+
+#define BUCKET_WIDTH (1u << NGHTTP2_WHEEL_BUCKET_SHIFT)
+
+void test_nghttp2_wheel(void) {
+  nghttp2_wheel wheel;
+  nghttp2_wheel_entry ents[8];
+
+  nghttp2_wheel_init(&wheel);
+
+  CU_ASSERT(nghttp2_wheel_empty(&wheel));
+  CU_ASSERT(NULL == nghttp2_wheel_top(&wheel));
+
+  /* Entries come out in the order of bucket, and in the order they
+     were pushed within a bucket. */
+  nghttp2_wheel_push(&wheel, &ents[0], 0);
+  nghttp2_wheel_push(&wheel, &ents[1], BUCKET_WIDTH * 3);
+  nghttp2_wheel_push(&wheel, &ents[2], BUCKET_WIDTH + 1);
+  nghttp2_wheel_push(&wheel, &ents[3], BUCKET_WIDTH);
+
+  CU_ASSERT(4 == nghttp2_wheel_size(&wheel));
+  CU_ASSERT(&ents[0] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[0]);
+
+  CU_ASSERT(&ents[2] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[2]);
+
+  CU_ASSERT(&ents[3] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[3]);
+
+  CU_ASSERT(&ents[1] == nghttp2_wheel_top(&wheel));
+  CU_ASSERT(BUCKET_WIDTH * 3 == wheel.base);
+
+  /* A key smaller than the current top bucket goes to the top
+     bucket. */
+  nghttp2_wheel_push(&wheel, &ents[4], 0);
+
+  nghttp2_wheel_remove(&wheel, &ents[1]);
+
+  CU_ASSERT(&ents[4] == nghttp2_wheel_top(&wheel));
+
+  /* A key beyond the range of buckets goes to the last bucket. */
+  nghttp2_wheel_push(&wheel, &ents[5], BUCKET_WIDTH * 3 + (1u << 30));
+  nghttp2_wheel_push(&wheel, &ents[6],
+                     BUCKET_WIDTH * (3 + NGHTTP2_WHEEL_NBUCKET - 2));
+
+  nghttp2_wheel_remove(&wheel, &ents[4]);
+
+  CU_ASSERT(&ents[6] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[6]);
+
+  CU_ASSERT(&ents[5] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[5]);
+
+  CU_ASSERT(nghttp2_wheel_empty(&wheel));
+  CU_ASSERT(NULL == nghttp2_wheel_top(&wheel));
+
+  /* Keys wrap around. */
+  nghttp2_wheel_push(&wheel, &ents[0], UINT32_MAX - 10);
+  nghttp2_wheel_push(&wheel, &ents[1], BUCKET_WIDTH * 2);
+  nghttp2_wheel_push(&wheel, &ents[2], 5);
+
+  CU_ASSERT(&ents[0] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[0]);
+
+  CU_ASSERT(&ents[2] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[2]);
+
+  CU_ASSERT(&ents[1] == nghttp2_wheel_top(&wheel));
+
+  nghttp2_wheel_remove(&wheel, &ents[1]);
+
+  CU_ASSERT(nghttp2_wheel_empty(&wheel));
+}